@@ -0,0 +1,780 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/falloc.h>
+#include <linux/limits.h>
+#include <wayland-util.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "file_sink.h"
+#include "debug.h"
+
+/* Buffer sizes, file offsets and memory are kept at this alignment so
+ * that O_DIRECT works on every common file system. */
+#define FILE_SINK_ALIGN 4096
+#define FILE_SINK_DEFAULT_BUFFER_SIZE (1024 * 1024)
+#define FILE_SINK_DEFAULT_NUM_BUFFERS 8
+#define FILE_SINK_MAX_BUFFERS 64
+
+#define NSEC_PER_MSEC 1000000ULL
+
+struct sink_segment {
+	char *path;
+	int fd;
+	int direct;
+	int failed;
+
+	/* where the segment starts in its file, non-zero when appending */
+	uint64_t base;
+	/* bytes handed to the writer, and bytes the writer has written */
+	uint64_t queued;
+	uint64_t written;
+	uint64_t start_ms;
+
+	struct file_sink_index_entry *index;
+	unsigned index_count;
+	unsigned index_capacity;
+};
+
+struct sink_buffer {
+	uint8_t *data;
+	size_t len;
+	struct sink_segment *segment;
+	/* the segment ends with this buffer */
+	int close_segment;
+
+	/* filled in by the writer */
+	uint64_t offset;
+	size_t direct_len;
+
+	/* file_sink::free_list or file_sink::queue */
+	struct wl_list link;
+};
+
+struct file_sink {
+	struct file_sink_options options;
+	char *path_stem;
+	char *path_ext;
+	unsigned next_seq;
+
+	struct sink_buffer buffers[FILE_SINK_MAX_BUFFERS];
+	unsigned num_buffers;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t queued_cond;
+	pthread_cond_t free_cond;
+	struct wl_list free_list;
+	struct wl_list queue;
+	int destroying;
+
+	/* owned by the thread calling file_sink_write() */
+	struct sink_buffer *current;
+	struct sink_segment *segment;
+
+	/* protected by lock */
+	struct file_sink_stats stats;
+
+#ifdef HAVE_LIBURING
+	struct io_uring ring;
+#endif
+	int use_uring;
+};
+
+static uint64_t
+sink_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+pwrite_all(int fd, const uint8_t *data, size_t len, uint64_t offset)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = pwrite(fd, data, len, offset);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
+
+static void
+sink_segment_open(struct file_sink *sink, struct sink_segment *segment)
+{
+	int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+	off_t end;
+
+	if (!sink->options.append)
+		flags |= O_TRUNC;
+
+	segment->fd = -1;
+	if (segment->direct) {
+		segment->fd = open(segment->path, flags | O_DIRECT, 0644);
+		if (segment->fd < 0 && errno == EINVAL)
+			INFO("%s does not support O_DIRECT.\n", segment->path);
+	}
+	if (segment->fd < 0) {
+		segment->direct = 0;
+		segment->fd = open(segment->path, flags, 0644);
+	}
+	if (segment->fd < 0) {
+		ERROR("Failed to open video output file: %s: %m.\n",
+				segment->path);
+		segment->failed = 1;
+		return;
+	}
+
+	if (sink->options.append) {
+		end = lseek(segment->fd, 0, SEEK_END);
+		segment->base = end > 0 ? end : 0;
+	}
+
+	/* Reserve the whole segment up front so the file system can lay it
+	 * out in one piece; the file size is only set by what is written. */
+	if (sink->options.segment_size)
+		fallocate(segment->fd, FALLOC_FL_KEEP_SIZE, segment->base,
+			  sink->options.segment_size);
+
+	INFO("Writing to %s (mode:%s / direct:%s)\n", segment->path,
+			sink->options.append ? "append" : "rewrite",
+			segment->direct ? "on" : "off");
+}
+
+static void
+sink_segment_write_index(struct sink_segment *segment)
+{
+	struct file_sink_index_header header = {
+		.magic = FILE_SINK_INDEX_MAGIC,
+		.version = FILE_SINK_INDEX_VERSION,
+		.count = segment->index_count,
+	};
+	char path[PATH_MAX];
+	FILE *fp;
+
+	if (snprintf(path, sizeof path, "%s.idx", segment->path) >=
+	    (int)sizeof path)
+		return;
+
+	fp = fopen(path, "wb");
+	if (!fp) {
+		ERROR("Failed to open segment index %s: %m.\n", path);
+		return;
+	}
+
+	if (fwrite(&header, sizeof header, 1, fp) != 1 ||
+	    fwrite(segment->index, sizeof *segment->index,
+		   segment->index_count, fp) != segment->index_count)
+		ERROR("Failed to write segment index %s.\n", path);
+
+	fclose(fp);
+}
+
+static void
+sink_segment_close(struct file_sink *sink, struct sink_segment *segment)
+{
+	unsigned i;
+
+	if (segment->fd >= 0) {
+		/* drops the preallocated blocks past the end of the data */
+		if (sink->options.segment_size &&
+		    ftruncate(segment->fd, segment->base + segment->written) < 0)
+			ERROR("Failed to truncate %s: %m.\n", segment->path);
+
+		if (sink->options.fsync != FILE_SINK_FSYNC_NONE)
+			fsync(segment->fd);
+
+		close(segment->fd);
+
+		if (sink->options.write_index) {
+			for (i = 0; i < segment->index_count; i++)
+				segment->index[i].offset += segment->base;
+			sink_segment_write_index(segment);
+		}
+	}
+
+	free(segment->index);
+	free(segment->path);
+	free(segment);
+}
+
+/* Writes the tail of a direct segment that is not a multiple of the block
+ * size. That only happens for the last buffer of a segment, so the file
+ * can simply continue without O_DIRECT. */
+static int
+sink_write_tail(struct sink_buffer *buffer)
+{
+	struct sink_segment *segment = buffer->segment;
+	int flags;
+
+	if (segment->direct) {
+		flags = fcntl(segment->fd, F_GETFL);
+		fcntl(segment->fd, F_SETFL, flags & ~O_DIRECT);
+		segment->direct = 0;
+	}
+
+	return pwrite_all(segment->fd, buffer->data + buffer->direct_len,
+			  buffer->len - buffer->direct_len,
+			  buffer->offset + buffer->direct_len);
+}
+
+#ifdef HAVE_LIBURING
+static int
+sink_submit_uring(struct file_sink *sink, struct sink_buffer **run,
+		  unsigned count)
+{
+	struct sink_buffer *buffer;
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	unsigned i, submitted = 0;
+	int errors = 0;
+
+	for (i = 0; i < count; i++) {
+		buffer = run[i];
+		if (buffer->direct_len == 0)
+			continue;
+
+		sqe = io_uring_get_sqe(&sink->ring);
+		io_uring_prep_write(sqe, buffer->segment->fd, buffer->data,
+				    buffer->direct_len, buffer->offset);
+		io_uring_sqe_set_data(sqe, buffer);
+		submitted++;
+	}
+
+	if (submitted == 0)
+		return 0;
+
+	io_uring_submit_and_wait(&sink->ring, submitted);
+
+	for (i = 0; i < submitted; i++) {
+		if (io_uring_wait_cqe(&sink->ring, &cqe) < 0) {
+			errors++;
+			continue;
+		}
+
+		buffer = io_uring_cqe_get_data(cqe);
+
+		/* short writes are finished synchronously */
+		if (cqe->res >= 0 && (size_t)cqe->res < buffer->direct_len &&
+		    pwrite_all(buffer->segment->fd, buffer->data + cqe->res,
+			       buffer->direct_len - cqe->res,
+			       buffer->offset + cqe->res) < 0)
+			errors++;
+		else if (cqe->res < 0)
+			errors++;
+
+		io_uring_cqe_seen(&sink->ring, cqe);
+	}
+
+	return errors;
+}
+#endif
+
+static int
+sink_submit_sync(struct sink_buffer **run, unsigned count)
+{
+	struct sink_buffer *buffer;
+	unsigned i;
+	int errors = 0;
+
+	for (i = 0; i < count; i++) {
+		buffer = run[i];
+		if (buffer->direct_len > 0 &&
+		    pwrite_all(buffer->segment->fd, buffer->data,
+			       buffer->direct_len, buffer->offset) < 0)
+			errors++;
+	}
+
+	return errors;
+}
+
+/*
+ * Writes a run of queued buffers. All of them are in flight at once with
+ * io_uring; a run ends with a buffer that closes its segment or has to
+ * finish without O_DIRECT, as those need the writes before them done.
+ */
+static void
+sink_write_run(struct file_sink *sink, struct sink_buffer **run,
+	       unsigned count, uint64_t *written, uint64_t *errors)
+{
+	struct sink_buffer *buffer;
+	struct sink_segment *segment;
+	unsigned i;
+	int failed;
+
+	for (i = 0; i < count; i++) {
+		buffer = run[i];
+		segment = buffer->segment;
+
+		if (segment->fd < 0 && !segment->failed && buffer->len > 0)
+			sink_segment_open(sink, segment);
+
+		buffer->offset = segment->base + segment->written;
+		buffer->direct_len = buffer->len;
+		if (segment->direct)
+			buffer->direct_len &= ~(size_t)(FILE_SINK_ALIGN - 1);
+		if (segment->failed)
+			buffer->direct_len = 0;
+		segment->written += buffer->len;
+	}
+
+#ifdef HAVE_LIBURING
+	if (sink->use_uring)
+		failed = sink_submit_uring(sink, run, count);
+	else
+#endif
+		failed = sink_submit_sync(run, count);
+
+	for (i = 0; i < count; i++) {
+		buffer = run[i];
+		segment = buffer->segment;
+
+		if (segment->failed)
+			continue;
+
+		if (buffer->direct_len < buffer->len &&
+		    sink_write_tail(buffer) < 0)
+			failed++;
+
+		if (sink->options.fsync == FILE_SINK_FSYNC_BUFFER &&
+		    (i + 1 == count || run[i + 1]->segment != segment))
+			fdatasync(segment->fd);
+
+		*written += buffer->len;
+	}
+
+	if (failed) {
+		ERROR("Failed to write %d buffers to video output file: %m.\n",
+				failed);
+		*errors += failed;
+	}
+
+	buffer = run[count - 1];
+	if (buffer->close_segment)
+		sink_segment_close(sink, buffer->segment);
+}
+
+static void
+sink_write_batch(struct file_sink *sink, struct sink_buffer **batch,
+		 unsigned count, uint64_t *written, uint64_t *errors)
+{
+	unsigned start = 0, i;
+	struct sink_buffer *buffer;
+
+	for (i = 0; i < count; i++) {
+		buffer = batch[i];
+		if (buffer->close_segment || i + 1 == count ||
+		    (buffer->segment->direct &&
+		     buffer->len % FILE_SINK_ALIGN != 0)) {
+			sink_write_run(sink, batch + start, i + 1 - start,
+				       written, errors);
+			start = i + 1;
+		}
+	}
+}
+
+static void *
+sink_thread(void *data)
+{
+	struct file_sink *sink = data;
+	struct sink_buffer *batch[FILE_SINK_MAX_BUFFERS];
+	struct sink_buffer *buffer;
+	uint64_t written, errors;
+	unsigned count, i;
+
+	pthread_mutex_lock(&sink->lock);
+	for (;;) {
+		while (wl_list_empty(&sink->queue) && !sink->destroying)
+			pthread_cond_wait(&sink->queued_cond, &sink->lock);
+
+		if (wl_list_empty(&sink->queue))
+			break;
+
+		count = 0;
+		while (!wl_list_empty(&sink->queue)) {
+			buffer = wl_container_of(sink->queue.next, buffer, link);
+			wl_list_remove(&buffer->link);
+			batch[count++] = buffer;
+		}
+		pthread_mutex_unlock(&sink->lock);
+
+		written = 0;
+		errors = 0;
+		sink_write_batch(sink, batch, count, &written, &errors);
+
+		pthread_mutex_lock(&sink->lock);
+		sink->stats.bytes_written += written;
+		sink->stats.write_errors += errors;
+		for (i = 0; i < count; i++) {
+			batch[i]->len = 0;
+			batch[i]->segment = NULL;
+			batch[i]->close_segment = 0;
+			wl_list_insert(sink->free_list.prev, &batch[i]->link);
+		}
+		pthread_cond_signal(&sink->free_cond);
+	}
+	pthread_mutex_unlock(&sink->lock);
+
+	return NULL;
+}
+
+static struct sink_buffer *
+sink_get_buffer(struct file_sink *sink)
+{
+	struct sink_buffer *buffer;
+
+	pthread_mutex_lock(&sink->lock);
+	if (wl_list_empty(&sink->free_list)) {
+		sink->stats.buffer_waits++;
+		while (wl_list_empty(&sink->free_list))
+			pthread_cond_wait(&sink->free_cond, &sink->lock);
+	}
+	buffer = wl_container_of(sink->free_list.next, buffer, link);
+	wl_list_remove(&buffer->link);
+	pthread_mutex_unlock(&sink->lock);
+
+	return buffer;
+}
+
+static void
+sink_queue_current(struct file_sink *sink, int close_segment)
+{
+	struct sink_buffer *buffer = sink->current;
+
+	if (!buffer) {
+		if (!close_segment)
+			return;
+		buffer = sink_get_buffer(sink);
+	}
+
+	buffer->segment = sink->segment;
+	buffer->close_segment = close_segment;
+	sink->current = NULL;
+
+	pthread_mutex_lock(&sink->lock);
+	wl_list_insert(sink->queue.prev, &buffer->link);
+	pthread_cond_signal(&sink->queued_cond);
+	pthread_mutex_unlock(&sink->lock);
+}
+
+static int
+sink_start_segment(struct file_sink *sink, uint64_t now_ms)
+{
+	struct sink_segment *segment;
+	int len;
+
+	if (sink->segment) {
+		sink_queue_current(sink, 1);
+		sink->segment = NULL;
+	}
+
+	segment = calloc(1, sizeof *segment);
+	if (!segment)
+		return -1;
+
+	if (sink->options.segment_size || sink->options.segment_ms)
+		len = asprintf(&segment->path, "%s-%05u%s", sink->path_stem,
+			       sink->next_seq++, sink->path_ext);
+	else
+		len = asprintf(&segment->path, "%s%s", sink->path_stem,
+			       sink->path_ext);
+	if (len < 0) {
+		free(segment);
+		return -1;
+	}
+
+	segment->fd = -1;
+	segment->direct = sink->options.direct;
+	segment->start_ms = now_ms;
+	sink->segment = segment;
+
+	pthread_mutex_lock(&sink->lock);
+	sink->stats.segments++;
+	pthread_mutex_unlock(&sink->lock);
+
+	return 0;
+}
+
+static int
+sink_should_rotate(struct file_sink *sink, uint64_t now_ms)
+{
+	struct sink_segment *segment = sink->segment;
+
+	if (sink->options.segment_size &&
+	    segment->queued >= sink->options.segment_size)
+		return 1;
+
+	if (sink->options.segment_ms &&
+	    now_ms - segment->start_ms >= sink->options.segment_ms)
+		return 1;
+
+	return 0;
+}
+
+static void
+sink_add_keyframe(struct sink_segment *segment, size_t size,
+		  uint32_t timestamp)
+{
+	struct file_sink_index_entry *entry;
+	unsigned capacity;
+
+	if (segment->index_count == segment->index_capacity) {
+		capacity = segment->index_capacity ?
+			   segment->index_capacity * 2 : 64;
+		entry = realloc(segment->index, capacity * sizeof *entry);
+		if (!entry)
+			return;
+		segment->index = entry;
+		segment->index_capacity = capacity;
+	}
+
+	entry = &segment->index[segment->index_count++];
+	entry->offset = segment->queued;
+	entry->timestamp = timestamp;
+	entry->size = size;
+}
+
+/*
+ * Copies a frame into the sink. Blocks only if every buffer is still
+ * waiting to be written. Segments are rotated at keyframes.
+ */
+int
+file_sink_write(struct file_sink *sink, const void *data, size_t size,
+		uint32_t timestamp, int keyframe)
+{
+	const uint8_t *src = data;
+	uint64_t start = sink_now_ns();
+	uint64_t now_ms = start / NSEC_PER_MSEC;
+	uint64_t stall;
+	size_t len;
+
+	if (!sink->segment ||
+	    (keyframe && sink_should_rotate(sink, now_ms))) {
+		if (sink_start_segment(sink, now_ms) < 0) {
+			ERROR("Failed to start a new segment.\n");
+			return -1;
+		}
+	}
+
+	if (keyframe && sink->options.write_index)
+		sink_add_keyframe(sink->segment, size, timestamp);
+
+	while (size > 0) {
+		if (!sink->current)
+			sink->current = sink_get_buffer(sink);
+
+		len = sink->options.buffer_size - sink->current->len;
+		if (len > size)
+			len = size;
+
+		memcpy(sink->current->data + sink->current->len, src, len);
+		sink->current->len += len;
+		sink->segment->queued += len;
+		src += len;
+		size -= len;
+
+		if (sink->current->len == sink->options.buffer_size)
+			sink_queue_current(sink, 0);
+	}
+
+	if (sink->options.flush)
+		sink_queue_current(sink, 0);
+
+	stall = sink_now_ns() - start;
+
+	pthread_mutex_lock(&sink->lock);
+	sink->stats.frames++;
+	sink->stats.bytes_queued += src - (const uint8_t *)data;
+	sink->stats.stall_ns_total += stall;
+	if (stall > sink->stats.stall_ns_max)
+		sink->stats.stall_ns_max = stall;
+	pthread_mutex_unlock(&sink->lock);
+
+	return 0;
+}
+
+void
+file_sink_get_stats(struct file_sink *sink, struct file_sink_stats *stats)
+{
+	pthread_mutex_lock(&sink->lock);
+	*stats = sink->stats;
+	pthread_mutex_unlock(&sink->lock);
+}
+
+static int
+sink_split_path(struct file_sink *sink, const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	const char *dot = strrchr(slash ? slash : path, '.');
+
+	if (!dot || dot == path || dot == slash + 1)
+		dot = path + strlen(path);
+
+	sink->path_stem = strndup(path, dot - path);
+	sink->path_ext = strdup(dot);
+
+	return sink->path_stem && sink->path_ext ? 0 : -1;
+}
+
+static void
+sink_free(struct file_sink *sink)
+{
+	unsigned i;
+
+	for (i = 0; i < sink->num_buffers; i++)
+		free(sink->buffers[i].data);
+
+#ifdef HAVE_LIBURING
+	if (sink->use_uring)
+		io_uring_queue_exit(&sink->ring);
+#endif
+
+	free(sink->path_stem);
+	free(sink->path_ext);
+	free(sink);
+}
+
+struct file_sink *
+file_sink_create(const struct file_sink_options *options)
+{
+	struct file_sink *sink;
+	unsigned i;
+
+	sink = calloc(1, sizeof *sink);
+	if (!sink)
+		return NULL;
+
+	sink->options = *options;
+	sink->options.path = NULL;
+
+	if (!sink->options.buffer_size)
+		sink->options.buffer_size = FILE_SINK_DEFAULT_BUFFER_SIZE;
+	sink->options.buffer_size = (sink->options.buffer_size +
+				     FILE_SINK_ALIGN - 1) &
+				    ~(size_t)(FILE_SINK_ALIGN - 1);
+
+	sink->num_buffers = options->num_buffers;
+	if (!sink->num_buffers)
+		sink->num_buffers = FILE_SINK_DEFAULT_NUM_BUFFERS;
+	if (sink->num_buffers > FILE_SINK_MAX_BUFFERS)
+		sink->num_buffers = FILE_SINK_MAX_BUFFERS;
+
+	/* appending starts at an unaligned offset, and a per frame flush
+	 * writes partial blocks */
+	if (sink->options.append || sink->options.flush)
+		sink->options.direct = 0;
+
+	wl_list_init(&sink->free_list);
+	wl_list_init(&sink->queue);
+
+	for (i = 0; i < sink->num_buffers; i++) {
+		if (posix_memalign((void **)&sink->buffers[i].data,
+				   FILE_SINK_ALIGN,
+				   sink->options.buffer_size) != 0) {
+			sink->buffers[i].data = NULL;
+			goto err_free;
+		}
+		wl_list_insert(sink->free_list.prev, &sink->buffers[i].link);
+	}
+
+	if (sink_split_path(sink, options->path) < 0)
+		goto err_free;
+
+#ifdef HAVE_LIBURING
+	sink->use_uring = io_uring_queue_init(sink->num_buffers,
+					      &sink->ring, 0) == 0;
+	if (!sink->use_uring)
+		INFO("io_uring not available, writing with pwrite().\n");
+#endif
+	sink->stats.io_uring = sink->use_uring;
+	sink->stats.direct = sink->options.direct;
+
+	pthread_mutex_init(&sink->lock, NULL);
+	pthread_cond_init(&sink->queued_cond, NULL);
+	pthread_cond_init(&sink->free_cond, NULL);
+
+	if (pthread_create(&sink->thread, NULL, sink_thread, sink) != 0) {
+		pthread_cond_destroy(&sink->free_cond);
+		pthread_cond_destroy(&sink->queued_cond);
+		pthread_mutex_destroy(&sink->lock);
+		goto err_free;
+	}
+
+	return sink;
+
+err_free:
+	sink_free(sink);
+	return NULL;
+}
+
+/* Writes out everything still queued and closes the last segment. The
+ * final statistics are stored in stats, if given. */
+void
+file_sink_destroy(struct file_sink *sink, struct file_sink_stats *stats)
+{
+	if (sink->segment) {
+		sink_queue_current(sink, 1);
+		sink->segment = NULL;
+	}
+
+	pthread_mutex_lock(&sink->lock);
+	sink->destroying = 1;
+	pthread_cond_signal(&sink->queued_cond);
+	pthread_mutex_unlock(&sink->lock);
+
+	pthread_join(sink->thread, NULL);
+
+	if (stats)
+		*stats = sink->stats;
+
+	pthread_cond_destroy(&sink->free_cond);
+	pthread_cond_destroy(&sink->queued_cond);
+	pthread_mutex_destroy(&sink->lock);
+	sink_free(sink);
+}
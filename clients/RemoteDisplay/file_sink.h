@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Asynchronous sink for the file transport plugin.
+ *
+ * Frames are copied into a small set of preallocated, block aligned
+ * buffers on the caller's thread; a writer thread owns the files and
+ * writes full buffers out, through io_uring when it is available and
+ * with pwrite() otherwise. The encoder only waits when all buffers are
+ * queued, and that time is accounted as stall time.
+ *
+ * The stream can be split into segment files by size or by time. A new
+ * segment is only started at a keyframe, so every segment can be decoded
+ * on its own. Each segment can get an index of its keyframes, see
+ * struct file_sink_index_entry.
+ */
+
+#ifndef _FILE_SINK_H
+#define _FILE_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum file_sink_fsync {
+	FILE_SINK_FSYNC_NONE,
+	FILE_SINK_FSYNC_SEGMENT,	/* when a segment is closed */
+	FILE_SINK_FSYNC_BUFFER,		/* after every buffer written */
+};
+
+struct file_sink_options {
+	/* "dir/name.ext"; segments are named "dir/name-00000.ext" */
+	const char *path;
+	int append;
+	/* O_DIRECT, dropped where the file system refuses it */
+	int direct;
+	/* every frame is handed to the writer right away */
+	int flush;
+	enum file_sink_fsync fsync;
+	int write_index;
+
+	/* 0 disables the respective rotation */
+	uint64_t segment_size;
+	uint32_t segment_ms;
+
+	size_t buffer_size;
+	unsigned num_buffers;
+};
+
+#define FILE_SINK_INDEX_MAGIC 0x58494452 /* "RDIX" */
+#define FILE_SINK_INDEX_VERSION 1
+
+/*
+ * "<segment>.idx" starts with a struct file_sink_index_header followed by
+ * one entry per keyframe, in stream order. Offsets are from the start of
+ * the segment file.
+ */
+struct file_sink_index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+struct file_sink_index_entry {
+	uint64_t offset;
+	uint32_t timestamp;
+	uint32_t size;
+};
+
+struct file_sink_stats {
+	uint64_t frames;
+	uint64_t bytes_queued;
+	uint64_t bytes_written;
+	uint64_t segments;
+	uint64_t write_errors;
+
+	/* time spent in file_sink_write() */
+	uint64_t stall_ns_total;
+	uint64_t stall_ns_max;
+	/* writes that had to wait for a free buffer */
+	uint64_t buffer_waits;
+
+	int io_uring;
+	int direct;
+};
+
+struct file_sink;
+
+struct file_sink *
+file_sink_create(const struct file_sink_options *options);
+
+int
+file_sink_write(struct file_sink *sink, const void *data, size_t size,
+		uint32_t timestamp, int keyframe);
+
+void
+file_sink_get_stats(struct file_sink *sink, struct file_sink_stats *stats);
+
+void
+file_sink_destroy(struct file_sink *sink, struct file_sink_stats *stats);
+
+#endif /* _FILE_SINK_H */
@@ -26,7 +26,8 @@
  * This file contains a transport plugin for the remote display wayland
  * client. This plugin simply captures the stream of H264 frames to either
  * a single file or a file per frame, according to the options selected
- * by the user.
+ * by the user. The single file can also be split into segments, see
+ * file_sink.h.
  */
 #include <stdio.h>
 #include <wayland-util.h>
@@ -40,8 +41,10 @@
 
 #include <libweston/config-parser.h>
 #include "../shared/helpers.h"
+#include "../shared/annexb.h"
 
 #include "transport_plugin.h"
+#include "file_sink.h"
 #include "debug.h"
 
 int debug_level = DBG_OFF;
@@ -54,9 +57,15 @@ struct private_data {
 	int verbose;
 	int to_file;
 	int dump_frames;
-	FILE *fp;
+	struct file_sink *sink;
 	int file_flush;
 	int file_mode;
+	int file_direct;
+	int file_fsync;
+	int file_index;
+	uint32_t segment_size;
+	uint32_t segment_time;
+	struct annexb_index nal_index;
 	char *file_path;
 	char *frame_path;
 	uint32_t benchmark_time, frames, total_stream_size;
@@ -75,6 +84,7 @@ WL_EXPORT int init(int *argc, char **argv, int verbose)
 	if (!private_data) {
 		return(-ENOMEM);
 	}
+	annexb_index_init(&private_data->nal_index);
 
 	INFO("Using file remote display transport plugin...\n");
 
@@ -83,6 +93,11 @@ WL_EXPORT int init(int *argc, char **argv, int verbose)
 		{ WESTON_OPTION_INTEGER, "file", 0, &private_data->to_file},
 		{ WESTON_OPTION_INTEGER, "file_mode", 0, &private_data->file_mode},
 		{ WESTON_OPTION_INTEGER, "file_flush", 0, &private_data->file_flush},
+		{ WESTON_OPTION_INTEGER, "file_direct", 0, &private_data->file_direct},
+		{ WESTON_OPTION_INTEGER, "file_fsync", 0, &private_data->file_fsync},
+		{ WESTON_OPTION_INTEGER, "file_index", 0, &private_data->file_index},
+		{ WESTON_OPTION_UNSIGNED_INTEGER, "segment_size", 0, &private_data->segment_size},
+		{ WESTON_OPTION_UNSIGNED_INTEGER, "segment_time", 0, &private_data->segment_time},
 		{ WESTON_OPTION_STRING,  "frame_path", 0, &private_data->frame_path},
 		{ WESTON_OPTION_INTEGER, "frame_files", 0, &private_data->dump_frames},
 		{ WESTON_OPTION_UNSIGNED_INTEGER, "max_frames", 0, &private_data->max_frames},
@@ -100,6 +115,12 @@ WL_EXPORT void help(void)
 	PRINT("\t--file=1\t\t\tappend video frames to <file_path>\n");
 	PRINT("\t--file_flush=<0/1>\t\tflush after each frame\n");
 	PRINT("\t--file_mode=<mode>\t\tfile mode: 0: rewrite 1: append\n");
+	PRINT("\t--file_direct=<0/1>\t\twrite with O_DIRECT where the file system allows it\n");
+	PRINT("\t--file_fsync=<policy>\t\tfsync policy: 0: never 1: per segment 2: per buffer\n");
+	PRINT("\t--segment_size=<MiB>\t\tstart a new file at the next keyframe after <MiB>\n");
+	PRINT("\t--segment_time=<seconds>\tstart a new file at the next keyframe after <seconds>\n");
+	PRINT("\t--file_index=<0/1>\t\twrite a keyframe index next to each file,"
+			" on by default with segments\n");
 	PRINT("\t--frame_path=<frame_path>\tset path to a folder for capture of frames into separate files\n");
 	PRINT("\t--frame_files=1\t\t\tdump each frame to a separate numbered file in <frame_path>\n");
 	PRINT("\t--max_frames=<max frames>\tStop recording after <max frames>\n");
@@ -128,6 +149,16 @@ WL_EXPORT int send_frame(drm_intel_bo *drm_bo, int32_t stream_size, uint32_t tim
 					BENCHMARK_INTERVAL,
 					(float) private_data->frames / BENCHMARK_INTERVAL,
 					TO_Mb((float)(private_data->total_stream_size / BENCHMARK_INTERVAL)));
+			if (private_data->sink) {
+				struct file_sink_stats stats;
+
+				file_sink_get_stats(private_data->sink, &stats);
+				INFO("file sink: %.1f us max stall, %llu buffer waits,"
+						" %llu write errors\n",
+						stats.stall_ns_max / 1000.0,
+						(unsigned long long)stats.buffer_waits,
+						(unsigned long long)stats.write_errors);
+			}
 			private_data->benchmark_time = time;
 			private_data->frames = 0;
 			private_data->total_stream_size = 0;
@@ -137,10 +168,13 @@ WL_EXPORT int send_frame(drm_intel_bo *drm_bo, int32_t stream_size, uint32_t tim
 	}
 
 	if (private_data->to_file) {
-		int count;
 		char filepath[PATH_MAX] = {0};
 		char last_char;
-		if (!private_data->fp) {
+		int keyframe = 0;
+
+		if (!private_data->sink) {
+			struct file_sink_options options = {0};
+
 			DBG("Processing frame in file plugin...\n");
 
 			if ((private_data->file_path == 0) || (private_data->file_path[0] == 0)) {
@@ -161,25 +195,37 @@ WL_EXPORT int send_frame(drm_intel_bo *drm_bo, int32_t stream_size, uint32_t tim
 
 				strncat(filepath, "capture.mp4", max_write);
 			}
-			private_data->fp = fopen(filepath, private_data->file_mode?"ab":"wb");
-			if (!private_data->fp) {
-				int err = errno;
-				ERROR("Failed to open video output file: %s.\n", filepath);
-				return err;
+
+			options.path = filepath;
+			options.append = private_data->file_mode;
+			options.direct = private_data->file_direct;
+			options.flush = private_data->file_flush;
+			options.fsync = private_data->file_fsync;
+			options.segment_size = (uint64_t)private_data->segment_size << 20;
+			options.segment_ms = private_data->segment_time * 1000;
+			options.write_index = private_data->file_index ||
+				private_data->segment_size || private_data->segment_time;
+
+			private_data->sink = file_sink_create(&options);
+			if (!private_data->sink) {
+				ERROR("Failed to create video output sink: %s.\n", filepath);
+				return (-ENOMEM);
 			}
-			INFO("Writing to %s (mode:%s / flush:%s)\n",
-					filepath,
-					private_data->file_mode?"ab":"wb",
-					private_data->file_flush?"on":"off");
 		}
 
-		count = fwrite(drm_bo->virtual, 1, stream_size, private_data->fp);
-		if (count != stream_size) {
-			ERROR("dumping frame to file. Tried to write "
-					"%d bytes, %d bytes actually written.\n", stream_size, count);
+		/* Keyframes are only needed to rotate and index segments. */
+		if (private_data->segment_size || private_data->segment_time ||
+				private_data->file_index) {
+			annexb_index_frame(&private_data->nal_index,
+					drm_bo->virtual, stream_size);
+			keyframe = !!(private_data->nal_index.flags &
+					(ANNEXB_FRAME_SPS | ANNEXB_FRAME_IDR));
 		}
-		if (private_data->file_flush) {
-			fflush(private_data->fp);
+
+		if (file_sink_write(private_data->sink, drm_bo->virtual,
+					stream_size, timestamp, keyframe) < 0) {
+			ERROR("dumping frame to file. Failed to queue "
+					"%d bytes.\n", stream_size);
 		}
 	}
 
@@ -222,11 +268,23 @@ WL_EXPORT int send_frame(drm_intel_bo *drm_bo, int32_t stream_size, uint32_t tim
 
 WL_EXPORT void destroy()
 {
+	struct file_sink_stats stats;
+
 	if (private_data) {
 		DBG("Freeing file plugin private data...\n");
 	}
-	if (private_data->fp) {
-		fclose(private_data->fp);
+	if (private_data->sink) {
+		file_sink_destroy(private_data->sink, &stats);
+		INFO("Wrote %llu frames, %llu bytes in %llu files (%s%s), "
+				"%.1f us average stall.\n",
+				(unsigned long long)stats.frames,
+				(unsigned long long)stats.bytes_written,
+				(unsigned long long)stats.segments,
+				stats.io_uring ? "io_uring" : "pwrite",
+				stats.direct ? ", O_DIRECT" : "",
+				stats.frames ?
+				stats.stall_ns_total / 1000.0 / stats.frames : 0.0);
 	}
+	annexb_index_release(&private_data->nal_index);
 	free(private_data);
 }
@@ -39,6 +39,7 @@
 
 #include <libweston/config-parser.h>
 #include "../shared/helpers.h"
+#include "../shared/annexb.h"
 #include "transport_plugin.h"
 #include "udp_socket.h"
 #include "debug.h"
@@ -53,8 +54,6 @@ int debug_level = DBG_OFF;
 #define NAL_HEADER_SIZE 1
 #define FU_HEADER_SIZE 1
 #define FU_INDICATOR_SIZE 1
-#define NAL_MARKER_SIZE 3
-#define SPS_PPS_MARKER_SIZE 4
 #define NRI_MASK 0x60
 #define NAL_TYPE_MASK 0x1F
 #define FU_A_TYPE 28
@@ -75,6 +74,7 @@ struct private_data {
 	uint32_t benchmark_time, frames, total_stream_size;
 	char *fifo_name;
 	int fifo_handle;
+	struct annexb_index nal_index;
 };
 
 struct private_data *private_data = NULL;
@@ -162,6 +162,7 @@ WL_EXPORT int init(int *argc, char **argv, int verbose)
 	if (!private_data) {
 		return(-ENOMEM);
 	}
+	annexb_index_init(&private_data->nal_index);
 
 	INFO("Using UDP remote display transport plugin...\n");
 
@@ -385,29 +386,91 @@ send_packet(uint8_t *payload, size_t size, uint32_t timestamp,
 	return 0;
 }
 
-static int
-get_ps_write_size(uint8_t *readptr)
+/* Sends one NAL unit, in a single packet if it fits and split into FU-A
+ * fragments otherwise. The marker bit goes on the last packet of the
+ * frame. */
+static void
+send_nal(uint8_t *base, uint8_t *nal, int32_t size, uint32_t timestamp,
+		int last_nal, int *num_packets)
 {
-	int i = 0;
-	int found_end = 0;
-
-	while (!found_end) {
-		if (readptr[i] == 0x00) {
-			if (readptr[i+1] == 0x00) {
-				if (readptr[i+2] == 0x00) {
-					if (readptr[i+3] == 0x01) {
-						found_end = 1;
-						continue;
-					}
-				} else if (readptr[i+2] == 0x01) {
-					found_end = 1;
-					continue;
-				}
-			}
+	uint8_t rtp_buffer[RTP_BUFFER_SIZE];
+	uint8_t *rtp_payload = &rtp_buffer[RTP_HEADER_SIZE];
+	/* Allow for FU indicator size and FU header size */
+	const int step = RTP_PAYLOAD_SIZE - FU_HEADER_SIZE - FU_INDICATOR_SIZE;
+	uint8_t nal_header = nal[0];
+	uint8_t *readptr, *fu_start;
+	int32_t bytes_left, len;
+	int start = 1, end = 0;
+	int err;
+
+	/* We avoid doing a memcpy where possible, writing the headers to the
+	 * mapped buffer instead. (This trashes the bytes in front of the
+	 * payload, but they belong to data that has already been sent.) */
+	if (size <= RTP_PAYLOAD_SIZE) {
+		if (private_data->debug_packetisation) {
+			PRINT("Small packet, only writing %d bytes.\n", size);
+		}
+		(*num_packets)++;
+		if (nal - base >= RTP_HEADER_SIZE) {
+			err = send_packet(nal, size, timestamp, last_nal,
+					private_data);
+		} else {
+			memcpy(rtp_payload, nal, size);
+			err = send_packet(rtp_payload, size, timestamp, last_nal,
+					private_data);
+		}
+		if (err) {
+			WARN("Sending small packet returned %d.\n", err);
+		}
+		return;
+	}
+
+	/* NAL packetisation into Fragmentation Units (FUs)...
+	 * Skip the NAL header because the info is already in the FU
+	 * indicator and header. */
+	readptr = nal + NAL_HEADER_SIZE;
+	bytes_left = size - NAL_HEADER_SIZE;
+
+	while (bytes_left > 0) {
+		len = bytes_left > step ? step : bytes_left;
+		end = len == bytes_left;
+
+		if (readptr - base >=
+				RTP_HEADER_SIZE + FU_HEADER_SIZE + FU_INDICATOR_SIZE) {
+			fu_start = readptr - FU_HEADER_SIZE - FU_INDICATOR_SIZE;
+		} else {
+			fu_start = rtp_payload;
+			memcpy(fu_start + FU_HEADER_SIZE + FU_INDICATOR_SIZE,
+				readptr, len);
+		}
+
+		/* FU indicator - as per section 5.8 of rfc6184. */
+		fu_start[0] = (nal_header & NRI_MASK) | FU_A_TYPE;
+
+		/* FU header - as per section 5.8 of rfc6184. */
+		fu_start[1] = (start << 7) | (end << 6) |
+			(nal_header & NAL_TYPE_MASK);
+
+		if (private_data->debug_packetisation) {
+			PRINT("%s FU. Indicator 0x%x Header 0x%x, size: %d\n",
+				start ? "First" : (end ? "Last" : "Middle"),
+				/* Sometimes fprintf tries to interpret
+				 * these as 64-bit ints. The 0xFF & fixes that. */
+				0xFF & fu_start[0], 0xFF & fu_start[1], len);
+		}
+
+		(*num_packets)++;
+		err = send_packet(fu_start,
+				len + FU_HEADER_SIZE + FU_INDICATOR_SIZE,
+				timestamp, last_nal && end, private_data);
+		if (err) {
+			WARN("Sending FU packet returned %d.\n", err);
 		}
-		i++;
+
+		readptr += len;
+		bytes_left -= len;
+		start = 0;
 	}
-	return i;
 }
 
 static int send_frame_gst(drm_intel_bo *drm_bo, int32_t stream_size, uint32_t timestamp)
@@ -448,22 +511,11 @@ error:
 
 static int send_frame_native(drm_intel_bo *drm_bo, int32_t stream_size, uint32_t timestamp)
 {
+	uint8_t *base = drm_bo->virtual;
+	struct annexb_index *index;
+	struct annexb_nal *nal;
 	int num_packets = 0;
-	int bytes_written = 0;
-	uint16_t count = 0;
-	uint8_t rtp_buffer[RTP_BUFFER_SIZE];
-	uint8_t *rtp_payload = &rtp_buffer[RTP_HEADER_SIZE];
-	uint8_t *fu_start;
-	uint8_t *readptr = drm_bo->virtual;
-	int32_t write_size = stream_size;
-	uint8_t nal_header = 0;
-	int start = 1, end = 0;
-	/* Allow for FU indicator size and FU header size */
-	const int step = RTP_PAYLOAD_SIZE - FU_HEADER_SIZE - FU_INDICATOR_SIZE;
-	int spspps = 0;
-	uint8_t *bufdata;
-	volatile sig_atomic_t send_packages;
-	int err = 0;
+	unsigned n;
 	int i;
 
 	if (!private_data) {
@@ -473,213 +525,35 @@ static int send_frame_native(drm_intel_bo *drm_bo, int32_t stream_size, uint32_t
 
 	VERBOSE("Sending frame over UDP...\n");
 
-	/* SPS and PPS are preceded by the bytes 00 00 00 01 (in our case).
-	 * 00 00 01 means we have an ordinary NAL unit containing an h264
-	 * encoded frame. This may well be different and more nuanced with
-	 * other implementations. */
-	bufdata = ((uint8_t *)(drm_bo->virtual));
-	if (bufdata[0] == 0x00) {
-		if (bufdata[1] == 0x00) {
-			if (bufdata[2] == 0x00) {
-				if (bufdata[3] == 0x01) {
-					/* SPS or PPS */
-					if (private_data->debug_packetisation) {
-						PRINT("SPS or PPS frame\n");
-					}
-					spspps = 1;
-				} else {
-					ERROR("Invalid start of stream.\n");
-					return 1;
-				}
-			} else if (bufdata[2] == 0x01) {
-				/* Ordinary NAL unit containing an h264 encoded frame */
-				if (private_data->debug_packetisation) {
-					PRINT("00 00 01 - start of frame?\n");
-				}
-			} else {
-				ERROR("Invalid frame.\n");
-				return 1;
-			}
-		}
+	/* Frames are an optional SPS and PPS followed by the slices, each
+	 * behind a 00 00 00 01 or 00 00 01 start code. They are split up in
+	 * a single pass before sending, as the packets below overwrite the
+	 * data in front of each payload. */
+	index = &private_data->nal_index;
+	if (annexb_index_frame(index, base, stream_size) < 0) {
+		ERROR("Failed to index frame.\n");
+		return -1;
 	}
 
-	send_packages = 1;
-	while (send_packages){
-		num_packets++;
-		if (spspps == 1) {
-			int32_t sps_size, pps_size;
-			/* Skip 00 00 00 01 */
-			readptr += SPS_PPS_MARKER_SIZE;
-			sps_size = get_ps_write_size(readptr);
-
-			/* Send SPS... */
-			memcpy(rtp_payload, readptr, sps_size);
-			err = send_packet(rtp_payload, sps_size, timestamp, 1,
-					private_data);
-			bytes_written += sps_size;
-			if (err) {
-				WARN("Sending SPS packet returned %d.\n",
-						err);
-				err = 0;
-			}
-
-			/* Advance readptr by SPS + second 00 00 00 01 marker... */
-			readptr += sps_size + SPS_PPS_MARKER_SIZE;
-			pps_size = get_ps_write_size(readptr);
-
-			if (private_data->debug_packetisation) {
-				PRINT("Skipping second 00 00 00 01 marker and writing"
-				   " %d bytes + 12 byte header\n", pps_size);
-				nal_header = readptr[0];
-				PRINT("PPS - nal_type = 0x%x\n",
-					nal_header & NAL_TYPE_MASK);
-			}
+	if (index->count == 0 || index->leading) {
+		ERROR("Invalid start of stream.\n");
+		return 1;
+	}
 
-			/* Send PPS... */
-			/* We avoid doing a memcpy where possible, writing
-			 * the headers to the mapped buffer instead. (This
-			 * trashes the previous 12 bytes in the buffer, but we
-			 * don't need to worry about that.) */
-			if (bytes_written >= RTP_HEADER_SIZE) {
-				err = send_packet(readptr, pps_size, timestamp,
-					1, private_data);
-			} else {
-				memcpy(rtp_payload, readptr, pps_size);
-				err = send_packet(rtp_payload, pps_size, timestamp, 1,
-						private_data);
-			}
-			bytes_written += pps_size;
-			if (err) {
-				WARN("Sending PPS packet returned %d.\n",
-						err);
-				err = 0;
-			}
+	if (private_data->debug_packetisation) {
+		PRINT("%u NAL units%s\n", index->count,
+			(index->flags & ANNEXB_FRAME_SPS) ? ", SPS and PPS" : "");
+	}
 
-			/* There will be a NAL unit in buffer after SPS and PPS. */
-			readptr += pps_size;
-			write_size = stream_size -
-				(sps_size + pps_size + 2 * SPS_PPS_MARKER_SIZE);
-			spspps = 0;
-		}
+	for (n = 0; n < index->count; n++) {
+		nal = &index->nals[n];
 
-		if (start == 1) {
-			/* Skip 00 00 01 marker before NAL unit starts... */
-			readptr += NAL_MARKER_SIZE;
-			write_size -= NAL_MARKER_SIZE;
-			nal_header = readptr[0];
-			if (private_data->debug_packetisation) {
-				PRINT("Skipped 00 00 01 marker.\n");
-				PRINT("nal_type = 0x%x\n",
-					nal_header & NAL_TYPE_MASK);
-			}
+		if (private_data->debug_packetisation) {
+			PRINT("nal_type = 0x%x, %zu bytes\n", nal->type, nal->size);
 		}
 
-		/* NAL packetisation into Fragmentation Units (FUs)...*/
-		if (RTP_PAYLOAD_SIZE >= write_size) {
-			/* Stream is smaller than a packet, no FUs. */
-			if (private_data->debug_packetisation) {
-				PRINT("Small packet, only writing %d bytes.\n", write_size);
-			}
-			if (bytes_written >= RTP_HEADER_SIZE) {
-				err = send_packet(readptr, write_size, timestamp,
-					1, private_data);
-			} else {
-				memcpy(rtp_payload, readptr, write_size);
-				err = send_packet(rtp_payload, write_size, timestamp, 1,
-						private_data);
-			}
-			bytes_written += write_size;
-			if (err) {
-				WARN("Sending small packet returned %d.\n",
-						err);
-				err = 0;
-			}
-			send_packages = 0;
-		} else if (step * count < write_size) {
-			count++;
-
-			/* FU indicator - as per section 5.8 of rfc6184. */
-			*rtp_payload = (nal_header & NRI_MASK) | FU_A_TYPE;
-
-			/* FU header - as per section 5.8 of rfc6184. */
-			*(rtp_payload + 1) = (start << 7) | (end << 6) |
-				(nal_header & NAL_TYPE_MASK);
-
-			if (private_data->debug_packetisation) {
-				PRINT("%s FU. Indicator 0x%x Header 0x%x\n",
-					start ? "First" : "Middle",
-					/* Sometimes fprintf tries to interpret
-					 * these as 64-bit ints. The 0xFF & fixes that. */
-					0xFF & *rtp_payload, 0xFF & *(rtp_payload + 1));
-			}
-
-			if (start) {
-				/* Skip the NAL header because the info is
-				 * already in the FU indicator and header. */
-				readptr += NAL_HEADER_SIZE;
-				start = 0;
-			}
-
-			if (bytes_written >= RTP_HEADER_SIZE) {
-				/* We have the marker bits free as well as the header size. */
-				fu_start = readptr - FU_HEADER_SIZE - FU_INDICATOR_SIZE;
-				fu_start[0] = *rtp_payload;
-				fu_start[1] = *(rtp_payload + 1);
-				err = send_packet(fu_start, RTP_PAYLOAD_SIZE,
-					timestamp, 0, private_data);
-			} else {
-				memcpy(rtp_payload + FU_HEADER_SIZE + FU_INDICATOR_SIZE,
-					readptr, step);
-				err = send_packet(rtp_payload, RTP_PAYLOAD_SIZE,
-					timestamp, 0, private_data);
-			}
-			bytes_written += step;
-			if (err) {
-				WARN("Sending FU packet returned %d.\n",
-						err);
-				err = 0;
-			}
-
-			readptr += step;
-		} else {
-			/* Last FU... */
-			int bytes_left = write_size - (step*(count-1)) - NAL_HEADER_SIZE;
-
-			end = 1;
-			*rtp_payload = (nal_header & NRI_MASK) | FU_A_TYPE;
-			*(rtp_payload + 1) = (start << 7) | (end << 6) |
-						(nal_header & NAL_TYPE_MASK);
-
-			if (private_data->debug_packetisation) {
-				PRINT("Last FU. Indicator: 0x%x, Header: 0x%x, size: %d\n",
-					*rtp_payload, *(rtp_payload + 1), bytes_left);
-			}
-
-			if (bytes_written >= RTP_HEADER_SIZE) {
-				/* We have the marker bits free as well as the header size. */
-				fu_start = readptr - FU_HEADER_SIZE - FU_INDICATOR_SIZE;
-				fu_start[0] = *rtp_payload;
-				fu_start[1] = *(rtp_payload + 1);
-				err = send_packet(fu_start, bytes_left
-					+ FU_HEADER_SIZE + FU_INDICATOR_SIZE,
-					timestamp, 1, private_data);
-			} else {
-				memcpy(rtp_payload + FU_HEADER_SIZE
-					+ FU_INDICATOR_SIZE,
-					readptr, bytes_left);
-				err = send_packet(rtp_payload, bytes_left
-					+ FU_HEADER_SIZE + FU_INDICATOR_SIZE,
-					timestamp, 1, private_data);
-			}
-			bytes_written += bytes_left;
-			if (err) {
-				WARN("Sending final packet returned %d.\n",
-						err);
-				err = 0;
-			}
-
-			send_packages = 0;
-		}
+		send_nal(base, base + nal->offset, nal->size, timestamp,
+				n == index->count - 1, &num_packets);
 	}
 
 	for(i = 0; i < private_data->num_addr; i++) {
@@ -828,5 +702,6 @@ WL_EXPORT void destroy()
 		unlink(private_data->fifo_name);
 		free(private_data->fifo_name);
 	}
+	annexb_index_release(&private_data->nal_index);
 	free(private_data);
 }
@@ -39,6 +39,7 @@
 #include <wayland-cursor.h>
 #include <wayland-client-protocol.h>
 #include "shared/cairo-util.h"
+#include "shared/image-loader.h"
 #include <libweston/config-parser.h>
 #include "shared/helpers.h"
 #include "shared/os-compatibility.h"
@@ -112,6 +113,10 @@ struct wlContextCommon {
 	struct wl_surface		*pointer_surface;
 	enum   cursor_type		current_cursor;
 	uint32_t			enter_serial;
+	/* decoded up front by preload_images() */
+	const char			**image_files;
+	cairo_surface_t			**images;
+	int				image_count;
 };
 
 struct wlContextStruct {
@@ -930,12 +935,92 @@ create_ivisurface(struct wlContextStruct *p_wlCtx,
 	drawImage(p_wlCtx);
 }
 
+static void
+preload_add(struct wlContextCommon *cmm, const char *imageFile)
+{
+	int i;
+
+	if (!imageFile)
+		return;
+
+	for (i = 0; i < cmm->image_count; i++) {
+		if (strcmp(cmm->image_files[i], imageFile) == 0)
+			return;
+	}
+
+	cmm->image_files[cmm->image_count++] = imageFile;
+}
+
+/**
+ * Internal method to decode every image file of the UI in parallel,
+ * each file once, before the surfaces showing them are created
+ */
+static void
+preload_images(struct wlContextCommon *cmm)
+{
+	struct hmi_homescreen_setting *hmi_setting = cmm->hmi_setting;
+	struct hmi_homescreen_launcher *launcher;
+	int max = 7 + wl_list_length(&hmi_setting->launcher_list);
+
+	cmm->image_files = xzalloc(max * sizeof(*cmm->image_files));
+	cmm->images = xzalloc(max * sizeof(*cmm->images));
+
+	preload_add(cmm, hmi_setting->background.filePath);
+	preload_add(cmm, hmi_setting->panel.filePath);
+	preload_add(cmm, hmi_setting->tiling.filePath);
+	preload_add(cmm, hmi_setting->sidebyside.filePath);
+	preload_add(cmm, hmi_setting->fullscreen.filePath);
+	preload_add(cmm, hmi_setting->random.filePath);
+	preload_add(cmm, hmi_setting->home.filePath);
+
+	wl_list_for_each(launcher, &hmi_setting->launcher_list, link)
+		preload_add(cmm, launcher->icon);
+
+	load_cairo_surfaces(cmm->image_files, cmm->image_count, cmm->images,
+			    IMAGE_LOAD_CACHE);
+}
+
+static void
+release_preloaded_images(struct wlContextCommon *cmm)
+{
+	int i;
+
+	for (i = 0; i < cmm->image_count; i++) {
+		if (cmm->images[i])
+			cairo_surface_destroy(cmm->images[i]);
+	}
+
+	free(cmm->image_files);
+	free(cmm->images);
+	cmm->image_files = NULL;
+	cmm->images = NULL;
+	cmm->image_count = 0;
+}
+
+static cairo_surface_t *
+get_image(struct wlContextCommon *cmm, const char *imageFile)
+{
+	int i;
+
+	for (i = 0; imageFile && i < cmm->image_count; i++) {
+		if (strcmp(cmm->image_files[i], imageFile) != 0)
+			continue;
+
+		if (!cmm->images[i])
+			return NULL;
+
+		return cairo_surface_reference(cmm->images[i]);
+	}
+
+	return load_cairo_surface(imageFile);
+}
+
 static void
 create_ivisurfaceFromFile(struct wlContextStruct *p_wlCtx,
 			  uint32_t id_surface,
 			  const char *imageFile)
 {
-	cairo_surface_t *surface = load_cairo_surface(imageFile);
+	cairo_surface_t *surface = get_image(p_wlCtx->cmm, imageFile);
 
 	if (NULL == surface) {
 		fprintf(stderr, "Failed to load_cairo_surface %s\n", imageFile);
@@ -1286,6 +1371,8 @@ int main(int argc, char **argv)
 	wlCtx_HomeButton.cmm = &wlCtxCommon;
 	wlCtx_WorkSpaceBackGround.cmm = &wlCtxCommon;
 
+	preload_images(&wlCtxCommon);
+
 	/* create desktop widgets */
 	for (i = 0; i < hmi_setting->screen_num; i++) {
 		wlCtx_BackGround[i].cmm = &wlCtxCommon;
@@ -1320,6 +1407,8 @@ int main(int argc, char **argv)
 	create_home_button(&wlCtx_HomeButton, hmi_setting->home.id,
 			   hmi_setting->home.filePath);
 
+	release_preloaded_images(&wlCtxCommon);
+
 	UI_ready(wlCtxCommon.hmiCtrl);
 
 	while (ret != -1)
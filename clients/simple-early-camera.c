@@ -0,0 +1,1110 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Reverse camera style viewer: shows the newest frame of a V4L2 capture
+ * device fullscreen and checks every frame against a capture-to-present
+ * deadline.
+ *
+ * Frames go to the compositor as dmabufs exported from the capture
+ * buffers when it supports zwp_linux_dmabuf_v1, and are copied into
+ * wl_shm buffers otherwise, so it also runs on the pixman renderer and
+ * the headless backend. Latency is measured from the driver's capture
+ * timestamp to the wp_presentation time, or to the frame callback when
+ * the compositor has no presentation-time support.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+
+#include <drm_fourcc.h>
+#include <linux/videodev2.h>
+
+#include <wayland-client.h>
+#include <libweston/config-parser.h>
+#include <libweston/zalloc.h>
+#include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+#include "shared/timespec-util.h"
+#include "shared/v4l2-capture.h"
+#include "xdg-shell-client-protocol.h"
+#include "ias-shell-client-protocol.h"
+#include "fullscreen-shell-unstable-v1-client-protocol.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+#include "presentation-time-client-protocol.h"
+
+#ifndef DRM_FORMAT_MOD_LINEAR
+#define DRM_FORMAT_MOD_LINEAR 0
+#endif
+
+#define SHM_BUFFERS 3
+
+struct display {
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+	struct ias_shell *ias_shell;
+	struct zwp_fullscreen_shell_v1 *fshell;
+	struct zwp_linux_dmabuf_v1 *dmabuf;
+	struct wp_presentation *presentation;
+	clockid_t clk_id;
+};
+
+struct buffer {
+	struct window *window;
+	struct wl_buffer *buffer;
+	bool busy;
+
+	/* dmabuf: the capture buffer it wraps, while on screen */
+	struct v4l2_capture_buffer *capture;
+	/* shm */
+	void *data;
+	size_t size;
+};
+
+struct feedback {
+	struct window *window;
+	struct wp_presentation_feedback *feedback;
+	struct timespec capture;
+	uint32_t sequence;
+	struct wl_list link;
+};
+
+struct window {
+	struct display *display;
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+	struct ias_surface *shell_surface;
+	struct wl_callback *callback;
+	bool wait_for_configure;
+
+	struct v4l2_capture capture;
+	uint32_t drm_format;
+	uint32_t shm_format;
+	struct buffer buffers[V4L2_CAPTURE_MAX_BUFFERS];
+	unsigned num_buffers;
+	/* newest frame waiting for the previous one to be shown */
+	struct v4l2_capture_buffer *pending;
+	/* capture time of the last frame committed */
+	struct timespec shown;
+
+	struct capture_watchdog watchdog;
+	int timer_fd;
+	struct timespec last_report;
+	uint64_t reported_missed;
+	struct wl_list feedback_list;
+};
+
+static bool running = true;
+
+static uint32_t
+parse_format(const char *fmt)
+{
+	if (strlen(fmt) != 4)
+		return 0;
+
+	return fourcc_code(fmt[0], fmt[1], fmt[2], fmt[3]);
+}
+
+static double
+to_ms(int64_t ns)
+{
+	return ns / 1000000.0;
+}
+
+/* Capture formats the copy path can hand to wl_shm unconverted. */
+static uint32_t
+shm_format_for(uint32_t pixelformat)
+{
+	switch (pixelformat) {
+	case V4L2_PIX_FMT_XBGR32:
+	case V4L2_PIX_FMT_BGR32:
+		return WL_SHM_FORMAT_XRGB8888;
+	case V4L2_PIX_FMT_ABGR32:
+		return WL_SHM_FORMAT_ARGB8888;
+	default:
+		return UINT32_MAX;
+	}
+}
+
+static void
+report_deadline_miss(struct window *window, uint32_t sequence)
+{
+	struct capture_watchdog *wd = &window->watchdog;
+	struct timespec now;
+
+	/* a late stream misses every frame; once a second is plenty */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (window->reported_missed > 0 &&
+	    timespec_sub_to_msec(&now, &window->last_report) < 1000)
+		return;
+
+	fprintf(stderr, "early-camera: frame %u took %.1f ms, deadline "
+		"%.1f ms (%" PRIu64 " missed since last report, %" PRIu64
+		" of %" PRIu64 " total)\n",
+		sequence, to_ms(wd->last_ns), to_ms(wd->deadline_ns),
+		wd->missed - window->reported_missed, wd->missed, wd->frames);
+
+	window->last_report = now;
+	window->reported_missed = wd->missed;
+}
+
+static void
+record_present(struct window *window, const struct timespec *capture,
+	       uint32_t sequence, const struct timespec *present)
+{
+	if (capture_watchdog_record(&window->watchdog, capture, present))
+		report_deadline_miss(window, sequence);
+}
+
+static void
+destroy_feedback(struct feedback *feedback)
+{
+	wp_presentation_feedback_destroy(feedback->feedback);
+	wl_list_remove(&feedback->link);
+	free(feedback);
+}
+
+static void
+feedback_sync_output(void *data,
+		     struct wp_presentation_feedback *presentation_feedback,
+		     struct wl_output *output)
+{
+}
+
+static void
+feedback_presented(void *data,
+		   struct wp_presentation_feedback *presentation_feedback,
+		   uint32_t tv_sec_hi,
+		   uint32_t tv_sec_lo,
+		   uint32_t tv_nsec,
+		   uint32_t refresh_nsec,
+		   uint32_t seq_hi,
+		   uint32_t seq_lo,
+		   uint32_t flags)
+{
+	struct feedback *feedback = data;
+	struct window *window = feedback->window;
+	clockid_t clk_id = window->display->clk_id;
+	struct timespec present, now_clk, now_mono;
+
+	timespec_from_proto(&present, tv_sec_hi, tv_sec_lo, tv_nsec);
+
+	/* capture timestamps are CLOCK_MONOTONIC */
+	if (clk_id != CLOCK_MONOTONIC) {
+		clock_gettime(clk_id, &now_clk);
+		clock_gettime(CLOCK_MONOTONIC, &now_mono);
+		timespec_add_nsec(&present, &present,
+				  timespec_sub_to_nsec(&now_mono, &now_clk));
+	}
+
+	record_present(window, &feedback->capture, feedback->sequence,
+		       &present);
+	destroy_feedback(feedback);
+}
+
+static void
+feedback_discarded(void *data,
+		   struct wp_presentation_feedback *presentation_feedback)
+{
+	/* replaced by a newer frame before it reached the screen */
+	destroy_feedback(data);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	feedback_sync_output,
+	feedback_presented,
+	feedback_discarded
+};
+
+static void
+request_feedback(struct window *window, const struct v4l2_capture_buffer *buf)
+{
+	struct feedback *feedback;
+
+	feedback = zalloc(sizeof *feedback);
+	if (!feedback)
+		return;
+
+	feedback->window = window;
+	feedback->capture = buf->timestamp;
+	feedback->sequence = buf->sequence;
+	feedback->feedback =
+		wp_presentation_feedback(window->display->presentation,
+					 window->surface);
+	wp_presentation_feedback_add_listener(feedback->feedback,
+					      &feedback_listener, feedback);
+	wl_list_insert(&window->feedback_list, &feedback->link);
+}
+
+static void
+requeue(struct window *window, struct v4l2_capture_buffer *buf)
+{
+	if (v4l2_capture_queue(&window->capture, buf) < 0) {
+		fprintf(stderr, "VIDIOC_QBUF: %s\n", strerror(errno));
+		running = false;
+	}
+}
+
+static void
+buffer_release(void *data, struct wl_buffer *wl_buffer)
+{
+	struct buffer *buffer = data;
+
+	buffer->busy = false;
+
+	if (buffer->capture) {
+		requeue(buffer->window, buffer->capture);
+		buffer->capture = NULL;
+	}
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	buffer_release
+};
+
+static struct buffer *
+next_shm_buffer(struct window *window)
+{
+	unsigned i;
+
+	for (i = 0; i < window->num_buffers; i++)
+		if (!window->buffers[i].busy)
+			return &window->buffers[i];
+
+	return NULL;
+}
+
+static void
+copy_frame(struct window *window, struct buffer *buffer,
+	   const struct v4l2_capture_buffer *buf)
+{
+	const struct v4l2_capture *cap = &window->capture;
+	const uint8_t *src = (const uint8_t *)buf->maps[0] + buf->offsets[0];
+	uint8_t *dst = buffer->data;
+	int dst_stride = cap->width * 4;
+	int row_bytes = MIN(dst_stride, (int)cap->strides[0]);
+	int y;
+
+	for (y = 0; y < cap->height; y++)
+		memcpy(dst + y * dst_stride, src + y * cap->strides[0],
+		       row_bytes);
+}
+
+static const struct wl_callback_listener frame_listener;
+
+static void
+present(struct window *window, struct v4l2_capture_buffer *buf)
+{
+	struct buffer *buffer;
+
+	if (window->capture.io == V4L2_CAPTURE_IO_DMABUF) {
+		buffer = &window->buffers[buf->index];
+		buffer->capture = buf;
+	} else {
+		/* one on screen and one committed leave one free */
+		buffer = next_shm_buffer(window);
+		if (!buffer) {
+			window->capture.dropped++;
+			requeue(window, buf);
+			return;
+		}
+		copy_frame(window, buffer, buf);
+	}
+
+	buffer->busy = true;
+	window->shown = buf->timestamp;
+
+	wl_surface_attach(window->surface, buffer->buffer, 0, 0);
+	wl_surface_damage(window->surface, 0, 0,
+			  window->capture.width, window->capture.height);
+
+	window->callback = wl_surface_frame(window->surface);
+	wl_callback_add_listener(window->callback, &frame_listener, window);
+
+	if (window->display->presentation)
+		request_feedback(window, buf);
+
+	wl_surface_commit(window->surface);
+
+	if (window->capture.io == V4L2_CAPTURE_IO_MMAP)
+		requeue(window, buf);
+}
+
+/* Picks the newest of the pending frame and whatever the driver has. */
+static struct v4l2_capture_buffer *
+take_newest(struct window *window)
+{
+	struct v4l2_capture_buffer *buf;
+
+	buf = v4l2_capture_dequeue_newest(&window->capture);
+	if (!buf) {
+		if (errno != EAGAIN) {
+			fprintf(stderr, "VIDIOC_DQBUF: %s\n", strerror(errno));
+			running = false;
+		}
+		buf = window->pending;
+	} else if (window->pending) {
+		window->capture.dropped++;
+		requeue(window, window->pending);
+	}
+
+	window->pending = NULL;
+
+	return buf;
+}
+
+static void
+handle_capture(struct window *window)
+{
+	struct v4l2_capture_buffer *buf;
+
+	buf = take_newest(window);
+	if (!buf)
+		return;
+
+	if (window->callback || window->wait_for_configure)
+		window->pending = buf;
+	else
+		present(window, buf);
+}
+
+static void
+frame_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+	struct window *window = data;
+	struct timespec now;
+
+	wl_callback_destroy(callback);
+	window->callback = NULL;
+
+	/* without presentation-time the frame callback is the closest
+	 * thing to the moment the frame reached the screen */
+	if (!window->display->presentation) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		record_present(window, &window->shown, 0, &now);
+	}
+
+	if (window->pending)
+		handle_capture(window);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	frame_done
+};
+
+static void
+handle_watchdog_timer(struct window *window)
+{
+	struct timespec now;
+	uint64_t expirations;
+	int64_t idle;
+
+	if (read(window->timer_fd, &expirations, sizeof expirations) < 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	idle = capture_watchdog_check(&window->watchdog, &now);
+	if (idle > 0)
+		fprintf(stderr, "early-camera: no frame presented for %.1f ms "
+			"since the last capture, deadline %.1f ms\n",
+			to_ms(idle), to_ms(window->watchdog.deadline_ns));
+}
+
+static int
+start_watchdog(struct window *window, int64_t deadline_ns)
+{
+	struct itimerspec its;
+	struct timespec now;
+	int64_t period;
+
+	window->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+					  TFD_CLOEXEC | TFD_NONBLOCK);
+	if (window->timer_fd < 0)
+		return -1;
+
+	/* check twice per deadline so a stall is caught at most half a
+	 * deadline late */
+	period = MAX(deadline_ns / 2, 10000000);
+	timespec_from_nsec(&its.it_interval, period);
+	its.it_value = its.it_interval;
+	if (timerfd_settime(window->timer_fd, 0, &its, NULL) < 0)
+		return -1;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	capture_watchdog_init(&window->watchdog, deadline_ns,
+			      window->capture.frame_interval_ns, &now);
+
+	return 0;
+}
+
+static void
+create_succeeded(void *data,
+		 struct zwp_linux_buffer_params_v1 *params,
+		 struct wl_buffer *new_buffer)
+{
+	struct buffer *buffer = data;
+
+	buffer->buffer = new_buffer;
+	wl_buffer_add_listener(buffer->buffer, &buffer_listener, buffer);
+
+	zwp_linux_buffer_params_v1_destroy(params);
+}
+
+static void
+create_failed(void *data, struct zwp_linux_buffer_params_v1 *params)
+{
+	struct buffer *buffer = data;
+
+	buffer->buffer = NULL;
+	zwp_linux_buffer_params_v1_destroy(params);
+}
+
+static const struct zwp_linux_buffer_params_v1_listener params_listener = {
+	create_succeeded,
+	create_failed
+};
+
+static int
+create_dmabuf_buffers(struct window *window)
+{
+	struct v4l2_capture *cap = &window->capture;
+	struct zwp_linux_buffer_params_v1 *params;
+	struct v4l2_capture_buffer *buf;
+	uint64_t modifier = DRM_FORMAT_MOD_LINEAR;
+	unsigned i, p;
+
+	window->num_buffers = cap->num_buffers;
+	for (i = 0; i < cap->num_buffers; i++) {
+		buf = &cap->buffers[i];
+		window->buffers[i].window = window;
+
+		params = zwp_linux_dmabuf_v1_create_params(
+			window->display->dmabuf);
+		for (p = 0; p < cap->num_planes; p++)
+			zwp_linux_buffer_params_v1_add(params,
+						       buf->dmabuf_fds[p], p,
+						       buf->offsets[p],
+						       cap->strides[p],
+						       modifier >> 32,
+						       modifier & 0xffffffff);
+		zwp_linux_buffer_params_v1_add_listener(params,
+							&params_listener,
+							&window->buffers[i]);
+		zwp_linux_buffer_params_v1_create(params, cap->width,
+						  cap->height,
+						  window->drm_format, 0);
+	}
+
+	wl_display_roundtrip(window->display->display);
+
+	for (i = 0; i < window->num_buffers; i++) {
+		if (!window->buffers[i].buffer) {
+			fprintf(stderr, "zwp_linux_buffer_params.create "
+				"failed\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+create_shm_buffers(struct window *window)
+{
+	struct v4l2_capture *cap = &window->capture;
+	struct buffer *buffer;
+	struct wl_shm_pool *pool;
+	int stride = cap->width * 4;
+	size_t size = (size_t)stride * cap->height;
+	void *data;
+	int fd;
+	unsigned i;
+
+	fd = os_create_anonymous_file(size * SHM_BUFFERS);
+	if (fd < 0) {
+		fprintf(stderr, "creating a buffer file for %zu B failed: %s\n",
+			size * SHM_BUFFERS, strerror(errno));
+		return -1;
+	}
+
+	data = mmap(NULL, size * SHM_BUFFERS, PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "mmap failed: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	pool = wl_shm_create_pool(window->display->shm, fd,
+				  size * SHM_BUFFERS);
+	for (i = 0; i < SHM_BUFFERS; i++) {
+		buffer = &window->buffers[i];
+		buffer->window = window;
+		buffer->data = (uint8_t *)data + i * size;
+		buffer->size = size;
+		buffer->buffer = wl_shm_pool_create_buffer(pool, i * size,
+							   cap->width,
+							   cap->height,
+							   stride,
+							   window->shm_format);
+		wl_buffer_add_listener(buffer->buffer, &buffer_listener,
+				       buffer);
+	}
+	window->num_buffers = SHM_BUFFERS;
+
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	return 0;
+}
+
+static void
+destroy_buffers(struct window *window)
+{
+	unsigned i;
+
+	for (i = 0; i < window->num_buffers; i++)
+		if (window->buffers[i].buffer)
+			wl_buffer_destroy(window->buffers[i].buffer);
+
+	if (window->capture.io == V4L2_CAPTURE_IO_MMAP &&
+	    window->num_buffers > 0)
+		munmap(window->buffers[0].data,
+		       window->buffers[0].size * window->num_buffers);
+
+	window->num_buffers = 0;
+}
+
+static void
+xdg_wm_base_ping(void *data, struct xdg_wm_base *shell, uint32_t serial)
+{
+	xdg_wm_base_pong(shell, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	xdg_wm_base_ping,
+};
+
+static void
+xdg_surface_handle_configure(void *data, struct xdg_surface *surface,
+			     uint32_t serial)
+{
+	struct window *window = data;
+
+	xdg_surface_ack_configure(surface, serial);
+
+	if (window->wait_for_configure) {
+		window->wait_for_configure = false;
+		if (window->pending)
+			handle_capture(window);
+	}
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	xdg_surface_handle_configure,
+};
+
+static void
+xdg_toplevel_handle_configure(void *data, struct xdg_toplevel *toplevel,
+			      int32_t width, int32_t height,
+			      struct wl_array *states)
+{
+}
+
+static void
+xdg_toplevel_handle_close(void *data, struct xdg_toplevel *xdg_toplevel)
+{
+	running = false;
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+	xdg_toplevel_handle_configure,
+	xdg_toplevel_handle_close,
+};
+
+static void
+ias_handle_ping(void *data, struct ias_surface *ias_surface,
+		uint32_t serial)
+{
+	ias_surface_pong(ias_surface, serial);
+}
+
+static void
+ias_handle_configure(void *data, struct ias_surface *ias_surface,
+		     int32_t width, int32_t height)
+{
+}
+
+static struct ias_surface_listener ias_surface_listener = {
+	ias_handle_ping,
+	ias_handle_configure,
+};
+
+/*
+ * The camera gets a fullscreen view of its own, which keeps it above the
+ * regular application layers and makes its buffers scanout candidates.
+ */
+static int
+create_surface(struct window *window)
+{
+	struct display *display = window->display;
+
+	window->surface = wl_compositor_create_surface(display->compositor);
+
+	if (display->ias_shell) {
+		window->shell_surface =
+			ias_shell_get_ias_surface(display->ias_shell,
+						  window->surface,
+						  "early-camera");
+		ias_surface_add_listener(window->shell_surface,
+					 &ias_surface_listener, window);
+		ias_surface_set_fullscreen(window->shell_surface, NULL);
+	} else if (display->fshell) {
+		zwp_fullscreen_shell_v1_present_surface(display->fshell,
+			window->surface,
+			ZWP_FULLSCREEN_SHELL_V1_PRESENT_METHOD_DEFAULT, NULL);
+	} else if (display->wm_base) {
+		window->xdg_surface =
+			xdg_wm_base_get_xdg_surface(display->wm_base,
+						    window->surface);
+		xdg_surface_add_listener(window->xdg_surface,
+					 &xdg_surface_listener, window);
+		window->xdg_toplevel =
+			xdg_surface_get_toplevel(window->xdg_surface);
+		xdg_toplevel_add_listener(window->xdg_toplevel,
+					  &xdg_toplevel_listener, window);
+		xdg_toplevel_set_title(window->xdg_toplevel, "early-camera");
+		xdg_toplevel_set_fullscreen(window->xdg_toplevel, NULL);
+		window->wait_for_configure = true;
+	} else {
+		fprintf(stderr, "no shell global\n");
+		return -1;
+	}
+
+	wl_surface_commit(window->surface);
+
+	return 0;
+}
+
+static void
+destroy_window(struct window *window)
+{
+	struct feedback *feedback, *tmp;
+
+	wl_list_for_each_safe(feedback, tmp, &window->feedback_list, link)
+		destroy_feedback(feedback);
+
+	if (window->callback)
+		wl_callback_destroy(window->callback);
+	if (window->xdg_toplevel)
+		xdg_toplevel_destroy(window->xdg_toplevel);
+	if (window->xdg_surface)
+		xdg_surface_destroy(window->xdg_surface);
+	if (window->shell_surface)
+		ias_surface_destroy(window->shell_surface);
+	if (window->surface)
+		wl_surface_destroy(window->surface);
+
+	destroy_buffers(window);
+	v4l2_capture_close(&window->capture);
+
+	if (window->timer_fd >= 0)
+		close(window->timer_fd);
+}
+
+static void
+presentation_clock_id(void *data, struct wp_presentation *presentation,
+		      uint32_t clk_id)
+{
+	struct display *d = data;
+
+	d->clk_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	presentation_clock_id
+};
+
+static void
+registry_handle_global(void *data, struct wl_registry *registry,
+		       uint32_t id, const char *interface, uint32_t version)
+{
+	struct display *d = data;
+
+	if (strcmp(interface, "wl_compositor") == 0) {
+		d->compositor = wl_registry_bind(registry, id,
+						 &wl_compositor_interface, 1);
+	} else if (strcmp(interface, "wl_shm") == 0) {
+		d->shm = wl_registry_bind(registry, id, &wl_shm_interface, 1);
+	} else if (strcmp(interface, "xdg_wm_base") == 0) {
+		d->wm_base = wl_registry_bind(registry, id,
+					      &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(d->wm_base, &wm_base_listener, d);
+	} else if (strcmp(interface, "ias_shell") == 0) {
+		d->ias_shell = wl_registry_bind(registry, id,
+						&ias_shell_interface, 1);
+	} else if (strcmp(interface, "zwp_fullscreen_shell_v1") == 0) {
+		d->fshell = wl_registry_bind(registry, id,
+					     &zwp_fullscreen_shell_v1_interface,
+					     1);
+	} else if (strcmp(interface, "zwp_linux_dmabuf_v1") == 0) {
+		d->dmabuf = wl_registry_bind(registry, id,
+					     &zwp_linux_dmabuf_v1_interface, 1);
+	} else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+		d->presentation = wl_registry_bind(registry, id,
+						   &wp_presentation_interface,
+						   1);
+		wp_presentation_add_listener(d->presentation,
+					     &presentation_listener, d);
+	}
+}
+
+static void
+registry_handle_global_remove(void *data, struct wl_registry *registry,
+			      uint32_t name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+	registry_handle_global,
+	registry_handle_global_remove
+};
+
+static int
+create_display(struct display *display)
+{
+	display->clk_id = CLOCK_MONOTONIC;
+
+	display->display = wl_display_connect(NULL);
+	if (!display->display) {
+		fprintf(stderr, "failed to connect to the compositor\n");
+		return -1;
+	}
+
+	display->registry = wl_display_get_registry(display->display);
+	wl_registry_add_listener(display->registry, &registry_listener,
+				 display);
+	/* the second roundtrip collects the presentation clock id */
+	wl_display_roundtrip(display->display);
+	wl_display_roundtrip(display->display);
+
+	if (!display->compositor) {
+		fprintf(stderr, "no wl_compositor global\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+destroy_display(struct display *display)
+{
+	if (!display->display)
+		return;
+
+	if (display->presentation)
+		wp_presentation_destroy(display->presentation);
+	if (display->dmabuf)
+		zwp_linux_dmabuf_v1_destroy(display->dmabuf);
+	if (display->fshell)
+		zwp_fullscreen_shell_v1_release(display->fshell);
+	if (display->ias_shell)
+		ias_shell_destroy(display->ias_shell);
+	if (display->wm_base)
+		xdg_wm_base_destroy(display->wm_base);
+	if (display->shm)
+		wl_shm_destroy(display->shm);
+	if (display->compositor)
+		wl_compositor_destroy(display->compositor);
+
+	wl_registry_destroy(display->registry);
+	wl_display_flush(display->display);
+	wl_display_disconnect(display->display);
+}
+
+/*
+ * The compositor holds up to two dmabuf buffers (on screen and committed)
+ * and we may hold one pending; with copies only the pending one is out.
+ */
+static int
+start_capture(struct window *window, bool use_dmabuf, int64_t budget_ns)
+{
+	struct v4l2_capture *cap = &window->capture;
+	unsigned held = use_dmabuf ? 3 : 1;
+	unsigned depth;
+
+	depth = v4l2_capture_queue_depth(budget_ns, cap->frame_interval_ns,
+					 held);
+	if (v4l2_capture_start(cap, depth, use_dmabuf ?
+			       V4L2_CAPTURE_IO_DMABUF :
+			       V4L2_CAPTURE_IO_MMAP) < 0) {
+		fprintf(stderr, "failed to start streaming: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	if (use_dmabuf && cap->io != V4L2_CAPTURE_IO_DMABUF)
+		fprintf(stderr, "early-camera: the driver cannot export "
+			"dmabufs, copying frames\n");
+
+	if (cap->io == V4L2_CAPTURE_IO_MMAP &&
+	    window->shm_format == UINT32_MAX) {
+		fprintf(stderr, "copying needs XR24, AR24 or BGR4 from the "
+			"capture device\n");
+		return -1;
+	}
+
+	printf("%d×%d, %u buffers, %s, frame interval %.1f ms\n",
+	       cap->width, cap->height, cap->num_buffers,
+	       cap->io == V4L2_CAPTURE_IO_DMABUF ? "dmabuf" : "copy",
+	       to_ms(cap->frame_interval_ns));
+
+	if (cap->io == V4L2_CAPTURE_IO_DMABUF)
+		return create_dmabuf_buffers(window);
+
+	return create_shm_buffers(window);
+}
+
+static void
+print_summary(struct window *window)
+{
+	struct capture_watchdog *wd = &window->watchdog;
+
+	printf("%" PRIu64 " frames presented, %" PRIu64 " missed the "
+	       "%.1f ms deadline, %" PRIu64 " stalls, %" PRIu64 " dropped\n",
+	       wd->frames, wd->missed, to_ms(wd->deadline_ns), wd->stalls,
+	       window->capture.dropped);
+	if (wd->frames > 0)
+		printf("capture to present: average %.1f ms, max %.1f ms\n",
+		       to_ms(wd->total_ns / (int64_t)wd->frames),
+		       to_ms(wd->max_ns));
+}
+
+static unsigned
+capture_buffers_queued(const struct v4l2_capture *cap)
+{
+	unsigned i, n = 0;
+
+	for (i = 0; i < cap->num_buffers; i++)
+		if (cap->buffers[i].queued)
+			n++;
+
+	return n;
+}
+
+static int
+run(struct window *window)
+{
+	struct wl_display *display = window->display->display;
+	struct pollfd fds[3];
+	int ret;
+
+	fds[0].fd = wl_display_get_fd(display);
+	fds[0].events = POLLIN;
+	fds[1].events = POLLIN;
+	fds[2].fd = window->timer_fd;
+	fds[2].events = POLLIN;
+
+	while (running) {
+		while (wl_display_prepare_read(display) != 0)
+			wl_display_dispatch_pending(display);
+
+		if (wl_display_flush(display) < 0 && errno != EAGAIN) {
+			wl_display_cancel_read(display);
+			return -1;
+		}
+
+		/* V4L2 reports POLLERR while no buffer is queued */
+		fds[1].fd = capture_buffers_queued(&window->capture) > 0 ?
+			window->capture.fd : -1;
+
+		ret = poll(fds, ARRAY_LENGTH(fds), -1);
+		if (ret < 0) {
+			wl_display_cancel_read(display);
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		if (fds[0].revents & (POLLERR | POLLHUP)) {
+			wl_display_cancel_read(display);
+			return -1;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			if (wl_display_read_events(display) < 0)
+				return -1;
+		} else {
+			wl_display_cancel_read(display);
+		}
+
+		if (wl_display_dispatch_pending(display) < 0)
+			return -1;
+
+		if (fds[1].revents & (POLLIN | POLLERR))
+			handle_capture(window);
+
+		if (fds[2].revents & POLLIN)
+			handle_watchdog_timer(window);
+	}
+
+	return 0;
+}
+
+static void
+signal_int(int signum)
+{
+	running = false;
+}
+
+static void
+usage(const char *argv0)
+{
+	printf("Usage: %s [options]\n"
+	       "\n"
+	       "  --device=PATH\t\tV4L2 capture device, default /dev/video0\n"
+	       "  --format=FOURCC\tV4L2 format, default XR24\n"
+	       "  --drm-format=FOURCC\tformat the dmabufs are imported as, "
+	       "default the V4L2 one\n"
+	       "  --deadline-ms=N\tcapture to present deadline, default 100\n"
+	       "  --budget-ms=N\t\tlatency the buffer queue may add, "
+	       "default the deadline\n"
+	       "  --shm\t\t\tcopy frames into wl_shm even if dmabufs work\n"
+	       "\n"
+	       "Without a camera, load the vivid virtual driver:\n"
+	       "    # modprobe vivid node_types=0x1 num_inputs=1 "
+	       "input_types=0x00\n"
+	       "The copy path, used when the compositor has no linux-dmabuf "
+	       "support (pixman\n"
+	       "renderer, headless backend) or with --shm, needs XR24, AR24 "
+	       "or BGR4.\n", argv0);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sigaction sigint;
+	struct display display = { 0 };
+	struct window window = { 0 };
+	char *device = NULL;
+	char *format = NULL;
+	char *drm_format = NULL;
+	int32_t deadline_ms = 100;
+	int32_t budget_ms = -1;
+	int32_t force_shm = 0;
+	int32_t help = 0;
+	uint32_t v4l_format;
+	bool use_dmabuf;
+	int ret = 1;
+
+	const struct weston_option options[] = {
+		{ WESTON_OPTION_STRING, "device", 0, &device },
+		{ WESTON_OPTION_STRING, "format", 0, &format },
+		{ WESTON_OPTION_STRING, "drm-format", 0, &drm_format },
+		{ WESTON_OPTION_INTEGER, "deadline-ms", 0, &deadline_ms },
+		{ WESTON_OPTION_INTEGER, "budget-ms", 0, &budget_ms },
+		{ WESTON_OPTION_BOOLEAN, "shm", 0, &force_shm },
+		{ WESTON_OPTION_BOOLEAN, "help", 'h', &help },
+	};
+
+	if (parse_options(options, ARRAY_LENGTH(options), &argc, argv) > 1 ||
+	    help) {
+		usage(argv[0]);
+		return help ? 0 : 1;
+	}
+
+	v4l_format = parse_format(format ? format : "XR24");
+	window.drm_format = drm_format ? parse_format(drm_format) : v4l_format;
+	if (!v4l_format || !window.drm_format || deadline_ms <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (budget_ms < 0)
+		budget_ms = deadline_ms;
+
+	window.display = &display;
+	window.timer_fd = -1;
+	window.capture.fd = -1;
+	wl_list_init(&window.feedback_list);
+
+	if (create_display(&display) < 0)
+		goto out_display;
+
+	if (v4l2_capture_open(&window.capture,
+			      device ? device : "/dev/video0",
+			      v4l_format) < 0) {
+		fprintf(stderr, "%s: %s\n", device ? device : "/dev/video0",
+			strerror(errno));
+		goto out_display;
+	}
+	window.shm_format = shm_format_for(window.capture.pixelformat);
+
+	use_dmabuf = display.dmabuf && !force_shm;
+	if (!use_dmabuf && !display.shm) {
+		fprintf(stderr, "neither zwp_linux_dmabuf_v1 nor wl_shm\n");
+		goto out_window;
+	}
+
+	if (create_surface(&window) < 0 ||
+	    start_capture(&window, use_dmabuf, budget_ms * 1000000LL) < 0 ||
+	    start_watchdog(&window, deadline_ms * 1000000LL) < 0)
+		goto out_window;
+
+	sigint.sa_handler = signal_int;
+	sigemptyset(&sigint.sa_mask);
+	sigint.sa_flags = SA_RESETHAND;
+	sigaction(SIGINT, &sigint, NULL);
+
+	if (run(&window) == 0)
+		ret = 0;
+
+	print_summary(&window);
+
+out_window:
+	destroy_window(&window);
+out_display:
+	destroy_display(&display);
+	free(device);
+	free(format);
+	free(drm_format);
+
+	return ret;
+}
@@ -0,0 +1,436 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-buffer-cache.c
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay cache of imported guest buffers
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <wayland-util.h>
+
+#include "vmdisplay-buffer-cache.h"
+
+/* Initial number of hash buckets, always a power of two */
+#define CACHE_MIN_BUCKETS 16
+/* Surfaces kept at once, the least recently used one goes beyond that */
+#define CACHE_MAX_SURFACES 256
+
+struct cache_surface;
+
+struct cache_entry {
+	struct wl_list hash_link;
+	/* cache_surface::lru when in use, cache_surface::free otherwise */
+	struct wl_list lru_link;
+	struct cache_surface *surface;
+	uint32_t buffer_id;
+	uint32_t width;
+	uint32_t height;
+	void *payload;
+};
+
+struct cache_surface {
+	struct wl_list link;
+	uint64_t surface_id;
+	/* most recently used first */
+	struct wl_list lru;
+	struct wl_list free;
+	int count;
+	/* all entries of the surface, allocated up front */
+	struct cache_entry *entries;
+};
+
+struct vmdisplay_buffer_cache {
+	int capacity;
+	vmdisplay_buffer_cache_release_func_t release;
+	void *release_data;
+
+	struct wl_list *buckets;
+	uint32_t n_buckets;
+	uint32_t n_entries;
+
+	struct wl_list surface_list;
+	int n_surfaces;
+
+	struct vmdisplay_buffer_cache_stats stats;
+};
+
+static uint32_t
+cache_hash(uint64_t surface_id, uint32_t buffer_id)
+{
+	uint64_t h = surface_id ^ ((uint64_t) buffer_id << 32 | buffer_id);
+
+	/* splitmix64 finaliser */
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+
+	return (uint32_t) h;
+}
+
+static struct wl_list *
+cache_bucket(struct vmdisplay_buffer_cache *cache,
+	     uint64_t surface_id, uint32_t buffer_id)
+{
+	uint32_t h = cache_hash(surface_id, buffer_id);
+
+	return &cache->buckets[h & (cache->n_buckets - 1)];
+}
+
+static int
+cache_resize(struct vmdisplay_buffer_cache *cache, uint32_t n_buckets)
+{
+	struct wl_list *buckets, *old = cache->buckets;
+	struct cache_entry *entry, *tmp;
+	uint32_t i, old_n = cache->n_buckets;
+
+	buckets = calloc(n_buckets, sizeof(*buckets));
+	if (!buckets)
+		return -1;
+
+	for (i = 0; i < n_buckets; i++)
+		wl_list_init(&buckets[i]);
+
+	cache->buckets = buckets;
+	cache->n_buckets = n_buckets;
+
+	for (i = 0; i < old_n; i++) {
+		wl_list_for_each_safe(entry, tmp, &old[i], hash_link) {
+			wl_list_remove(&entry->hash_link);
+			wl_list_insert(cache_bucket(cache,
+						    entry->surface->surface_id,
+						    entry->buffer_id),
+				       &entry->hash_link);
+		}
+	}
+	free(old);
+
+	return 0;
+}
+
+static struct cache_entry *
+cache_find(struct vmdisplay_buffer_cache *cache,
+	   uint64_t surface_id, uint32_t buffer_id)
+{
+	struct wl_list *bucket = cache_bucket(cache, surface_id, buffer_id);
+	struct cache_entry *entry;
+
+	wl_list_for_each(entry, bucket, hash_link) {
+		if (entry->buffer_id == buffer_id &&
+		    entry->surface->surface_id == surface_id)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void
+cache_entry_release(struct vmdisplay_buffer_cache *cache,
+		    struct cache_entry *entry)
+{
+	void *payload = entry->payload;
+
+	wl_list_remove(&entry->hash_link);
+	wl_list_remove(&entry->lru_link);
+	wl_list_insert(&entry->surface->free, &entry->lru_link);
+	entry->surface->count--;
+	entry->payload = NULL;
+	cache->n_entries--;
+
+	if (cache->release)
+		cache->release(payload, cache->release_data);
+}
+
+/*
+ * Surfaces are only looked up on misses and when metadata names a new
+ * surface, so a list that keeps the last used surface first is enough.
+ * The list is also the surfaces' LRU order.
+ */
+static struct cache_surface *
+cache_find_surface(struct vmdisplay_buffer_cache *cache, uint64_t surface_id)
+{
+	struct cache_surface *surface;
+
+	wl_list_for_each(surface, &cache->surface_list, link) {
+		if (surface->surface_id != surface_id)
+			continue;
+
+		if (cache->surface_list.next != &surface->link) {
+			wl_list_remove(&surface->link);
+			wl_list_insert(&cache->surface_list, &surface->link);
+		}
+		return surface;
+	}
+
+	return NULL;
+}
+
+static void
+cache_destroy_surface(struct vmdisplay_buffer_cache *cache,
+		      struct cache_surface *surface);
+
+static struct cache_surface *
+cache_create_surface(struct vmdisplay_buffer_cache *cache,
+		     uint64_t surface_id)
+{
+	struct cache_surface *surface, *oldest;
+	int i;
+
+	/* surfaces are never dropped when the guest stops showing them, so
+	 * this is what bounds the buffers held for surfaces that are gone */
+	if (cache->n_surfaces >= CACHE_MAX_SURFACES) {
+		oldest = wl_container_of(cache->surface_list.prev, oldest,
+					 link);
+		cache->stats.evictions += oldest->count;
+		cache_destroy_surface(cache, oldest);
+	}
+
+	surface = calloc(1, sizeof(*surface));
+	if (!surface)
+		return NULL;
+
+	surface->entries = calloc(cache->capacity, sizeof(*surface->entries));
+	if (!surface->entries) {
+		free(surface);
+		return NULL;
+	}
+
+	surface->surface_id = surface_id;
+	wl_list_init(&surface->lru);
+	wl_list_init(&surface->free);
+	for (i = 0; i < cache->capacity; i++) {
+		surface->entries[i].surface = surface;
+		wl_list_init(&surface->entries[i].hash_link);
+		wl_list_insert(surface->free.prev,
+			       &surface->entries[i].lru_link);
+	}
+	wl_list_insert(&cache->surface_list, &surface->link);
+	cache->n_surfaces++;
+
+	return surface;
+}
+
+static void
+cache_destroy_surface(struct vmdisplay_buffer_cache *cache,
+		      struct cache_surface *surface)
+{
+	struct cache_entry *entry, *tmp;
+
+	wl_list_for_each_safe(entry, tmp, &surface->lru, lru_link)
+		cache_entry_release(cache, entry);
+
+	wl_list_remove(&surface->link);
+	cache->n_surfaces--;
+	free(surface->entries);
+	free(surface);
+}
+
+struct vmdisplay_buffer_cache *
+vmdisplay_buffer_cache_create(int capacity,
+			      vmdisplay_buffer_cache_release_func_t release,
+			      void *data)
+{
+	struct vmdisplay_buffer_cache *cache;
+
+	if (capacity <= 0)
+		return NULL;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	cache->capacity = capacity;
+	cache->release = release;
+	cache->release_data = data;
+	wl_list_init(&cache->surface_list);
+
+	if (cache_resize(cache, CACHE_MIN_BUCKETS) < 0) {
+		free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+void vmdisplay_buffer_cache_destroy(struct vmdisplay_buffer_cache *cache)
+{
+	if (!cache)
+		return;
+
+	vmdisplay_buffer_cache_clear(cache);
+	free(cache->buckets);
+	free(cache);
+}
+
+/*
+ * Returns the payload cached for the buffer and marks it most recently
+ * used. A buffer that is cached with a different size is stale, as the
+ * guest reused the id for a new allocation, and is evicted.
+ */
+void *vmdisplay_buffer_cache_lookup(struct vmdisplay_buffer_cache *cache,
+				    uint64_t surface_id, uint32_t buffer_id,
+				    uint32_t width, uint32_t height)
+{
+	struct cache_entry *entry;
+
+	entry = cache_find(cache, surface_id, buffer_id);
+	if (entry && (entry->width != width || entry->height != height)) {
+		cache_entry_release(cache, entry);
+		cache->stats.evictions++;
+		entry = NULL;
+	}
+
+	if (!entry) {
+		cache->stats.misses++;
+		return NULL;
+	}
+
+	wl_list_remove(&entry->lru_link);
+	wl_list_insert(&entry->surface->lru, &entry->lru_link);
+	wl_list_remove(&entry->surface->link);
+	wl_list_insert(&cache->surface_list, &entry->surface->link);
+	cache->stats.hits++;
+
+	return entry->payload;
+}
+
+/*
+ * Takes ownership of payload on success. When the surface is full its
+ * least recently used buffer is released to make room.
+ */
+int vmdisplay_buffer_cache_insert(struct vmdisplay_buffer_cache *cache,
+				  uint64_t surface_id, uint32_t buffer_id,
+				  uint32_t width, uint32_t height,
+				  void *payload)
+{
+	struct cache_surface *surface;
+	struct cache_entry *entry;
+
+	entry = cache_find(cache, surface_id, buffer_id);
+	if (entry)
+		cache_entry_release(cache, entry);
+
+	surface = cache_find_surface(cache, surface_id);
+	if (!surface)
+		surface = cache_create_surface(cache, surface_id);
+	if (!surface)
+		return -1;
+
+	if (wl_list_empty(&surface->free)) {
+		entry = wl_container_of(surface->lru.prev, entry, lru_link);
+		cache_entry_release(cache, entry);
+		cache->stats.evictions++;
+	}
+
+	if (cache->n_entries >= cache->n_buckets &&
+	    cache_resize(cache, cache->n_buckets * 2) < 0)
+		return -1;
+
+	entry = wl_container_of(surface->free.next, entry, lru_link);
+	wl_list_remove(&entry->lru_link);
+	wl_list_insert(&surface->lru, &entry->lru_link);
+	wl_list_insert(cache_bucket(cache, surface_id, buffer_id),
+		       &entry->hash_link);
+	entry->buffer_id = buffer_id;
+	entry->width = width;
+	entry->height = height;
+	entry->payload = payload;
+	surface->count++;
+	cache->n_entries++;
+
+	return 0;
+}
+
+void vmdisplay_buffer_cache_remove(struct vmdisplay_buffer_cache *cache,
+				   uint64_t surface_id, uint32_t buffer_id)
+{
+	struct cache_entry *entry;
+
+	entry = cache_find(cache, surface_id, buffer_id);
+	if (entry)
+		cache_entry_release(cache, entry);
+}
+
+/*
+ * Reserves room for a surface as soon as its id shows up in the metadata:
+ * its LRU list is created and the table is grown for a full set of its
+ * buffers, so that inserting them later does not allocate. Nothing is
+ * imported, the metadata only names the buffer being shown. Returns 1 if
+ * the surface was not known yet, 0 if it was and -1 on allocation failure.
+ */
+int vmdisplay_buffer_cache_reserve(struct vmdisplay_buffer_cache *cache,
+				   uint64_t surface_id)
+{
+	if (cache_find_surface(cache, surface_id))
+		return 0;
+
+	if (!cache_create_surface(cache, surface_id))
+		return -1;
+
+	/* make sure the table will not need to grow for this surface */
+	while (cache->n_buckets < cache->n_entries + cache->capacity &&
+	       cache_resize(cache, cache->n_buckets * 2) == 0)
+		;
+
+	cache->stats.reserves++;
+
+	return 1;
+}
+
+void vmdisplay_buffer_cache_drop_surface(struct vmdisplay_buffer_cache *cache,
+					 uint64_t surface_id)
+{
+	struct cache_surface *surface;
+
+	surface = cache_find_surface(cache, surface_id);
+	if (surface)
+		cache_destroy_surface(cache, surface);
+}
+
+void vmdisplay_buffer_cache_clear(struct vmdisplay_buffer_cache *cache)
+{
+	struct cache_surface *surface, *tmp;
+
+	wl_list_for_each_safe(surface, tmp, &cache->surface_list, link)
+		cache_destroy_surface(cache, surface);
+}
+
+int vmdisplay_buffer_cache_count(struct vmdisplay_buffer_cache *cache,
+				 uint64_t surface_id)
+{
+	struct cache_surface *surface;
+
+	surface = cache_find_surface(cache, surface_id);
+
+	return surface ? surface->count : 0;
+}
+
+void vmdisplay_buffer_cache_get_stats(struct vmdisplay_buffer_cache *cache,
+				      struct vmdisplay_buffer_cache_stats *stats)
+{
+	*stats = cache->stats;
+}
@@ -0,0 +1,96 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-buffer-cache.h
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay cache of imported guest buffers
+ *-----------------------------------------------------------------------------
+ */
+#ifndef _VMDISPLAY_BUFFER_CACHE_H_
+#define _VMDISPLAY_BUFFER_CACHE_H_
+
+#include <stdint.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cache of imported buffers keyed by surface id and hyper_dmabuf id.
+ *
+ * Lookups go through a hash table, and each surface keeps its own LRU list
+ * bounded by the capacity given at creation, so a busy surface can only
+ * evict its own buffers. The least recently used surface is dropped once
+ * a few hundred are held. The cache never looks inside the payloads, it
+ * hands them back to the release callback when they are evicted, replaced
+ * or dropped, which keeps it independent of EGL and wayland.
+ */
+struct vmdisplay_buffer_cache;
+
+struct vmdisplay_buffer_cache_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t reserves;
+};
+
+typedef void (*vmdisplay_buffer_cache_release_func_t)(void *payload,
+						     void *data);
+
+#define VMDISPLAY_BUFFER_CACHE_DEFAULT_CAPACITY 4
+
+struct vmdisplay_buffer_cache *
+vmdisplay_buffer_cache_create(int capacity,
+			      vmdisplay_buffer_cache_release_func_t release,
+			      void *data);
+void vmdisplay_buffer_cache_destroy(struct vmdisplay_buffer_cache *cache);
+
+void *vmdisplay_buffer_cache_lookup(struct vmdisplay_buffer_cache *cache,
+				    uint64_t surface_id, uint32_t buffer_id,
+				    uint32_t width, uint32_t height);
+int vmdisplay_buffer_cache_insert(struct vmdisplay_buffer_cache *cache,
+				  uint64_t surface_id, uint32_t buffer_id,
+				  uint32_t width, uint32_t height,
+				  void *payload);
+void vmdisplay_buffer_cache_remove(struct vmdisplay_buffer_cache *cache,
+				   uint64_t surface_id, uint32_t buffer_id);
+
+int vmdisplay_buffer_cache_reserve(struct vmdisplay_buffer_cache *cache,
+				   uint64_t surface_id);
+void vmdisplay_buffer_cache_drop_surface(struct vmdisplay_buffer_cache *cache,
+					 uint64_t surface_id);
+void vmdisplay_buffer_cache_clear(struct vmdisplay_buffer_cache *cache);
+
+int vmdisplay_buffer_cache_count(struct vmdisplay_buffer_cache *cache,
+				 uint64_t surface_id);
+void vmdisplay_buffer_cache_get_stats(struct vmdisplay_buffer_cache *cache,
+				      struct vmdisplay_buffer_cache_stats *stats);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // _VMDISPLAY_BUFFER_CACHE_H_
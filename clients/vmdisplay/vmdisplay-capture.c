@@ -0,0 +1,217 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-capture.c
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay recording of metadata and input streams
+ *-----------------------------------------------------------------------------
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vmdisplay-capture.h"
+
+struct vmdisplay_capture {
+	FILE *file;
+	/* metadata and input are recorded from different threads */
+	pthread_mutex_t lock;
+};
+
+struct vmdisplay_capture_reader {
+	const char *data;
+	size_t size;
+	size_t offset;
+};
+
+uint64_t vmdisplay_capture_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct vmdisplay_capture *vmdisplay_capture_create(const char *path)
+{
+	struct vmdisplay_capture *capture;
+	struct vmdisplay_capture_file_header header;
+
+	capture = calloc(1, sizeof(*capture));
+	if (!capture)
+		return NULL;
+
+	capture->file = fopen(path, "we");
+	if (!capture->file) {
+		printf("Cannot create capture file %s: %s\n", path,
+		       strerror(errno));
+		free(capture);
+		return NULL;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, VMDISPLAY_CAPTURE_MAGIC, sizeof(header.magic));
+	header.version = VMDISPLAY_CAPTURE_VERSION;
+
+	if (fwrite(&header, sizeof(header), 1, capture->file) != 1) {
+		fclose(capture->file);
+		free(capture);
+		return NULL;
+	}
+
+	pthread_mutex_init(&capture->lock, NULL);
+
+	return capture;
+}
+
+int vmdisplay_capture_write(struct vmdisplay_capture *capture, uint32_t type,
+			    const void *data, uint32_t len)
+{
+	struct vmdisplay_capture_record_header header;
+	int ret = 0;
+
+	header.type = type;
+	header.len = len;
+	header.timestamp_ns = vmdisplay_capture_now();
+
+	pthread_mutex_lock(&capture->lock);
+	if (fwrite(&header, sizeof(header), 1, capture->file) != 1 ||
+	    fwrite(data, 1, len, capture->file) != len)
+		ret = -1;
+	pthread_mutex_unlock(&capture->lock);
+
+	return ret;
+}
+
+void vmdisplay_capture_destroy(struct vmdisplay_capture *capture)
+{
+	if (!capture)
+		return;
+
+	fclose(capture->file);
+	pthread_mutex_destroy(&capture->lock);
+	free(capture);
+}
+
+struct vmdisplay_capture_reader *vmdisplay_capture_reader_open(const char *path)
+{
+	struct vmdisplay_capture_reader *reader;
+	const struct vmdisplay_capture_file_header *header;
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		printf("Cannot open capture file %s: %s\n", path,
+		       strerror(errno));
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0 ||
+	    (size_t) st.st_size < sizeof(struct vmdisplay_capture_file_header)) {
+		printf("%s is not a capture file\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	header = (const struct vmdisplay_capture_file_header *)data;
+	if (memcmp(header->magic, VMDISPLAY_CAPTURE_MAGIC,
+		   sizeof(header->magic)) != 0 ||
+	    header->version != VMDISPLAY_CAPTURE_VERSION) {
+		printf("%s is not a capture file\n", path);
+		munmap(data, st.st_size);
+		return NULL;
+	}
+
+	reader = calloc(1, sizeof(*reader));
+	if (!reader) {
+		munmap(data, st.st_size);
+		return NULL;
+	}
+
+	reader->data = (const char *)data;
+	reader->size = st.st_size;
+	reader->offset = sizeof(*header);
+
+	return reader;
+}
+
+/*
+ * Returns 1 and fills in record when there is one more, 0 at the end of
+ * the capture. A record cut short, as left behind by a recorder that was
+ * killed, ends the capture as well.
+ */
+int vmdisplay_capture_reader_next(struct vmdisplay_capture_reader *reader,
+				  struct vmdisplay_capture_record *record)
+{
+	struct vmdisplay_capture_record_header header;
+	size_t left = reader->size - reader->offset;
+
+	if (left < sizeof(header))
+		return 0;
+
+	memcpy(&header, reader->data + reader->offset, sizeof(header));
+	if (left - sizeof(header) < header.len)
+		return 0;
+
+	record->type = header.type;
+	record->len = header.len;
+	record->timestamp_ns = header.timestamp_ns;
+	record->data = reader->data + reader->offset + sizeof(header);
+	reader->offset += sizeof(header) + header.len;
+
+	return 1;
+}
+
+void vmdisplay_capture_reader_rewind(struct vmdisplay_capture_reader *reader)
+{
+	reader->offset = sizeof(struct vmdisplay_capture_file_header);
+}
+
+void vmdisplay_capture_reader_close(struct vmdisplay_capture_reader *reader)
+{
+	if (!reader)
+		return;
+
+	munmap((void *)reader->data, reader->size);
+	free(reader);
+}
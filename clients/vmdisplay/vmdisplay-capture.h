@@ -0,0 +1,98 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-capture.h
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay recording of metadata and input streams
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _VMDISPLAY_CAPTURE_H_
+#define _VMDISPLAY_CAPTURE_H_
+
+#include <stdint.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Capture files hold the metadata and input streams exchanged with a
+ * guest, each message stamped with the CLOCK_MONOTONIC time it was seen.
+ * The file starts with a vmdisplay_capture_file_header and is followed by
+ * records, each a vmdisplay_capture_record_header and len bytes of
+ * payload. Metadata records hold a whole frame as it travels on the
+ * stream, METADATA_STREAM_START and METADATA_STREAM_END markers included.
+ */
+#define VMDISPLAY_CAPTURE_MAGIC "VMDCAPT"
+#define VMDISPLAY_CAPTURE_VERSION 1
+
+enum vmdisplay_capture_type {
+	VMDISPLAY_CAPTURE_METADATA = 1,
+	VMDISPLAY_CAPTURE_INPUT,
+};
+
+struct vmdisplay_capture_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+struct vmdisplay_capture_record_header {
+	uint32_t type;
+	uint32_t len;
+	uint64_t timestamp_ns;
+};
+
+struct vmdisplay_capture_record {
+	uint32_t type;
+	uint32_t len;
+	uint64_t timestamp_ns;
+	const void *data;
+};
+
+uint64_t vmdisplay_capture_now(void);
+
+struct vmdisplay_capture;
+
+struct vmdisplay_capture *vmdisplay_capture_create(const char *path);
+int vmdisplay_capture_write(struct vmdisplay_capture *capture, uint32_t type,
+			    const void *data, uint32_t len);
+void vmdisplay_capture_destroy(struct vmdisplay_capture *capture);
+
+struct vmdisplay_capture_reader;
+
+struct vmdisplay_capture_reader *vmdisplay_capture_reader_open(const char *path);
+int vmdisplay_capture_reader_next(struct vmdisplay_capture_reader *reader,
+				  struct vmdisplay_capture_record *record);
+void vmdisplay_capture_reader_rewind(struct vmdisplay_capture_reader *reader);
+void vmdisplay_capture_reader_close(struct vmdisplay_capture_reader *reader);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // _VMDISPLAY_CAPTURE_H_
@@ -51,7 +51,7 @@
 #include "vm-shared.h"
 #include "vmdisplay-shared.h"
 #include "vmdisplay-server.h"
-#include "vmdisplay-server-network.h"
+#include "vmdisplay-server-channel.h"
 
 typedef int32_t wl_fixed_t;
 
@@ -225,7 +225,7 @@ int VMDisplayInput::init(int domid, CommunicationChannelType comm_type,
 {
 	switch (comm_type) {
 		case CommunicationChannelNetwork:
-			hyper_comm_input = new NetworkCommunicator();
+			hyper_comm_input = new ChannelCommunicator();
 			break;
 		default:
 			printf("Only Network communication channel is supported\n");
@@ -556,6 +556,8 @@ void print_usage(const char *path)
 	printf("e.g.:\n");
 	printf("%s 2 --xen \"shared_input\"\n", path);
 	printf("%s 2 --net \"10.103.104.25:5555\"\n", path);
+	printf("%s 2 --chan \"shm:/run/vmdisplay-input\"\n", path);
+	printf("\n--chan accepts shm:<path>, tcp:<addr>:<port> and vsock:<cid>:<port>\n");
 }
 
 int main(int argc, char *argv[])
@@ -575,7 +577,8 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	if (strcmp(argv[2], "--net") == 0) {
+	if (strcmp(argv[2], "--net") == 0 ||
+	    strcmp(argv[2], "--chan") == 0) {
 		comm_type = CommunicationChannelNetwork;
 	} else {
 		print_usage(argv[0]);
@@ -47,6 +47,7 @@ struct vm_buffer_info *vbt;
 uint32_t surf_width = 0;
 uint32_t surf_height = 0;
 hyper_dmabuf_id_t hyper_dmabuf_id = { 0, {0, 0, 0} };
+uint64_t current_surface_id = 0;
 
 uint32_t surf_stride[3];
 uint32_t surf_offset[3];
@@ -162,6 +163,7 @@ reread:
 	surf_disp_h = vbt->bbox[3];
 
 	hyper_dmabuf_id = vbt->hyper_dmabuf_id;
+	current_surface_id = vbt->surface_id;
 
 	*counter = vbt->counter;
 
@@ -183,7 +185,7 @@ int parse_socket_metadata(vmdisplay_socket * socket, int *counter)
 
 	if (len <= 0) {
 		int err = errno;
-		printf("recv returned invalid status: %d, errno = %d", len,
+		printf("recv returned invalid status: %d, errno = %d\n", len,
 		       err);
 		return 1;
 	}
@@ -260,6 +262,7 @@ int parse_socket_metadata(vmdisplay_socket * socket, int *counter)
 	surf_disp_h = vbt[surf_index].bbox[3];
 
 	hyper_dmabuf_id = vbt[surf_index].hyper_dmabuf_id;
+	current_surface_id = vbt[surf_index].surface_id;
 
 	*counter = vbt[surf_index].counter;
 
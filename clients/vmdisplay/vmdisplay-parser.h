@@ -49,6 +49,7 @@ extern uint32_t surf_format;
 extern uint32_t surf_tile_format;
 extern uint32_t surf_rotation;
 extern hyper_dmabuf_id_t hyper_dmabuf_id;
+extern uint64_t current_surface_id;
 extern int32_t surf_disp_x;
 extern int32_t surf_disp_y;
 extern int32_t surf_disp_w;
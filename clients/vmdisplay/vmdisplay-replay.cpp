@@ -0,0 +1,308 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-replay.cpp
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay replay: benchmark of the metadata pipeline from a capture
+ *-----------------------------------------------------------------------------
+ */
+
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include "vmdisplay-server-core.h"
+#include "vmdisplay-server-capture.h"
+
+extern "C" {
+#include "vmdisplay-parser.h"
+extern struct vm_header vbt_header;
+}
+
+/* Globals the parser expects from the vmdisplay client */
+int surf_index = 0;
+uint64_t surf_id = 0;
+int use_event_poll = 0;
+unsigned int pipe_id = 0;
+
+/* How many recent deliveries are kept to match parsed frames against */
+#define DELIVERY_RING_SIZE 256
+
+struct delivery {
+	int output;
+	int32_t counter;
+	uint64_t ns;
+};
+
+struct replay_state {
+	pthread_mutex_t lock;
+	struct delivery ring[DELIVERY_RING_SIZE];
+	uint64_t n_delivered;
+};
+
+static void frame_delivered(void *data, int output, int32_t counter,
+			    uint64_t ns)
+{
+	struct replay_state *state = (struct replay_state *)data;
+	struct delivery *d;
+
+	pthread_mutex_lock(&state->lock);
+	d = &state->ring[state->n_delivered++ % DELIVERY_RING_SIZE];
+	d->output = output;
+	d->counter = counter;
+	d->ns = ns;
+	pthread_mutex_unlock(&state->lock);
+}
+
+static bool delivery_time(struct replay_state *state, int output,
+			  int32_t counter, uint64_t *ns)
+{
+	bool found = false;
+	uint64_t i;
+
+	pthread_mutex_lock(&state->lock);
+	for (i = 0; i < state->n_delivered && i < DELIVERY_RING_SIZE; i++) {
+		struct delivery *d = &state->ring[(state->n_delivered - 1 - i) %
+						  DELIVERY_RING_SIZE];
+
+		if (d->output == output && d->counter == counter) {
+			*ns = d->ns;
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&state->lock);
+
+	return found;
+}
+
+static int recvfd(int socket)
+{
+	char tmp_buf[1];
+	struct iovec iovec;
+	struct msghdr hdr;
+	struct cmsghdr *cmsg_hdr;
+	char msg_buf[CMSG_SPACE(sizeof(int))];
+	int fd;
+
+	iovec.iov_base = tmp_buf;
+	iovec.iov_len = sizeof(tmp_buf);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_iov = &iovec;
+	hdr.msg_iovlen = 1;
+	hdr.msg_control = msg_buf;
+	hdr.msg_controllen = sizeof(msg_buf);
+
+	if (recvmsg(socket, &hdr, 0) <= 0)
+		return -1;
+
+	cmsg_hdr = CMSG_FIRSTHDR(&hdr);
+	if (!cmsg_hdr)
+		return -1;
+
+	memcpy(&fd, CMSG_DATA(cmsg_hdr), sizeof(int));
+
+	return fd;
+}
+
+/* Connects the way vmdisplay-wayland does, see vmdisplay_socket_init() */
+static int connect_client(vmdisplay_socket *sock, int domid)
+{
+	struct sockaddr_un addr;
+	struct vmdisplay_msg msg;
+	uint32_t i;
+
+	memset(sock, 0, sizeof(*sock));
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/vmdisplay-%d",
+		 getenv("XDG_RUNTIME_DIR"), domid);
+
+	sock->socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sock->socket_fd < 0)
+		return -1;
+
+	if (connect(sock->socket_fd, (struct sockaddr *)&addr,
+		    sizeof(addr)) < 0 ||
+	    recv(sock->socket_fd, &msg, sizeof(msg), 0) != sizeof(msg) ||
+	    msg.display_num > VM_MAX_OUTPUTS) {
+		printf("Cannot connect to replaying server\n");
+		return -1;
+	}
+
+	for (i = 0; i < msg.display_num; i++) {
+		sock->outputs[i].mem_fd = recvfd(sock->socket_fd);
+		if (sock->outputs[i].mem_fd < 0)
+			return -1;
+
+		sock->outputs[i].mem_addr =
+		    mmap(NULL, METADATA_BUFFER_SIZE, PROT_READ, MAP_SHARED,
+			 sock->outputs[i].mem_fd, 0);
+		if (sock->outputs[i].mem_addr == MAP_FAILED)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void *server_thread_func(void *arg)
+{
+	VMDisplayServer *server = (VMDisplayServer *) arg;
+
+	server->run();
+	/* closes the client socket, which ends the parsing loop */
+	server->cleanup();
+
+	return NULL;
+}
+
+static void print_usage(const char *path)
+{
+	printf("Usage: %s <capture> [--fast] [--loops <n>] [--output <n>]\n",
+	       path);
+	printf("       --fast    replay frames as fast as possible instead of "
+	       "at recorded pace\n");
+	printf("       --loops   play the capture n times\n");
+	printf("       --output  output whose frames are parsed, 0 by default\n");
+	printf("\nCaptures are recorded with vmdisplay-server --record <file>\n");
+}
+
+int main(int argc, char *argv[])
+{
+	VMDisplayServer server;
+	ReplayCommunicator *replay;
+	struct replay_state state;
+	vmdisplay_socket sock;
+	std::vector<uint64_t> latency;
+	pthread_t server_thread;
+	std::string args;
+	uint64_t start, end, delivered, parsed = 0, unmatched = 0;
+	int counter, loops = 1, domid = getpid();
+	bool fast = false;
+	double secs;
+
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--fast") == 0) {
+			fast = true;
+		} else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+			loops = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			pipe_id = atoi(argv[++i]);
+		} else {
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (pipe_id >= VM_MAX_OUTPUTS || loops <= 0) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	memset(&state, 0, sizeof(state));
+	pthread_mutex_init(&state.lock, NULL);
+
+	replay = new ReplayCommunicator();
+	replay->set_loops(loops);
+	replay->set_frame_callback(frame_delivered, &state);
+	/* do not lose the first frames while the client connects */
+	replay->hold();
+	server.set_metadata_communicator(replay);
+
+	args = std::string(fast ? "fast:" : "") + argv[1];
+	if (server.init(domid, CommunicationChannelReplay, args.c_str(),
+			CommunicationChannelNetwork, NULL) < 0) {
+		printf("Cannot replay %s\n", argv[1]);
+		return -1;
+	}
+
+	pthread_create(&server_thread, NULL, server_thread_func, &server);
+
+	if (connect_client(&sock, domid) < 0) {
+		server.stop();
+		replay->start();
+		pthread_join(server_thread, NULL);
+		return -1;
+	}
+
+	start = vmdisplay_capture_now();
+	replay->start();
+
+	while (parse_socket_metadata(&sock, &counter) == 0) {
+		end = vmdisplay_capture_now();
+		parsed++;
+
+		if (delivery_time(&state, pipe_id, vbt_header.counter,
+				  &delivered))
+			latency.push_back(end - delivered);
+		else
+			unmatched++;
+	}
+
+	/* the end of the capture only shows up after the server's poll
+	 * timeout, so throughput is measured up to the last parsed frame */
+	if (!parsed)
+		end = start;
+
+	pthread_join(server_thread, NULL);
+	for (int i = 0; i < VM_MAX_OUTPUTS; i++) {
+		if (sock.outputs[i].mem_addr)
+			munmap(sock.outputs[i].mem_addr, METADATA_BUFFER_SIZE);
+		if (sock.outputs[i].mem_fd > 0)
+			close(sock.outputs[i].mem_fd);
+	}
+	close(sock.socket_fd);
+
+	secs = (end - start) / 1e9;
+	printf("Parsed %llu frames of output %u in %.3f s: %.1f frames/s",
+	       (unsigned long long)parsed, pipe_id, secs,
+	       secs > 0 ? parsed / secs : 0);
+	if (unmatched)
+		printf(", %llu not matched to a replayed frame",
+		       (unsigned long long)unmatched);
+	printf("\n");
+	print_latency_stats("delivery to parse_socket_metadata", latency);
+
+	pthread_mutex_destroy(&state.lock);
+
+	return 0;
+}
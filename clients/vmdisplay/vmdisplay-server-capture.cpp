@@ -0,0 +1,294 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-server-capture.cpp
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay server: recording and replay of communication streams
+ *-----------------------------------------------------------------------------
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "vmdisplay-server-capture.h"
+
+RecordingCommunicator::RecordingCommunicator(HyperCommunicatorInterface *comm,
+					     struct vmdisplay_capture *capture)
+:comm(comm), capture(capture), frame(NULL)
+{
+}
+
+RecordingCommunicator::~RecordingCommunicator()
+{
+	delete comm;
+	delete[]frame;
+}
+
+int RecordingCommunicator::init(int domid, HyperCommunicatorDirection dir,
+				const char *args)
+{
+	if (dir == HyperCommunicatorInterface::Receiver)
+		frame = new char[METADATA_BUFFER_SIZE + 2 * sizeof(int)];
+
+	return comm->init(domid, dir, args);
+}
+
+void RecordingCommunicator::cleanup()
+{
+	comm->cleanup();
+}
+
+int RecordingCommunicator::recv_data(void *data, int len)
+{
+	int ret = comm->recv_data(data, len);
+
+	if (ret > 0)
+		vmdisplay_capture_write(capture, VMDISPLAY_CAPTURE_INPUT,
+					data, ret);
+
+	return ret;
+}
+
+int RecordingCommunicator::send_data(const void *data, int len)
+{
+	int ret = comm->send_data(data, len);
+
+	if (ret > 0)
+		vmdisplay_capture_write(capture, VMDISPLAY_CAPTURE_INPUT,
+					data, ret);
+
+	return ret;
+}
+
+/*
+ * Every communicator leaves a frame in the same shape, a vm_header
+ * followed by n_buffers vm_buffer_info, so frames are recorded from there
+ * and framed like they are on the metadata stream.
+ */
+int RecordingCommunicator::recv_metadata(void **surfaces_metadata)
+{
+	const struct vm_header *header;
+	size_t len;
+	int output;
+	int end = METADATA_STREAM_END;
+	int start = METADATA_STREAM_START;
+
+	output = comm->recv_metadata(surfaces_metadata);
+	if (output < 0 || output >= VM_MAX_OUTPUTS)
+		return output;
+
+	header = (const struct vm_header *)surfaces_metadata[output];
+	len = sizeof(struct vm_header);
+	if (header->n_buffers > 0)
+		len += header->n_buffers * sizeof(struct vm_buffer_info);
+	if (len > METADATA_BUFFER_SIZE)
+		len = METADATA_BUFFER_SIZE;
+
+	memcpy(frame, &start, sizeof(int));
+	memcpy(frame + sizeof(int), header, len);
+	memcpy(frame + sizeof(int) + len, &end, sizeof(int));
+	vmdisplay_capture_write(capture, VMDISPLAY_CAPTURE_METADATA, frame,
+				len + 2 * sizeof(int));
+
+	return output;
+}
+
+ReplayCommunicator::ReplayCommunicator()
+:reader(NULL), fast(false), loops(1), held(false), frame_func(NULL),
+frame_data(NULL), first_ts(0), base_ns(0), start_ns(0), end_ns(0), frames(0),
+bytes(0)
+{
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&cond, NULL);
+}
+
+ReplayCommunicator::~ReplayCommunicator()
+{
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&lock);
+}
+
+int ReplayCommunicator::init(int domid, HyperCommunicatorDirection dir,
+			     const char *args)
+{
+	UNUSED(domid);
+
+	if (dir != HyperCommunicatorInterface::Receiver)
+		return -1;
+
+	if (strncmp(args, "fast:", 5) == 0) {
+		fast = true;
+		args += 5;
+	}
+
+	reader = vmdisplay_capture_reader_open(args);
+	if (!reader)
+		return -1;
+
+	return 0;
+}
+
+void ReplayCommunicator::cleanup()
+{
+	double secs;
+
+	/* let a waiting recv_metadata through so its thread can finish */
+	start();
+
+	if (!reader)
+		return;
+
+	vmdisplay_capture_reader_close(reader);
+	reader = NULL;
+
+	if (!frames)
+		return;
+
+	secs = (end_ns - start_ns) / 1e9;
+	printf("Replayed %llu frames in %.3f s: %.1f frames/s, %.2f MB/s\n",
+	       (unsigned long long)frames, secs, secs > 0 ? frames / secs : 0,
+	       secs > 0 ? bytes / secs / 1e6 : 0);
+	print_latency_stats("recv_metadata", parse_ns);
+}
+
+void ReplayCommunicator::set_loops(int n)
+{
+	loops = n;
+}
+
+void ReplayCommunicator::set_frame_callback(replay_frame_func_t func,
+					    void *data)
+{
+	frame_func = func;
+	frame_data = data;
+}
+
+void ReplayCommunicator::hold()
+{
+	pthread_mutex_lock(&lock);
+	held = true;
+	pthread_mutex_unlock(&lock);
+}
+
+void ReplayCommunicator::start()
+{
+	pthread_mutex_lock(&lock);
+	held = false;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+}
+
+void ReplayCommunicator::wait_for_start()
+{
+	pthread_mutex_lock(&lock);
+	while (held)
+		pthread_cond_wait(&cond, &lock);
+	pthread_mutex_unlock(&lock);
+}
+
+int ReplayCommunicator::recv_metadata(void **surfaces_metadata)
+{
+	struct vmdisplay_capture_record record;
+	struct timespec ts;
+	uint64_t target, t0, t1;
+	int output;
+
+	if (!reader)
+		return -1;
+
+	wait_for_start();
+	if (!start_ns)
+		start_ns = vmdisplay_capture_now();
+
+	while (1) {
+		if (!vmdisplay_capture_reader_next(reader, &record)) {
+			if (--loops <= 0) {
+				end_ns = vmdisplay_capture_now();
+				printf("End of capture\n");
+				return -1;
+			}
+			vmdisplay_capture_reader_rewind(reader);
+			base_ns = 0;
+			continue;
+		}
+
+		if (record.type != VMDISPLAY_CAPTURE_METADATA)
+			continue;
+
+		if (!base_ns) {
+			base_ns = vmdisplay_capture_now();
+			first_ts = record.timestamp_ns;
+		}
+
+		if (!fast && record.timestamp_ns > first_ts) {
+			target = base_ns + (record.timestamp_ns - first_ts);
+			ts.tv_sec = target / 1000000000ULL;
+			ts.tv_nsec = target % 1000000000ULL;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					       &ts, NULL) == EINTR)
+				;
+		}
+
+		t0 = vmdisplay_capture_now();
+		output = copy_metadata_frame((const char *)record.data,
+					     record.len, surfaces_metadata);
+		t1 = vmdisplay_capture_now();
+		if (output < 0)
+			continue;
+
+		parse_ns.push_back(t1 - t0);
+		frames++;
+		bytes += record.len;
+		end_ns = t1;
+
+		if (frame_func)
+			frame_func(frame_data, output,
+				   ((struct vm_header *)
+				    surfaces_metadata[output])->counter, t1);
+
+		return output;
+	}
+}
+
+void print_latency_stats(const char *name, std::vector<uint64_t> &samples)
+{
+	uint64_t sum = 0;
+	size_t n = samples.size();
+
+	if (!n)
+		return;
+
+	std::sort(samples.begin(), samples.end());
+	for (size_t i = 0; i < n; i++)
+		sum += samples[i];
+
+	printf("%s latency (us): avg %.2f, p50 %.2f, p99 %.2f, max %.2f\n",
+	       name, sum / 1e3 / n, samples[n / 2] / 1e3,
+	       samples[(n * 99) / 100] / 1e3, samples[n - 1] / 1e3);
+}
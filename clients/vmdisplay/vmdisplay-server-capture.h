@@ -0,0 +1,119 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-server-capture.h
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay server: recording and replay of communication streams
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _VMDISPLAY_SERVER_CAPTURE_H_
+#define _VMDISPLAY_SERVER_CAPTURE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+#include "vmdisplay-server.h"
+#include "vmdisplay-capture.h"
+#include "vm-shared.h"
+
+/*
+ * Wraps another communicator and records everything that goes through it
+ * to a capture file: whole metadata frames on the receiving side and the
+ * raw input stream on the sending side. Takes ownership of the wrapped
+ * communicator, the capture stays owned by the caller.
+ */
+class RecordingCommunicator:public HyperCommunicatorInterface {
+public:
+	RecordingCommunicator(HyperCommunicatorInterface *comm,
+			      struct vmdisplay_capture *capture);
+	~RecordingCommunicator();
+
+	int init(int domid, HyperCommunicatorDirection direction,
+		 const char *args);
+	void cleanup();
+	int recv_data(void *data, int len);
+	int send_data(const void *data, int len);
+	int recv_metadata(void **surfaces_metadata);
+
+private:
+	HyperCommunicatorInterface *comm;
+	struct vmdisplay_capture *capture;
+	char *frame;
+};
+
+typedef void (*replay_frame_func_t)(void *data, int output, int32_t counter,
+				    uint64_t delivered_ns);
+
+/*
+ * Plays back the metadata frames of a capture file through recv_metadata,
+ * either at the pace they were recorded at or as fast as possible. The
+ * args are the capture path, prefixed with "fast:" to not pace frames.
+ */
+class ReplayCommunicator:public HyperCommunicatorInterface {
+public:
+	ReplayCommunicator();
+	~ReplayCommunicator();
+
+	int init(int domid, HyperCommunicatorDirection direction,
+		 const char *args);
+	void cleanup();
+	int recv_metadata(void **surfaces_metadata);
+
+	void set_loops(int loops);
+	void set_frame_callback(replay_frame_func_t func, void *data);
+	/* keeps recv_metadata waiting until start() is called */
+	void hold();
+	void start();
+
+private:
+	void wait_for_start();
+
+	struct vmdisplay_capture_reader *reader;
+	bool fast;
+	int loops;
+
+	bool held;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	replay_frame_func_t frame_func;
+	void *frame_data;
+
+	/* pacing: capture time of the first frame and when it was replayed */
+	uint64_t first_ts;
+	uint64_t base_ns;
+
+	uint64_t start_ns;
+	uint64_t end_ns;
+	uint64_t frames;
+	uint64_t bytes;
+	std::vector<uint64_t> parse_ns;
+};
+
+void print_latency_stats(const char *name, std::vector<uint64_t> &samples);
+
+#endif // _VMDISPLAY_SERVER_CAPTURE_H_
@@ -0,0 +1,282 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-server-channel.cpp
+ *-----------------------------------------------------------------------------
+ * Copyright 2012-2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay server: vm-channel communicator
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "vmdisplay-server-channel.h"
+#include "vm-shared.h"
+#include "shared/vm-channel.h"
+
+/* How long a sender keeps retrying a full channel before dropping data */
+#define CHANNEL_SEND_RETRY_US 100
+#define CHANNEL_SEND_RETRIES 1000
+/* How long a receiver waits for its peer when starting up */
+#define CHANNEL_CONNECT_TIMEOUT_MS 1000
+
+int ChannelCommunicator::init(int domid, HyperCommunicatorDirection dir,
+			      const char *args)
+{
+	enum vm_channel_role role;
+
+	UNUSED(domid);
+
+	direction = dir;
+	role = (dir == HyperCommunicatorInterface::Receiver) ?
+	    VM_CHANNEL_CLIENT : VM_CHANNEL_SERVER;
+
+	channel = vm_channel_create(args, role);
+	if (!channel) {
+		printf("Cannot open channel %s: %s\n", args, strerror(errno));
+		return -1;
+	}
+
+	/*
+	 * Receivers used to fail straight away when the peer was not there;
+	 * keep that behaviour, the channel reconnects on its own afterwards.
+	 */
+	if (role == VM_CHANNEL_CLIENT &&
+	    !vm_channel_wait_connected(channel, CHANNEL_CONNECT_TIMEOUT_MS)) {
+		printf("cannot connect\n");
+		cleanup();
+		return -1;
+	}
+
+	return 0;
+}
+
+void ChannelCommunicator::cleanup()
+{
+	release_message();
+	vm_channel_destroy(channel);
+	channel = NULL;
+	delete[]stream;
+	stream = NULL;
+	stream_len = 0;
+}
+
+void ChannelCommunicator::release_message()
+{
+	if (msg && channel)
+		vm_channel_recv_release(channel);
+	msg = NULL;
+	msg_len = 0;
+	msg_offset = 0;
+}
+
+/*
+ * Makes sure there is a message to read from, blocking until one arrives.
+ * Returns -1 once the peer went away.
+ */
+int ChannelCommunicator::next_message()
+{
+	const void *data;
+	size_t len;
+	int ret;
+
+	while (!msg) {
+		ret = vm_channel_recv(channel, &data, &len, -1);
+		if (ret < 0)
+			return -1;
+		if (ret == 0)
+			continue;
+
+		if (len == 0) {
+			vm_channel_recv_release(channel);
+			continue;
+		}
+
+		msg = (const char *)data;
+		msg_len = len;
+		msg_offset = 0;
+	}
+
+	return 0;
+}
+
+int ChannelCommunicator::recv_data(void *buffer, int max_len)
+{
+	size_t len;
+
+	if (direction != HyperCommunicatorInterface::Receiver || !channel ||
+	    max_len <= 0)
+		return -1;
+
+	if (next_message() < 0)
+		return -1;
+
+	len = msg_len - msg_offset;
+	if (len > (size_t) max_len)
+		len = max_len;
+
+	memcpy(buffer, msg + msg_offset, len);
+	msg_offset += len;
+	if (msg_offset == msg_len)
+		release_message();
+
+	return len;
+}
+
+/*
+ * A metadata message carries exactly one frame, framed by
+ * METADATA_STREAM_START and METADATA_STREAM_END. Copies the frame into the
+ * buffer of its output and returns the output, or -1 if the message is
+ * not a valid frame.
+ */
+int copy_metadata_frame(const char *msg, size_t len, void **surfaces_metadata)
+{
+	const struct vm_header *header;
+	size_t payload;
+	int output_num;
+
+	if (len < 2 * sizeof(int) + sizeof(struct vm_header) ||
+	    *(const int *)msg != METADATA_STREAM_START ||
+	    *(const int *)(msg + len - sizeof(int)) != METADATA_STREAM_END)
+		return -1;
+
+	header = (const struct vm_header *)(msg + sizeof(int));
+	payload = len - 2 * sizeof(int);
+	output_num = header->output;
+	if (output_num < 0 || output_num >= VM_MAX_OUTPUTS ||
+	    payload > METADATA_BUFFER_SIZE)
+		return -1;
+
+	memcpy(surfaces_metadata[output_num], header, payload);
+
+	return output_num;
+}
+
+/*
+ * The unframed stream carries frames back to back, each one from a
+ * METADATA_STREAM_START marker to the METADATA_STREAM_END marker after it.
+ * Bytes are collected until a whole frame is there; a buffer that fills up
+ * without one keeps only what follows the last start marker.
+ */
+int ChannelCommunicator::recv_stream_metadata(void **surfaces_metadata)
+{
+	const size_t size = METADATA_BUFFER_SIZE + 2 * sizeof(int);
+	size_t i, start, end;
+	int marker, len, output_num;
+
+	if (!stream)
+		stream = new char[size];
+
+	while (1) {
+		start = size;
+		end = 0;
+		for (i = 0; i + sizeof(int) <= stream_len; i++) {
+			memcpy(&marker, stream + i, sizeof(int));
+			if (marker == METADATA_STREAM_START) {
+				start = i;
+			} else if (marker == METADATA_STREAM_END &&
+				   start < i) {
+				end = i + sizeof(int);
+				break;
+			}
+		}
+
+		if (end) {
+			output_num = copy_metadata_frame(stream + start,
+							 end - start,
+							 surfaces_metadata);
+			memmove(stream, stream + end, stream_len - end);
+			stream_len -= end;
+			if (output_num >= 0)
+				return output_num;
+			continue;
+		}
+
+		if (stream_len == size) {
+			/* a frame from the very start cannot fit at all */
+			if (start == 0 || start == size)
+				start = stream_len;
+			memmove(stream, stream + start, stream_len - start);
+			stream_len -= start;
+		}
+
+		len = recv_data(stream + stream_len, size - stream_len);
+		if (len < 0)
+			return -1;
+		stream_len += len;
+	}
+}
+
+/*
+ * Every message on a framed channel is a whole frame, so there is no
+ * stream to scan: the frame is copied straight out of the receive buffer.
+ */
+int ChannelCommunicator::recv_metadata(void **surfaces_metadata)
+{
+	int output_num;
+
+	if (direction != HyperCommunicatorInterface::Receiver || !channel)
+		return -1;
+
+	if (!vm_channel_is_framed(channel))
+		return recv_stream_metadata(surfaces_metadata);
+
+	while (1) {
+		/* drop whatever recv_data left behind */
+		release_message();
+		if (next_message() < 0)
+			return -1;
+
+		output_num = copy_metadata_frame(msg, msg_len,
+						 surfaces_metadata);
+		release_message();
+		if (output_num >= 0)
+			return output_num;
+	}
+}
+
+int ChannelCommunicator::send_data(const void *buffer, int len)
+{
+	int ret = -1;
+	int retries = 0;
+
+	if (direction != HyperCommunicatorInterface::Sender || !channel)
+		return -1;
+
+	/* Input events are tiny, so a full channel means the peer is stuck;
+	 * give it a short while before dropping the event. */
+	while ((ret = vm_channel_send(channel, buffer, len)) == 0 &&
+	       retries++ < CHANNEL_SEND_RETRIES)
+		usleep(CHANNEL_SEND_RETRY_US);
+
+	/* nothing else would push out a tail the socket left queued */
+	while (ret > 0 && vm_channel_flush(channel) > 0 &&
+	       retries++ < CHANNEL_SEND_RETRIES)
+		usleep(CHANNEL_SEND_RETRY_US);
+
+	return ret > 0 ? ret : -1;
+}
@@ -1,6 +1,6 @@
 /*
  *-----------------------------------------------------------------------------
- * Filename: vmdisplay-server-network.cpp
+ * Filename: vmdisplay-server-channel.h
  *-----------------------------------------------------------------------------
  * Copyright 2012-2018 Intel Corporation
  *
@@ -26,33 +26,49 @@
  * SOFTWARE.
  *-----------------------------------------------------------------------------
  * Description:
- *   VMDisplay server: Header file for socket related functions
+ *   VMDisplay server: Header file for vm-channel communicator
  *-----------------------------------------------------------------------------
  */
-#ifndef _VMDISPLAY_SERVER_NETWORK_H_
-#define _VMDISPLAY_SERVER_NETWORK_H_
+#ifndef _VMDISPLAY_SERVER_CHANNEL_H_
+#define _VMDISPLAY_SERVER_CHANNEL_H_
 
+#include <stddef.h>
 #include "vmdisplay-server.h"
-#include <pthread.h>
 
-class NetworkCommunicator:public HyperCommunicatorInterface {
+struct vm_channel;
+
+/*
+ * Communicator built on the shared vm-channel transport. The args string
+ * is a channel spec (shm:<path>, tcp:<addr>:<port>, vsock:<cid>:<port>);
+ * a bare <addr>:<port> is the unframed TCP stream --net always spoke, in
+ * which metadata frames are found by their start and end markers.
+ */
+class ChannelCommunicator:public HyperCommunicatorInterface {
 public:
+	ChannelCommunicator():channel(NULL), msg(NULL), msg_len(0),
+	    msg_offset(0), stream(NULL), stream_len(0) { }
+
 	int init(int domid, HyperCommunicatorDirection direction,
-		 const char *name);
+		 const char *args);
 	void cleanup();
 	int recv_data(void *data, int len);
 	int send_data(const void *data, int len);
 	int recv_metadata(void **surfaces_metadata);
 
-	void listen_for_connection();
 private:
-	 HyperCommunicatorDirection direction;
-	int sock_fd;
-	int client_sock_fd;
-	pthread_t listener_thread;
-	bool running;
-	char *metadata;
-	int metadata_offset;
+	int next_message();
+	void release_message();
+	int recv_stream_metadata(void **surfaces_metadata);
+
+	HyperCommunicatorDirection direction;
+	struct vm_channel *channel;
+	/* message currently being consumed by recv_data */
+	const char *msg;
+	size_t msg_len;
+	size_t msg_offset;
+	/* unframed channels: bytes received but not yet part of a frame */
+	char *stream;
+	size_t stream_len;
 };
 
-#endif // _VMDISPLAY_SERVER_NETWORK_H_
+#endif // _VMDISPLAY_SERVER_CHANNEL_H_
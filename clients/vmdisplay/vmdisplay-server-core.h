@@ -0,0 +1,102 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-server-core.h
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay server: server instance shared by its tools
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _VMDISPLAY_SERVER_CORE_H_
+#define _VMDISPLAY_SERVER_CORE_H_
+
+#include <pthread.h>
+#include <vector>
+#include "vm-shared.h"
+#include "vmdisplay-shared.h"
+#include "vmdisplay-server.h"
+#include "vmdisplay-capture.h"
+
+/*
+ * Number of pending connections that can be queued,
+ * until new vmdisplay-wayland instances will be getting
+ * error during connection
+ */
+#define SOCKET_BACKLOG 25
+
+struct output_data {
+	/*
+	 * File descriptor to anonymous
+	 * file that will contain metadata
+	 * of surfaces placed on given output
+	 */
+	int shm_fd;
+
+	/* Address of mmaped metadata file */
+	void *shm_addr;
+};
+
+class VMDisplayServer {
+public:
+	VMDisplayServer():hyper_comm_metadata(NULL), hyper_comm_input(NULL),
+	    capture(NULL), running(false), current_buf(NULL), domid(-1) {
+	} int init(int domid,
+		   CommunicationChannelType surf_comm_type,
+		   const char *surf_comm_args,
+		   CommunicationChannelType input_comm_type,
+		   const char *input_comm_args);
+	int cleanup();
+	int run();
+	void stop();
+	int process_metadata();
+	int process_input();
+	int set_recording(const char *path);
+	void set_metadata_communicator(HyperCommunicatorInterface *comm);
+private:
+	int receive_metadata(char *buffer, int len);
+	int send_message(int clinet_socket_fd,
+			 enum vmdisplay_msg_type type, int32_t data);
+	int init_outputs();
+
+	HyperCommunicatorInterface *hyper_comm_metadata;
+	HyperCommunicatorInterface *hyper_comm_input;
+	struct vmdisplay_capture *capture;
+	bool running;
+	pthread_t metadata_thread;
+	pthread_t input_thread;
+	pthread_mutex_t mutex;
+	int server_socket;
+	std::vector < int >client_sockets;
+
+	char *current_buf;
+	int current_buf_len;
+
+	int domid;
+	char socket_path[100];
+	struct output_data outputs[VM_MAX_OUTPUTS];
+};
+
+#endif // _VMDISPLAY_SERVER_CORE_H_
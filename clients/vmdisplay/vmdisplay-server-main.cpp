@@ -0,0 +1,140 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: vmdisplay-server-main.cpp
+ *-----------------------------------------------------------------------------
+ * Copyright 2012-2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   VMDisplay server: command line tool
+ *-----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "vmdisplay-server-core.h"
+
+static VMDisplayServer *vm_display_server = NULL;
+
+static void signal_int(int signum)
+{
+	UNUSED(signum);
+
+	if (vm_display_server)
+		vm_display_server->stop();
+}
+
+void signal_callback_handler(int signum)
+{
+	printf("Caught signal SIGPIPE %d\n", signum);
+}
+
+void print_usage(const char *path)
+{
+	printf
+	    ("Usage: %s <dom_id> <surf_comm_type> <surf_comm_arg> <input_comm_type> <input_comm_args> [--record <file>]\n",
+	     path);
+	printf
+	    ("       dom_id if of remote domain that will be sharing surfaces\n");
+	printf
+	    ("       surf_comm_type type of communication channel used by remote domain to share surfaces metadata\n");
+	printf
+	    ("       surf_comm_arg communication channel specific arguments\n\n");
+	printf
+	    ("       input_comm_type type of communication channel used by local domain to share input\n");
+	printf
+	    ("       input_comm_arg communication channel specific arguments\n");
+	printf
+	    ("       --record <file> records metadata and input streams to file\n\n");
+	printf("e.g.:\n");
+	printf("%s 2 --xen \"shared_surfaces\" --xen \"shared_input\"\n", path);
+	printf("%s 2 --net \"10.103.104.25:5555\" --net \"0:5554\"\n", path);
+	printf("%s 2 --chan \"vsock:2:5555\" --chan \"shm:/run/vmdisplay-input\"\n",
+	       path);
+	printf("%s 2 --replay \"fast:capture.vmd\" --net \"0:5554\"\n", path);
+	printf("\n--chan accepts shm:<path>, tcp:<addr>:<port> and vsock:<cid>:<port>\n");
+	printf("--replay plays back a recorded capture, at full speed with fast:\n");
+}
+
+int main(int argc, char *argv[])
+{
+	VMDisplayServer server;
+	struct sigaction sigint;
+	CommunicationChannelType surf_comm_type;
+	CommunicationChannelType input_comm_type;
+
+	sigint.sa_handler = signal_int;
+	sigemptyset(&sigint.sa_mask);
+	sigint.sa_flags = SA_RESETHAND;
+	sigaction(SIGINT, &sigint, NULL);
+
+	signal(SIGPIPE, signal_callback_handler);
+
+	if (argc < 6) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	if (strcmp(argv[2], "--net") == 0 ||
+	    strcmp(argv[2], "--chan") == 0) {
+		surf_comm_type = CommunicationChannelNetwork;
+	} else if (strcmp(argv[2], "--hdma") == 0) {
+		surf_comm_type = CommunicationChannelHyperDMABUF;
+	} else if (strcmp(argv[2], "--replay") == 0) {
+		surf_comm_type = CommunicationChannelReplay;
+	} else {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	if (strcmp(argv[4], "--net") == 0 ||
+	    strcmp(argv[4], "--chan") == 0) {
+		input_comm_type = CommunicationChannelNetwork;
+	} else {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	if (argc >= 8 && strcmp(argv[6], "--record") == 0) {
+		if (server.set_recording(argv[7]) < 0)
+			return -1;
+	} else if (argc > 6) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	if (server.init(atoi(argv[1]), surf_comm_type, argv[3],
+			input_comm_type, argv[5]) < 0) {
+		printf("Server init failed\n");
+		return -1;
+	}
+	printf("Starting vmdisplay server for domain %d\n", atoi(argv[1]));
+	vm_display_server = &server;
+
+	server.run();
+	server.cleanup();
+
+	return 0;
+}
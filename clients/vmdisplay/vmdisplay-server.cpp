@@ -50,64 +50,10 @@
 #include "vm-shared.h"
 #include "vmdisplay-shared.h"
 #include "vmdisplay-server.h"
+#include "vmdisplay-server-core.h"
 #include "vmdisplay-server-hyperdmabuf.h"
-#include "vmdisplay-server-network.h"
-
-/*
- * Number of pending connections that can be queued,
- * until new vmdisplay-wayland instances will be getting
- * error during connection
- */
-#define SOCKET_BACKLOG 25
-
-struct output_data {
-	/*
-	 * File descriptor to anonymous
-	 * file that will contain metadata
-	 * of surfaces placed on given output
-	 */
-	int shm_fd;
-
-	/* Address of mmaped metadata file */
-	void *shm_addr;
-};
-
-class VMDisplayServer {
-public:
-	VMDisplayServer():hyper_comm_metadata(NULL), hyper_comm_input(NULL),
-	    running(false), current_buf(NULL), domid(-1) {
-	} int init(int domid,
-		   CommunicationChannelType surf_comm_type,
-		   const char *surf_comm_args,
-		   CommunicationChannelType input_comm_type,
-		   const char *input_comm_args);
-	int cleanup();
-	int run();
-	void stop();
-	int process_metadata();
-	int process_input();
-private:
-	int receive_metadata(char *buffer, int len);
-	int send_message(int clinet_socket_fd,
-			 enum vmdisplay_msg_type type, int32_t data);
-	int init_outputs();
-
-	HyperCommunicatorInterface *hyper_comm_metadata;
-	HyperCommunicatorInterface *hyper_comm_input;
-	bool running;
-	pthread_t metadata_thread;
-	pthread_t input_thread;
-	pthread_mutex_t mutex;
-	int server_socket;
-	std::vector < int >client_sockets;
-
-	char *current_buf;
-	int current_buf_len;
-
-	int domid;
-	char socket_path[100];
-	struct output_data outputs[VM_MAX_OUTPUTS];
-};
+#include "vmdisplay-server-channel.h"
+#include "vmdisplay-server-capture.h"
 
 void *metadata_processing_thread(void *arg)
 {
@@ -221,16 +167,26 @@ int VMDisplayServer::init(int domid,
 	current_buf = new char[METADATA_BUFFER_SIZE];
 	current_buf_len = 0;
 
-	switch (surf_comm_type) {
-	case CommunicationChannelNetwork:
-		hyper_comm_metadata = new NetworkCommunicator();
-		break;
+	if (!hyper_comm_metadata) {
+		switch (surf_comm_type) {
+		case CommunicationChannelNetwork:
+			hyper_comm_metadata = new ChannelCommunicator();
+			break;
+
+		case CommunicationChannelHyperDMABUF:
+			hyper_comm_metadata = new HyperDMABUFCommunicator();
+			break;
 
-	case CommunicationChannelHyperDMABUF:
-		hyper_comm_metadata = new HyperDMABUFCommunicator();
-		break;
+		case CommunicationChannelReplay:
+			hyper_comm_metadata = new ReplayCommunicator();
+			break;
+		}
 	}
 
+	if (capture)
+		hyper_comm_metadata =
+		    new RecordingCommunicator(hyper_comm_metadata, capture);
+
 	if (hyper_comm_metadata->
 	    init(domid, HyperCommunicatorInterface::Receiver, surf_comm_args)) {
 		printf("Compositor not running in domain %d ?\n", domid);
@@ -240,22 +196,30 @@ int VMDisplayServer::init(int domid,
 		return -1;
 	}
 
-	switch (input_comm_type) {
-	case CommunicationChannelNetwork:
-		hyper_comm_input = new NetworkCommunicator();
-		break;
-	default:
-		printf("Only Network communication channel is supported\n");
-		cleanup();
-		return -1;
-	}
+	/* Replaying a capture does not need anybody to take the input */
+	if (input_comm_args) {
+		switch (input_comm_type) {
+		case CommunicationChannelNetwork:
+			hyper_comm_input = new ChannelCommunicator();
+			break;
+		default:
+			printf("Only Network communication channel is supported\n");
+			cleanup();
+			return -1;
+		}
 
-	if (hyper_comm_input->init(domid, HyperCommunicatorInterface::Sender,
-				   input_comm_args)) {
-		delete hyper_comm_input;
-		hyper_comm_input = NULL;
-		cleanup();
-		return -1;
+		if (capture)
+			hyper_comm_input =
+			    new RecordingCommunicator(hyper_comm_input, capture);
+
+		if (hyper_comm_input->init(domid,
+					   HyperCommunicatorInterface::Sender,
+					   input_comm_args)) {
+			delete hyper_comm_input;
+			hyper_comm_input = NULL;
+			cleanup();
+			return -1;
+		}
 	}
 
 	if (init_outputs() < 0) {
@@ -328,9 +292,32 @@ int VMDisplayServer::cleanup()
 		current_buf = NULL;
 	}
 
+	vmdisplay_capture_destroy(capture);
+	capture = NULL;
+
 	return 0;
 }
 
+/*
+ * Records the metadata and input streams of the session to path.
+ * Has to be called before init().
+ */
+int VMDisplayServer::set_recording(const char *path)
+{
+	capture = vmdisplay_capture_create(path);
+
+	return capture ? 0 : -1;
+}
+
+/*
+ * Makes init() use comm as metadata source instead of creating one for the
+ * given channel type. The server takes ownership of comm.
+ */
+void VMDisplayServer::set_metadata_communicator(HyperCommunicatorInterface *comm)
+{
+	hyper_comm_metadata = comm;
+}
+
 int VMDisplayServer::run()
 {
 	int client_sockfd;
@@ -558,87 +545,3 @@ int VMDisplayServer::send_message(int client_socket_fd,
 	msg.display_num = data;
 	return send(client_socket_fd, &msg, sizeof(msg), 0);
 }
-
-static VMDisplayServer *vm_display_server = NULL;
-
-static void signal_int(int signum)
-{
-	UNUSED(signum);
-
-	if (vm_display_server)
-		vm_display_server->stop();
-}
-
-void signal_callback_handler(int signum)
-{
-	printf("Caught signal SIGPIPE %d\n", signum);
-}
-
-void print_usage(const char *path)
-{
-	printf
-	    ("Usage: %s <dom_id> <surf_comm_type> <surf_comm_arg> <input_comm_type> <input_comm_args>\n",
-	     path);
-	printf
-	    ("       dom_id if of remote domain that will be sharing surfaces\n");
-	printf
-	    ("       surf_comm_type type of communication channel used by remote domain to share surfaces metadata\n");
-	printf
-	    ("       surf_comm_arg communication channel specific arguments\n\n");
-	printf
-	    ("       input_comm_type type of communication channel used by local domain to share input\n");
-	printf
-	    ("       input_comm_arg communication channel specific arguments\n\n");
-	printf("e.g.:\n");
-	printf("%s 2 --xen \"shared_surfaces\" --xen \"shared_input\"\n", path);
-	printf("%s 2 --net \"10.103.104.25:5555\" --net \"0:5554\"\n", path);
-}
-
-int main(int argc, char *argv[])
-{
-	VMDisplayServer server;
-	struct sigaction sigint;
-	CommunicationChannelType surf_comm_type;
-	CommunicationChannelType input_comm_type;
-
-	sigint.sa_handler = signal_int;
-	sigemptyset(&sigint.sa_mask);
-	sigint.sa_flags = SA_RESETHAND;
-	sigaction(SIGINT, &sigint, NULL);
-
-	signal(SIGPIPE, signal_callback_handler);
-
-	if (argc < 6) {
-		print_usage(argv[0]);
-		return -1;
-	}
-
-	if (strcmp(argv[2], "--net") == 0) {
-		surf_comm_type = CommunicationChannelNetwork;
-	} else if (strcmp(argv[2], "--hdma") == 0) {
-		surf_comm_type = CommunicationChannelHyperDMABUF;
-	} else {
-		print_usage(argv[0]);
-		return -1;
-	}
-
-	if (strcmp(argv[4], "--net") == 0) {
-		input_comm_type = CommunicationChannelNetwork;
-	} else {
-		print_usage(argv[0]);
-		return -1;
-	}
-
-	if (server.init(atoi(argv[1]), surf_comm_type, argv[3],
-			input_comm_type, argv[5]) < 0) {
-		printf("Server init failed\n");
-		return -1;
-	}
-	printf("Starting vmdisplay server for domain %d\n", atoi(argv[1]));
-	vm_display_server = &server;
-
-	server.run();
-	server.cleanup();
-
-	return 0;
-}
@@ -33,6 +33,8 @@
 #ifndef _VMDISPLAY_SERVER_H_
 #define _VMDISPLAY_SERVER_H_
 
+#include <stddef.h>
+
 #ifndef UNUSED
 #define UNUSED(a) (void) a
 #endif
@@ -65,4 +67,6 @@ public:
 	virtual int recv_metadata(void **surfaces_metadata) = 0;
 };
 
+int copy_metadata_frame(const char *msg, size_t len, void **surfaces_metadata);
+
 #endif // _VMDISPLAY_SERVER_H_
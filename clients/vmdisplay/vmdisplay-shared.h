@@ -38,6 +38,7 @@
 enum CommunicationChannelType {
 	CommunicationChannelNetwork = 0,
 	CommunicationChannelHyperDMABUF,
+	CommunicationChannelReplay,
 };
 
 enum vmdisplay_msg_type {
@@ -54,6 +54,7 @@
 #include "vmdisplay.h"
 
 #include "vmdisplay-parser.h"
+#include "vmdisplay-buffer-cache.h"
 #include "wayland-drm-client-protocol.h"
 #include "linux-dmabuf-unstable-v1-client-protocol.h"
 
@@ -1123,7 +1124,10 @@ static void usage(int error_code)
 		"  -H\tWindow height\n"
 		"  -W\tWindow width\n"
 		"  -d\tDisplay number\n"
-		"  -w\tUse wl_drm for rendering\n" "  -h\tThis help text\n\n");
+		"  -w\tUse wl_drm for rendering\n"
+		"  -c\tNumber of imported buffers cached per surface (default %d)\n"
+		"  -h\tThis help text\n\n",
+		VMDISPLAY_BUFFER_CACHE_DEFAULT_CAPACITY);
 	exit(error_code);
 }
 
@@ -1136,6 +1140,7 @@ int main(int argc, char **argv)
 	struct window window = { 0 };
 	int i, ret = 0;
 	int domid;
+	int cache_capacity = VMDISPLAY_BUFFER_CACHE_DEFAULT_CAPACITY;
 
 	if (argc < 3) {
 		usage(EXIT_SUCCESS);
@@ -1173,6 +1178,10 @@ int main(int argc, char **argv)
 			use_egl = 0;
 		} else if (strcmp("-e", argv[i]) == 0) {
 			use_event_poll = 1;
+		} else if (strcmp("-c", argv[i]) == 0) {
+			cache_capacity = atoi(argv[i + 1]);
+			if (cache_capacity <= 0)
+				usage(EXIT_FAILURE);
 		} else if (strcmp("-h", argv[i]) == 0)
 			usage(EXIT_SUCCESS);
 	}
@@ -1180,7 +1189,7 @@ int main(int argc, char **argv)
 	domid = atoi(argv[1]);
 	open_drm();
 
-	init_buffers();
+	init_buffers(cache_capacity);
 
 	if (g_Dbg) {
 		printf("Debug:%d h:%d w:%d\n", g_Dbg, window.window_size.height,
@@ -1228,6 +1237,7 @@ int main(int argc, char **argv)
 		ret = wl_display_dispatch(display.display);
 
 	clear_hyper_dmabuf_list();
+	fini_buffers();
 
 	destroy_surface(&window);
 	if (use_egl)
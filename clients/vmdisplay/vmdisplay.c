@@ -66,6 +66,7 @@
 
 #include "vmdisplay.h"
 #include "vmdisplay-parser.h"
+#include "vmdisplay-buffer-cache.h"
 
 #ifndef DRM_FORMAT_R8
 #define DRM_FORMAT_R8            fourcc_code('R', '8', ' ', ' ')	/* [7:0] R */
@@ -75,13 +76,13 @@
 #define DRM_FORMAT_GR88          fourcc_code('G', 'R', '8', '8')	/* [15:0] G:R 8:8 little endian */
 #endif
 
-#define HYPER_DMABUF_LIST_LEN 4
-
 static PFNEGLCREATEIMAGEKHRPROC create_image;
 static PFNEGLDESTROYIMAGEKHRPROC destroy_image;
 static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC image_target_texture_2d;
 
-static struct buffer_list hyper_dmabuf_list;
+static struct vmdisplay_buffer_cache *buffer_cache;
+/* surface currently shown, buffer_cache holds others as well */
+static uint64_t cached_surface_id;
 
 struct egl_manager g_eman_common;
 GLuint current_textureId[2];
@@ -117,73 +118,33 @@ int open_drm(void)
 
 #define ALIGN(x, y) ((x + y - 1) & ~(y - 1))
 
-static int find_rec(struct buffer_list *l, uint32_t id)
+static void release_rec(void *payload, void *data)
 {
-	int i, r;
-	r = -1;
+	struct buffer_rec *rec = payload;
 
-	for (i = 0; i < l->len; i++) {
-		if (l->l[i].hyper_dmabuf_id == id) {
-			r = i;
-		}
-	}
+	glDeleteTextures(2, rec->textureId);
 
-	return r;
-}
+	if (rec->buffer)
+		wl_buffer_destroy(rec->buffer);
 
-static void age_list(struct buffer_list *l)
-{
-	int i;
-	for (i = 0; i < l->len; i++)
-		l->l[i].age++;
-}
-
-static void last_rec(struct buffer_list *l, int i)
-{
-	l->l[i].age = 0;
+	free(rec);
 }
 
-static int oldest_rec(struct buffer_list *l, int len)
+void init_buffers(int capacity)
 {
-	int i, a, r;
-	a = 0, r = 0;
+	buffer_cache = vmdisplay_buffer_cache_create(capacity, release_rec,
+						     NULL);
 
-	for (i = 0; i < len; i++) {
-		if (l->l[i].age >= a) {
-			a = l->l[i].age;
-			r = i;
-		}
+	if (!buffer_cache) {
+		fprintf(stderr, "Error: allocating memory\n");
+		exit(1);
 	}
-
-	return r;
 }
 
-static void clear_rec(struct buffer_list *l, int i)
+void fini_buffers(void)
 {
-	l->l[i].age = 0;
-	glDeleteTextures(2, l->l[i].textureId);
-
-	if (l->l[i].buffer)
-		wl_buffer_destroy(l->l[i].buffer);
-
-	l->l[i].textureId[0] = 0;
-	l->l[i].textureId[1] = 0;
-	l->l[i].width = 0;
-	l->l[i].height = 0;
-	l->l[i].buffer = 0;
-	l->l[i].hyper_dmabuf_id = 0;
-	l->l[i].gem_handle = 0;
-}
-
-void init_buffers(void)
-{
-	hyper_dmabuf_list.l = calloc(1, HYPER_DMABUF_LIST_LEN * sizeof(struct buffer_rec));
-	hyper_dmabuf_list.len = HYPER_DMABUF_LIST_LEN;
-
-	if(!hyper_dmabuf_list.l) {
-		fprintf(stderr, "Error: allocating memory\n");
-		exit(1);
-	}
+	vmdisplay_buffer_cache_destroy(buffer_cache);
+	buffer_cache = NULL;
 }
 
 int init_hyper_dmabuf(int dom)
@@ -210,43 +171,44 @@ int init_hyper_dmabuf(int dom)
 	return 0;
 }
 
-static void update_oldest_rec_hyper_dmabuf(uint32_t old_id, GLuint *textureId,
-				    struct wl_buffer *buf, uint32_t width,
-				    uint32_t height, int age)
+static void store_rec(uint32_t id, GLuint *textureId, struct wl_buffer *buf,
+		      uint32_t width, uint32_t height)
 {
-	int r = oldest_rec(&hyper_dmabuf_list, HYPER_DMABUF_LIST_LEN);
+	struct buffer_rec *rec;
 
-	clear_rec(&hyper_dmabuf_list, r);
+	rec = calloc(1, sizeof(*rec));
+	if (!rec) {
+		fprintf(stderr, "Error: allocating memory\n");
+		return;
+	}
 
-	hyper_dmabuf_list.l[r].hyper_dmabuf_id = old_id;
-	hyper_dmabuf_list.l[r].buffer = buf;
-	hyper_dmabuf_list.l[r].textureId[0] = textureId[0];
-	hyper_dmabuf_list.l[r].textureId[1] = textureId[1];
-	hyper_dmabuf_list.l[r].width = width;
-	hyper_dmabuf_list.l[r].height = height;
-	hyper_dmabuf_list.l[r].age = age;
+	rec->hyper_dmabuf_id = id;
+	rec->buffer = buf;
+	rec->textureId[0] = textureId[0];
+	rec->textureId[1] = textureId[1];
+	rec->width = width;
+	rec->height = height;
+
+	if (vmdisplay_buffer_cache_insert(buffer_cache, cached_surface_id, id,
+					  width, height, rec) < 0)
+		release_rec(rec, NULL);
 }
 
 static void update_hyper_dmabuf_list(int id, int old_id)
 {
-	int r = find_rec(&hyper_dmabuf_list, id);
-
-	age_list(&hyper_dmabuf_list);
-
-	if (r >= 0) {
-		if (old_id == 0 ||
-		    hyper_dmabuf_list.l[r].width != surf_width ||
-		    hyper_dmabuf_list.l[r].height != surf_height) {
-			clear_rec(&hyper_dmabuf_list, r);
-			create_new_hyper_dmabuf_buffer();
-		} else {
-			last_rec(&hyper_dmabuf_list, r);
-			current_textureId[0] =
-			    hyper_dmabuf_list.l[r].textureId[0];
-			current_textureId[1] =
-			    hyper_dmabuf_list.l[r].textureId[1];
-			current_buffer = hyper_dmabuf_list.l[r].buffer;
-		}
+	struct buffer_rec *rec;
+
+	/* first buffer after a reset, do not trust what is cached */
+	if (old_id == 0)
+		vmdisplay_buffer_cache_remove(buffer_cache, cached_surface_id,
+					      id);
+
+	rec = vmdisplay_buffer_cache_lookup(buffer_cache, cached_surface_id, id,
+					    surf_width, surf_height);
+	if (rec) {
+		current_textureId[0] = rec->textureId[0];
+		current_textureId[1] = rec->textureId[1];
+		current_buffer = rec->buffer;
 	} else {
 		create_new_hyper_dmabuf_buffer();
 	}
@@ -255,6 +217,7 @@ static void update_hyper_dmabuf_list(int id, int old_id)
 int check_for_new_buffer(void)
 {
 	static hyper_dmabuf_id_t old_hyper_dmabuf_id = { 0, {0, 0, 0} };
+	int new_surface;
 	int ret = 0;
 
 	if (use_event_poll) {
@@ -273,8 +236,20 @@ int check_for_new_buffer(void)
 		old_hyper_dmabuf_id.id = 0;
 		clear_hyper_dmabuf_list();
 	}
+
+	/*
+	 * The displayed surface changed. The old one keeps its imports, the
+	 * guest may well switch back to it, and the per surface LRU bounds
+	 * them; reserve room for the new one before its first import.
+	 */
+	new_surface = current_surface_id != cached_surface_id;
+	if (new_surface) {
+		cached_surface_id = current_surface_id;
+		vmdisplay_buffer_cache_reserve(buffer_cache, cached_surface_id);
+	}
+
 	if ((hyper_dmabuf_id.id > 0)
-	    && (hyper_dmabuf_id.id != old_hyper_dmabuf_id.id)) {
+	    && (new_surface || hyper_dmabuf_id.id != old_hyper_dmabuf_id.id)) {
 		update_hyper_dmabuf_list(hyper_dmabuf_id.id,
 					 old_hyper_dmabuf_id.id);
 	}
@@ -524,8 +499,7 @@ static void create_new_buffer_common(int dmabuf_fd)
 							    surf_format, 0);
 		current_buffer = buf;
 	}
-	update_oldest_rec_hyper_dmabuf(hyper_dmabuf_id.id, textureId, buf,
-				       surf_width, surf_height, 0);
+	store_rec(hyper_dmabuf_id.id, textureId, buf, surf_width, surf_height);
 }
 
 void create_new_hyper_dmabuf_buffer(void)
@@ -551,10 +525,7 @@ void create_new_hyper_dmabuf_buffer(void)
 
 void clear_hyper_dmabuf_list(void)
 {
-	int i;
-	for (i = 0; i < hyper_dmabuf_list.len; i++)
-		clear_rec(&hyper_dmabuf_list, i);
-
+	vmdisplay_buffer_cache_clear(buffer_cache);
 }
 
 void received_frames(void)
@@ -572,9 +543,17 @@ void received_frames(void)
 		if (frames == 0)
 			benchmark_time = time;
 		if (time - benchmark_time > (benchmark_interval * 1000)) {
+			struct vmdisplay_buffer_cache_stats stats;
+
 			printf("%d frames in %d seconds: %f fps\n",
 			       frames, benchmark_interval,
 			       (float)frames / benchmark_interval);
+			vmdisplay_buffer_cache_get_stats(buffer_cache, &stats);
+			printf("buffer cache: %llu hits, %llu misses, "
+			       "%llu evictions\n",
+			       (unsigned long long)stats.hits,
+			       (unsigned long long)stats.misses,
+			       (unsigned long long)stats.evictions);
 			benchmark_time = time;
 			frames = 0;
 		}
@@ -60,15 +60,8 @@ typedef struct buffer_rec {
 	struct wl_buffer *buffer;
 	uint32_t width;
 	uint32_t height;
-	int age;
-	uint32_t gem_handle;
 } buffer_rec;
 
-typedef struct buffer_list {
-	struct buffer_rec *l;
-	int len;
-} buffer_list;
-
 typedef struct egl_manager {
 	EGLDisplay dpy;
 	EGLContext ctx;
@@ -92,7 +85,8 @@ extern int enable_fps_info;
 extern uint32_t show_window;
 
 int open_drm(void);
-void init_buffers(void);
+void init_buffers(int capacity);
+void fini_buffers(void);
 int init_hyper_dmabuf(int dom);
 void clear_hyper_dmabuf_list(void);
 void create_new_hyper_dmabuf_buffer(void);
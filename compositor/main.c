@@ -34,6 +34,7 @@
 #include <signal.h>
 #include <errno.h>
 #include <dlfcn.h>
+#include <limits.h>
 #include <stdint.h>
 #include <string.h>
 #include <sys/utsname.h>
@@ -1105,6 +1106,16 @@ out:
 	return ret;
 }
 
+/* The clipboard keeps selections in memfds addressed with off_t, so the
+ * caps are clamped to what one read can return, also on 32-bit. */
+static size_t
+clipboard_mib_to_bytes(uint32_t mib)
+{
+	uint64_t bytes = (uint64_t)mib << 20;
+
+	return MIN(bytes, (uint64_t)SSIZE_MAX);
+}
+
 static int
 weston_compositor_init_config(struct weston_compositor *ec,
 			      struct weston_config *config)
@@ -1112,6 +1123,7 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	struct xkb_rule_names xkb_names;
 	struct weston_config_section *s;
 	int repaint_msec;
+	uint32_t clipboard_mib;
 	int vt_switching;
 	int cal;
 
@@ -1153,6 +1165,13 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	weston_log("Output repaint window is %d ms maximum.\n",
 		   ec->repaint_msec);
 
+	weston_config_section_get_uint(s, "clipboard-max-size", &clipboard_mib,
+				       ec->clipboard_max_size >> 20);
+	ec->clipboard_max_size = clipboard_mib_to_bytes(clipboard_mib);
+	weston_config_section_get_uint(s, "clipboard-max-total", &clipboard_mib,
+				       ec->clipboard_max_total >> 20);
+	ec->clipboard_max_total = clipboard_mib_to_bytes(clipboard_mib);
+
 	/* weston.ini [libinput] */
 	s = weston_config_get_section(config, "libinput", NULL, NULL);
 	weston_config_section_get_bool(s, "touchscreen_calibrator", &cal, 0);
@@ -26,11 +26,14 @@
 
 #include "config.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/mman.h>
 #include <signal.h>
@@ -46,6 +49,8 @@
 #include "weston.h"
 #include "shared/helpers.h"
 #include "shared/os-compatibility.h"
+#include "shared/pixel-convert.h"
+#include "shared/readback-plan.h"
 #include "shared/timespec-util.h"
 #include "fullscreen-shell-unstable-v1-client-protocol.h"
 
@@ -79,8 +84,39 @@ struct shared_output {
 
 	int cache_dirty;
 	pixman_image_t *cache_image;
-	uint32_t *tmp_data;
-	size_t tmp_data_size;
+
+	/* Damage is read back into the staging buffer on the compositor
+	 * thread, the worker converts it into cache_image. */
+	struct {
+		pthread_t thread;
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		/* protected by mutex */
+		bool queued;
+		bool done;
+		bool quit;
+
+		int done_fd;
+		struct wl_event_source *done_source;
+
+		/* the worker owns these and cache_image while busy */
+		bool busy;
+		bool yflip;
+		uint8_t *staging;
+		size_t staging_size;
+		struct ss_readback *rects;
+		int n_rects;
+	} readback;
+};
+
+/* Upper bound on readbacks per frame, and the fixed cost of one readback
+ * in pixels; see readback_plan(). */
+#define SS_MAX_READBACKS 8
+#define SS_READBACK_COST 4096
+
+struct ss_readback {
+	struct readback_box box;
+	size_t offset;
 };
 
 struct ss_seat {
@@ -571,42 +607,6 @@ output_compute_transform(struct weston_output *output,
 static void
 shared_output_destroy(struct shared_output *so);
 
-static int
-shared_output_ensure_tmp_data(struct shared_output *so,
-			      pixman_region32_t *region)
-{
-	pixman_box32_t *ext;
-	size_t size;
-
-	if (!pixman_region32_not_empty(region))
-		return 0;
-
-	ext = pixman_region32_extents(region);
-
-	/* Damage is in output coordinates.
-	 *
-	 * We are multiplying by 4 because the temporary data needs to be able
-	 * to store an 32 bit-per-pixel buffer.
-	 */
-	size = 4 * (ext->x2 - ext->x1) * (ext->y2 - ext->y1)
-		 * so->output->current_scale * so->output->current_scale;
-
-	if (so->tmp_data != NULL && size <= so->tmp_data_size)
-		return 0;
-
-	free(so->tmp_data);
-	so->tmp_data = malloc(size);
-	if (so->tmp_data == NULL) {
-		so->tmp_data_size = 0;
-		errno = ENOMEM;
-		return -1;
-	}
-
-	so->tmp_data_size = size;
-
-	return 0;
-}
-
 static void
 shared_output_update(struct shared_output *so);
 
@@ -636,8 +636,9 @@ shared_output_update(struct shared_output *so)
 	int i, nrects;
 	pixman_transform_t transform;
 
-	/* Only update if we need to */
-	if (!so->cache_dirty || so->parent.frame_cb)
+	/* Only update if we need to, and never while the worker is still
+	 * writing to cache_image */
+	if (!so->cache_dirty || so->parent.frame_cb || so->readback.busy)
 		return;
 
 	sb = shared_output_get_shm_buffer(so);
@@ -810,6 +811,221 @@ struct zwp_fullscreen_shell_mode_feedback_v1_listener mode_feedback_listener = {
 	mode_feedback_ok,
 };
 
+static void *
+shared_output_readback_thread(void *data)
+{
+	struct shared_output *so = data;
+	struct ss_readback *rb;
+	uint8_t *cache_data;
+	int cache_stride, width, height, i;
+	uint64_t one = 1;
+	ssize_t ret;
+
+	pthread_mutex_lock(&so->readback.mutex);
+	for (;;) {
+		while (!so->readback.queued && !so->readback.quit)
+			pthread_cond_wait(&so->readback.cond, &so->readback.mutex);
+		if (so->readback.quit)
+			break;
+		pthread_mutex_unlock(&so->readback.mutex);
+
+		cache_data = (uint8_t *)pixman_image_get_data(so->cache_image);
+		cache_stride = pixman_image_get_stride(so->cache_image);
+
+		for (i = 0; i < so->readback.n_rects; i++) {
+			rb = &so->readback.rects[i];
+			width = rb->box.x2 - rb->box.x1;
+			height = rb->box.y2 - rb->box.y1;
+
+			pixel_convert_xrgb(cache_data + rb->box.y1 * cache_stride +
+					   rb->box.x1 * 4, cache_stride,
+					   so->readback.staging + rb->offset,
+					   width * 4, width, height,
+					   so->readback.yflip ? PIXEL_CONVERT_YFLIP : 0);
+		}
+
+		pthread_mutex_lock(&so->readback.mutex);
+		so->readback.queued = false;
+		so->readback.done = true;
+		pthread_cond_broadcast(&so->readback.cond);
+
+		/* eventfd writes only fail once the counter is saturated,
+		 * in which case a wakeup is pending anyway */
+		ret = write(so->readback.done_fd, &one, sizeof(one));
+		(void)ret;
+	}
+	pthread_mutex_unlock(&so->readback.mutex);
+
+	return NULL;
+}
+
+/* Waits for the worker to finish the frame in flight, if any. Returns
+ * true when a frame was finished and cache_image has new content. */
+static bool
+shared_output_readback_wait(struct shared_output *so)
+{
+	bool done;
+
+	if (!so->readback.busy)
+		return false;
+
+	pthread_mutex_lock(&so->readback.mutex);
+	while (so->readback.queued)
+		pthread_cond_wait(&so->readback.cond, &so->readback.mutex);
+	done = so->readback.done;
+	so->readback.done = false;
+	pthread_mutex_unlock(&so->readback.mutex);
+
+	so->readback.busy = false;
+	if (done)
+		so->cache_dirty = 1;
+
+	return done;
+}
+
+static int
+shared_output_readback_done(int fd, uint32_t mask, void *data)
+{
+	struct shared_output *so = data;
+	uint64_t count;
+
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		weston_log("Screen share: failed to read eventfd: %s\n",
+			   strerror(errno));
+
+	/* the frame may already have been reaped by the next repaint */
+	if (shared_output_readback_wait(so))
+		shared_output_update(so);
+
+	return 0;
+}
+
+static int
+shared_output_readback_init(struct shared_output *so, struct wl_event_loop *loop)
+{
+	pthread_mutex_init(&so->readback.mutex, NULL);
+	pthread_cond_init(&so->readback.cond, NULL);
+
+	so->readback.rects = calloc(SS_MAX_READBACKS, sizeof *so->readback.rects);
+	if (!so->readback.rects)
+		goto err_mutex;
+
+	so->readback.done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (so->readback.done_fd < 0)
+		goto err_rects;
+
+	so->readback.done_source =
+		wl_event_loop_add_fd(loop, so->readback.done_fd,
+				     WL_EVENT_READABLE,
+				     shared_output_readback_done, so);
+	if (!so->readback.done_source)
+		goto err_fd;
+
+	if (pthread_create(&so->readback.thread, NULL,
+			   shared_output_readback_thread, so) != 0)
+		goto err_source;
+
+	return 0;
+
+err_source:
+	wl_event_source_remove(so->readback.done_source);
+err_fd:
+	close(so->readback.done_fd);
+err_rects:
+	free(so->readback.rects);
+err_mutex:
+	pthread_cond_destroy(&so->readback.cond);
+	pthread_mutex_destroy(&so->readback.mutex);
+	return -1;
+}
+
+static void
+shared_output_readback_fini(struct shared_output *so)
+{
+	shared_output_readback_wait(so);
+
+	pthread_mutex_lock(&so->readback.mutex);
+	so->readback.quit = true;
+	pthread_cond_broadcast(&so->readback.cond);
+	pthread_mutex_unlock(&so->readback.mutex);
+	pthread_join(so->readback.thread, NULL);
+
+	wl_event_source_remove(so->readback.done_source);
+	close(so->readback.done_fd);
+	pthread_cond_destroy(&so->readback.cond);
+	pthread_mutex_destroy(&so->readback.mutex);
+
+	free(so->readback.rects);
+	free(so->readback.staging);
+}
+
+/* Plans the readbacks for 'damage', in buffer coordinates, and reads the
+ * pixels into the staging buffer back to back. */
+static int
+shared_output_readback(struct shared_output *so, pixman_region32_t *damage)
+{
+	struct weston_renderer *renderer = so->output->compositor->renderer;
+	struct ss_readback *rb;
+	pixman_box32_t *r;
+	struct readback_box boxes[READBACK_PLAN_MAX_INPUT];
+	struct readback_box *in = boxes;
+	size_t size = 0;
+	uint8_t *staging;
+	int i, n, nrects, width, height, y_orig;
+
+	r = pixman_region32_rectangles(damage, &nrects);
+	if (nrects > READBACK_PLAN_MAX_INPUT) {
+		in = malloc(nrects * sizeof *in);
+		if (!in)
+			return -1;
+	}
+
+	/* pixman_box32_t and readback_box share their layout */
+	memcpy(in, r, nrects * sizeof *in);
+	n = readback_plan(in, nrects, SS_MAX_READBACKS, SS_READBACK_COST);
+
+	for (i = 0; i < n; i++) {
+		rb = &so->readback.rects[i];
+		rb->box = in[i];
+		rb->offset = size;
+		size += (size_t)(in[i].x2 - in[i].x1) * (in[i].y2 - in[i].y1) * 4;
+	}
+	so->readback.n_rects = n;
+
+	if (in != boxes)
+		free(in);
+
+	if (size > so->readback.staging_size) {
+		staging = realloc(so->readback.staging, size);
+		if (!staging) {
+			errno = ENOMEM;
+			return -1;
+		}
+		so->readback.staging = staging;
+		so->readback.staging_size = size;
+	}
+
+	so->readback.yflip =
+		!!(so->output->compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
+
+	for (i = 0; i < n; i++) {
+		rb = &so->readback.rects[i];
+		width = rb->box.x2 - rb->box.x1;
+		height = rb->box.y2 - rb->box.y1;
+
+		if (so->readback.yflip)
+			y_orig = so->output->current_mode->height - rb->box.y2;
+		else
+			y_orig = rb->box.y1;
+
+		renderer->read_pixels(so->output, PIXMAN_a8r8g8b8,
+				      so->readback.staging + rb->offset,
+				      rb->box.x1, y_orig, width, height);
+	}
+
+	return 0;
+}
+
 static void
 shared_output_repainted(struct wl_listener *listener, void *data)
 {
@@ -817,11 +1033,11 @@ shared_output_repainted(struct wl_listener *listener, void *data)
 		container_of(listener, struct shared_output, frame_listener);
 	pixman_region32_t damage;
 	struct ss_shm_buffer *sb;
-	int32_t x, y, width, height, stride;
-	int i, nrects, do_yflip, y_orig;
-	pixman_box32_t *r;
-	pixman_image_t *damaged_image;
-	pixman_transform_t transform;
+	int32_t width, height, stride;
+
+	/* at most one frame in flight: the staging buffer and cache_image
+	 * are about to be reused */
+	shared_output_readback_wait(so);
 
 	width = so->output->current_mode->width;
 	height = so->output->current_mode->height;
@@ -859,61 +1075,25 @@ shared_output_repainted(struct wl_listener *listener, void *data)
 				  so->output->current_scale,
 				  &damage, &damage);
 
-	if (shared_output_ensure_tmp_data(so, &damage) < 0)
-		goto err_pixman_init;
-
-	do_yflip = !!(so->output->compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
-
-	r = pixman_region32_rectangles(&damage, &nrects);
-	for (i = 0; i < nrects; ++i) {
-		x = r[i].x1;
-		y = r[i].y1;
-		width = r[i].x2 - r[i].x1;
-		height = r[i].y2 - r[i].y1;
-
-		if (do_yflip)
-			y_orig = so->output->current_mode->height - r[i].y2;
-		else
-			y_orig = y;
-
-		so->output->compositor->renderer->read_pixels(
-			so->output, PIXMAN_a8r8g8b8, so->tmp_data,
-			x, y_orig, width, height);
-
-		damaged_image = pixman_image_create_bits(PIXMAN_a8r8g8b8,
-							 width, height,
-							 so->tmp_data,
-				(PIXMAN_FORMAT_BPP(PIXMAN_a8r8g8b8) / 8) * width);
-		if (!damaged_image)
-			goto err_pixman_init;
-
-		if (do_yflip) {
-			pixman_transform_init_scale(&transform,
-						    pixman_fixed_1,
-						    pixman_fixed_minus_1);
-
-			pixman_transform_translate(&transform, NULL,
-						   0,
-						   pixman_int_to_fixed(height));
-
-			pixman_image_set_transform(damaged_image, &transform);
-		}
-
-		pixman_image_composite32(PIXMAN_OP_SRC,
-					 damaged_image,
-					 NULL,
-					 so->cache_image,
-					 0, 0,
-					 0, 0,
-					 x, y,
-					 width, height);
-		pixman_image_unref(damaged_image);
+	if (!pixman_region32_not_empty(&damage)) {
+		pixman_region32_fini(&damage);
+		/* a frame finished by the wait above still needs sending */
+		shared_output_update(so);
+		return;
 	}
 
-	so->cache_dirty = 1;
+	if (shared_output_readback(so, &damage) < 0)
+		goto err_pixman_init;
 
 	pixman_region32_fini(&damage);
-	shared_output_update(so);
+
+	/* conversion and y-flip happen on the worker, the parent surface
+	 * is updated once it is done */
+	so->readback.busy = true;
+	pthread_mutex_lock(&so->readback.mutex);
+	so->readback.queued = true;
+	pthread_cond_broadcast(&so->readback.cond);
+	pthread_mutex_unlock(&so->readback.mutex);
 
 	return;
 
@@ -1000,6 +1180,12 @@ shared_output_create(struct weston_output *output, int parent_fd)
 		goto err_display;
 	}
 
+	if (shared_output_readback_init(so, loop) < 0) {
+		weston_log("Screen share failed: %s\n", strerror(errno));
+		wl_event_source_remove(so->event_source);
+		goto err_display;
+	}
+
 	/* Ok, everything's created.  We should be good to go */
 	wl_list_init(&so->shm.buffers);
 	wl_list_init(&so->shm.free_buffers);
@@ -1044,8 +1230,9 @@ shared_output_destroy(struct shared_output *so)
 	wl_list_remove(&so->output_destroyed.link);
 	wl_list_remove(&so->frame_listener.link);
 
-	pixman_image_unref(so->cache_image);
-	free(so->tmp_data);
+	shared_output_readback_fini(so);
+	if (so->cache_image)
+		pixman_image_unref(so->cache_image);
 
 	free(so);
 }
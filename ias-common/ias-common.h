@@ -42,6 +42,7 @@
 
 #include "ias-plugin-framework-definitions.h"
 #include "ias-spug.h"
+#include "ias-config.h"
 #include <backend.h>
 
 #define CFG_FILENAME "ias.conf"
@@ -71,39 +72,6 @@ weston_log("[dbg] :: " msg "\n" , ##__VA_ARGS__)
 #define UNUSED_IN_RELEASE(var)  (void)(var)
 #endif
 
-/***
- *** Configuration functionality
- ***/
-
-/* Valid XML elements we can parse */
-enum ias_element {
-	NONE		= 0,
-	IASCONFIG	= 1,
-	BACKEND		= 2,
-	STARTUP		= 4,
-	CRTC		= 8,
-	OUTPUT		= 16,
-	HMI			= 32,
-	PLUGIN		= 64,
-	INPUTPLUGIN = 128,
-	INPUT		= 256,
-	ENV			= 512,
-	GLOBAL_ENV	= 1024,
-	REM_DISP	= 2048,
-};
-
-/* Type to hold element -> handler mapping and hierarchy */
-struct xml_element {
-	enum ias_element id;
-	char *name;
-	void (*begin_handler)(void *, const char **);
-	unsigned int valid_children;
-	enum ias_element return_to;
-};
-
-/* Parses the IAS config file using the provided state machine info */
-int ias_read_configuration(char *, struct xml_element *, int, void *);
-
 /***
  *** Backend compositor type
  ***/
@@ -203,6 +171,8 @@ struct ias_output {
 struct ias_surface_capture {
 	struct wl_list link;
 	struct capture_proxy *cp;
+	/* client buffers imported into GBM, see capture_commit_notify() */
+	struct capture_pool *import_pool;
 	struct weston_surface *capture_surface;
 	struct wl_listener capture_commit_listener;
 	struct wl_listener capture_vsync_listener;
@@ -33,122 +33,399 @@
 
 #include <assert.h>
 #include <expat.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <libweston/config-parser.h>
 #include "ias-common.h"
 
-/* General expat handlers */
-static void startElement(void *, const char *, const char **);
-static void endElement(void *, const char *);
+#define IAS_CONFIG_BUCKETS 64
 
-/* Current state machine information being used for parsing */
-static struct xml_element *parse_data = NULL;
-static int num_elements = 0;
+/*
+ * A config file is parsed once into the sequence of elements expat
+ * reported, which is then replayed through the state machine of every
+ * caller. Trees are immutable once cached and are shared between
+ * threads by reference count.
+ */
+struct ias_config_event {
+	char *name;
+	char **attrs;		/* NULL terminated name/value pairs; NULL on end */
+};
+
+struct ias_config_tree {
+	char *path;
+	uint64_t hash;
+	int refcount;
+	struct ias_config_tree *next;
+
+	struct ias_config_event *events;
+	int num_events;
+	int max_events;
 
-/* Current parsing state */
-static int current_state = 0;
+	/* Parse error, reported again each time the tree is replayed */
+	enum XML_Error error;
+	unsigned long error_line;
+	bool oom;
+};
 
-/* Expat parsing object */
-static XML_Parser parser;
+/* Per call state machine; nothing in here is shared between callers */
+struct ias_config_parser {
+	struct xml_element *parse_data;
+	int num_elements;
+	int current_state;
+	void *userdata;
 
+	/* Elements by name hash, chained in table order */
+	int buckets[IAS_CONFIG_BUCKETS];
+	int *next_in_bucket;
+
+	/* Element to transition to when each element ends, or -1 */
+	int *return_state;
+};
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ias_config_tree *cache_list = NULL;
+
+static uint64_t
+config_hash(const char *data, size_t len)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;	/* FNV-1a */
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static unsigned int
+element_bucket(const char *name)
+{
+	return config_hash(name, strlen(name)) & (IAS_CONFIG_BUCKETS - 1);
+}
+
+static void
+tree_destroy(struct ias_config_tree *tree)
+{
+	int i, j;
+
+	for (i = 0; i < tree->num_events; i++) {
+		free(tree->events[i].name);
+		if (tree->events[i].attrs) {
+			for (j = 0; tree->events[i].attrs[j]; j++)
+				free(tree->events[i].attrs[j]);
+			free(tree->events[i].attrs);
+		}
+	}
+
+	free(tree->events);
+	free(tree->path);
+	free(tree);
+}
+
+static void
+tree_unref(struct ias_config_tree *tree)
+{
+	int refcount;
+
+	pthread_mutex_lock(&cache_mutex);
+	refcount = --tree->refcount;
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (refcount == 0)
+		tree_destroy(tree);
+}
+
+static struct ias_config_event *
+tree_add_event(struct ias_config_tree *tree, const char *name)
+{
+	struct ias_config_event *event;
+	int max;
+
+	if (tree->num_events == tree->max_events) {
+		max = tree->max_events ? tree->max_events * 2 : 32;
+		event = realloc(tree->events, max * sizeof *event);
+		if (!event)
+			return NULL;
+		tree->events = event;
+		tree->max_events = max;
+	}
+
+	event = &tree->events[tree->num_events];
+	event->attrs = NULL;
+	event->name = strdup(name);
+	if (!event->name)
+		return NULL;
+
+	tree->num_events++;
+
+	return event;
+}
+
+static void
+recordStartElement(void *data, const char *name, const char **attrs)
+{
+	XML_Parser parser = data;
+	struct ias_config_tree *tree = XML_GetUserData(parser);
+	struct ias_config_event *event;
+	int i, num;
+
+	event = tree_add_event(tree, name);
+	if (!event)
+		goto oom;
+
+	for (num = 0; attrs[num]; num++)
+		;
+
+	event->attrs = calloc(num + 1, sizeof *event->attrs);
+	if (!event->attrs)
+		goto oom;
+
+	for (i = 0; i < num; i++) {
+		event->attrs[i] = strdup(attrs[i]);
+		if (!event->attrs[i])
+			goto oom;
+	}
+
+	return;
+
+oom:
+	tree->oom = true;
+	XML_StopParser(parser, XML_FALSE);
+}
+
+static void
+recordEndElement(void *data, const char *name)
+{
+	XML_Parser parser = data;
+	struct ias_config_tree *tree = XML_GetUserData(parser);
+
+	if (!tree_add_event(tree, name)) {
+		tree->oom = true;
+		XML_StopParser(parser, XML_FALSE);
+	}
+}
 
 /*
- * ias_read_configuration()
+ * parse_tree()
  *
- * Reads the IAS config file to setup backend behavior according to the
- * customer's needs.
+ * Runs expat over the whole file once and records every element.
  */
-int
-ias_read_configuration(char *filename,
+static struct ias_config_tree *
+parse_tree(const char *path, const char *buf, size_t len, uint64_t hash)
+{
+	struct ias_config_tree *tree;
+	XML_Parser parser;
+
+	tree = calloc(1, sizeof *tree);
+	if (!tree)
+		return NULL;
+
+	tree->refcount = 1;
+	tree->hash = hash;
+	tree->path = strdup(path);
+	if (!tree->path) {
+		free(tree);
+		return NULL;
+	}
+
+	parser = XML_ParserCreate(NULL);
+	if (!parser) {
+		IAS_ERROR("Failed to create XML config parser");
+		tree_destroy(tree);
+		return NULL;
+	}
+
+	XML_SetUserData(parser, tree);
+	XML_UseParserAsHandlerArg(parser);
+	XML_SetElementHandler(parser, recordStartElement, recordEndElement);
+	if (XML_Parse(parser, buf, len, XML_TRUE) == XML_STATUS_ERROR &&
+	    !tree->oom) {
+		tree->error = XML_GetErrorCode(parser);
+		tree->error_line = XML_GetCurrentLineNumber(parser);
+	}
+	XML_ParserFree(parser);
+
+	if (tree->oom) {
+		IAS_ERROR("Out of memory parsing IAS config %s", path);
+		tree_destroy(tree);
+		return NULL;
+	}
+
+	return tree;
+}
+
+/*
+ * cache_get_tree()
+ *
+ * Returns a reference to the parsed tree for the given file contents,
+ * parsing it if no caller has done so before.
+ */
+static struct ias_config_tree *
+cache_get_tree(const char *path, const char *buf, size_t len)
+{
+	struct ias_config_tree *tree, *parsed, **link;
+	uint64_t hash = config_hash(buf, len);
+
+	pthread_mutex_lock(&cache_mutex);
+	for (tree = cache_list; tree; tree = tree->next) {
+		if (tree->hash == hash && strcmp(tree->path, path) == 0) {
+			tree->refcount++;
+			pthread_mutex_unlock(&cache_mutex);
+			return tree;
+		}
+	}
+	pthread_mutex_unlock(&cache_mutex);
+
+	/* Parse without holding the lock so other files load in parallel */
+	parsed = parse_tree(path, buf, len, hash);
+	if (!parsed)
+		return NULL;
+
+	pthread_mutex_lock(&cache_mutex);
+	link = &cache_list;
+	while ((tree = *link)) {
+		if (strcmp(tree->path, path) != 0) {
+			link = &tree->next;
+			continue;
+		}
+
+		if (tree->hash == hash) {
+			/* Another thread parsed the same file meanwhile */
+			tree->refcount++;
+			pthread_mutex_unlock(&cache_mutex);
+			tree_unref(parsed);
+			return tree;
+		}
+
+		/* The file changed since it was cached */
+		*link = tree->next;
+		if (--tree->refcount == 0)
+			tree_destroy(tree);
+	}
+
+	parsed->refcount++;
+	parsed->next = cache_list;
+	cache_list = parsed;
+	pthread_mutex_unlock(&cache_mutex);
+
+	return parsed;
+}
+
+/*
+ * ias_config_cache_flush()
+ *
+ * Drops the cached configuration trees. Trees still being replayed are
+ * freed once their last reader is done.
+ */
+void
+ias_config_cache_flush(void)
+{
+	struct ias_config_tree *tree, *next;
+
+	pthread_mutex_lock(&cache_mutex);
+	tree = cache_list;
+	cache_list = NULL;
+	pthread_mutex_unlock(&cache_mutex);
+
+	for (; tree; tree = next) {
+		next = tree->next;
+		tree_unref(tree);
+	}
+}
+
+static int
+parser_init(struct ias_config_parser *parser,
 		struct xml_element *state_machine_def,
 		int num,
 		void *userdata)
 {
-	FILE *conf;
-	int len;
-	int done;
-	char buf[BUFSIZ];
-	char *cfgfile;
+	unsigned int bucket;
+	int i, j;
 
-	/* Save the state machine parsing data */
-	parse_data = state_machine_def;
-	num_elements = num;
+	parser->parse_data = state_machine_def;
+	parser->num_elements = num;
+	parser->current_state = 0;
+	parser->userdata = userdata;
 
-	/* Open the config file */
-	cfgfile = config_file_path(filename);
-	if (!cfgfile) {
-		IAS_ERROR("Failed to get generate full path for config filename");
+	parser->next_in_bucket = calloc(num, sizeof(int));
+	parser->return_state = calloc(num, sizeof(int));
+	if (num && (!parser->next_in_bucket || !parser->return_state)) {
+		free(parser->next_in_bucket);
+		free(parser->return_state);
 		return -1;
 	}
 
-	conf = fopen(cfgfile, "r");
-	if (!conf) {
-		IAS_ERROR("Failed to open IAS config file (%s): %m", cfgfile);
-		free(cfgfile);
-		return -1;
-	}
-	free(cfgfile);
+	for (i = 0; i < IAS_CONFIG_BUCKETS; i++)
+		parser->buckets[i] = -1;
 
-	parser = XML_ParserCreate(NULL);
-	if (!parser) {
-		IAS_ERROR("Failed to create XML config parser");
-		fclose(conf);
-		return -1;
+	/* Walk backwards so that each chain ends up in table order */
+	for (i = num - 1; i >= 0; i--) {
+		parser->next_in_bucket[i] = -1;
+		if (!state_machine_def[i].name)
+			continue;
+
+		bucket = element_bucket(state_machine_def[i].name);
+		parser->next_in_bucket[i] = parser->buckets[bucket];
+		parser->buckets[bucket] = i;
 	}
 
-	XML_SetUserData(parser, userdata);
-	XML_SetElementHandler(parser, startElement, endElement);
-	do {
-		len = fread(buf, 1, sizeof buf, conf);
-		if (ferror(conf)) {
-			IAS_ERROR("Failed to read from config file: %m");
-			break;
-		}
-		done = feof(conf);
-
-		if (XML_Parse(parser, buf, len, done) == XML_STATUS_ERROR) {
-			IAS_ERROR("Unable to parse IAS config at %s:%lu: %s",
-					filename,
-					XML_GetCurrentLineNumber(parser),
-					XML_ErrorString(XML_GetErrorCode(parser)));
-			break;
+	for (i = 0; i < num; i++) {
+		parser->return_state[i] = -1;
+		for (j = 0; j < num; j++) {
+			if (state_machine_def[j].id ==
+					state_machine_def[i].return_to) {
+				parser->return_state[i] = j;
+				break;
+			}
 		}
-	} while (!done);
-	XML_ParserFree(parser);
-	fclose(conf);
+	}
 
 	return 0;
 }
 
+static void
+parser_fini(struct ias_config_parser *parser)
+{
+	free(parser->next_in_bucket);
+	free(parser->return_state);
+}
+
 /*
  * startElement()
  *
  * Begins parsing an XML element in the config file.
  */
 static void
-startElement(void *userdata, const char *name, const char **attrs)
+startElement(struct ias_config_parser *parser,
+		const char *name, const char **attrs)
 {
 	struct xml_element *curr, *next;
 	int i;
 
-	curr = &parse_data[current_state];
+	curr = &parser->parse_data[parser->current_state];
 
 	/* Map element back to ID */
-	for (i = 0; i < num_elements; i++) {
-		next = &parse_data[i];
+	for (i = parser->buckets[element_bucket(name)]; i >= 0;
+			i = parser->next_in_bucket[i]) {
+		next = &parser->parse_data[i];
 
-		if (next->name && strcmp(next->name, name) == 0) {
+		if (strcmp(next->name, name) == 0) {
 			/* Found an element we recognize; is it an acceptable child? */
 			if (curr->valid_children & next->id) {
 				/* Acceptable child; call handler, if any */
 				if (next->begin_handler) {
-					next->begin_handler(userdata, attrs);
+					next->begin_handler(parser->userdata, attrs);
 				}
 
 				/* Transition state machine */
-				current_state = i;
+				parser->current_state = i;
 
 				return;
 			} else {
@@ -164,10 +441,9 @@ startElement(void *userdata, const char *name, const char **attrs)
  * Finishes parsing an XML element in the config file.
  */
 static void
-endElement(void *userdata, const char *name)
+endElement(struct ias_config_parser *parser, const char *name)
 {
-	struct xml_element *curr = &parse_data[current_state];
-	int i;
+	struct xml_element *curr = &parser->parse_data[parser->current_state];
 
 	/* Make sure it's the element we were parsing */
 	if (curr->name && strcmp(name, curr->name) != 0) {
@@ -175,10 +451,115 @@ endElement(void *userdata, const char *name)
 	}
 
 	/* Transition state machine */
-	for (i = 0; i < num_elements; i++) {
-		if (parse_data[i].id == curr->return_to) {
-			current_state = i;
-			return;
+	if (parser->return_state[parser->current_state] >= 0)
+		parser->current_state =
+			parser->return_state[parser->current_state];
+}
+
+static char *
+read_config_file(const char *cfgfile, size_t *len)
+{
+	FILE *conf;
+	char *buf = NULL, *tmp;
+	size_t size = 0;
+	size_t n;
+
+	conf = fopen(cfgfile, "r");
+	if (!conf) {
+		IAS_ERROR("Failed to open IAS config file (%s): %m", cfgfile);
+		return NULL;
+	}
+
+	*len = 0;
+	do {
+		if (*len + BUFSIZ > size) {
+			size = size ? size * 2 : 2 * BUFSIZ;
+			tmp = realloc(buf, size);
+			if (!tmp) {
+				IAS_ERROR("Out of memory reading config file");
+				goto err;
+			}
+			buf = tmp;
+		}
+
+		n = fread(buf + *len, 1, size - *len, conf);
+		if (ferror(conf)) {
+			IAS_ERROR("Failed to read from config file: %m");
+			goto err;
 		}
+		*len += n;
+	} while (!feof(conf));
+
+	fclose(conf);
+	return buf;
+
+err:
+	free(buf);
+	fclose(conf);
+	return NULL;
+}
+
+/*
+ * ias_read_configuration()
+ *
+ * Reads the IAS config file to setup backend behavior according to the
+ * customer's needs.
+ */
+int
+ias_read_configuration(char *filename,
+		struct xml_element *state_machine_def,
+		int num,
+		void *userdata)
+{
+	struct ias_config_parser parser;
+	struct ias_config_tree *tree;
+	struct ias_config_event *event;
+	char *cfgfile;
+	char *buf;
+	size_t len;
+	int i;
+
+	/* Open the config file */
+	cfgfile = config_file_path(filename);
+	if (!cfgfile) {
+		IAS_ERROR("Failed to get generate full path for config filename");
+		return -1;
+	}
+
+	buf = read_config_file(cfgfile, &len);
+	if (!buf) {
+		free(cfgfile);
+		return -1;
+	}
+
+	tree = cache_get_tree(cfgfile, buf, len);
+	free(buf);
+	free(cfgfile);
+	if (!tree)
+		return -1;
+
+	if (parser_init(&parser, state_machine_def, num, userdata) < 0) {
+		IAS_ERROR("Failed to create XML config parser");
+		tree_unref(tree);
+		return -1;
 	}
+
+	for (i = 0; i < tree->num_events; i++) {
+		event = &tree->events[i];
+		if (event->attrs)
+			startElement(&parser, event->name,
+					(const char **)event->attrs);
+		else
+			endElement(&parser, event->name);
+	}
+
+	if (tree->error != XML_ERROR_NONE)
+		IAS_ERROR("Unable to parse IAS config at %s:%lu: %s",
+				filename, tree->error_line,
+				XML_ErrorString(tree->error));
+
+	parser_fini(&parser);
+	tree_unref(tree);
+
+	return 0;
 }
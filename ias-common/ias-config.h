@@ -0,0 +1,79 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: ias-config.h
+ *-----------------------------------------------------------------------------
+ * Copyright 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *-----------------------------------------------------------------------------
+ * Description:
+ *   IAS XML configuration file loader.
+ *-----------------------------------------------------------------------------
+ */
+
+
+#ifndef __IAS_CONFIG_H__
+#define __IAS_CONFIG_H__
+
+/***
+ *** Configuration functionality
+ ***/
+
+/* Valid XML elements we can parse */
+enum ias_element {
+	NONE		= 0,
+	IASCONFIG	= 1,
+	BACKEND		= 2,
+	STARTUP		= 4,
+	CRTC		= 8,
+	OUTPUT		= 16,
+	HMI			= 32,
+	PLUGIN		= 64,
+	INPUTPLUGIN = 128,
+	INPUT		= 256,
+	ENV			= 512,
+	GLOBAL_ENV	= 1024,
+	REM_DISP	= 2048,
+};
+
+/* Type to hold element -> handler mapping and hierarchy */
+struct xml_element {
+	enum ias_element id;
+	char *name;
+	void (*begin_handler)(void *, const char **);
+	unsigned int valid_children;
+	enum ias_element return_to;
+};
+
+/*
+ * Parses the IAS config file using the provided state machine info.
+ *
+ * Safe to call from several threads at once. Each file is parsed only
+ * once per content; later calls replay the cached elements through the
+ * given state machine.
+ */
+int ias_read_configuration(char *, struct xml_element *, int, void *);
+
+/* Drops all cached configuration files */
+void ias_config_cache_flush(void);
+
+#endif /* __IAS_CONFIG_H__ */
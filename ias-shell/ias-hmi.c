@@ -73,20 +73,18 @@ ias_hmi_set_behavior(struct wl_client *client,
 		break;
 	}
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-			shsurf->next_behavior = (behavior & 0x00ffffff) |
-				(shsurf->behavior & 0xff000000);
-			if(touch && shsurf->next_behavior & IAS_HMI_INPUT_OWNER) {
-				shell->compositor->input_view = shsurf->view;
-				weston_touch_set_focus(touch, shsurf->view);
-			} else {
-				shell->compositor->input_view = NULL;
-				ias_committed(shsurf->surface, 0, 0);
-			}
-			return;
-		}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
+
+	shsurf->next_behavior = (behavior & 0x00ffffff) |
+		(shsurf->behavior & 0xff000000);
+	if(touch && shsurf->next_behavior & IAS_HMI_INPUT_OWNER) {
+		shell->compositor->input_view = shsurf->view;
+		weston_touch_set_focus(touch, shsurf->view);
+	} else {
+		shell->compositor->input_view = NULL;
+		ias_committed(shsurf->surface, 0, 0);
 	}
 }
 
@@ -102,37 +100,35 @@ ias_hmi_set_constant_alpha(struct wl_client *client,
 	int32_t rel_alpha;
 	int32_t new_alpha;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-			rel_alpha = alpha - (uint32_t)(shsurf->view->alpha * 0xFF);
-
-			if (alpha <= 0xFF) {
-				shsurf->view->alpha =
-						(GLfloat)((GLfloat) alpha / (GLfloat) 0xFF);
-				weston_surface_damage(shsurf->surface);
-
-				/* Need to modify the alpha value for descendant surfaces */
-				wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
-					new_alpha =
-						(uint32_t)(child_shsurf->view->alpha * 0xFF) +
-						rel_alpha;
-
-					if (new_alpha < 0) {
-						new_alpha = 0;
-					} else if (new_alpha > 0xFF) {
-						new_alpha = 0xFF;
-					}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
 
-					ias_hmi_set_constant_alpha(client, shell_resource,
-							SURFPTR2ID(child_shsurf), new_alpha);
-				}
+	rel_alpha = alpha - (uint32_t)(shsurf->view->alpha * 0xFF);
+
+	if (alpha <= 0xFF) {
+		shsurf->view->alpha =
+				(GLfloat)((GLfloat) alpha / (GLfloat) 0xFF);
+		weston_surface_damage(shsurf->surface);
 
-			} else {
-				IAS_DEBUG("Invalid alpha value specified");
+		/* Need to modify the alpha value for descendant surfaces */
+		wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
+			new_alpha =
+				(uint32_t)(child_shsurf->view->alpha * 0xFF) +
+				rel_alpha;
+
+			if (new_alpha < 0) {
+				new_alpha = 0;
+			} else if (new_alpha > 0xFF) {
+				new_alpha = 0xFF;
 			}
-			return;
+
+			ias_hmi_set_constant_alpha(client, shell_resource,
+					SURFPTR2ID(child_shsurf), new_alpha);
 		}
+
+	} else {
+		IAS_DEBUG("Invalid alpha value specified");
 	}
 }
 
@@ -147,35 +143,32 @@ ias_hmi_move_surface(struct wl_client *client,
 	struct ias_surface *child_shsurf;
 	int32_t relx, rely;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-			/* Don't try to move fullscreen or background surfaces */
-			if (shsurf->zorder == SHELL_SURFACE_ZORDER_BACKGROUND ||
-					shsurf->zorder == SHELL_SURFACE_ZORDER_FULLSCREEN) {
-				return;
-			}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
 
-			/* Store the relative change in position so we know how much
-			 * to move the child surfaces. When a surface is first created,
-			 * shsurf->x still has the value of 0.
-			 */
-			relx = x - (int32_t)shsurf->view->geometry.x;
-			rely = y - (int32_t)shsurf->view->geometry.y;
-			shsurf->x = x;
-			shsurf->y = y;
-			shsurf->position_update = 1;
-			ias_committed(shsurf->surface, 0, 0);
-
-			wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
-				ias_hmi_move_surface(client, shell_resource,
-						SURFPTR2ID(child_shsurf),
-						child_shsurf->view->geometry.x + relx,
-						child_shsurf->view->geometry.y + rely);
-			}
+	/* Don't try to move fullscreen or background surfaces */
+	if (shsurf->zorder == SHELL_SURFACE_ZORDER_BACKGROUND ||
+			shsurf->zorder == SHELL_SURFACE_ZORDER_FULLSCREEN) {
+		return;
+	}
 
-			return;
-		}
+	/* Store the relative change in position so we know how much
+	 * to move the child surfaces. When a surface is first created,
+	 * shsurf->x still has the value of 0.
+	 */
+	relx = x - (int32_t)shsurf->view->geometry.x;
+	rely = y - (int32_t)shsurf->view->geometry.y;
+	shsurf->x = x;
+	shsurf->y = y;
+	shsurf->position_update = 1;
+	ias_committed(shsurf->surface, 0, 0);
+
+	wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
+		ias_hmi_move_surface(client, shell_resource,
+				SURFPTR2ID(child_shsurf),
+				child_shsurf->view->geometry.x + relx,
+				child_shsurf->view->geometry.y + rely);
 	}
 }
 
@@ -190,48 +183,45 @@ ias_hmi_resize_surface(struct wl_client *client,
 	struct weston_surface *es;
 	struct weston_frame_callback *cb, *cnext;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-			if (shsurf->zorder == SHELL_SURFACE_ZORDER_BACKGROUND ||
-					shsurf->zorder == SHELL_SURFACE_ZORDER_FULLSCREEN ||
-					(width <= 0 || height <= 0)) {
-				ias_hmi_send_surface_info(client_resource, SURFPTR2ID(shsurf),
-						shsurf->title,
-						shsurf->zorder,
-						(int32_t)shsurf->view->geometry.x,
-						(int32_t)shsurf->view->geometry.y,
-						shsurf->surface->width,
-						shsurf->surface->height,
-						(uint32_t) (shsurf->view->alpha * 0xFF),
-						(uint32_t) (shsurf->behavior),
-						shsurf->pid,
-						shsurf->pname,
-						shsurf->view->output ? shsurf->view->output->id : 0,
-						ias_surface_is_flipped(shsurf));
-
-				return;
-			}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
 
-			shsurf->hmi_client->send_configure(shsurf->surface,
-					width, height);
-
-			/*
-			 * Send callbacks for any outstanding 'frame' requests; it's
-			 * possible that the changes we made here caused the surface
-			 * to become visible even though it wasn't before.  If we
-			 * don't send a frame event to get things moving again, the
-			 * client will never send us a new buffer and the configure
-			 * event above will have no effect.
-			 */
-			es = shsurf->surface;
-			wl_list_for_each_safe(cb, cnext, &es->frame_callback_list, link) {
-				wl_callback_send_done(cb->resource, 0);
-				wl_resource_destroy(cb->resource);
-			}
+	if (shsurf->zorder == SHELL_SURFACE_ZORDER_BACKGROUND ||
+			shsurf->zorder == SHELL_SURFACE_ZORDER_FULLSCREEN ||
+			(width <= 0 || height <= 0)) {
+		ias_hmi_send_surface_info(client_resource, SURFPTR2ID(shsurf),
+				shsurf->title,
+				shsurf->zorder,
+				(int32_t)shsurf->view->geometry.x,
+				(int32_t)shsurf->view->geometry.y,
+				shsurf->surface->width,
+				shsurf->surface->height,
+				(uint32_t) (shsurf->view->alpha * 0xFF),
+				(uint32_t) (shsurf->behavior),
+				shsurf->pid,
+				shsurf->pname,
+				shsurf->view->output ? shsurf->view->output->id : 0,
+				ias_surface_is_flipped(shsurf));
 
-			return;
-		}
+		return;
+	}
+
+	shsurf->hmi_client->send_configure(shsurf->surface,
+			width, height);
+
+	/*
+	 * Send callbacks for any outstanding 'frame' requests; it's
+	 * possible that the changes we made here caused the surface
+	 * to become visible even though it wasn't before.  If we
+	 * don't send a frame event to get things moving again, the
+	 * client will never send us a new buffer and the configure
+	 * event above will have no effect.
+	 */
+	es = shsurf->surface;
+	wl_list_for_each_safe(cb, cnext, &es->frame_callback_list, link) {
+		wl_callback_send_done(cb->resource, 0);
+		wl_resource_destroy(cb->resource);
 	}
 }
 
@@ -244,22 +234,20 @@ ias_hmi_zorder_surface(struct wl_client *client,
 	struct ias_shell *shell = shell_resource->data;
 	struct ias_surface *shsurf;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-			/*
-			 * Don't allow changing the zorder of "special" surfaces
-			 * (background, fullscreen, or popup).
-			 */
-			if (shsurf->zorder & 0xff000000) {
-				return;
-			}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
 
-			shsurf->next_zorder = (zorder & 0xffffff);
-			ias_committed(shsurf->surface, 0, 0);
-			return;
-		}
+	/*
+	 * Don't allow changing the zorder of "special" surfaces
+	 * (background, fullscreen, or popup).
+	 */
+	if (shsurf->zorder & 0xff000000) {
+		return;
 	}
+
+	shsurf->next_zorder = (zorder & 0xffffff);
+	ias_committed(shsurf->surface, 0, 0);
 }
 
 static void
@@ -272,32 +260,30 @@ ias_hmi_set_visible(struct wl_client *client,
 	struct ias_surface *shsurf;
 	struct ias_surface *child_shsurf;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-			/*
-			 * If the client wants to make this surface visible and
-			 * its already not visible, then we will make it visible
-			 */
-			if (visibility == IAS_HMI_VISIBLE_OPTIONS_VISIBLE &&
-					shsurf->behavior & SHELL_SURFACE_BEHAVIOR_HIDDEN) {
-				shsurf->next_behavior &= ~SHELL_SURFACE_BEHAVIOR_HIDDEN;
-				ias_committed(shsurf->surface, 0, 0);
-				weston_compositor_damage_all(shell->compositor);
-			} else if (visibility == IAS_HMI_VISIBLE_OPTIONS_HIDDEN &&
-					!(shsurf->behavior & SHELL_SURFACE_BEHAVIOR_HIDDEN)) {
-				shsurf->next_behavior |= SHELL_SURFACE_BEHAVIOR_HIDDEN;
-				ias_committed(shsurf->surface, 0, 0);
-				weston_compositor_damage_all(shell->compositor);
-			}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
 
-			/* Set the visibility for child and descendant surfaces. */
-			wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
-				ias_hmi_set_visible(client, shell_resource,
-						SURFPTR2ID(child_shsurf), visibility);
-			}
-			return;
-		}
+	/*
+	 * If the client wants to make this surface visible and
+	 * its already not visible, then we will make it visible
+	 */
+	if (visibility == IAS_HMI_VISIBLE_OPTIONS_VISIBLE &&
+			shsurf->behavior & SHELL_SURFACE_BEHAVIOR_HIDDEN) {
+		shsurf->next_behavior &= ~SHELL_SURFACE_BEHAVIOR_HIDDEN;
+		ias_committed(shsurf->surface, 0, 0);
+		weston_compositor_damage_all(shell->compositor);
+	} else if (visibility == IAS_HMI_VISIBLE_OPTIONS_HIDDEN &&
+			!(shsurf->behavior & SHELL_SURFACE_BEHAVIOR_HIDDEN)) {
+		shsurf->next_behavior |= SHELL_SURFACE_BEHAVIOR_HIDDEN;
+		ias_committed(shsurf->surface, 0, 0);
+		weston_compositor_damage_all(shell->compositor);
+	}
+
+	/* Set the visibility for child and descendant surfaces. */
+	wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
+		ias_hmi_set_visible(client, shell_resource,
+				SURFPTR2ID(child_shsurf), visibility);
 	}
 }
 
@@ -313,7 +299,7 @@ ias_hmi_start_capture(struct wl_client *client,
 	struct ias_shell *ias_shell = shell_resource->data;
 	struct ias_backend *ias_backend =
 			(struct ias_backend *)ias_shell->compositor->backend;
-	struct ias_surface *shsurf;
+	struct ias_surface *shsurf = NULL;
 	struct weston_surface *surface = NULL;
 	pid_t pid;
 	uid_t uid;
@@ -335,12 +321,10 @@ ias_hmi_start_capture(struct wl_client *client,
 	}
 
 	if (surfid){
-		wl_list_for_each(shsurf, &ias_shell->client_surfaces, surface_link) {
-			if (SURFPTR2ID(shsurf) == surfid) {
-				surface = shsurf->surface;
-				printf("Starting capture for surface %p.\n", surface);
-				break;
-			}
+		shsurf = ias_shell_get_surface_from_id(ias_shell, surfid);
+		if (shsurf) {
+			surface = shsurf->surface;
+			printf("Starting capture for surface %p.\n", surface);
 		}
 	} else {
 		printf("Starting capture for output %u.\n", output_number);
@@ -374,7 +358,7 @@ ias_hmi_stop_capture(struct wl_client *client,
 	struct ias_shell *ias_shell = shell_resource->data;
 	struct ias_backend *ias_backend =
 			(struct ias_backend *)ias_shell->compositor->backend;
-	struct ias_surface *shsurf;
+	struct ias_surface *shsurf = NULL;
 	struct weston_surface *surface = NULL;
 	uid_t uid;
 	gid_t gid;
@@ -395,12 +379,10 @@ ias_hmi_stop_capture(struct wl_client *client,
 	}
 
 	if (surfid){
-		wl_list_for_each(shsurf, &ias_shell->client_surfaces, surface_link) {
-			if (SURFPTR2ID(shsurf) == surfid) {
-				surface = shsurf->surface;
-				printf("Stopping capture for surface %p.\n", surface);
-				break;
-			}
+		shsurf = ias_shell_get_surface_from_id(ias_shell, surfid);
+		if (shsurf) {
+			surface = shsurf->surface;
+			printf("Stopping capture for surface %p.\n", surface);
 		}
 	} else {
 		printf("Stopping capture for output %u.\n", output_number);
@@ -445,11 +427,9 @@ ias_hmi_release_buffer_handle(struct wl_client *client,
 		struct ias_surface *shsurf;
 
 		if (surfid) {
-			wl_list_for_each(shsurf, &ias_shell->client_surfaces, surface_link) {
-				if (SURFPTR2ID(shsurf) == surfid) {
-					surface = shsurf->surface;
-					break;
-				}
+			shsurf = ias_shell_get_surface_from_id(ias_shell, surfid);
+			if (shsurf) {
+				surface = shsurf->surface;
 			}
 		}
 	}
@@ -486,33 +466,30 @@ ias_hmi_set_soc(struct wl_client *client,
 	struct ias_surface *child_shsurf;
 	struct ias_surface *shsurf;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-
-			shsurf->soc = soc;
-			/*
-			 * If this surface is not supposed to be shown on the local SoC,
-			 * then we skip rendering for it. This way, the client app can
-			 * continue to provide its buffers to the compositor and continue
-			 * rendering. However, the compositor just won't use them for
-			 * presenting on the local screen.
-			 */
-			if (!(soc & 1)) {
-				if (weston_surface_set_role(shsurf->surface, "remote_soc",
-						shell_resource, IAS_SHELL_ERROR_ROLE) < 0) {
-					return;
-				}
-				weston_compositor_damage_all(shell->compositor);
-			}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
 
-			 /* Set the soc flag for child and descendant surfaces. */
-			 wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
-				 ias_hmi_set_soc(client, shell_resource,
-						SURFPTR2ID(child_shsurf), soc);
-			}
+	shsurf->soc = soc;
+	/*
+	 * If this surface is not supposed to be shown on the local SoC,
+	 * then we skip rendering for it. This way, the client app can
+	 * continue to provide its buffers to the compositor and continue
+	 * rendering. However, the compositor just won't use them for
+	 * presenting on the local screen.
+	 */
+	if (!(soc & 1)) {
+		if (weston_surface_set_role(shsurf->surface, "remote_soc",
+				shell_resource, IAS_SHELL_ERROR_ROLE) < 0) {
 			return;
 		}
+		weston_compositor_damage_all(shell->compositor);
+	}
+
+	 /* Set the soc flag for child and descendant surfaces. */
+	 wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
+		 ias_hmi_set_soc(client, shell_resource,
+				SURFPTR2ID(child_shsurf), soc);
 	}
 }
 
@@ -545,27 +522,25 @@ ias_hmi_set_shareable(struct wl_client *client,
 	struct ias_surface *child_shsurf;
 	struct hmi_callback *cb;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-			 shsurf->shareable = shareable;
-
-			/* Notify ias_hmi listeners of the surface sharing flag change  */
-			wl_list_for_each(cb, &shell->sfc_change_callbacks, link) {
-				ias_hmi_send_surface_sharing_info(cb->resource, SURFPTR2ID(shsurf),
-					shsurf->title,
-					shsurf->shareable,
-					shsurf->pid,
-					shsurf->pname);
-			}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
 
-			 /* Set the shareable flag for child and descendant surfaces. */
-			 wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
-				ias_hmi_set_shareable(client, shell_resource,
-						SURFPTR2ID(child_shsurf), shareable);
-			}
-			return;
-		}
+	 shsurf->shareable = shareable;
+
+	/* Notify ias_hmi listeners of the surface sharing flag change  */
+	wl_list_for_each(cb, &shell->sfc_change_callbacks, link) {
+		ias_hmi_send_surface_sharing_info(cb->resource, SURFPTR2ID(shsurf),
+			shsurf->title,
+			shsurf->shareable,
+			shsurf->pid,
+			shsurf->pname);
+	}
+
+	 /* Set the shareable flag for child and descendant surfaces. */
+	 wl_list_for_each(child_shsurf, &shsurf->child_list, child_link) {
+		ias_hmi_set_shareable(client, shell_resource,
+				SURFPTR2ID(child_shsurf), shareable);
 	}
 }
 
@@ -577,18 +552,17 @@ ias_hmi_get_surface_sharing_info(struct wl_client *client,
 	struct ias_surface *shsurf;
 	struct hmi_callback *cb;
 
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == id) {
-			/* Notify ias_hmi listeners of the surface sharing flag status  */
-			wl_list_for_each(cb, &shell->sfc_change_callbacks, link) {
-				ias_hmi_send_surface_sharing_info(cb->resource, SURFPTR2ID(shsurf),
-					shsurf->title,
-					shsurf->shareable,
-					shsurf->pid,
-					shsurf->pname);
-			}
-			return;
-		}
+	shsurf = ias_shell_get_surface_from_id(shell, id);
+	if (!shsurf)
+		return;
+
+	/* Notify ias_hmi listeners of the surface sharing flag status  */
+	wl_list_for_each(cb, &shell->sfc_change_callbacks, link) {
+		ias_hmi_send_surface_sharing_info(cb->resource, SURFPTR2ID(shsurf),
+			shsurf->title,
+			shsurf->shareable,
+			shsurf->pid,
+			shsurf->pname);
 	}
 }
 
@@ -59,13 +59,10 @@ ias_relay_input_send_touch(struct wl_client *client,
 	struct wl_resource *t_resource = NULL;
 	struct weston_seat *seat = NULL;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == surfid) {
-			surf_resource = shsurf->resource;
-			ws_resource = shsurf->surface->resource;
-			break;
-		}
+	shsurf = ias_shell_get_surface_from_id(shell, surfid);
+	if (shsurf) {
+		surf_resource = shsurf->resource;
+		ws_resource = shsurf->surface->resource;
 	}
 
 	if (surf_resource == NULL) {
@@ -144,13 +141,10 @@ ias_relay_input_send_key(struct wl_client *client,
 	struct weston_seat *seat = NULL;
 	struct weston_keyboard *keyboard = NULL;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == surfid) {
-			surf_resource = shsurf->resource;
-			ws_resource = shsurf->surface->resource;
-			break;
-		}
+	shsurf = ias_shell_get_surface_from_id(shell, surfid);
+	if (shsurf) {
+		surf_resource = shsurf->resource;
+		ws_resource = shsurf->surface->resource;
 	}
 
 	if (surf_resource == NULL) {
@@ -228,13 +222,10 @@ void ias_relay_input_send_pointer(struct wl_client *client,
 	struct wl_resource *t_resource = NULL;
 	struct weston_seat *seat = NULL;
 
-	/* Walk the surface list looking for the requested surface.  */
-	wl_list_for_each(shsurf, &shell->client_surfaces, surface_link) {
-		if (SURFPTR2ID(shsurf) == surfid) {
-			surf_resource = shsurf->resource;
-			ws_resource = shsurf->surface->resource;
-			break;
-		}
+	shsurf = ias_shell_get_surface_from_id(shell, surfid);
+	if (shsurf) {
+		surf_resource = shsurf->resource;
+		ws_resource = shsurf->surface->resource;
 	}
 
 	if (surf_resource == NULL) {
@@ -899,6 +899,9 @@ ias_shell_get_ias_surface_internal(struct wl_client *client,
 	 * identifier.
 	 */
 	wl_list_insert(&shell->client_surfaces, &shsurf->surface_link);
+	if (id_index_insert(&shell->client_surface_index,
+			    SURFPTR2ID(shsurf), shsurf) < 0)
+		IAS_ERROR("Failed to index shell surface %u", SURFPTR2ID(shsurf));
 
 	wl_list_for_each(cb, &shell->sfc_change_callbacks, link) {
 		ias_hmi_send_surface_info(cb->resource, SURFPTR2ID(shsurf),
@@ -1007,6 +1010,12 @@ terminate_binding(struct wl_seat *seat,
  *** Helper functions
  ***/
 
+struct ias_surface *
+ias_shell_get_surface_from_id(struct ias_shell *shell, uint32_t id)
+{
+	return id_index_lookup(&shell->client_surface_index, id);
+}
+
 /*
  * ias_shell_destructor()
  *
@@ -1025,6 +1034,7 @@ ias_shell_destructor(struct wl_listener *listener, void *data)
 	}
 	free(shell->hmi.execname);
 
+	id_index_release(&shell->client_surface_index);
 	free(shell);
 }
 
@@ -1343,6 +1353,7 @@ ias_surface_destructor(struct ias_surface *shsurf)
 
 	/* Remove surface from surface lists */
 	wl_list_remove(&shsurf->surface_link);
+	id_index_remove(&shell->client_surface_index, SURFPTR2ID(shsurf), shsurf);
 
 	/* Remove surface from popup/background special surface lists */
 	wl_list_remove(&shsurf->special_link);
@@ -2619,6 +2630,7 @@ WL_EXPORT int wet_shell_init(struct weston_compositor *compositor,
 	wl_list_init(&shell->popup_surfaces);
 	wl_list_init(&shell->client_surfaces);
 	wl_list_init(&shell->soc_list);
+	id_index_init(&shell->client_surface_index);
 
 	/* Initialize hmi callback list */
 	wl_list_init(&shell->sfc_change_callbacks);
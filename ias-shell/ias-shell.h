@@ -39,6 +39,7 @@
 #include "config.h"
 #include <ias-common.h>
 #include <ias-shell-server-protocol.h>
+#include "shared/id-index.h"
 
 #ifndef IAS_SHELL_ERROR_ENUM
 #define IAS_SHELL_ERROR_ENUM
@@ -102,6 +103,10 @@ struct ias_shell {
 	struct wl_list client_surfaces;
 	struct wl_list soc_list;
 
+	/* client_surfaces keyed by SURFPTR2ID(), used to resolve HMI and relay
+	 * input requests */
+	struct id_index client_surface_index;
+
 #ifdef IASDEBUG
 	/*
 	 * Special 'default' background surface.  An HMI should really set the
@@ -280,4 +285,8 @@ struct ias_surface {
 // whether surface is directly flipped or composited
 int ias_surface_is_flipped(struct ias_surface *shsurf);
 
+// client surface the HMI knows by this id, or NULL
+struct ias_surface *
+ias_shell_get_surface_from_id(struct ias_shell *shell, uint32_t id);
+
 #endif
@@ -229,12 +229,6 @@ struct spug_draw_info {
 #define SPUG_IS_COMP_SOLID 	(1 << 1)
 #define SPUG_IS_CURSOR		(1 << 2)
 
-/* a node for a wl_list to track list allocations */
-struct spug_allocated_list {
-	spug_view_list allocated_list;
-	struct wl_list link;
-};
-
 /* wrapper lists */
 enum spug_wrapper_type {
 	SPUG_WRAPPER_VIEW = 0,
@@ -535,6 +529,11 @@ WL_EXPORT pixman_region32_t* spug_view_get_trans_boundingbox(const spug_view_id
  * list rather than stripping one down, which makes the max_views param to
  * spug_filter_view_list more useful.
  */
+/* copies src into *dst, which must be NULL or a list from an earlier
+ * spug_copy_view_list(). The copy belongs to the plugin and survives the
+ * frame; copying into it again reuses its storage when src fits. Hand it to
+ * spug_release_view_list() when done, which also NULLs *view_list
+ */
 WL_EXPORT void spug_copy_view_list(spug_view_list *dst, spug_view_list src);
 WL_EXPORT void spug_release_view_list(spug_view_list *view_list);
 WL_EXPORT spug_bool spug_view_list_is_empty(spug_view_list *view_list);
@@ -542,13 +541,18 @@ WL_EXPORT spug_bool spug_view_list_is_empty(spug_view_list *view_list);
 
 /* iterates over a view list, passing each view to view_draw. returns a list
  * of the views that weren't rejected by view_draw. will stop once max_views
- * is reached
+ * is reached. the list belongs to spug and stays valid until the end of the
+ * frame being drawn, don't pass it to spug_release_view_list()
  */
 WL_EXPORT spug_view_list
 spug_filter_view_list(spug_view_list view_list,
 					spug_view_filter_fn view_filter,
 					int max_views);
 
+/* largest number of bytes of filtered view lists handed out while drawing a
+ * single frame on the given output, for sizing and leak hunting */
+WL_EXPORT size_t spug_get_frame_arena_high_water(const spug_output_id output_id);
+
 /* call all the spug_init_*_list() functions below */
 WL_EXPORT void spug_init_all_lists(void);
 
@@ -34,6 +34,7 @@ extern "C" {
 #include <stdint.h>
 
 #define WESTON_CONFIG_FILE_ENV_VAR "WESTON_CONFIG_FILE"
+#define WESTON_CONFIG_SNAPSHOT_ENV_VAR "WESTON_CONFIG_SNAPSHOT"
 
 enum config_key_type {
 	CONFIG_KEY_INTEGER,		/* typeof data = int */
@@ -113,6 +114,9 @@ weston_config_get_name_from_env(void);
 struct weston_config *
 weston_config_parse(const char *name);
 
+struct weston_config *
+weston_config_parse_with_snapshot(const char *name, const char *snapshot);
+
 const char *
 weston_config_get_full_path(struct weston_config *config);
 
@@ -1170,6 +1170,7 @@ struct weston_compositor {
 	struct wl_list seat_list;
 	struct wl_list layer_list;	/* struct weston_layer::link */
 	struct wl_list view_list;	/* struct weston_view::link */
+	struct wl_list fence_wait_list;	/* weston_surface::fence_wait.link */
 	struct wl_list plane_list;
 	struct wl_list key_binding_list;
 	struct wl_list modifier_binding_list;
@@ -1217,6 +1218,11 @@ struct weston_compositor {
 	clockid_t presentation_clock;
 	int32_t repaint_msec;
 
+	/* bytes the clipboard keeps for one mime type, and for a whole
+	 * selection */
+	size_t clipboard_max_size;
+	size_t clipboard_max_total;
+
 	unsigned int activate_serial;
 
 	struct wl_global *pointer_constraints;
@@ -1621,6 +1627,17 @@ struct weston_surface {
 	int acquire_fence_fd;
 	struct weston_buffer_release_reference buffer_release_ref;
 
+	/* A commit held back because its acquire fence had not signalled.
+	 * The previous buffer stays on screen until the fence signals. */
+	struct {
+		bool held;
+		struct weston_surface_state state;
+		struct wl_event_source *source;
+		struct wl_list link; /* weston_compositor::fence_wait_list */
+	} fence_wait;
+	/* Output repaints that went ahead without the held commit */
+	uint32_t fence_misses;
+
 	enum weston_hdcp_protection desired_protection;
 	enum weston_hdcp_protection current_protection;
 	enum weston_surface_protection_mode protection_mode;
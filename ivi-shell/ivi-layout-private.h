@@ -30,6 +30,7 @@
 
 #include <libweston/libweston.h>
 #include "ivi-layout-export.h"
+#include "shared/id-index.h"
 #include <libweston-desktop/libweston-desktop.h>
 
 struct ivi_layout_view {
@@ -62,6 +63,8 @@ struct ivi_layout_surface {
 	} pending;
 
 	struct wl_list view_list;	/* ivi_layout_view::surf_link */
+	struct wl_list dirty_link;	/* ivi_layout::dirty_surface_list */
+	struct wl_list transition_list;	/* ivi_layout_transition::target_link */
 };
 
 struct ivi_layout_layer {
@@ -87,6 +90,21 @@ struct ivi_layout_layer {
 	} order;
 
 	int32_t ref_count;
+	struct wl_list dirty_link;	/* ivi_layout::dirty_layer_list */
+	struct wl_list transition_list;	/* ivi_layout_transition::target_link */
+};
+
+/*
+ * Objects walked by a commit, including the transitions looked at to find
+ * the running one of a surface or layer, so that tests can check that its
+ * cost only depends on what changed.
+ */
+struct ivi_layout_commit_stats {
+	uint32_t screens;
+	uint32_t layers;
+	uint32_t surfaces;
+	uint32_t views;
+	uint32_t transitions;	/* looked at to find a running one */
 };
 
 struct ivi_layout {
@@ -97,6 +115,22 @@ struct ivi_layout {
 	struct wl_list screen_list;	/* ivi_layout_screen::link */
 	struct wl_list view_list;	/* ivi_layout_view::link */
 
+	/* Objects with pending changes since the last commit.  A commit
+	 * only visits these, so its cost does not grow with the number of
+	 * surfaces and layers that did not change. */
+	struct wl_list dirty_surface_list;	/* ivi_layout_surface::dirty_link */
+	struct wl_list dirty_layer_list;	/* ivi_layout_layer::dirty_link */
+	struct wl_list dirty_screen_list;	/* ivi_layout_screen::dirty_link */
+	/* the weston view order must be rebuilt from the screens */
+	bool view_list_dirty;
+
+	/* objects walked by the last commit */
+	struct ivi_layout_commit_stats commit_stats;
+
+	/* surface_list and layer_list keyed by id_surface and id_layer */
+	struct id_index surface_index;
+	struct id_index layer_index;
+
 	struct {
 		struct wl_signal created;
 		struct wl_signal removed;
@@ -112,16 +146,28 @@ struct ivi_layout {
 	struct weston_layer layout_layer;
 
 	struct ivi_layout_transition_set *transitions;
-	struct wl_list pending_transition_list;	/* transition_node::link */
+	struct wl_list pending_transition_list;	/* ivi_layout_transition::link */
 };
 
 struct ivi_layout *get_instance(void);
 
 struct ivi_layout_transition;
 
+/*
+ * Transitions are stepped from the repaint loop of a single clock output:
+ * the animation hook runs after each repaint of that output, samples every
+ * active transition at the predicted presentation time of the next frame
+ * and commits the result once.  Nothing is hooked while the list is empty.
+ */
 struct ivi_layout_transition_set {
-	struct wl_event_source  *event_source;
-	struct wl_list          transition_list;
+	struct weston_compositor *compositor;
+	struct wl_list          transition_list;	/* ivi_layout_transition::link */
+
+	struct weston_animation animation;
+	struct weston_output    *clock_output;
+	struct wl_listener      clock_output_destroy_listener;
+	struct wl_listener      output_created_listener;
+	uint32_t                last_sample_msec;
 };
 
 typedef void (*ivi_layout_transition_destroy_user_func)(void *user_data);
@@ -129,6 +175,13 @@ typedef void (*ivi_layout_transition_destroy_user_func)(void *user_data);
 struct ivi_layout_transition_set *
 ivi_layout_transition_set_create(struct weston_compositor *ec);
 
+void
+ivi_layout_transition_set_start(struct ivi_layout_transition_set *transitions);
+
+void
+ivi_layout_transition_set_commit(struct ivi_layout_transition_set *transitions,
+				 struct wl_list *pending);
+
 void
 ivi_layout_transition_move_resize_view(struct ivi_layout_surface *surface,
 				       int32_t dest_x, int32_t dest_y,
@@ -163,6 +216,9 @@ is_surface_transition(struct ivi_layout_surface *surface);
 void
 ivi_layout_remove_all_surface_transitions(struct ivi_layout_surface *surface);
 
+void
+ivi_layout_remove_all_layer_transitions(struct ivi_layout_layer *layer);
+
 /**
  * methods of interaction between transition animation with ivi-layout
  */
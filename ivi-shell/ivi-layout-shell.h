@@ -60,6 +60,9 @@ ivi_layout_init_with_compositor(struct weston_compositor *ec);
 void
 ivi_layout_surface_destroy(struct ivi_layout_surface *ivisurf);
 
+void
+ivi_layout_surface_mark_dirty(struct ivi_layout_surface *ivisurf);
+
 int
 load_controller_modules(struct weston_compositor *compositor, const char *modules,
 			int *argc, char *argv[]);
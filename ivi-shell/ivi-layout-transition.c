@@ -35,6 +35,8 @@
 #include "ivi-shell.h"
 #include "ivi-layout-export.h"
 #include "ivi-layout-private.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 struct ivi_layout_transition;
 
@@ -42,7 +44,6 @@ typedef void (*ivi_layout_transition_frame_func)(
 			struct ivi_layout_transition *transition);
 typedef void (*ivi_layout_transition_destroy_func)(
 			struct ivi_layout_transition *transition);
-typedef int32_t (*ivi_layout_is_transition_func)(void *private_data, void *id);
 
 struct ivi_layout_transition {
 	enum ivi_layout_transition_type type;
@@ -53,35 +54,38 @@ struct ivi_layout_transition {
 	uint32_t time_duration;
 	uint32_t time_elapsed;
 	uint32_t  is_done;
-	ivi_layout_is_transition_func is_transition_func;
+	bool is_active;
 	ivi_layout_transition_frame_func frame_func;
 	ivi_layout_transition_destroy_func destroy_func;
-};
-
-struct transition_node {
-	struct ivi_layout_transition *transition;
 
 	/* ivi_layout::pending_transition_list
-	 * ivi_layout_transition_set::transition_list
+	 * ivi_layout_transition_set::transition_list (is_active)
 	 */
 	struct wl_list link;
+
+	/* ivi_layout_surface::transition_list
+	 * ivi_layout_layer::transition_list
+	 */
+	struct wl_list target_link;
 };
 
 static void layout_transition_destroy(struct ivi_layout_transition *transition);
 
+/*
+ * Transitions are kept on the surface or layer they animate, so a lookup
+ * only visits the handful of transitions of that one object instead of
+ * every running transition.
+ */
 static struct ivi_layout_transition *
-get_transition_from_type_and_id(enum ivi_layout_transition_type type,
-				void *id_data)
+get_transition_from_type_and_target(enum ivi_layout_transition_type type,
+				    struct wl_list *target_transitions)
 {
 	struct ivi_layout *layout = get_instance();
-	struct transition_node *node;
 	struct ivi_layout_transition *tran;
 
-	wl_list_for_each(node, &layout->transitions->transition_list, link) {
-		tran = node->transition;
-
-		if (tran->type == type &&
-		    tran->is_transition_func(tran->private_data, id_data))
+	wl_list_for_each(tran, target_transitions, target_link) {
+		layout->commit_stats.transitions++;
+		if (tran->is_active && tran->type == type)
 			return tran;
 	}
 
@@ -91,36 +95,41 @@ get_transition_from_type_and_id(enum ivi_layout_transition_type type,
 int32_t
 is_surface_transition(struct ivi_layout_surface *surface)
 {
-	struct ivi_layout *layout = get_instance();
-	struct transition_node *node;
 	struct ivi_layout_transition *tran;
 
-	wl_list_for_each(node, &layout->transitions->transition_list, link) {
-		tran = node->transition;
-
-		if ((tran->type == IVI_LAYOUT_TRANSITION_VIEW_MOVE_RESIZE ||
-		     tran->type == IVI_LAYOUT_TRANSITION_VIEW_RESIZE) &&
-		    tran->is_transition_func(tran->private_data, surface))
+	wl_list_for_each(tran, &surface->transition_list, target_link) {
+		surface->layout->commit_stats.transitions++;
+		if (tran->is_active &&
+		    (tran->type == IVI_LAYOUT_TRANSITION_VIEW_MOVE_RESIZE ||
+		     tran->type == IVI_LAYOUT_TRANSITION_VIEW_RESIZE))
 			return 1;
 	}
 
 	return 0;
 }
 
+static void
+remove_all_target_transitions(struct wl_list *target_transitions)
+{
+	struct ivi_layout_transition *tran;
+
+	while (!wl_list_empty(target_transitions)) {
+		tran = wl_container_of(target_transitions->next, tran,
+				       target_link);
+		layout_transition_destroy(tran);
+	}
+}
+
 void
 ivi_layout_remove_all_surface_transitions(struct ivi_layout_surface *surface)
 {
-	struct ivi_layout *layout = get_instance();
-	struct transition_node *node;
-	struct transition_node *tmp;
-	struct ivi_layout_transition *tran;
+	remove_all_target_transitions(&surface->transition_list);
+}
 
-	wl_list_for_each_safe(node, tmp, &layout->transitions->transition_list, link) {
-		tran = node->transition;
-		if (tran->is_transition_func(tran->private_data, surface)) {
-			layout_transition_destroy(tran);
-		}
-	};
+void
+ivi_layout_remove_all_layer_transitions(struct ivi_layout_layer *layer)
+{
+	remove_all_target_transitions(&layer->transition_list);
 }
 
 static void
@@ -156,105 +165,202 @@ do_transition_frame(struct ivi_layout_transition *transition,
 		layout_transition_destroy(transition);
 }
 
-static int32_t
-layout_transition_frame(void *data)
+/*
+ * output->frame_time is the presentation time of the previous frame.  The
+ * frame being repainted now is shown one refresh later, and whatever the
+ * transitions commit from the animation hook is only picked up by the
+ * repaint after that, so sample two refresh periods ahead.
+ */
+static void
+predict_sample_time(struct weston_output *output,
+		    const struct timespec *frame_time,
+		    struct timespec *sample)
+{
+	int64_t refresh_nsec = 0;
+
+	if (output->current_mode && output->current_mode->refresh)
+		refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
+
+	timespec_add_nsec(sample, frame_time, 2 * refresh_nsec);
+}
+
+static void
+transition_clock_detach(struct ivi_layout_transition_set *transitions)
 {
-	struct ivi_layout_transition_set *transitions = data;
-	uint32_t fps = 30;
-	struct timespec timestamp = {};
-	uint32_t msec = 0;
-	struct transition_node *node = NULL;
-	struct transition_node *next = NULL;
+	if (!transitions->clock_output)
+		return;
+
+	wl_list_remove(&transitions->animation.link);
+	wl_list_init(&transitions->animation.link);
+	wl_list_remove(&transitions->clock_output_destroy_listener.link);
+	wl_list_init(&transitions->clock_output_destroy_listener.link);
+	transitions->clock_output = NULL;
+}
+
+static void
+layout_transition_frame(struct weston_animation *animation,
+			struct weston_output *output,
+			const struct timespec *time)
+{
+	struct ivi_layout_transition_set *transitions =
+		container_of(animation, struct ivi_layout_transition_set,
+			     animation);
+	struct ivi_layout_transition *tran = NULL;
+	struct ivi_layout_transition *next = NULL;
+	struct timespec sample;
+	uint32_t msec;
 
 	if (wl_list_empty(&transitions->transition_list)) {
-		wl_event_source_timer_update(transitions->event_source, 0);
-		return 1;
+		transition_clock_detach(transitions);
+		return;
 	}
 
-	wl_event_source_timer_update(transitions->event_source, 1000 / fps);
+	predict_sample_time(output, time, &sample);
+	msec = timespec_to_msec(&sample);
+
+	/* A second repaint within the same refresh period (e.g. a damage
+	 * flush) would present nothing new, so don't commit again. */
+	if (animation->frame_counter > 1 &&
+	    (int32_t)(msec - transitions->last_sample_msec) <= 0)
+		return;
+	transitions->last_sample_msec = msec;
 
-	clock_gettime(CLOCK_MONOTONIC, &timestamp);/* FIXME */
-	msec = (1e+3 * timestamp.tv_sec + 1e-6 * timestamp.tv_nsec);
+	/* time_start == 0 marks a transition that has not been sampled yet */
+	if (msec == 0)
+		msec = 1;
 
-	wl_list_for_each_safe(node, next, &transitions->transition_list, link) {
-		do_transition_frame(node->transition, msec);
+	wl_list_for_each_safe(tran, next, &transitions->transition_list, link) {
+		do_transition_frame(tran, msec);
 	}
 
 	ivi_layout_commit_changes();
-	return 1;
+
+	if (wl_list_empty(&transitions->transition_list))
+		transition_clock_detach(transitions);
+	else
+		weston_output_schedule_repaint(output);
+}
+
+static struct weston_output *
+pick_clock_output(struct weston_compositor *ec)
+{
+	struct weston_output *output;
+	struct weston_output *best = NULL;
+
+	/* Drive transitions from the fastest output so that no screen is
+	 * updated less often than it refreshes. */
+	wl_list_for_each(output, &ec->output_list, link) {
+		if (!best ||
+		    (output->current_mode && best->current_mode &&
+		     output->current_mode->refresh > best->current_mode->refresh))
+			best = output;
+	}
+
+	return best;
+}
+
+static void
+clock_output_destroyed(struct wl_listener *listener, void *data)
+{
+	struct ivi_layout_transition_set *transitions =
+		container_of(listener, struct ivi_layout_transition_set,
+			     clock_output_destroy_listener);
+
+	transition_clock_detach(transitions);
+	ivi_layout_transition_set_start(transitions);
+}
+
+static void
+transition_output_created(struct wl_listener *listener, void *data)
+{
+	struct ivi_layout_transition_set *transitions =
+		container_of(listener, struct ivi_layout_transition_set,
+			     output_created_listener);
+
+	ivi_layout_transition_set_start(transitions);
+}
+
+void
+ivi_layout_transition_set_start(struct ivi_layout_transition_set *transitions)
+{
+	struct weston_output *output;
+
+	if (wl_list_empty(&transitions->transition_list))
+		return;
+
+	if (!transitions->clock_output) {
+		output = pick_clock_output(transitions->compositor);
+		if (!output)
+			return;
+
+		transitions->clock_output = output;
+		transitions->animation.frame_counter = 0;
+		wl_list_insert(output->animation_list.prev,
+			       &transitions->animation.link);
+		wl_signal_add(&output->destroy_signal,
+			      &transitions->clock_output_destroy_listener);
+	}
+
+	weston_output_schedule_repaint(transitions->clock_output);
 }
 
 struct ivi_layout_transition_set *
 ivi_layout_transition_set_create(struct weston_compositor *ec)
 {
 	struct ivi_layout_transition_set *transitions;
-	struct wl_event_loop *loop;
 
-	transitions = malloc(sizeof(*transitions));
+	transitions = zalloc(sizeof(*transitions));
 	if (transitions == NULL) {
 		weston_log("%s: memory allocation fails\n", __func__);
 		return NULL;
 	}
 
+	transitions->compositor = ec;
 	wl_list_init(&transitions->transition_list);
 
-	loop = wl_display_get_event_loop(ec->wl_display);
-	transitions->event_source =
-		wl_event_loop_add_timer(loop, layout_transition_frame,
-					transitions);
+	transitions->animation.frame = layout_transition_frame;
+	wl_list_init(&transitions->animation.link);
+	transitions->clock_output_destroy_listener.notify =
+		clock_output_destroyed;
+	wl_list_init(&transitions->clock_output_destroy_listener.link);
+	transitions->output_created_listener.notify =
+		transition_output_created;
+	wl_signal_add(&ec->output_created_signal,
+		      &transitions->output_created_listener);
 
 	return transitions;
 }
 
-static bool
-layout_transition_register(struct ivi_layout_transition *trans)
+void
+ivi_layout_transition_set_commit(struct ivi_layout_transition_set *transitions,
+				 struct wl_list *pending)
 {
-	struct ivi_layout *layout = get_instance();
-	struct transition_node *node;
+	struct ivi_layout_transition *tran;
 
-	node = malloc(sizeof(*node));
-	if (node == NULL) {
-		weston_log("%s: memory allocation fails\n", __func__);
-		return false;
-	}
+	wl_list_for_each(tran, pending, link)
+		tran->is_active = true;
+
+	wl_list_insert_list(&transitions->transition_list, pending);
+	wl_list_init(pending);
 
-	node->transition = trans;
-	wl_list_insert(&layout->pending_transition_list, &node->link);
-	return true;
+	ivi_layout_transition_set_start(transitions);
 }
 
 static void
-remove_transition(struct ivi_layout *layout,
-		  struct ivi_layout_transition *trans)
+layout_transition_register(struct ivi_layout_transition *trans,
+			   struct wl_list *target_transitions)
 {
-	struct transition_node *node;
-	struct transition_node *next;
-
-	wl_list_for_each_safe(node, next,
-			      &layout->transitions->transition_list, link) {
-		if (node->transition == trans) {
-			wl_list_remove(&node->link);
-			free(node);
-			return;
-		}
-	}
+	struct ivi_layout *layout = get_instance();
 
-	wl_list_for_each_safe(node, next,
-			      &layout->pending_transition_list, link) {
-		if (node->transition == trans) {
-			wl_list_remove(&node->link);
-			free(node);
-			return;
-		}
-	}
+	wl_list_insert(&layout->pending_transition_list, &trans->link);
+	wl_list_insert(target_transitions, &trans->target_link);
 }
 
 static void
 layout_transition_destroy(struct ivi_layout_transition *transition)
 {
-	struct ivi_layout *layout = get_instance();
-
-	remove_transition(layout, transition);
+	wl_list_remove(&transition->link);
+	wl_list_remove(&transition->target_link);
 	if (transition->destroy_func)
 		transition->destroy_func(transition);
 	free(transition);
@@ -276,14 +382,17 @@ create_layout_transition(void)
 	transition->time_elapsed = 0;
 
 	transition->is_done = 0;
+	transition->is_active = false;
 
-	transition->is_transition_func = NULL;
 	transition->private_data = NULL;
 	transition->user_data = NULL;
 
 	transition->frame_func = NULL;
 	transition->destroy_func = NULL;
 
+	wl_list_init(&transition->link);
+	wl_list_init(&transition->target_link);
+
 	return transition;
 }
 
@@ -341,13 +450,6 @@ transition_move_resize_view_user_frame(struct ivi_layout_transition *transition)
 						     dest_width, dest_height);
 }
 
-static int32_t
-is_transition_move_resize_view_func(struct move_resize_view_data *data,
-				    struct ivi_layout_surface *view)
-{
-	return data->surface == view;
-}
-
 static struct ivi_layout_transition *
 create_move_resize_view_transition(
 			struct ivi_layout_surface *surface,
@@ -374,7 +476,6 @@ create_move_resize_view_transition(
 	}
 
 	transition->type = IVI_LAYOUT_TRANSITION_VIEW_MOVE_RESIZE;
-	transition->is_transition_func = (ivi_layout_is_transition_func)is_transition_move_resize_view_func;
 
 	transition->frame_func = frame_func;
 	transition->destroy_func = destroy_func;
@@ -414,9 +515,9 @@ ivi_layout_transition_move_resize_view(struct ivi_layout_surface *surface,
 		surface->pending.prop.start_height
 	};
 
-	transition = get_transition_from_type_and_id(
+	transition = get_transition_from_type_and_target(
 					IVI_LAYOUT_TRANSITION_VIEW_MOVE_RESIZE,
-					surface);
+					&surface->transition_list);
 	if (transition) {
 		struct move_resize_view_data *data = transition->private_data;
 		transition->time_start = 0;
@@ -444,9 +545,9 @@ ivi_layout_transition_move_resize_view(struct ivi_layout_surface *surface,
 		transition_move_resize_view_destroy,
 		duration);
 
-	if (transition && layout_transition_register(transition))
-		return;
-	layout_transition_destroy(transition);
+	if (transition)
+		layout_transition_register(transition,
+					   &surface->transition_list);
 }
 
 /* fade transition */
@@ -474,13 +575,6 @@ fade_view_user_frame(struct ivi_layout_transition *transition)
 	ivi_layout_surface_set_visibility(surface, true);
 }
 
-static int32_t
-is_transition_fade_view_func(struct fade_view_data *data,
-			     struct ivi_layout_surface *view)
-{
-	return data->surface == view;
-}
-
 static struct ivi_layout_transition *
 create_fade_view_transition(
 			struct ivi_layout_surface *surface,
@@ -505,7 +599,6 @@ create_fade_view_transition(
 	}
 
 	transition->type = IVI_LAYOUT_TRANSITION_VIEW_FADE;
-	transition->is_transition_func = (ivi_layout_is_transition_func)is_transition_fade_view_func;
 
 	transition->user_data = user_data;
 	transition->private_data = data;
@@ -540,9 +633,9 @@ create_visibility_transition(struct ivi_layout_surface *surface,
 		destroy_func,
 		duration);
 
-	if (transition && layout_transition_register(transition))
-		return;
-	layout_transition_destroy(transition);
+	if (transition)
+		layout_transition_register(transition,
+					   &surface->transition_list);
 }
 
 static void
@@ -571,9 +664,9 @@ ivi_layout_transition_visibility_on(struct ivi_layout_surface *surface,
 	wl_fixed_t start_alpha = 0.0;
 	struct fade_view_data *data = NULL;
 
-	transition = get_transition_from_type_and_id(
+	transition = get_transition_from_type_and_target(
 					IVI_LAYOUT_TRANSITION_VIEW_FADE,
-					surface);
+					&surface->transition_list);
 	if (transition) {
 		start_alpha = surface->prop.opacity;
 		user_data = transition->user_data;
@@ -635,8 +728,9 @@ ivi_layout_transition_visibility_off(struct ivi_layout_surface *surface,
 	struct fade_view_data* data = NULL;
 
 	transition =
-		get_transition_from_type_and_id(IVI_LAYOUT_TRANSITION_VIEW_FADE,
-						surface);
+		get_transition_from_type_and_target(
+					IVI_LAYOUT_TRANSITION_VIEW_FADE,
+					&surface->transition_list);
 	if (transition) {
 		data = transition->private_data;
 
@@ -706,14 +800,6 @@ transition_move_layer_destroy(struct ivi_layout_transition *transition)
 	transition->private_data = NULL;
 }
 
-static int32_t
-is_transition_move_layer_func(struct move_layer_data *data,
-			      struct ivi_layout_layer *layer)
-{
-	return data->layer == layer;
-}
-
-
 static struct ivi_layout_transition *
 create_move_layer_transition(
 		struct ivi_layout_layer *layer,
@@ -738,7 +824,6 @@ create_move_layer_transition(
 	}
 
 	transition->type = IVI_LAYOUT_TRANSITION_LAYER_MOVE;
-	transition->is_transition_func = (ivi_layout_is_transition_func)is_transition_move_layer_func;
 
 	transition->frame_func = transition_move_layer_user_frame;
 	transition->destroy_func = transition_move_layer_destroy;
@@ -774,19 +859,18 @@ ivi_layout_transition_move_layer(struct ivi_layout_layer *layer,
 		NULL, NULL,
 		duration);
 
-	if (transition && layout_transition_register(transition))
-		return;
-
-	free(transition);
+	if (transition)
+		layout_transition_register(transition,
+					   &layer->transition_list);
 }
 
 void
 ivi_layout_transition_move_layer_cancel(struct ivi_layout_layer *layer)
 {
 	struct ivi_layout_transition *transition =
-		get_transition_from_type_and_id(
+		get_transition_from_type_and_target(
 					IVI_LAYOUT_TRANSITION_LAYER_MOVE,
-					layer);
+					&layer->transition_list);
 	if (transition) {
 		layout_transition_destroy(transition);
 	}
@@ -826,13 +910,6 @@ transition_fade_layer_user_frame(struct ivi_layout_transition *transition)
 	ivi_layout_layer_set_visibility(data->layer, is_visible);
 }
 
-static int32_t
-is_transition_fade_layer_func(struct fade_layer_data *data,
-			      struct ivi_layout_layer *layer)
-{
-	return data->layer == layer;
-}
-
 void
 ivi_layout_transition_fade_layer(
 			struct ivi_layout_layer *layer,
@@ -848,9 +925,9 @@ ivi_layout_transition_fade_layer(
 	double now_opacity;
 	double remain;
 
-	transition = get_transition_from_type_and_id(
+	transition = get_transition_from_type_and_target(
 					IVI_LAYOUT_TRANSITION_LAYER_FADE,
-					layer);
+					&layer->transition_list);
 	if (transition) {
 		/* transition update */
 		data = transition->private_data;
@@ -883,7 +960,6 @@ ivi_layout_transition_fade_layer(
 	}
 
 	transition->type = IVI_LAYOUT_TRANSITION_LAYER_FADE;
-	transition->is_transition_func = (ivi_layout_is_transition_func)is_transition_fade_layer_func;
 
 	transition->private_data = data;
 	transition->user_data = user_data;
@@ -900,9 +976,6 @@ ivi_layout_transition_fade_layer(
 	data->end_alpha = end_alpha;
 	data->destroy_func = destroy_func;
 
-	if (!layout_transition_register(transition))
-		layout_transition_destroy(transition);
-
-	return;
+	layout_transition_register(transition, &layer->transition_list);
 }
 
@@ -89,6 +89,8 @@ struct ivi_layout_screen {
 		int dirty;
 		struct wl_list layer_list;	/* ivi_layout_layer::order.link */
 	} order;
+
+	struct wl_list dirty_link;	/* ivi_layout::dirty_screen_list */
 };
 
 struct ivi_rectangle
@@ -110,34 +112,6 @@ get_instance(void)
 /**
  * Internal API to add/remove an ivi_layer to/from ivi_screen.
  */
-static struct ivi_layout_surface *
-get_surface(struct wl_list *surf_list, uint32_t id_surface)
-{
-	struct ivi_layout_surface *ivisurf;
-
-	wl_list_for_each(ivisurf, surf_list, link) {
-		if (ivisurf->id_surface == id_surface) {
-			return ivisurf;
-		}
-	}
-
-	return NULL;
-}
-
-static struct ivi_layout_layer *
-get_layer(struct wl_list *layer_list, uint32_t id_layer)
-{
-	struct ivi_layout_layer *ivilayer;
-
-	wl_list_for_each(ivilayer, layer_list, link) {
-		if (ivilayer->id_layer == id_layer) {
-			return ivilayer;
-		}
-	}
-
-	return NULL;
-}
-
 static bool
 ivi_view_is_rendered(struct ivi_layout_view *view)
 {
@@ -231,6 +205,33 @@ get_screen_from_output(struct weston_output *output)
 	return NULL;
 }
 
+/**
+ * Internal APIs to queue an object for the next ivi_layout_commit_changes.
+ */
+void
+ivi_layout_surface_mark_dirty(struct ivi_layout_surface *ivisurf)
+{
+	if (wl_list_empty(&ivisurf->dirty_link))
+		wl_list_insert(ivisurf->layout->dirty_surface_list.prev,
+			       &ivisurf->dirty_link);
+}
+
+static void
+layer_mark_dirty(struct ivi_layout_layer *ivilayer)
+{
+	if (wl_list_empty(&ivilayer->dirty_link))
+		wl_list_insert(ivilayer->layout->dirty_layer_list.prev,
+			       &ivilayer->dirty_link);
+}
+
+static void
+screen_mark_dirty(struct ivi_layout_screen *iviscrn)
+{
+	if (wl_list_empty(&iviscrn->dirty_link))
+		wl_list_insert(iviscrn->layout->dirty_screen_list.prev,
+			       &iviscrn->dirty_link);
+}
+
 /**
  * Called at destruction of wl_surface/ivi_surface
  */
@@ -246,6 +247,7 @@ ivi_layout_surface_destroy(struct ivi_layout_surface *ivisurf)
 	}
 
 	wl_list_remove(&ivisurf->link);
+	id_index_remove(&layout->surface_index, ivisurf->id_surface, ivisurf);
 
 	wl_list_for_each_safe(ivi_view, next, &ivisurf->view_list, surf_link) {
 		ivi_view_destroy(ivi_view);
@@ -253,7 +255,9 @@ ivi_layout_surface_destroy(struct ivi_layout_surface *ivisurf)
 
 	wl_signal_emit(&layout->surface_notification.removed, ivisurf);
 
+	/* transition destructors may still queue the surface */
 	ivi_layout_remove_all_surface_transitions(ivisurf);
+	wl_list_remove(&ivisurf->dirty_link);
 
 	free(ivisurf);
 }
@@ -284,6 +288,8 @@ create_screen(struct weston_compositor *ec)
 
 		wl_list_init(&iviscrn->order.layer_list);
 
+		wl_list_init(&iviscrn->dirty_link);
+
 		wl_list_insert(&layout->screen_list, &iviscrn->link);
 	}
 }
@@ -606,17 +612,33 @@ ivi_view_is_mapped(struct ivi_layout_view *ivi_view)
 static void
 commit_changes(struct ivi_layout *layout)
 {
+	struct ivi_layout_layer *ivilayer = NULL;
+	struct ivi_layout_surface *ivisurf = NULL;
 	struct ivi_layout_view *ivi_view  = NULL;
 
-	wl_list_for_each(ivi_view, &layout->view_list, link) {
-		/*
-		 * If the view is not on the currently rendered scenegraph,
-		 * we do not need to update its properties.
-		 */
-		if (!ivi_view_is_mapped(ivi_view))
-			continue;
+	/*
+	 * If the view is not on the currently rendered scenegraph,
+	 * we do not need to update its properties.
+	 */
+	wl_list_for_each(ivilayer, &layout->dirty_layer_list, dirty_link) {
+		wl_list_for_each(ivi_view, &ivilayer->order.view_list, order_link) {
+			layout->commit_stats.views++;
+			if (ivi_view_is_mapped(ivi_view))
+				update_prop(ivi_view);
+		}
+	}
 
-		update_prop(ivi_view);
+	wl_list_for_each(ivisurf, &layout->dirty_surface_list, dirty_link) {
+		wl_list_for_each(ivi_view, &ivisurf->view_list, surf_link) {
+			layout->commit_stats.views++;
+
+			/* already updated through its layer */
+			if (!wl_list_empty(&ivi_view->on_layer->dirty_link))
+				continue;
+
+			if (ivi_view_is_mapped(ivi_view))
+				update_prop(ivi_view);
+		}
 	}
 }
 
@@ -630,7 +652,9 @@ commit_surface_list(struct ivi_layout *layout)
 	int32_t dest_height = 0;
 	int32_t configured = 0;
 
-	wl_list_for_each(ivisurf, &layout->surface_list, link) {
+	wl_list_for_each(ivisurf, &layout->dirty_surface_list, dirty_link) {
+		layout->commit_stats.surfaces++;
+
 		if (ivisurf->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_VIEW_DEFAULT) {
 			dest_x = ivisurf->prop.dest_x;
 			dest_y = ivisurf->prop.dest_y;
@@ -729,7 +753,9 @@ commit_layer_list(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_view *next     = NULL;
 
-	wl_list_for_each(ivilayer, &layout->layer_list, link) {
+	wl_list_for_each(ivilayer, &layout->dirty_layer_list, dirty_link) {
+		layout->commit_stats.layers++;
+
 		if (ivilayer->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_LAYER_MOVE) {
 			ivi_layout_transition_move_layer(ivilayer, ivilayer->pending.prop.dest_x, ivilayer->pending.prop.dest_y, ivilayer->pending.prop.transition_duration);
 		} else if (ivilayer->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_LAYER_FADE) {
@@ -748,21 +774,26 @@ commit_layer_list(struct ivi_layout *layout)
 
 		wl_list_for_each_safe(ivi_view, next, &ivilayer->order.view_list,
 					 order_link) {
+			layout->commit_stats.views++;
 			wl_list_remove(&ivi_view->order_link);
 			wl_list_init(&ivi_view->order_link);
 			ivi_view->ivisurf->prop.event_mask |= IVI_NOTIFICATION_REMOVE;
+			ivi_layout_surface_mark_dirty(ivi_view->ivisurf);
 		}
 
 		assert(wl_list_empty(&ivilayer->order.view_list));
 
 		wl_list_for_each(ivi_view, &ivilayer->pending.view_list,
 					 pending_link) {
+			layout->commit_stats.views++;
 			wl_list_remove(&ivi_view->order_link);
 			wl_list_insert(&ivilayer->order.view_list, &ivi_view->order_link);
 			ivi_view->ivisurf->prop.event_mask |= IVI_NOTIFICATION_ADD;
+			ivi_layout_surface_mark_dirty(ivi_view->ivisurf);
 		}
 
 		ivilayer->order.dirty = 0;
+		layout->view_list_dirty = true;
 	}
 }
 
@@ -773,14 +804,18 @@ commit_screen_list(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_layer   *next     = NULL;
 
-	wl_list_for_each(iviscrn, &layout->screen_list, link) {
+	wl_list_for_each(iviscrn, &layout->dirty_screen_list, dirty_link) {
+		layout->commit_stats.screens++;
+
 		if (iviscrn->order.dirty) {
 			wl_list_for_each_safe(ivilayer, next,
 					      &iviscrn->order.layer_list, order.link) {
+				layout->commit_stats.layers++;
 				ivilayer->on_screen = NULL;
 				wl_list_remove(&ivilayer->order.link);
 				wl_list_init(&ivilayer->order.link);
 				ivilayer->prop.event_mask |= IVI_NOTIFICATION_REMOVE;
+				layer_mark_dirty(ivilayer);
 			}
 
 			assert(wl_list_empty(&iviscrn->order.layer_list));
@@ -788,21 +823,24 @@ commit_screen_list(struct ivi_layout *layout)
 			wl_list_for_each(ivilayer, &iviscrn->pending.layer_list,
 					 pending.link) {
 				/* FIXME: avoid to insert order.link to multiple screens */
+				layout->commit_stats.layers++;
 				wl_list_remove(&ivilayer->order.link);
 
 				wl_list_insert(&iviscrn->order.layer_list,
 					       &ivilayer->order.link);
 				ivilayer->on_screen = iviscrn;
 				ivilayer->prop.event_mask |= IVI_NOTIFICATION_ADD;
+				layer_mark_dirty(ivilayer);
 			}
 
 			iviscrn->order.dirty = 0;
+			layout->view_list_dirty = true;
 		}
 	}
 }
 
 static void
-build_view_list(struct ivi_layout *layout)
+rebuild_view_list(struct ivi_layout *layout)
 {
 	struct ivi_layout_screen  *iviscrn;
 	struct ivi_layout_layer   *ivilayer;
@@ -812,6 +850,7 @@ build_view_list(struct ivi_layout *layout)
 	 * weston_views
 	 */
 	wl_list_for_each(ivi_view, &layout->view_list, link) {
+		layout->commit_stats.views++;
 		if (!ivi_view_is_mapped(ivi_view))
 			weston_view_unmap(ivi_view->view);
 	}
@@ -821,10 +860,12 @@ build_view_list(struct ivi_layout *layout)
 
 	wl_list_for_each(iviscrn, &layout->screen_list, link) {
 		wl_list_for_each(ivilayer, &iviscrn->order.layer_list, order.link) {
+			layout->commit_stats.layers++;
 			if (ivilayer->prop.visibility == false)
 				continue;
 
 			wl_list_for_each(ivi_view, &ivilayer->order.view_list, order_link) {
+				layout->commit_stats.views++;
 				if (ivi_view->ivisurf->prop.visibility == false)
 					continue;
 
@@ -838,6 +879,61 @@ build_view_list(struct ivi_layout *layout)
 	}
 }
 
+/*
+ * Returns true if the weston view has to be inserted into the layout
+ * layer, which needs the full render order.  Views that have to leave
+ * the scenegraph are unmapped in place.
+ */
+static bool
+patch_view(struct ivi_layout_view *ivi_view)
+{
+	bool mapped = ivi_view_is_mapped(ivi_view);
+
+	if (mapped == weston_view_is_mapped(ivi_view->view))
+		return false;
+
+	if (mapped)
+		return true;
+
+	weston_view_unmap(ivi_view->view);
+	return false;
+}
+
+static void
+build_view_list(struct ivi_layout *layout)
+{
+	struct ivi_layout_layer   *ivilayer;
+	struct ivi_layout_surface *ivisurf;
+	struct ivi_layout_view    *ivi_view;
+
+	/* Only order changes and views entering the scenegraph rebuild the
+	 * layout layer; property changes and removals leave it in place. */
+	if (!layout->view_list_dirty) {
+		wl_list_for_each(ivilayer, &layout->dirty_layer_list, dirty_link) {
+			wl_list_for_each(ivi_view, &ivilayer->order.view_list,
+					 order_link) {
+				layout->commit_stats.views++;
+				if (patch_view(ivi_view))
+					layout->view_list_dirty = true;
+			}
+		}
+
+		wl_list_for_each(ivisurf, &layout->dirty_surface_list, dirty_link) {
+			wl_list_for_each(ivi_view, &ivisurf->view_list, surf_link) {
+				layout->commit_stats.views++;
+				if (patch_view(ivi_view))
+					layout->view_list_dirty = true;
+			}
+		}
+	}
+
+	if (!layout->view_list_dirty)
+		return;
+
+	rebuild_view_list(layout);
+	layout->view_list_dirty = false;
+}
+
 static void
 commit_transition(struct ivi_layout* layout)
 {
@@ -845,18 +941,15 @@ commit_transition(struct ivi_layout* layout)
 		return;
 	}
 
-	wl_list_insert_list(&layout->transitions->transition_list,
-			    &layout->pending_transition_list);
-
-	wl_list_init(&layout->pending_transition_list);
-
-	wl_event_source_timer_update(layout->transitions->event_source, 1);
+	ivi_layout_transition_set_commit(layout->transitions,
+					 &layout->pending_transition_list);
 }
 
 static void
 send_surface_prop(struct ivi_layout_surface *ivisurf)
 {
 	wl_signal_emit(&ivisurf->property_changed, ivisurf);
+	ivisurf->prop.event_mask = 0;
 	ivisurf->pending.prop.event_mask = 0;
 }
 
@@ -864,21 +957,51 @@ static void
 send_layer_prop(struct ivi_layout_layer *ivilayer)
 {
 	wl_signal_emit(&ivilayer->property_changed, ivilayer);
+	ivilayer->prop.event_mask = 0;
 	ivilayer->pending.prop.event_mask = 0;
 }
 
+/*
+ * Empties the dirty sets.  Each object leaves its set before its listeners
+ * run, so setters called from a listener queue it for the next commit.
+ */
 static void
 send_prop(struct ivi_layout *layout)
 {
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_surface *ivisurf  = NULL;
+	struct ivi_layout_screen  *iviscrn  = NULL;
+	struct ivi_layout_screen  *next     = NULL;
+	struct wl_list layers;
+	struct wl_list surfaces;
+
+	wl_list_for_each_safe(iviscrn, next, &layout->dirty_screen_list,
+			      dirty_link)
+		wl_list_init(&iviscrn->dirty_link);
+	wl_list_init(&layout->dirty_screen_list);
+
+	wl_list_init(&layers);
+	wl_list_insert_list(&layers, &layout->dirty_layer_list);
+	wl_list_init(&layout->dirty_layer_list);
+
+	wl_list_init(&surfaces);
+	wl_list_insert_list(&surfaces, &layout->dirty_surface_list);
+	wl_list_init(&layout->dirty_surface_list);
+
+	while (!wl_list_empty(&layers)) {
+		ivilayer = wl_container_of(layers.next, ivilayer, dirty_link);
+		wl_list_remove(&ivilayer->dirty_link);
+		wl_list_init(&ivilayer->dirty_link);
 
-	wl_list_for_each_reverse(ivilayer, &layout->layer_list, link) {
 		if (ivilayer->prop.event_mask)
 			send_layer_prop(ivilayer);
 	}
 
-	wl_list_for_each_reverse(ivisurf, &layout->surface_list, link) {
+	while (!wl_list_empty(&surfaces)) {
+		ivisurf = wl_container_of(surfaces.next, ivisurf, dirty_link);
+		wl_list_remove(&ivisurf->dirty_link);
+		wl_list_init(&ivisurf->dirty_link);
+
 		if (ivisurf->prop.event_mask)
 			send_surface_prop(ivisurf);
 	}
@@ -1007,30 +1130,16 @@ static struct ivi_layout_layer *
 ivi_layout_get_layer_from_id(uint32_t id_layer)
 {
 	struct ivi_layout *layout = get_instance();
-	struct ivi_layout_layer *ivilayer = NULL;
-
-	wl_list_for_each(ivilayer, &layout->layer_list, link) {
-		if (ivilayer->id_layer == id_layer) {
-			return ivilayer;
-		}
-	}
 
-	return NULL;
+	return id_index_lookup(&layout->layer_index, id_layer);
 }
 
 struct ivi_layout_surface *
 ivi_layout_get_surface_from_id(uint32_t id_surface)
 {
 	struct ivi_layout *layout = get_instance();
-	struct ivi_layout_surface *ivisurf = NULL;
 
-	wl_list_for_each(ivisurf, &layout->surface_list, link) {
-		if (ivisurf->id_surface == id_surface) {
-			return ivisurf;
-		}
-	}
-
-	return NULL;
+	return id_index_lookup(&layout->surface_index, id_surface);
 }
 
 static int32_t
@@ -1275,7 +1384,7 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 	struct ivi_layout *layout = get_instance();
 	struct ivi_layout_layer *ivilayer = NULL;
 
-	ivilayer = get_layer(&layout->layer_list, id_layer);
+	ivilayer = ivi_layout_get_layer_from_id(id_layer);
 	if (ivilayer != NULL) {
 		weston_log("id_layer is already created\n");
 		++ivilayer->ref_count;
@@ -1301,8 +1410,16 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 
 	wl_list_init(&ivilayer->order.view_list);
 	wl_list_init(&ivilayer->order.link);
+	wl_list_init(&ivilayer->dirty_link);
+	wl_list_init(&ivilayer->transition_list);
 
 	wl_list_insert(&layout->layer_list, &ivilayer->link);
+	if (id_index_insert(&layout->layer_index, id_layer, ivilayer) < 0) {
+		weston_log("fails to allocate memory\n");
+		wl_list_remove(&ivilayer->link);
+		free(ivilayer);
+		return NULL;
+	}
 
 	wl_signal_emit(&layout->layer_notification.created, ivilayer);
 
@@ -1331,9 +1448,13 @@ ivi_layout_layer_destroy(struct ivi_layout_layer *ivilayer)
 
 	wl_signal_emit(&layout->layer_notification.removed, ivilayer);
 
+	ivi_layout_remove_all_layer_transitions(ivilayer);
+
 	wl_list_remove(&ivilayer->pending.link);
 	wl_list_remove(&ivilayer->order.link);
+	wl_list_remove(&ivilayer->dirty_link);
 	wl_list_remove(&ivilayer->link);
+	id_index_remove(&layout->layer_index, ivilayer->id_layer, ivilayer);
 
 	free(ivilayer);
 }
@@ -1350,6 +1471,7 @@ ivi_layout_layer_set_visibility(struct ivi_layout_layer *ivilayer,
 	}
 
 	prop = &ivilayer->pending.prop;
+	layer_mark_dirty(ivilayer);
 	prop->visibility = newVisibility;
 
 	if (ivilayer->prop.visibility != newVisibility)
@@ -1374,6 +1496,7 @@ ivi_layout_layer_set_opacity(struct ivi_layout_layer *ivilayer,
 	}
 
 	prop = &ivilayer->pending.prop;
+	layer_mark_dirty(ivilayer);
 	prop->opacity = opacity;
 
 	if (ivilayer->prop.opacity != opacity)
@@ -1397,6 +1520,7 @@ ivi_layout_layer_set_source_rectangle(struct ivi_layout_layer *ivilayer,
 	}
 
 	prop = &ivilayer->pending.prop;
+	layer_mark_dirty(ivilayer);
 	prop->source_x = x;
 	prop->source_y = y;
 	prop->source_width = width;
@@ -1425,6 +1549,7 @@ ivi_layout_layer_set_destination_rectangle(struct ivi_layout_layer *ivilayer,
 	}
 
 	prop = &ivilayer->pending.prop;
+	layer_mark_dirty(ivilayer);
 	prop->dest_x = x;
 	prop->dest_y = y;
 	prop->dest_width = width;
@@ -1467,6 +1592,7 @@ ivi_layout_layer_set_render_order(struct ivi_layout_layer *ivilayer,
 	}
 
 	ivilayer->order.dirty = 1;
+	layer_mark_dirty(ivilayer);
 
 	return IVI_SUCCEEDED;
 }
@@ -1483,6 +1609,7 @@ ivi_layout_surface_set_visibility(struct ivi_layout_surface *ivisurf,
 	}
 
 	prop = &ivisurf->pending.prop;
+	ivi_layout_surface_mark_dirty(ivisurf);
 	prop->visibility = newVisibility;
 
 	if (ivisurf->prop.visibility != newVisibility)
@@ -1507,6 +1634,7 @@ ivi_layout_surface_set_opacity(struct ivi_layout_surface *ivisurf,
 	}
 
 	prop = &ivisurf->pending.prop;
+	ivi_layout_surface_mark_dirty(ivisurf);
 	prop->opacity = opacity;
 
 	if (ivisurf->prop.opacity != opacity)
@@ -1530,6 +1658,7 @@ ivi_layout_surface_set_destination_rectangle(struct ivi_layout_surface *ivisurf,
 	}
 
 	prop = &ivisurf->pending.prop;
+	ivi_layout_surface_mark_dirty(ivisurf);
 	prop->start_x = prop->dest_x;
 	prop->start_y = prop->dest_y;
 	prop->dest_x = x;
@@ -1577,13 +1706,16 @@ ivi_layout_screen_add_layer(struct weston_output *output,
 
 	/*if layer is already assigned to screen make order of it dirty
 	 * we are going to remove it (in commit_screen_list)*/
-	if (addlayer->on_screen)
+	if (addlayer->on_screen) {
 		addlayer->on_screen->order.dirty = 1;
+		screen_mark_dirty(addlayer->on_screen);
+	}
 
 	wl_list_remove(&addlayer->pending.link);
 	wl_list_insert(&iviscrn->pending.layer_list, &addlayer->pending.link);
 
 	iviscrn->order.dirty = 1;
+	screen_mark_dirty(iviscrn);
 
 	return IVI_SUCCEEDED;
 }
@@ -1605,6 +1737,7 @@ ivi_layout_screen_remove_layer(struct weston_output *output,
 	wl_list_init(&removelayer->pending.link);
 
 	iviscrn->order.dirty = 1;
+	screen_mark_dirty(iviscrn);
 
 	return IVI_SUCCEEDED;
 }
@@ -1641,6 +1774,7 @@ ivi_layout_screen_set_render_order(struct weston_output *output,
 	}
 
 	iviscrn->order.dirty = 1;
+	screen_mark_dirty(iviscrn);
 
 	return IVI_SUCCEEDED;
 }
@@ -1728,6 +1862,7 @@ ivi_layout_layer_add_surface(struct ivi_layout_layer *ivilayer,
 	wl_list_insert(&ivilayer->pending.view_list, &ivi_view->pending_link);
 
 	ivilayer->order.dirty = 1;
+	layer_mark_dirty(ivilayer);
 
 	return IVI_SUCCEEDED;
 }
@@ -1749,6 +1884,7 @@ ivi_layout_layer_remove_surface(struct ivi_layout_layer *ivilayer,
 		wl_list_init(&ivi_view->pending_link);
 
 		ivilayer->order.dirty = 1;
+		layer_mark_dirty(ivilayer);
 	}
 }
 
@@ -1765,6 +1901,7 @@ ivi_layout_surface_set_source_rectangle(struct ivi_layout_surface *ivisurf,
 	}
 
 	prop = &ivisurf->pending.prop;
+	ivi_layout_surface_mark_dirty(ivisurf);
 	prop->source_x = x;
 	prop->source_y = y;
 	prop->source_width = width;
@@ -1785,6 +1922,8 @@ ivi_layout_commit_changes(void)
 {
 	struct ivi_layout *layout = get_instance();
 
+	memset(&layout->commit_stats, 0, sizeof layout->commit_stats);
+
 	commit_surface_list(layout);
 	commit_layer_list(layout);
 	commit_screen_list(layout);
@@ -1810,6 +1949,7 @@ ivi_layout_layer_set_transition(struct ivi_layout_layer *ivilayer,
 
 	ivilayer->pending.prop.transition_type = type;
 	ivilayer->pending.prop.transition_duration = duration;
+	layer_mark_dirty(ivilayer);
 
 	return 0;
 }
@@ -1827,6 +1967,7 @@ ivi_layout_layer_set_fade_info(struct ivi_layout_layer* ivilayer,
 	ivilayer->pending.prop.is_fade_in = is_fade_in;
 	ivilayer->pending.prop.start_alpha = start_alpha;
 	ivilayer->pending.prop.end_alpha = end_alpha;
+	layer_mark_dirty(ivilayer);
 
 	return 0;
 }
@@ -1843,6 +1984,7 @@ ivi_layout_surface_set_transition_duration(struct ivi_layout_surface *ivisurf,
 	}
 
 	prop = &ivisurf->pending.prop;
+	ivi_layout_surface_mark_dirty(ivisurf);
 	prop->transition_duration = duration*10;
 	return 0;
 }
@@ -1870,12 +2012,17 @@ ivi_layout_surface_set_id(struct ivi_layout_surface *ivisurf,
 		return IVI_FAILED;
 	}
 
-	search_ivisurf = get_surface(&layout->surface_list, id_surface);
+	search_ivisurf = ivi_layout_get_surface_from_id(id_surface);
 	if (search_ivisurf) {
 		weston_log("id_surface(%d) is already created\n", id_surface);
 		return IVI_FAILED;
 	}
 
+	if (id_index_insert(&layout->surface_index, id_surface, ivisurf) < 0) {
+		weston_log("fails to allocate memory\n");
+		return IVI_FAILED;
+	}
+	id_index_remove(&layout->surface_index, ivisurf->id_surface, ivisurf);
 	ivisurf->id_surface = id_surface;
 
 	wl_signal_emit(&layout->surface_notification.created, ivisurf);
@@ -1898,6 +2045,7 @@ ivi_layout_surface_set_transition(struct ivi_layout_surface *ivisurf,
 	}
 
 	prop = &ivisurf->pending.prop;
+	ivi_layout_surface_mark_dirty(ivisurf);
 	prop->transition_type = type;
 	prop->transition_duration = duration;
 	return 0;
@@ -1957,7 +2105,14 @@ surface_create(struct weston_surface *wl_surface, uint32_t id_surface)
 	ivisurf->pending.prop = ivisurf->prop;
 
 	wl_list_init(&ivisurf->view_list);
+	wl_list_init(&ivisurf->dirty_link);
+	wl_list_init(&ivisurf->transition_list);
 
+	if (id_index_insert(&layout->surface_index, id_surface, ivisurf) < 0) {
+		weston_log("fails to allocate memory\n");
+		free(ivisurf);
+		return NULL;
+	}
 	wl_list_insert(&layout->surface_list, &ivisurf->link);
 
 	return ivisurf;
@@ -1998,7 +2153,7 @@ ivi_layout_surface_create(struct weston_surface *wl_surface,
 	struct ivi_layout *layout = get_instance();
 	struct ivi_layout_surface *ivisurf = NULL;
 
-	ivisurf = get_surface(&layout->surface_list, id_surface);
+	ivisurf = ivi_layout_get_surface_from_id(id_surface);
 	if (ivisurf) {
 		weston_log("id_surface(%d) is already created\n", id_surface);
 		return NULL;
@@ -2026,6 +2181,13 @@ ivi_layout_init_with_compositor(struct weston_compositor *ec)
 	wl_list_init(&layout->screen_list);
 	wl_list_init(&layout->view_list);
 
+	wl_list_init(&layout->dirty_surface_list);
+	wl_list_init(&layout->dirty_layer_list);
+	wl_list_init(&layout->dirty_screen_list);
+
+	id_index_init(&layout->surface_index);
+	id_index_init(&layout->layer_index);
+
 	wl_signal_init(&layout->layer_notification.created);
 	wl_signal_init(&layout->layer_notification.removed);
 
@@ -112,6 +112,11 @@ ivi_shell_surface_committed(struct weston_surface *surface,
 	if (surface->width == 0 || surface->height == 0)
 		return;
 
+	/* A NULL attach unmapped the weston surface; let the next layout
+	 * commit put its views back. */
+	if (ivisurf->layout_surface && !weston_surface_is_mapped(surface))
+		ivi_layout_surface_mark_dirty(ivisurf->layout_surface);
+
 	if (ivisurf->width != surface->width ||
 	    ivisurf->height != surface->height) {
 		ivisurf->width  = surface->width;
@@ -467,6 +472,11 @@ desktop_surface_committed(struct weston_desktop_surface *surface,
 	if (weston_surf->width == 0 || weston_surf->height == 0)
 		return;
 
+	/* A NULL attach unmapped the weston surface; let the next layout
+	 * commit put its views back. */
+	if (ivisurf->layout_surface && !weston_surface_is_mapped(weston_surf))
+		ivi_layout_surface_mark_dirty(ivisurf->layout_surface);
+
 	if (ivisurf->width != weston_surf->width ||
 	    ivisurf->height != weston_surf->height) {
 		ivisurf->width  = weston_surf->width;
@@ -0,0 +1,395 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <wayland-util.h>
+
+#include "capture-pool.h"
+
+#define CAPTURE_POOL_BUCKETS 32
+
+struct capture_pool_entry {
+	struct capture_pool_key key;
+	void *object;
+
+	/* released objects are destroyed instead of going back to idle */
+	int stale;
+
+	/* pool::idle, most recently used first, or pool::in_use */
+	struct wl_list link;
+	/* pool::buckets while idle, empty otherwise */
+	struct wl_list bucket_link;
+};
+
+struct capture_pool_pending {
+	struct capture_pool_key key;
+	struct wl_list link;
+};
+
+struct capture_pool {
+	struct capture_pool_allocator allocator;
+	unsigned capacity;
+	unsigned spares;
+
+	unsigned num_idle;
+	struct wl_list idle;
+	struct wl_list in_use;
+	struct wl_list buckets[CAPTURE_POOL_BUCKETS];
+
+	/* keys that missed since the last refill */
+	struct wl_list pending;
+
+	struct capture_pool_stats stats;
+};
+
+static uint32_t
+capture_pool_key_hash(const struct capture_pool_key *key)
+{
+	const uint8_t *p = (const uint8_t *)key;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < sizeof(*key); i++) {
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+
+	return hash % CAPTURE_POOL_BUCKETS;
+}
+
+static int
+capture_pool_key_equal(const struct capture_pool_key *a,
+		       const struct capture_pool_key *b)
+{
+	return a->width == b->width && a->height == b->height &&
+	       a->format == b->format && a->stride == b->stride &&
+	       a->modifier == b->modifier && a->ident == b->ident;
+}
+
+static struct capture_pool_entry *
+capture_pool_entry_create(struct capture_pool *pool,
+			  const struct capture_pool_key *key, void *source)
+{
+	struct capture_pool_entry *entry;
+
+	entry = calloc(1, sizeof *entry);
+	if (!entry) {
+		pool->stats.failures++;
+		return NULL;
+	}
+
+	entry->object = pool->allocator.create(pool->allocator.data, key,
+					       source);
+	if (!entry->object) {
+		pool->stats.failures++;
+		free(entry);
+		return NULL;
+	}
+
+	entry->key = *key;
+	wl_list_init(&entry->bucket_link);
+	pool->stats.allocations++;
+
+	return entry;
+}
+
+static void
+capture_pool_entry_destroy(struct capture_pool *pool,
+			   struct capture_pool_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	wl_list_remove(&entry->bucket_link);
+	pool->allocator.destroy(pool->allocator.data, entry->object);
+	free(entry);
+}
+
+static void
+capture_pool_make_idle(struct capture_pool *pool,
+		       struct capture_pool_entry *entry)
+{
+	wl_list_insert(&pool->idle, &entry->link);
+	wl_list_insert(&pool->buckets[capture_pool_key_hash(&entry->key)],
+		       &entry->bucket_link);
+	pool->num_idle++;
+}
+
+static void
+capture_pool_evict_idle(struct capture_pool *pool,
+			struct capture_pool_entry *entry)
+{
+	pool->num_idle--;
+	pool->stats.evictions++;
+	capture_pool_entry_destroy(pool, entry);
+}
+
+struct capture_pool *
+capture_pool_create(const struct capture_pool_allocator *allocator,
+		    unsigned capacity, unsigned spares)
+{
+	struct capture_pool *pool;
+	int i;
+
+	if (!allocator->create || !allocator->destroy)
+		return NULL;
+
+	pool = calloc(1, sizeof *pool);
+	if (!pool)
+		return NULL;
+
+	pool->allocator = *allocator;
+	pool->capacity = capacity;
+	pool->spares = spares < capacity ? spares : capacity;
+
+	wl_list_init(&pool->idle);
+	wl_list_init(&pool->in_use);
+	for (i = 0; i < CAPTURE_POOL_BUCKETS; i++)
+		wl_list_init(&pool->buckets[i]);
+	wl_list_init(&pool->pending);
+
+	return pool;
+}
+
+/* Objects still in use are destroyed as well, the caller has to be done
+ * with them. */
+void
+capture_pool_destroy(struct capture_pool *pool)
+{
+	struct capture_pool_entry *entry, *tmp;
+	struct capture_pool_pending *pending, *ptmp;
+
+	if (!pool)
+		return;
+
+	wl_list_for_each_safe(entry, tmp, &pool->idle, link)
+		capture_pool_entry_destroy(pool, entry);
+	wl_list_for_each_safe(entry, tmp, &pool->in_use, link)
+		capture_pool_entry_destroy(pool, entry);
+	wl_list_for_each_safe(pending, ptmp, &pool->pending, link) {
+		wl_list_remove(&pending->link);
+		free(pending);
+	}
+
+	free(pool);
+}
+
+static void
+capture_pool_queue_refill(struct capture_pool *pool,
+			  const struct capture_pool_key *key)
+{
+	struct capture_pool_pending *pending;
+	int was_empty = wl_list_empty(&pool->pending);
+
+	wl_list_for_each(pending, &pool->pending, link) {
+		if (capture_pool_key_equal(&pending->key, key))
+			return;
+	}
+
+	pending = calloc(1, sizeof *pending);
+	if (!pending)
+		return;
+
+	pending->key = *key;
+	wl_list_insert(pool->pending.prev, &pending->link);
+
+	if (was_empty)
+		pool->allocator.schedule_refill(pool->allocator.data);
+}
+
+/*
+ * Returns an object for key, reusing an idle one if there is any. On a
+ * miss the object is created right away, since the caller needs it for
+ * the current frame, and spares for the key are queued to be created
+ * from capture_pool_refill() so that the next frames hit.
+ */
+void *
+capture_pool_acquire(struct capture_pool *pool,
+		     const struct capture_pool_key *key, void *source)
+{
+	struct wl_list *bucket = &pool->buckets[capture_pool_key_hash(key)];
+	struct capture_pool_entry *entry;
+
+	wl_list_for_each(entry, bucket, bucket_link) {
+		if (!capture_pool_key_equal(&entry->key, key))
+			continue;
+
+		wl_list_remove(&entry->bucket_link);
+		wl_list_init(&entry->bucket_link);
+		wl_list_remove(&entry->link);
+		wl_list_insert(&pool->in_use, &entry->link);
+		pool->num_idle--;
+		pool->stats.hits++;
+
+		return entry->object;
+	}
+
+	pool->stats.misses++;
+
+	entry = capture_pool_entry_create(pool, key, source);
+	if (!entry)
+		return NULL;
+
+	wl_list_insert(&pool->in_use, &entry->link);
+
+	if (pool->spares && pool->allocator.schedule_refill)
+		capture_pool_queue_refill(pool, key);
+
+	return entry->object;
+}
+
+void
+capture_pool_release(struct capture_pool *pool, void *object)
+{
+	struct capture_pool_entry *entry;
+
+	/* only frames in flight are in use, so this list stays short */
+	wl_list_for_each(entry, &pool->in_use, link) {
+		if (entry->object == object)
+			break;
+	}
+
+	if (&entry->link == &pool->in_use)
+		return;
+
+	wl_list_remove(&entry->link);
+	wl_list_init(&entry->link);
+
+	if (entry->stale) {
+		capture_pool_entry_destroy(pool, entry);
+		return;
+	}
+
+	capture_pool_make_idle(pool, entry);
+
+	while (pool->num_idle > pool->capacity) {
+		entry = wl_container_of(pool->idle.prev, entry, link);
+		capture_pool_evict_idle(pool, entry);
+	}
+}
+
+/* Drops everything made for key, e.g. once the buffer it was imported
+ * from is gone. Objects in use are destroyed when they are released. */
+void
+capture_pool_discard(struct capture_pool *pool,
+		     const struct capture_pool_key *key)
+{
+	struct capture_pool_entry *entry, *tmp;
+	struct capture_pool_pending *pending, *ptmp;
+
+	wl_list_for_each_safe(entry, tmp,
+			      &pool->buckets[capture_pool_key_hash(key)],
+			      bucket_link) {
+		if (capture_pool_key_equal(&entry->key, key))
+			capture_pool_evict_idle(pool, entry);
+	}
+
+	wl_list_for_each(entry, &pool->in_use, link) {
+		if (capture_pool_key_equal(&entry->key, key))
+			entry->stale = 1;
+	}
+
+	wl_list_for_each_safe(pending, ptmp, &pool->pending, link) {
+		if (capture_pool_key_equal(&pending->key, key)) {
+			wl_list_remove(&pending->link);
+			free(pending);
+		}
+	}
+}
+
+/*
+ * Tops up the idle objects of every key that missed since the last call,
+ * up to the number of spares and without exceeding the capacity.
+ */
+void
+capture_pool_refill(struct capture_pool *pool)
+{
+	struct capture_pool_pending *pending, *ptmp;
+	struct capture_pool_entry *entry;
+	unsigned idle;
+
+	wl_list_for_each_safe(pending, ptmp, &pool->pending, link) {
+		idle = 0;
+		wl_list_for_each(entry,
+				 &pool->buckets[capture_pool_key_hash(&pending->key)],
+				 bucket_link) {
+			if (capture_pool_key_equal(&entry->key, &pending->key))
+				idle++;
+		}
+
+		while (idle < pool->spares && pool->num_idle < pool->capacity) {
+			entry = capture_pool_entry_create(pool, &pending->key,
+							  NULL);
+			if (!entry)
+				break;
+
+			capture_pool_make_idle(pool, entry);
+			pool->stats.refills++;
+			idle++;
+		}
+
+		wl_list_remove(&pending->link);
+		free(pending);
+	}
+}
+
+void
+capture_pool_get_stats(const struct capture_pool *pool,
+		       struct capture_pool_stats *stats)
+{
+	*stats = pool->stats;
+}
+
+/*
+ * Copies height rows between two buffers that may be pitched differently.
+ * When the pitches match the plane is contiguous on both sides and goes
+ * out in a single copy.
+ */
+void
+capture_copy_plane(void *dst, size_t dst_pitch,
+		   const void *src, size_t src_pitch, int height)
+{
+	const char *s = src;
+	char *d = dst;
+	size_t row = dst_pitch < src_pitch ? dst_pitch : src_pitch;
+	int i;
+
+	if (height <= 0)
+		return;
+
+	if (dst_pitch == src_pitch) {
+		memcpy(dst, src, dst_pitch * height);
+		return;
+	}
+
+	for (i = 0; i < height; i++) {
+		memcpy(d, s, row);
+		s += src_pitch;
+		d += dst_pitch;
+	}
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _CAPTURE_POOL_H_
+#define _CAPTURE_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Keyed pool of reusable capture buffers with LRU eviction.
+ *
+ * The pool does not know what it stores; objects are made and destroyed
+ * by a capture_pool_allocator. The capture proxy uses it for VA surfaces
+ * that shm frames are copied into, and the backend for dmabufs it has
+ * imported into GBM, so neither has to be recreated on every frame.
+ *
+ * An acquired object is in use until it is released again, after which it
+ * is idle and may be handed out for the next acquire of the same key.
+ * Idle objects beyond the pool capacity are destroyed, least recently
+ * used first.
+ */
+struct capture_pool;
+
+struct capture_pool_key {
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t stride;
+	uint64_t modifier;
+	/* identity of an imported buffer, 0 for objects the pool allocates */
+	uint64_t ident;
+};
+
+struct capture_pool_allocator {
+	/* make an object for key, source is whatever was passed to
+	 * capture_pool_acquire() and NULL for refills */
+	void *(*create)(void *data, const struct capture_pool_key *key,
+			void *source);
+	void (*destroy)(void *data, void *object);
+
+	/* ask for capture_pool_refill() to be called soon, outside of the
+	 * frame that missed; may be NULL, then misses are not refilled */
+	void (*schedule_refill)(void *data);
+
+	void *data;
+};
+
+struct capture_pool_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t allocations;
+	uint64_t refills;
+	uint64_t evictions;
+	uint64_t failures;
+};
+
+struct capture_pool *
+capture_pool_create(const struct capture_pool_allocator *allocator,
+		    unsigned capacity, unsigned spares);
+void
+capture_pool_destroy(struct capture_pool *pool);
+void *
+capture_pool_acquire(struct capture_pool *pool,
+		     const struct capture_pool_key *key, void *source);
+void
+capture_pool_release(struct capture_pool *pool, void *object);
+void
+capture_pool_discard(struct capture_pool *pool,
+		     const struct capture_pool_key *key);
+void
+capture_pool_refill(struct capture_pool *pool);
+void
+capture_pool_get_stats(const struct capture_pool *pool,
+		       struct capture_pool_stats *stats);
+
+void
+capture_copy_plane(void *dst, size_t dst_pitch,
+		   const void *src, size_t src_pitch, int height);
+
+#endif /* _CAPTURE_POOL_H_ */
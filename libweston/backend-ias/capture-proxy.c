@@ -27,6 +27,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
@@ -46,6 +47,7 @@
 
 #include <libweston/libweston.h>
 #include "capture-proxy.h"
+#include "capture-pool.h"
 #include "ias-shell-server-protocol.h"
 #include "../shared/timespec-util.h"
 
@@ -53,6 +55,21 @@
  * outstanding frames. */
 #define MAX_FRAMES_IN_FLIGHT 3
 
+/* A miss makes spares for every frame the client can hold on to, and a
+ * resize can briefly keep the old size around as well. */
+#define SURFACE_POOL_SPARES (MAX_FRAMES_IN_FLIGHT + 1)
+#define SURFACE_POOL_CAPACITY (2 * SURFACE_POOL_SPARES)
+
+/* VA surface shm frames are copied into, with its derived image kept
+ * mapped-ready for the next frame. */
+struct capture_va_surface {
+	VASurfaceID surface;
+	VAImage image;
+
+	/* capture_proxy::in_flight while the client holds it */
+	struct wl_list link;
+};
+
 struct capture_proxy {
 	int drm_fd;
 	int profile_capture;
@@ -67,6 +84,11 @@ struct capture_proxy {
 
 	VADisplay va_dpy;
 
+	struct capture_pool *surface_pool;
+	struct wl_event_loop *loop;
+	struct wl_event_source *refill_source;
+	struct wl_list in_flight;
+
 	/* Resource for client that asked us to start capturing, to which
 	 * we will send buffer handles. */
 	struct wl_resource *resource;
@@ -88,12 +110,86 @@ handle_resource_destroyed(struct wl_listener *listener, void *data)
 }
 
 
+static void *
+capture_va_surface_create(void *data, const struct capture_pool_key *key,
+		void *source)
+{
+	struct capture_proxy *cp = data;
+	struct capture_va_surface *vs;
+	VAStatus status;
+
+	vs = zalloc(sizeof(*vs));
+	if (vs == NULL) {
+		return NULL;
+	}
+
+	status = vaCreateSurfaces(cp->va_dpy, key->format,
+			key->width, key->height,
+			&vs->surface, 1, NULL, 0);
+	if (status != VA_STATUS_SUCCESS) {
+		weston_log("[capture proxy]: Failed to create shm source surface.\n");
+		free(vs);
+		return NULL;
+	}
+
+	status = vaDeriveImage(cp->va_dpy, vs->surface, &vs->image);
+	if (status != VA_STATUS_SUCCESS) {
+		weston_log("[capture proxy]: Failed to get shm source image.\n");
+		vaDestroySurfaces(cp->va_dpy, &vs->surface, 1);
+		free(vs);
+		return NULL;
+	}
+
+	wl_list_init(&vs->link);
+
+	return vs;
+}
+
+static void
+capture_va_surface_destroy(void *data, void *object)
+{
+	struct capture_proxy *cp = data;
+	struct capture_va_surface *vs = object;
+
+	wl_list_remove(&vs->link);
+	vaDestroyImage(cp->va_dpy, vs->image.image_id);
+	vaDestroySurfaces(cp->va_dpy, &vs->surface, 1);
+	free(vs);
+}
+
+static void
+capture_proxy_refill(void *data)
+{
+	struct capture_proxy *cp = data;
+
+	cp->refill_source = NULL;
+	capture_pool_refill(cp->surface_pool);
+}
+
+/* Spare surfaces are made from an idle callback, after the frame that
+ * missed has gone out to the client. */
+static void
+capture_proxy_schedule_refill(void *data)
+{
+	struct capture_proxy *cp = data;
+
+	if (cp->refill_source == NULL) {
+		cp->refill_source = wl_event_loop_add_idle(cp->loop,
+				capture_proxy_refill, cp);
+	}
+}
+
 struct capture_proxy *
 capture_proxy_create(const int drm_fd, struct wl_client *client)
 {
 	struct capture_proxy *cp;
 	VAStatus status;
 	int major, minor;
+	struct capture_pool_allocator allocator = {
+		.create = capture_va_surface_create,
+		.destroy = capture_va_surface_destroy,
+		.schedule_refill = capture_proxy_schedule_refill,
+	};
 
 	cp = zalloc(sizeof(*cp));
 	if (cp == NULL) {
@@ -117,6 +213,17 @@ capture_proxy_create(const int drm_fd, struct wl_client *client)
 		return NULL;
 	}
 
+	allocator.data = cp;
+	cp->surface_pool = capture_pool_create(&allocator,
+			SURFACE_POOL_CAPACITY, SURFACE_POOL_SPARES);
+	if (!cp->surface_pool) {
+		weston_log("[capture proxy]: Failed to create surface pool.\n");
+		vaTerminate(cp->va_dpy);
+		free(cp);
+		return NULL;
+	}
+	cp->loop = wl_display_get_event_loop(wl_client_get_display(client));
+	wl_list_init(&cp->in_flight);
 
 	wl_list_init(&cp->resource_listener.link);
 	cp->resource_listener.notify = handle_resource_destroyed;
@@ -138,12 +245,25 @@ capture_proxy_set_size(struct capture_proxy *cp, int width, int height)
 void
 capture_proxy_destroy(struct capture_proxy *cp)
 {
+	struct capture_pool_stats stats;
+
 	wl_list_remove(&cp->resource_listener.link);
 	close(cp->drm_fd);
 
 	if (cp->resource) {
 		wl_resource_destroy(cp->resource);
 	}
+
+	if (cp->refill_source) {
+		wl_event_source_remove(cp->refill_source);
+	}
+	capture_pool_get_stats(cp->surface_pool, &stats);
+	weston_log("[capture proxy]: Surface pool: %" PRIu64 " hits, %" PRIu64
+			" misses, %" PRIu64 " allocations, %" PRIu64 " evictions.\n",
+			stats.hits, stats.misses, stats.allocations,
+			stats.evictions);
+	capture_pool_destroy(cp->surface_pool);
+
 	vaTerminate(cp->va_dpy);
 	free(cp);
 	weston_log("[capture proxy]: Capture proxy destroyed.\n");
@@ -170,11 +290,11 @@ capture_proxy_shm_frame(struct capture_proxy * const cp,
 		struct wl_shm_buffer * const shm_buffer, int stride,
 		enum capture_proxy_format format, uint32_t timestamp)
 {
-	VASurfaceID src_surface;
+	struct capture_va_surface *vs;
+	struct capture_pool_key key;
 	VAStatus status;
 	void *surface_p = NULL;
 	void *shm_buffer_data = NULL;
-	VAImage rgb_image;
 	VABufferInfo buf_info;
 	uint32_t shm_format;
 
@@ -193,70 +313,50 @@ capture_proxy_shm_frame(struct capture_proxy * const cp,
 		goto error_data_pointer;
 	}
 
-	status = vaCreateSurfaces(cp->va_dpy, VA_RT_FORMAT_RGB32,
-			wl_shm_buffer_get_width(shm_buffer),
-			wl_shm_buffer_get_height(shm_buffer),
-			&src_surface, 1, NULL, 0);
-	if (status != VA_STATUS_SUCCESS) {
-		weston_log("[capture proxy]: Failed to create shm source surface.\n");
-		goto error_data_pointer;
-	}
+	memset(&key, 0, sizeof(key));
+	key.width = wl_shm_buffer_get_width(shm_buffer);
+	key.height = wl_shm_buffer_get_height(shm_buffer);
+	key.format = VA_RT_FORMAT_RGB32;
 
-	status = vaDeriveImage(cp->va_dpy, src_surface, &rgb_image);
-	if (status != VA_STATUS_SUCCESS) {
-		weston_log("[capture proxy]: Failed to get shm source image.\n");
-		goto error_source_image;
+	vs = capture_pool_acquire(cp->surface_pool, &key, NULL);
+	if (vs == NULL) {
+		goto error_data_pointer;
 	}
 
-	status = vaMapBuffer(cp->va_dpy, rgb_image.buf, &surface_p);
+	status = vaMapBuffer(cp->va_dpy, vs->image.buf, &surface_p);
 	if (status != VA_STATUS_SUCCESS) {
 		weston_log("[capture proxy]: Failed to map shm source image.\n");
 		goto error_map_image;
 	}
 
 	/* Shared memory buffer and the VAImage may not have the same stride. */
-	if (rgb_image.pitches[0] == (uint32_t)wl_shm_buffer_get_stride(shm_buffer)) {
-		memcpy(surface_p, shm_buffer_data,
-			wl_shm_buffer_get_height(shm_buffer) * wl_shm_buffer_get_stride(shm_buffer));
-	} else {
-		int i;
-		const char *src = (char *)shm_buffer_data;
-		char *dst = (char *)surface_p;
-		int32_t stride = wl_shm_buffer_get_stride(shm_buffer);
-		int32_t height = wl_shm_buffer_get_height(shm_buffer);
-		size_t count = (size_t)stride <
-			(size_t)(rgb_image.pitches[0]) ?
-			(size_t)stride :
-			(size_t)(rgb_image.pitches[0]);
-
-		for (i = 0; i < height; i++) {
-			memcpy(dst, src, count);
-			src += stride;
-			dst += rgb_image.pitches[0];
-		}
-	}
+	capture_copy_plane(surface_p, vs->image.pitches[0], shm_buffer_data,
+			wl_shm_buffer_get_stride(shm_buffer),
+			wl_shm_buffer_get_height(shm_buffer));
 
-	status = vaUnmapBuffer(cp->va_dpy, rgb_image.buf);
+	status = vaUnmapBuffer(cp->va_dpy, vs->image.buf);
 	if (status != VA_STATUS_SUCCESS) {
 		weston_log("[capture proxy]: Failed to unmap image.\n");
 	}
 
 	memset(&buf_info, 0, sizeof(buf_info));
 	buf_info.mem_type = VA_SURFACE_ATTRIB_MEM_TYPE_KERNEL_DRM;
-	status = vaAcquireBufferHandle(cp->va_dpy, rgb_image.buf, &buf_info);
+	status = vaAcquireBufferHandle(cp->va_dpy, vs->image.buf, &buf_info);
 	wl_shm_buffer_end_access(shm_buffer);
 
+	/* The surface stays out of the pool until the client hands it back
+	 * through capture_proxy_release_buffer(). */
+	wl_list_insert(&cp->in_flight, &vs->link);
+
 	ias_hmi_send_raw_buffer_handle(cp->resource, buf_info.handle, timestamp,
-		cp->frame_count, rgb_image.pitches[0], 0, 0, 0,
-		cp->width, cp->height, src_surface, rgb_image.buf,
-		rgb_image.image_id);
+		cp->frame_count, vs->image.pitches[0], 0, 0, 0,
+		cp->width, cp->height, vs->surface, vs->image.buf,
+		vs->image.image_id);
 
 	return 0;
 
 error_map_image:
-	vaDestroyImage(cp->va_dpy, rgb_image.image_id);
-error_source_image:
-	vaDestroySurfaces(cp->va_dpy, &src_surface, 1);
+	capture_pool_release(cp->surface_pool, vs);
 error_data_pointer:
 	wl_shm_buffer_end_access(shm_buffer);
 	return -1;
@@ -310,6 +410,7 @@ capture_proxy_release_buffer(struct capture_proxy *cp, uint32_t surfid,
 			VABufferID buf_id = bufid;
 			VASurfaceID surface_id = surfid;
 			VAImageID image_id = imageid;
+			struct capture_va_surface *vs;
 
 			status = vaReleaseBufferHandle(cp->va_dpy, buf_id);
 			if (status != VA_STATUS_SUCCESS) {
@@ -317,6 +418,18 @@ capture_proxy_release_buffer(struct capture_proxy *cp, uint32_t surfid,
 						bufid);
 			}
 
+			/* Hand pooled surfaces back for the next frame. */
+			wl_list_for_each(vs, &cp->in_flight, link) {
+				if (vs->surface == surface_id &&
+						vs->image.image_id == image_id) {
+					wl_list_remove(&vs->link);
+					wl_list_init(&vs->link);
+					capture_pool_release(cp->surface_pool, vs);
+					cp->num_frames_in_flight--;
+					return 0;
+				}
+			}
+
 			status = vaDestroyImage(cp->va_dpy, image_id);
 			if (status != VA_STATUS_SUCCESS) {
 				weston_log("[capture proxy]: Failed to destroy image.\n");
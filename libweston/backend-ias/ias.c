@@ -61,6 +61,7 @@
 #include "trace-reporter.h"
 #include <EGL/egl.h>
 #include <dlfcn.h>
+#include <inttypes.h>
 #include <time.h>
 #include "linux-dmabuf.h"
 
@@ -76,6 +77,7 @@
 
 #ifdef BUILD_REMOTE_DISPLAY
 #include "capture-proxy.h"
+#include "capture-pool.h"
 #include "../shared/timespec-util.h"
 #include "ias-shell-server-protocol.h"
 #endif
@@ -3602,6 +3604,19 @@ capture_proxy_destroy_from_surface(struct ias_backend *ias_backend, struct westo
 				capture_item->cp = NULL;
 			}
 
+			if (capture_item->import_pool) {
+				struct capture_pool_stats stats;
+
+				capture_pool_get_stats(capture_item->import_pool,
+						&stats);
+				weston_log("[WESTON] Import pool: %" PRIu64 " hits, %" PRIu64
+						" misses, %" PRIu64 " evictions.\n",
+						stats.hits, stats.misses,
+						stats.evictions);
+				capture_pool_destroy(capture_item->import_pool);
+				capture_item->import_pool = NULL;
+			}
+
 			weston_log("[WESTON] Removing callbacks...\n");
 			wl_list_remove(&capture_item->capture_commit_listener.link);
 			wl_list_remove(&capture_item->capture_vsync_listener.link);
@@ -3698,6 +3713,134 @@ ias_capture_fb_get_from_bo(struct gbm_bo *bo, struct weston_buffer *buffer,
  * needed. RFC6184 says that "A 90 kHz clock rate MUST be used." */
 #define PIPELINE_CLOCK 90000
 
+/* Client buffers are imported into GBM once and kept, together with their
+ * kms fb, for as long as the client keeps attaching them. */
+#define CAPTURE_IMPORT_POOL_CAPACITY 8
+
+struct capture_import {
+	struct gbm_bo *bo;
+	struct ias_fb *fb;
+
+	struct capture_pool *pool;
+	struct capture_pool_key key;
+	struct wl_listener buffer_destroy_listener;
+};
+
+static void
+capture_import_buffer_destroyed(struct wl_listener *listener, void *data)
+{
+	struct capture_import *import =
+		container_of(listener, struct capture_import,
+				buffer_destroy_listener);
+	/* Discarding frees import, so the key has to be copied out first. */
+	struct capture_pool_key key = import->key;
+
+	capture_pool_discard(import->pool, &key);
+}
+
+static void *
+capture_import_create(void *data, const struct capture_pool_key *key,
+		void *source)
+{
+	struct ias_surface_capture *capture = data;
+	struct ias_backend *c = capture->backend;
+	struct weston_buffer *buffer = source;
+	struct linux_dmabuf_buffer *dmabuf;
+	struct capture_import *import;
+
+	/* Imports are only ever made for a frame, never refilled. */
+	if (!buffer) {
+		return NULL;
+	}
+
+	import = calloc(1, sizeof(*import));
+	if (!import) {
+		return NULL;
+	}
+
+	if ((dmabuf = linux_dmabuf_buffer_get(buffer->resource))) {
+		struct gbm_import_fd_data gbm_dmabuf = {
+			.fd = dmabuf->attributes.fd[0],
+			.width = dmabuf->attributes.width,
+			.height = dmabuf->attributes.height,
+			.stride = dmabuf->attributes.stride[0],
+			.format = dmabuf->attributes.format
+		};
+
+		import->bo = gbm_bo_import(c->gbm, GBM_BO_IMPORT_FD,
+				&gbm_dmabuf, GBM_BO_USE_SCANOUT);
+	} else {
+		import->bo = gbm_bo_import(c->gbm, GBM_BO_IMPORT_WL_BUFFER,
+				buffer->resource, GBM_BO_USE_SCANOUT);
+	}
+
+	if (!import->bo) {
+		weston_log("[capture proxy]: Failed to import bo for wl_resource at %p - giving up.\n",
+				buffer->resource);
+		free(import);
+		return NULL;
+	}
+
+	import->fb = ias_capture_fb_get_from_bo(import->bo, buffer, c);
+	if (!import->fb) {
+		weston_log("[capture proxy]: Failed to get fb from bo.\n");
+		gbm_bo_destroy(import->bo);
+		free(import);
+		return NULL;
+	}
+
+	import->pool = capture->import_pool;
+	import->key = *key;
+	import->buffer_destroy_listener.notify = capture_import_buffer_destroyed;
+	wl_signal_add(&buffer->destroy_signal, &import->buffer_destroy_listener);
+
+	return import;
+}
+
+static void
+capture_import_destroy(void *data, void *object)
+{
+	struct capture_import *import = object;
+
+	wl_list_remove(&import->buffer_destroy_listener.link);
+	/* The fb goes with the bo, see ias_fb_destroy_callback(). */
+	gbm_bo_destroy(import->bo);
+	free(import);
+}
+
+static struct capture_pool *
+capture_import_pool_create(struct ias_surface_capture *capture)
+{
+	struct capture_pool_allocator allocator = {
+		.create = capture_import_create,
+		.destroy = capture_import_destroy,
+		.data = capture,
+	};
+
+	return capture_pool_create(&allocator, CAPTURE_IMPORT_POOL_CAPACITY, 0);
+}
+
+/* Imports are per wl_buffer; the layout is part of the key as well so an
+ * entry can never be matched by a buffer that differs from the import. */
+static void
+capture_import_key(struct weston_buffer *buffer, struct capture_pool_key *key)
+{
+	struct linux_dmabuf_buffer *dmabuf;
+
+	memset(key, 0, sizeof(*key));
+	key->ident = (uintptr_t)buffer;
+	key->width = buffer->width;
+	key->height = buffer->height;
+
+	if ((dmabuf = linux_dmabuf_buffer_get(buffer->resource))) {
+		key->width = dmabuf->attributes.width;
+		key->height = dmabuf->attributes.height;
+		key->format = dmabuf->attributes.format;
+		key->stride = dmabuf->attributes.stride[0];
+		key->modifier = dmabuf->attributes.modifier[0];
+	}
+}
+
 /* Callback that is called when a frame has been composited
  * and is ready to be displayed on the relevant output. */
 static void
@@ -3782,8 +3925,8 @@ capture_commit_notify(struct wl_listener *listener, void *data)
 	uint32_t format;
 	struct weston_surface *surface = (struct weston_surface *)data;
 	struct weston_buffer *buffer;
-	struct linux_dmabuf_buffer *dmabuf;
-	struct gbm_bo *bo;
+	struct capture_import *import;
+	struct capture_pool_key key;
 	struct wl_shm_buffer *shm_buffer;
 	struct ias_surface_capture *capture_item = NULL;
 	struct ias_surface_capture *capture_tmp = NULL;
@@ -3878,35 +4021,14 @@ capture_commit_notify(struct wl_listener *listener, void *data)
 				start, finish, duration);
 #endif
 		return;
-	} else {
-		if ((dmabuf = linux_dmabuf_buffer_get(buffer->resource))) {
-			struct gbm_import_fd_data gbm_dmabuf = {
-				.fd = dmabuf->attributes.fd[0],
-				.width = dmabuf->attributes.width,
-				.height = dmabuf->attributes.height,
-				.stride = dmabuf->attributes.stride[0],
-				.format = dmabuf->attributes.format
-			};
-
-			bo = gbm_bo_import(c->gbm, GBM_BO_IMPORT_FD,
-					   &gbm_dmabuf, GBM_BO_USE_SCANOUT);
-		} else {
-			bo = gbm_bo_import(c->gbm, GBM_BO_IMPORT_WL_BUFFER,
-					   buffer->resource, GBM_BO_USE_SCANOUT);
-		}
-
-		if (!bo) {
-			weston_log("[capture proxy]: Failed to import bo for wl_resource at %p - giving up.\n",
-					buffer->resource);
-			return;
-		}
 	}
 
-	fb = ias_capture_fb_get_from_bo(bo, buffer, c);
-	if (!fb) {
-		weston_log("[capture proxy]: Failed to get fb from bo.\n");
-		goto err_commit;
+	capture_import_key(buffer, &key);
+	import = capture_pool_acquire(capture->import_pool, &key, buffer);
+	if (!import) {
+		return;
 	}
+	fb = import->fb;
 
 	handle = gbm_bo_get_handle(fb->bo).u32;
 
@@ -3917,7 +4039,7 @@ capture_commit_notify(struct wl_listener *listener, void *data)
 		goto err_commit;
 	}
 
-	format = gbm_bo_get_format(bo);
+	format = gbm_bo_get_format(fb->bo);
 	if (format == GBM_FORMAT_XRGB8888 || format == GBM_FORMAT_ARGB8888) {
 		ret = capture_proxy_handle_frame(capture->cp, NULL, fd,
 				gbm_bo_get_stride(fb->bo), CP_FORMAT_RGB, timestamp);
@@ -3935,10 +4057,9 @@ capture_commit_notify(struct wl_listener *listener, void *data)
 err_commit:
 	/* We've asked for the buffer to be kept alive long enough for us to
 	 * encode it, so dereference it now that we're done with it. Note that
-	 * the client keeps an open fd to the data until it is done. */
-	if (fb != NULL) {
-		gbm_bo_destroy(fb->bo);
-	}
+	 * the client keeps an open fd to the data until it is done. The import
+	 * stays in the pool for the next commit of the same buffer. */
+	capture_pool_release(capture->import_pool, import);
 	weston_buffer_reference(&capture->capture_surface->buffer_ref, NULL);
 
 	if (abort) {
@@ -4048,6 +4169,15 @@ start_capture(struct wl_client *client,
 			return IAS_HMI_FCAP_ERROR_NO_CAPTURE_PROXY;
 		}
 
+		capture_proxy_item->import_pool =
+			capture_import_pool_create(capture_proxy_item);
+		if (!capture_proxy_item->import_pool) {
+			weston_log("Failed to create capture import pool.\n");
+			capture_proxy_destroy(capture_proxy_item->cp);
+			free(capture_proxy_item);
+			return IAS_HMI_FCAP_ERROR_NO_CAPTURE_PROXY;
+		}
+
 		capture_proxy_item->capture_commit_listener.notify =
 			capture_commit_notify;
 		wl_signal_add(&surface->commit_signal,
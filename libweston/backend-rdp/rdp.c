@@ -26,10 +26,14 @@
 #include "config.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include <linux/input.h>
 
 #if HAVE_FREERDP_VERSION_H
@@ -157,6 +161,58 @@ struct rdp_output {
 	pixman_image_t *shadow_surface;
 
 	struct wl_list peers;
+	uint32_t dispatch_seq;
+};
+
+enum rdp_encoder_codec {
+	RDP_ENCODER_RAW,
+	RDP_ENCODER_NSC,
+	RDP_ENCODER_RFX,
+};
+
+/* One frame worth of damage, encoded by the peer's worker thread. */
+struct rdp_encoder_job {
+	enum rdp_encoder_codec codec;
+	UINT32 multifrag_max_request_size;
+	pixman_region32_t damage;
+
+	/* results, bitmap data points into the peer's encode_stream or
+	 * into raw_data */
+	SURFACE_BITS_COMMAND *cmds;
+	int n_cmds;
+	int cmds_size;
+	BYTE *raw_data;
+	size_t raw_size;
+};
+
+struct rdp_encoder {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/* protected by mutex */
+	bool job_queued;
+	bool job_done;
+	bool quit;
+
+	/* signalled by the worker when a job is done */
+	int done_fd;
+	struct wl_event_source *done_source;
+	bool running;
+
+	/* Only touched by the compositor thread, except for snapshot and
+	 * job which belong to the worker while job_queued is set. */
+	pixman_image_t *snapshot;
+	struct rdp_encoder_job job;
+	pixman_region32_t pending;
+	bool busy;
+	uint32_t dispatch_seq;
+	uint32_t frame_id;
+
+	/* Peers sharing the same codec and damage reuse the bitstream of a
+	 * leader instead of encoding it again. */
+	struct wl_list followers;
+	struct wl_list follower_link;
+	struct rdp_peer_context *leader;
 };
 
 struct rdp_peer_context {
@@ -168,6 +224,7 @@ struct rdp_peer_context {
 	wStream *encode_stream;
 	RFX_RECT *rfx_rects;
 	NSC_CONTEXT *nsc_context;
+	struct rdp_encoder encoder;
 
 	struct rdp_peers_item item;
 };
@@ -191,16 +248,35 @@ to_rdp_backend(struct weston_compositor *base)
 	return container_of(base->backend, struct rdp_backend, base);
 }
 
+static bool
+rdp_encoder_job_push(struct rdp_encoder_job *job, const SURFACE_BITS_COMMAND *cmd)
+{
+	SURFACE_BITS_COMMAND *cmds;
+	int size;
+
+	if (job->n_cmds == job->cmds_size) {
+		size = job->cmds_size ? job->cmds_size * 2 : 8;
+		cmds = realloc(job->cmds, size * sizeof *cmds);
+		if (!cmds)
+			return false;
+		job->cmds = cmds;
+		job->cmds_size = size;
+	}
+
+	job->cmds[job->n_cmds++] = *cmd;
+	return true;
+}
+
 static void
-rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+rdp_encoder_encode_rfx(RdpPeerContext *context, struct rdp_encoder_job *job)
 {
+	pixman_region32_t *damage = &job->damage;
+	pixman_image_t *image = context->encoder.snapshot;
 	int width, height, nrects, i;
 	pixman_box32_t *region, *rects;
 	uint32_t *ptr;
 	RFX_RECT *rfxRect;
-	rdpUpdate *update = peer->update;
 	SURFACE_BITS_COMMAND cmd;
-	RdpPeerContext *context = (RdpPeerContext *)peer->context;
 
 	Stream_Clear(context->encode_stream);
 	Stream_SetPosition(context->encode_stream, 0);
@@ -208,17 +284,15 @@ rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	width = (damage->extents.x2 - damage->extents.x1);
 	height = (damage->extents.y2 - damage->extents.y1);
 
+	memset(&cmd, 0, sizeof(cmd));
 #ifdef HAVE_SKIP_COMPRESSION
 	cmd.skipCompression = TRUE;
-#else
-	memset(&cmd, 0, sizeof(*cmd));
 #endif
 	cmd.destLeft = damage->extents.x1;
 	cmd.destTop = damage->extents.y1;
 	cmd.destRight = damage->extents.x2;
 	cmd.destBottom = damage->extents.y2;
 	SURFACE_BPP(cmd) = 32;
-	SURFACE_CODECID(cmd) = peer->settings->RemoteFxCodecId;
 	SURFACE_WIDTH(cmd) = width;
 	SURFACE_HEIGHT(cmd) = height;
 
@@ -246,18 +320,18 @@ rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	SURFACE_BITMAP_DATA_LEN(cmd) = Stream_GetPosition(context->encode_stream);
 	SURFACE_BITMAP_DATA(cmd) = Stream_Buffer(context->encode_stream);
 
-	update->SurfaceBits(update->context, &cmd);
+	rdp_encoder_job_push(job, &cmd);
 }
 
 
 static void
-rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+rdp_encoder_encode_nsc(RdpPeerContext *context, struct rdp_encoder_job *job)
 {
+	pixman_region32_t *damage = &job->damage;
+	pixman_image_t *image = context->encoder.snapshot;
 	int width, height;
 	uint32_t *ptr;
-	rdpUpdate *update = peer->update;
 	SURFACE_BITS_COMMAND cmd;
-	RdpPeerContext *context = (RdpPeerContext *)peer->context;
 
 	Stream_Clear(context->encode_stream);
 	Stream_SetPosition(context->encode_stream, 0);
@@ -265,10 +339,9 @@ rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	width = (damage->extents.x2 - damage->extents.x1);
 	height = (damage->extents.y2 - damage->extents.y1);
 
+	memset(&cmd, 0, sizeof(cmd));
 #ifdef HAVE_SKIP_COMPRESSION
 	cmd.skipCompression = TRUE;
-#else
-	memset(cmd, 0, sizeof(*cmd));
 #endif
 
 	cmd.destLeft = damage->extents.x1;
@@ -276,7 +349,6 @@ rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	cmd.destRight = damage->extents.x2;
 	cmd.destBottom = damage->extents.y2;
 	SURFACE_BPP(cmd) = 32;
-	SURFACE_CODECID(cmd) = peer->settings->NSCodecId;
 	SURFACE_WIDTH(cmd) = width;
 	SURFACE_HEIGHT(cmd) = height;
 
@@ -290,7 +362,7 @@ rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	SURFACE_BITMAP_DATA_LEN(cmd) = Stream_GetPosition(context->encode_stream);
 	SURFACE_BITMAP_DATA(cmd) = Stream_Buffer(context->encode_stream);
 
-	update->SurfaceBits(update->context, &cmd);
+	rdp_encoder_job_push(job, &cmd);
 }
 
 static void
@@ -308,34 +380,40 @@ pixman_image_flipped_subrect(const pixman_box32_t *rect, pixman_image_t *img, BY
 }
 
 static void
-rdp_peer_refresh_raw(pixman_region32_t *region, pixman_image_t *image, freerdp_peer *peer)
+rdp_encoder_encode_raw(RdpPeerContext *context, struct rdp_encoder_job *job)
 {
-	rdpUpdate *update = peer->update;
+	pixman_image_t *image = context->encoder.snapshot;
 	SURFACE_BITS_COMMAND cmd;
-	SURFACE_FRAME_MARKER marker;
-	pixman_box32_t *rect, subrect;
+	pixman_box32_t *rects, *rect, subrect;
 	int nrects, i;
 	int heightIncrement, remainingHeight, top;
-
-	rect = pixman_region32_rectangles(region, &nrects);
-	if (!nrects)
-		return;
-
-	marker.frameId++;
-	marker.frameAction = SURFACECMD_FRAMEACTION_BEGIN;
-	update->SurfaceFrameMarker(peer->context, &marker);
+	size_t size = 0, offset = 0;
+	BYTE *data;
+
+	rects = pixman_region32_rectangles(&job->damage, &nrects);
+	for (i = 0; i < nrects; i++)
+		size += (size_t)(rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1) * 4;
+
+	/* all strips of the frame go back to back into one buffer, so the
+	 * commands stay valid until the next job */
+	if (size > job->raw_size) {
+		data = realloc(job->raw_data, size);
+		if (!data)
+			return;
+		job->raw_data = data;
+		job->raw_size = size;
+	}
 
 	memset(&cmd, 0, sizeof(cmd));
 	SURFACE_BPP(cmd) = 32;
-	SURFACE_CODECID(cmd) = 0;
 
-	for (i = 0; i < nrects; i++, rect++) {
-		/*weston_log("rect(%d,%d, %d,%d)\n", rect->x1, rect->y1, rect->x2, rect->y2);*/
+	for (i = 0, rect = rects; i < nrects; i++, rect++) {
 		cmd.destLeft = rect->x1;
 		cmd.destRight = rect->x2;
 		SURFACE_WIDTH(cmd) = rect->x2 - rect->x1;
 
-		heightIncrement = peer->settings->MultifragMaxRequestSize / (16 + SURFACE_WIDTH(cmd) * 4);
+		heightIncrement = job->multifrag_max_request_size / (16 + SURFACE_WIDTH(cmd) * 4);
 		remainingHeight = rect->y2 - rect->y1;
 		top = rect->y1;
 
@@ -347,39 +425,423 @@ rdp_peer_refresh_raw(pixman_region32_t *region, pixman_image_t *image, freerdp_p
 			   cmd.destTop = top;
 			   cmd.destBottom = top + SURFACE_HEIGHT(cmd);
 			   SURFACE_BITMAP_DATA_LEN(cmd) = SURFACE_WIDTH(cmd) * SURFACE_HEIGHT(cmd) * 4;
-			   SURFACE_BITMAP_DATA(cmd) = (BYTE *)realloc(SURFACE_BITMAP_DATA(cmd), SURFACE_BITMAP_DATA_LEN(cmd));
+			   SURFACE_BITMAP_DATA(cmd) = job->raw_data + offset;
 
 			   subrect.y1 = top;
 			   subrect.y2 = top + SURFACE_HEIGHT(cmd);
 			   pixman_image_flipped_subrect(&subrect, image, SURFACE_BITMAP_DATA(cmd));
 
-			   /*weston_log("*  sending (%d,%d, %d,%d)\n", subrect.x1, subrect.y1, subrect.x2, subrect.y2); */
-			   update->SurfaceBits(peer->context, &cmd);
+			   if (!rdp_encoder_job_push(job, &cmd))
+				   return;
 
+			   offset += SURFACE_BITMAP_DATA_LEN(cmd);
 			   remainingHeight -= SURFACE_HEIGHT(cmd);
 			   top += SURFACE_HEIGHT(cmd);
 		}
 	}
+}
+
+static void *
+rdp_encoder_thread(void *data)
+{
+	RdpPeerContext *context = data;
+	struct rdp_encoder *encoder = &context->encoder;
+	struct rdp_encoder_job *job = &encoder->job;
+	uint64_t one = 1;
+	ssize_t ret;
+
+	pthread_mutex_lock(&encoder->mutex);
+	for (;;) {
+		while (!encoder->job_queued && !encoder->quit)
+			pthread_cond_wait(&encoder->cond, &encoder->mutex);
+		if (encoder->quit)
+			break;
+		pthread_mutex_unlock(&encoder->mutex);
+
+		job->n_cmds = 0;
+		switch (job->codec) {
+		case RDP_ENCODER_RFX:
+			rdp_encoder_encode_rfx(context, job);
+			break;
+		case RDP_ENCODER_NSC:
+			rdp_encoder_encode_nsc(context, job);
+			break;
+		case RDP_ENCODER_RAW:
+			rdp_encoder_encode_raw(context, job);
+			break;
+		}
+
+		pthread_mutex_lock(&encoder->mutex);
+		encoder->job_queued = false;
+		encoder->job_done = true;
+		pthread_cond_broadcast(&encoder->cond);
+
+		/* eventfd writes only fail once the counter is saturated,
+		 * in which case the compositor has a wakeup pending anyway */
+		ret = write(encoder->done_fd, &one, sizeof(one));
+		(void)ret;
+	}
+	pthread_mutex_unlock(&encoder->mutex);
+
+	return NULL;
+}
+
+static enum rdp_encoder_codec
+rdp_peer_codec(freerdp_peer *peer)
+{
+	if (peer->settings->RemoteFxCodec)
+		return RDP_ENCODER_RFX;
+	else if (peer->settings->NSCodec)
+		return RDP_ENCODER_NSC;
+	else
+		return RDP_ENCODER_RAW;
+}
+
+static void
+rdp_encoder_send(RdpPeerContext *context, struct rdp_encoder_job *job)
+{
+	freerdp_peer *peer = context->item.peer;
+	rdpUpdate *update = peer->update;
+	SURFACE_FRAME_MARKER marker;
+	SURFACE_BITS_COMMAND cmd;
+	UINT32 codec_id;
+	int i;
+
+	if (!job->n_cmds)
+		return;
+
+	switch (job->codec) {
+	case RDP_ENCODER_RFX:
+		codec_id = peer->settings->RemoteFxCodecId;
+		break;
+	case RDP_ENCODER_NSC:
+		codec_id = peer->settings->NSCodecId;
+		break;
+	default:
+		codec_id = 0;
+		break;
+	}
+
+	if (job->codec == RDP_ENCODER_RAW) {
+		marker.frameId = ++context->encoder.frame_id;
+		marker.frameAction = SURFACECMD_FRAMEACTION_BEGIN;
+		update->SurfaceFrameMarker(update->context, &marker);
+	}
 
-	free(SURFACE_BITMAP_DATA(cmd));
+	for (i = 0; i < job->n_cmds; i++) {
+		cmd = job->cmds[i];
+		SURFACE_CODECID(cmd) = codec_id;
+		update->SurfaceBits(update->context, &cmd);
+	}
 
-	marker.frameAction = SURFACECMD_FRAMEACTION_END;
-	update->SurfaceFrameMarker(peer->context, &marker);
+	if (job->codec == RDP_ENCODER_RAW) {
+		marker.frameAction = SURFACECMD_FRAMEACTION_END;
+		update->SurfaceFrameMarker(update->context, &marker);
+	}
 }
 
 static void
-rdp_peer_refresh_region(pixman_region32_t *region, freerdp_peer *peer)
+rdp_encoder_wait(struct rdp_encoder *encoder)
 {
-	RdpPeerContext *context = (RdpPeerContext *)peer->context;
-	struct rdp_output *output = context->rdpBackend->output;
-	rdpSettings *settings = peer->settings;
-
-	if (settings->RemoteFxCodec)
-		rdp_peer_refresh_rfx(region, output->shadow_surface, peer);
-	else if (settings->NSCodec)
-		rdp_peer_refresh_nsc(region, output->shadow_surface, peer);
+	pthread_mutex_lock(&encoder->mutex);
+	while (encoder->job_queued)
+		pthread_cond_wait(&encoder->cond, &encoder->mutex);
+	pthread_mutex_unlock(&encoder->mutex);
+}
+
+/* Hands a finished job to the peer and to all of its followers. When
+ * 'deliver' is false the frame is dropped and its damage is put back into
+ * the pending region of every peer that was waiting for it. */
+static void
+rdp_encoder_complete(RdpPeerContext *context, bool deliver)
+{
+	struct rdp_encoder *encoder = &context->encoder;
+	struct rdp_encoder *follower, *tmp;
+
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->job_done = false;
+	pthread_mutex_unlock(&encoder->mutex);
+
+	if (deliver)
+		rdp_encoder_send(context, &encoder->job);
 	else
-		rdp_peer_refresh_raw(region, output->shadow_surface, peer);
+		pixman_region32_union(&encoder->pending, &encoder->pending,
+				      &encoder->job.damage);
+
+	wl_list_for_each_safe(follower, tmp, &encoder->followers, follower_link) {
+		if (deliver)
+			rdp_encoder_send(container_of(follower, RdpPeerContext, encoder),
+					 &encoder->job);
+		else
+			pixman_region32_union(&follower->pending, &follower->pending,
+					      &encoder->job.damage);
+
+		wl_list_remove(&follower->follower_link);
+		wl_list_init(&follower->follower_link);
+		follower->leader = NULL;
+		follower->busy = false;
+	}
+
+	encoder->busy = false;
+}
+
+/* Drops the frame in flight for this peer, waiting for the worker if it is
+ * still encoding, so the codec contexts can be touched safely. */
+static void
+rdp_encoder_cancel(RdpPeerContext *context)
+{
+	struct rdp_encoder *encoder = &context->encoder;
+
+	if (!encoder->busy)
+		return;
+
+	if (encoder->leader) {
+		pixman_region32_union(&encoder->pending, &encoder->pending,
+				      &encoder->leader->encoder.job.damage);
+		wl_list_remove(&encoder->follower_link);
+		wl_list_init(&encoder->follower_link);
+		encoder->leader = NULL;
+		encoder->busy = false;
+		return;
+	}
+
+	rdp_encoder_wait(encoder);
+	rdp_encoder_complete(context, false);
+}
+
+static bool
+rdp_peer_wants_frame(RdpPeerContext *context)
+{
+	struct rdp_encoder *encoder = &context->encoder;
+
+	return encoder->running && !encoder->busy &&
+		(context->item.flags & RDP_PEER_ACTIVATED) &&
+		(context->item.flags & RDP_PEER_OUTPUT_ENABLED) &&
+		pixman_region32_not_empty(&encoder->pending);
+}
+
+/* Looks for a peer that started encoding the very same frame in this
+ * dispatch pass with a codec whose bitstream does not depend on the
+ * connection. RemoteFX keeps per-connection state (headers, frame index)
+ * in its messages, so it is never shared. */
+static RdpPeerContext *
+rdp_output_find_leader(struct rdp_output *output, RdpPeerContext *context)
+{
+	enum rdp_encoder_codec codec = rdp_peer_codec(context->item.peer);
+	UINT32 multifrag = context->item.peer->settings->MultifragMaxRequestSize;
+	struct rdp_peers_item *item;
+	RdpPeerContext *other;
+	struct rdp_encoder *encoder;
+
+	if (codec == RDP_ENCODER_RFX)
+		return NULL;
+
+	wl_list_for_each(item, &output->peers, link) {
+		other = container_of(item, RdpPeerContext, item);
+		encoder = &other->encoder;
+
+		if (other == context || !encoder->busy || encoder->leader ||
+		    encoder->dispatch_seq != output->dispatch_seq)
+			continue;
+
+		if (encoder->job.codec != codec)
+			continue;
+
+		if (codec == RDP_ENCODER_RAW &&
+		    encoder->job.multifrag_max_request_size != multifrag)
+			continue;
+
+		if (pixman_region32_equal(&encoder->job.damage,
+					  &context->encoder.pending))
+			return other;
+	}
+
+	return NULL;
+}
+
+static void
+rdp_encoder_start(struct rdp_output *output, RdpPeerContext *context)
+{
+	struct rdp_encoder *encoder = &context->encoder;
+	struct rdp_encoder_job *job = &encoder->job;
+	freerdp_peer *peer = context->item.peer;
+	int width = pixman_image_get_width(output->shadow_surface);
+	int height = pixman_image_get_height(output->shadow_surface);
+	pixman_box32_t *rects;
+	int nrects, i;
+
+	if (!encoder->snapshot ||
+	    pixman_image_get_width(encoder->snapshot) != width ||
+	    pixman_image_get_height(encoder->snapshot) != height) {
+		if (encoder->snapshot)
+			pixman_image_unref(encoder->snapshot);
+		encoder->snapshot = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+							     width, height,
+							     NULL, width * 4);
+		if (!encoder->snapshot) {
+			weston_log("Failed to create RDP encoder snapshot.\n");
+			return;
+		}
+	}
+
+	/* only the damaged tiles are copied, the worker reads the rest of
+	 * the snapshot as left by previous frames but never encodes it */
+	rects = pixman_region32_rectangles(&encoder->pending, &nrects);
+	for (i = 0; i < nrects; i++)
+		pixman_image_composite32(PIXMAN_OP_SRC, output->shadow_surface,
+					 NULL, encoder->snapshot,
+					 rects[i].x1, rects[i].y1, 0, 0,
+					 rects[i].x1, rects[i].y1,
+					 rects[i].x2 - rects[i].x1,
+					 rects[i].y2 - rects[i].y1);
+
+	pixman_region32_copy(&job->damage, &encoder->pending);
+	pixman_region32_clear(&encoder->pending);
+	job->codec = rdp_peer_codec(peer);
+	job->multifrag_max_request_size = peer->settings->MultifragMaxRequestSize;
+
+	encoder->busy = true;
+	encoder->dispatch_seq = output->dispatch_seq;
+
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->job_queued = true;
+	pthread_cond_broadcast(&encoder->cond);
+	pthread_mutex_unlock(&encoder->mutex);
+}
+
+/* Starts a frame for every idle peer with pending damage. Busy peers keep
+ * accumulating damage and get a single merged frame once their worker is
+ * done, so there is never more than one frame in flight per peer. */
+static void
+rdp_output_dispatch_peers(struct rdp_output *output)
+{
+	struct rdp_peers_item *item;
+	RdpPeerContext *context, *leader;
+	struct rdp_encoder *encoder;
+
+	if (!output)
+		return;
+
+	output->dispatch_seq++;
+
+	wl_list_for_each(item, &output->peers, link) {
+		context = container_of(item, RdpPeerContext, item);
+		encoder = &context->encoder;
+
+		if (!rdp_peer_wants_frame(context))
+			continue;
+
+		pixman_region32_intersect_rect(&encoder->pending, &encoder->pending, 0, 0,
+					       pixman_image_get_width(output->shadow_surface),
+					       pixman_image_get_height(output->shadow_surface));
+		if (!pixman_region32_not_empty(&encoder->pending))
+			continue;
+
+		leader = rdp_output_find_leader(output, context);
+		if (leader) {
+			pixman_region32_clear(&encoder->pending);
+			encoder->leader = leader;
+			encoder->busy = true;
+			wl_list_insert(leader->encoder.followers.prev,
+				       &encoder->follower_link);
+		} else {
+			rdp_encoder_start(output, context);
+		}
+	}
+}
+
+static int
+rdp_encoder_done(int fd, uint32_t mask, void *data)
+{
+	RdpPeerContext *context = data;
+	struct rdp_encoder *encoder = &context->encoder;
+	uint64_t count;
+	bool done;
+
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		weston_log("failed to read RDP encoder eventfd: %s\n",
+			   strerror(errno));
+
+	pthread_mutex_lock(&encoder->mutex);
+	done = encoder->job_done;
+	pthread_mutex_unlock(&encoder->mutex);
+
+	/* the job may already have been reaped by rdp_encoder_cancel() */
+	if (!done)
+		return 0;
+
+	rdp_encoder_complete(context, true);
+	rdp_output_dispatch_peers(context->rdpBackend->output);
+
+	return 0;
+}
+
+static int
+rdp_encoder_init(RdpPeerContext *context, struct wl_event_loop *loop)
+{
+	struct rdp_encoder *encoder = &context->encoder;
+
+	pixman_region32_init(&encoder->pending);
+	pixman_region32_init(&encoder->job.damage);
+	wl_list_init(&encoder->followers);
+	wl_list_init(&encoder->follower_link);
+	pthread_mutex_init(&encoder->mutex, NULL);
+	pthread_cond_init(&encoder->cond, NULL);
+
+	encoder->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (encoder->done_fd < 0)
+		goto err_fd;
+
+	encoder->done_source = wl_event_loop_add_fd(loop, encoder->done_fd,
+						    WL_EVENT_READABLE,
+						    rdp_encoder_done, context);
+	if (!encoder->done_source)
+		goto err_source;
+
+	if (pthread_create(&encoder->thread, NULL, rdp_encoder_thread, context) != 0)
+		goto err_thread;
+
+	encoder->running = true;
+	return 0;
+
+err_thread:
+	wl_event_source_remove(encoder->done_source);
+err_source:
+	close(encoder->done_fd);
+err_fd:
+	pthread_cond_destroy(&encoder->cond);
+	pthread_mutex_destroy(&encoder->mutex);
+	pixman_region32_fini(&encoder->job.damage);
+	pixman_region32_fini(&encoder->pending);
+	weston_log("unable to start the RDP encoder thread\n");
+	return -1;
+}
+
+static void
+rdp_encoder_fini(RdpPeerContext *context)
+{
+	struct rdp_encoder *encoder = &context->encoder;
+
+	rdp_encoder_cancel(context);
+
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->quit = true;
+	pthread_cond_broadcast(&encoder->cond);
+	pthread_mutex_unlock(&encoder->mutex);
+	pthread_join(encoder->thread, NULL);
+	encoder->running = false;
+
+	wl_event_source_remove(encoder->done_source);
+	close(encoder->done_fd);
+	pthread_cond_destroy(&encoder->cond);
+	pthread_mutex_destroy(&encoder->mutex);
+
+	if (encoder->snapshot)
+		pixman_image_unref(encoder->snapshot);
+	free(encoder->job.cmds);
+	free(encoder->job.raw_data);
+	pixman_region32_fini(&encoder->job.damage);
+	pixman_region32_fini(&encoder->pending);
 }
 
 static int
@@ -400,6 +862,7 @@ rdp_output_repaint(struct weston_output *output_base, pixman_region32_t *damage,
 	struct rdp_output *output = container_of(output_base, struct rdp_output, base);
 	struct weston_compositor *ec = output->base.compositor;
 	struct rdp_peers_item *outputPeer;
+	RdpPeerContext *peerCtx;
 
 	pixman_renderer_output_set_buffer(output_base, output->shadow_surface);
 	ec->renderer->repaint_output(&output->base, damage);
@@ -409,9 +872,14 @@ rdp_output_repaint(struct weston_output *output_base, pixman_region32_t *damage,
 			if ((outputPeer->flags & RDP_PEER_ACTIVATED) &&
 					(outputPeer->flags & RDP_PEER_OUTPUT_ENABLED))
 			{
-				rdp_peer_refresh_region(damage, outputPeer->peer);
+				peerCtx = container_of(outputPeer, RdpPeerContext, item);
+				pixman_region32_union(&peerCtx->encoder.pending,
+						      &peerCtx->encoder.pending, damage);
 			}
 		}
+
+		/* encoding happens on the peers' worker threads */
+		rdp_output_dispatch_peers(output);
 	}
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
@@ -499,6 +967,9 @@ rdp_switch_mode(struct weston_output *output, struct weston_mode *target_mode)
 				settings->DesktopHeight == (UINT32)target_mode->height)
 			continue;
 
+		/* frames in flight were encoded for the old size */
+		rdp_encoder_cancel(container_of(rdpPeer, RdpPeerContext, item));
+
 		if (!settings->DesktopResize) {
 			/* too bad this peer does not support desktop resize */
 			rdpPeer->peer->Close(rdpPeer->peer);
@@ -780,6 +1251,12 @@ rdp_peer_context_free(freerdp_peer* client, RdpPeerContext* context)
 		 * but it would crash on reconnect */
 	}
 
+	if (context->encoder.running) {
+		rdp_encoder_fini(context);
+		/* peers that were waiting for our frame now encode their own */
+		rdp_output_dispatch_peers(context->rdpBackend->output);
+	}
+
 	Stream_Free(context->encode_stream, TRUE);
 	nsc_context_free(context->nsc_context);
 	rfx_context_free(context->rfx_context);
@@ -958,8 +1435,6 @@ xf_peer_activate(freerdp_peer* client)
 	struct xkb_keymap *keymap;
 	struct weston_output *weston_output;
 	int i;
-	pixman_box32_t box;
-	pixman_region32_t damage;
 	char seat_name[50];
 	POINTER_SYSTEM_UPDATE pointer_system;
 
@@ -1011,11 +1486,15 @@ xf_peer_activate(freerdp_peer* client)
 	}
 
 	weston_output = &output->base;
+	/* the worker owns the codec contexts while it is encoding */
+	rdp_encoder_cancel(peerCtx);
 	RFX_RESET(peerCtx->rfx_context, weston_output->width, weston_output->height);
 	NSC_RESET(peerCtx->nsc_context, weston_output->width, weston_output->height);
 
-	if (peersItem->flags & RDP_PEER_ACTIVATED)
+	if (peersItem->flags & RDP_PEER_ACTIVATED) {
+		rdp_output_dispatch_peers(output);
 		return TRUE;
+	}
 
 	/* when here it's the first reactivation, we need to setup a little more */
 	weston_log("kbd_layout:0x%x kbd_type:0x%x kbd_subType:0x%x kbd_functionKeys:0x%x\n",
@@ -1070,15 +1549,10 @@ xf_peer_activate(freerdp_peer* client)
 	pointer->PointerSystem(client->context, &pointer_system);
 
 	/* sends a full refresh */
-	box.x1 = 0;
-	box.y1 = 0;
-	box.x2 = output->base.width;
-	box.y2 = output->base.height;
-	pixman_region32_init_with_extents(&damage, &box);
-
-	rdp_peer_refresh_region(&damage, client);
-
-	pixman_region32_fini(&damage);
+	pixman_region32_union_rect(&peerCtx->encoder.pending,
+				   &peerCtx->encoder.pending, 0, 0,
+				   output->base.width, output->base.height);
+	rdp_output_dispatch_peers(output);
 
 	return TRUE;
 }
@@ -1174,22 +1648,15 @@ xf_extendedMouseEvent(rdpInput *input, UINT16 flags, UINT16 x, UINT16 y)
 static FREERDP_CB_RET_TYPE
 xf_input_synchronize_event(rdpInput *input, UINT32 flags)
 {
-	freerdp_peer *client = input->context->peer;
 	RdpPeerContext *peerCtx = (RdpPeerContext *)input->context;
 	struct rdp_output *output = peerCtx->rdpBackend->output;
-	pixman_box32_t box;
-	pixman_region32_t damage;
 
 	/* sends a full refresh */
-	box.x1 = 0;
-	box.y1 = 0;
-	box.x2 = output->base.width;
-	box.y2 = output->base.height;
-	pixman_region32_init_with_extents(&damage, &box);
+	pixman_region32_union_rect(&peerCtx->encoder.pending,
+				   &peerCtx->encoder.pending, 0, 0,
+				   output->base.width, output->base.height);
+	rdp_output_dispatch_peers(output);
 
-	rdp_peer_refresh_region(&damage, client);
-
-	pixman_region32_fini(&damage);
 	FREERDP_CB_RETURN(TRUE);
 }
 
@@ -1275,6 +1742,10 @@ rdp_peer_init(freerdp_peer *client, struct rdp_backend *b)
 	peerCtx = (RdpPeerContext *) client->context;
 	peerCtx->rdpBackend = b;
 
+	loop = wl_display_get_event_loop(b->compositor->wl_display);
+	if (rdp_encoder_init(peerCtx, loop) < 0)
+		goto error_initialize;
+
 	settings = client->settings;
 	/* configure security settings */
 	if (b->rdp_key)
@@ -1319,7 +1790,6 @@ rdp_peer_init(freerdp_peer *client, struct rdp_backend *b)
 		goto error_initialize;
 	}
 
-	loop = wl_display_get_event_loop(b->compositor->wl_display);
 	for (i = 0; i < rcount; i++) {
 		fd = (int)(long)(rfds[i]);
 
@@ -25,25 +25,54 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <linux/input.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/uio.h>
 
 #include <libweston/libweston.h>
 #include "shared/helpers.h"
 
+/* First chunk of a memfd; it doubles from there up to the size cap. */
+#define CLIPBOARD_MIN_CAPACITY (64 * 1024)
+
+enum clipboard_entry_state {
+	CLIPBOARD_ENTRY_READING,
+	CLIPBOARD_ENTRY_DONE,
+	CLIPBOARD_ENTRY_FAILED,
+};
+
+/* The contents of one offered mime type, spliced from the source client
+ * into a memfd. */
+struct clipboard_entry {
+	struct clipboard_source *source;
+	char *mime_type;
+	enum clipboard_entry_state state;
+
+	int pipe_fd;
+	struct wl_event_source *event_source;
+
+	int memfd;
+	off_t size;
+	off_t capacity;
+
+	/* readers that asked for the data before it was complete */
+	struct wl_list waiting_list;
+};
+
 struct clipboard_source {
 	struct weston_data_source base;
-	struct wl_array contents;
+	struct clipboard_entry *entries;
+	int n_entries;
 	struct clipboard *clipboard;
-	struct wl_event_source *event_source;
 	uint32_t serial;
 	int refcount;
-	int fd;
 };
 
 struct clipboard {
@@ -53,60 +82,222 @@ struct clipboard {
 	struct clipboard_source *source;
 };
 
-static void clipboard_client_create(struct clipboard_source *source, int fd);
+struct clipboard_client {
+	struct wl_event_source *event_source;
+	struct wl_list link;
+	struct clipboard_entry *entry;
+	int fd;
+	off_t offset;
+};
+
+static void clipboard_source_unref(struct clipboard_source *source);
+static void clipboard_client_start(struct clipboard_client *client);
+static void clipboard_client_destroy(struct clipboard_client *client);
 
 static void
-clipboard_source_unref(struct clipboard_source *source)
+clipboard_entry_stop_reading(struct clipboard_entry *entry)
 {
-	char **s;
+	if (entry->event_source)
+		wl_event_source_remove(entry->event_source);
+	entry->event_source = NULL;
 
-	source->refcount--;
-	if (source->refcount > 0)
+	if (entry->pipe_fd >= 0)
+		close(entry->pipe_fd);
+	entry->pipe_fd = -1;
+}
+
+static void
+clipboard_entry_fail(struct clipboard_entry *entry)
+{
+	struct clipboard_client *client, *next;
+
+	clipboard_entry_stop_reading(entry);
+
+	if (entry->memfd >= 0)
+		close(entry->memfd);
+	entry->memfd = -1;
+	entry->size = 0;
+	entry->capacity = 0;
+	entry->state = CLIPBOARD_ENTRY_FAILED;
+
+	/* the waiting clients may hold the last references */
+	entry->source->refcount++;
+	wl_list_for_each_safe(client, next, &entry->waiting_list, link)
+		clipboard_client_destroy(client);
+	clipboard_source_unref(entry->source);
+}
+
+static void
+clipboard_entry_finish(struct clipboard_entry *entry)
+{
+	struct clipboard_client *client, *next;
+
+	clipboard_entry_stop_reading(entry);
+
+	/* drop the unused tail of the last doubling */
+	if (ftruncate(entry->memfd, entry->size) < 0) {
+		clipboard_entry_fail(entry);
 		return;
+	}
+	entry->capacity = entry->size;
+	entry->state = CLIPBOARD_ENTRY_DONE;
+
+	entry->source->refcount++;
+	wl_list_for_each_safe(client, next, &entry->waiting_list, link) {
+		wl_list_remove(&client->link);
+		wl_list_init(&client->link);
+		clipboard_client_start(client);
+	}
+	clipboard_source_unref(entry->source);
+}
+
+static off_t
+clipboard_source_room(struct clipboard_source *source)
+{
+	struct weston_compositor *ec = source->clipboard->seat->compositor;
+	off_t total = 0;
+	int i;
+
+	for (i = 0; i < source->n_entries; i++)
+		total += source->entries[i].size;
+
+	return total < (off_t)ec->clipboard_max_total ?
+		(off_t)ec->clipboard_max_total - total : 0;
+}
+
+/* Makes room for more data, doubling the memfd up to the size cap.
+ * Growing a memfd never copies what is already there. */
+static int
+clipboard_entry_grow(struct clipboard_entry *entry)
+{
+	struct weston_compositor *ec = entry->source->clipboard->seat->compositor;
+	off_t capacity;
+
+	capacity = entry->capacity ? entry->capacity * 2 : CLIPBOARD_MIN_CAPACITY;
+	if (capacity > (off_t)ec->clipboard_max_size)
+		capacity = ec->clipboard_max_size;
+	if (capacity <= entry->capacity)
+		return -1;
 
-	if (source->event_source) {
-		wl_event_source_remove(source->event_source);
-		close(source->fd);
+	if (ftruncate(entry->memfd, capacity) < 0)
+		return -1;
+	entry->capacity = capacity;
+
+	return 0;
+}
+
+/* The entry reached a size cap. It is still kept if the source has
+ * nothing more to send, so data exactly as large as the cap fits. */
+static void
+clipboard_entry_at_cap(struct clipboard_entry *entry, int fd,
+		       const char *what, size_t cap)
+{
+	char byte;
+	ssize_t len;
+
+	len = read(fd, &byte, 1);
+	if (len == 0) {
+		clipboard_entry_finish(entry);
+	} else if (len > 0 || (errno != EAGAIN && errno != EINTR)) {
+		weston_log("clipboard: not keeping %s selection, "
+			   "%s larger than %zu bytes\n", entry->mime_type,
+			   what, cap);
+		clipboard_entry_fail(entry);
 	}
-	wl_signal_emit(&source->base.destroy_signal,
-		       &source->base);
-	s = source->base.mime_types.data;
-	free(*s);
-	wl_array_release(&source->base.mime_types);
-	wl_array_release(&source->contents);
-	free(source);
 }
 
 static int
-clipboard_source_data(int fd, uint32_t mask, void *data)
+clipboard_entry_data(int fd, uint32_t mask, void *data)
 {
-	struct clipboard_source *source = data;
-	struct clipboard *clipboard = source->clipboard;
-	char *p;
-	int len, size;
-
-	if (source->contents.alloc - source->contents.size < 1024) {
-		wl_array_add(&source->contents, 1024);
-		source->contents.size -= 1024;
+	struct clipboard_entry *entry = data;
+	struct weston_compositor *ec = entry->source->clipboard->seat->compositor;
+	off_t room, offset;
+	ssize_t len;
+
+	if (entry->size == entry->capacity && clipboard_entry_grow(entry) < 0) {
+		clipboard_entry_at_cap(entry, fd, "data", ec->clipboard_max_size);
+		return 1;
+	}
+
+	room = clipboard_source_room(entry->source);
+	if (room == 0) {
+		clipboard_entry_at_cap(entry, fd, "selection",
+				       ec->clipboard_max_total);
+		return 1;
 	}
 
-	p = source->contents.data + source->contents.size;
-	size = source->contents.alloc - source->contents.size;
-	len = read(fd, p, size);
+	offset = entry->size;
+	len = splice(fd, NULL, entry->memfd, &offset,
+		     MIN(entry->capacity - entry->size, room),
+		     SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
 	if (len == 0) {
-		wl_event_source_remove(source->event_source);
-		close(fd);
-		source->event_source = NULL;
+		clipboard_entry_finish(entry);
 	} else if (len < 0) {
-		clipboard_source_unref(source);
-		clipboard->source = NULL;
+		if (errno != EAGAIN && errno != EINTR)
+			clipboard_entry_fail(entry);
 	} else {
-		source->contents.size += len;
+		entry->size += len;
 	}
 
 	return 1;
 }
 
+static int
+clipboard_entry_init(struct clipboard_entry *entry,
+		     struct weston_data_source *offer, const char *mime_type)
+{
+	struct wl_display *display =
+		entry->source->clipboard->seat->compositor->wl_display;
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	int p[2];
+
+	entry->memfd = memfd_create("weston-clipboard", MFD_CLOEXEC);
+	if (entry->memfd < 0)
+		return -1;
+
+	if (pipe2(p, O_CLOEXEC) == -1)
+		return -1;
+
+	/* only our end; the source client may rely on blocking writes */
+	fcntl(p[0], F_SETFL, O_NONBLOCK);
+	entry->pipe_fd = p[0];
+
+	offer->send(offer, mime_type, p[1]);
+
+	entry->event_source =
+		wl_event_loop_add_fd(loop, p[0], WL_EVENT_READABLE,
+				     clipboard_entry_data, entry);
+	if (entry->event_source == NULL)
+		return -1;
+
+	return 0;
+}
+
+static void
+clipboard_source_unref(struct clipboard_source *source)
+{
+	struct clipboard_entry *entry;
+	int i;
+
+	source->refcount--;
+	if (source->refcount > 0)
+		return;
+
+	for (i = 0; i < source->n_entries; i++) {
+		entry = &source->entries[i];
+		clipboard_entry_stop_reading(entry);
+		if (entry->memfd >= 0)
+			close(entry->memfd);
+		free(entry->mime_type);
+	}
+
+	wl_signal_emit(&source->base.destroy_signal,
+		       &source->base);
+	wl_array_release(&source->base.mime_types);
+	free(source->entries);
+	free(source);
+}
+
 static void
 clipboard_source_accept(struct weston_data_source *source,
 			uint32_t time, const char *mime_type)
@@ -119,13 +310,41 @@ clipboard_source_send(struct weston_data_source *base,
 {
 	struct clipboard_source *source =
 		container_of(base, struct clipboard_source, base);
-	char **s;
+	struct clipboard_entry *entry = NULL;
+	struct clipboard_client *client;
+	int i;
+
+	for (i = 0; i < source->n_entries; i++) {
+		if (strcmp(mime_type, source->entries[i].mime_type) == 0 &&
+		    source->entries[i].state != CLIPBOARD_ENTRY_FAILED) {
+			entry = &source->entries[i];
+			break;
+		}
+	}
 
-	s = source->base.mime_types.data;
-	if (strcmp(mime_type, s[0]) == 0)
-		clipboard_client_create(source, fd);
-	else
+	if (entry == NULL) {
+		close(fd);
+		return;
+	}
+
+	client = zalloc(sizeof *client);
+	if (client == NULL) {
 		close(fd);
+		return;
+	}
+
+	/* never let a slow reader block the compositor */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	client->entry = entry;
+	client->fd = fd;
+	wl_list_init(&client->link);
+	source->refcount++;
+
+	if (entry->state == CLIPBOARD_ENTRY_READING)
+		wl_list_insert(entry->waiting_list.prev, &client->link);
+	else
+		clipboard_client_start(client);
 }
 
 static void
@@ -133,20 +352,50 @@ clipboard_source_cancel(struct weston_data_source *source)
 {
 }
 
+/* Advertises only the mime types that are still readable. Returns the
+ * number of types left. */
+static int
+clipboard_source_prune(struct clipboard_source *source)
+{
+	char **s;
+	int i;
+
+	source->base.mime_types.size = 0;
+	for (i = 0; i < source->n_entries; i++) {
+		if (source->entries[i].state == CLIPBOARD_ENTRY_FAILED)
+			continue;
+
+		s = wl_array_add(&source->base.mime_types, sizeof *s);
+		if (s == NULL)
+			break;
+		*s = source->entries[i].mime_type;
+	}
+
+	return source->base.mime_types.size / sizeof *s;
+}
+
 static struct clipboard_source *
 clipboard_source_create(struct clipboard *clipboard,
-			const char *mime_type, uint32_t serial, int fd)
+			struct weston_data_source *offer, uint32_t serial)
 {
-	struct wl_display *display = clipboard->seat->compositor->wl_display;
-	struct wl_event_loop *loop = wl_display_get_event_loop(display);
 	struct clipboard_source *source;
-	char **s;
+	struct clipboard_entry *entry;
+	const char **mime_types = offer->mime_types.data;
+	int i, n = offer->mime_types.size / sizeof *mime_types;
+
+	if (n == 0)
+		return NULL;
 
 	source = zalloc(sizeof *source);
 	if (source == NULL)
 		return NULL;
 
-	wl_array_init(&source->contents);
+	source->entries = calloc(n, sizeof *source->entries);
+	if (source->entries == NULL) {
+		free(source);
+		return NULL;
+	}
+
 	wl_array_init(&source->base.mime_types);
 	source->base.resource = NULL;
 	source->base.accept = clipboard_source_accept;
@@ -156,79 +405,75 @@ clipboard_source_create(struct clipboard *clipboard,
 	source->refcount = 1;
 	source->clipboard = clipboard;
 	source->serial = serial;
-	source->fd = fd;
-
-	s = wl_array_add(&source->base.mime_types, sizeof *s);
-	if (s == NULL)
-		goto err_add;
-	*s = strdup(mime_type);
-	if (*s == NULL)
-		goto err_strdup;
-	source->event_source =
-		wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
-				     clipboard_source_data, source);
-	if (source->event_source == NULL)
-		goto err_source;
 
-	return source;
+	/* keep every offered type, each one read into its own memfd */
+	for (i = 0; i < n; i++) {
+		entry = &source->entries[source->n_entries];
+		entry->source = source;
+		entry->pipe_fd = -1;
+		entry->memfd = -1;
+		wl_list_init(&entry->waiting_list);
+
+		entry->mime_type = strdup(mime_types[i]);
+		if (entry->mime_type == NULL)
+			continue;
+		source->n_entries++;
+
+		if (clipboard_entry_init(entry, offer, mime_types[i]) < 0)
+			clipboard_entry_fail(entry);
+	}
 
- err_source:
-	free(*s);
- err_strdup:
-	wl_array_release(&source->base.mime_types);
- err_add:
-	free(source);
+	if (clipboard_source_prune(source) == 0) {
+		clipboard_source_unref(source);
+		return NULL;
+	}
 
-	return NULL;
+	return source;
 }
 
-struct clipboard_client {
-	struct wl_event_source *event_source;
-	size_t offset;
-	struct clipboard_source *source;
-};
-
 static int
 clipboard_client_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_client *client = data;
-	char *p;
-	size_t size;
-	int len;
-
-	size = client->source->contents.size;
-	p = client->source->contents.data;
-	len = write(fd, p + client->offset, size - client->offset);
-	if (len > 0)
-		client->offset += len;
-
-	if (client->offset == size || len <= 0) {
-		close(fd);
-		wl_event_source_remove(client->event_source);
-		clipboard_source_unref(client->source);
-		free(client);
+	struct clipboard_entry *entry = client->entry;
+	ssize_t len = 0;
+
+	if (client->offset < entry->size) {
+		len = sendfile(fd, entry->memfd, &client->offset,
+			       entry->size - client->offset);
+		if (len < 0 && (errno == EAGAIN || errno == EINTR))
+			return 1;
 	}
 
+	if (client->offset == entry->size || len <= 0)
+		clipboard_client_destroy(client);
+
 	return 1;
 }
 
 static void
-clipboard_client_create(struct clipboard_source *source, int fd)
+clipboard_client_start(struct clipboard_client *client)
 {
-	struct weston_seat *seat = source->clipboard->seat;
-	struct clipboard_client *client;
+	struct weston_seat *seat = client->entry->source->clipboard->seat;
 	struct wl_event_loop *loop =
 		wl_display_get_event_loop(seat->compositor->wl_display);
 
-	client = zalloc(sizeof *client);
-	if (client == NULL)
-		return;
-
-	client->source = source;
-	source->refcount++;
 	client->event_source =
-		wl_event_loop_add_fd(loop, fd, WL_EVENT_WRITABLE,
+		wl_event_loop_add_fd(loop, client->fd, WL_EVENT_WRITABLE,
 				     clipboard_client_data, client);
+	if (client->event_source == NULL)
+		clipboard_client_destroy(client);
+}
+
+static void
+clipboard_client_destroy(struct clipboard_client *client)
+{
+	close(client->fd);
+	if (client->event_source)
+		wl_event_source_remove(client->event_source);
+	wl_list_remove(&client->link);
+	clipboard_source_unref(client->entry->source);
+	free(client);
 }
 
 static void
@@ -238,11 +483,10 @@ clipboard_set_selection(struct wl_listener *listener, void *data)
 		container_of(listener, struct clipboard, selection_listener);
 	struct weston_seat *seat = data;
 	struct weston_data_source *source = seat->selection_data_source;
-	const char **mime_types;
-	int p[2];
 
 	if (source == NULL) {
-		if (clipboard->source)
+		if (clipboard->source &&
+		    clipboard_source_prune(clipboard->source) > 0)
 			weston_seat_set_selection(seat,
 						  &clipboard->source->base,
 						  clipboard->source->serial);
@@ -257,20 +501,12 @@ clipboard_set_selection(struct wl_listener *listener, void *data)
 
 	clipboard->source = NULL;
 
-	mime_types = source->mime_types.data;
-
-	if (!mime_types || pipe2(p, O_CLOEXEC) == -1)
+	if (!source->mime_types.data || seat->compositor->clipboard_max_size == 0)
 		return;
 
-	source->send(source, mime_types[0], p[1]);
-
 	clipboard->source =
-		clipboard_source_create(clipboard, mime_types[0],
-					seat->selection_serial, p[0]);
-	if (clipboard->source == NULL) {
-		close(p[0]);
-		return;
-	}
+		clipboard_source_create(clipboard, source,
+					seat->selection_serial);
 }
 
 static void
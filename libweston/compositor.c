@@ -63,6 +63,7 @@
 #include "xdg-output-unstable-v1-server-protocol.h"
 #include "linux-explicit-synchronization-unstable-v1-server-protocol.h"
 #include "linux-explicit-synchronization.h"
+#include "linux-sync-file.h"
 #include "shared/fd-util.h"
 #include "shared/helpers.h"
 #include "shared/os-compatibility.h"
@@ -74,6 +75,7 @@
 #include "pixel-formats.h"
 #include "backend.h"
 #include "libweston-internal.h"
+#include "pick-index.h"
 #include "trace-reporter.h"
 
 #include "weston-log-internal.h"
@@ -85,6 +87,8 @@
  */
 
 #define DEFAULT_REPAINT_WINDOW 7 /* milliseconds */
+#define DEFAULT_CLIPBOARD_MAX_SIZE (256 << 20)
+#define DEFAULT_CLIPBOARD_MAX_TOTAL (512 << 20)
 /* Storage for global tracing variables (see compositor.h) */
 WL_EXPORT struct trace_info __trace_buffer[TRACE_BUFFER_SIZE];
 WL_EXPORT unsigned int __trace_start, __trace_end;
@@ -335,11 +339,13 @@ weston_surface_to_subsurface(struct weston_surface *surface);
 WL_EXPORT struct weston_view *
 weston_view_create(struct weston_surface *surface)
 {
+	struct weston_view_internal *internal;
 	struct weston_view *view;
 
-	view = zalloc(sizeof *view);
-	if (view == NULL)
+	internal = zalloc(sizeof *internal);
+	if (internal == NULL)
 		return NULL;
+	view = &internal->base;
 
 	view->surface = surface;
 	view->plane = &surface->compositor->primary_plane;
@@ -556,6 +562,8 @@ weston_surface_create(struct weston_compositor *compositor)
 	surface->buffer_viewport.surface.width = -1;
 
 	weston_surface_state_init(&surface->pending);
+	weston_surface_state_init(&surface->fence_wait.state);
+	wl_list_init(&surface->fence_wait.link);
 
 	pixman_region32_init(&surface->damage);
 	pixman_region32_init(&surface->opaque);
@@ -1496,6 +1504,8 @@ weston_view_update_transform(struct weston_view *view)
 
 	weston_view_damage_below(view);
 
+	weston_pick_index_update_view(view);
+
 	weston_view_assign_output(view);
 
 	wl_signal_emit(&view->surface->compositor->transform_signal,
@@ -1956,7 +1966,64 @@ weston_compositor_get_time(struct timespec *time)
 	clock_gettime(CLOCK_REALTIME, time);
 }
 
+static bool
+weston_view_accepts_pick(struct weston_view *view, wl_fixed_t x, wl_fixed_t y,
+			 wl_fixed_t *vx, wl_fixed_t *vy)
+{
+	wl_fixed_t view_x, view_y;
+	int view_ix, view_iy;
+
+	if (!pixman_region32_contains_point(&view->transform.boundingbox,
+					    wl_fixed_to_int(x),
+					    wl_fixed_to_int(y), NULL))
+		return false;
+
+	weston_view_from_global_fixed(view, x, y, &view_x, &view_y);
+	view_ix = wl_fixed_to_int(view_x);
+	view_iy = wl_fixed_to_int(view_y);
+
+	if (!pixman_region32_contains_point(&view->surface->input,
+					    view_ix, view_iy, NULL))
+		return false;
+
+	if (view->geometry.scissor_enabled &&
+	    !pixman_region32_contains_point(&view->geometry.scissor,
+					    view_ix, view_iy, NULL))
+		return false;
+
+	*vx = view_x;
+	*vy = view_y;
+	return true;
+}
+
+/** Pick a view by walking the whole view list
+ *
+ * Reference implementation of weston_compositor_pick_view(), used for
+ * points outside of the pick index.
+ */
+static struct weston_view *
+weston_compositor_pick_view_linear(struct weston_compositor *compositor,
+				   wl_fixed_t x, wl_fixed_t y,
+				   wl_fixed_t *vx, wl_fixed_t *vy)
+{
+	struct weston_view *view;
+
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (weston_view_accepts_pick(view, x, y, vx, vy))
+			return view;
+	}
+
+	*vx = wl_fixed_from_int(-1000000);
+	*vy = wl_fixed_from_int(-1000000);
+	return NULL;
+}
+
 /** weston_compositor_pick_view
+ *
+ * Returns the topmost view in the view list accepting input at the given
+ * global position. Only the views sharing a pick index cell with the
+ * point are considered, the result is the same as walking the list.
+ *
  * \ingroup compositor
  */
 WL_EXPORT struct weston_view *
@@ -1964,38 +2031,42 @@ weston_compositor_pick_view(struct weston_compositor *compositor,
 			    wl_fixed_t x, wl_fixed_t y,
 			    wl_fixed_t *vx, wl_fixed_t *vy)
 {
-	struct weston_view *view;
+	struct weston_pick_index *index;
+	struct weston_pick_entry **entries;
+	struct weston_pick_entry *entry, *picked = NULL;
 	wl_fixed_t view_x, view_y;
-	int view_ix, view_iy;
-	int ix = wl_fixed_to_int(x);
-	int iy = wl_fixed_to_int(y);
+	size_t count, i;
 
-	wl_list_for_each(view, &compositor->view_list, link) {
-		if (!pixman_region32_contains_point(
-				&view->transform.boundingbox, ix, iy, NULL))
-			continue;
+	index = weston_pick_index_get(compositor);
+	if (!index ||
+	    !weston_pick_index_lookup(index,
+				      wl_fixed_to_int(x), wl_fixed_to_int(y),
+				      &entries, &count))
+		return weston_compositor_pick_view_linear(compositor, x, y,
+							  vx, vy);
 
-		weston_view_from_global_fixed(view, x, y, &view_x, &view_y);
-		view_ix = wl_fixed_to_int(view_x);
-		view_iy = wl_fixed_to_int(view_y);
+	for (i = 0; i < count; i++) {
+		entry = entries[i];
 
-		if (!pixman_region32_contains_point(&view->surface->input,
-						    view_ix, view_iy, NULL))
+		if (picked && entry->order > picked->order)
 			continue;
 
-		if (view->geometry.scissor_enabled &&
-		    !pixman_region32_contains_point(&view->geometry.scissor,
-						    view_ix, view_iy, NULL))
+		if (!weston_view_accepts_pick(entry->view, x, y,
+					      &view_x, &view_y))
 			continue;
 
+		picked = entry;
 		*vx = view_x;
 		*vy = view_y;
-		return view;
 	}
 
-	*vx = wl_fixed_from_int(-1000000);
-	*vy = wl_fixed_from_int(-1000000);
-	return NULL;
+	if (!picked) {
+		*vx = wl_fixed_from_int(-1000000);
+		*vy = wl_fixed_from_int(-1000000);
+		return NULL;
+	}
+
+	return picked->view;
 }
 
 static void
@@ -2025,6 +2096,7 @@ weston_view_unmap(struct weston_view *view)
 	weston_layer_entry_remove(&view->layer_link);
 	wl_list_remove(&view->link);
 	wl_list_init(&view->link);
+	weston_pick_index_remove_view(view);
 	view->output_mask = 0;
 	weston_surface_assign_output(view->surface);
 
@@ -2067,6 +2139,22 @@ weston_surface_reset_pending_buffer(struct weston_surface *surface)
 	surface->pending.buffer_viewport.changed = 0;
 }
 
+static void
+weston_surface_fence_wait_drop(struct weston_surface *surface)
+{
+	if (!surface->fence_wait.held)
+		return;
+
+	wl_event_source_remove(surface->fence_wait.source);
+	surface->fence_wait.source = NULL;
+	wl_list_remove(&surface->fence_wait.link);
+	wl_list_init(&surface->fence_wait.link);
+	surface->fence_wait.held = false;
+
+	weston_surface_state_fini(&surface->fence_wait.state);
+	weston_surface_state_init(&surface->fence_wait.state);
+}
+
 WL_EXPORT void
 weston_view_destroy(struct weston_view *view)
 {
@@ -2092,7 +2180,7 @@ weston_view_destroy(struct weston_view *view)
 
 	wl_list_remove(&view->surface_link);
 
-	free(view);
+	free(container_of(view, struct weston_view_internal, base));
 }
 
 WL_EXPORT void
@@ -2115,6 +2203,8 @@ weston_surface_destroy(struct weston_surface *surface)
 	wl_list_for_each_safe(ev, nv, &surface->views, surface_link)
 		weston_view_destroy(ev);
 
+	weston_surface_fence_wait_drop(surface);
+	weston_surface_state_fini(&surface->fence_wait.state);
 	weston_surface_state_fini(&surface->pending);
 
 	weston_buffer_reference(&surface->buffer_ref, NULL);
@@ -2159,6 +2249,10 @@ destroy_surface(struct wl_resource *resource)
 					  NULL);
 	}
 
+	/* A commit still waiting for its fence has no client left to
+	 * show it to. */
+	weston_surface_fence_wait_drop(surface);
+
 	weston_surface_destroy(surface);
 }
 
@@ -2574,8 +2668,10 @@ view_list_add(struct weston_compositor *compositor,
 static void
 weston_compositor_build_view_list(struct weston_compositor *compositor)
 {
+	struct weston_pick_index *index;
 	struct weston_view *view;
 	struct weston_layer *layer;
+	uint32_t order = 0;
 
 	wl_list_for_each(layer, &compositor->layer_list, link)
 		wl_list_for_each(view, &layer->view_list.link, layer_link.link)
@@ -2591,6 +2687,15 @@ weston_compositor_build_view_list(struct weston_compositor *compositor)
 	wl_list_for_each(layer, &compositor->layer_list, link)
 		wl_list_for_each(view, &layer->view_list.link, layer_link.link)
 			surface_free_unused_subsurface_views(view->surface);
+
+	index = weston_pick_index_get(compositor);
+	if (!index)
+		return;
+
+	weston_pick_index_begin_update(index);
+	wl_list_for_each(view, &compositor->view_list, link)
+		weston_pick_index_add_view(index, view, order++);
+	weston_pick_index_end_update(index);
 }
 
 static void
@@ -2618,10 +2723,14 @@ weston_output_take_feedback_list(struct weston_output *output,
 	wl_list_init(&surface->feedback_list);
 }
 
+static void
+weston_surface_fence_wait_flush(struct weston_surface *surface);
+
 static int
 weston_output_repaint(struct weston_output *output, void *repaint_data)
 {
 	struct weston_compositor *ec = output->compositor;
+	struct weston_surface *surface, *next_surface;
 	struct weston_view *ev;
 	struct weston_animation *animation, *next;
 	struct weston_frame_callback *cb, *cnext;
@@ -2636,6 +2745,18 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 
 	TL_POINT("core_repaint_begin", TLP_OUTPUT(output), TLP_END);
 
+	/* Latch held commits whose acquire fence signalled in time for this
+	 * repaint. The others keep their previous buffer on screen. */
+	wl_list_for_each_safe(surface, next_surface,
+			      &ec->fence_wait_list, fence_wait.link) {
+		int fd = surface->fence_wait.state.acquire_fence_fd;
+
+		if (linux_sync_file_is_signalled(fd))
+			weston_surface_fence_wait_flush(surface);
+		else if (surface->output_mask & (1u << output->id))
+			surface->fence_misses++;
+	}
+
 	/* Rebuild the surface list and update surface transforms up front. */
 	weston_compositor_build_view_list(ec);
 
@@ -3590,10 +3711,106 @@ weston_surface_commit_state(struct weston_surface *surface,
 	wl_signal_emit(&surface->commit_signal, surface);
 }
 
+static void
+weston_surface_fence_wait_flush(struct weston_surface *surface)
+{
+	if (!surface->fence_wait.held)
+		return;
+
+	wl_event_source_remove(surface->fence_wait.source);
+	surface->fence_wait.source = NULL;
+	wl_list_remove(&surface->fence_wait.link);
+	wl_list_init(&surface->fence_wait.link);
+	surface->fence_wait.held = false;
+
+	weston_surface_commit_state(surface, &surface->fence_wait.state);
+
+	weston_surface_schedule_repaint(surface);
+}
+
+static int
+surface_fence_wait_signalled(int fd, uint32_t mask, void *data)
+{
+	struct weston_surface *surface = data;
+
+	weston_surface_fence_wait_flush(surface);
+
+	return 0;
+}
+
+/* Hold the pending commit back if its acquire fence has not signalled yet,
+ * so that repaints keep showing the previous buffer instead of stalling
+ * on the client's rendering. Returns true if the commit was held.
+ */
+static bool
+weston_surface_fence_wait_hold(struct weston_surface *surface)
+{
+	struct weston_surface_state *pending = &surface->pending;
+	struct weston_surface_state *held = &surface->fence_wait.state;
+	struct wl_event_loop *loop;
+
+	if (!pending->newly_attached || pending->acquire_fence_fd < 0)
+		return false;
+
+	/* A parent and its sub-surfaces must latch together. */
+	if (!wl_list_empty(&surface->subsurface_list))
+		return false;
+
+	if (linux_sync_file_is_signalled(pending->acquire_fence_fd))
+		return false;
+
+	loop = wl_display_get_event_loop(surface->compositor->wl_display);
+	surface->fence_wait.source =
+		wl_event_loop_add_fd(loop, pending->acquire_fence_fd,
+				     WL_EVENT_READABLE,
+				     surface_fence_wait_signalled, surface);
+	if (!surface->fence_wait.source)
+		return false;
+
+	held->newly_attached = 1;
+	weston_surface_state_set_buffer(held, pending->buffer);
+	/* zwp_surface_synchronization_v1.set_acquire_fence */
+	fd_move(&held->acquire_fence_fd, &pending->acquire_fence_fd);
+	/* zwp_surface_synchronization_v1.get_release */
+	weston_buffer_release_move(&held->buffer_release_ref,
+				   &pending->buffer_release_ref);
+	held->sx = pending->sx;
+	held->sy = pending->sy;
+	held->buffer_viewport = pending->buffer_viewport;
+	held->desired_protection = pending->desired_protection;
+	held->protection_mode = pending->protection_mode;
+
+	pixman_region32_copy(&held->damage_surface, &pending->damage_surface);
+	pixman_region32_clear(&pending->damage_surface);
+	pixman_region32_copy(&held->damage_buffer, &pending->damage_buffer);
+	pixman_region32_clear(&pending->damage_buffer);
+	pixman_region32_copy(&held->opaque, &pending->opaque);
+	pixman_region32_copy(&held->input, &pending->input);
+
+	wl_list_insert_list(&held->frame_callback_list,
+			    &pending->frame_callback_list);
+	wl_list_init(&pending->frame_callback_list);
+
+	wl_list_insert_list(&held->feedback_list, &pending->feedback_list);
+	wl_list_init(&pending->feedback_list);
+
+	weston_surface_reset_pending_buffer(surface);
+
+	surface->fence_wait.held = true;
+	wl_list_insert(&surface->compositor->fence_wait_list,
+		       &surface->fence_wait.link);
+
+	return true;
+}
+
 static void
 weston_surface_commit(struct weston_surface *surface)
 {
-	weston_surface_commit_state(surface, &surface->pending);
+	/* Commits are applied in order, so an older held one goes first. */
+	weston_surface_fence_wait_flush(surface);
+
+	if (!weston_surface_fence_wait_hold(surface))
+		weston_surface_commit_state(surface, &surface->pending);
 
 	weston_surface_commit_subsurface_order(surface);
 
@@ -5801,6 +6018,9 @@ weston_output_init_geometry(struct weston_output *output, int x, int y)
 	pixman_region32_init_rect(&output->region, x, y,
 				  output->width,
 				  output->height);
+
+	weston_pick_index_outputs_changed(
+		weston_pick_index_get(output->compositor));
 }
 
 /**
@@ -5893,6 +6113,7 @@ weston_compositor_add_output(struct weston_compositor *compositor,
 	wl_list_remove(&output->link);
 	wl_list_insert(compositor->output_list.prev, &output->link);
 	output->enabled = true;
+	weston_pick_index_outputs_changed(weston_pick_index_get(compositor));
 
 	wl_list_for_each(head, &output->head_list, output_link)
 		weston_head_add_global(head);
@@ -5984,6 +6205,7 @@ weston_compositor_remove_output(struct weston_output *output)
 	wl_list_remove(&output->link);
 	wl_list_insert(compositor->pending_output_list.prev, &output->link);
 	output->enabled = false;
+	weston_pick_index_outputs_changed(weston_pick_index_get(compositor));
 
 	wl_signal_emit(&compositor->output_destroyed_signal, output);
 	wl_signal_emit(&output->destroy_signal, output);
@@ -7258,12 +7480,14 @@ weston_compositor_create(struct wl_display *display,
 			 struct weston_log_context *log_ctx,
 			 void *user_data)
 {
+	struct weston_compositor_internal *internal;
 	struct weston_compositor *ec;
 	struct wl_event_loop *loop;
 
-	ec = zalloc(sizeof *ec);
-	if (!ec)
+	internal = zalloc(sizeof *internal);
+	if (!internal)
 		return NULL;
+	ec = &internal->base;
 
 	ec->wl_display = display;
 	ec->user_data = user_data;
@@ -7289,6 +7513,8 @@ weston_compositor_create(struct wl_display *display,
 
 	ec->output_id_pool = 0;
 	ec->repaint_msec = DEFAULT_REPAINT_WINDOW;
+	ec->clipboard_max_size = DEFAULT_CLIPBOARD_MAX_SIZE;
+	ec->clipboard_max_total = DEFAULT_CLIPBOARD_MAX_TOTAL;
 
 	ec->activate_serial = 1;
 
@@ -7296,6 +7522,9 @@ weston_compositor_create(struct wl_display *display,
 
 	ec->content_protection = NULL;
 
+	if (weston_pick_index_create(ec) < 0)
+		goto fail;
+
 	if (!wl_global_create(ec->wl_display, &wl_compositor_interface, 4,
 			      ec, compositor_bind))
 		goto fail;
@@ -7323,6 +7552,7 @@ weston_compositor_create(struct wl_display *display,
 		goto fail;
 
 	wl_list_init(&ec->view_list);
+	wl_list_init(&ec->fence_wait_list);
 	wl_list_init(&ec->plane_list);
 	wl_list_init(&ec->layer_list);
 	wl_list_init(&ec->seat_list);
@@ -7370,7 +7600,8 @@ weston_compositor_create(struct wl_display *display,
 	return ec;
 
 fail:
-	free(ec);
+	weston_pick_index_destroy(weston_pick_index_get(ec));
+	free(internal);
 	return NULL;
 }
 
@@ -7403,6 +7634,8 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 	weston_binding_list_destroy_all(&ec->debug_binding_list);
 
 	weston_plane_release(&ec->primary_plane);
+
+	weston_pick_index_destroy(weston_pick_index_get(ec));
 }
 
 /** weston_compositor_exit_with_code
@@ -7705,7 +7938,8 @@ weston_compositor_tear_down(struct weston_compositor *compositor)
 WL_EXPORT void
 weston_compositor_destroy(struct weston_compositor *compositor)
 {
-	free(compositor);
+	free(container_of(compositor, struct weston_compositor_internal,
+			  base));
 }
 
 /** Instruct the compositor to exit.
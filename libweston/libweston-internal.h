@@ -64,6 +64,13 @@ weston_binding_list_destroy_all(struct wl_list *list);
 
 /* weston_compositor */
 
+/* What weston_compositor_create() allocates: the public struct followed by
+ * state that is not part of the API. */
+struct weston_compositor_internal {
+	struct weston_compositor base;
+	struct weston_pick_index *pick_index;
+};
+
 void
 touch_calibrator_mode_changed(struct weston_compositor *compositor);
 
@@ -269,6 +276,12 @@ weston_spring_update(struct weston_spring *spring, const struct timespec *time);
 
 /* weston_view */
 
+/* What weston_view_create() allocates, see weston_compositor_internal */
+struct weston_view_internal {
+	struct weston_view base;
+	struct weston_pick_entry *pick_entry;
+};
+
 void
 weston_view_to_global_fixed(struct weston_view *view,
 			    wl_fixed_t sx, wl_fixed_t sy,
@@ -57,6 +57,25 @@ linux_sync_file_is_valid(int fd)
 	return file_info.num_fences > 0;
 }
 
+/* Check whether all fences in a sync file have signalled, without blocking
+ *
+ * \param fd[in] a file descriptor for a sync file
+ * \return true if the sync file has signalled, or cannot be polled,
+ * false if it is still pending
+ */
+bool
+linux_sync_file_is_signalled(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int ret;
+
+	do {
+		ret = poll(&pfd, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret != 0;
+}
+
 /* Read the timestamp stored in a sync file
  *
  * \param fd[in] fd a file descriptor for a sync file
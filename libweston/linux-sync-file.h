@@ -32,6 +32,9 @@
 bool
 linux_sync_file_is_valid(int fd);
 
+bool
+linux_sync_file_is_signalled(int fd);
+
 int
 weston_linux_sync_file_read_timestamp(int fd, struct timespec *ts);
 
@@ -0,0 +1,442 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include <libweston/zalloc.h>
+#include "shared/helpers.h"
+#include "libweston-internal.h"
+#include "pick-index.h"
+
+/* 128x128 pixel cells; the shift grows if the output area would need
+ * more than PICK_MAX_CELLS of them. */
+#define PICK_CELL_SHIFT 7
+#define PICK_MAX_CELLS (64 * 1024)
+
+struct weston_pick_index {
+	struct weston_compositor *compositor;
+	struct wl_listener compositor_destroy_listener;
+	struct wl_list entry_list;	/* weston_pick_entry::link */
+	uint32_t generation;
+
+	/* A view of the current generation could not be added, lookups
+	 * fail until the next update. */
+	bool incomplete;
+
+	/* The grid is rebuilt lazily on the next lookup once the output
+	 * layout changes. While it is not valid, lookups fail and the
+	 * caller falls back to the linear scan. */
+	bool valid;
+	bool layout_dirty;
+	int32_t x, y;
+	int cols, rows;
+	int shift;
+	struct wl_array *cells;
+};
+
+static bool
+cell_range(struct weston_pick_index *index, const pixman_box32_t *box,
+	   int *c0, int *r0, int *c1, int *r1)
+{
+	int64_t x1, y1, x2, y2;
+
+	x1 = MAX((int64_t)box->x1, index->x);
+	y1 = MAX((int64_t)box->y1, index->y);
+	x2 = MIN((int64_t)box->x2,
+		 (int64_t)index->x + ((int64_t)index->cols << index->shift));
+	y2 = MIN((int64_t)box->y2,
+		 (int64_t)index->y + ((int64_t)index->rows << index->shift));
+
+	if (x1 >= x2 || y1 >= y2)
+		return false;
+
+	*c0 = (x1 - index->x) >> index->shift;
+	*r0 = (y1 - index->y) >> index->shift;
+	*c1 = (x2 - 1 - index->x) >> index->shift;
+	*r1 = (y2 - 1 - index->y) >> index->shift;
+
+	return true;
+}
+
+static void
+grid_invalidate(struct weston_pick_index *index)
+{
+	index->valid = false;
+	index->layout_dirty = true;
+}
+
+static void
+grid_insert(struct weston_pick_index *index, struct weston_pick_entry *entry)
+{
+	struct weston_pick_entry **slot;
+	int c0, r0, c1, r1, c, r;
+
+	if (!cell_range(index, &entry->box, &c0, &r0, &c1, &r1))
+		return;
+
+	for (r = r0; r <= r1; r++) {
+		for (c = c0; c <= c1; c++) {
+			slot = wl_array_add(&index->cells[r * index->cols + c],
+					    sizeof *slot);
+			if (!slot) {
+				grid_invalidate(index);
+				return;
+			}
+			*slot = entry;
+		}
+	}
+}
+
+static void
+grid_remove(struct weston_pick_index *index, struct weston_pick_entry *entry)
+{
+	struct weston_pick_entry **slots;
+	struct wl_array *cell;
+	size_t i, count;
+	int c0, r0, c1, r1, c, r;
+
+	if (!cell_range(index, &entry->box, &c0, &r0, &c1, &r1))
+		return;
+
+	for (r = r0; r <= r1; r++) {
+		for (c = c0; c <= c1; c++) {
+			cell = &index->cells[r * index->cols + c];
+			slots = cell->data;
+			count = cell->size / sizeof *slots;
+
+			for (i = 0; i < count; i++) {
+				if (slots[i] != entry)
+					continue;
+
+				/* order is kept per entry, so the cell
+				 * does not need to stay sorted */
+				slots[i] = slots[count - 1];
+				cell->size -= sizeof *slots;
+				break;
+			}
+		}
+	}
+}
+
+static void
+grid_release(struct weston_pick_index *index)
+{
+	int i;
+
+	for (i = 0; i < index->cols * index->rows; i++)
+		wl_array_release(&index->cells[i]);
+	free(index->cells);
+
+	index->cells = NULL;
+	index->cols = 0;
+	index->rows = 0;
+	index->valid = false;
+}
+
+static void
+grid_rebuild(struct weston_pick_index *index)
+{
+	struct weston_output *output;
+	struct weston_pick_entry *entry;
+	pixman_box32_t *box;
+	int64_t x1 = INT32_MAX, y1 = INT32_MAX;
+	int64_t x2 = INT32_MIN, y2 = INT32_MIN;
+	int64_t cols, rows;
+	int shift;
+
+	grid_release(index);
+	index->layout_dirty = false;
+
+	wl_list_for_each(output, &index->compositor->output_list, link) {
+		box = pixman_region32_extents(&output->region);
+		if (box->x1 >= box->x2 || box->y1 >= box->y2)
+			continue;
+
+		x1 = MIN(x1, box->x1);
+		y1 = MIN(y1, box->y1);
+		x2 = MAX(x2, box->x2);
+		y2 = MAX(y2, box->y2);
+	}
+
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	shift = PICK_CELL_SHIFT;
+	for (;;) {
+		cols = ((x2 - x1) + (1 << shift) - 1) >> shift;
+		rows = ((y2 - y1) + (1 << shift) - 1) >> shift;
+		if (cols * rows <= PICK_MAX_CELLS)
+			break;
+		shift++;
+	}
+
+	index->cells = calloc(cols * rows, sizeof *index->cells);
+	if (!index->cells)
+		return;
+
+	index->x = x1;
+	index->y = y1;
+	index->cols = cols;
+	index->rows = rows;
+	index->shift = shift;
+	index->valid = true;
+
+	wl_list_for_each(entry, &index->entry_list, link) {
+		grid_insert(index, entry);
+		if (!index->valid)
+			return;
+	}
+}
+
+static void
+pick_entry_destroy(struct weston_pick_entry *entry)
+{
+	struct weston_pick_index *index = entry->index;
+
+	if (index->valid)
+		grid_remove(index, entry);
+
+	container_of(entry->view, struct weston_view_internal,
+		     base)->pick_entry = NULL;
+	wl_list_remove(&entry->view_destroy_listener.link);
+	wl_list_remove(&entry->link);
+	free(entry);
+}
+
+static void
+pick_entry_handle_view_destroy(struct wl_listener *listener, void *data)
+{
+	struct weston_pick_entry *entry =
+		container_of(listener, struct weston_pick_entry,
+			     view_destroy_listener);
+
+	pick_entry_destroy(entry);
+}
+
+static struct weston_pick_entry *
+pick_entry_get(struct weston_view *view)
+{
+	return container_of(view, struct weston_view_internal,
+			    base)->pick_entry;
+}
+
+static void
+pick_index_handle_compositor_destroy(struct wl_listener *listener,
+				     void *data)
+{
+	struct weston_pick_index *index =
+		container_of(listener, struct weston_pick_index,
+			     compositor_destroy_listener);
+
+	weston_pick_index_destroy(index);
+}
+
+/** Create the pick index of a compositor. It is destroyed with the
+ * compositor unless weston_pick_index_destroy() is called earlier. */
+int
+weston_pick_index_create(struct weston_compositor *compositor)
+{
+	struct weston_pick_index *index;
+
+	index = zalloc(sizeof *index);
+	if (!index)
+		return -1;
+
+	index->compositor = compositor;
+	wl_list_init(&index->entry_list);
+	index->layout_dirty = true;
+
+	index->compositor_destroy_listener.notify =
+		pick_index_handle_compositor_destroy;
+	wl_signal_add(&compositor->destroy_signal,
+		      &index->compositor_destroy_listener);
+
+	container_of(compositor, struct weston_compositor_internal,
+		     base)->pick_index = index;
+
+	return 0;
+}
+
+/** Return the pick index of a compositor, or NULL if it has none. */
+struct weston_pick_index *
+weston_pick_index_get(struct weston_compositor *compositor)
+{
+	return container_of(compositor, struct weston_compositor_internal,
+			    base)->pick_index;
+}
+
+void
+weston_pick_index_destroy(struct weston_pick_index *index)
+{
+	struct weston_pick_entry *entry, *next;
+
+	if (!index)
+		return;
+
+	grid_release(index);
+
+	wl_list_for_each_safe(entry, next, &index->entry_list, link)
+		pick_entry_destroy(entry);
+
+	container_of(index->compositor, struct weston_compositor_internal,
+		     base)->pick_index = NULL;
+	wl_list_remove(&index->compositor_destroy_listener.link);
+	free(index);
+}
+
+/** Schedule a grid rebuild after an output was added, moved, resized
+ * or removed. */
+void
+weston_pick_index_outputs_changed(struct weston_pick_index *index)
+{
+	if (index)
+		grid_invalidate(index);
+}
+
+/** Start mirroring a freshly built compositor view list. Every view on
+ * the list must then be passed to weston_pick_index_add_view() in list
+ * order before weston_pick_index_end_update() drops the views that are
+ * no longer part of it. */
+void
+weston_pick_index_begin_update(struct weston_pick_index *index)
+{
+	index->generation++;
+	index->incomplete = false;
+}
+
+void
+weston_pick_index_add_view(struct weston_pick_index *index,
+			   struct weston_view *view, uint32_t order)
+{
+	struct weston_pick_entry *entry;
+
+	entry = pick_entry_get(view);
+	if (!entry) {
+		entry = zalloc(sizeof *entry);
+		if (!entry) {
+			index->incomplete = true;
+			return;
+		}
+
+		entry->view = view;
+		entry->index = index;
+		entry->box =
+			*pixman_region32_extents(&view->transform.boundingbox);
+		entry->view_destroy_listener.notify =
+			pick_entry_handle_view_destroy;
+		wl_signal_add(&view->destroy_signal,
+			      &entry->view_destroy_listener);
+		container_of(view, struct weston_view_internal,
+			     base)->pick_entry = entry;
+		wl_list_insert(index->entry_list.prev, &entry->link);
+
+		if (index->valid)
+			grid_insert(index, entry);
+	}
+
+	entry->order = order;
+	entry->generation = index->generation;
+}
+
+void
+weston_pick_index_end_update(struct weston_pick_index *index)
+{
+	struct weston_pick_entry *entry, *next;
+
+	wl_list_for_each_safe(entry, next, &index->entry_list, link) {
+		if (entry->generation != index->generation)
+			pick_entry_destroy(entry);
+	}
+}
+
+/** Move an indexed view to the cells of its current bounding box. */
+void
+weston_pick_index_update_view(struct weston_view *view)
+{
+	struct weston_pick_entry *entry;
+	struct weston_pick_index *index;
+	pixman_box32_t *box;
+
+	entry = pick_entry_get(view);
+	if (!entry)
+		return;
+
+	index = entry->index;
+	box = pixman_region32_extents(&view->transform.boundingbox);
+	if (box->x1 == entry->box.x1 && box->y1 == entry->box.y1 &&
+	    box->x2 == entry->box.x2 && box->y2 == entry->box.y2)
+		return;
+
+	if (index->valid)
+		grid_remove(index, entry);
+
+	entry->box = *box;
+
+	if (index->valid)
+		grid_insert(index, entry);
+}
+
+void
+weston_pick_index_remove_view(struct weston_view *view)
+{
+	struct weston_pick_entry *entry;
+
+	entry = pick_entry_get(view);
+	if (entry)
+		pick_entry_destroy(entry);
+}
+
+/** Return the entries whose bounding box may contain the given point, in
+ * no particular order; use weston_pick_entry::order to restore the view
+ * list stacking order. Returns false when the point is not covered by
+ * the grid, in which case the caller has to scan the view list. */
+bool
+weston_pick_index_lookup(struct weston_pick_index *index, int32_t x, int32_t y,
+			 struct weston_pick_entry ***entries, size_t *count)
+{
+	struct wl_array *cell;
+	int64_t c, r;
+
+	if (index->layout_dirty)
+		grid_rebuild(index);
+
+	if (!index->valid || index->incomplete)
+		return false;
+
+	c = ((int64_t)x - index->x) >> index->shift;
+	r = ((int64_t)y - index->y) >> index->shift;
+	if (x < index->x || y < index->y || c >= index->cols || r >= index->rows)
+		return false;
+
+	cell = &index->cells[r * index->cols + c];
+	*entries = cell->data;
+	*count = cell->size / sizeof **entries;
+
+	return true;
+}
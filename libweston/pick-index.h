@@ -0,0 +1,96 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_PICK_INDEX_H
+#define WESTON_PICK_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pixman.h>
+#include <wayland-server-core.h>
+
+struct weston_compositor;
+struct weston_view;
+struct weston_pick_index;
+
+/*
+ * Uniform grid over the area covered by the enabled outputs, used by
+ * weston_compositor_pick_view() to find the views under a point without
+ * walking the whole view list. The index mirrors the compositor view
+ * list: views enter it when the list is rebuilt, follow their bounding
+ * box through weston_view_update_transform() and leave it when they are
+ * unmapped, destroyed or dropped from the list.
+ *
+ * The index and its per-view entries are private to libweston: the
+ * pointers to them live in weston_compositor_internal and
+ * weston_view_internal, not in the public structs. The index is freed
+ * with the compositor and each entry with its view.
+ */
+
+struct weston_pick_entry {
+	struct weston_view *view;
+	struct weston_pick_index *index;
+	struct wl_listener view_destroy_listener;
+	struct wl_list link;		/* weston_pick_index::entry_list */
+	pixman_box32_t box;		/* indexed boundingbox extents */
+	uint32_t order;			/* position in the view list */
+	uint32_t generation;
+};
+
+int
+weston_pick_index_create(struct weston_compositor *compositor);
+
+struct weston_pick_index *
+weston_pick_index_get(struct weston_compositor *compositor);
+
+void
+weston_pick_index_destroy(struct weston_pick_index *index);
+
+void
+weston_pick_index_outputs_changed(struct weston_pick_index *index);
+
+void
+weston_pick_index_begin_update(struct weston_pick_index *index);
+
+void
+weston_pick_index_add_view(struct weston_pick_index *index,
+			   struct weston_view *view, uint32_t order);
+
+void
+weston_pick_index_end_update(struct weston_pick_index *index);
+
+void
+weston_pick_index_update_view(struct weston_view *view);
+
+void
+weston_pick_index_remove_view(struct weston_view *view);
+
+bool
+weston_pick_index_lookup(struct weston_pick_index *index, int32_t x, int32_t y,
+			 struct weston_pick_entry ***entries, size_t *count);
+
+#endif /* WESTON_PICK_INDEX_H */
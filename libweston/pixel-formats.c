@@ -26,9 +26,12 @@
 
 #include "config.h"
 
+#include <assert.h>
 #include <endian.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <drm_fourcc.h>
@@ -376,6 +379,58 @@ static const struct pixel_format_info pixel_format_table[] = {
 	},
 };
 
+/*
+ * Lookup indices over pixel_format_table, built once on first use. The
+ * fourcc index is an open-addressed hash table holding table index + 1,
+ * with 0 marking an empty slot. The name index holds table indices sorted
+ * by case-insensitive DRM format name.
+ */
+#define PIXEL_FORMAT_HASH_BITS 7
+#define PIXEL_FORMAT_HASH_SIZE (1u << PIXEL_FORMAT_HASH_BITS)
+
+/* Keep the hash table at most half full so probe chains stay short. */
+static_assert(ARRAY_LENGTH(pixel_format_table) * 2 <= PIXEL_FORMAT_HASH_SIZE,
+	      "pixel format hash table too small");
+
+static uint8_t pixel_format_hash[PIXEL_FORMAT_HASH_SIZE];
+static uint8_t pixel_format_by_name[ARRAY_LENGTH(pixel_format_table)];
+static pthread_once_t pixel_format_index_once = PTHREAD_ONCE_INIT;
+
+static unsigned int
+pixel_format_hash_slot(uint32_t format)
+{
+	/* Fibonacci hashing: fourccs share most of their bits. */
+	return (format * 0x9e3779b1u) >> (32 - PIXEL_FORMAT_HASH_BITS);
+}
+
+static int
+pixel_format_name_compare(const void *a, const void *b)
+{
+	const uint8_t *index_a = a;
+	const uint8_t *index_b = b;
+
+	return strcasecmp(pixel_format_table[*index_a].drm_format_name,
+			  pixel_format_table[*index_b].drm_format_name);
+}
+
+static void
+pixel_format_index_init(void)
+{
+	unsigned int i, slot;
+
+	for (i = 0; i < ARRAY_LENGTH(pixel_format_table); i++) {
+		slot = pixel_format_hash_slot(pixel_format_table[i].format);
+		while (pixel_format_hash[slot] != 0)
+			slot = (slot + 1) % PIXEL_FORMAT_HASH_SIZE;
+		pixel_format_hash[slot] = i + 1;
+
+		pixel_format_by_name[i] = i;
+	}
+
+	qsort(pixel_format_by_name, ARRAY_LENGTH(pixel_format_by_name),
+	      sizeof pixel_format_by_name[0], pixel_format_name_compare);
+}
+
 WL_EXPORT const struct pixel_format_info *
 pixel_format_get_info_shm(uint32_t format)
 {
@@ -390,11 +445,17 @@ pixel_format_get_info_shm(uint32_t format)
 WL_EXPORT const struct pixel_format_info *
 pixel_format_get_info(uint32_t format)
 {
-	unsigned int i;
+	const struct pixel_format_info *info;
+	unsigned int slot;
 
-	for (i = 0; i < ARRAY_LENGTH(pixel_format_table); i++) {
-		if (pixel_format_table[i].format == format)
-			return &pixel_format_table[i];
+	pthread_once(&pixel_format_index_once, pixel_format_index_init);
+
+	slot = pixel_format_hash_slot(format);
+	while (pixel_format_hash[slot] != 0) {
+		info = &pixel_format_table[pixel_format_hash[slot] - 1];
+		if (info->format == format)
+			return info;
+		slot = (slot + 1) % PIXEL_FORMAT_HASH_SIZE;
 	}
 
 	return NULL;
@@ -404,12 +465,23 @@ WL_EXPORT const struct pixel_format_info *
 pixel_format_get_info_by_drm_name(const char *drm_format_name)
 {
 	const struct pixel_format_info *info;
-	unsigned int i;
+	unsigned int low = 0;
+	unsigned int high = ARRAY_LENGTH(pixel_format_by_name);
+	unsigned int mid;
+	int cmp;
 
-	for (i = 0; i < ARRAY_LENGTH(pixel_format_table); i++) {
-		info = &pixel_format_table[i];
-		if (strcasecmp(info->drm_format_name, drm_format_name) == 0)
+	pthread_once(&pixel_format_index_once, pixel_format_index_init);
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		info = &pixel_format_table[pixel_format_by_name[mid]];
+		cmp = strcasecmp(drm_format_name, info->drm_format_name);
+		if (cmp == 0)
 			return info;
+		if (cmp < 0)
+			high = mid;
+		else
+			low = mid + 1;
 	}
 
 	return NULL;
@@ -36,6 +36,8 @@
 
 #include <glib.h>
 
+struct spug_frame_arena;
+
 /*
  * Plugin framework information (singleton)
  */
@@ -91,12 +93,15 @@ struct {
 	spug_bool lists_initialised;
 	spug_bool config_err;
 	void *spug_ids[SPUG_WRAPPER_SIZE];
+	int spug_ids_capacity[SPUG_WRAPPER_SIZE];
 	GHashTable *spug_hashtables[SPUG_WRAPPER_SIZE];
 	struct wl_list output_node_list;
 
-	/* keep track of lists allocated to a plugin using spug_filter_view_list(),
-	these will be freed at the end of spug_draw() */
-	struct wl_list allocated_lists;
+	/* arenas backing the lists handed out by spug_filter_view_list(), one
+	 * per output plus one for plugins drawing outside of a repaint. The one
+	 * for the output being repainted is frame_arena */
+	struct wl_list frame_arenas;
+	struct spug_frame_arena *frame_arena;
 } *framework;
 
 struct spug_renderer_interface {
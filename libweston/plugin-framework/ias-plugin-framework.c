@@ -1908,8 +1908,8 @@ WL_EXPORT int wet_module_init(struct weston_compositor *compositor,int *argc, ch
 	/* Initialize plugin list */
 	wl_list_init(&framework->plugin_list);
 
-	/* Initialize list to track allocated lists */
-	wl_list_init(&framework->allocated_lists);
+	/* Initialize list of per-output frame arenas */
+	wl_list_init(&framework->frame_arenas);
 
 	/* Initialize layout change callback list */
 	wl_list_init(&framework->layout_change_callbacks);
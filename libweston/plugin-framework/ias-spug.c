@@ -31,12 +31,14 @@
  *-----------------------------------------------------------------------------
  */
 #include <ias-common.h>
+#include <stddef.h>
 #include <string.h>
 #include <glib.h>
 #include <inttypes.h>
 #include <libweston-internal.h>
 
 #include "ias-plugin-framework-private.h"
+#include "shared/frame-arena.h"
 
 struct plugin_output_node {
 
@@ -61,31 +63,146 @@ _spug_global_destroy(gpointer data);
 static void
 update_spug_ids(enum spug_wrapper_type table, spug_id** ids)
 {
-	GList *cur, *head;
-	int num_values, i = 0;
+	GHashTableIter iter;
+	gpointer key;
+	int num_values, capacity, i = 0;
 	spug_id *id_arr;
 
-	/* regenerate list of view ids */
-	if(*ids) {
-		free(*ids);
-	}
+	/* regenerate list of view ids. The array is only reallocated when the
+	 * table outgrows it, wrappers come and go far more often than the
+	 * number of them changes much */
+	num_values = g_hash_table_size(framework->spug_hashtables[table]);
 
-	head = g_hash_table_get_keys(framework->spug_hashtables[table]);
-	num_values = g_list_length(head);
+	if(!*ids || num_values + 1 > framework->spug_ids_capacity[table]) {
+		capacity = framework->spug_ids_capacity[table];
+		if(capacity < 16) {
+			capacity = 16;
+		}
+		while(capacity < num_values + 1) {
+			capacity *= 2;
+		}
 
-	(*ids) = calloc(num_values + 1, sizeof(spug_id));
-        if ((*ids) == NULL) {
-		IAS_ERROR("Memory Allocation failure \n");
-		return;
+		id_arr = realloc(*ids, capacity * sizeof(spug_id));
+		if (id_arr == NULL) {
+			IAS_ERROR("Memory Allocation failure \n");
+			return;
+		}
+
+		(*ids) = id_arr;
+		framework->spug_ids_capacity[table] = capacity;
 	}
 
-	cur = head;
 	id_arr = *ids;
-	while(i < num_values) {
-		id_arr[i++] = (spug_id)cur->data;
-		cur = cur->next;
+	g_hash_table_iter_init(&iter, framework->spug_hashtables[table]);
+	while(g_hash_table_iter_next(&iter, &key, NULL)) {
+		id_arr[i++] = (spug_id)key;
 	}
-	g_list_free(head);
+	id_arr[i] = 0;
+}
+
+/*
+ * Per-output frame arena backing the view lists handed out to a layout
+ * plugin while it draws. Everything is released in one go when the output
+ * finishes its frame, see shared/frame-arena.h.
+ */
+struct spug_frame_arena {
+	/* NULL for the arena used by plugins drawing outside of a repaint */
+	struct weston_output *output;
+	struct wl_listener output_destroy_listener;
+
+	struct frame_arena arena;
+
+	struct wl_list link;
+};
+
+static void *
+spug_frame_arena_alloc(struct spug_frame_arena *arena, size_t size)
+{
+	return frame_arena_alloc(&arena->arena, size);
+}
+
+static void
+spug_frame_arena_reset(struct spug_frame_arena *arena)
+{
+	frame_arena_reset(&arena->arena);
+}
+
+static void
+spug_frame_arena_destroy(struct spug_frame_arena *arena)
+{
+	if(arena->output) {
+		wl_list_remove(&arena->output_destroy_listener.link);
+	}
+	wl_list_remove(&arena->link);
+	frame_arena_release(&arena->arena);
+	free(arena);
+}
+
+static void
+spug_frame_arena_output_destroyed(struct wl_listener *listener, void *data)
+{
+	struct spug_frame_arena *arena =
+		container_of(listener, struct spug_frame_arena,
+				output_destroy_listener);
+
+	if(framework->frame_arena == arena) {
+		framework->frame_arena = NULL;
+	}
+	spug_frame_arena_destroy(arena);
+}
+
+static struct spug_frame_arena *
+spug_find_frame_arena(struct weston_output *output)
+{
+	struct spug_frame_arena *arena;
+
+	wl_list_for_each(arena, &framework->frame_arenas, link) {
+		if(arena->output == output) {
+			return arena;
+		}
+	}
+
+	return NULL;
+}
+
+static struct spug_frame_arena *
+spug_get_frame_arena(struct weston_output *output)
+{
+	struct spug_frame_arena *arena;
+
+	arena = spug_find_frame_arena(output);
+	if(arena) {
+		return arena;
+	}
+
+	arena = calloc(1, sizeof(struct spug_frame_arena));
+	if(!arena) {
+		IAS_ERROR("Failed to create frame arena: out of memory\n");
+		return NULL;
+	}
+
+	arena->output = output;
+	frame_arena_init(&arena->arena);
+	if(output) {
+		arena->output_destroy_listener.notify =
+				spug_frame_arena_output_destroyed;
+		wl_signal_add(&output->destroy_signal,
+				&arena->output_destroy_listener);
+	}
+	wl_list_insert(&framework->frame_arenas, &arena->link);
+
+	return arena;
+}
+
+static void
+spug_destroy_frame_arenas(void)
+{
+	struct spug_frame_arena *arena, *tmp;
+
+	wl_list_for_each_safe(arena, tmp, &framework->frame_arenas, link) {
+		spug_frame_arena_destroy(arena);
+	}
+	framework->frame_arena = NULL;
 }
 
 static gpointer
@@ -1386,22 +1503,58 @@ spug_view_get_trans_boundingbox(const spug_view_id view_id)
 	return &sview->view->transform.boundingbox;
 }
 
+/* copied lists belong to the plugin and usually outlive the frame, so they
+ * can't come from the frame arena. Instead a copy remembers how much room it
+ * has, and copying into the same list again reuses it unless src has grown */
+struct spug_view_list_copy {
+	int capacity;
+	spug_view_id ids[];
+};
+
+static struct spug_view_list_copy *
+spug_view_list_copy_from_list(spug_view_list list)
+{
+	return (struct spug_view_list_copy *)((char *)list -
+			offsetof(struct spug_view_list_copy, ids));
+}
+
 WL_EXPORT void
 spug_copy_view_list(spug_view_list *dst, spug_view_list src)
 {
-	int i, length;
+	struct spug_view_list_copy *copy = NULL, *grown;
+	int i, length, capacity;
+
 	if(src && dst) {
 		if(*dst) {
-			free(*dst);
+			copy = spug_view_list_copy_from_list(*dst);
 		}
 
 		length = spug_view_list_length(src);
 
-		*dst = calloc(1, sizeof(spug_view_id) * length + 1);
+		if(!copy || copy->capacity < length + 1) {
+			capacity = copy ? copy->capacity : 16;
+			while(capacity < length + 1) {
+				capacity *= 2;
+			}
+
+			grown = realloc(copy, sizeof(*copy) +
+					capacity * sizeof(spug_view_id));
+			if(!grown) {
+				IAS_ERROR("Failed to copy list: out of memory \n");
+				free(copy);
+				*dst = NULL;
+				return;
+			}
+
+			copy = grown;
+			copy->capacity = capacity;
+			*dst = copy->ids;
+		}
 
 		for(i = 0; i < length; i++) {
 			(*dst)[i] = src[i];
 		}
+		(*dst)[length] = 0;
 	}
 }
 
@@ -1409,7 +1562,8 @@ WL_EXPORT void
 spug_release_view_list(spug_view_list *view_list)
 {
 	if(*view_list) {
-		free(*view_list);
+		free(spug_view_list_copy_from_list(*view_list));
+		*view_list = NULL;
 	}
 }
 
@@ -1429,48 +1583,58 @@ spug_filter_view_list(	spug_view_list view_list,
 {
 	spug_view_list filtered_list;
 	spug_view_list old_list = (spug_view_id *)view_list;
-	int i=0, filtered_i=0;
-	struct spug_allocated_list *alloc_list;
+	int i=0, filtered_i=0, length;
+	struct spug_frame_arena *arena;
 
 	if(!view_list || !view_filter || max_views < 1) {
 		return NULL;
 	}
 
-	filtered_list = calloc(1, sizeof(spug_view_id) *
-					spug_view_list_length(view_list) + 1);
-
-	if (filtered_list == NULL) {
-		IAS_ERROR("Failed to create list: out of memory \n");
-		return NULL;
+	/* the list lives until the end of the frame being drawn, or until the
+	 * next spug_draw() if the plugin is not drawing an output right now */
+	arena = framework->frame_arena;
+	if(!arena) {
+		arena = spug_get_frame_arena(NULL);
+		if(!arena) {
+			return NULL;
+		}
 	}
 
-	/* keep track of lists being allocated above to ensure we do not leak this memory. */
-	alloc_list = calloc(1, sizeof(struct spug_allocated_list));
-	if (alloc_list == NULL) {
+	length = MIN(spug_view_list_length(view_list), max_views);
+	filtered_list = spug_frame_arena_alloc(arena,
+					sizeof(spug_view_id) * (length + 1));
+
+	if (filtered_list == NULL) {
 		IAS_ERROR("Failed to create list: out of memory \n");
-		free(filtered_list);
 		return NULL;
 	}
 
-	alloc_list->allocated_list = filtered_list;
-	wl_list_init(&alloc_list->link);
-	wl_list_insert(&framework->allocated_lists, &alloc_list->link);
-
-	while(old_list[i]) {
+	while(old_list[i] && filtered_i < max_views) {
 		/* the plugin's filter function should return true if it wants
 		 * to keep the view, so add it to the filtered list */
 		if(view_filter(old_list[i], view_list)) {
 			filtered_list[filtered_i++] = old_list[i];
 		}
-		if(filtered_i == max_views)	{
-			break;
-		}
 		i++;
 	}
+	filtered_list[filtered_i] = 0;
 
 	return filtered_list;
 }
 
+WL_EXPORT size_t
+spug_get_frame_arena_high_water(const spug_output_id output_id)
+{
+	struct spug_frame_arena *arena;
+
+	arena = spug_find_frame_arena((struct weston_output *)output_id);
+	if(!arena) {
+		return 0;
+	}
+
+	return arena->arena.high_water;
+}
+
 WL_EXPORT void
 spug_list_init(spug_list *list)
 {
@@ -1606,12 +1770,15 @@ spug_draw(	spug_view_list view_list,
 		view_draw_clean_state();
 	}
 
-	/* Cleanup the lists allocated by spug_filter_view_list() */
-	struct spug_allocated_list *alloc_list, *tmp;
-	wl_list_for_each_safe(alloc_list, tmp, &framework->allocated_lists, link) {
-		spug_release_view_list(&alloc_list->allocated_list);
-		wl_list_remove(&alloc_list->link);
-		free(alloc_list);
+	/* Lists filtered while drawing an output stay valid until the end of
+	 * its frame. Outside of a repaint there is no frame to wait for, so
+	 * release them now */
+	if(!framework->frame_arena) {
+		struct spug_frame_arena *arena = spug_find_frame_arena(NULL);
+
+		if(arena) {
+			spug_frame_arena_reset(arena);
+		}
 	}
 }
 
@@ -2830,8 +2997,16 @@ spug_renderer_repaint_output(struct weston_output *output,
 
 	spug_update_all_lists();
 
+	framework->frame_arena = spug_get_frame_arena(output);
+
 	ioutput->plugin->info.draw(framework->spug_view_ids);
 
+	/* the frame is done, hand back everything filtered for it */
+	if(framework->frame_arena) {
+		spug_frame_arena_reset(framework->frame_arena);
+		framework->frame_arena = NULL;
+	}
+
 	/* do we need to do anything with output_damage? perhaps pass it to the
 	 * layout plugin so it can decide what to update */
 }
@@ -2865,6 +3040,7 @@ static void
 spug_renderer_destroy(struct weston_compositor *ec)
 {
 	spug_destroy_all_lists();
+	spug_destroy_frame_arenas();
 }
 
 static void
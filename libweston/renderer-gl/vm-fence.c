@@ -0,0 +1,164 @@
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libweston/zalloc.h>
+#include "vm-fence.h"
+
+struct vm_fence {
+	struct vm_fence_wait *wait;
+	struct wl_list link; /* vm_fence_wait::fence_list */
+	struct wl_event_source *source;
+	int fd;
+};
+
+struct vm_fence_wait {
+	struct wl_event_loop *loop;
+	struct wl_list fence_list;
+	int pending;
+	int armed;
+
+	vm_fence_done_func_t done;
+	void *data;
+};
+
+static int
+fence_is_signalled(int fd)
+{
+	struct pollfd pfd = {
+		.fd = fd,
+		.events = POLLIN,
+	};
+	int ret;
+
+	do {
+		ret = poll(&pfd, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	/* Treat errors as signalled, nobody would ever wake us up for them */
+	return ret != 0;
+}
+
+static void
+fence_destroy(struct vm_fence *fence)
+{
+	wl_event_source_remove(fence->source);
+	wl_list_remove(&fence->link);
+	close(fence->fd);
+	free(fence);
+}
+
+static void
+fence_wait_check_done(struct vm_fence_wait *wait)
+{
+	if (!wait->armed || wait->pending > 0)
+		return;
+
+	/* Only report once, the callback is free to destroy the wait */
+	wait->armed = 0;
+	wait->done(wait, wait->data);
+}
+
+static int
+fence_signalled(int fd, uint32_t mask, void *data)
+{
+	struct vm_fence *fence = data;
+	struct vm_fence_wait *wait = fence->wait;
+
+	fence_destroy(fence);
+	wait->pending--;
+	fence_wait_check_done(wait);
+
+	return 0;
+}
+
+struct vm_fence_wait *
+vm_fence_wait_create(struct wl_event_loop *loop,
+		     vm_fence_done_func_t done, void *data)
+{
+	struct vm_fence_wait *wait;
+
+	wait = zalloc(sizeof *wait);
+	if (!wait)
+		return NULL;
+
+	wait->loop = loop;
+	wait->done = done;
+	wait->data = data;
+	wl_list_init(&wait->fence_list);
+
+	return wait;
+}
+
+/*
+ * Takes ownership of fence_fd. Fences that already signalled are dropped
+ * right away and never reach the event loop.
+ */
+int
+vm_fence_wait_add(struct vm_fence_wait *wait, int fence_fd)
+{
+	struct vm_fence *fence;
+
+	if (fence_fd < 0)
+		return -1;
+
+	if (fence_is_signalled(fence_fd)) {
+		close(fence_fd);
+		return 0;
+	}
+
+	fence = zalloc(sizeof *fence);
+	if (!fence) {
+		close(fence_fd);
+		return -1;
+	}
+
+	fence->wait = wait;
+	fence->fd = fence_fd;
+	fence->source = wl_event_loop_add_fd(wait->loop, fence_fd,
+					     WL_EVENT_READABLE,
+					     fence_signalled, fence);
+	if (!fence->source) {
+		close(fence_fd);
+		free(fence);
+		return -1;
+	}
+
+	wl_list_insert(&wait->fence_list, &fence->link);
+	wait->pending++;
+
+	return 0;
+}
+
+/*
+ * No more fences will be added. If all of them already signalled the done
+ * callback is called before this returns.
+ */
+void
+vm_fence_wait_arm(struct vm_fence_wait *wait)
+{
+	wait->armed = 1;
+	fence_wait_check_done(wait);
+}
+
+int
+vm_fence_wait_pending(struct vm_fence_wait *wait)
+{
+	return wait->pending;
+}
+
+void
+vm_fence_wait_destroy(struct vm_fence_wait *wait)
+{
+	struct vm_fence *fence, *tmp;
+
+	if (!wait)
+		return;
+
+	wl_list_for_each_safe(fence, tmp, &wait->fence_list, link)
+		fence_destroy(fence);
+	free(wait);
+}
@@ -0,0 +1,30 @@
+#ifndef __VM_FENCE_H__
+#define __VM_FENCE_H__
+
+#include <wayland-server-core.h>
+
+/*
+ * Waits for a group of fences from the compositor event loop. Any fd that
+ * becomes readable once the GPU work behind it is done can be used: a
+ * sync_file, or a dma-buf fd for its implicit write fence. The done
+ * callback runs exactly once, after every fence of the group signalled
+ * and vm_fence_wait_arm() was called; it is never called after
+ * vm_fence_wait_destroy().
+ */
+struct vm_fence_wait;
+
+typedef void (*vm_fence_done_func_t)(struct vm_fence_wait *wait, void *data);
+
+struct vm_fence_wait *
+vm_fence_wait_create(struct wl_event_loop *loop,
+		     vm_fence_done_func_t done, void *data);
+int
+vm_fence_wait_add(struct vm_fence_wait *wait, int fence_fd);
+void
+vm_fence_wait_arm(struct vm_fence_wait *wait);
+int
+vm_fence_wait_pending(struct vm_fence_wait *wait);
+void
+vm_fence_wait_destroy(struct vm_fence_wait *wait);
+
+#endif /* __VM_FENCE_H__ */
@@ -0,0 +1,291 @@
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <libweston/libweston.h>
+#include <libweston/zalloc.h>
+#include "vm-shared.h"
+#include "vm-sender.h"
+
+/* How long the sender thread waits before retrying a channel that has
+ * no room or would block, in milliseconds. */
+#define VM_SENDER_RETRY_MS 1
+
+/*
+ * Lock-free triple buffer. The compositor always owns 'write', the sender
+ * thread always owns 'read' and the third buffer is parked in 'pending'.
+ * Swapping 'write' with 'pending' publishes a table and hands back either
+ * a free buffer or the stale, never sent, previous table.
+ */
+#define VM_SLOT_NEW 4
+#define VM_SLOT_INDEX(v) ((v) & 3)
+
+struct vm_sender_slot {
+	char *buf[3];
+	int len[3];
+	int write;
+	int read;
+	atomic_int pending;
+};
+
+struct vm_sender {
+	struct hyper_communication_interface *comm;
+	int buffer_size;
+
+	struct vm_sender_slot slots[VM_MAX_OUTPUTS + 1];
+
+	pthread_t sender_thread;
+	int wake_fd;
+	atomic_int destroying;
+
+	/* table currently being written out by the sender thread */
+	int cur_output;
+	int cur_offset;
+
+	atomic_uint frames_sent;
+	atomic_uint frames_replaced;
+	atomic_uint frames_dropped;
+};
+
+static void *
+sender_thread_function(void *data);
+
+static void
+sender_wake(struct vm_sender *sender)
+{
+	uint64_t one = 1;
+
+	/* eventfd writes never block unless the counter overflows */
+	if (write(sender->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		weston_log("vm: failed to wake metadata sender: %m\n");
+}
+
+static int
+slot_take(struct vm_sender_slot *slot)
+{
+	int prev;
+
+	if (!(atomic_load(&slot->pending) & VM_SLOT_NEW))
+		return 0;
+
+	prev = atomic_exchange(&slot->pending, slot->read);
+	slot->read = VM_SLOT_INDEX(prev);
+
+	return 1;
+}
+
+struct vm_sender *
+vm_sender_create(struct hyper_communication_interface *comm, int buffer_size)
+{
+	struct vm_sender *sender;
+	int i, j;
+
+	sender = zalloc(sizeof *sender);
+	if (!sender)
+		return NULL;
+
+	sender->comm = comm;
+	sender->buffer_size = buffer_size;
+	sender->cur_output = -1;
+
+	for (i = 0; i <= VM_MAX_OUTPUTS; i++) {
+		struct vm_sender_slot *slot = &sender->slots[i];
+
+		for (j = 0; j < 3; j++) {
+			slot->buf[j] = malloc(buffer_size);
+			if (!slot->buf[j])
+				goto err_buffers;
+		}
+		slot->write = 0;
+		atomic_init(&slot->pending, 1);
+		slot->read = 2;
+	}
+
+	sender->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (sender->wake_fd < 0)
+		goto err_buffers;
+
+	if (pthread_create(&sender->sender_thread, NULL,
+			   sender_thread_function, sender) != 0) {
+		close(sender->wake_fd);
+		goto err_buffers;
+	}
+
+	return sender;
+
+err_buffers:
+	for (i = 0; i <= VM_MAX_OUTPUTS; i++)
+		for (j = 0; j < 3; j++)
+			free(sender->slots[i].buf[j]);
+	free(sender);
+
+	return NULL;
+}
+
+void
+vm_sender_destroy(struct vm_sender *sender)
+{
+	int i, j;
+
+	if (!sender)
+		return;
+
+	/* Make sure the sender thread finishes */
+	atomic_store(&sender->destroying, 1);
+	sender_wake(sender);
+	pthread_join(sender->sender_thread, NULL);
+
+	weston_log("vm: metadata sender stats: %u sent, %u replaced, "
+		   "%u dropped\n", atomic_load(&sender->frames_sent),
+		   atomic_load(&sender->frames_replaced),
+		   atomic_load(&sender->frames_dropped));
+
+	close(sender->wake_fd);
+	for (i = 0; i <= VM_MAX_OUTPUTS; i++)
+		for (j = 0; j < 3; j++)
+			free(sender->slots[i].buf[j]);
+	free(sender);
+}
+
+/*
+ * Called from the repaint path. Copies the table into the output's
+ * mailbox and returns immediately; the table still waiting from a
+ * previous frame, if any, is discarded in favour of the new one.
+ */
+int
+vm_sender_queue(struct vm_sender *sender, int output,
+		const void *data, int len)
+{
+	struct vm_sender_slot *slot;
+	int prev;
+
+	if (output < 0 || output > VM_MAX_OUTPUTS ||
+	    len > sender->buffer_size)
+		return -1;
+
+	slot = &sender->slots[output];
+	memcpy(slot->buf[slot->write], data, len);
+	slot->len[slot->write] = len;
+
+	prev = atomic_exchange(&slot->pending, slot->write | VM_SLOT_NEW);
+	slot->write = VM_SLOT_INDEX(prev);
+	if (prev & VM_SLOT_NEW)
+		atomic_fetch_add(&sender->frames_replaced, 1);
+
+	sender_wake(sender);
+
+	return 0;
+}
+
+/*
+ * Picks the next output with a pending table, starting after the one that
+ * was sent last so a busy output cannot starve the others.
+ */
+static int
+sender_next_output(struct vm_sender *sender, int last)
+{
+	int i, output;
+
+	for (i = 1; i <= VM_MAX_OUTPUTS + 1; i++) {
+		output = (last + i) % (VM_MAX_OUTPUTS + 1);
+		if (slot_take(&sender->slots[output]))
+			return output;
+	}
+
+	return -1;
+}
+
+/*
+ * Pushes as much of the current table as the channel accepts without
+ * blocking. Returns 1 when the sender has to wait for the channel and
+ * 0 when there is nothing left to do right now, which includes the
+ * channel having written out everything it queued.
+ */
+static int
+sender_flush(struct vm_sender *sender)
+{
+	struct hyper_communication_interface *comm = sender->comm;
+	struct vm_sender_slot *slot;
+	int last = 0;
+	int len, rc;
+
+	for (;;) {
+		if (sender->cur_output < 0) {
+			sender->cur_output = sender_next_output(sender, last);
+			sender->cur_offset = 0;
+			if (sender->cur_output < 0)
+				return comm->flush && comm->flush() > 0;
+		}
+
+		slot = &sender->slots[sender->cur_output];
+		len = slot->len[slot->read];
+
+		/* Nothing of this table went out yet, so a newer one for the
+		 * same output can still take its place while we wait. */
+		if (sender->cur_offset == 0) {
+			if (slot_take(slot)) {
+				atomic_fetch_add(&sender->frames_replaced, 1);
+				len = slot->len[slot->read];
+			}
+
+			if (comm->available_space() < len)
+				return 1;
+		}
+
+		rc = comm->send_data(slot->buf[slot->read] + sender->cur_offset,
+				     len - sender->cur_offset);
+		if (rc < 0) {
+			/* channel is gone, the peer resyncs on the next
+			 * METADATA_STREAM_START marker */
+			atomic_fetch_add(&sender->frames_dropped, 1);
+			last = sender->cur_output;
+			sender->cur_output = -1;
+			continue;
+		}
+
+		if (rc == 0)
+			return 1;
+
+		sender->cur_offset += rc;
+		if (sender->cur_offset == len) {
+			atomic_fetch_add(&sender->frames_sent, 1);
+			last = sender->cur_output;
+			sender->cur_output = -1;
+		}
+	}
+}
+
+static void *
+sender_thread_function(void *data)
+{
+	struct vm_sender *sender = data;
+	struct pollfd pfd = {
+		.fd = sender->wake_fd,
+		.events = POLLIN,
+	};
+	uint64_t count;
+	int busy = 0;
+
+	while (!atomic_load(&sender->destroying)) {
+		if (poll(&pfd, 1, busy ? VM_SENDER_RETRY_MS : -1) < 0 &&
+		    errno != EINTR)
+			break;
+
+		if ((pfd.revents & POLLIN) &&
+		    read(sender->wake_fd, &count, sizeof(count)) < 0 &&
+		    errno != EAGAIN)
+			break;
+
+		busy = sender_flush(sender);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,22 @@
+#ifndef __VM_SENDER_H__
+#define __VM_SENDER_H__
+
+#include "vm_comm.h"
+
+/*
+ * Metadata sender used by vm.c to move the communication channel off the
+ * repaint path. Each output owns a single mailbox: queueing a new table
+ * replaces whatever is still pending for that output, so the backlog is
+ * bounded to one table per output no matter how slow the guest is.
+ */
+struct vm_sender;
+
+struct vm_sender *
+vm_sender_create(struct hyper_communication_interface *comm, int buffer_size);
+void
+vm_sender_destroy(struct vm_sender *sender);
+int
+vm_sender_queue(struct vm_sender *sender, int output,
+		const void *data, int len);
+
+#endif /* __VM_SENDER_H__ */
@@ -1,7 +1,8 @@
 #include "config.h"
 #include "vm.h"
 #include "linux-dmabuf.h"
-#include <sched.h>
+#include "vm-sender.h"
+#include "vm-fence.h"
 #ifdef HYPER_DMABUF
 #include <hyper_dmabuf.h>
 #endif
@@ -9,13 +10,29 @@
 char vm_data[METADATA_BUFFER_SIZE];
 int vm_data_offset;
 
-#define METADATA_SEND_RETRIES 10
-#define METADATA_SEND_SLEEP 1000
-
 #define VBT_VERSION 3
 
+/*
+ * Frames whose buffers are still being rendered are kept around until
+ * their fences signal. Only this many are kept per output, older ones
+ * are dropped as they would be superseded anyway.
+ */
+#define VM_MAX_PENDING_FRAMES 3
+
+struct vm_pending_frame {
+	struct wl_list link; /* vm_buffer_table::pending_frame_list */
+	struct vm_buffer_table *vbt;
+	struct vm_fence_wait *wait;
+	struct wl_array bos;
+	int32_t output;
+	int32_t counter;
+	char *data;
+	int len;
+};
+
 static struct hyper_communication_interface comm_interface;
 static void *comm_module;
+static struct vm_sender *comm_sender;
 
 int vm_init(struct gl_renderer *gr)
 {
@@ -30,6 +47,7 @@ int vm_init(struct gl_renderer *gr)
 	vbt->h.n_buffers = 0;
 
 	wl_list_init(&vbt->vm_buffer_info_list);
+	wl_list_init(&vbt->pending_frame_list);
 
 	/*
 	 * Check if vm plugin was not provided in ias.conf,
@@ -71,6 +89,16 @@ int vm_init(struct gl_renderer *gr)
 			weston_log("hypervisor communication channel initialization failed\n");
 			return -1;
 		}
+
+		/* Metadata is pushed to the channel from a dedicated thread,
+		 * so a slow guest never stalls the repaint */
+		comm_sender = vm_sender_create(&comm_interface,
+					       METADATA_BUFFER_SIZE);
+		if (!comm_sender) {
+			weston_log("Failed to start metadata sender thread\n");
+			comm_interface.cleanup();
+			return -1;
+		}
 		weston_log("Succesfully loaded hypervisor communication channel plugin\n");
 	}
 
@@ -89,32 +117,79 @@ static void add_to_vm_data(void *buf, int len)
 	vm_data_offset += len;
 }
 
+static void pending_frame_destroy(struct vm_pending_frame *frame)
+{
+	struct gbm_bo **bo;
+
+	vm_fence_wait_destroy(frame->wait);
+	wl_array_for_each(bo, &frame->bos)
+		gbm_bo_destroy(*bo);
+	wl_array_release(&frame->bos);
+	wl_list_remove(&frame->link);
+	free(frame->data);
+	free(frame);
+}
+
+/*
+ * Runs from the event loop once every buffer of the frame finished
+ * rendering, so the guest never sees metadata of incomplete buffers.
+ */
+static void pending_frame_ready(struct vm_fence_wait *wait, void *data)
+{
+	struct vm_pending_frame *frame = data;
+	struct vm_buffer_table *vbt = frame->vbt;
+
+	/* Fences may signal out of order, never publish an older table
+	 * after a newer one for the same output */
+	if (frame->data && frame->counter > vbt->published[frame->output]) {
+		if (vm_sender_queue(comm_sender, frame->output,
+				    frame->data, frame->len) < 0)
+			weston_log("Metadata of output %d too large to send: %d\n",
+				   frame->output, frame->len);
+		vbt->published[frame->output] = frame->counter;
+	}
+
+	pending_frame_destroy(frame);
+}
+
+static void pending_frame_trim(struct vm_buffer_table *vbt, int32_t output)
+{
+	struct vm_pending_frame *frame, *tmp;
+	int n = 0;
+
+	/* the list is kept newest first */
+	wl_list_for_each_safe(frame, tmp, &vbt->pending_frame_list, link) {
+		if (frame->output != output)
+			continue;
+		if (++n > VM_MAX_PENDING_FRAMES)
+			pending_frame_destroy(frame);
+	}
+}
+
 void vm_table_clean(struct gl_renderer *gr)
 {
 	struct gr_buffer_ref *gr_buf, *tmp;
 	struct vm_buffer_table *vbt = gr->vm_buffer_table;
-	int i = 0, rc;
-	int retries = METADATA_SEND_RETRIES;
+	struct vm_pending_frame *frame = vbt->current;
 
 	if (gl_renderer_interface.vm_use_plugin) {
-		while (comm_interface.available_space() < vm_data_offset && retries--) {
-			usleep(METADATA_SEND_SLEEP);
-		}
-
-		if (comm_interface.available_space() >= vm_data_offset) {
-			if (comm_interface.send_data != NULL) {
-				add_marker_to_vm_data(METADATA_STREAM_END);
-				do {
-					rc = comm_interface.send_data(&vm_data[i], vm_data_offset - i);
-					i += rc;
-				} while (i != vm_data_offset && rc >= 0);
+		if (frame && vm_data_offset > 0) {
+			add_marker_to_vm_data(METADATA_STREAM_END);
+			frame->data = malloc(vm_data_offset);
+			if (frame->data) {
+				memcpy(frame->data, vm_data, vm_data_offset);
+				frame->len = vm_data_offset;
 			}
-		} else {
-			printf("No space in comm channel - skipping frame %d < %d\n",
-				comm_interface.available_space(), vm_data_offset);
 		}
 		vm_data_offset = 0;
-		memset(vm_data, 0, METADATA_BUFFER_SIZE);
+	}
+
+	if (frame) {
+		vbt->current = NULL;
+		wl_list_insert(&vbt->pending_frame_list, &frame->link);
+		pending_frame_trim(vbt, frame->output);
+		/* may publish right away when nothing is left to render */
+		vm_fence_wait_arm(frame->wait);
 	}
 
 	/* remove any buffer refs inside this table */
@@ -140,6 +215,10 @@ void vm_destroy(struct gl_renderer * gr)
 {
 	struct gr_buffer_ref *gr_buf, *tmp;
 	struct vm_buffer_table *vbt = gr->vm_buffer_table;
+	struct vm_pending_frame *frame, *ftmp;
+
+	wl_list_for_each_safe(frame, ftmp, &vbt->pending_frame_list, link)
+		pending_frame_destroy(frame);
 
 	/* free any buffers inside this table */
 	wl_list_for_each_safe(gr_buf, tmp, &vbt->vm_buffer_info_list, elm) {
@@ -149,6 +228,8 @@ void vm_destroy(struct gl_renderer * gr)
 	free(gr->vm_buffer_table);
 
 	if (gl_renderer_interface.vm_use_plugin) {
+		vm_sender_destroy(comm_sender);
+		comm_sender = NULL;
 		if (comm_interface.cleanup != NULL) {
 			comm_interface.cleanup();
 		}
@@ -326,24 +407,49 @@ void vm_add_buf(struct weston_compositor *ec, struct gl_renderer *gr,
 	}
 }
 
-static int wait_for_gpu(const struct wl_list * list, int drm_fd)
+/*
+ * Returns an fd that becomes readable once rendering into the buffer is
+ * complete: the client's explicit acquire fence if it sent one, otherwise
+ * the dma-buf itself, which polls readable when its implicit write fence
+ * signals.
+ */
+static int buffer_fence_fd(struct gr_buffer_ref *gr_buf)
 {
-	struct gr_buffer_ref *gr_buffer_ref_ptr;
-	int result = 0;
-	wl_list_for_each_reverse(gr_buffer_ref_ptr, list, elm) {
-		if (gr_buffer_ref_ptr->bo != NULL) {
-			struct drm_i915_gem_busy busy = {};
-			busy.handle = gbm_bo_get_handle(gr_buffer_ref_ptr->bo).u32;
-			drmIoctl(drm_fd, DRM_IOCTL_I915_GEM_BUSY, &busy);
-			while (busy.busy != 0) {
-				result = 1;
-				sched_yield();
-				drmIoctl(drm_fd, DRM_IOCTL_I915_GEM_BUSY, &busy);
-			}
-			gbm_bo_destroy(gr_buffer_ref_ptr->bo);
-		}
+	struct linux_dmabuf_buffer *dmabuf;
+
+	if (gr_buf->surface && gr_buf->surface->acquire_fence_fd >= 0)
+		return dup(gr_buf->surface->acquire_fence_fd);
+
+	dmabuf = linux_dmabuf_buffer_get(gr_buf->buffer->resource);
+	if (!dmabuf)
+		return -1;
+
+	return dup(dmabuf->attributes.fd[0]);
+}
+
+static struct vm_pending_frame *pending_frame_create(struct weston_compositor *ec,
+						     struct vm_buffer_table *vbt)
+{
+	struct vm_pending_frame *frame;
+
+	frame = zalloc(sizeof *frame);
+	if (!frame)
+		return NULL;
+
+	frame->wait = vm_fence_wait_create(wl_display_get_event_loop(ec->wl_display),
+					   pending_frame_ready, frame);
+	if (!frame->wait) {
+		free(frame);
+		return NULL;
 	}
-	return result;
+
+	frame->vbt = vbt;
+	frame->output = vbt->h.output;
+	frame->counter = vbt->h.counter;
+	wl_array_init(&frame->bos);
+	wl_list_init(&frame->link);
+
+	return frame;
 }
 
 int vm_table_expose(struct weston_output *output, struct gl_output_state *go,
@@ -358,7 +464,6 @@ int vm_table_expose(struct weston_output *output, struct gl_output_state *go,
 	struct vm_buffer_table *vbt = gr->vm_buffer_table;
 	EGLint buffer_age = 0;
 	EGLBoolean ret;
-	int drm_fd = bc->drm.fd;
 	int shareable = 0;
 	struct weston_output *o;
 	int output_num = 0;
@@ -418,10 +523,11 @@ int vm_table_expose(struct weston_output *output, struct gl_output_state *go,
 
 	/* No buffers */
 	if(vbt->h.n_buffers == 0) {
-		wait_for_gpu(&vbt->vm_buffer_info_list, drm_fd);
 		return 1;
 	}
 
+	vbt->current = pending_frame_create(ec, vbt);
+
 	if (gl_renderer_interface.vm_use_plugin) {
 		add_marker_to_vm_data(METADATA_STREAM_START);
 		add_to_vm_data(&vbt->h, sizeof(struct vm_header));
@@ -447,9 +553,31 @@ int vm_table_expose(struct weston_output *output, struct gl_output_state *go,
 
 		if (gl_renderer_interface.vm_use_plugin)
 			add_to_vm_data(&gr_buf->vm_buffer_info, sizeof(struct vm_buffer_info));
+
+		/*
+		 * Instead of waiting for the GPU here, the frame holds on to
+		 * the imported bo and is published once the buffer's fence
+		 * signals.
+		 */
+		if (vbt->current) {
+			struct gbm_bo **bo;
+
+			if (gr_buf->bo) {
+				bo = wl_array_add(&vbt->current->bos, sizeof(*bo));
+				if (bo) {
+					*bo = gr_buf->bo;
+					gr_buf->bo = NULL;
+				}
+			}
+			vm_fence_wait_add(vbt->current->wait, buffer_fence_fd(gr_buf));
+		}
+
+		if (gr_buf->bo) {
+			gbm_bo_destroy(gr_buf->bo);
+			gr_buf->bo = NULL;
+		}
 	}
 
-	wait_for_gpu(&vbt->vm_buffer_info_list, drm_fd);
 	return 1;
 }
 
@@ -46,9 +46,18 @@
 
 #define VM_MAX_BUFFERS_NUMBER 4
 
+struct vm_pending_frame;
+
 struct vm_buffer_table {
 	struct vm_header h;
 	struct wl_list vm_buffer_info_list;
+
+	/* frame being built between vm_table_expose() and vm_table_clean() */
+	struct vm_pending_frame *current;
+	/* frames waiting for their buffers' fences, newest first */
+	struct wl_list pending_frame_list;
+	/* counter of the newest table published per output */
+	int32_t published[VM_MAX_OUTPUTS + 1];
 };
 
 struct gr_buffer_ref {
@@ -37,6 +37,7 @@
 
 #include <libweston/libweston.h>
 #include "shared/helpers.h"
+#include "shared/pixel-convert.h"
 #include "shared/timespec-util.h"
 #include "backend.h"
 #include "libweston-internal.h"
@@ -50,69 +51,6 @@ struct screenshooter_frame_listener {
 	void *data;
 };
 
-static void
-copy_bgra_yflip(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	uint8_t *end;
-
-	end = dst + height * stride;
-	while (dst < end) {
-		memcpy(dst, src, stride);
-		dst += stride;
-		src -= stride;
-	}
-}
-
-static void
-copy_bgra(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	/* TODO: optimize this out */
-	memcpy(dst, src, height * stride);
-}
-
-static void
-copy_row_swap_RB(void *vdst, void *vsrc, int bytes)
-{
-	uint32_t *dst = vdst;
-	uint32_t *src = vsrc;
-	uint32_t *end = dst + bytes / 4;
-
-	while (dst < end) {
-		uint32_t v = *src++;
-		/*                    A R G B */
-		uint32_t tmp = v & 0xff00ff00;
-		tmp |= (v >> 16) & 0x000000ff;
-		tmp |= (v << 16) & 0x00ff0000;
-		*dst++ = tmp;
-	}
-}
-
-static void
-copy_rgba_yflip(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	uint8_t *end;
-
-	end = dst + height * stride;
-	while (dst < end) {
-		copy_row_swap_RB(dst, src, stride);
-		dst += stride;
-		src -= stride;
-	}
-}
-
-static void
-copy_rgba(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	uint8_t *end;
-
-	end = dst + height * stride;
-	while (dst < end) {
-		copy_row_swap_RB(dst, src, stride);
-		dst += stride;
-		src += stride;
-	}
-}
-
 static void
 screenshooter_frame_notify(struct wl_listener *listener, void *data)
 {
@@ -122,7 +60,9 @@ screenshooter_frame_notify(struct wl_listener *listener, void *data)
 	struct weston_output *output = data;
 	struct weston_compositor *compositor = output->compositor;
 	int32_t stride;
-	uint8_t *pixels, *d, *s;
+	uint8_t *pixels, *d;
+	uint32_t flags = 0;
+	bool convert = true;
 
 	output->disable_planes--;
 	wl_list_remove(&listener->link);
@@ -143,29 +83,30 @@ screenshooter_frame_notify(struct wl_listener *listener, void *data)
 	stride = wl_shm_buffer_get_stride(l->buffer->shm_buffer);
 
 	d = wl_shm_buffer_get_data(l->buffer->shm_buffer);
-	s = pixels + stride * (l->buffer->height - 1);
 
 	wl_shm_buffer_begin_access(l->buffer->shm_buffer);
 
 	switch (compositor->read_format) {
 	case PIXMAN_a8r8g8b8:
 	case PIXMAN_x8r8g8b8:
-		if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
-			copy_bgra_yflip(d, s, output->current_mode->height, stride);
-		else
-			copy_bgra(d, pixels, output->current_mode->height, stride);
+		flags = 0;
 		break;
 	case PIXMAN_x8b8g8r8:
 	case PIXMAN_a8b8g8r8:
-		if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
-			copy_rgba_yflip(d, s, output->current_mode->height, stride);
-		else
-			copy_rgba(d, pixels, output->current_mode->height, stride);
+		flags = PIXEL_CONVERT_SWAP_RB;
 		break;
 	default:
+		convert = false;
 		break;
 	}
 
+	if (convert) {
+		if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
+			flags |= PIXEL_CONVERT_YFLIP;
+		pixel_convert_xrgb(d, stride, pixels, stride, stride / 4,
+				   output->current_mode->height, flags);
+	}
+
 	wl_shm_buffer_end_access(l->buffer->shm_buffer);
 
 	l->done(l->data, WESTON_SCREENSHOOTER_SUCCESS);
@@ -5,6 +5,9 @@ struct hyper_communication_interface {
 	void (*cleanup)(void);
 	int (*send_data)(void *data, int len);
 	int (*available_space)(void);
+	/* Optional: writes out data send_data() accepted but had to queue,
+	 * returns 1 while some is still pending */
+	int (*flush)(void);
 };
 
 typedef int (*init_comm_interface)(struct hyper_communication_interface * comm_interface,
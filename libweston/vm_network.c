@@ -1,146 +1,82 @@
 #include "vm_comm.h"
 #include "renderer-gl/vm-shared.h"
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <netinet/tcp.h>
-#include <arpa/inet.h>
-#include <string.h>
+#include "shared/vm-channel.h"
 #include <stdio.h>
-#include <signal.h>
-#include <unistd.h>
-#include <pthread.h>
-#include <limits.h>
-#include <stdlib.h>
-
-int sock_fd;
-int client_sock_fd;
-int portno;
-struct sockaddr_in server_addr, client_addr;
-pthread_t thread;
-void* listener_thread(void *arg);
-
-
-void* listener_thread(void *arg)
-{
-	socklen_t clilen;
-
-	clilen = sizeof(client_addr);
-	client_sock_fd = accept(sock_fd, (struct sockaddr *) &client_addr, &clilen);
-
-	return NULL;
-}
+#include <string.h>
 
-static void signal_callback_handler(int signum)
-{
-	if (client_sock_fd >= 0) {
-		printf("VM client disconnected\n");
-		close(client_sock_fd);
-		client_sock_fd = -1;
-		/* Kick off thread to start listening for new connection */
-		pthread_create(&thread, NULL, listener_thread, NULL);
-	}
-}
+/*
+ * Despite its name this plugin serves every vm-channel transport: the
+ * plugin args are a channel spec. A bare "<addr>:<port>" keeps the plain
+ * TCP byte stream existing receivers expect, "tcp:<addr>:<port>",
+ * "vsock:<cid>:<port>" and "shm:<socket path>" carry framed messages.
+ */
+static struct vm_channel *channel;
 
 static int hyper_communication_network_init(int dom_id, int buffer_size,
 					    const char *args)
 {
 	(void) dom_id;
 	(void) buffer_size;
-	/* Local copy of args, as strtok is modyfing them */
-	char args_tmp[256];
-	char *addr;
-	char *port;
-	int reuse_enable = 1;
-	int tcp_nodelay_enable = 1;
-
-	if (!strlen(args)) {
-		printf("No valid parameters for network plugin\n");
-		return -1;
-	}
 
-	strncpy(args_tmp, args, 255);
-	args_tmp[255] = '\0';
-
-	addr = strtok(args_tmp, ":");
-	if (!addr) {
-		printf("Cannot parse parameters\n");
-		return -1;
-	}
-
-	port = strtok(NULL, ":");
-	if (!port) {
-		printf("Cannot parse parameters\n");
-		return -1;
-	}
-
-	printf("Network socket listening on %s:%s\n", addr, port);
-
-	sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-	if (sock_fd < 0) {
-		printf("Cannot create socket\n");
+	if (!args || !strlen(args)) {
+		printf("No valid parameters for network plugin\n");
 		return -1;
 	}
 
-	memset(&server_addr, 0, sizeof(server_addr));
-	portno = atoi(port);
-	server_addr.sin_family = AF_INET;
-	server_addr.sin_addr.s_addr = inet_addr(addr);
-	server_addr.sin_port = htons(portno);
-	setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &reuse_enable, sizeof(reuse_enable));
-	setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &tcp_nodelay_enable, sizeof(tcp_nodelay_enable));
-
-	if (bind(sock_fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0) {
-		printf("Cannot bind socket\n");
-		close(sock_fd);
-		sock_fd = -1;
+	channel = vm_channel_create(args, VM_CHANNEL_SERVER);
+	if (!channel) {
+		printf("Cannot create VM channel %s\n", args);
 		return -1;
 	}
 
-	/*
-	 * Start listening on socket and register SIGPIPE signal handler,
-	 * otherwise whenever client will disconnect, weston will be killed
-	 */
-	listen(sock_fd, 1);
-	signal(SIGPIPE, signal_callback_handler);
-
-	/* Kick off thread to accept connection from client, to not block main thread */
-	pthread_create(&thread, NULL, listener_thread, NULL);
+	printf("VM channel listening on %s\n", args);
 
 	return 0;
 }
 
 static void hyper_communication_network_cleanup(void)
 {
-	if (client_sock_fd >= 0) {
-		close(client_sock_fd);
-		client_sock_fd = -1;
-	} else {
-		pthread_join(thread, NULL);
-	}
-
-	if (sock_fd >= 0) {
-		close(sock_fd);
-		sock_fd = -1;
-	}
+	vm_channel_destroy(channel);
+	channel = NULL;
 }
 
+/*
+ * Every call carries one complete metadata table, which goes out as a
+ * single channel message: either all of it is accepted or nothing is and
+ * 0 is returned, so the caller never blocks and tables are never torn.
+ */
 static int hyper_communication_network_send_data(void *data, int len)
 {
-	if (client_sock_fd >= 0) {
-		return send(client_sock_fd, data, len, 0);
-	}
-	return -1;
+	if (!channel)
+		return -1;
+
+	return vm_channel_send(channel, data, len);
+}
+
+/* Pushes out the rest of a table the socket could not take at once */
+static int hyper_communication_network_flush(void)
+{
+	if (!channel)
+		return 0;
+
+	return vm_channel_flush(channel);
 }
 
 static int hyper_communication_network_space(void)
 {
-	/*
-	 * It seems there is no way to query what is size
-	 * of internal buffer used by network socket,
-	 * so just assume that is big enought for our needs
-	 */
-	return INT_MAX;
+	size_t space;
+
+	if (!channel)
+		return 0;
+
+	/* Without a peer let send_data() report it, so the table is dropped
+	 * instead of waited for */
+	if (!vm_channel_wait_connected(channel, 0))
+		return INT32_MAX;
+
+	space = vm_channel_send_space(channel);
+
+	return space > INT32_MAX ? INT32_MAX : (int) space;
 }
 
 int __attribute__((__visibility__("default")))
@@ -155,5 +91,6 @@ init_comm(struct hyper_communication_interface * comm_interface, int dom_id,
 	comm_interface->cleanup = hyper_communication_network_cleanup;
 	comm_interface->send_data = hyper_communication_network_send_data;
 	comm_interface->available_space = hyper_communication_network_space;
+	comm_interface->flush = hyper_communication_network_flush;
 	return 0;
 }
@@ -0,0 +1,274 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "annexb.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ANNEXB_HAVE_SSE2
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ANNEXB_HAVE_AVX2
+#endif
+
+#define ANNEXB_INDEX_MIN_CAPACITY 16
+
+/*
+ * Looks at every third byte: if p[2] is neither 0 nor 1, no start code can
+ * begin at p, p + 1 or p + 2.
+ */
+static const uint8_t *
+find_start_code_scalar(const uint8_t *p, const uint8_t *end)
+{
+	while (end - p >= 3) {
+		if (p[2] > 1)
+			p += 3;
+		else if (p[2] == 0)
+			p++;
+		else if (p[0] == 0 && p[1] == 0)
+			return p;
+		else
+			p += 3;
+	}
+
+	return end;
+}
+
+#ifdef ANNEXB_HAVE_SSE2
+static const uint8_t *
+find_start_code_sse2(const uint8_t *p, const uint8_t *end)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i a, b, c;
+	int mask;
+
+	/* each block reads 2 bytes past the 16 candidates */
+	while (end - p >= 18) {
+		a = _mm_loadu_si128((const __m128i *)p);
+		b = _mm_loadu_si128((const __m128i *)(p + 1));
+		c = _mm_loadu_si128((const __m128i *)(p + 2));
+
+		a = _mm_and_si128(_mm_cmpeq_epi8(a, zero),
+				  _mm_cmpeq_epi8(b, zero));
+		a = _mm_and_si128(a, _mm_cmpeq_epi8(c, one));
+
+		mask = _mm_movemask_epi8(a);
+		if (mask)
+			return p + __builtin_ctz(mask);
+
+		p += 16;
+	}
+
+	return find_start_code_scalar(p, end);
+}
+#endif
+
+#ifdef ANNEXB_HAVE_AVX2
+__attribute__((target("avx2")))
+static const uint8_t *
+find_start_code_avx2(const uint8_t *p, const uint8_t *end)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi8(1);
+	__m256i a, b, c;
+	uint32_t mask;
+
+	while (end - p >= 34) {
+		a = _mm256_loadu_si256((const __m256i *)p);
+		b = _mm256_loadu_si256((const __m256i *)(p + 1));
+		c = _mm256_loadu_si256((const __m256i *)(p + 2));
+
+		a = _mm256_and_si256(_mm256_cmpeq_epi8(a, zero),
+				     _mm256_cmpeq_epi8(b, zero));
+		a = _mm256_and_si256(a, _mm256_cmpeq_epi8(c, one));
+
+		mask = _mm256_movemask_epi8(a);
+		if (mask)
+			return p + __builtin_ctz(mask);
+
+		p += 32;
+	}
+
+	return find_start_code_scalar(p, end);
+}
+#endif
+
+annexb_find_func_t
+annexb_get_scanner(enum annexb_scanner scanner)
+{
+	switch (scanner) {
+	case ANNEXB_SCANNER_SCALAR:
+		return find_start_code_scalar;
+	case ANNEXB_SCANNER_SSE2:
+#ifdef ANNEXB_HAVE_SSE2
+		return find_start_code_sse2;
+#else
+		return NULL;
+#endif
+	case ANNEXB_SCANNER_AVX2:
+#ifdef ANNEXB_HAVE_AVX2
+		if (__builtin_cpu_supports("avx2"))
+			return find_start_code_avx2;
+#endif
+		return NULL;
+	}
+
+	return NULL;
+}
+
+static annexb_find_func_t
+annexb_best_scanner(void)
+{
+	annexb_find_func_t find;
+
+	find = annexb_get_scanner(ANNEXB_SCANNER_AVX2);
+	if (!find)
+		find = annexb_get_scanner(ANNEXB_SCANNER_SSE2);
+	if (!find)
+		find = find_start_code_scalar;
+
+	return find;
+}
+
+/* Returns the first 00 00 01 in [p, end), or end if there is none. A
+ * preceding zero byte, making it a 4-byte start code, is up to the caller. */
+const uint8_t *
+annexb_find_start_code(const uint8_t *p, const uint8_t *end)
+{
+	return annexb_best_scanner()(p, end);
+}
+
+void
+annexb_index_init(struct annexb_index *index)
+{
+	index->nals = NULL;
+	index->count = 0;
+	index->capacity = 0;
+	index->flags = 0;
+	index->leading = 0;
+}
+
+void
+annexb_index_release(struct annexb_index *index)
+{
+	free(index->nals);
+	annexb_index_init(index);
+}
+
+static int
+annexb_index_add(struct annexb_index *index, const uint8_t *data,
+		 const uint8_t *nal, const uint8_t *nal_end,
+		 int start_code_size)
+{
+	struct annexb_nal *entry;
+
+	if (index->count == index->capacity) {
+		unsigned capacity = index->capacity * 2;
+
+		if (capacity < ANNEXB_INDEX_MIN_CAPACITY)
+			capacity = ANNEXB_INDEX_MIN_CAPACITY;
+
+		entry = realloc(index->nals, capacity * sizeof *entry);
+		if (!entry)
+			return -1;
+
+		index->nals = entry;
+		index->capacity = capacity;
+	}
+
+	entry = &index->nals[index->count++];
+	entry->offset = nal - data;
+	entry->size = nal_end - nal;
+	entry->start_code_size = start_code_size;
+	entry->type = nal[0] & 0x1f;
+	entry->ref_idc = (nal[0] >> 5) & 0x3;
+
+	switch (entry->type) {
+	case ANNEXB_NAL_SPS:
+		index->flags |= ANNEXB_FRAME_SPS;
+		break;
+	case ANNEXB_NAL_PPS:
+		index->flags |= ANNEXB_FRAME_PPS;
+		break;
+	case ANNEXB_NAL_IDR:
+		index->flags |= ANNEXB_FRAME_IDR;
+		break;
+	}
+
+	return 0;
+}
+
+/*
+ * Splits a frame into its NAL units. The index is reset first and keeps
+ * its storage, so the same index can be used for every frame of a stream.
+ * Empty NAL units are skipped. Returns -1 if the index could not grow.
+ */
+int
+annexb_index_frame(struct annexb_index *index, const uint8_t *data,
+		   size_t size)
+{
+	annexb_find_func_t find = annexb_best_scanner();
+	const uint8_t *end = data + size;
+	const uint8_t *p, *nal, *next, *nal_end;
+	int start_code_size, next_size;
+
+	index->count = 0;
+	index->flags = 0;
+
+	p = find(data, end);
+	start_code_size = (p != end && p > data && p[-1] == 0) ? 4 : 3;
+	index->leading = p != end ? (size_t)(p - data) - (start_code_size - 3) :
+				    size;
+
+	while (p != end) {
+		nal = p + 3;
+		next = find(nal, end);
+		nal_end = next;
+		next_size = 3;
+
+		if (next != end && next > nal && next[-1] == 0) {
+			nal_end--;
+			next_size = 4;
+		}
+
+		if (nal_end > nal &&
+		    annexb_index_add(index, data, nal, nal_end,
+				     start_code_size) < 0)
+			return -1;
+
+		p = next;
+		start_code_size = next_size;
+	}
+
+	return 0;
+}
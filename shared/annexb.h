@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_ANNEXB_H
+#define WESTON_ANNEXB_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Scanner for H.264 Annex-B byte streams, as produced by the VA-API
+ * encoders. A frame is split at its start codes into a NAL index in a
+ * single pass, so packetizers can walk the NAL units without scanning the
+ * stream again.
+ *
+ * Start codes are searched with SSE2 or AVX2 where the CPU has it; the
+ * result is the same as with the byte-wise scalar scanner.
+ */
+
+enum annexb_nal_type {
+	ANNEXB_NAL_SLICE = 1,
+	ANNEXB_NAL_IDR = 5,
+	ANNEXB_NAL_SEI = 6,
+	ANNEXB_NAL_SPS = 7,
+	ANNEXB_NAL_PPS = 8,
+	ANNEXB_NAL_AUD = 9,
+};
+
+/* set in annexb_index::flags when the frame has a NAL unit of that type */
+enum annexb_frame_flags {
+	ANNEXB_FRAME_SPS = 1 << 0,
+	ANNEXB_FRAME_PPS = 1 << 1,
+	ANNEXB_FRAME_IDR = 1 << 2,
+};
+
+struct annexb_nal {
+	/* NAL header, right after the start code, and the size up to the
+	 * next start code or the end of the frame */
+	size_t offset;
+	size_t size;
+	uint8_t start_code_size;	/* 3 or 4 */
+	uint8_t type;			/* enum annexb_nal_type */
+	uint8_t ref_idc;
+};
+
+struct annexb_index {
+	struct annexb_nal *nals;
+	unsigned count;
+	unsigned capacity;
+	uint32_t flags;
+	/* bytes before the first start code, 0 for a well formed frame */
+	size_t leading;
+};
+
+void
+annexb_index_init(struct annexb_index *index);
+
+void
+annexb_index_release(struct annexb_index *index);
+
+int
+annexb_index_frame(struct annexb_index *index, const uint8_t *data,
+		   size_t size);
+
+const uint8_t *
+annexb_find_start_code(const uint8_t *p, const uint8_t *end);
+
+enum annexb_scanner {
+	ANNEXB_SCANNER_SCALAR,
+	ANNEXB_SCANNER_SSE2,
+	ANNEXB_SCANNER_AVX2,
+};
+
+typedef const uint8_t *(*annexb_find_func_t)(const uint8_t *p,
+					     const uint8_t *end);
+
+/* For tests and benchmarks: a specific scanner, or NULL when it was not
+ * built or the CPU does not support it. */
+annexb_find_func_t
+annexb_get_scanner(enum annexb_scanner scanner);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_ANNEXB_H */
@@ -36,6 +36,7 @@
 #include "cairo-util.h"
 
 #include "shared/helpers.h"
+#include "shared/xalloc.h"
 #include "image-loader.h"
 #include <libweston/config-parser.h>
 
@@ -344,14 +345,12 @@ rounded_rect(cairo_t *cr, int x0, int y0, int x1, int y1, int radius)
 	cairo_close_path(cr);
 }
 
-cairo_surface_t *
-load_cairo_surface(const char *filename)
+static cairo_surface_t *
+cairo_surface_from_image(pixman_image_t *image)
 {
-	pixman_image_t *image;
 	int width, height, stride;
 	void *data;
 
-	image = load_image(filename);
 	if (image == NULL) {
 		return NULL;
 	}
@@ -365,6 +364,28 @@ load_cairo_surface(const char *filename)
 						   width, height, stride);
 }
 
+cairo_surface_t *
+load_cairo_surface(const char *filename)
+{
+	return cairo_surface_from_image(load_image(filename));
+}
+
+void
+load_cairo_surfaces(const char * const *filenames, int count,
+		    cairo_surface_t **surfaces, uint32_t flags)
+{
+	pixman_image_t **images;
+	int i;
+
+	images = xzalloc(count * sizeof *images);
+	load_images(filenames, count, images, flags);
+
+	for (i = 0; i < count; i++)
+		surfaces[i] = cairo_surface_from_image(images[i]);
+
+	free(images);
+}
+
 void
 theme_set_background_source(struct theme *t, cairo_t *cr, uint32_t flags)
 {
@@ -49,6 +49,12 @@ rounded_rect(cairo_t *cr, int x0, int y0, int x1, int y1, int radius);
 cairo_surface_t *
 load_cairo_surface(const char *filename);
 
+/* load_cairo_surface() for several files, decoded in parallel; flags
+ * are enum image_load_flags */
+void
+load_cairo_surfaces(const char * const *filenames, int count,
+		    cairo_surface_t **surfaces, uint32_t flags);
+
 struct theme {
 	cairo_surface_t *active_frame;
 	cairo_surface_t *inactive_frame;
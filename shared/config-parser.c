@@ -32,8 +32,10 @@
 #include <assert.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -43,23 +45,161 @@
 #include "helpers.h"
 #include "string-helpers.h"
 
+/*
+ * A parsed configuration is compiled into a single block that only uses
+ * offsets from its start: a header, the interned strings, the sections in
+ * file order, their entries and the string hash table. Looking up a key
+ * hashes it once and then compares string offsets, and sections of the
+ * same name are chained from their interned name. Since the block holds
+ * no pointers it can be saved as a snapshot and mapped back in as is.
+ */
+
+#define CONFIG_SNAPSHOT_MAGIC "WCFGSNAP"
+#define CONFIG_SNAPSHOT_VERSION 1
+
+struct config_string {
+	uint32_t hash;
+	uint32_t next;		/* older string in the same bucket, or 0 */
+	uint32_t section;	/* first section of this name, index + 1 */
+	uint32_t len;
+	char data[];
+};
+
 struct weston_config_entry {
-	char *key;
-	char *value;
-	struct wl_list link;
+	uint32_t key;
+	uint32_t value;
 };
 
 struct weston_config_section {
-	char *name;
-	struct wl_list entry_list;
-	struct wl_list link;
+	uint32_t self;		/* offset of this section in the block */
+	uint32_t name;
+	uint32_t next;		/* next section of the same name, index + 1 */
+	uint32_t first_entry;
+	uint32_t n_entries;
+};
+
+struct config_block {
+	char magic[8];
+	uint32_t version;
+	uint32_t size;
+
+	/* the ini file a snapshot was compiled from */
+	uint64_t source_path_hash;
+	uint64_t source_mtime;
+	uint64_t source_size;
+	uint64_t source_hash;
+
+	uint32_t n_sections;
+	uint32_t sections;
+	uint32_t n_entries;
+	uint32_t entries;
+	uint32_t n_buckets;
+	uint32_t buckets;
 };
 
+/* strings directly follow the header */
+#define CONFIG_STRINGS_BASE ((uint32_t)sizeof(struct config_block))
+
 struct weston_config {
-	struct wl_list section_list;
+	struct config_block *block;
+	bool mapped;
 	char path[PATH_MAX];
 };
 
+#define config_at(block, offset) \
+	((const void *)((const char *)(block) + (offset)))
+
+static uint64_t
+config_hash(const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	uint64_t hash = 0xcbf29ce484222325ull;	/* FNV-1a */
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static uint32_t
+config_string_hash(const char *str, size_t len)
+{
+	uint64_t hash = config_hash(str, len);
+
+	return hash ^ (hash >> 32);
+}
+
+static size_t
+config_string_size(size_t len)
+{
+	return (sizeof(struct config_string) + len + 1 + 3) & ~(size_t)3;
+}
+
+static const struct config_string *
+block_string(const struct config_block *block, uint32_t offset)
+{
+	return config_at(block, offset);
+}
+
+static const char *
+block_str(const struct config_block *block, uint32_t offset)
+{
+	return block_string(block, offset)->data;
+}
+
+static const struct weston_config_section *
+block_sections(const struct config_block *block)
+{
+	return config_at(block, block->sections);
+}
+
+/* Returns the offset of the interned copy of str, 0 if there is none. */
+static uint32_t
+block_find_string(const struct config_block *block, const char *str)
+{
+	const uint32_t *buckets = config_at(block, block->buckets);
+	const struct config_string *s;
+	size_t len = strlen(str);
+	uint32_t hash = config_string_hash(str, len);
+	uint32_t offset;
+
+	for (offset = buckets[hash & (block->n_buckets - 1)]; offset;
+	     offset = s->next) {
+		s = block_string(block, offset);
+		if (s->hash == hash && s->len == len &&
+		    memcmp(s->data, str, len) == 0)
+			return offset;
+	}
+
+	return 0;
+}
+
+static const struct config_block *
+section_block(const struct weston_config_section *section)
+{
+	return config_at(section, -(intptr_t)section->self);
+}
+
+static const struct weston_config_entry *
+section_find_entry(const struct config_block *block,
+		   const struct weston_config_section *section, uint32_t key)
+{
+	const struct weston_config_entry *entries;
+	uint32_t i;
+
+	entries = config_at(block, block->entries);
+	entries += section->first_entry;
+
+	for (i = 0; i < section->n_entries; i++)
+		if (entries[i].key == key)
+			return &entries[i];
+
+	return NULL;
+}
+
 static int
 open_config_file(struct weston_config *c, const char *name)
 {
@@ -113,19 +253,27 @@ open_config_file(struct weston_config *c, const char *name)
 	return -1;
 }
 
-static struct weston_config_entry *
-config_section_get_entry(struct weston_config_section *section,
+static const char *
+config_section_get_value(struct weston_config_section *section,
 			 const char *key)
 {
-	struct weston_config_entry *e;
+	const struct config_block *block;
+	const struct weston_config_entry *e;
+	uint32_t k;
 
 	if (section == NULL)
 		return NULL;
-	wl_list_for_each(e, &section->entry_list, link)
-		if (strcmp(e->key, key) == 0)
-			return e;
 
-	return NULL;
+	block = section_block(section);
+	k = block_find_string(block, key);
+	if (!k)
+		return NULL;
+
+	e = section_find_entry(block, section, k);
+	if (!e)
+		return NULL;
+
+	return block_str(block, e->value);
 }
 
 WL_EXPORT
@@ -133,19 +281,35 @@ struct weston_config_section *
 weston_config_get_section(struct weston_config *config, const char *section,
 			  const char *key, const char *value)
 {
-	struct weston_config_section *s;
-	struct weston_config_entry *e;
+	const struct config_block *block;
+	const struct weston_config_section *sections, *s;
+	const struct weston_config_entry *e;
+	uint32_t name, k = 0, v = 0, i;
 
 	if (config == NULL)
 		return NULL;
-	wl_list_for_each(s, &config->section_list, link) {
-		if (strcmp(s->name, section) != 0)
-			continue;
+
+	block = config->block;
+	name = block_find_string(block, section);
+	if (!name)
+		return NULL;
+
+	if (key) {
+		/* a key or value that was never interned matches nothing */
+		k = block_find_string(block, key);
+		v = value ? block_find_string(block, value) : 0;
+		if (!k || !v)
+			return NULL;
+	}
+
+	sections = block_sections(block);
+	for (i = block_string(block, name)->section; i; i = s->next) {
+		s = &sections[i - 1];
 		if (key == NULL)
-			return s;
-		e = config_section_get_entry(s, key);
-		if (e && strcmp(e->value, value) == 0)
-			return s;
+			return (struct weston_config_section *)s;
+		e = section_find_entry(block, s, k);
+		if (e && e->value == v)
+			return (struct weston_config_section *)s;
 	}
 
 	return NULL;
@@ -157,16 +321,16 @@ weston_config_section_get_int(struct weston_config_section *section,
 			      const char *key,
 			      int32_t *value, int32_t default_value)
 {
-	struct weston_config_entry *entry;
+	const char *str;
 
-	entry = config_section_get_entry(section, key);
-	if (entry == NULL) {
+	str = config_section_get_value(section, key);
+	if (str == NULL) {
 		*value = default_value;
 		errno = ENOENT;
 		return -1;
 	}
 
-	if (!safe_strtoint(entry->value, value)) {
+	if (!safe_strtoint(str, value)) {
 		*value = default_value;
 		return -1;
 	}
@@ -181,19 +345,19 @@ weston_config_section_get_uint(struct weston_config_section *section,
 			       uint32_t *value, uint32_t default_value)
 {
 	long int ret;
-	struct weston_config_entry *entry;
+	const char *str;
 	char *end;
 
-	entry = config_section_get_entry(section, key);
-	if (entry == NULL) {
+	str = config_section_get_value(section, key);
+	if (str == NULL) {
 		*value = default_value;
 		errno = ENOENT;
 		return -1;
 	}
 
 	errno = 0;
-	ret = strtol(entry->value, &end, 0);
-	if (errno != 0 || end == entry->value || *end != '\0') {
+	ret = strtol(str, &end, 0);
+	if (errno != 0 || end == str || *end != '\0') {
 		*value = default_value;
 		errno = EINVAL;
 		return -1;
@@ -217,19 +381,19 @@ weston_config_section_get_color(struct weston_config_section *section,
 				const char *key,
 				uint32_t *color, uint32_t default_color)
 {
-	struct weston_config_entry *entry;
+	const char *str;
 	int len;
 	char *end;
 
-	entry = config_section_get_entry(section, key);
-	if (entry == NULL) {
+	str = config_section_get_value(section, key);
+	if (str == NULL) {
 		*color = default_color;
 		errno = ENOENT;
 		return -1;
 	}
 
-	len = strlen(entry->value);
-	if (len == 1 && entry->value[0] == '0') {
+	len = strlen(str);
+	if (len == 1 && str[0] == '0') {
 		*color = 0;
 		return 0;
 	} else if (len != 8 && len != 10) {
@@ -239,8 +403,8 @@ weston_config_section_get_color(struct weston_config_section *section,
 	}
 
 	errno = 0;
-	*color = strtoul(entry->value, &end, 16);
-	if (errno != 0 || end == entry->value || *end != '\0') {
+	*color = strtoul(str, &end, 16);
+	if (errno != 0 || end == str || *end != '\0') {
 		*color = default_color;
 		errno = EINVAL;
 		return -1;
@@ -255,17 +419,17 @@ weston_config_section_get_double(struct weston_config_section *section,
 				 const char *key,
 				 double *value, double default_value)
 {
-	struct weston_config_entry *entry;
+	const char *str;
 	char *end;
 
-	entry = config_section_get_entry(section, key);
-	if (entry == NULL) {
+	str = config_section_get_value(section, key);
+	if (str == NULL) {
 		*value = default_value;
 		errno = ENOENT;
 		return -1;
 	}
 
-	*value = strtod(entry->value, &end);
+	*value = strtod(str, &end);
 	if (*end != '\0') {
 		*value = default_value;
 		errno = EINVAL;
@@ -281,10 +445,10 @@ weston_config_section_get_string(struct weston_config_section *section,
 				 const char *key,
 				 char **value, const char *default_value)
 {
-	struct weston_config_entry *entry;
+	const char *str;
 
-	entry = config_section_get_entry(section, key);
-	if (entry == NULL) {
+	str = config_section_get_value(section, key);
+	if (str == NULL) {
 		if (default_value)
 			*value = strdup(default_value);
 		else
@@ -293,7 +457,7 @@ weston_config_section_get_string(struct weston_config_section *section,
 		return -1;
 	}
 
-	*value = strdup(entry->value);
+	*value = strdup(str);
 
 	return 0;
 }
@@ -304,18 +468,18 @@ weston_config_section_get_bool(struct weston_config_section *section,
 			       const char *key,
 			       int *value, int default_value)
 {
-	struct weston_config_entry *entry;
+	const char *str;
 
-	entry = config_section_get_entry(section, key);
-	if (entry == NULL) {
+	str = config_section_get_value(section, key);
+	if (str == NULL) {
 		*value = default_value;
 		errno = ENOENT;
 		return -1;
 	}
 
-	if (strcmp(entry->value, "false") == 0)
+	if (strcmp(str, "false") == 0)
 		*value = 0;
-	else if (strcmp(entry->value, "true") == 0)
+	else if (strcmp(str, "true") == 0)
 		*value = 1;
 	else {
 		*value = default_value;
@@ -339,92 +503,246 @@ weston_config_get_name_from_env(void)
 	return "weston.ini";
 }
 
+struct config_builder {
+	struct wl_array strings;	/* struct config_string */
+	struct wl_array sections;	/* struct weston_config_section */
+	struct wl_array entries;	/* struct weston_config_entry */
+	uint32_t *buckets;
+	uint32_t n_buckets;
+	uint32_t n_strings;
+};
+
+static struct config_string *
+builder_string(struct config_builder *b, uint32_t offset)
+{
+	return (struct config_string *)
+		((char *)b->strings.data + offset - CONFIG_STRINGS_BASE);
+}
+
+static int
+builder_grow_buckets(struct config_builder *b)
+{
+	struct config_string *s;
+	uint32_t *buckets, *bucket;
+	uint32_t n_buckets = b->n_buckets ? b->n_buckets * 2 : 64;
+	uint32_t offset, end;
+
+	buckets = calloc(n_buckets, sizeof *buckets);
+	if (!buckets)
+		return -1;
+
+	/* Relink in file order so every string still points to an older
+	 * one, which is what keeps snapshot chains free of cycles. */
+	end = CONFIG_STRINGS_BASE + b->strings.size;
+	for (offset = CONFIG_STRINGS_BASE; offset < end;
+	     offset += config_string_size(s->len)) {
+		s = builder_string(b, offset);
+		bucket = &buckets[s->hash & (n_buckets - 1)];
+		s->next = *bucket;
+		*bucket = offset;
+	}
+
+	free(b->buckets);
+	b->buckets = buckets;
+	b->n_buckets = n_buckets;
+
+	return 0;
+}
+
+static uint32_t
+builder_intern(struct config_builder *b, const char *str)
+{
+	struct config_string *s;
+	size_t len = strlen(str);
+	uint32_t hash = config_string_hash(str, len);
+	uint32_t offset, *bucket;
+
+	for (offset = b->buckets[hash & (b->n_buckets - 1)]; offset;
+	     offset = s->next) {
+		s = builder_string(b, offset);
+		if (s->hash == hash && s->len == len &&
+		    memcmp(s->data, str, len) == 0)
+			return offset;
+	}
+
+	if ((b->n_strings + 1) * 4 > b->n_buckets * 3 &&
+	    builder_grow_buckets(b) < 0)
+		return 0;
+
+	if (b->strings.size + config_string_size(len) > UINT32_MAX / 2)
+		return 0;
+
+	s = wl_array_add(&b->strings, config_string_size(len));
+	if (!s)
+		return 0;
+
+	memset(s, 0, config_string_size(len));
+	s->hash = hash;
+	s->len = len;
+	memcpy(s->data, str, len);
+
+	offset = CONFIG_STRINGS_BASE + ((char *)s - (char *)b->strings.data);
+	bucket = &b->buckets[hash & (b->n_buckets - 1)];
+	s->next = *bucket;
+	*bucket = offset;
+	b->n_strings++;
+
+	return offset;
+}
+
 static struct weston_config_section *
-config_add_section(struct weston_config *config, const char *name)
+config_add_section(struct config_builder *b, const char *name)
 {
-	struct weston_config_section *section;
+	struct weston_config_section *section, *sections;
+	struct config_string *s;
+	uint32_t offset, index, *next;
 
-	section = malloc(sizeof *section);
-	if (section == NULL)
+	offset = builder_intern(b, name);
+	if (!offset)
 		return NULL;
 
-	section->name = strdup(name);
-	if (section->name == NULL) {
-		free(section);
+	section = wl_array_add(&b->sections, sizeof *section);
+	if (section == NULL)
 		return NULL;
-	}
 
-	wl_list_init(&section->entry_list);
-	wl_list_insert(config->section_list.prev, &section->link);
+	sections = b->sections.data;
+	index = section - sections;
+
+	section->self = 0;
+	section->name = offset;
+	section->next = 0;
+	section->first_entry = b->entries.size /
+			       sizeof(struct weston_config_entry);
+	section->n_entries = 0;
+
+	/* append to the sections sharing this name */
+	s = builder_string(b, offset);
+	for (next = &s->section; *next; next = &sections[*next - 1].next)
+		;
+	*next = index + 1;
 
 	return section;
 }
 
 static struct weston_config_entry *
-section_add_entry(struct weston_config_section *section,
+section_add_entry(struct config_builder *b,
+		  struct weston_config_section *section,
 		  const char *key, const char *value)
 {
 	struct weston_config_entry *entry;
+	uint32_t k, v;
 
-	entry = malloc(sizeof *entry);
-	if (entry == NULL)
-		return NULL;
-
-	entry->key = strdup(key);
-	if (entry->key == NULL) {
-		free(entry);
+	k = builder_intern(b, key);
+	v = builder_intern(b, value);
+	if (!k || !v)
 		return NULL;
-	}
 
-	entry->value = strdup(value);
-	if (entry->value == NULL) {
-		free(entry->key);
-		free(entry);
+	entry = wl_array_add(&b->entries, sizeof *entry);
+	if (entry == NULL)
 		return NULL;
-	}
 
-	wl_list_insert(section->entry_list.prev, &entry->link);
+	entry->key = k;
+	entry->value = v;
+	section->n_entries++;
 
 	return entry;
 }
 
-WL_EXPORT
-struct weston_config *
-weston_config_parse(const char *name)
+static void
+config_builder_release(struct config_builder *b)
 {
-	FILE *fp;
-	char line[512], *p;
-	struct stat filestat;
-	struct weston_config *config;
-	struct weston_config_section *section = NULL;
-	int i, fd;
+	wl_array_release(&b->strings);
+	wl_array_release(&b->sections);
+	wl_array_release(&b->entries);
+	free(b->buckets);
+}
 
-	config = malloc(sizeof *config);
-	if (config == NULL)
+static struct config_block *
+config_builder_finish(struct config_builder *b)
+{
+	struct config_block *block;
+	struct weston_config_section *sections;
+	uint64_t size;
+	uint32_t i;
+
+	size = (uint64_t)CONFIG_STRINGS_BASE + b->strings.size +
+	       b->sections.size + b->entries.size +
+	       (uint64_t)b->n_buckets * sizeof(uint32_t);
+	if (size > UINT32_MAX)
 		return NULL;
 
-	wl_list_init(&config->section_list);
-
-	fd = open_config_file(config, name);
-	if (fd == -1) {
-		free(config);
+	block = calloc(1, size);
+	if (block == NULL)
 		return NULL;
-	}
 
-	if (fstat(fd, &filestat) < 0 ||
-	    !S_ISREG(filestat.st_mode)) {
-		close(fd);
-		free(config);
-		return NULL;
+	memcpy(block->magic, CONFIG_SNAPSHOT_MAGIC, sizeof block->magic);
+	block->version = CONFIG_SNAPSHOT_VERSION;
+	block->size = size;
+
+	block->n_sections = b->sections.size / sizeof *sections;
+	block->sections = CONFIG_STRINGS_BASE + b->strings.size;
+	block->n_entries = b->entries.size /
+			   sizeof(struct weston_config_entry);
+	block->entries = block->sections + b->sections.size;
+	block->n_buckets = b->n_buckets;
+	block->buckets = block->entries + b->entries.size;
+
+	memcpy((char *)block + CONFIG_STRINGS_BASE,
+	       b->strings.data, b->strings.size);
+	memcpy((char *)block + block->sections,
+	       b->sections.data, b->sections.size);
+	memcpy((char *)block + block->entries,
+	       b->entries.data, b->entries.size);
+	memcpy((char *)block + block->buckets,
+	       b->buckets, b->n_buckets * sizeof(uint32_t));
+
+	sections = (struct weston_config_section *)
+		((char *)block + block->sections);
+	for (i = 0; i < block->n_sections; i++)
+		sections[i].self = block->sections + i * sizeof *sections;
+
+	return block;
+}
+
+/* Same line splitting as fgets() into a buffer of the given size. */
+static bool
+config_read_line(const char **cursor, const char *end,
+		 char *line, size_t size)
+{
+	const char *p = *cursor;
+	size_t n = 0;
+
+	if (p == end)
+		return false;
+
+	while (p < end && n < size - 1) {
+		line[n++] = *p;
+		if (*p++ == '\n')
+			break;
 	}
+	line[n] = '\0';
+	*cursor = p;
 
-	fp = fdopen(fd, "r");
-	if (fp == NULL) {
-		free(config);
+	return true;
+}
+
+static struct config_block *
+config_compile(const char *data, size_t len)
+{
+	struct config_builder b = { 0 };
+	struct config_block *block = NULL;
+	const char *cursor = data, *end = data + len;
+	char line[512], *p;
+	struct weston_config_section *section = NULL;
+	int i;
+
+	wl_array_init(&b.strings);
+	wl_array_init(&b.sections);
+	wl_array_init(&b.entries);
+	if (builder_grow_buckets(&b) < 0)
 		return NULL;
-	}
 
-	while (fgets(line, sizeof line, fp)) {
+	while (config_read_line(&cursor, end, line, sizeof line)) {
 		switch (line[0]) {
 		case '#':
 		case '\n':
@@ -434,21 +752,19 @@ weston_config_parse(const char *name)
 			if (!p || p[1] != '\n') {
 				fprintf(stderr, "malformed "
 					"section header: %s\n", line);
-				fclose(fp);
-				weston_config_destroy(config);
-				return NULL;
+				goto out;
 			}
 			p[0] = '\0';
-			section = config_add_section(config, &line[1]);
+			section = config_add_section(&b, &line[1]);
+			if (!section)
+				goto out;
 			continue;
 		default:
 			p = strchr(line, '=');
 			if (!p || p == line || !section) {
 				fprintf(stderr, "malformed "
 					"config line: %s\n", line);
-				fclose(fp);
-				weston_config_destroy(config);
-				return NULL;
+				goto out;
 			}
 
 			p[0] = '\0';
@@ -460,16 +776,308 @@ weston_config_parse(const char *name)
 				p[i - 1] = '\0';
 				i--;
 			}
-			section_add_entry(section, line, p);
+			if (!section_add_entry(&b, section, line, p))
+				goto out;
+			continue;
+		}
+	}
+
+	block = config_builder_finish(&b);
+
+out:
+	config_builder_release(&b);
+
+	return block;
+}
+
+static bool
+config_block_is_string(const struct config_block *block,
+		       const uint8_t *starts, uint32_t offset)
+{
+	uint32_t bit;
+
+	if (offset < CONFIG_STRINGS_BASE || offset >= block->sections ||
+	    offset % 4)
+		return false;
+
+	bit = (offset - CONFIG_STRINGS_BASE) / 4;
+
+	return starts[bit / 8] & (1 << (bit % 8));
+}
+
+static bool
+config_block_check_region(const struct config_block *block, uint32_t offset,
+			  uint64_t count, size_t size)
+{
+	return offset >= CONFIG_STRINGS_BASE && offset % 4 == 0 &&
+	       offset + count * size <= block->size;
+}
+
+/* A snapshot comes from disk, so check every offset before use. */
+static bool
+config_block_validate(const struct config_block *block)
+{
+	const struct weston_config_section *sections;
+	const struct weston_config_entry *entries;
+	const struct config_string *s;
+	const uint32_t *buckets;
+	uint8_t *starts;
+	uint32_t offset, i;
+	bool ok = false;
+
+	if (!config_block_check_region(block, block->sections,
+				       block->n_sections, sizeof *sections) ||
+	    !config_block_check_region(block, block->entries,
+				       block->n_entries, sizeof *entries) ||
+	    !config_block_check_region(block, block->buckets,
+				       block->n_buckets, sizeof *buckets) ||
+	    block->n_buckets == 0 ||
+	    (block->n_buckets & (block->n_buckets - 1)) != 0)
+		return false;
+
+	starts = calloc((block->sections - CONFIG_STRINGS_BASE) / 32 + 1, 1);
+	if (!starts)
+		return false;
+
+	offset = CONFIG_STRINGS_BASE;
+	while (offset < block->sections) {
+		s = block_string(block, offset);
+		if (block->sections - offset < sizeof *s ||
+		    s->len >= block->sections - offset - sizeof *s ||
+		    s->data[s->len] != '\0' ||
+		    s->hash != config_string_hash(s->data, s->len) ||
+		    s->section > block->n_sections)
+			goto out;
+
+		/* chains only point backwards, see builder_grow_buckets() */
+		if (s->next && (s->next >= offset ||
+		    !config_block_is_string(block, starts, s->next)))
+			goto out;
+
+		i = (offset - CONFIG_STRINGS_BASE) / 4;
+		starts[i / 8] |= 1 << (i % 8);
+		offset += config_string_size(s->len);
+	}
+	if (offset != block->sections)
+		goto out;
+
+	buckets = config_at(block, block->buckets);
+	for (i = 0; i < block->n_buckets; i++)
+		if (buckets[i] &&
+		    !config_block_is_string(block, starts, buckets[i]))
+			goto out;
+
+	sections = block_sections(block);
+	for (i = 0; i < block->n_sections; i++) {
+		if (sections[i].self != block->sections + i * sizeof *sections ||
+		    !config_block_is_string(block, starts, sections[i].name) ||
+		    (sections[i].next && sections[i].next <= i + 1) ||
+		    sections[i].next > block->n_sections ||
+		    sections[i].first_entry > block->n_entries ||
+		    sections[i].n_entries >
+		    block->n_entries - sections[i].first_entry)
+			goto out;
+	}
+
+	entries = config_at(block, block->entries);
+	for (i = 0; i < block->n_entries; i++)
+		if (!config_block_is_string(block, starts, entries[i].key) ||
+		    !config_block_is_string(block, starts, entries[i].value))
+			goto out;
+
+	ok = true;
+
+out:
+	free(starts);
+	return ok;
+}
+
+static struct config_block *
+config_map_snapshot(const char *path, const struct config_block *source)
+{
+	struct config_block *block;
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size < (off_t)sizeof *block || st.st_size > UINT32_MAX) {
+		close(fd);
+		return NULL;
+	}
+
+	block = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (block == MAP_FAILED)
+		return NULL;
+
+	if (memcmp(block->magic, CONFIG_SNAPSHOT_MAGIC,
+		   sizeof block->magic) != 0 ||
+	    block->version != CONFIG_SNAPSHOT_VERSION ||
+	    block->size != st.st_size ||
+	    block->source_path_hash != source->source_path_hash ||
+	    block->source_mtime != source->source_mtime ||
+	    block->source_size != source->source_size ||
+	    block->source_hash != source->source_hash ||
+	    !config_block_validate(block)) {
+		munmap(block, st.st_size);
+		return NULL;
+	}
+
+	return block;
+}
+
+static void
+config_write_snapshot(const char *path, const struct config_block *block)
+{
+	char tmp[PATH_MAX];
+	const char *p = (const char *)block;
+	size_t len = block->size;
+	ssize_t ret;
+	int fd;
+
+	if (snprintf(tmp, sizeof tmp, "%s.XXXXXX", path) >= (int)sizeof tmp)
+		return;
+
+	fd = mkostemp(tmp, O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	while (len > 0) {
+		ret = write(fd, p, len);
+		if (ret < 0 && errno == EINTR)
 			continue;
+		if (ret <= 0) {
+			close(fd);
+			unlink(tmp);
+			return;
 		}
+		p += ret;
+		len -= ret;
 	}
 
-	fclose(fp);
+	/* replace atomically, a concurrent reader sees old or new */
+	if (close(fd) < 0 || rename(tmp, path) < 0)
+		unlink(tmp);
+}
+
+static char *
+config_read_file(int fd, size_t size)
+{
+	char *data;
+	size_t len = 0;
+	ssize_t ret;
+
+	data = malloc(size + 1);
+	if (data == NULL)
+		return NULL;
+
+	while (len < size) {
+		ret = read(fd, data + len, size - len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+
+	if (len != size) {
+		free(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+/** Parse a configuration file, going through a precompiled snapshot
+ *
+ * \param name The config file name, see weston_config_parse().
+ * \param snapshot Path of the snapshot file, or NULL to not use one.
+ *
+ * When the snapshot was compiled from the same file with the same
+ * modification time, size and contents it is mapped instead of parsing
+ * the file again. Otherwise the file is parsed and the snapshot is
+ * replaced; failing to write it is not an error.
+ */
+WL_EXPORT
+struct weston_config *
+weston_config_parse_with_snapshot(const char *name, const char *snapshot)
+{
+	struct stat filestat;
+	struct config_block source;
+	struct weston_config *config;
+	char *data;
+	int fd;
+
+	config = calloc(1, sizeof *config);
+	if (config == NULL)
+		return NULL;
+
+	fd = open_config_file(config, name);
+	if (fd == -1) {
+		free(config);
+		return NULL;
+	}
+
+	if (fstat(fd, &filestat) < 0 ||
+	    !S_ISREG(filestat.st_mode)) {
+		close(fd);
+		free(config);
+		return NULL;
+	}
+
+	data = config_read_file(fd, filestat.st_size);
+	close(fd);
+	if (data == NULL) {
+		free(config);
+		return NULL;
+	}
+
+	source.source_path_hash = config_hash(config->path,
+					      strlen(config->path));
+	source.source_mtime = (uint64_t)filestat.st_mtim.tv_sec * 1000000000 +
+			      filestat.st_mtim.tv_nsec;
+	source.source_size = filestat.st_size;
+	source.source_hash = config_hash(data, filestat.st_size);
+
+	if (snapshot && snapshot[0]) {
+		config->block = config_map_snapshot(snapshot, &source);
+		config->mapped = config->block != NULL;
+	}
+
+	if (!config->block) {
+		config->block = config_compile(data, filestat.st_size);
+		if (config->block && snapshot && snapshot[0]) {
+			config->block->source_path_hash =
+				source.source_path_hash;
+			config->block->source_mtime = source.source_mtime;
+			config->block->source_size = source.source_size;
+			config->block->source_hash = source.source_hash;
+			config_write_snapshot(snapshot, config->block);
+		}
+	}
+
+	free(data);
+
+	if (!config->block) {
+		free(config);
+		return NULL;
+	}
 
 	return config;
 }
 
+WL_EXPORT
+struct weston_config *
+weston_config_parse(const char *name)
+{
+	return weston_config_parse_with_snapshot(name,
+			getenv(WESTON_CONFIG_SNAPSHOT_ENV_VAR));
+}
+
 const char *
 weston_config_get_full_path(struct weston_config *config)
 {
@@ -482,20 +1090,22 @@ weston_config_next_section(struct weston_config *config,
 			   struct weston_config_section **section,
 			   const char **name)
 {
+	const struct config_block *block;
+	const struct weston_config_section *sections;
+	uint32_t i;
+
 	if (config == NULL)
 		return 0;
 
-	if (*section == NULL)
-		*section = container_of(config->section_list.next,
-					struct weston_config_section, link);
-	else
-		*section = container_of((*section)->link.next,
-					struct weston_config_section, link);
+	block = config->block;
+	sections = block_sections(block);
 
-	if (&(*section)->link == &config->section_list)
+	i = *section == NULL ? 0 : *section - sections + 1;
+	if (i >= block->n_sections)
 		return 0;
 
-	*name = (*section)->name;
+	*section = (struct weston_config_section *)&sections[i];
+	*name = block_str(block, sections[i].name);
 
 	return 1;
 }
@@ -503,21 +1113,13 @@ weston_config_next_section(struct weston_config *config,
 void
 weston_config_destroy(struct weston_config *config)
 {
-	struct weston_config_section *s, *next_s;
-	struct weston_config_entry *e, *next_e;
-
 	if (config == NULL)
 		return;
 
-	wl_list_for_each_safe(s, next_s, &config->section_list, link) {
-		wl_list_for_each_safe(e, next_e, &s->entry_list, link) {
-			free(e->key);
-			free(e->value);
-			free(e);
-		}
-		free(s->name);
-		free(s);
-	}
+	if (config->mapped)
+		munmap(config->block, config->block->size);
+	else
+		free(config->block);
 
 	free(config);
 }
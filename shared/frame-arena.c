@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "frame-arena.h"
+
+#define FRAME_ARENA_MIN_CHUNK	4096
+#define FRAME_ARENA_ALIGN	sizeof(void *)
+
+struct frame_arena_chunk {
+	struct frame_arena_chunk *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+static struct frame_arena_chunk *
+frame_arena_chunk_create(size_t min_size)
+{
+	struct frame_arena_chunk *chunk;
+	size_t size = FRAME_ARENA_MIN_CHUNK;
+
+	while (size < min_size)
+		size *= 2;
+
+	chunk = malloc(sizeof(*chunk) + size);
+	if (!chunk)
+		return NULL;
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+
+	return chunk;
+}
+
+static void
+frame_arena_free_chunks(struct frame_arena *arena)
+{
+	struct frame_arena_chunk *chunk, *next;
+
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	arena->chunks = NULL;
+}
+
+void
+frame_arena_init(struct frame_arena *arena)
+{
+	arena->chunks = NULL;
+	arena->used = 0;
+	arena->high_water = 0;
+}
+
+void
+frame_arena_release(struct frame_arena *arena)
+{
+	frame_arena_free_chunks(arena);
+	arena->used = 0;
+}
+
+void *
+frame_arena_alloc(struct frame_arena *arena, size_t size)
+{
+	struct frame_arena_chunk *chunk = arena->chunks;
+	void *ptr;
+
+	size = (size + FRAME_ARENA_ALIGN - 1) & ~(FRAME_ARENA_ALIGN - 1);
+
+	if (!chunk || chunk->size - chunk->used < size) {
+		size_t want = size;
+
+		if (chunk && chunk->size * 2 > want)
+			want = chunk->size * 2;
+
+		chunk = frame_arena_chunk_create(want);
+		if (!chunk)
+			return NULL;
+
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+
+	arena->used += size;
+	if (arena->used > arena->high_water)
+		arena->high_water = arena->used;
+
+	return ptr;
+}
+
+void
+frame_arena_reset(struct frame_arena *arena)
+{
+	if (arena->chunks && arena->chunks->next) {
+		frame_arena_free_chunks(arena);
+		arena->chunks = frame_arena_chunk_create(arena->high_water);
+	} else if (arena->chunks) {
+		arena->chunks->used = 0;
+	}
+
+	arena->used = 0;
+}
+
+unsigned
+frame_arena_chunk_count(const struct frame_arena *arena)
+{
+	const struct frame_arena_chunk *chunk;
+	unsigned count = 0;
+
+	for (chunk = arena->chunks; chunk; chunk = chunk->next)
+		count++;
+
+	return count;
+}
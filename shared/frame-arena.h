@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_FRAME_ARENA_H
+#define WESTON_FRAME_ARENA_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for memory that only has to live until the end of a
+ * frame. Everything is released in one go by frame_arena_reset(). If a
+ * frame spills over into more than one chunk, the chunks are folded into a
+ * single one sized for the busiest frame seen, so that in steady state a
+ * frame does not hit malloc at all.
+ */
+struct frame_arena_chunk;
+
+struct frame_arena {
+	/* chunk currently being filled comes first */
+	struct frame_arena_chunk *chunks;
+
+	/* bytes handed out this frame, and the most ever handed out in one */
+	size_t used;
+	size_t high_water;
+};
+
+void
+frame_arena_init(struct frame_arena *arena);
+
+void
+frame_arena_release(struct frame_arena *arena);
+
+void *
+frame_arena_alloc(struct frame_arena *arena, size_t size);
+
+void
+frame_arena_reset(struct frame_arena *arena);
+
+/* number of chunks backing the arena, 1 once it has settled */
+unsigned
+frame_arena_chunk_count(const struct frame_arena *arena);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_FRAME_ARENA_H */
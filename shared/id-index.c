@@ -0,0 +1,169 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "id-index.h"
+
+/*
+ * Open addressing with linear probing. A slot is empty when data is NULL
+ * and deleted when data points at id_index_deleted, so lookups keep
+ * probing past removed entries. Deleted slots are dropped whenever the
+ * table is rebuilt.
+ */
+struct id_index_entry {
+	uint32_t id;
+	void *data;
+};
+
+static char id_index_deleted;
+
+#define ID_INDEX_MIN_SIZE 64
+
+static uint32_t
+id_index_slot(const struct id_index *index, uint32_t id)
+{
+	/* ids are often small counters or masked pointers, so mix them
+	 * before taking the low bits */
+	return (id * 0x9e3779b1u) & (index->size - 1);
+}
+
+static int
+id_index_resize(struct id_index *index, uint32_t size)
+{
+	struct id_index_entry *old = index->entries;
+	uint32_t old_size = index->size;
+	uint32_t i, slot;
+
+	index->entries = calloc(size, sizeof *index->entries);
+	if (!index->entries) {
+		index->entries = old;
+		return -1;
+	}
+	index->size = size;
+	index->deleted = 0;
+
+	for (i = 0; i < old_size; i++) {
+		if (!old[i].data || old[i].data == &id_index_deleted)
+			continue;
+
+		slot = id_index_slot(index, old[i].id);
+		while (index->entries[slot].data)
+			slot = (slot + 1) & (size - 1);
+		index->entries[slot] = old[i];
+	}
+
+	free(old);
+
+	return 0;
+}
+
+void
+id_index_init(struct id_index *index)
+{
+	memset(index, 0, sizeof *index);
+}
+
+void
+id_index_release(struct id_index *index)
+{
+	free(index->entries);
+	id_index_init(index);
+}
+
+int
+id_index_insert(struct id_index *index, uint32_t id, void *data)
+{
+	uint32_t size = index->size ? index->size : ID_INDEX_MIN_SIZE;
+	uint32_t slot;
+
+	if (!data)
+		return -1;
+
+	/* keep at most half of the slots in use, counting deleted ones, so
+	 * probe sequences stay short */
+	if ((index->count + index->deleted + 1) * 2 > index->size) {
+		while ((index->count + 1) * 4 > size)
+			size *= 2;
+		if (id_index_resize(index, size) < 0)
+			return -1;
+	}
+
+	slot = id_index_slot(index, id);
+	while (index->entries[slot].data &&
+	       index->entries[slot].data != &id_index_deleted)
+		slot = (slot + 1) & (index->size - 1);
+
+	if (index->entries[slot].data == &id_index_deleted)
+		index->deleted--;
+	index->entries[slot].id = id;
+	index->entries[slot].data = data;
+	index->count++;
+
+	return 0;
+}
+
+void
+id_index_remove(struct id_index *index, uint32_t id, void *data)
+{
+	uint32_t slot;
+
+	if (!index->size)
+		return;
+
+	slot = id_index_slot(index, id);
+	while (index->entries[slot].data) {
+		if (index->entries[slot].id == id &&
+		    index->entries[slot].data == data) {
+			index->entries[slot].data = &id_index_deleted;
+			index->count--;
+			index->deleted++;
+			return;
+		}
+		slot = (slot + 1) & (index->size - 1);
+	}
+}
+
+void *
+id_index_lookup(const struct id_index *index, uint32_t id)
+{
+	uint32_t slot;
+
+	if (!index->size)
+		return NULL;
+
+	slot = id_index_slot(index, id);
+	while (index->entries[slot].data) {
+		if (index->entries[slot].id == id &&
+		    index->entries[slot].data != &id_index_deleted)
+			return index->entries[slot].data;
+		slot = (slot + 1) & (index->size - 1);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_ID_INDEX_H
+#define WESTON_ID_INDEX_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Hash index from 32-bit protocol ids to the objects they name, for shells
+ * that otherwise resolve every request by walking their surface lists.
+ *
+ * The same id may be present more than once, paired with different
+ * objects. id_index_lookup() then returns any one of them, which is what a
+ * list walk did as well. Objects are never dereferenced by the index.
+ */
+struct id_index_entry;
+
+struct id_index {
+	struct id_index_entry *entries;
+	uint32_t size;		/* always 0 or a power of two */
+	uint32_t count;
+	uint32_t deleted;
+};
+
+void
+id_index_init(struct id_index *index);
+
+void
+id_index_release(struct id_index *index);
+
+int
+id_index_insert(struct id_index *index, uint32_t id, void *data);
+
+void
+id_index_remove(struct id_index *index, uint32_t id, void *data);
+
+void *
+id_index_lookup(const struct id_index *index, uint32_t id);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_ID_INDEX_H */
@@ -26,15 +26,24 @@
 
 #include "config.h"
 
+#include <dirent.h>
+#include <endian.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <png.h>
 #include <pixman.h>
 
 #include "shared/helpers.h"
+#include "shared/pixel-convert.h"
 #include "image-loader.h"
 
 #ifdef HAVE_JPEG
@@ -59,21 +68,6 @@ pixman_image_destroy_func(pixman_image_t *image, void *data)
 
 #ifdef HAVE_JPEG
 
-static void
-swizzle_row(JSAMPLE *row, JDIMENSION width)
-{
-	JSAMPLE *s;
-	uint32_t *d;
-
-	s = row + (width - 1) * 3;
-	d = (uint32_t *) (row + (width - 1) * 4);
-	while (s >= row) {
-		*d = 0xff000000 | (s[0] << 16) | (s[1] << 8) | (s[2] << 0);
-		s -= 3;
-		d--;
-	}
-}
-
 static void
 error_exit(j_common_ptr cinfo)
 {
@@ -87,15 +81,21 @@ load_jpeg(FILE *fp)
 	struct jpeg_error_mgr jerr;
 	pixman_image_t *pixman_image = NULL;
 	unsigned int i;
-	int stride, first;
-	JSAMPLE *data, *rows[4];
+	int stride, first, count;
+	JSAMPLE *volatile data = NULL;
+	JSAMPLE *volatile scanlines = NULL;
+	JSAMPLE *rows[4];
 	jmp_buf env;
 
 	cinfo.err = jpeg_std_error(&jerr);
 	jerr.error_exit = error_exit;
 	cinfo.client_data = env;
-	if (setjmp(env))
+	if (setjmp(env)) {
+		free(data);
+		free(scanlines);
+		jpeg_destroy_decompress(&cinfo);
 		return NULL;
+	}
 
 	jpeg_create_decompress(&cinfo);
 
@@ -108,22 +108,34 @@ load_jpeg(FILE *fp)
 
 	stride = cinfo.output_width * 4;
 	data = malloc(stride * cinfo.output_height);
-	if (data == NULL) {
+	scanlines = malloc(cinfo.output_width * 3 * ARRAY_LENGTH(rows));
+	if (data == NULL || scanlines == NULL) {
 		fprintf(stderr, "couldn't allocate image data\n");
+		free(data);
+		free(scanlines);
+		jpeg_destroy_decompress(&cinfo);
 		return NULL;
 	}
 
+	for (i = 0; i < ARRAY_LENGTH(rows); i++)
+		rows[i] = scanlines + i * cinfo.output_width * 3;
+
 	while (cinfo.output_scanline < cinfo.output_height) {
 		first = cinfo.output_scanline;
-		for (i = 0; i < ARRAY_LENGTH(rows); i++)
-			rows[i] = data + (first + i) * stride;
-
-		jpeg_read_scanlines(&cinfo, rows, ARRAY_LENGTH(rows));
-		for (i = 0; first + i < cinfo.output_scanline; i++)
-			swizzle_row(rows[i], cinfo.output_width);
+		count = jpeg_read_scanlines(&cinfo, rows, ARRAY_LENGTH(rows));
+
+		/* libjpeg writes R, G, B: pixman's r8g8b8 with red and
+		 * blue swapped */
+		pixel_convert_rgb24_to_xrgb(data + first * stride, stride,
+					    scanlines, cinfo.output_width * 3,
+					    cinfo.output_width, count,
+					    PIXEL_CONVERT_SWAP_RB);
 	}
 
+	/* finish can still fail on a corrupt trailer, which frees the
+	 * scanlines from the error handler */
 	jpeg_finish_decompress(&cinfo);
+	free(scanlines);
 
 	jpeg_destroy_decompress(&cinfo);
 
@@ -149,44 +161,36 @@ load_jpeg(FILE *fp)
 
 #endif
 
-static inline int
-multiply_alpha(int alpha, int color)
+#if __BYTE_ORDER != __LITTLE_ENDIAN
+static inline uint32_t
+multiply_alpha(uint32_t alpha, uint32_t color)
 {
-    int temp = (alpha * color) + 0x80;
+	uint32_t temp = (alpha * color) + 0x80;
 
-    return ((temp + (temp >> 8)) >> 8);
+	return ((temp + (temp >> 8)) >> 8);
 }
 
+/* The pixel-convert kernels read native words, which only match libpng's
+ * byte order on little-endian; this is the byte-wise equivalent. */
 static void
-premultiply_data(png_structp   png,
-		 png_row_infop row_info,
-		 png_bytep     data)
+premultiply_rgba(uint8_t *data, int stride, int width, int height)
 {
-    unsigned int i;
-    png_bytep p;
-
-    for (i = 0, p = data; i < row_info->rowbytes; i += 4, p += 4) {
-	png_byte  alpha = p[3];
-	uint32_t w;
-
-	if (alpha == 0) {
-		w = 0;
-	} else {
-		png_byte red   = p[0];
-		png_byte green = p[1];
-		png_byte blue  = p[2];
-
-		if (alpha != 0xff) {
-			red   = multiply_alpha(alpha, red);
-			green = multiply_alpha(alpha, green);
-			blue  = multiply_alpha(alpha, blue);
+	uint8_t *p;
+	uint32_t a;
+	int x, y;
+
+	for (y = 0; y < height; y++) {
+		p = data + y * stride;
+		for (x = 0; x < width; x++, p += 4) {
+			a = p[3];
+			*(uint32_t *)p = a << 24 |
+					 multiply_alpha(a, p[0]) << 16 |
+					 multiply_alpha(a, p[1]) << 8 |
+					 multiply_alpha(a, p[2]);
 		}
-		w = (alpha << 24) | (red << 16) | (green << 8) | (blue << 0);
 	}
-
-	* (uint32_t *) p = w;
-    }
 }
+#endif
 
 static void
 read_func(png_structp png, png_bytep data, png_size_t size)
@@ -264,7 +268,6 @@ load_png(FILE *fp)
 		png_set_interlace_handling(png);
 
 	png_set_filler(png, 0xff, PNG_FILLER_AFTER);
-	png_set_read_user_transform_fn(png, premultiply_data);
 	png_read_update_info(png, info);
 	png_get_IHDR(png, info,
 		     &width, &height, &depth,
@@ -294,6 +297,14 @@ load_png(FILE *fp)
 	free(row_pointers);
 	png_destroy_read_struct(&png, &info, NULL);
 
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	/* R, G, B, A in memory reads as a8b8g8r8 here */
+	pixel_convert_premultiply(data, stride, data, stride, width, height,
+				  PIXEL_CONVERT_SWAP_RB);
+#else
+	premultiply_rgba(data, stride, width, height);
+#endif
+
 	pixman_image = pixman_image_create_bits(PIXMAN_a8r8g8b8,
 				width, height, (uint32_t *) data, stride);
 
@@ -393,32 +404,352 @@ static const struct image_loader loaders[] = {
 	{ { 'R', 'I', 'F', 'F' }, 4, load_webp }
 };
 
-pixman_image_t *
-load_image(const char *filename)
+/*
+ * With IMAGE_LOAD_CACHE, decoded images are kept in
+ * $XDG_RUNTIME_DIR/weston-image-cache, one file per source file. A hit
+ * maps the pixels copy-on-write instead of reading and decoding the
+ * source, so the shell's assets are decoded once per session rather than
+ * at every launch. The runtime dir is usually RAM backed, hence the small
+ * cap. Entries are keyed on the source's device, inode, size and mtime,
+ * which are checked again on every hit. WESTON_IMAGE_CACHE=0 in the
+ * environment disables the cache.
+ */
+#define IMAGE_CACHE_DIR "weston-image-cache"
+#define IMAGE_CACHE_MAGIC 0x32434957 /* "WIC2" */
+#define IMAGE_CACHE_MAX_BYTES (32 * 1024 * 1024)
+#define IMAGE_CACHE_MAX_DIM 16384
+
+struct image_cache_key {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+};
+
+struct image_cache_header {
+	uint32_t magic;
+	int32_t width;
+	int32_t height;
+	int32_t stride;
+	struct image_cache_key key;
+};
+
+struct image_cache_entry {
+	char *name;
+	off_t size;
+	time_t mtime;
+};
+
+static void
+image_cache_key_from_stat(struct image_cache_key *key, const struct stat *st)
+{
+	memset(key, 0, sizeof *key);
+	key->dev = st->st_dev;
+	key->ino = st->st_ino;
+	key->size = st->st_size;
+	key->mtime_sec = st->st_mtim.tv_sec;
+	key->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+/* FNV-1a */
+static uint64_t
+image_hash(const uint8_t *data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static char *
+image_cache_dir(void)
+{
+	const char *env = getenv("WESTON_IMAGE_CACHE");
+	const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+	char *dir;
+
+	if ((env && strcmp(env, "0") == 0) || !runtime_dir)
+		return NULL;
+
+	if (asprintf(&dir, "%s/%s", runtime_dir, IMAGE_CACHE_DIR) < 0)
+		return NULL;
+
+	if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+		free(dir);
+		return NULL;
+	}
+
+	return dir;
+}
+
+/* Computed wide: the header may come from a damaged file. */
+static uint64_t
+image_cache_file_size(const struct image_cache_header *header)
+{
+	return sizeof *header + (uint64_t)header->stride * header->height;
+}
+
+static void
+image_cache_unmap(pixman_image_t *image, void *data)
+{
+	munmap(data, image_cache_file_size(data));
+}
+
+static pixman_image_t *
+image_cache_lookup(const char *path, const struct image_cache_key *key)
+{
+	const struct image_cache_header *header;
+	pixman_image_t *image;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof *header ||
+	    st.st_size > IMAGE_CACHE_MAX_BYTES) {
+		close(fd);
+		return NULL;
+	}
+
+	/* private and writable: users may draw into the image */
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		   fd, 0);
+	/* keep recently used entries from being evicted first */
+	futimens(fd, NULL);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	header = map;
+	if (header->magic != IMAGE_CACHE_MAGIC ||
+	    memcmp(&header->key, key, sizeof *key) != 0 ||
+	    header->width <= 0 || header->width > IMAGE_CACHE_MAX_DIM ||
+	    header->height <= 0 || header->height > IMAGE_CACHE_MAX_DIM ||
+	    header->stride < 0 ||
+	    (uint64_t)header->stride < (uint64_t)header->width * 4 ||
+	    header->stride % 4 != 0 ||
+	    image_cache_file_size(header) != (uint64_t)st.st_size) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	image = pixman_image_create_bits(PIXMAN_a8r8g8b8,
+					 header->width, header->height,
+					 (uint32_t *)(header + 1),
+					 header->stride);
+	if (!image) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	pixman_image_set_destroy_function(image, image_cache_unmap, map);
+
+	return image;
+}
+
+static int
+image_cache_entry_compare(const void *a, const void *b)
+{
+	const struct image_cache_entry *entry_a = a;
+	const struct image_cache_entry *entry_b = b;
+
+	return (entry_a->mtime > entry_b->mtime) -
+	       (entry_a->mtime < entry_b->mtime);
+}
+
+/* Removes the least recently used entries until size more bytes fit. */
+static void
+image_cache_evict(const char *dir, size_t size)
+{
+	struct image_cache_entry *entries = NULL, *resized;
+	int count = 0, capacity = 0, i;
+	uint64_t total = size;
+	struct dirent *de;
+	struct stat st;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return;
+
+	while ((de = readdir(d))) {
+		/* skips ".", ".." and files still being written */
+		if (de->d_name[0] == '.')
+			continue;
+		if (fstatat(dirfd(d), de->d_name, &st, 0) < 0 ||
+		    !S_ISREG(st.st_mode))
+			continue;
+
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 16;
+			resized = realloc(entries, capacity * sizeof *entries);
+			if (!resized)
+				break;
+			entries = resized;
+		}
+		entries[count].name = strdup(de->d_name);
+		entries[count].size = st.st_size;
+		entries[count].mtime = st.st_mtime;
+		if (!entries[count].name)
+			break;
+		total += st.st_size;
+		count++;
+	}
+
+	if (total > IMAGE_CACHE_MAX_BYTES) {
+		qsort(entries, count, sizeof *entries,
+		      image_cache_entry_compare);
+		for (i = 0; i < count && total > IMAGE_CACHE_MAX_BYTES; i++) {
+			if (unlinkat(dirfd(d), entries[i].name, 0) == 0)
+				total -= entries[i].size;
+		}
+	}
+
+	for (i = 0; i < count; i++)
+		free(entries[i].name);
+	free(entries);
+	closedir(d);
+}
+
+static bool
+write_all(int fd, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	ssize_t len;
+
+	while (size > 0) {
+		len = write(fd, p, size);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			return false;
+		p += len;
+		size -= len;
+	}
+
+	return true;
+}
+
+static void
+image_cache_store(const char *dir, const char *path,
+		  const struct image_cache_key *key, pixman_image_t *image)
+{
+	struct image_cache_header header = {
+		.magic = IMAGE_CACHE_MAGIC,
+		.width = pixman_image_get_width(image),
+		.height = pixman_image_get_height(image),
+		.stride = pixman_image_get_stride(image),
+		.key = *key,
+	};
+	char *tmp;
+	bool ok;
+	int fd;
+
+	/* one entry may take at most a quarter of the cache */
+	if (pixman_image_get_format(image) != PIXMAN_a8r8g8b8 ||
+	    header.width <= 0 || header.width > IMAGE_CACHE_MAX_DIM ||
+	    header.height <= 0 || header.height > IMAGE_CACHE_MAX_DIM ||
+	    image_cache_file_size(&header) > IMAGE_CACHE_MAX_BYTES / 4)
+		return;
+
+	image_cache_evict(dir, image_cache_file_size(&header));
+
+	if (asprintf(&tmp, "%s/.tmp-XXXXXX", dir) < 0)
+		return;
+
+	/* written aside and renamed, so readers never see a partial file */
+	fd = mkostemp(tmp, O_CLOEXEC);
+	if (fd < 0) {
+		free(tmp);
+		return;
+	}
+
+	ok = write_all(fd, &header, sizeof header) &&
+	     write_all(fd, pixman_image_get_data(image),
+		       (size_t)header.stride * header.height);
+	close(fd);
+
+	if (!ok || rename(tmp, path) < 0)
+		unlink(tmp);
+	free(tmp);
+}
+
+/*
+ * Reads until end of file. The size from fstat() is only a first guess:
+ * it is 0 for pipes and FIFOs, and a file may grow while it is read.
+ */
+static int
+read_fd(int fd, const struct stat *st, uint8_t **contents, size_t *size)
+{
+	size_t alloc, done = 0;
+	uint8_t *data, *resized;
+	ssize_t len;
+
+	alloc = S_ISREG(st->st_mode) && st->st_size > 0 ?
+		(size_t)st->st_size + 1 : 64 * 1024;
+	data = malloc(alloc);
+	if (!data)
+		return -1;
+
+	for (;;) {
+		if (done == alloc) {
+			resized = realloc(data, alloc * 2);
+			if (!resized) {
+				free(data);
+				errno = ENOMEM;
+				return -1;
+			}
+			data = resized;
+			alloc *= 2;
+		}
+
+		len = read(fd, data + done, alloc - done);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0) {
+			free(data);
+			return -1;
+		}
+		if (len == 0)
+			break;
+		done += len;
+	}
+
+	*contents = data;
+	*size = done;
+
+	return 0;
+}
+
+static pixman_image_t *
+decode_image(const char *filename, const uint8_t *contents, size_t size)
 {
 	pixman_image_t *image = NULL;
-	unsigned char header[4];
 	FILE *fp;
 	unsigned int i;
 
-	if (!filename || !*filename)
+	if (size < 4) {
+		fprintf(stderr, "%s: unable to read file header\n", filename);
 		return NULL;
+	}
 
-	fp = fopen(filename, "rb");
+	fp = fmemopen((void *)contents, size, "rb");
 	if (!fp) {
 		fprintf(stderr, "%s: %s\n", filename, strerror(errno));
 		return NULL;
 	}
 
-	if (fread(header, sizeof header, 1, fp) != 1) {
-		fclose(fp);
-		fprintf(stderr, "%s: unable to read file header\n", filename);
-		return NULL;
-	}
-
-	rewind(fp);
 	for (i = 0; i < ARRAY_LENGTH(loaders); i++) {
-		if (memcmp(header, loaders[i].header,
+		if (memcmp(contents, loaders[i].header,
 			   loaders[i].header_size) == 0) {
 			image = loaders[i].load(fp);
 			break;
@@ -430,7 +761,8 @@ load_image(const char *filename)
 	if (i == ARRAY_LENGTH(loaders)) {
 		fprintf(stderr, "%s: unrecognized file header "
 			"0x%02x 0x%02x 0x%02x 0x%02x\n",
-			filename, header[0], header[1], header[2], header[3]);
+			filename, contents[0], contents[1], contents[2],
+			contents[3]);
 	} else if (!image) {
 		/* load probably printed something, but just in case */
 		fprintf(stderr, "%s: error reading image\n", filename);
@@ -438,3 +770,136 @@ load_image(const char *filename)
 
 	return image;
 }
+
+static pixman_image_t *
+load_image_flags(const char *filename, uint32_t flags)
+{
+	pixman_image_t *image = NULL;
+	struct image_cache_key key, key_after;
+	struct stat st, st_after;
+	uint8_t *contents;
+	size_t size;
+	char *dir = NULL, *path = NULL;
+	int fd;
+
+	if (!filename || !*filename)
+		return NULL;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+
+	/* only regular files have an identity worth caching under */
+	if ((flags & IMAGE_LOAD_CACHE) && S_ISREG(st.st_mode))
+		dir = image_cache_dir();
+	if (dir) {
+		image_cache_key_from_stat(&key, &st);
+		if (asprintf(&path, "%s/%016" PRIx64, dir,
+			     image_hash((const uint8_t *)&key,
+					sizeof key)) < 0)
+			path = NULL;
+	}
+
+	if (path)
+		image = image_cache_lookup(path, &key);
+
+	if (!image) {
+		if (read_fd(fd, &st, &contents, &size) < 0) {
+			fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+		} else {
+			image = decode_image(filename, contents, size);
+			free(contents);
+		}
+
+		/* do not file a decode under a key the file no longer has */
+		if (image && path && fstat(fd, &st_after) == 0) {
+			image_cache_key_from_stat(&key_after, &st_after);
+			if (memcmp(&key, &key_after, sizeof key) == 0)
+				image_cache_store(dir, path, &key, image);
+		}
+	}
+
+	close(fd);
+	free(path);
+	free(dir);
+
+	return image;
+}
+
+pixman_image_t *
+load_image(const char *filename)
+{
+	return load_image_flags(filename, 0);
+}
+
+#define IMAGE_LOADER_MAX_THREADS 8
+
+struct image_batch {
+	pthread_mutex_t mutex;
+	uint32_t flags;
+	const char * const *filenames;
+	pixman_image_t **images;
+	int count;
+	int next;
+};
+
+static void *
+image_batch_worker(void *data)
+{
+	struct image_batch *batch = data;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&batch->mutex);
+		i = batch->next++;
+		pthread_mutex_unlock(&batch->mutex);
+
+		if (i >= batch->count)
+			break;
+
+		batch->images[i] = load_image_flags(batch->filenames[i],
+						   batch->flags);
+	}
+
+	return NULL;
+}
+
+void
+load_images(const char * const *filenames, int count,
+	    pixman_image_t **images, uint32_t flags)
+{
+	pthread_t threads[IMAGE_LOADER_MAX_THREADS - 1];
+	struct image_batch batch = {
+		.flags = flags,
+		.filenames = filenames,
+		.images = images,
+		.count = count,
+	};
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int wanted, started = 0;
+	int i;
+
+	/* the calling thread decodes too */
+	wanted = MIN(count, IMAGE_LOADER_MAX_THREADS) - 1;
+	if (cpus > 0 && wanted > cpus - 1)
+		wanted = cpus - 1;
+
+	pthread_mutex_init(&batch.mutex, NULL);
+
+	for (i = 0; i < wanted; i++) {
+		if (pthread_create(&threads[started], NULL,
+				   image_batch_worker, &batch) == 0)
+			started++;
+	}
+
+	image_batch_worker(&batch);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&batch.mutex);
+}
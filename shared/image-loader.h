@@ -26,9 +26,22 @@
 #ifndef _IMAGE_LOADER_H
 #define _IMAGE_LOADER_H
 
+#include <stdint.h>
 #include <pixman.h>
 
+enum image_load_flags {
+	/* keep the decoded pixels in $XDG_RUNTIME_DIR for the next load,
+	 * meant for a shell's own assets */
+	IMAGE_LOAD_CACHE = 1 << 0,
+};
+
 pixman_image_t *
 load_image(const char *filename);
 
+/* Loads count images at once on worker threads. images[i] is whatever
+ * load_image(filenames[i]) would have returned. */
+void
+load_images(const char * const *filenames, int count,
+	    pixman_image_t **images, uint32_t flags);
+
 #endif
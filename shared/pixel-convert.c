@@ -0,0 +1,972 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pixel-convert.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PIXEL_CONVERT_HAVE_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXEL_CONVERT_HAVE_NEON
+#endif
+
+/*
+ * BT.601 limited range in 8.8 fixed point. The sums stay inside 16 bits,
+ * which the NEON kernel relies on; the x86 kernels work in 32 bits.
+ */
+#define Y_R 66
+#define Y_G 129
+#define Y_B 25
+#define U_R -38
+#define U_G -74
+#define U_B 112
+#define V_R 112
+#define V_G -94
+#define V_B -18
+
+static inline void
+unpack_pixel(uint32_t p, bool swap_rb, int *r, int *g, int *b)
+{
+	*g = (p >> 8) & 0xff;
+	if (swap_rb) {
+		*r = p & 0xff;
+		*b = (p >> 16) & 0xff;
+	} else {
+		*r = (p >> 16) & 0xff;
+		*b = p & 0xff;
+	}
+}
+
+static inline uint8_t
+luma(uint32_t p, bool swap_rb)
+{
+	int r, g, b;
+
+	unpack_pixel(p, swap_rb, &r, &g, &b);
+
+	return ((Y_R * r + Y_G * g + Y_B * b + 128) >> 8) + 16;
+}
+
+static inline void
+chroma(const uint32_t p[4], bool swap_rb, uint8_t *uv)
+{
+	int r = 0, g = 0, b = 0;
+	int pr, pg, pb;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		unpack_pixel(p[i], swap_rb, &pr, &pg, &pb);
+		r += pr;
+		g += pg;
+		b += pb;
+	}
+	r = (r + 2) >> 2;
+	g = (g + 2) >> 2;
+	b = (b + 2) >> 2;
+
+	uv[0] = ((U_R * r + U_G * g + U_B * b + 128) >> 8) + 128;
+	uv[1] = ((V_R * r + V_G * g + V_B * b + 128) >> 8) + 128;
+}
+
+static void
+swap_rb_scalar(uint32_t *dst, const uint32_t *src, int width)
+{
+	uint32_t v;
+	int i;
+
+	for (i = 0; i < width; i++) {
+		v = src[i];
+		dst[i] = (v & 0xff00ff00) |
+			 ((v >> 16) & 0x000000ff) |
+			 ((v << 16) & 0x00ff0000);
+	}
+}
+
+static void
+pack_rgb24_scalar(uint8_t *dst, const uint32_t *src, int width, bool swap_rb)
+{
+	uint32_t v;
+	int i;
+
+	for (i = 0; i < width; i++) {
+		v = src[i];
+		if (swap_rb) {
+			dst[0] = v >> 16;
+			dst[2] = v;
+		} else {
+			dst[0] = v;
+			dst[2] = v >> 16;
+		}
+		dst[1] = v >> 8;
+		dst += 3;
+	}
+}
+
+static void
+unpack_rgb24_scalar(uint32_t *dst, const uint8_t *src, int width,
+		    bool swap_rb)
+{
+	int i;
+
+	for (i = 0; i < width; i++) {
+		if (swap_rb)
+			dst[i] = 0xff000000 | (src[0] << 16) |
+				 (src[1] << 8) | src[2];
+		else
+			dst[i] = 0xff000000 | (src[2] << 16) |
+				 (src[1] << 8) | src[0];
+		src += 3;
+	}
+}
+
+/* Converts from pixel x on; x must be even. */
+static void
+nv12_tail(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+	  const uint32_t *s0, const uint32_t *s1, int x, int width,
+	  bool swap_rb)
+{
+	uint32_t block[4];
+
+	for (; x < width; x += 2) {
+		block[0] = s0[x];
+		block[2] = s1[x];
+		if (x + 1 < width) {
+			block[1] = s0[x + 1];
+			block[3] = s1[x + 1];
+			y0[x + 1] = luma(block[1], swap_rb);
+			y1[x + 1] = luma(block[3], swap_rb);
+		} else {
+			block[1] = block[0];
+			block[3] = block[2];
+		}
+		y0[x] = luma(block[0], swap_rb);
+		y1[x] = luma(block[2], swap_rb);
+		chroma(block, swap_rb, &uv[x]);
+	}
+}
+
+static void
+nv12_scalar(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+	    const uint32_t *s0, const uint32_t *s1, int width, bool swap_rb)
+{
+	nv12_tail(y0, y1, uv, s0, s1, 0, width, swap_rb);
+}
+
+/* alpha * c / 255, rounded; exact for all 8-bit inputs */
+static inline uint32_t
+multiply_alpha(uint32_t alpha, uint32_t c)
+{
+	uint32_t t = alpha * c + 0x80;
+
+	return (t + (t >> 8)) >> 8;
+}
+
+static void
+premultiply_scalar(uint32_t *dst, const uint32_t *src, int width,
+		   bool swap_rb)
+{
+	uint32_t v, a;
+	int r, g, b;
+	int i;
+
+	for (i = 0; i < width; i++) {
+		v = src[i];
+		a = v >> 24;
+		unpack_pixel(v, swap_rb, &r, &g, &b);
+		dst[i] = (a << 24) | (multiply_alpha(a, r) << 16) |
+			 (multiply_alpha(a, g) << 8) | multiply_alpha(a, b);
+	}
+}
+
+static const struct pixel_convert_kernels kernels_scalar = {
+	swap_rb_scalar,
+	pack_rgb24_scalar,
+	unpack_rgb24_scalar,
+	nv12_scalar,
+	premultiply_scalar,
+};
+
+#ifdef PIXEL_CONVERT_HAVE_X86
+
+#define SHUF_SWAP_RB 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+#define SHUF_PACK 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+#define SHUF_PACK_SWAP 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+#define SHUF_UNPACK 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1
+#define SHUF_UNPACK_SWAP 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+#define SHUF_IDENTITY 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+/* alpha of each pixel into its colour bytes */
+#define SHUF_ALPHA 3, 3, 3, -1, 7, 7, 7, -1, 11, 11, 11, -1, 15, 15, 15, -1
+/* first byte of each dword, and the U/V interleave of [UA UB VA VB] */
+#define SHUF_LUMA 0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define SHUF_CHROMA 0, 8, 4, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+
+/* madd coefficients for 16-bit [B G R X] pixels */
+#define COEF(r, g, b, swap) \
+	((swap) ? _mm_set_epi16(0, b, g, r, 0, b, g, r) : \
+		  _mm_set_epi16(0, r, g, b, 0, r, g, b))
+
+__attribute__((target("sse4.1")))
+static void
+swap_rb_sse4(uint32_t *dst, const uint32_t *src, int width)
+{
+	const __m128i shuf = _mm_setr_epi8(SHUF_SWAP_RB);
+	__m128i a, b;
+	int i = 0;
+
+	for (; width - i >= 8; i += 8) {
+		a = _mm_loadu_si128((const __m128i *)(src + i));
+		b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(a, shuf));
+		_mm_storeu_si128((__m128i *)(dst + i + 4),
+				 _mm_shuffle_epi8(b, shuf));
+	}
+
+	swap_rb_scalar(dst + i, src + i, width - i);
+}
+
+__attribute__((target("sse4.1")))
+static void
+pack_rgb24_sse4(uint8_t *dst, const uint32_t *src, int width, bool swap_rb)
+{
+	const __m128i shuf = swap_rb ? _mm_setr_epi8(SHUF_PACK_SWAP) :
+				       _mm_setr_epi8(SHUF_PACK);
+	__m128i a, b, c, d;
+	int i = 0;
+
+	/* 16 pixels in, three full 16 byte stores out */
+	for (; width - i >= 16; i += 16) {
+		a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i)),
+				     shuf);
+		b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i + 4)),
+				     shuf);
+		c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i + 8)),
+				     shuf);
+		d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i + 12)),
+				     shuf);
+
+		_mm_storeu_si128((__m128i *)(dst + 3 * i),
+				 _mm_or_si128(a, _mm_slli_si128(b, 12)));
+		_mm_storeu_si128((__m128i *)(dst + 3 * i + 16),
+				 _mm_or_si128(_mm_srli_si128(b, 4),
+					      _mm_slli_si128(c, 8)));
+		_mm_storeu_si128((__m128i *)(dst + 3 * i + 32),
+				 _mm_or_si128(_mm_srli_si128(c, 8),
+					      _mm_slli_si128(d, 4)));
+	}
+
+	pack_rgb24_scalar(dst + 3 * i, src + i, width - i, swap_rb);
+}
+
+__attribute__((target("sse4.1")))
+static void
+unpack_rgb24_sse4(uint32_t *dst, const uint8_t *src, int width, bool swap_rb)
+{
+	const __m128i shuf = swap_rb ? _mm_setr_epi8(SHUF_UNPACK_SWAP) :
+				       _mm_setr_epi8(SHUF_UNPACK);
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	__m128i a, b, c;
+	int i = 0;
+
+	/* 48 bytes in, 16 pixels out */
+	for (; width - i >= 16; i += 16) {
+		a = _mm_loadu_si128((const __m128i *)(src + 3 * i));
+		b = _mm_loadu_si128((const __m128i *)(src + 3 * i + 16));
+		c = _mm_loadu_si128((const __m128i *)(src + 3 * i + 32));
+
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_or_si128(_mm_shuffle_epi8(a, shuf), alpha));
+		_mm_storeu_si128((__m128i *)(dst + i + 4),
+				 _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12),
+							       shuf), alpha));
+		_mm_storeu_si128((__m128i *)(dst + i + 8),
+				 _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8),
+							       shuf), alpha));
+		_mm_storeu_si128((__m128i *)(dst + i + 12),
+				 _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4),
+							       shuf), alpha));
+	}
+
+	unpack_rgb24_scalar(dst + i, src + 3 * i, width - i, swap_rb);
+}
+
+/*
+ * Four pixels of two rows: lo and hi hold pixels 0-1 and 2-3 of each row
+ * widened to 16 bits. Returns four luma values per row in the low dword
+ * of *l0 / *l1 and U0 V0 U1 V1 in the low dword of the result.
+ */
+__attribute__((target("sse4.1")))
+static inline __m128i
+nv12_block_sse4(__m128i lo0, __m128i hi0, __m128i lo1, __m128i hi1,
+		__m128i cy, __m128i cu, __m128i cv, __m128i *l0, __m128i *l1)
+{
+	const __m128i round = _mm_set1_epi32(128);
+	const __m128i offset_y = _mm_set1_epi32(16);
+	const __m128i shuf_luma = _mm_setr_epi8(SHUF_LUMA);
+	const __m128i shuf_chroma = _mm_setr_epi8(SHUF_CHROMA);
+	__m128i y, slo, shi, avg, uv;
+
+	y = _mm_hadd_epi32(_mm_madd_epi16(lo0, cy), _mm_madd_epi16(hi0, cy));
+	y = _mm_add_epi32(_mm_srli_epi32(_mm_add_epi32(y, round), 8), offset_y);
+	*l0 = _mm_shuffle_epi8(y, shuf_luma);
+
+	y = _mm_hadd_epi32(_mm_madd_epi16(lo1, cy), _mm_madd_epi16(hi1, cy));
+	y = _mm_add_epi32(_mm_srli_epi32(_mm_add_epi32(y, round), 8), offset_y);
+	*l1 = _mm_shuffle_epi8(y, shuf_luma);
+
+	/* 2x2 sums of [B G R X], block A in the low and B in the high half */
+	slo = _mm_add_epi16(lo0, lo1);
+	shi = _mm_add_epi16(hi0, hi1);
+	avg = _mm_add_epi16(_mm_unpacklo_epi64(slo, shi),
+			    _mm_unpackhi_epi64(slo, shi));
+	avg = _mm_srli_epi16(_mm_add_epi16(avg, _mm_set1_epi16(2)), 2);
+
+	uv = _mm_hadd_epi32(_mm_madd_epi16(avg, cu), _mm_madd_epi16(avg, cv));
+	uv = _mm_srai_epi32(_mm_add_epi32(uv, round), 8);
+	uv = _mm_add_epi32(uv, round);
+
+	return _mm_shuffle_epi8(uv, shuf_chroma);
+}
+
+__attribute__((target("sse4.1")))
+static void
+nv12_sse4(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+	  const uint32_t *s0, const uint32_t *s1, int width, bool swap_rb)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i cy = COEF(Y_R, Y_G, Y_B, swap_rb);
+	const __m128i cu = COEF(U_R, U_G, U_B, swap_rb);
+	const __m128i cv = COEF(V_R, V_G, V_B, swap_rb);
+	__m128i a, b, l0, l1, c;
+	uint32_t out;
+	int x = 0;
+
+	for (; width - x >= 4; x += 4) {
+		a = _mm_loadu_si128((const __m128i *)(s0 + x));
+		b = _mm_loadu_si128((const __m128i *)(s1 + x));
+
+		c = nv12_block_sse4(_mm_unpacklo_epi8(a, zero),
+				    _mm_unpackhi_epi8(a, zero),
+				    _mm_unpacklo_epi8(b, zero),
+				    _mm_unpackhi_epi8(b, zero),
+				    cy, cu, cv, &l0, &l1);
+
+		/* y1 may alias y0, so both stores go through memcpy */
+		out = _mm_cvtsi128_si32(l0);
+		memcpy(y0 + x, &out, 4);
+		out = _mm_cvtsi128_si32(l1);
+		memcpy(y1 + x, &out, 4);
+		out = _mm_cvtsi128_si32(c);
+		memcpy(uv + x, &out, 4);
+	}
+
+	nv12_tail(y0, y1, uv, s0, s1, x, width, swap_rb);
+}
+
+/* multiply_alpha() on 16-bit lanes; a * c + 0x80 fits in 16 bits */
+__attribute__((target("sse4.1")))
+static inline __m128i
+multiply_alpha_sse4(__m128i c, __m128i a)
+{
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a),
+				  _mm_set1_epi16(0x80));
+
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("sse4.1")))
+static void
+premultiply_sse4(uint32_t *dst, const uint32_t *src, int width, bool swap_rb)
+{
+	const __m128i shuf = swap_rb ? _mm_setr_epi8(SHUF_SWAP_RB) :
+				       _mm_setr_epi8(SHUF_IDENTITY);
+	const __m128i shuf_alpha = _mm_setr_epi8(SHUF_ALPHA);
+	/* alpha itself is multiplied by 255, i.e. kept */
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v, a, lo, hi;
+	int i = 0;
+
+	for (; width - i >= 4; i += 4) {
+		v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i)),
+				     shuf);
+		a = _mm_or_si128(_mm_shuffle_epi8(v, shuf_alpha), alpha);
+		lo = multiply_alpha_sse4(_mm_unpacklo_epi8(v, zero),
+					 _mm_unpacklo_epi8(a, zero));
+		hi = multiply_alpha_sse4(_mm_unpackhi_epi8(v, zero),
+					 _mm_unpackhi_epi8(a, zero));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+
+	premultiply_scalar(dst + i, src + i, width - i, swap_rb);
+}
+
+static const struct pixel_convert_kernels kernels_sse4 = {
+	swap_rb_sse4,
+	pack_rgb24_sse4,
+	unpack_rgb24_sse4,
+	nv12_sse4,
+	premultiply_sse4,
+};
+
+#define COEF256(r, g, b, swap) \
+	_mm256_broadcastsi128_si256(COEF(r, g, b, swap))
+
+__attribute__((target("avx2")))
+static void
+swap_rb_avx2(uint32_t *dst, const uint32_t *src, int width)
+{
+	const __m256i shuf = _mm256_setr_epi8(SHUF_SWAP_RB, SHUF_SWAP_RB);
+	__m256i a, b;
+	int i = 0;
+
+	for (; width - i >= 16; i += 16) {
+		a = _mm256_loadu_si256((const __m256i *)(src + i));
+		b = _mm256_loadu_si256((const __m256i *)(src + i + 8));
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_shuffle_epi8(a, shuf));
+		_mm256_storeu_si256((__m256i *)(dst + i + 8),
+				    _mm256_shuffle_epi8(b, shuf));
+	}
+
+	swap_rb_sse4(dst + i, src + i, width - i);
+}
+
+__attribute__((target("avx2")))
+static void
+pack_rgb24_avx2(uint8_t *dst, const uint32_t *src, int width, bool swap_rb)
+{
+	const __m256i shuf = swap_rb ?
+		_mm256_setr_epi8(SHUF_PACK_SWAP, SHUF_PACK_SWAP) :
+		_mm256_setr_epi8(SHUF_PACK, SHUF_PACK);
+	/* the 12 packed bytes of each lane next to each other */
+	const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	__m256i a, b;
+	int i = 0;
+
+	/* 16 pixels in, 48 bytes out as one 32 and one 16 byte store */
+	for (; width - i >= 16; i += 16) {
+		a = _mm256_loadu_si256((const __m256i *)(src + i));
+		b = _mm256_loadu_si256((const __m256i *)(src + i + 8));
+		a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(a, shuf),
+						compact);
+		b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(b, shuf),
+						compact);
+
+		/* a: 24 bytes, b: 24 bytes */
+		_mm256_storeu_si256((__m256i *)(dst + 3 * i),
+				    _mm256_blend_epi32(a,
+					_mm256_permutevar8x32_epi32(b,
+						_mm256_setr_epi32(0, 0, 0, 0,
+								  0, 0, 0, 1)),
+					0xc0));
+		_mm_storeu_si128((__m128i *)(dst + 3 * i + 32),
+				 _mm256_castsi256_si128(
+					_mm256_permutevar8x32_epi32(b,
+						_mm256_setr_epi32(2, 3, 4, 5,
+								  0, 0, 0, 0))));
+	}
+
+	pack_rgb24_sse4(dst + 3 * i, src + i, width - i, swap_rb);
+}
+
+__attribute__((target("avx2")))
+static void
+unpack_rgb24_avx2(uint32_t *dst, const uint8_t *src, int width, bool swap_rb)
+{
+	const __m256i shuf = swap_rb ?
+		_mm256_setr_epi8(SHUF_UNPACK_SWAP, SHUF_UNPACK_SWAP) :
+		_mm256_setr_epi8(SHUF_UNPACK, SHUF_UNPACK);
+	/* bytes 0-11 to the low lane, 12-23 to the high one */
+	const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i alpha = _mm256_set1_epi32(0xff000000);
+	__m256i a;
+	int i = 0;
+
+	/* each step reads 32 bytes for its 24, so stay 8 bytes short */
+	for (; width - i >= 11; i += 8) {
+		a = _mm256_loadu_si256((const __m256i *)(src + 3 * i));
+		a = _mm256_permutevar8x32_epi32(a, spread);
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_or_si256(_mm256_shuffle_epi8(a, shuf),
+						    alpha));
+	}
+
+	unpack_rgb24_sse4(dst + i, src + 3 * i, width - i, swap_rb);
+}
+
+__attribute__((target("avx2")))
+static void
+nv12_avx2(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+	  const uint32_t *s0, const uint32_t *s1, int width, bool swap_rb)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi32(128);
+	const __m256i offset_y = _mm256_set1_epi32(16);
+	const __m256i two = _mm256_set1_epi16(2);
+	const __m256i shuf_luma = _mm256_setr_epi8(SHUF_LUMA, SHUF_LUMA);
+	const __m256i shuf_chroma = _mm256_setr_epi8(SHUF_CHROMA, SHUF_CHROMA);
+	/* low dword of each lane to the bottom 8 bytes */
+	const __m256i gather = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+	const __m256i cy = COEF256(Y_R, Y_G, Y_B, swap_rb);
+	const __m256i cu = COEF256(U_R, U_G, U_B, swap_rb);
+	const __m256i cv = COEF256(V_R, V_G, V_B, swap_rb);
+	__m256i a, b, lo0, hi0, lo1, hi1, y, avg, c;
+	int x = 0;
+
+	/* The same math as the SSE4.1 kernel, once per 128-bit lane:
+	 * the low lane takes pixels 0-3 and the high lane pixels 4-7. */
+	for (; width - x >= 8; x += 8) {
+		a = _mm256_loadu_si256((const __m256i *)(s0 + x));
+		b = _mm256_loadu_si256((const __m256i *)(s1 + x));
+		lo0 = _mm256_unpacklo_epi8(a, zero);
+		hi0 = _mm256_unpackhi_epi8(a, zero);
+		lo1 = _mm256_unpacklo_epi8(b, zero);
+		hi1 = _mm256_unpackhi_epi8(b, zero);
+
+		y = _mm256_hadd_epi32(_mm256_madd_epi16(lo0, cy),
+				      _mm256_madd_epi16(hi0, cy));
+		y = _mm256_add_epi32(_mm256_srli_epi32(_mm256_add_epi32(y, round), 8),
+				     offset_y);
+		y = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(y, shuf_luma),
+						gather);
+		_mm_storel_epi64((__m128i *)(y0 + x), _mm256_castsi256_si128(y));
+
+		y = _mm256_hadd_epi32(_mm256_madd_epi16(lo1, cy),
+				      _mm256_madd_epi16(hi1, cy));
+		y = _mm256_add_epi32(_mm256_srli_epi32(_mm256_add_epi32(y, round), 8),
+				     offset_y);
+		y = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(y, shuf_luma),
+						gather);
+		_mm_storel_epi64((__m128i *)(y1 + x), _mm256_castsi256_si128(y));
+
+		lo0 = _mm256_add_epi16(lo0, lo1);
+		hi0 = _mm256_add_epi16(hi0, hi1);
+		avg = _mm256_add_epi16(_mm256_unpacklo_epi64(lo0, hi0),
+				       _mm256_unpackhi_epi64(lo0, hi0));
+		avg = _mm256_srli_epi16(_mm256_add_epi16(avg, two), 2);
+
+		c = _mm256_hadd_epi32(_mm256_madd_epi16(avg, cu),
+				      _mm256_madd_epi16(avg, cv));
+		c = _mm256_srai_epi32(_mm256_add_epi32(c, round), 8);
+		c = _mm256_add_epi32(c, round);
+		c = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(c, shuf_chroma),
+						gather);
+		_mm_storel_epi64((__m128i *)(uv + x), _mm256_castsi256_si128(c));
+	}
+
+	nv12_sse4(y0 + x, y1 + x, uv + x, s0 + x, s1 + x, width - x, swap_rb);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+multiply_alpha_avx2(__m256i c, __m256i a)
+{
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(c, a),
+				     _mm256_set1_epi16(0x80));
+
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)),
+				 8);
+}
+
+__attribute__((target("avx2")))
+static void
+premultiply_avx2(uint32_t *dst, const uint32_t *src, int width, bool swap_rb)
+{
+	const __m256i shuf = swap_rb ?
+		_mm256_setr_epi8(SHUF_SWAP_RB, SHUF_SWAP_RB) :
+		_mm256_setr_epi8(SHUF_IDENTITY, SHUF_IDENTITY);
+	const __m256i shuf_alpha = _mm256_setr_epi8(SHUF_ALPHA, SHUF_ALPHA);
+	const __m256i alpha = _mm256_set1_epi32(0xff000000);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i v, a, lo, hi;
+	int i = 0;
+
+	/* unpack and pack stay within lanes, so pixel order is kept */
+	for (; width - i >= 8; i += 8) {
+		v = _mm256_shuffle_epi8(
+			_mm256_loadu_si256((const __m256i *)(src + i)), shuf);
+		a = _mm256_or_si256(_mm256_shuffle_epi8(v, shuf_alpha), alpha);
+		lo = multiply_alpha_avx2(_mm256_unpacklo_epi8(v, zero),
+					 _mm256_unpacklo_epi8(a, zero));
+		hi = multiply_alpha_avx2(_mm256_unpackhi_epi8(v, zero),
+					 _mm256_unpackhi_epi8(a, zero));
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_packus_epi16(lo, hi));
+	}
+
+	premultiply_sse4(dst + i, src + i, width - i, swap_rb);
+}
+
+static const struct pixel_convert_kernels kernels_avx2 = {
+	swap_rb_avx2,
+	pack_rgb24_avx2,
+	unpack_rgb24_avx2,
+	nv12_avx2,
+	premultiply_avx2,
+};
+
+#endif /* PIXEL_CONVERT_HAVE_X86 */
+
+#ifdef PIXEL_CONVERT_HAVE_NEON
+
+static void
+swap_rb_neon(uint32_t *dst, const uint32_t *src, int width)
+{
+	uint8x16x4_t v;
+	uint8x16_t t;
+	int i = 0;
+
+	for (; width - i >= 16; i += 16) {
+		v = vld4q_u8((const uint8_t *)(src + i));
+		t = v.val[0];
+		v.val[0] = v.val[2];
+		v.val[2] = t;
+		vst4q_u8((uint8_t *)(dst + i), v);
+	}
+
+	swap_rb_scalar(dst + i, src + i, width - i);
+}
+
+static void
+pack_rgb24_neon(uint8_t *dst, const uint32_t *src, int width, bool swap_rb)
+{
+	uint8x16x4_t v;
+	uint8x16x3_t o;
+	int i = 0;
+
+	for (; width - i >= 16; i += 16) {
+		v = vld4q_u8((const uint8_t *)(src + i));
+		o.val[0] = swap_rb ? v.val[2] : v.val[0];
+		o.val[1] = v.val[1];
+		o.val[2] = swap_rb ? v.val[0] : v.val[2];
+		vst3q_u8(dst + 3 * i, o);
+	}
+
+	pack_rgb24_scalar(dst + 3 * i, src + i, width - i, swap_rb);
+}
+
+static void
+unpack_rgb24_neon(uint32_t *dst, const uint8_t *src, int width, bool swap_rb)
+{
+	uint8x16x3_t v;
+	uint8x16x4_t o;
+	int i = 0;
+
+	o.val[3] = vdupq_n_u8(0xff);
+	for (; width - i >= 16; i += 16) {
+		v = vld3q_u8(src + 3 * i);
+		o.val[0] = swap_rb ? v.val[2] : v.val[0];
+		o.val[1] = v.val[1];
+		o.val[2] = swap_rb ? v.val[0] : v.val[2];
+		vst4q_u8((uint8_t *)(dst + i), o);
+	}
+
+	unpack_rgb24_scalar(dst + i, src + 3 * i, width - i, swap_rb);
+}
+
+static inline uint8x8_t
+luma_neon(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+	uint16x8_t acc;
+
+	/* at most 56228, unsigned 16-bit is enough */
+	acc = vmull_u8(r, vdup_n_u8(Y_R));
+	acc = vmlal_u8(acc, g, vdup_n_u8(Y_G));
+	acc = vmlal_u8(acc, b, vdup_n_u8(Y_B));
+	acc = vaddq_u16(acc, vdupq_n_u16(128));
+
+	return vadd_u8(vshrn_n_u16(acc, 8), vdup_n_u8(16));
+}
+
+/* rounded 2x2 average of one channel, four chroma samples */
+static inline int16x4_t
+average_neon(uint8x8_t row0, uint8x8_t row1)
+{
+	uint16x8_t sum = vaddl_u8(row0, row1);
+
+	return vreinterpret_s16_u16(vrshr_n_u16(vpadd_u16(vget_low_u16(sum),
+							  vget_high_u16(sum)),
+						2));
+}
+
+static inline int16x4_t
+chroma_neon(int16x4_t r, int16x4_t g, int16x4_t b, int cr, int cg, int cb)
+{
+	int16x4_t acc;
+
+	acc = vmul_n_s16(r, cr);
+	acc = vmla_n_s16(acc, g, cg);
+	acc = vmla_n_s16(acc, b, cb);
+	acc = vadd_s16(acc, vdup_n_s16(128));
+
+	return vadd_s16(vshr_n_s16(acc, 8), vdup_n_s16(128));
+}
+
+static void
+nv12_neon(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+	  const uint32_t *s0, const uint32_t *s1, int width, bool swap_rb)
+{
+	const int ri = swap_rb ? 0 : 2;
+	const int bi = swap_rb ? 2 : 0;
+	uint8x8x4_t a, b;
+	int16x4_t r, g, bl, u, v;
+	uint16x4_t packed;
+	int x = 0;
+
+	for (; width - x >= 8; x += 8) {
+		a = vld4_u8((const uint8_t *)(s0 + x));
+		b = vld4_u8((const uint8_t *)(s1 + x));
+
+		vst1_u8(y0 + x, luma_neon(a.val[ri], a.val[1], a.val[bi]));
+		vst1_u8(y1 + x, luma_neon(b.val[ri], b.val[1], b.val[bi]));
+
+		r = average_neon(a.val[ri], b.val[ri]);
+		g = average_neon(a.val[1], b.val[1]);
+		bl = average_neon(a.val[bi], b.val[bi]);
+
+		/* partial sums stay within +-28688 */
+		u = chroma_neon(r, g, bl, U_R, U_G, U_B);
+		v = chroma_neon(r, g, bl, V_R, V_G, V_B);
+
+		packed = vorr_u16(vreinterpret_u16_s16(u),
+				  vshl_n_u16(vreinterpret_u16_s16(v), 8));
+		vst1_u8(uv + x, vreinterpret_u8_u16(packed));
+	}
+
+	nv12_tail(y0, y1, uv, s0, s1, x, width, swap_rb);
+}
+
+/* multiply_alpha(): vraddhn(t, (t + 0x80) >> 8) == (t + 0x80 +
+ * ((t + 0x80) >> 8)) >> 8 for t = a * c */
+static inline uint8x16_t
+multiply_alpha_neon(uint8x16_t c, uint8x16_t a)
+{
+	uint16x8_t lo = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+	uint16x8_t hi = vmull_u8(vget_high_u8(c), vget_high_u8(a));
+
+	return vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+			   vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+}
+
+static void
+premultiply_neon(uint32_t *dst, const uint32_t *src, int width, bool swap_rb)
+{
+	uint8x16x4_t v, o;
+	int i = 0;
+
+	for (; width - i >= 16; i += 16) {
+		v = vld4q_u8((const uint8_t *)(src + i));
+		o.val[0] = multiply_alpha_neon(swap_rb ? v.val[2] : v.val[0],
+					       v.val[3]);
+		o.val[1] = multiply_alpha_neon(v.val[1], v.val[3]);
+		o.val[2] = multiply_alpha_neon(swap_rb ? v.val[0] : v.val[2],
+					       v.val[3]);
+		o.val[3] = v.val[3];
+		vst4q_u8((uint8_t *)(dst + i), o);
+	}
+
+	premultiply_scalar(dst + i, src + i, width - i, swap_rb);
+}
+
+static const struct pixel_convert_kernels kernels_neon = {
+	swap_rb_neon,
+	pack_rgb24_neon,
+	unpack_rgb24_neon,
+	nv12_neon,
+	premultiply_neon,
+};
+
+#endif /* PIXEL_CONVERT_HAVE_NEON */
+
+const struct pixel_convert_kernels *
+pixel_convert_get_kernels(enum pixel_convert_impl impl)
+{
+	switch (impl) {
+	case PIXEL_CONVERT_IMPL_SCALAR:
+		return &kernels_scalar;
+	case PIXEL_CONVERT_IMPL_SSE4:
+#ifdef PIXEL_CONVERT_HAVE_X86
+		if (__builtin_cpu_supports("sse4.1"))
+			return &kernels_sse4;
+#endif
+		return NULL;
+	case PIXEL_CONVERT_IMPL_AVX2:
+#ifdef PIXEL_CONVERT_HAVE_X86
+		if (__builtin_cpu_supports("avx2"))
+			return &kernels_avx2;
+#endif
+		return NULL;
+	case PIXEL_CONVERT_IMPL_NEON:
+#ifdef PIXEL_CONVERT_HAVE_NEON
+		return &kernels_neon;
+#else
+		return NULL;
+#endif
+	}
+
+	return NULL;
+}
+
+static const struct pixel_convert_kernels *
+pixel_convert_best(void)
+{
+	static const enum pixel_convert_impl order[] = {
+		PIXEL_CONVERT_IMPL_AVX2,
+		PIXEL_CONVERT_IMPL_SSE4,
+		PIXEL_CONVERT_IMPL_NEON,
+	};
+	const struct pixel_convert_kernels *k;
+	unsigned i;
+
+	for (i = 0; i < sizeof order / sizeof order[0]; i++) {
+		k = pixel_convert_get_kernels(order[i]);
+		if (k)
+			return k;
+	}
+
+	return &kernels_scalar;
+}
+
+static inline const uint8_t *
+source_row(const void *src, int src_stride, int row, int height,
+	   uint32_t flags)
+{
+	if (flags & PIXEL_CONVERT_YFLIP)
+		row = height - 1 - row;
+
+	return (const uint8_t *)src + (intptr_t)row * src_stride;
+}
+
+void
+pixel_convert_xrgb(void *dst, int dst_stride,
+		   const void *src, int src_stride,
+		   int width, int height, uint32_t flags)
+{
+	const struct pixel_convert_kernels *k = pixel_convert_best();
+	uint8_t *d = dst;
+	int row;
+
+	if (flags == 0 && dst_stride == src_stride &&
+	    dst_stride == width * 4) {
+		memcpy(dst, src, (size_t)height * dst_stride);
+		return;
+	}
+
+	for (row = 0; row < height; row++, d += dst_stride) {
+		const uint8_t *s = source_row(src, src_stride, row, height,
+					      flags);
+
+		if (flags & PIXEL_CONVERT_SWAP_RB)
+			k->swap_rb((uint32_t *)d, (const uint32_t *)s, width);
+		else
+			memcpy(d, s, (size_t)width * 4);
+	}
+}
+
+void
+pixel_convert_xrgb_to_rgb24(void *dst, int dst_stride,
+			    const void *src, int src_stride,
+			    int width, int height, uint32_t flags)
+{
+	const struct pixel_convert_kernels *k = pixel_convert_best();
+	uint8_t *d = dst;
+	int row;
+
+	for (row = 0; row < height; row++, d += dst_stride)
+		k->pack_rgb24(d, (const uint32_t *)
+			      source_row(src, src_stride, row, height, flags),
+			      width, flags & PIXEL_CONVERT_SWAP_RB);
+}
+
+void
+pixel_convert_rgb24_to_xrgb(void *dst, int dst_stride,
+			    const void *src, int src_stride,
+			    int width, int height, uint32_t flags)
+{
+	const struct pixel_convert_kernels *k = pixel_convert_best();
+	uint8_t *d = dst;
+	int row;
+
+	for (row = 0; row < height; row++, d += dst_stride)
+		k->unpack_rgb24((uint32_t *)d,
+				source_row(src, src_stride, row, height, flags),
+				width, flags & PIXEL_CONVERT_SWAP_RB);
+}
+
+void
+pixel_convert_xrgb_to_nv12(uint8_t *y, int y_stride,
+			   uint8_t *uv, int uv_stride,
+			   const void *src, int src_stride,
+			   int width, int height, uint32_t flags)
+{
+	const struct pixel_convert_kernels *k = pixel_convert_best();
+	const uint32_t *s0, *s1;
+	uint8_t *y1;
+	int row;
+
+	for (row = 0; row < height; row += 2) {
+		s0 = (const uint32_t *)source_row(src, src_stride, row,
+						  height, flags);
+		if (row + 1 < height) {
+			s1 = (const uint32_t *)source_row(src, src_stride,
+							  row + 1, height,
+							  flags);
+			y1 = y + y_stride;
+		} else {
+			s1 = s0;
+			y1 = y;
+		}
+
+		k->nv12(y, y1, uv, s0, s1, width,
+			flags & PIXEL_CONVERT_SWAP_RB);
+
+		y += 2 * (intptr_t)y_stride;
+		uv += uv_stride;
+	}
+}
+
+void
+pixel_convert_premultiply(void *dst, int dst_stride,
+			  const void *src, int src_stride,
+			  int width, int height, uint32_t flags)
+{
+	const struct pixel_convert_kernels *k = pixel_convert_best();
+	uint8_t *d = dst;
+	int row;
+
+	for (row = 0; row < height; row++, d += dst_stride)
+		k->premultiply((uint32_t *)d, (const uint32_t *)
+			       source_row(src, src_stride, row, height, flags),
+			       width, flags & PIXEL_CONVERT_SWAP_RB);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_PIXEL_CONVERT_H
+#define WESTON_PIXEL_CONVERT_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Pixel conversion for the capture paths: screenshots, recordings and
+ * screen sharing read back 32-bit output pixels and copy them out with
+ * a vertical flip, a red/blue swap, or both. The same module packs them
+ * to 24-bit and converts them to NV12 for encoders. The image loader
+ * uses it to expand decoded 24-bit rows and premultiply alpha.
+ *
+ * The 32-bit side is x8r8g8b8 (a8r8g8b8 alike, alpha is ignored), or
+ * x8b8g8r8 with PIXEL_CONVERT_SWAP_RB. The 24-bit side is pixman's
+ * r8g8b8, i.e. B, G, R in memory. NV12 uses BT.601 limited range with
+ * each chroma sample taken from the rounded average of a 2x2 block.
+ *
+ * Rows are converted by SSE4.1, AVX2 or NEON kernels where the CPU has
+ * them. Every kernel produces exactly the bytes of the scalar one.
+ */
+
+enum pixel_convert_flags {
+	/* read the source bottom-up, as glReadPixels returns it */
+	PIXEL_CONVERT_YFLIP = 1 << 0,
+	/* the 32-bit side is x8b8g8r8 */
+	PIXEL_CONVERT_SWAP_RB = 1 << 1,
+};
+
+/* 32-bit to 32-bit copy; the destination gets the other channel order
+ * with PIXEL_CONVERT_SWAP_RB. */
+void
+pixel_convert_xrgb(void *dst, int dst_stride,
+		   const void *src, int src_stride,
+		   int width, int height, uint32_t flags);
+
+void
+pixel_convert_xrgb_to_rgb24(void *dst, int dst_stride,
+			    const void *src, int src_stride,
+			    int width, int height, uint32_t flags);
+
+/* Alpha is set to 0xff. PIXEL_CONVERT_YFLIP flips the 24-bit source. */
+void
+pixel_convert_rgb24_to_xrgb(void *dst, int dst_stride,
+			    const void *src, int src_stride,
+			    int width, int height, uint32_t flags);
+
+/* Straight to premultiplied alpha, with the 32-bit side a8r8g8b8 (or
+ * a8b8g8r8 with PIXEL_CONVERT_SWAP_RB, which is R, G, B, A in memory on
+ * little-endian only) and the result always a8r8g8b8. dst may be src for
+ * an in-place pass. */
+void
+pixel_convert_premultiply(void *dst, int dst_stride,
+			  const void *src, int src_stride,
+			  int width, int height, uint32_t flags);
+
+/* The UV plane holds (width + 1) / 2 pairs per row and (height + 1) / 2
+ * rows; odd edges reuse the last column or row. */
+void
+pixel_convert_xrgb_to_nv12(uint8_t *y, int y_stride,
+			   uint8_t *uv, int uv_stride,
+			   const void *src, int src_stride,
+			   int width, int height, uint32_t flags);
+
+enum pixel_convert_impl {
+	PIXEL_CONVERT_IMPL_SCALAR,
+	PIXEL_CONVERT_IMPL_SSE4,
+	PIXEL_CONVERT_IMPL_AVX2,
+	PIXEL_CONVERT_IMPL_NEON,
+};
+
+/* Row kernels; width is in pixels and may be anything from 0 up. */
+struct pixel_convert_kernels {
+	void (*swap_rb)(uint32_t *dst, const uint32_t *src, int width);
+	void (*pack_rgb24)(uint8_t *dst, const uint32_t *src, int width,
+			   bool swap_rb);
+	void (*unpack_rgb24)(uint32_t *dst, const uint8_t *src, int width,
+			     bool swap_rb);
+	/* two source rows to two luma rows and one interleaved chroma row;
+	 * s1 and y1 may equal s0 and y0 for the last row of an odd height */
+	void (*nv12)(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+		     const uint32_t *s0, const uint32_t *s1, int width,
+		     bool swap_rb);
+	/* src alpha is straight, dst is premultiplied a8r8g8b8; dst may
+	 * equal src */
+	void (*premultiply)(uint32_t *dst, const uint32_t *src, int width,
+			    bool swap_rb);
+};
+
+/* For tests and benchmarks: a specific implementation, or NULL when it
+ * was not built or the CPU does not support it. */
+const struct pixel_convert_kernels *
+pixel_convert_get_kernels(enum pixel_convert_impl impl);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_PIXEL_CONVERT_H */
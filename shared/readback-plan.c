@@ -0,0 +1,141 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "readback-plan.h"
+
+static inline int64_t
+box_area(const struct readback_box *b)
+{
+	return (int64_t)(b->x2 - b->x1) * (b->y2 - b->y1);
+}
+
+static inline void
+box_union(struct readback_box *dst, const struct readback_box *a,
+	  const struct readback_box *b)
+{
+	dst->x1 = a->x1 < b->x1 ? a->x1 : b->x1;
+	dst->y1 = a->y1 < b->y1 ? a->y1 : b->y1;
+	dst->x2 = a->x2 > b->x2 ? a->x2 : b->x2;
+	dst->y2 = a->y2 > b->y2 ? a->y2 : b->y2;
+}
+
+/* fold_input() buckets boxes on a FOLD_GRID x FOLD_GRID grid, one slot
+ * per READBACK_PLAN_MAX_INPUT */
+#define FOLD_GRID 8
+
+static_assert(FOLD_GRID * FOLD_GRID <= READBACK_PLAN_MAX_INPUT,
+	      "fold_input() must not leave more than READBACK_PLAN_MAX_INPUT boxes");
+
+static int
+fold_cell(int32_t lo, int32_t hi, int32_t min, int64_t span)
+{
+	/* cell of the box centre, kept in doubled coordinates */
+	int64_t c = ((int64_t)lo + hi - 2 * (int64_t)min) * FOLD_GRID /
+		    (2 * span);
+
+	return c < FOLD_GRID ? (int)c : FOLD_GRID - 1;
+}
+
+static int
+fold_input(struct readback_box *boxes, int n)
+{
+	struct readback_box cells[FOLD_GRID * FOLD_GRID], ext = boxes[0];
+	uint8_t used[FOLD_GRID * FOLD_GRID] = { 0 };
+	int64_t w, h;
+	int i, k, count = 0;
+
+	for (i = 1; i < n; i++)
+		box_union(&ext, &ext, &boxes[i]);
+	w = ext.x2 > ext.x1 ? (int64_t)ext.x2 - ext.x1 : 1;
+	h = ext.y2 > ext.y1 ? (int64_t)ext.y2 - ext.y1 : 1;
+
+	/* a banded region lists boxes row by row across the whole width, so
+	 * fold by where boxes are rather than where they come in the list:
+	 * two clusters sharing rows still land in different cells */
+	for (i = 0; i < n; i++) {
+		k = fold_cell(boxes[i].y1, boxes[i].y2, ext.y1, h) * FOLD_GRID +
+		    fold_cell(boxes[i].x1, boxes[i].x2, ext.x1, w);
+		if (used[k]) {
+			box_union(&cells[k], &cells[k], &boxes[i]);
+		} else {
+			cells[k] = boxes[i];
+			used[k] = 1;
+		}
+	}
+
+	for (k = 0; k < FOLD_GRID * FOLD_GRID; k++)
+		if (used[k])
+			boxes[count++] = cells[k];
+
+	return count;
+}
+
+int
+readback_plan(struct readback_box *boxes, int n, int max_boxes,
+	      uint32_t call_cost)
+{
+	struct readback_box u, best_u;
+	int64_t delta, best_delta;
+	int i, j, best_i, best_j;
+
+	if (max_boxes < 1)
+		max_boxes = 1;
+
+	if (n > READBACK_PLAN_MAX_INPUT)
+		n = fold_input(boxes, n);
+
+	while (n > 1) {
+		best_i = best_j = -1;
+		best_delta = INT64_MAX;
+
+		for (i = 0; i < n; i++) {
+			for (j = i + 1; j < n; j++) {
+				box_union(&u, &boxes[i], &boxes[j]);
+				/* one readback of the union instead of two */
+				delta = box_area(&u) - box_area(&boxes[i]) -
+					box_area(&boxes[j]) - call_cost;
+				if (delta < best_delta) {
+					best_delta = delta;
+					best_u = u;
+					best_i = i;
+					best_j = j;
+				}
+			}
+		}
+
+		if (best_delta > 0 && n <= max_boxes)
+			break;
+
+		boxes[best_i] = best_u;
+		boxes[best_j] = boxes[--n];
+	}
+
+	return n;
+}
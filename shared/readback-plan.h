@@ -0,0 +1,68 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_READBACK_PLAN_H
+#define WESTON_READBACK_PLAN_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Plans the readbacks needed to cover a damage region. Each readback has
+ * a fixed cost (a renderer round trip, a pipeline stall) on top of the
+ * pixels it copies, so many small rectangles are cheaper to read as a few
+ * larger ones. The planner greedily merges the pair of boxes whose
+ * bounding box adds the least cost, and keeps going while merging pays
+ * off or there are more boxes than allowed.
+ *
+ * Same layout as pixman_box32_t, so callers can pass region rectangles
+ * straight in.
+ */
+struct readback_box {
+	int32_t x1, y1, x2, y2;
+};
+
+/* Above this many input boxes the planner first folds boxes that share a
+ * cell of a coarse grid over the damage, so the pairwise merge that
+ * follows never sees more than this many. */
+#define READBACK_PLAN_MAX_INPUT 64
+
+/*
+ * Merges 'boxes' in place and returns the new count. The result covers
+ * every input box and has at most max_boxes entries (max_boxes >= 1).
+ * call_cost is the fixed cost of one readback, in pixels.
+ */
+int
+readback_plan(struct readback_box *boxes, int n, int max_boxes,
+	      uint32_t call_cost);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_READBACK_PLAN_H */
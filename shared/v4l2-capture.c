@@ -0,0 +1,543 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "shared/timespec-util.h"
+#include "v4l2-capture.h"
+
+#define CLEAR(x) memset(&(x), 0, sizeof(x))
+
+static int
+xioctl(int fd, unsigned long request, void *arg)
+{
+	int r;
+
+	do {
+		r = ioctl(fd, request, arg);
+	} while (r == -1 && errno == EINTR);
+
+	return r;
+}
+
+static bool
+is_mplane(const struct v4l2_capture *cap)
+{
+	return cap->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+}
+
+static void
+init_v4l2_buffer(const struct v4l2_capture *cap, struct v4l2_buffer *vb,
+		 struct v4l2_plane *planes, unsigned index)
+{
+	memset(vb, 0, sizeof *vb);
+	vb->type = cap->type;
+	vb->memory = V4L2_MEMORY_MMAP;
+	vb->index = index;
+
+	if (is_mplane(cap)) {
+		memset(planes, 0, VIDEO_MAX_PLANES * sizeof *planes);
+		vb->length = VIDEO_MAX_PLANES;
+		vb->m.planes = planes;
+	}
+}
+
+unsigned
+v4l2_capture_queue_depth(int64_t latency_budget_ns, int64_t frame_interval_ns,
+			 unsigned held)
+{
+	int64_t ahead = 1;
+	unsigned depth;
+
+	if (frame_interval_ns > 0 && latency_budget_ns > frame_interval_ns)
+		ahead = latency_budget_ns / frame_interval_ns;
+	if (ahead > V4L2_CAPTURE_MAX_BUFFERS)
+		ahead = V4L2_CAPTURE_MAX_BUFFERS;
+
+	depth = held + ahead;
+	if (depth < 2)
+		depth = 2;
+	if (depth > V4L2_CAPTURE_MAX_BUFFERS)
+		depth = V4L2_CAPTURE_MAX_BUFFERS;
+
+	return depth;
+}
+
+static int
+negotiate_format(struct v4l2_capture *cap, uint32_t pixelformat)
+{
+	struct v4l2_format fmt;
+	unsigned i;
+
+	CLEAR(fmt);
+	fmt.type = cap->type;
+	if (xioctl(cap->fd, VIDIOC_G_FMT, &fmt) < 0)
+		return -1;
+
+	if (pixelformat != 0) {
+		if (is_mplane(cap))
+			fmt.fmt.pix_mp.pixelformat = pixelformat;
+		else
+			fmt.fmt.pix.pixelformat = pixelformat;
+
+		if (xioctl(cap->fd, VIDIOC_S_FMT, &fmt) < 0)
+			return -1;
+	}
+
+	if (is_mplane(cap)) {
+		cap->pixelformat = fmt.fmt.pix_mp.pixelformat;
+		cap->width = fmt.fmt.pix_mp.width;
+		cap->height = fmt.fmt.pix_mp.height;
+		cap->num_planes = fmt.fmt.pix_mp.num_planes;
+		for (i = 0; i < cap->num_planes; i++)
+			cap->strides[i] =
+				fmt.fmt.pix_mp.plane_fmt[i].bytesperline;
+	} else {
+		cap->pixelformat = fmt.fmt.pix.pixelformat;
+		cap->width = fmt.fmt.pix.width;
+		cap->height = fmt.fmt.pix.height;
+		cap->num_planes = 1;
+		cap->strides[0] = fmt.fmt.pix.bytesperline;
+	}
+
+	/* drivers substitute what they support rather than fail S_FMT */
+	if (pixelformat != 0 && cap->pixelformat != pixelformat) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (cap->num_planes < 1 || cap->num_planes > VIDEO_MAX_PLANES) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+read_frame_interval(struct v4l2_capture *cap)
+{
+	struct v4l2_streamparm parm;
+	struct v4l2_fract *tpf = &parm.parm.capture.timeperframe;
+
+	CLEAR(parm);
+	parm.type = cap->type;
+	if (xioctl(cap->fd, VIDIOC_G_PARM, &parm) < 0 ||
+	    !(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME) ||
+	    tpf->denominator == 0)
+		return;
+
+	cap->frame_interval_ns =
+		(int64_t)tpf->numerator * NSEC_PER_SEC / tpf->denominator;
+}
+
+int
+v4l2_capture_open(struct v4l2_capture *cap, const char *path,
+		  uint32_t pixelformat)
+{
+	struct v4l2_capability caps;
+	uint32_t device_caps;
+	int saved_errno;
+
+	memset(cap, 0, sizeof *cap);
+
+	cap->fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (cap->fd < 0)
+		return -1;
+
+	CLEAR(caps);
+	if (xioctl(cap->fd, VIDIOC_QUERYCAP, &caps) < 0)
+		goto err;
+
+	device_caps = caps.capabilities;
+	if (caps.capabilities & V4L2_CAP_DEVICE_CAPS)
+		device_caps = caps.device_caps;
+
+	if (device_caps & V4L2_CAP_VIDEO_CAPTURE) {
+		cap->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	} else if (device_caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE) {
+		cap->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	} else {
+		errno = ENODEV;
+		goto err;
+	}
+
+	if (!(device_caps & V4L2_CAP_STREAMING)) {
+		errno = ENOTSUP;
+		goto err;
+	}
+
+	if (negotiate_format(cap, pixelformat) < 0)
+		goto err;
+
+	read_frame_interval(cap);
+
+	return 0;
+
+err:
+	saved_errno = errno;
+	close(cap->fd);
+	cap->fd = -1;
+	errno = saved_errno;
+	return -1;
+}
+
+static void
+release_buffers(struct v4l2_capture *cap)
+{
+	struct v4l2_requestbuffers req;
+	struct v4l2_capture_buffer *buf;
+	unsigned i, p;
+
+	for (i = 0; i < cap->num_buffers; i++) {
+		buf = &cap->buffers[i];
+		for (p = 0; p < cap->num_planes; p++) {
+			if (buf->dmabuf_fds[p] >= 0)
+				close(buf->dmabuf_fds[p]);
+			buf->dmabuf_fds[p] = -1;
+			if (buf->maps[p])
+				munmap(buf->maps[p], buf->map_lengths[p]);
+			buf->maps[p] = NULL;
+		}
+	}
+
+	CLEAR(req);
+	req.type = cap->type;
+	req.memory = V4L2_MEMORY_MMAP;
+	req.count = 0;
+	xioctl(cap->fd, VIDIOC_REQBUFS, &req);
+
+	cap->num_buffers = 0;
+}
+
+static int
+export_buffer(struct v4l2_capture *cap, struct v4l2_capture_buffer *buf)
+{
+	struct v4l2_exportbuffer expbuf;
+	unsigned p;
+
+	for (p = 0; p < cap->num_planes; p++) {
+		CLEAR(expbuf);
+		expbuf.type = cap->type;
+		expbuf.index = buf->index;
+		expbuf.plane = p;
+		expbuf.flags = O_RDONLY | O_CLOEXEC;
+		if (xioctl(cap->fd, VIDIOC_EXPBUF, &expbuf) < 0)
+			return -1;
+		buf->dmabuf_fds[p] = expbuf.fd;
+	}
+
+	return 0;
+}
+
+static int
+map_buffer(struct v4l2_capture *cap, struct v4l2_capture_buffer *buf,
+	   const struct v4l2_buffer *vb)
+{
+	size_t length;
+	off_t offset;
+	void *map;
+	unsigned p;
+
+	for (p = 0; p < cap->num_planes; p++) {
+		if (is_mplane(cap)) {
+			length = vb->m.planes[p].length;
+			offset = vb->m.planes[p].m.mem_offset;
+		} else {
+			length = vb->length;
+			offset = vb->m.offset;
+		}
+
+		map = mmap(NULL, length, PROT_READ, MAP_SHARED, cap->fd, offset);
+		if (map == MAP_FAILED)
+			return -1;
+
+		buf->maps[p] = map;
+		buf->map_lengths[p] = length;
+	}
+
+	return 0;
+}
+
+static int
+setup_buffer(struct v4l2_capture *cap, struct v4l2_capture_buffer *buf)
+{
+	struct v4l2_buffer vb;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	unsigned p;
+
+	init_v4l2_buffer(cap, &vb, planes, buf->index);
+	if (xioctl(cap->fd, VIDIOC_QUERYBUF, &vb) < 0)
+		return -1;
+
+	if (is_mplane(cap)) {
+		if (vb.length != cap->num_planes) {
+			errno = EINVAL;
+			return -1;
+		}
+		for (p = 0; p < cap->num_planes; p++)
+			buf->offsets[p] = planes[p].data_offset;
+	}
+
+	if (cap->io == V4L2_CAPTURE_IO_DMABUF) {
+		if (export_buffer(cap, buf) == 0)
+			return 0;
+
+		/* Only the first buffer can discover that the driver does
+		 * not export; later failures are real errors. */
+		if (buf->index != 0)
+			return -1;
+
+		for (p = 0; p < cap->num_planes; p++) {
+			if (buf->dmabuf_fds[p] >= 0)
+				close(buf->dmabuf_fds[p]);
+			buf->dmabuf_fds[p] = -1;
+		}
+		cap->io = V4L2_CAPTURE_IO_MMAP;
+	}
+
+	return map_buffer(cap, buf, &vb);
+}
+
+int
+v4l2_capture_start(struct v4l2_capture *cap, unsigned num_buffers,
+		   enum v4l2_capture_io io)
+{
+	struct v4l2_requestbuffers req;
+	struct v4l2_capture_buffer *buf;
+	int type = cap->type;
+	int saved_errno;
+	unsigned i, p;
+
+	if (num_buffers > V4L2_CAPTURE_MAX_BUFFERS)
+		num_buffers = V4L2_CAPTURE_MAX_BUFFERS;
+
+	CLEAR(req);
+	req.type = cap->type;
+	req.memory = V4L2_MEMORY_MMAP;
+	req.count = num_buffers;
+	if (xioctl(cap->fd, VIDIOC_REQBUFS, &req) < 0)
+		return -1;
+
+	/* the driver may adjust the count either way, but the array is
+	 * fixed and less than two buffers cannot stream */
+	cap->num_buffers = req.count;
+	if (req.count < 2 || req.count > V4L2_CAPTURE_MAX_BUFFERS) {
+		cap->num_buffers = 0;
+		release_buffers(cap);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (i = 0; i < cap->num_buffers; i++) {
+		buf = &cap->buffers[i];
+		memset(buf, 0, sizeof *buf);
+		buf->index = i;
+		for (p = 0; p < VIDEO_MAX_PLANES; p++)
+			buf->dmabuf_fds[p] = -1;
+	}
+
+	cap->io = io;
+	for (i = 0; i < cap->num_buffers; i++) {
+		if (setup_buffer(cap, &cap->buffers[i]) < 0)
+			goto err;
+	}
+
+	for (i = 0; i < cap->num_buffers; i++) {
+		if (v4l2_capture_queue(cap, &cap->buffers[i]) < 0)
+			goto err;
+	}
+
+	if (xioctl(cap->fd, VIDIOC_STREAMON, &type) < 0)
+		goto err;
+
+	cap->streaming = true;
+
+	return 0;
+
+err:
+	saved_errno = errno;
+	release_buffers(cap);
+	errno = saved_errno;
+	return -1;
+}
+
+struct v4l2_capture_buffer *
+v4l2_capture_dequeue_newest(struct v4l2_capture *cap)
+{
+	struct v4l2_capture_buffer *newest = NULL, *buf;
+	struct v4l2_buffer vb;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+
+	for (;;) {
+		init_v4l2_buffer(cap, &vb, planes, 0);
+		if (xioctl(cap->fd, VIDIOC_DQBUF, &vb) < 0) {
+			/* keep what we got; a real error shows up again on
+			 * the next call */
+			if (newest)
+				break;
+			return NULL;
+		}
+
+		buf = &cap->buffers[vb.index];
+		buf->queued = false;
+		cap->frames++;
+
+		if (vb.flags & V4L2_BUF_FLAG_ERROR) {
+			cap->dropped++;
+			v4l2_capture_queue(cap, buf);
+			continue;
+		}
+
+		if (newest) {
+			cap->dropped++;
+			v4l2_capture_queue(cap, newest);
+		}
+		newest = buf;
+
+		newest->sequence = vb.sequence;
+		cap->timestamp_monotonic =
+			(vb.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+			V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+		if (cap->timestamp_monotonic) {
+			newest->timestamp.tv_sec = vb.timestamp.tv_sec;
+			newest->timestamp.tv_nsec =
+				vb.timestamp.tv_usec * 1000;
+		} else {
+			clock_gettime(CLOCK_MONOTONIC, &newest->timestamp);
+		}
+	}
+
+	return newest;
+}
+
+int
+v4l2_capture_queue(struct v4l2_capture *cap, struct v4l2_capture_buffer *buf)
+{
+	struct v4l2_buffer vb;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+
+	init_v4l2_buffer(cap, &vb, planes, buf->index);
+	if (is_mplane(cap))
+		vb.length = cap->num_planes;
+
+	if (xioctl(cap->fd, VIDIOC_QBUF, &vb) < 0)
+		return -1;
+
+	buf->queued = true;
+
+	return 0;
+}
+
+void
+v4l2_capture_stop(struct v4l2_capture *cap)
+{
+	int type = cap->type;
+
+	if (cap->streaming)
+		xioctl(cap->fd, VIDIOC_STREAMOFF, &type);
+	cap->streaming = false;
+
+	if (cap->num_buffers > 0)
+		release_buffers(cap);
+}
+
+void
+v4l2_capture_close(struct v4l2_capture *cap)
+{
+	if (cap->fd < 0)
+		return;
+
+	v4l2_capture_stop(cap);
+	close(cap->fd);
+	cap->fd = -1;
+}
+
+void
+capture_watchdog_init(struct capture_watchdog *wd, int64_t deadline_ns,
+		      int64_t frame_interval_ns, const struct timespec *start)
+{
+	memset(wd, 0, sizeof *wd);
+	wd->deadline_ns = deadline_ns;
+	wd->frame_interval_ns = frame_interval_ns;
+	wd->last_capture = *start;
+}
+
+bool
+capture_watchdog_record(struct capture_watchdog *wd,
+			const struct timespec *capture,
+			const struct timespec *present)
+{
+	int64_t latency;
+
+	/* the two ends can come from clocks sampled a hair apart */
+	latency = timespec_sub_to_nsec(present, capture);
+	if (latency < 0)
+		latency = 0;
+
+	wd->frames++;
+	wd->last_ns = latency;
+	wd->total_ns += latency;
+	if (latency > wd->max_ns)
+		wd->max_ns = latency;
+
+	if (timespec_sub_to_nsec(capture, &wd->last_capture) > 0)
+		wd->last_capture = *capture;
+	wd->stalled = false;
+
+	if (latency > wd->deadline_ns) {
+		wd->missed++;
+		wd->consecutive_missed++;
+		return true;
+	}
+
+	wd->consecutive_missed = 0;
+
+	return false;
+}
+
+int64_t
+capture_watchdog_check(struct capture_watchdog *wd, const struct timespec *now)
+{
+	int64_t idle;
+
+	idle = timespec_sub_to_nsec(now, &wd->last_capture);
+	if (wd->stalled ||
+	    idle <= wd->frame_interval_ns + wd->deadline_ns)
+		return 0;
+
+	wd->stalled = true;
+	wd->stalls++;
+
+	return idle;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_V4L2_CAPTURE_H
+#define WESTON_V4L2_CAPTURE_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <linux/videodev2.h>
+
+/*
+ * V4L2 streaming capture for latency sensitive viewers such as a reverse
+ * camera. Buffers are always allocated by the driver (MEMORY_MMAP); when
+ * zero-copy is asked for each plane is exported as a dmabuf so it can be
+ * handed to the compositor directly, otherwise, or when the driver cannot
+ * export, the planes are mapped for the caller to copy out of.
+ *
+ * All calls return -1 and set errno on failure.
+ */
+
+#define V4L2_CAPTURE_MAX_BUFFERS 16
+
+enum v4l2_capture_io {
+	V4L2_CAPTURE_IO_DMABUF,
+	V4L2_CAPTURE_IO_MMAP,
+};
+
+struct v4l2_capture_buffer {
+	unsigned index;
+	bool queued;
+
+	/* V4L2_CAPTURE_IO_DMABUF: owned by the capture, -1 otherwise */
+	int dmabuf_fds[VIDEO_MAX_PLANES];
+	/* V4L2_CAPTURE_IO_MMAP: read-only plane mappings, NULL otherwise */
+	void *maps[VIDEO_MAX_PLANES];
+	size_t map_lengths[VIDEO_MAX_PLANES];
+	uint32_t offsets[VIDEO_MAX_PLANES];
+
+	/* Of the frame last dequeued into this buffer. The timestamp is
+	 * the driver's when it is CLOCK_MONOTONIC, else the dequeue time. */
+	uint32_t sequence;
+	struct timespec timestamp;
+};
+
+struct v4l2_capture {
+	int fd;
+	enum v4l2_buf_type type;
+	uint32_t pixelformat;
+	int32_t width, height;
+	unsigned num_planes;
+	uint32_t strides[VIDEO_MAX_PLANES];
+	/* 0 when the driver does not report it */
+	int64_t frame_interval_ns;
+	bool timestamp_monotonic;
+
+	bool streaming;
+	enum v4l2_capture_io io;
+	unsigned num_buffers;
+	struct v4l2_capture_buffer buffers[V4L2_CAPTURE_MAX_BUFFERS];
+
+	/* frames dequeued, and those skipped for a newer one or an error */
+	uint64_t frames;
+	uint64_t dropped;
+};
+
+/*
+ * Number of buffers to request so that queueing cannot push a frame past
+ * latency_budget_ns. 'held' buffers are out with the consumer (on screen
+ * and pending) and cost no latency; each buffer the driver has queued on
+ * top of those may hold a finished frame for another interval if the
+ * consumer falls behind, so at most budget / interval of them are allowed,
+ * and always at least one so the driver never starves.
+ */
+unsigned
+v4l2_capture_queue_depth(int64_t latency_budget_ns, int64_t frame_interval_ns,
+			 unsigned held);
+
+/*
+ * Opens a capture device non-blocking and negotiates pixelformat (0 keeps
+ * the current one). Fills in the geometry and frame interval.
+ */
+int
+v4l2_capture_open(struct v4l2_capture *cap, const char *path,
+		  uint32_t pixelformat);
+
+/*
+ * Allocates num_buffers buffers, queues them all and starts streaming.
+ * Asking for V4L2_CAPTURE_IO_DMABUF falls back to V4L2_CAPTURE_IO_MMAP
+ * when the driver cannot export; cap->io says which one was used.
+ */
+int
+v4l2_capture_start(struct v4l2_capture *cap, unsigned num_buffers,
+		   enum v4l2_capture_io io);
+
+/*
+ * Dequeues every completed frame and returns the newest, putting the
+ * older ones straight back. Returns NULL with errno EAGAIN when no frame
+ * is ready. The buffer belongs to the caller until v4l2_capture_queue().
+ */
+struct v4l2_capture_buffer *
+v4l2_capture_dequeue_newest(struct v4l2_capture *cap);
+
+int
+v4l2_capture_queue(struct v4l2_capture *cap, struct v4l2_capture_buffer *buf);
+
+/* Stops streaming and frees the buffers; the device stays open. */
+void
+v4l2_capture_stop(struct v4l2_capture *cap);
+
+void
+v4l2_capture_close(struct v4l2_capture *cap);
+
+/*
+ * Tracks capture-to-present latency against a deadline. Times are on
+ * CLOCK_MONOTONIC.
+ */
+struct capture_watchdog {
+	int64_t deadline_ns;
+	int64_t frame_interval_ns;
+
+	uint64_t frames;
+	uint64_t missed;
+	uint32_t consecutive_missed;
+	int64_t last_ns;
+	int64_t max_ns;
+	int64_t total_ns;
+
+	/* capture time of the last presented frame, or the start time */
+	struct timespec last_capture;
+	uint64_t stalls;
+	bool stalled;
+};
+
+void
+capture_watchdog_init(struct capture_watchdog *wd, int64_t deadline_ns,
+		      int64_t frame_interval_ns, const struct timespec *start);
+
+/* Returns true when the frame missed the deadline. */
+bool
+capture_watchdog_record(struct capture_watchdog *wd,
+			const struct timespec *capture,
+			const struct timespec *present);
+
+/*
+ * Catches frames that never arrive at all. The frame after the last one
+ * presented is due by its capture time, one interval later, plus the
+ * deadline; past that the stream is stalled. Returns the time since the
+ * last presented capture the first time that happens, 0 otherwise. The
+ * next presented frame re-arms it.
+ */
+int64_t
+capture_watchdog_check(struct capture_watchdog *wd, const struct timespec *now);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_V4L2_CAPTURE_H */
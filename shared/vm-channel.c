@@ -0,0 +1,1119 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <linux/vm_sockets.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "shared/vm-channel.h"
+
+/* How often a client retries to reach a server it lost */
+#define VM_CHANNEL_RECONNECT_MS 500
+/* How long connecting and the shm handshake may take */
+#define VM_CHANNEL_CONNECT_TIMEOUT_MS 1000
+/* Size of each direction's ring for the shm backend, a power of two */
+#define VM_CHANNEL_SHM_RING_SIZE (1 << 20)
+/* Upper bound for a single message on the socket backends */
+#define VM_CHANNEL_MAX_MESSAGE (16 << 20)
+/* Ring sizes a shm client accepts from its server; the largest still
+ * holds a largest message, which may take at most half of a ring */
+#define VM_CHANNEL_SHM_RING_MIN (1 << 12)
+#define VM_CHANNEL_SHM_RING_MAX (2 * VM_CHANNEL_MAX_MESSAGE)
+
+/* Marks the unused tail of a shm ring, the next message starts at 0 */
+#define VM_CHANNEL_PAD 0xffffffffu
+
+enum vm_channel_type {
+	VM_CHANNEL_SHM,
+	VM_CHANNEL_TCP,
+	VM_CHANNEL_VSOCK,
+};
+
+/*
+ * Every message is preceded by this header, on the wire and in the rings,
+ * and padded to 8 bytes so the next header and payload stay aligned.
+ * Unframed channels send the bare message bytes instead.
+ */
+struct vm_channel_hdr {
+	uint32_t len;
+	uint32_t reserved;
+};
+
+#define VM_CHANNEL_ALIGN(len) (((len) + 7) & ~(size_t) 7)
+#define VM_CHANNEL_FRAME_SIZE(len) \
+	(sizeof(struct vm_channel_hdr) + VM_CHANNEL_ALIGN(len))
+
+/*
+ * Single producer, single consumer ring living in the shared memfd.
+ * head and tail are free running byte counters, each on its own cache
+ * line, only written by the producer and the consumer respectively.
+ */
+struct vm_ring_ctl {
+	uint32_t head;
+	char pad0[60];
+	uint32_t tail;
+	char pad1[60];
+};
+
+struct vm_ring {
+	struct vm_ring_ctl *ctl;
+	char *data;
+	uint32_t size;
+};
+
+/* Sent by a shm server along with the memfd and both eventfds */
+struct vm_channel_shm_setup {
+	uint32_t ring_size;
+};
+
+struct vm_channel {
+	enum vm_channel_type type;
+	enum vm_channel_role role;
+	bool framed;
+
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in in;
+		struct sockaddr_vm vm;
+		struct sockaddr_un un;
+	} addr;
+	socklen_t addr_len;
+
+	int listen_fd;
+	int conn_fd;
+	struct timespec last_connect;
+
+	/* socket backends */
+	char *tx_buf;
+	size_t tx_alloc;
+	size_t tx_len;
+	size_t tx_off;
+	size_t tx_reserved;
+
+	char *rx_buf;
+	size_t rx_alloc;
+	size_t rx_len;
+	size_t rx_start;
+
+	/* shm backend */
+	void *shm;
+	size_t shm_size;
+	struct vm_ring tx;
+	struct vm_ring rx;
+	int tx_event_fd;
+	int rx_event_fd;
+	uint32_t tx_frame;
+	uint32_t rx_frame;
+};
+
+static int64_t
+now_msec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return timespec_to_msec(&ts);
+}
+
+/* Remaining time until deadline for poll(), -1 stays infinite */
+static int
+remaining_msec(int64_t deadline)
+{
+	int64_t left;
+
+	if (deadline < 0)
+		return -1;
+
+	left = deadline - now_msec();
+	return left > 0 ? (int) left : 0;
+}
+
+static int
+poll_one(int fd, short events, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = fd, .events = events };
+	int ret;
+
+	do {
+		ret = poll(&pfd, 1, timeout_ms);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret <= 0)
+		return ret;
+
+	return pfd.revents;
+}
+
+static int
+parse_spec(struct vm_channel *ch, const char *spec)
+{
+	struct addrinfo hints, *res;
+	char host[256];
+	const char *port;
+	unsigned long cid;
+	char *end;
+
+	ch->framed = true;
+
+	if (strncmp(spec, "shm:", 4) == 0) {
+		ch->type = VM_CHANNEL_SHM;
+		ch->addr.un.sun_family = AF_UNIX;
+		if (strlen(spec + 4) >= sizeof(ch->addr.un.sun_path))
+			return -1;
+		strcpy(ch->addr.un.sun_path, spec + 4);
+		ch->addr_len = sizeof(ch->addr.un);
+		return 0;
+	}
+
+	if (strncmp(spec, "vsock:", 6) == 0) {
+		ch->type = VM_CHANNEL_VSOCK;
+		cid = strtoul(spec + 6, &end, 0);
+		if (*end != ':')
+			return -1;
+		ch->addr.vm.svm_family = AF_VSOCK;
+		ch->addr.vm.svm_cid = cid;
+		ch->addr.vm.svm_port = strtoul(end + 1, NULL, 0);
+		ch->addr_len = sizeof(ch->addr.vm);
+		return 0;
+	}
+
+	/* a bare <address>:<port> is the unframed --net byte stream */
+	if (strncmp(spec, "tcp:", 4) == 0)
+		spec += 4;
+	else
+		ch->framed = false;
+
+	ch->type = VM_CHANNEL_TCP;
+	port = strrchr(spec, ':');
+	if (!port || (size_t) (port - spec) >= sizeof(host))
+		return -1;
+
+	memcpy(host, spec, port - spec);
+	host[port - spec] = '\0';
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, port + 1, &hints, &res) != 0)
+		return -1;
+
+	memcpy(&ch->addr.in, res->ai_addr, sizeof(ch->addr.in));
+	ch->addr_len = sizeof(ch->addr.in);
+	freeaddrinfo(res);
+
+	return 0;
+}
+
+static void
+ring_init(struct vm_ring *ring, void *ctl, void *data, uint32_t size)
+{
+	ring->ctl = ctl;
+	ring->data = data;
+	ring->size = size;
+}
+
+/* Free bytes in the ring, seen from the producer */
+static uint32_t
+ring_free(struct vm_ring *ring)
+{
+	uint32_t head = ring->ctl->head;
+	uint32_t tail = __atomic_load_n(&ring->ctl->tail, __ATOMIC_ACQUIRE);
+
+	return ring->size - (head - tail);
+}
+
+/*
+ * Finds room for a message of len bytes at the ring head, marking the end
+ * of the ring as padding if the message has to wrap. Returns the number of
+ * ring bytes the message will take, or 0 if it does not fit right now.
+ */
+static uint32_t
+ring_reserve(struct vm_ring *ring, size_t len, void **data)
+{
+	uint32_t head = ring->ctl->head;
+	uint32_t pos = head & (ring->size - 1);
+	uint32_t contiguous = ring->size - pos;
+	size_t frame = VM_CHANNEL_FRAME_SIZE(len);
+	uint32_t total = frame;
+	struct vm_channel_hdr *hdr;
+
+	if (contiguous < frame)
+		total += contiguous;
+
+	if (frame > ring->size / 2 || total > ring_free(ring))
+		return 0;
+
+	if (contiguous < frame) {
+		/* the pad header fits: every frame is 8 byte aligned */
+		hdr = (struct vm_channel_hdr *) &ring->data[pos];
+		hdr->len = VM_CHANNEL_PAD;
+		pos = 0;
+	}
+
+	hdr = (struct vm_channel_hdr *) &ring->data[pos];
+	hdr->len = len;
+	*data = hdr + 1;
+
+	return total;
+}
+
+static void
+ring_commit(struct vm_ring *ring, uint32_t total)
+{
+	__atomic_store_n(&ring->ctl->head, ring->ctl->head + total,
+			 __ATOMIC_RELEASE);
+}
+
+/*
+ * Finds the next message and the ring bytes it occupies in *total.
+ * Returns 1 for a message, 0 if the ring is empty and -1 if the peer wrote
+ * a header that does not describe a frame inside the published data; the
+ * ring contents belong to the peer, so nothing in them is trusted.
+ */
+static int
+ring_peek(struct vm_ring *ring, const void **data, size_t *len,
+	  uint32_t *total)
+{
+	uint32_t tail = ring->ctl->tail;
+	uint32_t head = __atomic_load_n(&ring->ctl->head, __ATOMIC_ACQUIRE);
+	uint32_t avail = head - tail;
+	uint32_t pos = tail & (ring->size - 1);
+	uint32_t skip = 0;
+	struct vm_channel_hdr *hdr;
+	uint32_t hdr_len;
+	size_t frame;
+
+	*total = 0;
+	if (avail == 0)
+		return 0;
+	if (avail > ring->size || avail < sizeof(*hdr))
+		return -1;
+
+	hdr = (struct vm_channel_hdr *) &ring->data[pos];
+	hdr_len = __atomic_load_n(&hdr->len, __ATOMIC_RELAXED);
+	if (hdr_len == VM_CHANNEL_PAD) {
+		skip = ring->size - pos;
+		if (skip + sizeof(*hdr) > avail)
+			return -1;
+		pos = 0;
+		hdr = (struct vm_channel_hdr *) &ring->data[0];
+		hdr_len = __atomic_load_n(&hdr->len, __ATOMIC_RELAXED);
+	}
+
+	if (hdr_len > VM_CHANNEL_MAX_MESSAGE)
+		return -1;
+
+	frame = VM_CHANNEL_FRAME_SIZE(hdr_len);
+	if (skip + frame > avail || pos + frame > ring->size)
+		return -1;
+
+	*data = hdr + 1;
+	*len = hdr_len;
+	*total = skip + frame;
+
+	return 1;
+}
+
+static void
+ring_release(struct vm_ring *ring, uint32_t total)
+{
+	__atomic_store_n(&ring->ctl->tail, ring->ctl->tail + total,
+			 __ATOMIC_RELEASE);
+}
+
+static void
+event_signal(int fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		fprintf(stderr, "vm-channel: eventfd write failed: %m\n");
+}
+
+static void
+event_drain(int fd)
+{
+	uint64_t count;
+
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		fprintf(stderr, "vm-channel: eventfd read failed: %m\n");
+}
+
+static void
+channel_disconnect(struct vm_channel *ch)
+{
+	if (ch->conn_fd >= 0) {
+		close(ch->conn_fd);
+		ch->conn_fd = -1;
+	}
+
+	ch->tx_len = 0;
+	ch->tx_off = 0;
+	ch->tx_reserved = 0;
+	ch->rx_len = 0;
+	ch->rx_start = 0;
+
+	if (ch->shm) {
+		munmap(ch->shm, ch->shm_size);
+		ch->shm = NULL;
+	}
+	if (ch->tx_event_fd >= 0) {
+		close(ch->tx_event_fd);
+		ch->tx_event_fd = -1;
+	}
+	if (ch->rx_event_fd >= 0) {
+		close(ch->rx_event_fd);
+		ch->rx_event_fd = -1;
+	}
+	ch->tx_frame = 0;
+	ch->rx_frame = 0;
+}
+
+static int
+shm_map(struct vm_channel *ch, int fd, uint32_t ring_size)
+{
+	char *base;
+	struct vm_ring_ctl *ctl;
+	int tx, rx;
+
+	ch->shm_size = 2 * (sizeof(struct vm_ring_ctl) + ring_size);
+	ch->shm = mmap(NULL, ch->shm_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED, fd, 0);
+	if (ch->shm == MAP_FAILED) {
+		ch->shm = NULL;
+		return -1;
+	}
+
+	/* ring 0 carries server to client messages, ring 1 the others */
+	base = ch->shm;
+	ctl = ch->shm;
+	base += 2 * sizeof(struct vm_ring_ctl);
+	tx = ch->role == VM_CHANNEL_SERVER ? 0 : 1;
+	rx = !tx;
+	ring_init(&ch->tx, &ctl[tx], base + tx * ring_size, ring_size);
+	ring_init(&ch->rx, &ctl[rx], base + rx * ring_size, ring_size);
+
+	return 0;
+}
+
+/* Server side of the shm handshake: a fresh memfd for every peer */
+static int
+shm_setup_server(struct vm_channel *ch)
+{
+	struct vm_channel_shm_setup setup = {
+		.ring_size = VM_CHANNEL_SHM_RING_SIZE,
+	};
+	char control[CMSG_SPACE(3 * sizeof(int))];
+	struct iovec iov = { &setup, sizeof(setup) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	size_t size = 2 * (sizeof(struct vm_ring_ctl) + setup.ring_size);
+	int fds[3];
+	int ret;
+
+	fds[0] = memfd_create("vm-channel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fds[0] < 0)
+		return -1;
+
+	/* the client must not be able to pull the mapping from under us */
+	if (ftruncate(fds[0], size) < 0 ||
+	    fcntl(fds[0], F_ADD_SEALS,
+		  F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		close(fds[0]);
+		return -1;
+	}
+
+	if (shm_map(ch, fds[0], setup.ring_size) < 0) {
+		close(fds[0]);
+		return -1;
+	}
+	memset(ch->shm, 0, 2 * sizeof(struct vm_ring_ctl));
+
+	fds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	fds[2] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	ch->tx_event_fd = fds[1];
+	ch->rx_event_fd = fds[2];
+	if (fds[1] < 0 || fds[2] < 0) {
+		close(fds[0]);
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	ret = sendmsg(ch->conn_fd, &msg, MSG_NOSIGNAL);
+	close(fds[0]);
+
+	return ret == sizeof(setup) ? 0 : -1;
+}
+
+/*
+ * Client side of the shm handshake. The ring size and the memfd come from
+ * the server, so the memfd has to be large enough for the rings it claims
+ * and sealed against shrinking; touching a page past its end would SIGBUS.
+ */
+static int
+shm_setup_client(struct vm_channel *ch)
+{
+	struct vm_channel_shm_setup setup;
+	char control[CMSG_SPACE(3 * sizeof(int))];
+	struct iovec iov = { &setup, sizeof(setup) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct stat st;
+	int fds[3];
+	int seals;
+	int ret;
+
+	if (poll_one(ch->conn_fd, POLLIN, VM_CHANNEL_CONNECT_TIMEOUT_MS) <= 0)
+		return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ret = recvmsg(ch->conn_fd, &msg, MSG_CMSG_CLOEXEC);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (ret != sizeof(setup) || !cmsg ||
+	    cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+		return -1;
+
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	/* the server's tx event is our rx event and vice versa */
+	ch->rx_event_fd = fds[1];
+	ch->tx_event_fd = fds[2];
+
+	seals = fcntl(fds[0], F_GET_SEALS);
+	if (setup.ring_size < VM_CHANNEL_SHM_RING_MIN ||
+	    setup.ring_size > VM_CHANNEL_SHM_RING_MAX ||
+	    (setup.ring_size & (setup.ring_size - 1)) != 0 ||
+	    fstat(fds[0], &st) < 0 ||
+	    (uint64_t) st.st_size <
+	    2 * (sizeof(struct vm_ring_ctl) + (uint64_t) setup.ring_size) ||
+	    seals < 0 || !(seals & F_SEAL_SHRINK) ||
+	    shm_map(ch, fds[0], setup.ring_size) < 0) {
+		close(fds[0]);
+		return -1;
+	}
+	close(fds[0]);
+
+	return 0;
+}
+
+static int
+channel_setup_peer(struct vm_channel *ch)
+{
+	int enable = 1;
+
+	switch (ch->type) {
+	case VM_CHANNEL_SHM:
+		if (ch->role == VM_CHANNEL_SERVER)
+			return shm_setup_server(ch);
+		return shm_setup_client(ch);
+	case VM_CHANNEL_TCP:
+		setsockopt(ch->conn_fd, IPPROTO_TCP, TCP_NODELAY,
+			   &enable, sizeof(enable));
+		break;
+	case VM_CHANNEL_VSOCK:
+		break;
+	}
+
+	return 0;
+}
+
+static int
+channel_domain(struct vm_channel *ch)
+{
+	return ch->addr.sa.sa_family;
+}
+
+static bool
+channel_accept(struct vm_channel *ch, int timeout_ms)
+{
+	if (poll_one(ch->listen_fd, POLLIN, timeout_ms) <= 0)
+		return false;
+
+	ch->conn_fd = accept4(ch->listen_fd, NULL, NULL,
+			      SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (ch->conn_fd < 0)
+		return false;
+
+	if (channel_setup_peer(ch) < 0) {
+		channel_disconnect(ch);
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+channel_connect(struct vm_channel *ch, int timeout_ms)
+{
+	int64_t since = now_msec() - timespec_to_msec(&ch->last_connect);
+	int err = 0;
+	socklen_t err_len = sizeof(err);
+
+	/* back off between attempts, but still honour the caller's wait */
+	if (since < VM_CHANNEL_RECONNECT_MS) {
+		int wait = VM_CHANNEL_RECONNECT_MS - since;
+
+		if (timeout_ms >= 0 && timeout_ms < wait)
+			return false;
+		usleep(wait * 1000);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ch->last_connect);
+
+	ch->conn_fd = socket(channel_domain(ch),
+			     SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (ch->conn_fd < 0)
+		return false;
+
+	if (connect(ch->conn_fd, &ch->addr.sa, ch->addr_len) < 0) {
+		if (errno != EINPROGRESS ||
+		    poll_one(ch->conn_fd, POLLOUT,
+			     VM_CHANNEL_CONNECT_TIMEOUT_MS) <= 0 ||
+		    getsockopt(ch->conn_fd, SOL_SOCKET, SO_ERROR,
+			       &err, &err_len) < 0 || err != 0) {
+			channel_disconnect(ch);
+			return false;
+		}
+	}
+
+	if (channel_setup_peer(ch) < 0) {
+		channel_disconnect(ch);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+vm_channel_wait_connected(struct vm_channel *ch, int timeout_ms)
+{
+	int64_t deadline = timeout_ms < 0 ? -1 : now_msec() + timeout_ms;
+
+	do {
+		if (ch->conn_fd >= 0)
+			return true;
+
+		if (ch->role == VM_CHANNEL_SERVER) {
+			if (channel_accept(ch, remaining_msec(deadline)))
+				return true;
+		} else {
+			if (channel_connect(ch, remaining_msec(deadline)))
+				return true;
+		}
+	} while (remaining_msec(deadline) != 0);
+
+	return false;
+}
+
+/* Reports a lost peer once and prepares for the next one */
+static int
+channel_lost(struct vm_channel *ch)
+{
+	channel_disconnect(ch);
+	errno = EPIPE;
+
+	return -1;
+}
+
+/* A shm peer only shows up as gone on its handshake socket */
+static bool
+shm_peer_alive(struct vm_channel *ch)
+{
+	char c;
+	int revents = poll_one(ch->conn_fd, POLLIN, 0);
+	ssize_t ret;
+
+	if (revents == 0)
+		return true;
+
+	ret = recv(ch->conn_fd, &c, 1, MSG_DONTWAIT | MSG_PEEK);
+	if (ret < 0)
+		return errno == EAGAIN || errno == EINTR;
+
+	return ret > 0;
+}
+
+/* Unframed channels send the message bytes alone */
+static size_t
+socket_hdr_size(struct vm_channel *ch)
+{
+	return ch->framed ? sizeof(struct vm_channel_hdr) : 0;
+}
+
+/* Bytes a message of len takes on the wire */
+static size_t
+socket_frame_size(struct vm_channel *ch, size_t len)
+{
+	return ch->framed ? VM_CHANNEL_FRAME_SIZE(len) : len;
+}
+
+/* Pushes queued socket data, returns 1 if some is still pending */
+static int
+socket_flush(struct vm_channel *ch)
+{
+	ssize_t ret;
+
+	while (ch->tx_off < ch->tx_len) {
+		ret = send(ch->conn_fd, ch->tx_buf + ch->tx_off,
+			   ch->tx_len - ch->tx_off,
+			   MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 1;
+			return -1;
+		}
+		ch->tx_off += ret;
+	}
+
+	ch->tx_len = 0;
+	ch->tx_off = 0;
+
+	return 0;
+}
+
+size_t
+vm_channel_send_space(struct vm_channel *ch)
+{
+	struct vm_ring *ring = &ch->tx;
+	uint32_t free, pos, contiguous, space;
+
+	if (!vm_channel_wait_connected(ch, 0))
+		return 0;
+
+	if (ch->type != VM_CHANNEL_SHM) {
+		if (socket_flush(ch) != 0)
+			return 0;
+		return VM_CHANNEL_MAX_MESSAGE;
+	}
+
+	free = ring_free(ring);
+	pos = ring->ctl->head & (ring->size - 1);
+	contiguous = ring->size - pos;
+	if (free > contiguous)
+		space = MAX(contiguous, free - contiguous);
+	else
+		space = free;
+	space = MIN(space, ring->size / 2);
+
+	if (space <= sizeof(struct vm_channel_hdr))
+		return 0;
+
+	return (space - sizeof(struct vm_channel_hdr)) & ~(size_t) 7;
+}
+
+void *
+vm_channel_send_reserve(struct vm_channel *ch, size_t len)
+{
+	void *data;
+	size_t size;
+	char *buf;
+
+	if (!vm_channel_wait_connected(ch, 0)) {
+		errno = ENOTCONN;
+		return NULL;
+	}
+
+	if (ch->type == VM_CHANNEL_SHM) {
+		ch->tx_frame = ring_reserve(&ch->tx, len, &data);
+		if (ch->tx_frame)
+			return data;
+
+		/* a ring that stays full may mean the reader is gone */
+		if (!shm_peer_alive(ch))
+			channel_lost(ch);
+		else
+			errno = EAGAIN;
+		return NULL;
+	}
+
+	if (len > VM_CHANNEL_MAX_MESSAGE) {
+		errno = EMSGSIZE;
+		return NULL;
+	}
+
+	switch (socket_flush(ch)) {
+	case 1:
+		errno = EAGAIN;
+		return NULL;
+	case -1:
+		channel_lost(ch);
+		return NULL;
+	}
+
+	size = socket_frame_size(ch, len);
+	if (ch->tx_alloc < size) {
+		buf = realloc(ch->tx_buf, size);
+		if (!buf)
+			return NULL;
+		ch->tx_buf = buf;
+		ch->tx_alloc = size;
+	}
+
+	ch->tx_reserved = len;
+
+	return ch->tx_buf + socket_hdr_size(ch);
+}
+
+int
+vm_channel_send_commit(struct vm_channel *ch)
+{
+	struct vm_channel_hdr *hdr;
+
+	if (ch->type == VM_CHANNEL_SHM) {
+		if (!ch->shm || !ch->tx_frame)
+			return -1;
+		ring_commit(&ch->tx, ch->tx_frame);
+		ch->tx_frame = 0;
+		event_signal(ch->tx_event_fd);
+		return 0;
+	}
+
+	if (ch->conn_fd < 0)
+		return -1;
+
+	/* partial writes stay queued, the message is never torn */
+	ch->tx_len = socket_frame_size(ch, ch->tx_reserved);
+	if (ch->framed) {
+		hdr = (struct vm_channel_hdr *) ch->tx_buf;
+		hdr->len = ch->tx_reserved;
+		hdr->reserved = 0;
+		memset(ch->tx_buf + sizeof(*hdr) + ch->tx_reserved, 0,
+		       ch->tx_len - sizeof(*hdr) - ch->tx_reserved);
+	}
+	ch->tx_off = 0;
+	ch->tx_reserved = 0;
+
+	return vm_channel_flush(ch);
+}
+
+int
+vm_channel_flush(struct vm_channel *ch)
+{
+	int ret;
+
+	if (ch->type == VM_CHANNEL_SHM || ch->conn_fd < 0)
+		return 0;
+
+	ret = socket_flush(ch);
+	if (ret < 0)
+		return channel_lost(ch);
+
+	return ret;
+}
+
+int
+vm_channel_send(struct vm_channel *ch, const void *data, size_t len)
+{
+	void *msg;
+
+	msg = vm_channel_send_reserve(ch, len);
+	if (!msg)
+		return errno == EAGAIN ? 0 : -1;
+
+	memcpy(msg, data, len);
+	if (vm_channel_send_commit(ch) < 0)
+		return -1;
+
+	return len;
+}
+
+/*
+ * Returns 1 with a complete message, 0 if more data is needed. Unframed
+ * channels hand out whatever arrived so far as the message.
+ */
+static int
+socket_parse(struct vm_channel *ch, const void **data, size_t *len)
+{
+	struct vm_channel_hdr *hdr;
+	size_t avail = ch->rx_len - ch->rx_start;
+
+	if (!ch->framed) {
+		if (avail == 0)
+			return 0;
+		*data = ch->rx_buf + ch->rx_start;
+		*len = avail;
+		return 1;
+	}
+
+	if (avail < sizeof(*hdr))
+		return 0;
+
+	hdr = (struct vm_channel_hdr *) (ch->rx_buf + ch->rx_start);
+	if (hdr->len > VM_CHANNEL_MAX_MESSAGE ||
+	    avail < VM_CHANNEL_FRAME_SIZE(hdr->len))
+		return 0;
+
+	*data = hdr + 1;
+	*len = hdr->len;
+
+	return 1;
+}
+
+static int
+socket_fill(struct vm_channel *ch)
+{
+	struct vm_channel_hdr *hdr;
+	size_t need = sizeof(*hdr);
+	ssize_t ret;
+	char *buf;
+
+	if (ch->rx_start > 0) {
+		memmove(ch->rx_buf, ch->rx_buf + ch->rx_start,
+			ch->rx_len - ch->rx_start);
+		ch->rx_len -= ch->rx_start;
+		ch->rx_start = 0;
+	}
+
+	if (ch->framed && ch->rx_len >= sizeof(*hdr)) {
+		hdr = (struct vm_channel_hdr *) ch->rx_buf;
+		if (hdr->len > VM_CHANNEL_MAX_MESSAGE)
+			return -1;
+		need = VM_CHANNEL_FRAME_SIZE(hdr->len);
+	}
+
+	need = MAX(need, 4096);
+	if (ch->rx_alloc < need) {
+		buf = realloc(ch->rx_buf, need);
+		if (!buf)
+			return -1;
+		ch->rx_buf = buf;
+		ch->rx_alloc = need;
+	}
+
+	do {
+		ret = recv(ch->conn_fd, ch->rx_buf + ch->rx_len,
+			   ch->rx_alloc - ch->rx_len, MSG_DONTWAIT);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret == 0)
+		return -1;
+	if (ret < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+	ch->rx_len += ret;
+
+	return 1;
+}
+
+int
+vm_channel_recv(struct vm_channel *ch, const void **data, size_t *len,
+		int timeout_ms)
+{
+	int64_t deadline = timeout_ms < 0 ? -1 : now_msec() + timeout_ms;
+	struct pollfd pfd[2];
+	int ret;
+
+	for (;;) {
+		if (!vm_channel_wait_connected(ch, remaining_msec(deadline)))
+			return 0;
+
+		if (ch->type == VM_CHANNEL_SHM) {
+			/* only pay for draining the eventfd when idle */
+			ret = ring_peek(&ch->rx, data, len, &ch->rx_frame);
+			if (ret == 0) {
+				event_drain(ch->rx_event_fd);
+				ret = ring_peek(&ch->rx, data, len,
+						&ch->rx_frame);
+			}
+			if (ret < 0) {
+				ch->rx_frame = 0;
+				return channel_lost(ch);
+			}
+			if (ret > 0)
+				return 1;
+		} else {
+			/* a reply may be waiting for the rest of our message */
+			if (socket_flush(ch) < 0)
+				return channel_lost(ch);
+			if (socket_parse(ch, data, len))
+				return 1;
+			ret = socket_fill(ch);
+			if (ret < 0)
+				return channel_lost(ch);
+			if (ret > 0)
+				continue;
+		}
+
+		pfd[0].fd = ch->conn_fd;
+		pfd[0].events = POLLIN;
+		if (ch->tx_off < ch->tx_len)
+			pfd[0].events |= POLLOUT;
+		pfd[1].fd = ch->rx_event_fd;
+		pfd[1].events = POLLIN;
+		do {
+			ret = poll(pfd, ch->type == VM_CHANNEL_SHM ? 2 : 1,
+				   remaining_msec(deadline));
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret < 0)
+			return -1;
+		if (ret == 0)
+			return 0;
+
+		if (ch->type == VM_CHANNEL_SHM && pfd[0].revents &&
+		    !shm_peer_alive(ch))
+			return channel_lost(ch);
+	}
+}
+
+void
+vm_channel_recv_release(struct vm_channel *ch)
+{
+	struct vm_channel_hdr *hdr;
+
+	if (ch->type == VM_CHANNEL_SHM) {
+		if (ch->shm && ch->rx_frame)
+			ring_release(&ch->rx, ch->rx_frame);
+		ch->rx_frame = 0;
+		return;
+	}
+
+	if (!ch->framed) {
+		ch->rx_start = ch->rx_len;
+		return;
+	}
+
+	if (ch->rx_len - ch->rx_start < sizeof(*hdr))
+		return;
+
+	hdr = (struct vm_channel_hdr *) (ch->rx_buf + ch->rx_start);
+	ch->rx_start += VM_CHANNEL_FRAME_SIZE(hdr->len);
+}
+
+bool
+vm_channel_is_framed(struct vm_channel *ch)
+{
+	return ch->framed;
+}
+
+struct vm_channel *
+vm_channel_create(const char *spec, enum vm_channel_role role)
+{
+	struct vm_channel *ch;
+	int enable = 1;
+
+	ch = calloc(1, sizeof *ch);
+	if (!ch)
+		return NULL;
+
+	ch->role = role;
+	ch->listen_fd = -1;
+	ch->conn_fd = -1;
+	ch->tx_event_fd = -1;
+	ch->rx_event_fd = -1;
+
+	if (parse_spec(ch, spec) < 0) {
+		fprintf(stderr, "vm-channel: cannot parse '%s'\n", spec);
+		free(ch);
+		return NULL;
+	}
+
+	if (role == VM_CHANNEL_CLIENT) {
+		/* the first attempt is made right away */
+		if (!vm_channel_wait_connected(ch, 0))
+			fprintf(stderr, "vm-channel: %s not reachable yet\n",
+				spec);
+		return ch;
+	}
+
+	ch->listen_fd = socket(channel_domain(ch),
+			       SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (ch->listen_fd < 0)
+		goto err;
+
+	if (ch->type == VM_CHANNEL_SHM)
+		unlink(ch->addr.un.sun_path);
+	else
+		setsockopt(ch->listen_fd, SOL_SOCKET, SO_REUSEADDR,
+			   &enable, sizeof(enable));
+
+	if (bind(ch->listen_fd, &ch->addr.sa, ch->addr_len) < 0 ||
+	    listen(ch->listen_fd, 1) < 0) {
+		fprintf(stderr, "vm-channel: cannot listen on '%s': %m\n",
+			spec);
+		goto err;
+	}
+
+	return ch;
+
+err:
+	vm_channel_destroy(ch);
+	return NULL;
+}
+
+void
+vm_channel_destroy(struct vm_channel *ch)
+{
+	if (!ch)
+		return;
+
+	channel_disconnect(ch);
+
+	if (ch->listen_fd >= 0) {
+		close(ch->listen_fd);
+		if (ch->type == VM_CHANNEL_SHM)
+			unlink(ch->addr.un.sun_path);
+	}
+
+	free(ch->tx_buf);
+	free(ch->rx_buf);
+	free(ch);
+}
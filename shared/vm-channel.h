@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_VM_CHANNEL_H
+#define WESTON_VM_CHANNEL_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Transport for the VM surface sharing metadata and input streams, used by
+ * the compositor's vm_comm plugins and by vmdisplay alike.
+ *
+ * A channel carries framed messages and is selected by a spec string:
+ *
+ *   shm:<socket path>        memfd rings + eventfds, for VMs and containers
+ *                            on the same host; the unix socket at the path is
+ *                            only used to hand over the fds
+ *   tcp:<address>:<port>     TCP
+ *   vsock:<cid>:<port>       AF_VSOCK
+ *   <address>:<port>         TCP without framing, the byte stream the --net
+ *                            transport always used: messages go out as
+ *                            their bare bytes and a receive returns
+ *                            whatever bytes arrived, so the reader has to
+ *                            find message boundaries itself
+ *
+ * The server side creates the channel and waits for a peer, the client side
+ * connects to it. Neither side uses threads or signals: a lost peer is
+ * reported once as -1 with errno set to EPIPE, after which the channel goes
+ * back to waiting for (server) or reconnecting to (client) a peer on the
+ * next call. Only calls given a timeout wait for data; reaching a peer
+ * and the shm handshake may each take up to about a second.
+ */
+
+enum vm_channel_role {
+	VM_CHANNEL_SERVER = 0,
+	VM_CHANNEL_CLIENT,
+};
+
+struct vm_channel;
+
+struct vm_channel *
+vm_channel_create(const char *spec, enum vm_channel_role role);
+
+void
+vm_channel_destroy(struct vm_channel *ch);
+
+/* Waits up to timeout_ms (-1 forever) for a peer. Returns true if one is
+ * connected. */
+bool
+vm_channel_wait_connected(struct vm_channel *ch, int timeout_ms);
+
+/* Largest message that can currently be sent without waiting, 0 when the
+ * channel is busy or has no peer. */
+size_t
+vm_channel_send_space(struct vm_channel *ch);
+
+/*
+ * Zero-copy send: reserve returns memory for a message of len bytes,
+ * directly in the shared ring for the shm backend, and commit hands it to
+ * the peer. Returns NULL with errno EAGAIN when there is no room right now
+ * and EPIPE or ENOTCONN when there is no peer.
+ */
+void *
+vm_channel_send_reserve(struct vm_channel *ch, size_t len);
+
+/* Returns 0 once the message is written out, 1 if the socket backends
+ * had to queue part of it and -1 on error or a lost peer. */
+int
+vm_channel_send_commit(struct vm_channel *ch);
+
+/*
+ * Writes out what a commit had to queue. Returns 0 when nothing is left,
+ * 1 if some still is and -1 on a lost peer. vm_channel_recv() and the next
+ * send do this as well; a sender with nothing else to do has to call it
+ * until it returns 0, or the tail of its last message stays queued.
+ */
+int
+vm_channel_flush(struct vm_channel *ch);
+
+/* Copying convenience wrapper, returns len once the message is taken,
+ * 0 if it would block or -1. Part of it may still be queued, see
+ * vm_channel_flush(). */
+int
+vm_channel_send(struct vm_channel *ch, const void *data, size_t len);
+
+/*
+ * Zero-copy receive: on success *data points to the next message, valid
+ * until vm_channel_recv_release(). Returns 1 for a message, 0 on timeout
+ * and -1 on error or a lost peer.
+ */
+int
+vm_channel_recv(struct vm_channel *ch, const void **data, size_t *len,
+		int timeout_ms);
+
+void
+vm_channel_recv_release(struct vm_channel *ch);
+
+/* False for the unframed <address>:<port> stream */
+bool
+vm_channel_is_framed(struct vm_channel *ch);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_VM_CHANNEL_H */
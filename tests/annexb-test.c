@@ -0,0 +1,338 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/annexb.h"
+#include "shared/timespec-util.h"
+#include "zunitc/zunitc.h"
+
+static const enum annexb_scanner scanners[] = {
+	ANNEXB_SCANNER_SCALAR,
+	ANNEXB_SCANNER_SSE2,
+	ANNEXB_SCANNER_AVX2,
+};
+
+static const char *scanner_names[] = { "scalar", "sse2", "avx2" };
+
+static const uint8_t *
+find_reference(const uint8_t *p, const uint8_t *end)
+{
+	for (; end - p >= 3; p++)
+		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+			return p;
+
+	return end;
+}
+
+/* Mostly random bytes, with enough zero runs and start codes that every
+ * partial match a scanner can trip over shows up. */
+static void
+fill_stream(uint8_t *buf, size_t size, unsigned seed)
+{
+	size_t i;
+
+	srand(seed);
+	for (i = 0; i < size; i++) {
+		switch (rand() % 8) {
+		case 0:
+		case 1:
+			buf[i] = 0;
+			break;
+		case 2:
+			buf[i] = 1;
+			break;
+		default:
+			buf[i] = rand();
+			break;
+		}
+	}
+}
+
+ZUC_TEST(annexb_test, scanners_match_reference)
+{
+	uint8_t buf[300];
+	annexb_find_func_t find;
+	const uint8_t *end, *p, *expect;
+	unsigned s, seed, len;
+
+	for (s = 0; s < ARRAY_LENGTH(scanners); s++) {
+		find = annexb_get_scanner(scanners[s]);
+		if (!find) {
+			printf("%s scanner not available\n", scanner_names[s]);
+			continue;
+		}
+
+		for (seed = 0; seed < 200; seed++) {
+			fill_stream(buf, sizeof buf, seed);
+
+			/* every length, so each block boundary and tail is hit */
+			for (len = 0; len <= sizeof buf; len++) {
+				end = buf + len;
+				p = buf;
+				do {
+					expect = find_reference(p, end);
+					ZUC_ASSERT_EQ(expect, find(p, end));
+					p = expect + 1;
+				} while (expect != end);
+			}
+		}
+	}
+}
+
+ZUC_TEST(annexb_test, start_code_at_block_edges)
+{
+	uint8_t buf[128];
+	annexb_find_func_t find;
+	unsigned s, pos;
+
+	for (s = 0; s < ARRAY_LENGTH(scanners); s++) {
+		find = annexb_get_scanner(scanners[s]);
+		if (!find)
+			continue;
+
+		for (pos = 0; pos + 3 <= sizeof buf; pos++) {
+			memset(buf, 0xff, sizeof buf);
+			buf[pos] = 0;
+			buf[pos + 1] = 0;
+			buf[pos + 2] = 1;
+
+			ZUC_ASSERT_EQ(buf + pos, find(buf, buf + sizeof buf));
+			/* cut right before the last byte of the start code */
+			ZUC_ASSERT_EQ(buf + pos + 2, find(buf, buf + pos + 2));
+		}
+	}
+}
+
+ZUC_TEST(annexb_test, index_frame)
+{
+	static const uint8_t frame[] = {
+		0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1f,	/* SPS */
+		0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,	/* PPS */
+		0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x00,	/* IDR */
+		0x03, 0x01, 0x02,
+	};
+	struct annexb_index index;
+	struct annexb_nal *nal;
+
+	annexb_index_init(&index);
+
+	ZUC_ASSERTG_EQ(0, annexb_index_frame(&index, frame, sizeof frame), out);
+	ZUC_ASSERTG_EQ(3, index.count, out);
+	ZUC_ASSERTG_EQ(0, index.leading, out);
+	ZUC_ASSERTG_EQ(ANNEXB_FRAME_SPS | ANNEXB_FRAME_PPS | ANNEXB_FRAME_IDR,
+		       index.flags, out);
+
+	nal = &index.nals[0];
+	ZUC_ASSERTG_EQ(ANNEXB_NAL_SPS, nal->type, out);
+	ZUC_ASSERTG_EQ(3, nal->ref_idc, out);
+	ZUC_ASSERTG_EQ(4, nal->offset, out);
+	ZUC_ASSERTG_EQ(4, nal->size, out);
+	ZUC_ASSERTG_EQ(4, nal->start_code_size, out);
+
+	nal = &index.nals[1];
+	ZUC_ASSERTG_EQ(ANNEXB_NAL_PPS, nal->type, out);
+	ZUC_ASSERTG_EQ(12, nal->offset, out);
+	ZUC_ASSERTG_EQ(4, nal->size, out);
+
+	/* emulation prevention bytes are payload, not a start code */
+	nal = &index.nals[2];
+	ZUC_ASSERTG_EQ(ANNEXB_NAL_IDR, nal->type, out);
+	ZUC_ASSERTG_EQ(3, nal->start_code_size, out);
+	ZUC_ASSERTG_EQ(19, nal->offset, out);
+	ZUC_ASSERTG_EQ(sizeof frame - 19, nal->size, out);
+
+	/* the index is reused for the next frame */
+	ZUC_ASSERTG_EQ(0, annexb_index_frame(&index, frame + 16,
+					     sizeof frame - 16), out);
+	ZUC_ASSERTG_EQ(1, index.count, out);
+	ZUC_ASSERTG_EQ(ANNEXB_FRAME_IDR, index.flags, out);
+	ZUC_ASSERTG_EQ(3, index.nals[0].offset, out);
+
+out:
+	annexb_index_release(&index);
+}
+
+ZUC_TEST(annexb_test, index_malformed)
+{
+	static const uint8_t garbage[] = { 0x12, 0x34, 0x00, 0x00, 0x02 };
+	static const uint8_t leading[] = {
+		0xaa, 0xbb, 0x00, 0x00, 0x00, 0x01, 0x41, 0x9a,
+	};
+	static const uint8_t empty_nals[] = {
+		0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x09, 0xf0,
+		0x00, 0x00, 0x00, 0x01,
+	};
+	struct annexb_index index;
+
+	annexb_index_init(&index);
+
+	ZUC_ASSERTG_EQ(0, annexb_index_frame(&index, garbage, 0), out);
+	ZUC_ASSERTG_EQ(0, index.count, out);
+
+	ZUC_ASSERTG_EQ(0, annexb_index_frame(&index, garbage, sizeof garbage),
+		       out);
+	ZUC_ASSERTG_EQ(0, index.count, out);
+	ZUC_ASSERTG_EQ(sizeof garbage, index.leading, out);
+
+	ZUC_ASSERTG_EQ(0, annexb_index_frame(&index, leading, sizeof leading),
+		       out);
+	ZUC_ASSERTG_EQ(2, index.leading, out);
+	ZUC_ASSERTG_EQ(1, index.count, out);
+	ZUC_ASSERTG_EQ(ANNEXB_NAL_SLICE, index.nals[0].type, out);
+	ZUC_ASSERTG_EQ(2, index.nals[0].ref_idc, out);
+	ZUC_ASSERTG_EQ(0, index.flags, out);
+
+	/* back to back start codes and one at the very end */
+	ZUC_ASSERTG_EQ(0, annexb_index_frame(&index, empty_nals,
+					     sizeof empty_nals), out);
+	ZUC_ASSERTG_EQ(1, index.count, out);
+	ZUC_ASSERTG_EQ(ANNEXB_NAL_AUD, index.nals[0].type, out);
+	ZUC_ASSERTG_EQ(2, index.nals[0].size, out);
+
+out:
+	annexb_index_release(&index);
+}
+
+ZUC_TEST(annexb_test, index_many_nals)
+{
+	uint8_t buf[4 * 1000];
+	struct annexb_index index;
+	unsigned i;
+
+	/* a frame split into many slices grows the index */
+	for (i = 0; i < 1000; i++) {
+		buf[i * 4] = 0;
+		buf[i * 4 + 1] = 0;
+		buf[i * 4 + 2] = 1;
+		buf[i * 4 + 3] = 0x21;
+	}
+
+	annexb_index_init(&index);
+	ZUC_ASSERTG_EQ(0, annexb_index_frame(&index, buf, sizeof buf), out);
+	ZUC_ASSERTG_EQ(1000, index.count, out);
+	for (i = 0; i < 1000; i++) {
+		ZUC_ASSERTG_EQ(i * 4 + 3, index.nals[i].offset, out);
+		ZUC_ASSERTG_EQ(1, index.nals[i].size, out);
+	}
+
+out:
+	annexb_index_release(&index);
+}
+
+/* The scanner the UDP transport used before, one byte at a time. */
+static const uint8_t *
+find_bytewise(const uint8_t *p, const uint8_t *end)
+{
+	while (end - p >= 3) {
+		if (p[0] == 0x00) {
+			if (p[1] == 0x00) {
+				if (p[2] == 0x01)
+					return p;
+			}
+		}
+		p++;
+	}
+
+	return end;
+}
+
+static double
+scan_mb_per_s(annexb_find_func_t find, const uint8_t *buf, size_t size,
+	      unsigned rounds)
+{
+	struct timespec start, end;
+	const uint8_t *p;
+	unsigned i, found = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < rounds; i++) {
+		for (p = find(buf, buf + size); p != buf + size;
+		     p = find(p + 3, buf + size))
+			found++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (found != rounds * 4)
+		return -1.0;
+
+	return (double)size * rounds /
+	       timespec_sub_to_nsec(&end, &start) * 1000.0;
+}
+
+ZUC_TEST(annexb_test, scan_benchmark)
+{
+	/* about one 1080p frame at 8 Mbit/s and 30 fps */
+	const size_t size = 32 * 1024;
+	uint8_t *buf;
+	unsigned i, s;
+	double rate;
+
+	buf = malloc(size);
+	ZUC_ASSERT_NOT_NULL(buf);
+
+	/* compressed slice data has no start codes; the encoder inserts
+	 * emulation prevention bytes */
+	srand(1);
+	for (i = 0; i < size; i++)
+		buf[i] = rand();
+	for (i = 2; i < size; i++)
+		if (buf[i - 2] == 0 && buf[i - 1] == 0 && buf[i] <= 3)
+			buf[i] = 4;
+	for (i = 0; i < 4; i++) {
+		size_t pos = i * (size / 4) + 1;
+
+		buf[pos - 1] = 0x80;
+		buf[pos] = 0;
+		buf[pos + 1] = 0;
+		buf[pos + 2] = 1;
+		buf[pos + 3] = 0x80;
+	}
+
+	rate = scan_mb_per_s(find_bytewise, buf, size, 2000);
+	ZUC_ASSERTG_TRUE(rate >= 0.0, out);
+	printf("bytewise: %.0f MB/s\n", rate);
+
+	for (s = 0; s < ARRAY_LENGTH(scanners); s++) {
+		annexb_find_func_t find = annexb_get_scanner(scanners[s]);
+
+		if (!find)
+			continue;
+
+		rate = scan_mb_per_s(find, buf, size, 2000);
+		ZUC_ASSERTG_TRUE(rate >= 0.0, out);
+		printf("%s: %.0f MB/s\n", scanner_names[s], rate);
+	}
+
+out:
+	free(buf);
+}
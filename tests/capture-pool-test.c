@@ -0,0 +1,369 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "shared/helpers.h"
+#include "libweston/backend-ias/capture-pool.h"
+#include "zunitc/zunitc.h"
+
+struct fake_object {
+	struct capture_pool_key key;
+	void *source;
+};
+
+struct fake_allocator {
+	int live;
+	int created;
+	int destroyed;
+	int refills_scheduled;
+	int fail;
+};
+
+static void *
+fake_create(void *data, const struct capture_pool_key *key, void *source)
+{
+	struct fake_allocator *fa = data;
+	struct fake_object *obj;
+
+	if (fa->fail)
+		return NULL;
+
+	obj = calloc(1, sizeof *obj);
+	obj->key = *key;
+	obj->source = source;
+	fa->live++;
+	fa->created++;
+
+	return obj;
+}
+
+static void
+fake_destroy(void *data, void *object)
+{
+	struct fake_allocator *fa = data;
+
+	fa->live--;
+	fa->destroyed++;
+	free(object);
+}
+
+static void
+fake_schedule_refill(void *data)
+{
+	struct fake_allocator *fa = data;
+
+	fa->refills_scheduled++;
+}
+
+static struct capture_pool *
+fake_pool_create(struct fake_allocator *fa, unsigned capacity,
+		 unsigned spares)
+{
+	struct capture_pool_allocator allocator = {
+		.create = fake_create,
+		.destroy = fake_destroy,
+		.schedule_refill = fake_schedule_refill,
+		.data = fa,
+	};
+
+	memset(fa, 0, sizeof *fa);
+
+	return capture_pool_create(&allocator, capacity, spares);
+}
+
+static struct capture_pool_key
+make_key(uint32_t width, uint32_t height)
+{
+	struct capture_pool_key key;
+
+	memset(&key, 0, sizeof key);
+	key.width = width;
+	key.height = height;
+	key.format = 1;
+
+	return key;
+}
+
+ZUC_TEST(capture_pool_test, reuse_after_release)
+{
+	struct fake_allocator fa;
+	struct capture_pool *pool = fake_pool_create(&fa, 4, 0);
+	struct capture_pool_key key = make_key(640, 480);
+	struct capture_pool_stats stats;
+	void *a, *b;
+
+	ZUC_ASSERT_NOT_NULL(pool);
+
+	a = capture_pool_acquire(pool, &key, NULL);
+	ZUC_ASSERT_NOT_NULL(a);
+	capture_pool_release(pool, a);
+
+	b = capture_pool_acquire(pool, &key, NULL);
+	ZUC_ASSERT_EQ(a, b);
+	ZUC_ASSERT_EQ(1, fa.created);
+
+	capture_pool_get_stats(pool, &stats);
+	ZUC_ASSERT_EQ(1, stats.hits);
+	ZUC_ASSERT_EQ(1, stats.misses);
+	ZUC_ASSERT_EQ(1, stats.allocations);
+
+	/* no spares, so nothing is ever queued for refill */
+	ZUC_ASSERT_EQ(0, fa.refills_scheduled);
+
+	/* objects still in use go with the pool */
+	capture_pool_destroy(pool);
+	ZUC_ASSERT_EQ(0, fa.live);
+}
+
+ZUC_TEST(capture_pool_test, keys_do_not_mix)
+{
+	struct fake_allocator fa;
+	struct capture_pool *pool = fake_pool_create(&fa, 4, 0);
+	struct capture_pool_key small = make_key(640, 480);
+	struct capture_pool_key big = make_key(1920, 1080);
+	struct capture_pool_key strided = make_key(640, 480);
+	struct fake_object *obj;
+
+	strided.stride = 4096;
+
+	obj = capture_pool_acquire(pool, &small, NULL);
+	capture_pool_release(pool, obj);
+
+	obj = capture_pool_acquire(pool, &big, NULL);
+	ZUC_ASSERT_EQ(1920, obj->key.width);
+	capture_pool_release(pool, obj);
+
+	obj = capture_pool_acquire(pool, &strided, NULL);
+	ZUC_ASSERT_EQ(4096, obj->key.stride);
+	capture_pool_release(pool, obj);
+
+	ZUC_ASSERT_EQ(3, fa.created);
+
+	obj = capture_pool_acquire(pool, &small, NULL);
+	ZUC_ASSERT_EQ(0, obj->key.stride);
+	ZUC_ASSERT_EQ(640, obj->key.width);
+	ZUC_ASSERT_EQ(3, fa.created);
+	capture_pool_release(pool, obj);
+
+	capture_pool_destroy(pool);
+	ZUC_ASSERT_EQ(0, fa.live);
+}
+
+ZUC_TEST(capture_pool_test, lru_eviction)
+{
+	struct fake_allocator fa;
+	struct capture_pool *pool = fake_pool_create(&fa, 2, 0);
+	struct capture_pool_key keys[3] = {
+		make_key(1, 1), make_key(2, 2), make_key(3, 3),
+	};
+	struct capture_pool_stats stats;
+	void *objs[3];
+	int i;
+
+	for (i = 0; i < 3; i++)
+		objs[i] = capture_pool_acquire(pool, &keys[i], NULL);
+
+	/* in-use objects do not count against the capacity */
+	ZUC_ASSERT_EQ(3, fa.live);
+
+	for (i = 0; i < 3; i++)
+		capture_pool_release(pool, objs[i]);
+
+	/* the first released is the least recently used one */
+	ZUC_ASSERT_EQ(2, fa.live);
+	capture_pool_get_stats(pool, &stats);
+	ZUC_ASSERT_EQ(1, stats.evictions);
+
+	ZUC_ASSERT_EQ(objs[1], capture_pool_acquire(pool, &keys[1], NULL));
+	ZUC_ASSERT_EQ(objs[2], capture_pool_acquire(pool, &keys[2], NULL));
+	ZUC_ASSERT_NE(objs[0], capture_pool_acquire(pool, &keys[0], NULL));
+
+	capture_pool_destroy(pool);
+	ZUC_ASSERT_EQ(0, fa.live);
+}
+
+ZUC_TEST(capture_pool_test, refill_after_miss)
+{
+	struct fake_allocator fa;
+	struct capture_pool *pool = fake_pool_create(&fa, 8, 3);
+	struct capture_pool_key key = make_key(320, 240);
+	struct capture_pool_stats stats;
+	void *objs[4];
+	int i;
+
+	objs[0] = capture_pool_acquire(pool, &key, &fa);
+	ZUC_ASSERT_EQ(&fa, ((struct fake_object *)objs[0])->source);
+	ZUC_ASSERT_EQ(1, fa.refills_scheduled);
+
+	/* a second miss for the same key before the refill ran is folded
+	 * into the pending one */
+	objs[1] = capture_pool_acquire(pool, &key, NULL);
+	ZUC_ASSERT_EQ(1, fa.refills_scheduled);
+
+	capture_pool_refill(pool);
+	ZUC_ASSERT_EQ(5, fa.created);
+
+	/* the next frames hit, even with both earlier ones still out */
+	for (i = 2; i < 4; i++)
+		objs[i] = capture_pool_acquire(pool, &key, NULL);
+	ZUC_ASSERT_EQ(5, fa.created);
+
+	capture_pool_get_stats(pool, &stats);
+	ZUC_ASSERT_EQ(2, stats.hits);
+	ZUC_ASSERT_EQ(2, stats.misses);
+	ZUC_ASSERT_EQ(3, stats.refills);
+
+	/* nothing pending, a refill is a no-op */
+	capture_pool_refill(pool);
+	ZUC_ASSERT_EQ(5, fa.created);
+
+	for (i = 0; i < 4; i++)
+		capture_pool_release(pool, objs[i]);
+
+	capture_pool_destroy(pool);
+	ZUC_ASSERT_EQ(0, fa.live);
+}
+
+ZUC_TEST(capture_pool_test, refill_respects_capacity)
+{
+	struct fake_allocator fa;
+	struct capture_pool *pool = fake_pool_create(&fa, 2, 4);
+	struct capture_pool_key key = make_key(320, 240);
+	void *obj;
+
+	obj = capture_pool_acquire(pool, &key, NULL);
+	capture_pool_refill(pool);
+	ZUC_ASSERT_EQ(3, fa.live);
+
+	capture_pool_release(pool, obj);
+	ZUC_ASSERT_EQ(2, fa.live);
+
+	capture_pool_destroy(pool);
+	ZUC_ASSERT_EQ(0, fa.live);
+}
+
+ZUC_TEST(capture_pool_test, discard)
+{
+	struct fake_allocator fa;
+	struct capture_pool *pool = fake_pool_create(&fa, 4, 2);
+	struct capture_pool_key key = make_key(800, 600);
+	struct capture_pool_key other = make_key(1024, 768);
+	struct fake_object *obj;
+	void *busy, *idle, *kept;
+	int created;
+
+	key.ident = 0x1000;
+	other.ident = 0x2000;
+
+	busy = capture_pool_acquire(pool, &key, NULL);
+	idle = capture_pool_acquire(pool, &key, NULL);
+	kept = capture_pool_acquire(pool, &other, NULL);
+	capture_pool_release(pool, idle);
+	capture_pool_release(pool, kept);
+
+	/* the idle object goes right away, pending refills are dropped and
+	 * the one in use is destroyed once it comes back */
+	capture_pool_discard(pool, &key);
+	ZUC_ASSERT_EQ(2, fa.live);
+
+	capture_pool_refill(pool);
+	ZUC_ASSERT_EQ(3, fa.live);
+
+	capture_pool_release(pool, busy);
+	ZUC_ASSERT_EQ(2, fa.live);
+
+	/* other keys are untouched */
+	created = fa.created;
+	obj = capture_pool_acquire(pool, &other, NULL);
+	ZUC_ASSERT_EQ(1024, obj->key.width);
+	ZUC_ASSERT_EQ(created, fa.created);
+
+	obj = capture_pool_acquire(pool, &key, NULL);
+	ZUC_ASSERT_EQ(created + 1, fa.created);
+
+	capture_pool_destroy(pool);
+	ZUC_ASSERT_EQ(0, fa.live);
+}
+
+ZUC_TEST(capture_pool_test, allocation_failure)
+{
+	struct fake_allocator fa;
+	struct capture_pool *pool = fake_pool_create(&fa, 4, 2);
+	struct capture_pool_key key = make_key(16, 16);
+	struct capture_pool_stats stats;
+
+	fa.fail = 1;
+	ZUC_ASSERT_NULL(capture_pool_acquire(pool, &key, NULL));
+	ZUC_ASSERT_EQ(0, fa.refills_scheduled);
+
+	capture_pool_get_stats(pool, &stats);
+	ZUC_ASSERT_EQ(1, stats.misses);
+	ZUC_ASSERT_EQ(1, stats.failures);
+
+	/* releasing something the pool does not know is ignored */
+	capture_pool_release(pool, &fa);
+
+	capture_pool_destroy(pool);
+}
+
+ZUC_TEST(capture_pool_test, copy_plane)
+{
+	uint8_t src[4 * 16], dst[4 * 24];
+	int i, y;
+
+	for (i = 0; i < (int)ARRAY_LENGTH(src); i++)
+		src[i] = i;
+
+	/* same pitch, one contiguous copy */
+	memset(dst, 0xff, sizeof dst);
+	capture_copy_plane(dst, 16, src, 16, 4);
+	ZUC_ASSERT_EQ(0, memcmp(dst, src, sizeof src));
+	ZUC_ASSERT_EQ(0xff, dst[4 * 16]);
+
+	/* wider destination, padding is left alone */
+	memset(dst, 0xff, sizeof dst);
+	capture_copy_plane(dst, 24, src, 16, 4);
+	for (y = 0; y < 4; y++) {
+		ZUC_ASSERT_EQ(0, memcmp(dst + y * 24, src + y * 16, 16));
+		ZUC_ASSERT_EQ(0xff, dst[y * 24 + 16]);
+	}
+
+	/* narrower destination, rows are cut */
+	memset(dst, 0xff, sizeof dst);
+	capture_copy_plane(dst, 12, src, 16, 4);
+	for (y = 0; y < 4; y++)
+		ZUC_ASSERT_EQ(0, memcmp(dst + y * 12, src + y * 16, 12));
+	ZUC_ASSERT_EQ(0xff, dst[4 * 12]);
+
+	/* nothing to copy */
+	memset(dst, 0xff, sizeof dst);
+	capture_copy_plane(dst, 16, src, 16, 0);
+	ZUC_ASSERT_EQ(0xff, dst[0]);
+}
@@ -0,0 +1,417 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include <libweston/zalloc.h>
+#include "libweston-internal.h"
+#include "compositor/weston.h"
+#include "shared/helpers.h"
+
+/* not a multiple of the memfd growth steps */
+#define MAX_SIZE (100 * 1000)
+
+struct test_type {
+	const char *mime_type;
+	size_t size;
+	bool kept;
+};
+
+struct test_phase {
+	const char *name;
+	size_t max_size;
+	size_t max_total;
+	const struct test_type *types;
+	int n_types;
+};
+
+static const struct test_type size_cap_types[] = {
+	{ "text/plain;charset=utf-8", 1000, true },
+	{ "application/x-exact", MAX_SIZE, true },
+	{ "application/x-over", MAX_SIZE + 1, false },
+};
+
+static const struct test_type total_cap_types[] = {
+	{ "text/plain;charset=utf-8", 1000, true },
+	{ "application/x-exact", MAX_SIZE, true },
+};
+
+static const struct test_phase phases[] = {
+	{
+		"size cap", MAX_SIZE, 4 * MAX_SIZE,
+		size_cap_types, ARRAY_LENGTH(size_cap_types),
+	},
+	{
+		"total cap", MAX_SIZE, MAX_SIZE + 1000,
+		total_cap_types, ARRAY_LENGTH(total_cap_types),
+	},
+};
+
+struct clipboard_test {
+	struct weston_compositor *compositor;
+	struct weston_seat seat;
+	uint32_t serial;
+	unsigned int phase;
+
+	/* transfers of the current phase still running */
+	int writers;
+	int readers;
+	struct wl_array results[ARRAY_LENGTH(size_cap_types)];
+};
+
+/* Plays the client that owns the selection. */
+struct test_source {
+	struct weston_data_source base;
+	struct clipboard_test *test;
+};
+
+/* Writes the contents of one type like a client would, from the event
+ * loop and independently of the data source. */
+struct test_writer {
+	struct clipboard_test *test;
+	struct wl_event_source *event_source;
+	int fd;
+	int type;
+	size_t size;
+	size_t offset;
+};
+
+struct test_reader {
+	struct clipboard_test *test;
+	struct wl_event_source *event_source;
+	int fd;
+	int type;
+};
+
+static void run_phase(struct clipboard_test *test);
+
+static uint8_t
+pattern(int type, size_t i)
+{
+	return (i * 13 + type * 101) & 0xff;
+}
+
+static const struct test_phase *
+current_phase(struct clipboard_test *test)
+{
+	return &phases[test->phase];
+}
+
+static void
+check_results(struct clipboard_test *test)
+{
+	const struct test_phase *phase = current_phase(test);
+	const uint8_t *data;
+	size_t size, i;
+	int t;
+
+	for (t = 0; t < phase->n_types; t++) {
+		data = test->results[t].data;
+		size = test->results[t].size;
+
+		fprintf(stderr, "%s: %s, %zu of %zu bytes\n", phase->name,
+			phase->types[t].mime_type, size, phase->types[t].size);
+
+		if (!phase->types[t].kept) {
+			assert(size == 0);
+			continue;
+		}
+
+		assert(size == phase->types[t].size);
+		for (i = 0; i < size; i++)
+			assert(data[i] == pattern(t, i));
+	}
+}
+
+static void
+transfer_done(struct clipboard_test *test)
+{
+	unsigned int t;
+
+	if (test->writers > 0 || test->readers > 0)
+		return;
+
+	check_results(test);
+	for (t = 0; t < ARRAY_LENGTH(test->results); t++) {
+		wl_array_release(&test->results[t]);
+		wl_array_init(&test->results[t]);
+	}
+
+	if (++test->phase == ARRAY_LENGTH(phases)) {
+		weston_compositor_exit(test->compositor);
+		return;
+	}
+
+	run_phase(test);
+}
+
+static void
+writer_destroy(struct test_writer *writer)
+{
+	struct clipboard_test *test = writer->test;
+
+	wl_event_source_remove(writer->event_source);
+	close(writer->fd);
+	free(writer);
+
+	test->writers--;
+	transfer_done(test);
+}
+
+static int
+writer_data(int fd, uint32_t mask, void *data)
+{
+	struct test_writer *writer = data;
+	uint8_t buf[4096];
+	size_t i, n;
+	ssize_t len;
+
+	n = MIN(sizeof buf, writer->size - writer->offset);
+	for (i = 0; i < n; i++)
+		buf[i] = pattern(writer->type, writer->offset + i);
+
+	len = write(fd, buf, n);
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return 1;
+
+	/* EPIPE once the clipboard gave up on a type */
+	if (len > 0)
+		writer->offset += len;
+	if (len <= 0 || writer->offset == writer->size)
+		writer_destroy(writer);
+
+	return 1;
+}
+
+static void
+test_source_send(struct weston_data_source *base,
+		 const char *mime_type, int32_t fd)
+{
+	struct test_source *source =
+		container_of(base, struct test_source, base);
+	struct clipboard_test *test = source->test;
+	const struct test_phase *phase = current_phase(test);
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(test->compositor->wl_display);
+	struct test_writer *writer;
+	int t;
+
+	for (t = 0; t < phase->n_types; t++)
+		if (strcmp(mime_type, phase->types[t].mime_type) == 0)
+			break;
+	assert(t < phase->n_types);
+
+	writer = zalloc(sizeof *writer);
+	assert(writer);
+	writer->test = test;
+	writer->fd = fd;
+	writer->type = t;
+	writer->size = phase->types[t].size;
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	writer->event_source =
+		wl_event_loop_add_fd(loop, fd, WL_EVENT_WRITABLE,
+				     writer_data, writer);
+	assert(writer->event_source);
+	test->writers++;
+}
+
+static void
+test_source_accept(struct weston_data_source *base,
+		   uint32_t time, const char *mime_type)
+{
+}
+
+static void
+test_source_cancel(struct weston_data_source *base)
+{
+}
+
+static struct test_source *
+test_source_create(struct clipboard_test *test)
+{
+	const struct test_phase *phase = current_phase(test);
+	struct test_source *source;
+	const char **p;
+	int t;
+
+	source = zalloc(sizeof *source);
+	assert(source);
+	source->test = test;
+
+	wl_signal_init(&source->base.destroy_signal);
+	wl_array_init(&source->base.mime_types);
+	source->base.accept = test_source_accept;
+	source->base.send = test_source_send;
+	source->base.cancel = test_source_cancel;
+
+	for (t = 0; t < phase->n_types; t++) {
+		p = wl_array_add(&source->base.mime_types, sizeof *p);
+		assert(p);
+		*p = phase->types[t].mime_type;
+	}
+
+	return source;
+}
+
+static void
+test_source_destroy(struct test_source *source)
+{
+	wl_signal_emit(&source->base.destroy_signal, &source->base);
+	wl_array_release(&source->base.mime_types);
+	free(source);
+}
+
+static int
+reader_data(int fd, uint32_t mask, void *data)
+{
+	struct test_reader *reader = data;
+	struct clipboard_test *test = reader->test;
+	struct wl_array *result = &test->results[reader->type];
+	uint8_t buf[4096], *p;
+	ssize_t len;
+
+	len = read(fd, buf, sizeof buf);
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return 1;
+
+	if (len > 0) {
+		p = wl_array_add(result, len);
+		assert(p);
+		memcpy(p, buf, len);
+		return 1;
+	}
+
+	wl_event_source_remove(reader->event_source);
+	close(reader->fd);
+	free(reader);
+
+	test->readers--;
+	transfer_done(test);
+
+	return 1;
+}
+
+static void
+read_selection(struct clipboard_test *test, int type)
+{
+	struct weston_data_source *selection = test->seat.selection_data_source;
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(test->compositor->wl_display);
+	struct test_reader *reader;
+	int p[2];
+
+	assert(pipe2(p, O_CLOEXEC | O_NONBLOCK) == 0);
+
+	reader = zalloc(sizeof *reader);
+	assert(reader);
+	reader->test = test;
+	reader->fd = p[0];
+	reader->type = type;
+	reader->event_source =
+		wl_event_loop_add_fd(loop, p[0], WL_EVENT_READABLE,
+				     reader_data, reader);
+	assert(reader->event_source);
+	test->readers++;
+
+	/* the clipboard owns the write end from here on */
+	selection->send(selection,
+			current_phase(test)->types[type].mime_type, p[1]);
+}
+
+/*
+ * Offers the types of the phase, then destroys the source right away,
+ * while the clipboard is still reading from it. The clipboard has to take
+ * over the selection and serve what it keeps once the writers are done.
+ */
+static void
+run_phase(struct clipboard_test *test)
+{
+	const struct test_phase *phase = current_phase(test);
+	struct weston_data_source *selection;
+	struct test_source *source;
+	int t;
+
+	test->compositor->clipboard_max_size = phase->max_size;
+	test->compositor->clipboard_max_total = phase->max_total;
+
+	source = test_source_create(test);
+	weston_seat_set_selection(&test->seat, &source->base, ++test->serial);
+	assert(test->writers == phase->n_types);
+
+	test_source_destroy(source);
+
+	selection = test->seat.selection_data_source;
+	assert(selection && selection->send != test_source_send);
+	assert(selection->mime_types.size ==
+	       phase->n_types * sizeof(char *));
+
+	for (t = 0; t < phase->n_types; t++)
+		read_selection(test, t);
+}
+
+static void
+clipboard_test(void *data)
+{
+	struct clipboard_test *test = data;
+
+	/* writers see EPIPE when the clipboard drops a type */
+	signal(SIGPIPE, SIG_IGN);
+
+	weston_seat_init(&test->seat, test->compositor, "clipboard-test-seat");
+	run_phase(test);
+}
+
+WL_EXPORT int
+wet_module_init(struct weston_compositor *compositor,
+		int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+	struct clipboard_test *test;
+	unsigned int t;
+
+	test = zalloc(sizeof *test);
+	if (!test)
+		return -1;
+
+	test->compositor = compositor;
+	for (t = 0; t < ARRAY_LENGTH(test->results); t++)
+		wl_array_init(&test->results[t]);
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	wl_event_loop_add_idle(loop, clipboard_test, test);
+
+	return 0;
+}
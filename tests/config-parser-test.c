@@ -31,11 +31,14 @@
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include <libweston/config-parser.h>
 
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 #include "zunitc/zunitc.h"
 
 struct fixture_data {
@@ -639,3 +642,252 @@ ZUC_TEST(config_test, section_from_null)
 	section = weston_config_get_section(NULL, "bucket", NULL, NULL);
 	ZUC_ASSERT_NULL(section);
 }
+
+static const char snapshot_text[] =
+	"[output]\n"
+	"name=HDMI-A-1\n"
+	"mode=1920x1080\n"
+	"[output]\n"
+	"name=DP-1\n"
+	"mode=off\n"
+	"mode=preferred\n"
+	"[core]\n"
+	"idle-time=0\n";
+
+struct snapshot_files {
+	char dir[32];
+	char ini[64];
+	char snapshot[64];
+};
+
+static bool
+write_file(const char *path, const char *text, size_t len)
+{
+	FILE *fp = fopen(path, "w");
+	bool ok;
+
+	if (!fp)
+		return false;
+	ok = fwrite(text, 1, len, fp) == len;
+	return fclose(fp) == 0 && ok;
+}
+
+static bool
+snapshot_files_init(struct snapshot_files *f, const char *text)
+{
+	snprintf(f->dir, sizeof f->dir, "/tmp/weston-config-snap-XXXXXX");
+	if (!mkdtemp(f->dir))
+		return false;
+
+	snprintf(f->ini, sizeof f->ini, "%s/weston.ini", f->dir);
+	snprintf(f->snapshot, sizeof f->snapshot, "%s/weston.snap", f->dir);
+
+	return write_file(f->ini, text, strlen(text));
+}
+
+static void
+snapshot_files_fini(struct snapshot_files *f)
+{
+	unlink(f->ini);
+	unlink(f->snapshot);
+	rmdir(f->dir);
+}
+
+static ino_t
+file_inode(const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) < 0)
+		return 0;
+	return st.st_ino;
+}
+
+static void
+check_snapshot_config(struct weston_config *config)
+{
+	struct weston_config_section *section;
+	char *mode = NULL;
+	int32_t idle = -1;
+	int r;
+
+	ZUC_ASSERT_NOT_NULL(config);
+
+	section = weston_config_get_section(config, "output", "name", "DP-1");
+	ZUC_ASSERT_NOT_NULL(section);
+
+	/* the first of two identical keys wins */
+	r = weston_config_section_get_string(section, "mode", &mode, NULL);
+	ZUC_ASSERTG_EQ(0, r, out);
+	ZUC_ASSERTG_STREQ("off", mode, out);
+
+	ZUC_ASSERTG_NULL(weston_config_get_section(config, "output", "name",
+						   "DP-2"), out);
+	ZUC_ASSERTG_NULL(weston_config_get_section(config, "output", "color",
+						   "DP-1"), out);
+
+	section = weston_config_get_section(config, "core", NULL, NULL);
+	r = weston_config_section_get_int(section, "idle-time", &idle, 5);
+	ZUC_ASSERTG_EQ(0, r, out);
+	ZUC_ASSERTG_EQ(0, idle, out);
+
+out:
+	free(mode);
+}
+
+ZUC_TEST(config_test, snapshot_reused)
+{
+	struct snapshot_files f;
+	struct weston_config *config;
+	ino_t inode;
+
+	ZUC_ASSERT_TRUE(snapshot_files_init(&f, snapshot_text));
+
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	check_snapshot_config(config);
+	weston_config_destroy(config);
+
+	inode = file_inode(f.snapshot);
+	ZUC_ASSERTG_NE(0, inode, out);
+
+	/* an unchanged ini maps the snapshot instead of rewriting it */
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	check_snapshot_config(config);
+	ZUC_ASSERTG_STREQ(f.ini, weston_config_get_full_path(config), out_config);
+	ZUC_ASSERTG_EQ(inode, file_inode(f.snapshot), out_config);
+
+out_config:
+	weston_config_destroy(config);
+out:
+	snapshot_files_fini(&f);
+}
+
+ZUC_TEST(config_test, snapshot_stale)
+{
+	static const char stale_text[] = "[core]\nidle-time=7\n";
+	struct snapshot_files f;
+	struct weston_config *config;
+	struct weston_config_section *section;
+	int32_t idle = 0;
+	ino_t inode;
+
+	ZUC_ASSERT_TRUE(snapshot_files_init(&f, snapshot_text));
+
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	weston_config_destroy(config);
+	inode = file_inode(f.snapshot);
+
+	ZUC_ASSERTG_TRUE(write_file(f.ini, stale_text, strlen(stale_text)),
+			 out);
+
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	ZUC_ASSERTG_NOT_NULL(config, out);
+	section = weston_config_get_section(config, "core", NULL, NULL);
+	weston_config_section_get_int(section, "idle-time", &idle, 5);
+	ZUC_ASSERTG_EQ(7, idle, out_config);
+	ZUC_ASSERTG_NULL(weston_config_get_section(config, "output",
+						   NULL, NULL), out_config);
+	ZUC_ASSERTG_NE(inode, file_inode(f.snapshot), out_config);
+
+out_config:
+	weston_config_destroy(config);
+out:
+	snapshot_files_fini(&f);
+}
+
+ZUC_TEST(config_test, snapshot_corrupt)
+{
+	struct snapshot_files f;
+	struct weston_config *config;
+	char garbage[4096];
+	FILE *fp;
+	long size;
+	size_t i;
+
+	ZUC_ASSERT_TRUE(snapshot_files_init(&f, snapshot_text));
+
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	weston_config_destroy(config);
+
+	/* keep the header so only the body checks can reject it */
+	fp = fopen(f.snapshot, "r+");
+	ZUC_ASSERTG_NOT_NULL(fp, out);
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	for (i = 0; i < sizeof garbage; i++)
+		garbage[i] = rand();
+	fseek(fp, 96, SEEK_SET);
+	fwrite(garbage, 1, MIN(sizeof garbage, (size_t)(size - 96)), fp);
+	fclose(fp);
+
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	check_snapshot_config(config);
+	weston_config_destroy(config);
+
+	/* not a snapshot at all */
+	ZUC_ASSERTG_TRUE(write_file(f.snapshot, snapshot_text, 64), out);
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	check_snapshot_config(config);
+	weston_config_destroy(config);
+
+out:
+	snapshot_files_fini(&f);
+}
+
+ZUC_TEST(config_test, lookup_benchmark)
+{
+	struct snapshot_files f;
+	struct weston_config *config;
+	struct weston_config_section *section;
+	struct timespec start, parsed, mapped, looked_up;
+	char *text, name[32];
+	size_t len = 0, size = 1 << 20;
+	int32_t value, sum = 0;
+	int i, j;
+
+	/* a large multi-output setup */
+	text = malloc(size);
+	ZUC_ASSERT_NOT_NULL(text);
+	for (i = 0; i < 64; i++) {
+		len += snprintf(text + len, size - len,
+				"[output]\nname=OUT-%d\n", i);
+		for (j = 0; j < 16; j++)
+			len += snprintf(text + len, size - len,
+					"key-%d=%d\n", j, i * j);
+	}
+	ZUC_ASSERTG_TRUE(snapshot_files_init(&f, text), out_free);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	clock_gettime(CLOCK_MONOTONIC, &parsed);
+	weston_config_destroy(config);
+
+	clock_gettime(CLOCK_MONOTONIC, &parsed);
+	config = weston_config_parse_with_snapshot(f.ini, f.snapshot);
+	clock_gettime(CLOCK_MONOTONIC, &mapped);
+	ZUC_ASSERTG_NOT_NULL(config, out);
+
+	for (i = 0; i < 10000; i++) {
+		snprintf(name, sizeof name, "OUT-%d", i % 64);
+		section = weston_config_get_section(config, "output",
+						    "name", name);
+		weston_config_section_get_int(section, "key-15", &value, 0);
+		sum += value;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &looked_up);
+	weston_config_destroy(config);
+
+	ZUC_ASSERTG_EQ(15 * (63 * 64 / 2) * (10000 / 64) +
+		       15 * (15 * 16 / 2), sum, out);
+
+	printf("%zu byte config: parse and save %.1f us, snapshot %.1f us, "
+	       "%.1f ns per section and key lookup\n", len,
+	       timespec_sub_to_nsec(&parsed, &start) / 1000.0,
+	       timespec_sub_to_nsec(&mapped, &parsed) / 1000.0,
+	       timespec_sub_to_nsec(&looked_up, &mapped) / 10000.0);
+
+out:
+	snapshot_files_fini(&f);
+out_free:
+	free(text);
+}
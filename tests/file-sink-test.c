@@ -0,0 +1,401 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "shared/helpers.h"
+#include "clients/RemoteDisplay/file_sink.h"
+#include "zunitc/zunitc.h"
+
+/* for debug.h, pulled in by the sink */
+int debug_level;
+
+struct stream {
+	uint8_t *data;
+	size_t size;
+	size_t frame_offset[256];
+	size_t frame_size[256];
+	int keyframe[256];
+	unsigned frames;
+};
+
+static void
+make_stream(struct stream *s, unsigned frames, size_t max_size,
+	    unsigned gop)
+{
+	size_t i, len;
+	unsigned f;
+
+	s->size = 0;
+	s->frames = frames;
+	s->data = malloc(frames * max_size);
+
+	srand(frames);
+	for (f = 0; f < frames; f++) {
+		/* keyframes are the big ones, as in a real stream */
+		len = f % gop == 0 ? max_size : 1 + rand() % (max_size / 4);
+		s->frame_offset[f] = s->size;
+		s->frame_size[f] = len;
+		s->keyframe[f] = f % gop == 0;
+		for (i = 0; i < len; i++)
+			s->data[s->size + i] = rand();
+		s->size += len;
+	}
+}
+
+static uint8_t *
+read_file(const char *path, size_t *size)
+{
+	struct stat st;
+	uint8_t *data;
+	FILE *fp;
+
+	if (stat(path, &st) < 0)
+		return NULL;
+
+	fp = fopen(path, "rb");
+	if (!fp)
+		return NULL;
+
+	data = malloc(st.st_size + 1);
+	*size = fread(data, 1, st.st_size, fp);
+	fclose(fp);
+
+	return data;
+}
+
+static void
+remove_dir(const char *dir)
+{
+	char path[512];
+	struct dirent *de;
+	DIR *d = opendir(dir);
+
+	if (!d)
+		return;
+
+	while ((de = readdir(d))) {
+		if (de->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof path, "%s/%s", dir, de->d_name);
+		unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+static int
+write_stream(const struct file_sink_options *options, const struct stream *s,
+	     struct file_sink_stats *stats)
+{
+	struct file_sink *sink;
+	unsigned f;
+
+	sink = file_sink_create(options);
+	if (!sink)
+		return -1;
+
+	for (f = 0; f < s->frames; f++)
+		if (file_sink_write(sink, s->data + s->frame_offset[f],
+				    s->frame_size[f], f * 3000,
+				    s->keyframe[f]) < 0)
+			return -1;
+
+	file_sink_destroy(sink, stats);
+
+	return 0;
+}
+
+ZUC_TEST(file_sink_test, single_file)
+{
+	char dir[] = "/tmp/file-sink-test-XXXXXX";
+	char path[64];
+	struct file_sink_options options;
+	struct file_sink_stats stats;
+	struct stream s = { 0 };
+	uint8_t *data;
+	size_t size;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof path, "%s/capture.h264", dir);
+
+	memset(&options, 0, sizeof options);
+	options.path = path;
+	options.direct = 1;
+	options.fsync = FILE_SINK_FSYNC_SEGMENT;
+	options.buffer_size = 64 * 1024;
+	options.num_buffers = 4;
+	make_stream(&s, 100, 40000, 30);
+
+	ZUC_ASSERTG_EQ(0, write_stream(&options, &s, &stats), out);
+	ZUC_ASSERTG_EQ(100, stats.frames, out);
+	ZUC_ASSERTG_EQ(1, stats.segments, out);
+
+	data = read_file(path, &size);
+	ZUC_ASSERTG_NOT_NULL(data, out);
+	ZUC_ASSERTG_EQ(s.size, size, out);
+	ZUC_ASSERTG_EQ(0, memcmp(data, s.data, size), out);
+	free(data);
+
+	/* no index unless asked for */
+	snprintf(path, sizeof path, "%s/capture.h264.idx", dir);
+	ZUC_ASSERTG_EQ(-1, access(path, F_OK), out);
+
+out:
+	free(s.data);
+	remove_dir(dir);
+}
+
+ZUC_TEST(file_sink_test, size_rotation_and_index)
+{
+	char dir[] = "/tmp/file-sink-test-XXXXXX";
+	char path[64], seg_path[64];
+	struct file_sink_options options;
+	struct file_sink_stats stats;
+	struct file_sink_index_header *header;
+	struct file_sink_index_entry *entry;
+	struct stream s = { 0 };
+	uint8_t *data = NULL, *index = NULL;
+	size_t size, index_size, total = 0;
+	unsigned seg, f = 0, i;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof path, "%s/capture.h264", dir);
+
+	memset(&options, 0, sizeof options);
+	options.path = path;
+	options.direct = 1;
+	options.write_index = 1;
+	options.segment_size = 100000;
+	options.buffer_size = 16 * 1024;
+	options.num_buffers = 3;
+	make_stream(&s, 200, 20000, 10);
+
+	ZUC_ASSERTG_EQ(0, write_stream(&options, &s, &stats), out);
+	ZUC_ASSERTG_TRUE(stats.segments > 1, out);
+	ZUC_ASSERTG_EQ(stats.bytes_queued, stats.bytes_written, out);
+	ZUC_ASSERTG_EQ(0, stats.write_errors, out);
+
+	for (seg = 0; seg < stats.segments; seg++) {
+		snprintf(seg_path, sizeof seg_path, "%s/capture-%05u.h264",
+			 dir, seg);
+		data = read_file(seg_path, &size);
+		ZUC_ASSERTG_NOT_NULL(data, out);
+
+		/* every segment starts with a keyframe and continues the
+		 * stream where the previous one stopped */
+		ZUC_ASSERTG_EQ(0, memcmp(data, s.data + total, size), out);
+		ZUC_ASSERTG_EQ(s.frame_offset[f], total, out);
+		ZUC_ASSERTG_TRUE(s.keyframe[f], out);
+
+		snprintf(seg_path, sizeof seg_path, "%s/capture-%05u.h264.idx",
+			 dir, seg);
+		index = read_file(seg_path, &index_size);
+		ZUC_ASSERTG_NOT_NULL(index, out);
+
+		header = (struct file_sink_index_header *)index;
+		entry = (struct file_sink_index_entry *)(header + 1);
+		ZUC_ASSERTG_EQ(FILE_SINK_INDEX_MAGIC, header->magic, out);
+		ZUC_ASSERTG_EQ(sizeof *header + header->count * sizeof *entry,
+			       index_size, out);
+
+		for (i = 0; i < header->count; i++) {
+			while (!s.keyframe[f])
+				f++;
+			ZUC_ASSERTG_EQ(s.frame_offset[f] - total,
+				       entry[i].offset, out);
+			ZUC_ASSERTG_EQ(s.frame_size[f], entry[i].size, out);
+			ZUC_ASSERTG_EQ(f * 3000, entry[i].timestamp, out);
+			f++;
+		}
+		while (f < s.frames && !s.keyframe[f])
+			f++;
+
+		total += size;
+		free(data);
+		free(index);
+		data = index = NULL;
+	}
+	ZUC_ASSERTG_EQ(s.size, total, out);
+
+out:
+	free(data);
+	free(index);
+	free(s.data);
+	remove_dir(dir);
+}
+
+ZUC_TEST(file_sink_test, append)
+{
+	static const char existing[] = "previous recording";
+	char dir[] = "/tmp/file-sink-test-XXXXXX";
+	char path[64], idx_path[80];
+	struct file_sink_options options;
+	struct file_sink_stats stats;
+	struct file_sink_index_entry *entry;
+	struct stream s = { 0 };
+	uint8_t *data = NULL, *index = NULL;
+	size_t size;
+	FILE *fp;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof path, "%s/capture.h264", dir);
+	snprintf(idx_path, sizeof idx_path, "%s.idx", path);
+
+	fp = fopen(path, "wb");
+	ZUC_ASSERTG_NOT_NULL(fp, out);
+	fwrite(existing, 1, strlen(existing), fp);
+	fclose(fp);
+
+	memset(&options, 0, sizeof options);
+	options.path = path;
+	options.append = 1;
+	options.direct = 1;
+	options.write_index = 1;
+	make_stream(&s, 20, 5000, 10);
+
+	ZUC_ASSERTG_EQ(0, write_stream(&options, &s, &stats), out);
+	/* appending starts at an unaligned offset */
+	ZUC_ASSERTG_EQ(0, stats.direct, out);
+
+	data = read_file(path, &size);
+	ZUC_ASSERTG_NOT_NULL(data, out);
+	ZUC_ASSERTG_EQ(strlen(existing) + s.size, size, out);
+	ZUC_ASSERTG_EQ(0, memcmp(data, existing, strlen(existing)), out);
+	ZUC_ASSERTG_EQ(0, memcmp(data + strlen(existing), s.data, s.size),
+		       out);
+
+	/* index offsets are file offsets */
+	index = read_file(idx_path, &size);
+	ZUC_ASSERTG_NOT_NULL(index, out);
+	entry = (struct file_sink_index_entry *)
+		(index + sizeof(struct file_sink_index_header));
+	ZUC_ASSERTG_EQ(strlen(existing), entry[0].offset, out);
+	ZUC_ASSERTG_EQ(strlen(existing) + s.frame_offset[10], entry[1].offset,
+		       out);
+
+out:
+	free(data);
+	free(index);
+	free(s.data);
+	remove_dir(dir);
+}
+
+ZUC_TEST(file_sink_test, flush_and_large_frames)
+{
+	char dir[] = "/tmp/file-sink-test-XXXXXX";
+	char path[64];
+	struct file_sink_options options;
+	struct file_sink_stats stats;
+	struct stream s = { 0 };
+	uint8_t *data;
+	size_t size;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof path, "%s/capture", dir);
+
+	/* frames span several buffers, and each one is flushed */
+	memset(&options, 0, sizeof options);
+	options.path = path;
+	options.flush = 1;
+	options.fsync = FILE_SINK_FSYNC_BUFFER;
+	options.buffer_size = 4096;
+	options.num_buffers = 2;
+	make_stream(&s, 30, 50000, 5);
+
+	ZUC_ASSERTG_EQ(0, write_stream(&options, &s, &stats), out);
+
+	data = read_file(path, &size);
+	ZUC_ASSERTG_NOT_NULL(data, out);
+	ZUC_ASSERTG_EQ(s.size, size, out);
+	ZUC_ASSERTG_EQ(0, memcmp(data, s.data, size), out);
+	free(data);
+
+out:
+	free(s.data);
+	remove_dir(dir);
+}
+
+ZUC_TEST(file_sink_test, throughput_benchmark)
+{
+	char dir[] = "/tmp/file-sink-test-XXXXXX";
+	char path[64];
+	struct file_sink_options options;
+	struct file_sink_stats stats;
+	struct file_sink *sink;
+	uint64_t start, elapsed;
+	struct timespec ts;
+	uint8_t *frame;
+	unsigned f;
+	/* 1080p at about 30 Mbit/s */
+	const size_t frame_size = 128 * 1024;
+	const unsigned frames = 256;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof path, "%s/capture.h264", dir);
+
+	frame = malloc(frame_size);
+	ZUC_ASSERTG_NOT_NULL(frame, out);
+	memset(frame, 0x5a, frame_size);
+
+	memset(&options, 0, sizeof options);
+	options.path = path;
+	options.direct = 1;
+	options.segment_size = 8 * 1024 * 1024;
+
+	sink = file_sink_create(&options);
+	ZUC_ASSERTG_NOT_NULL(sink, out);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	start = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	for (f = 0; f < frames; f++)
+		file_sink_write(sink, frame, frame_size, f, f % 30 == 0);
+	file_sink_destroy(sink, &stats);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	elapsed = ts.tv_sec * 1000000000ULL + ts.tv_nsec - start;
+
+	ZUC_ASSERTG_EQ(frames, stats.frames, out);
+	printf("%s%s: %.0f MB/s, stall %.1f us average, %.1f us max, "
+	       "%llu buffer waits\n",
+	       stats.io_uring ? "io_uring" : "pwrite",
+	       stats.direct ? " + O_DIRECT" : "",
+	       (double)frames * frame_size / elapsed * 1000.0,
+	       stats.stall_ns_total / 1000.0 / frames,
+	       stats.stall_ns_max / 1000.0,
+	       (unsigned long long)stats.buffer_waits);
+
+out:
+	free(frame);
+	remove_dir(dir);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "shared/frame-arena.h"
+#include "zunitc/zunitc.h"
+
+ZUC_TEST(frame_arena_test, reset_reuses_the_chunk)
+{
+	struct frame_arena arena;
+	char *first, *again;
+	int frame;
+
+	frame_arena_init(&arena);
+
+	for (frame = 0; frame < 3; frame++) {
+		again = frame_arena_alloc(&arena, 100);
+		ZUC_ASSERT_NOT_NULL(again);
+		ZUC_ASSERT_EQ(0, (uintptr_t)again % sizeof(void *));
+		memset(again, 0xa5, 100);
+
+		ZUC_ASSERT_NOT_NULL(frame_arena_alloc(&arena, 3));
+		ZUC_ASSERT_EQ(1, frame_arena_chunk_count(&arena));
+
+		if (frame == 0)
+			first = again;
+		/* every frame starts over at the same spot */
+		ZUC_ASSERT_TRUE(again == first);
+
+		frame_arena_reset(&arena);
+		ZUC_ASSERT_EQ(0, arena.used);
+	}
+
+	frame_arena_release(&arena);
+}
+
+ZUC_TEST(frame_arena_test, high_water_tracks_the_busiest_frame)
+{
+	struct frame_arena arena;
+
+	frame_arena_init(&arena);
+	ZUC_ASSERT_EQ(0, arena.high_water);
+
+	/* sizes are rounded up to pointer alignment */
+	frame_arena_alloc(&arena, 1);
+	ZUC_ASSERT_EQ(sizeof(void *), arena.used);
+	frame_arena_alloc(&arena, 64);
+	ZUC_ASSERT_EQ(sizeof(void *) + 64, arena.high_water);
+	frame_arena_reset(&arena);
+
+	/* a quieter frame leaves it alone */
+	frame_arena_alloc(&arena, 8);
+	ZUC_ASSERT_EQ(sizeof(void *) + 64, arena.high_water);
+	frame_arena_reset(&arena);
+
+	frame_arena_alloc(&arena, 1000);
+	ZUC_ASSERT_EQ(1000, arena.high_water);
+	frame_arena_reset(&arena);
+	ZUC_ASSERT_EQ(1000, arena.high_water);
+
+	frame_arena_release(&arena);
+}
+
+ZUC_TEST(frame_arena_test, spilled_frame_folds_into_one_chunk)
+{
+	struct frame_arena arena;
+	size_t total = 0;
+	int i, frame;
+
+	frame_arena_init(&arena);
+
+	/* the first frame outgrows the initial chunk a few times over */
+	for (i = 0; i < 100; i++) {
+		ZUC_ASSERT_NOT_NULL(frame_arena_alloc(&arena, 1024));
+		total += 1024;
+	}
+	ZUC_ASSERT_TRUE(frame_arena_chunk_count(&arena) > 1);
+	ZUC_ASSERT_EQ(total, arena.high_water);
+
+	frame_arena_reset(&arena);
+	ZUC_ASSERT_EQ(1, frame_arena_chunk_count(&arena));
+
+	/* and from then on the same frame fits without a new chunk */
+	for (frame = 0; frame < 3; frame++) {
+		for (i = 0; i < 100; i++)
+			ZUC_ASSERT_NOT_NULL(frame_arena_alloc(&arena, 1024));
+		ZUC_ASSERT_EQ(1, frame_arena_chunk_count(&arena));
+		frame_arena_reset(&arena);
+	}
+	ZUC_ASSERT_EQ(total, arena.high_water);
+
+	frame_arena_release(&arena);
+	ZUC_ASSERT_EQ(0, frame_arena_chunk_count(&arena));
+}
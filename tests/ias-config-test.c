@@ -0,0 +1,457 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <expat.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libweston/config-parser.h>
+#include "ias-config.h"
+
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+/*
+ * Every handler call and error is logged as text, so the cached loader
+ * can be compared against a copy of the original expat driven one.
+ */
+struct call_log {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static __thread struct call_log *current_log;
+
+static void
+log_append(struct call_log *log, const char *fmt, va_list ap)
+{
+	va_list aq;
+	int n;
+
+	va_copy(aq, ap);
+	n = vsnprintf(NULL, 0, fmt, aq);
+	va_end(aq);
+
+	if (log->len + n + 1 > log->size) {
+		log->size = MAX(log->size * 2, log->len + n + 1);
+		log->buf = realloc(log->buf, log->size);
+		assert(log->buf);
+	}
+
+	vsnprintf(log->buf + log->len, n + 1, fmt, ap);
+	log->len += n;
+}
+
+static void
+log_printf(struct call_log *log, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	log_append(log, fmt, ap);
+	va_end(ap);
+}
+
+/* The loader reports errors through IAS_ERROR() */
+int
+weston_log(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (!current_log)
+		return 0;
+
+	va_start(ap, fmt);
+	log_append(current_log, fmt, ap);
+	va_end(ap);
+
+	return 0;
+}
+
+static void
+record_begin(void *userdata, const char *name, const char **attrs)
+{
+	struct call_log *log = userdata;
+
+	log_printf(log, "<%s", name);
+	for (; attrs[0]; attrs += 2)
+		log_printf(log, " %s='%s'", attrs[0], attrs[1]);
+	log_printf(log, ">\n");
+}
+
+#define RECORD_HANDLER(elem) \
+static void \
+record_##elem(void *userdata, const char **attrs) \
+{ \
+	record_begin(userdata, #elem, attrs); \
+}
+
+RECORD_HANDLER(backend)
+RECORD_HANDLER(crtc)
+RECORD_HANDLER(output)
+RECORD_HANDLER(input)
+RECORD_HANDLER(env)
+RECORD_HANDLER(capture)
+RECORD_HANDLER(hmi)
+RECORD_HANDLER(hmienv)
+RECORD_HANDLER(plugin)
+RECORD_HANDLER(input_plugin)
+
+/* Same hierarchies as the backend, shell and plugin framework */
+static struct xml_element backend_machine[] = {
+	{ NONE,			NULL,			NULL,			IASCONFIG,	NONE },
+	{ IASCONFIG,	"iasconfig",	NULL,			BACKEND,	NONE },
+	{ BACKEND,		"backend",		record_backend,	STARTUP | GLOBAL_ENV | REM_DISP,	IASCONFIG },
+	{ STARTUP,		"startup",		NULL,			CRTC,		BACKEND },
+	{ CRTC,			"crtc",			record_crtc,	OUTPUT,		STARTUP },
+	{ OUTPUT,		"output",		record_output,	INPUT,		CRTC },
+	{ INPUT,		"input",		record_input,	NONE,		OUTPUT },
+	{ GLOBAL_ENV,	"env",			record_env,		NONE,		BACKEND },
+	{ REM_DISP,		"capture",		record_capture,	NONE,		BACKEND },
+};
+
+static struct xml_element shell_machine[] = {
+	{ NONE,			NULL,			NULL,			IASCONFIG,	NONE },
+	{ IASCONFIG,	"iasconfig",	NULL,			HMI | PLUGIN | INPUTPLUGIN,	NONE },
+	{ HMI,			"hmi",			record_hmi,		ENV,		IASCONFIG },
+	{ ENV,			"hmienv",		record_hmienv,	NONE,		HMI },
+};
+
+static struct xml_element plugin_machine[] = {
+	{ NONE,			NULL,			NULL,			IASCONFIG,	NONE },
+	{ IASCONFIG,	"iasconfig",	NULL,			HMI | PLUGIN | INPUTPLUGIN,	NONE },
+	{ PLUGIN,		"plugin",		record_plugin,	NONE,		IASCONFIG },
+	{ INPUTPLUGIN,	"input_plugin",	record_input_plugin,	NONE,	IASCONFIG },
+};
+
+static const struct {
+	struct xml_element *elements;
+	int num;
+} machines[] = {
+	{ backend_machine, ARRAY_LENGTH(backend_machine) },
+	{ shell_machine, ARRAY_LENGTH(shell_machine) },
+	{ plugin_machine, ARRAY_LENGTH(plugin_machine) },
+};
+
+/* The configurations shipped in the repository */
+static const char *repo_configs[] = {
+	"ias_brd2.conf",
+	"ias_vmware.conf",
+	"packaging/ias_dualscreen.conf",
+};
+
+/*
+ * Reference copy of the loader before the parsed tree cache: one expat
+ * pass per call, driving a global state machine.
+ */
+static struct xml_element *ref_parse_data;
+static int ref_num_elements;
+static int ref_current_state;
+
+static void
+ref_start(void *userdata, const char *name, const char **attrs)
+{
+	struct xml_element *curr, *next;
+	int i;
+
+	curr = &ref_parse_data[ref_current_state];
+
+	for (i = 0; i < ref_num_elements; i++) {
+		next = &ref_parse_data[i];
+
+		if (next->name && strcmp(next->name, name) == 0) {
+			if (curr->valid_children & next->id) {
+				if (next->begin_handler)
+					next->begin_handler(userdata, attrs);
+				ref_current_state = i;
+				return;
+			} else {
+				weston_log("IAS ERROR: Element <%s> found at "
+					   "unexpected location\n", name);
+			}
+		}
+	}
+}
+
+static void
+ref_end(void *userdata, const char *name)
+{
+	struct xml_element *curr = &ref_parse_data[ref_current_state];
+	int i;
+
+	if (curr->name && strcmp(name, curr->name) != 0)
+		return;
+
+	for (i = 0; i < ref_num_elements; i++) {
+		if (ref_parse_data[i].id == curr->return_to) {
+			ref_current_state = i;
+			return;
+		}
+	}
+}
+
+static int
+ref_read_configuration(char *filename, struct xml_element *elements,
+		       int num, void *userdata)
+{
+	XML_Parser parser;
+	FILE *conf;
+	char buf[BUFSIZ];
+	char *cfgfile;
+	int len, done;
+
+	ref_parse_data = elements;
+	ref_num_elements = num;
+	ref_current_state = 0;
+
+	cfgfile = config_file_path(filename);
+	conf = fopen(cfgfile, "r");
+	free(cfgfile);
+	if (!conf)
+		return -1;
+
+	parser = XML_ParserCreate(NULL);
+	XML_SetUserData(parser, userdata);
+	XML_SetElementHandler(parser, ref_start, ref_end);
+	do {
+		len = fread(buf, 1, sizeof buf, conf);
+		done = feof(conf);
+
+		if (XML_Parse(parser, buf, len, done) == XML_STATUS_ERROR) {
+			weston_log("IAS ERROR: Unable to parse IAS config at "
+				   "%s:%lu: %s\n", filename,
+				   XML_GetCurrentLineNumber(parser),
+				   XML_ErrorString(XML_GetErrorCode(parser)));
+			break;
+		}
+	} while (!done);
+	XML_ParserFree(parser);
+	fclose(conf);
+
+	return 0;
+}
+
+static char *
+run_loader(bool reference, const char *file, int machine)
+{
+	struct call_log log = { 0 };
+	int ret;
+
+	log_printf(&log, "%s:\n", file);
+	current_log = &log;
+	if (reference)
+		ret = ref_read_configuration((char *)file,
+					     machines[machine].elements,
+					     machines[machine].num, &log);
+	else
+		ret = ias_read_configuration((char *)file,
+					     machines[machine].elements,
+					     machines[machine].num, &log);
+	current_log = NULL;
+	log_printf(&log, "ret %d\n", ret);
+
+	return log.buf;
+}
+
+static void
+compare_loaders(const char *file)
+{
+	char *expected, *parsed, *cached;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(machines); i++) {
+		expected = run_loader(true, file, i);
+		parsed = run_loader(false, file, i);
+		cached = run_loader(false, file, i);
+
+		ZUC_ASSERTG_STREQ(expected, parsed, out);
+		ZUC_ASSERTG_STREQ(expected, cached, out);
+
+out:
+		free(expected);
+		free(parsed);
+		free(cached);
+	}
+}
+
+static void
+write_config(const char *name, const char *text)
+{
+	FILE *fp = fopen(name, "w");
+
+	assert(fp);
+	fputs(text, fp);
+	fclose(fp);
+}
+
+ZUC_TEST(ias_config, repo_configs_match_reference)
+{
+	unsigned int i;
+
+	setenv("XDG_CONFIG_HOME", IAS_CONFIG_SOURCE_DIR, 1);
+	ias_config_cache_flush();
+
+	for (i = 0; i < ARRAY_LENGTH(repo_configs); i++)
+		compare_loaders(repo_configs[i]);
+
+	ias_config_cache_flush();
+}
+
+ZUC_TEST(ias_config, malformed_configs_match_reference)
+{
+	static const char *configs[] = {
+		/* elements at unexpected locations */
+		"<iasconfig><crtc name='x'/><backend><output name='o'/>"
+		"<startup><crtc name='c'><output name='p'><input devnode='i'/>"
+		"</output></crtc></startup></backend><hmi exec='h'>"
+		"<hmienv var='a' val='b'/></hmi><plugin name='p' lib='l'/>"
+		"</iasconfig>",
+		/* parse error after some elements */
+		"<iasconfig>\n<backend>\n<env var='a' val='b'/>\n<startup>\n"
+		"<crtc name='c'>\n</backend>\n</iasconfig>\n",
+		/* nothing at all */
+		"",
+	};
+	char dir[] = "/tmp/ias-config-test-XXXXXX";
+	char path[64];
+	unsigned int i;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(dir));
+	setenv("XDG_CONFIG_HOME", dir, 1);
+	snprintf(path, sizeof path, "%s/ias.conf", dir);
+
+	for (i = 0; i < ARRAY_LENGTH(configs); i++) {
+		write_config(path, configs[i]);
+		compare_loaders("ias.conf");
+	}
+
+	unlink(path);
+	rmdir(dir);
+	ias_config_cache_flush();
+}
+
+ZUC_TEST(ias_config, changed_file_is_reparsed)
+{
+	char dir[] = "/tmp/ias-config-test-XXXXXX";
+	char path[64];
+	char *log;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(dir));
+	setenv("XDG_CONFIG_HOME", dir, 1);
+	snprintf(path, sizeof path, "%s/ias.conf", dir);
+
+	write_config(path, "<iasconfig><plugin name='a'/></iasconfig>");
+	log = run_loader(false, "ias.conf", 2);
+	ZUC_ASSERTG_NOT_NULL(strstr(log, "<plugin name='a'>"), out);
+	free(log);
+
+	write_config(path, "<iasconfig><plugin name='b'/></iasconfig>");
+	log = run_loader(false, "ias.conf", 2);
+	ZUC_ASSERTG_NOT_NULL(strstr(log, "<plugin name='b'>"), out);
+	ZUC_ASSERTG_NULL(strstr(log, "<plugin name='a'>"), out);
+
+out:
+	free(log);
+	unlink(path);
+	rmdir(dir);
+	ias_config_cache_flush();
+}
+
+#define LOADER_THREADS 8
+#define LOADER_ROUNDS 50
+
+struct loader_thread {
+	pthread_t thread;
+	char **expected;
+	int mismatches;
+};
+
+static void *
+loader_thread_func(void *data)
+{
+	struct loader_thread *lt = data;
+	unsigned int i, m;
+	char *log;
+	int round;
+
+	for (round = 0; round < LOADER_ROUNDS; round++) {
+		for (i = 0; i < ARRAY_LENGTH(repo_configs); i++) {
+			for (m = 0; m < ARRAY_LENGTH(machines); m++) {
+				log = run_loader(false, repo_configs[i], m);
+				if (strcmp(log, lt->expected[i *
+					   ARRAY_LENGTH(machines) + m]) != 0)
+					lt->mismatches++;
+				free(log);
+			}
+
+			/* drop the cache now and then to race the parsers */
+			if (round % 10 == 0 && i == 0)
+				ias_config_cache_flush();
+		}
+	}
+
+	return NULL;
+}
+
+ZUC_TEST(ias_config, parallel_loads)
+{
+	struct loader_thread threads[LOADER_THREADS];
+	char *expected[ARRAY_LENGTH(repo_configs) * ARRAY_LENGTH(machines)];
+	unsigned int i, m;
+
+	setenv("XDG_CONFIG_HOME", IAS_CONFIG_SOURCE_DIR, 1);
+	ias_config_cache_flush();
+
+	for (i = 0; i < ARRAY_LENGTH(repo_configs); i++)
+		for (m = 0; m < ARRAY_LENGTH(machines); m++)
+			expected[i * ARRAY_LENGTH(machines) + m] =
+				run_loader(true, repo_configs[i], m);
+
+	for (i = 0; i < LOADER_THREADS; i++) {
+		threads[i].expected = expected;
+		threads[i].mismatches = 0;
+		ZUC_ASSERT_EQ(0, pthread_create(&threads[i].thread, NULL,
+						loader_thread_func,
+						&threads[i]));
+	}
+
+	for (i = 0; i < LOADER_THREADS; i++) {
+		pthread_join(threads[i].thread, NULL);
+		ZUC_ASSERT_EQ(0, threads[i].mismatches);
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(expected); i++)
+		free(expected[i]);
+	ias_config_cache_flush();
+}
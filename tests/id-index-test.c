@@ -0,0 +1,198 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/id-index.h"
+#include "shared/timespec-util.h"
+#include "zunitc/zunitc.h"
+
+struct object {
+	uint32_t id;
+};
+
+ZUC_TEST(id_index_test, empty)
+{
+	struct id_index index;
+
+	id_index_init(&index);
+	ZUC_ASSERT_NULL(id_index_lookup(&index, 0));
+	ZUC_ASSERT_NULL(id_index_lookup(&index, 42));
+
+	/* removing from an empty index is fine */
+	id_index_remove(&index, 42, &index);
+	id_index_release(&index);
+}
+
+ZUC_TEST(id_index_test, insert_lookup_remove)
+{
+	struct id_index index;
+	struct object objects[1000];
+	unsigned i;
+
+	id_index_init(&index);
+
+	for (i = 0; i < ARRAY_LENGTH(objects); i++) {
+		objects[i].id = i * 7919;
+		ZUC_ASSERTG_EQ(0, id_index_insert(&index, objects[i].id,
+						  &objects[i]), out);
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(objects); i++)
+		ZUC_ASSERTG_EQ(&objects[i],
+			       id_index_lookup(&index, objects[i].id), out);
+	ZUC_ASSERTG_NULL(id_index_lookup(&index, 1), out);
+
+	/* drop every other object */
+	for (i = 0; i < ARRAY_LENGTH(objects); i += 2)
+		id_index_remove(&index, objects[i].id, &objects[i]);
+
+	for (i = 0; i < ARRAY_LENGTH(objects); i++) {
+		if (i % 2)
+			ZUC_ASSERTG_EQ(&objects[i],
+				       id_index_lookup(&index, objects[i].id), out);
+		else
+			ZUC_ASSERTG_NULL(id_index_lookup(&index, objects[i].id),
+					 out);
+	}
+	ZUC_ASSERTG_EQ(ARRAY_LENGTH(objects) / 2, index.count, out);
+
+out:
+	id_index_release(&index);
+}
+
+ZUC_TEST(id_index_test, duplicate_ids)
+{
+	struct id_index index;
+	struct object a = { 5 }, b = { 5 };
+
+	id_index_init(&index);
+
+	ZUC_ASSERTG_EQ(0, id_index_insert(&index, 5, &a), out);
+	ZUC_ASSERTG_EQ(0, id_index_insert(&index, 5, &b), out);
+	ZUC_ASSERTG_TRUE(id_index_lookup(&index, 5) == &a ||
+			 id_index_lookup(&index, 5) == &b, out);
+
+	/* removing one pairing leaves the other reachable */
+	id_index_remove(&index, 5, &a);
+	ZUC_ASSERTG_EQ(&b, id_index_lookup(&index, 5), out);
+
+	/* removing an unknown pairing is a no-op */
+	id_index_remove(&index, 5, &a);
+	ZUC_ASSERTG_EQ(&b, id_index_lookup(&index, 5), out);
+
+	id_index_remove(&index, 5, &b);
+	ZUC_ASSERTG_NULL(id_index_lookup(&index, 5), out);
+
+out:
+	id_index_release(&index);
+}
+
+ZUC_TEST(id_index_test, churn_keeps_table_small)
+{
+	struct id_index index;
+	struct object objects[16];
+	unsigned i, round;
+
+	id_index_init(&index);
+
+	/* surfaces coming and going for a long time must not grow the table
+	 * or leave stale entries behind */
+	for (round = 0; round < 10000; round++) {
+		for (i = 0; i < ARRAY_LENGTH(objects); i++) {
+			objects[i].id = round * ARRAY_LENGTH(objects) + i;
+			ZUC_ASSERTG_EQ(0, id_index_insert(&index, objects[i].id,
+							  &objects[i]), out);
+		}
+		for (i = 0; i < ARRAY_LENGTH(objects); i++) {
+			ZUC_ASSERTG_EQ(&objects[i],
+				       id_index_lookup(&index, objects[i].id),
+				       out);
+			id_index_remove(&index, objects[i].id, &objects[i]);
+		}
+	}
+
+	ZUC_ASSERTG_EQ(0, index.count, out);
+	ZUC_ASSERTG_TRUE(index.size <= 128, out);
+	ZUC_ASSERTG_NULL(id_index_lookup(&index, 0), out);
+
+out:
+	id_index_release(&index);
+}
+
+static double
+lookup_ns(unsigned count, unsigned lookups)
+{
+	struct id_index index;
+	struct object *objects;
+	struct timespec start, end;
+	uintptr_t hits = 0;
+	unsigned i;
+
+	objects = calloc(count, sizeof *objects);
+	if (!objects)
+		return -1.0;
+
+	id_index_init(&index);
+	for (i = 0; i < count; i++) {
+		/* shells key surfaces by their masked address */
+		objects[i].id = (uint32_t)(INT32_MAX & (uintptr_t)&objects[i]);
+		id_index_insert(&index, objects[i].id, &objects[i]);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < lookups; i++)
+		hits += id_index_lookup(&index,
+					objects[(i * 2654435761u) % count].id) != NULL;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	id_index_release(&index);
+	free(objects);
+
+	if (hits != lookups)
+		return -1.0;
+
+	return (double)timespec_sub_to_nsec(&end, &start) / lookups;
+}
+
+ZUC_TEST(id_index_test, lookup_benchmark)
+{
+	static const unsigned counts[] = { 16, 256, 4096, 16384 };
+	double ns;
+	unsigned i;
+
+	/* an HMI issuing requests against a growing number of surfaces */
+	for (i = 0; i < ARRAY_LENGTH(counts); i++) {
+		ns = lookup_ns(counts[i], 1000000);
+		ZUC_ASSERT_TRUE(ns >= 0.0);
+		printf("%u surfaces: %.1f ns per id lookup\n", counts[i], ns);
+	}
+}
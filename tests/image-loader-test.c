@@ -0,0 +1,490 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <png.h>
+#include <pixman.h>
+#ifdef HAVE_JPEG
+#include <jpeglib.h>
+#endif
+
+#include "shared/helpers.h"
+#include "shared/image-loader.h"
+#include "zunitc/zunitc.h"
+
+static const char *image_names[] = {
+	"background.png",
+	"home.png",
+	"icon_ivi_flower.png",
+	"pattern.png",
+	"sign_close.png",
+	"terminal.png",
+	"wayland.png",
+};
+
+static char *
+data_path(const char *name)
+{
+	char *path;
+
+	if (asprintf(&path, "%s/%s", IMAGE_LOADER_DATA_DIR, name) < 0)
+		return NULL;
+
+	return path;
+}
+
+/* libpng's own premultiplied BGRA output, rounded the same way */
+static bool
+image_matches_png(pixman_image_t *image, const char *path)
+{
+	png_image png = { .version = PNG_IMAGE_VERSION };
+	uint8_t *ref, *row;
+	uint32_t *pixels;
+	uint32_t expect, x, y, a, c, t;
+	int stride;
+	bool match = true;
+
+	if (!png_image_begin_read_from_file(&png, path))
+		return false;
+
+	png.format = PNG_FORMAT_BGRA;
+	ref = malloc(PNG_IMAGE_SIZE(png));
+	if (!ref || !png_image_finish_read(&png, NULL, ref, 0, NULL)) {
+		free(ref);
+		return false;
+	}
+
+	if (pixman_image_get_width(image) != (int)png.width ||
+	    pixman_image_get_height(image) != (int)png.height) {
+		free(ref);
+		return false;
+	}
+
+	pixels = pixman_image_get_data(image);
+	stride = pixman_image_get_stride(image) / 4;
+	for (y = 0; y < png.height && match; y++) {
+		row = ref + y * PNG_IMAGE_ROW_STRIDE(png);
+		for (x = 0; x < png.width; x++, row += 4) {
+			a = row[3];
+			expect = a << 24;
+			for (c = 0; c < 3; c++) {
+				t = a * row[c] + 0x80;
+				expect |= ((t + (t >> 8)) >> 8) << (8 * c);
+			}
+			if (pixels[y * stride + x] != expect) {
+				match = false;
+				break;
+			}
+		}
+	}
+
+	free(ref);
+
+	return match;
+}
+
+static bool
+images_equal(pixman_image_t *a, pixman_image_t *b)
+{
+	int height = pixman_image_get_height(a);
+	int y;
+
+	if (pixman_image_get_width(a) != pixman_image_get_width(b) ||
+	    height != pixman_image_get_height(b))
+		return false;
+
+	for (y = 0; y < height; y++) {
+		if (memcmp((uint8_t *)pixman_image_get_data(a) +
+				y * pixman_image_get_stride(a),
+			   (uint8_t *)pixman_image_get_data(b) +
+				y * pixman_image_get_stride(b),
+			   pixman_image_get_width(a) * 4) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static void
+remove_dir(const char *dir)
+{
+	struct dirent *de;
+	DIR *d = opendir(dir);
+
+	while (d && (de = readdir(d))) {
+		if (strcmp(de->d_name, ".") != 0 &&
+		    strcmp(de->d_name, "..") != 0)
+			unlinkat(dirfd(d), de->d_name, 0);
+	}
+	if (d)
+		closedir(d);
+	rmdir(dir);
+}
+
+static pixman_image_t *
+load_cached(const char *path)
+{
+	pixman_image_t *image;
+
+	load_images(&path, 1, &image, IMAGE_LOAD_CACHE);
+
+	return image;
+}
+
+/* The one entry in the cache dir */
+static char *
+cache_entry(const char *cache_dir)
+{
+	struct dirent *de;
+	char *entry = NULL;
+	DIR *d;
+
+	d = opendir(cache_dir);
+	if (!d)
+		return NULL;
+	while ((de = readdir(d)) && de->d_name[0] == '.')
+		;
+	if (de && asprintf(&entry, "%s/%s", cache_dir, de->d_name) < 0)
+		entry = NULL;
+	closedir(d);
+
+	return entry;
+}
+
+static bool
+copy_file(const char *from, const char *to)
+{
+	char buf[4096];
+	FILE *in, *out;
+	size_t len;
+	bool ok = true;
+
+	in = fopen(from, "rb");
+	out = fopen(to, "wb");
+	while (in && out && (len = fread(buf, 1, sizeof buf, in)) > 0)
+		ok = ok && fwrite(buf, 1, len, out) == len;
+	if (!in || !out)
+		ok = false;
+	if (in)
+		fclose(in);
+	if (out && fclose(out) != 0)
+		ok = false;
+
+	return ok;
+}
+
+ZUC_TEST(image_loader, png_is_premultiplied)
+{
+	pixman_image_t *image;
+	unsigned int i;
+	char *path;
+
+	for (i = 0; i < ARRAY_LENGTH(image_names); i++) {
+		path = data_path(image_names[i]);
+		image = load_image(path);
+		ZUC_ASSERT_NOT_NULL(image);
+		ZUC_ASSERT_TRUE(image_matches_png(image, path));
+		pixman_image_unref(image);
+		free(path);
+	}
+}
+
+ZUC_TEST(image_loader, cache_hit_matches_decode)
+{
+	char runtime_dir[] = "/tmp/image-loader-test-XXXXXX";
+	char *cache_dir, *path, *entry;
+	pixman_image_t *decoded, *cached;
+	struct stat st;
+	FILE *fp;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(runtime_dir));
+	ZUC_ASSERT_TRUE(asprintf(&cache_dir, "%s/weston-image-cache",
+				 runtime_dir) > 0);
+	setenv("XDG_RUNTIME_DIR", runtime_dir, 1);
+	path = data_path("wayland.png");
+
+	/* plain loads never touch the cache */
+	decoded = load_image(path);
+	ZUC_ASSERT_NOT_NULL(decoded);
+	ZUC_ASSERT_EQ(-1, stat(cache_dir, &st));
+
+	/* the first cached load decodes and stores, the second maps */
+	cached = load_cached(path);
+	ZUC_ASSERT_NOT_NULL(cached);
+	pixman_image_unref(cached);
+	cached = load_cached(path);
+	ZUC_ASSERT_NOT_NULL(cached);
+	ZUC_ASSERT_TRUE(pixman_image_get_data(cached) !=
+			pixman_image_get_data(decoded));
+	ZUC_ASSERT_TRUE(images_equal(decoded, cached));
+	pixman_image_unref(cached);
+
+	/* a damaged entry is ignored, not trusted */
+	entry = cache_entry(cache_dir);
+	ZUC_ASSERT_NOT_NULL(entry);
+	ZUC_ASSERT_EQ(0, truncate(entry, 100));
+
+	cached = load_cached(path);
+	ZUC_ASSERT_NOT_NULL(cached);
+	ZUC_ASSERT_TRUE(images_equal(decoded, cached));
+	pixman_image_unref(cached);
+
+	/* and rewritten on that load */
+	fp = fopen(entry, "rb");
+	ZUC_ASSERT_NOT_NULL(fp);
+	fseek(fp, 0, SEEK_END);
+	ZUC_ASSERT_TRUE(ftell(fp) > 100);
+	fclose(fp);
+
+	pixman_image_unref(decoded);
+	free(entry);
+	free(path);
+	remove_dir(cache_dir);
+	remove_dir(runtime_dir);
+	free(cache_dir);
+	unsetenv("XDG_RUNTIME_DIR");
+}
+
+ZUC_TEST(image_loader, cache_checks_source_and_header)
+{
+	char runtime_dir[] = "/tmp/image-loader-test-XXXXXX";
+	static const int32_t bad_stride = 0x7fffffff;
+	char *cache_dir, *source, *path, *entry, *entry2;
+	pixman_image_t *decoded, *cached;
+	struct timespec times[2];
+	uint8_t junk[256];
+	FILE *fp;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(runtime_dir));
+	ZUC_ASSERT_TRUE(asprintf(&cache_dir, "%s/weston-image-cache",
+				 runtime_dir) > 0);
+	ZUC_ASSERT_TRUE(asprintf(&source, "%s/source.png", runtime_dir) > 0);
+	setenv("XDG_RUNTIME_DIR", runtime_dir, 1);
+	path = data_path("wayland.png");
+	ZUC_ASSERT_TRUE(copy_file(path, source));
+
+	decoded = load_image(source);
+	ZUC_ASSERT_NOT_NULL(decoded);
+	cached = load_cached(source);
+	ZUC_ASSERT_NOT_NULL(cached);
+	pixman_image_unref(cached);
+	entry = cache_entry(cache_dir);
+	ZUC_ASSERT_NOT_NULL(entry);
+
+	/* an unchanged source is served from the entry, even tampered */
+	memset(junk, 0x5a, sizeof junk);
+	fp = fopen(entry, "r+b");
+	ZUC_ASSERT_NOT_NULL(fp);
+	fseek(fp, -(long)sizeof junk, SEEK_END);
+	fwrite(junk, 1, sizeof junk, fp);
+	fclose(fp);
+	cached = load_cached(source);
+	ZUC_ASSERT_NOT_NULL(cached);
+	ZUC_ASSERT_FALSE(images_equal(decoded, cached));
+	pixman_image_unref(cached);
+
+	/* a header that would overflow the size check is rejected */
+	fp = fopen(entry, "r+b");
+	ZUC_ASSERT_NOT_NULL(fp);
+	fseek(fp, 3 * sizeof(int32_t), SEEK_SET);
+	fwrite(&bad_stride, sizeof bad_stride, 1, fp);
+	fclose(fp);
+	cached = load_cached(source);
+	ZUC_ASSERT_NOT_NULL(cached);
+	ZUC_ASSERT_TRUE(images_equal(decoded, cached));
+	pixman_image_unref(cached);
+
+	/* a modified source gets a fresh entry */
+	clock_gettime(CLOCK_REALTIME, &times[0]);
+	times[0].tv_sec += 10;
+	times[1] = times[0];
+	ZUC_ASSERT_EQ(0, utimensat(AT_FDCWD, source, times, 0));
+	cached = load_cached(source);
+	ZUC_ASSERT_NOT_NULL(cached);
+	ZUC_ASSERT_TRUE(images_equal(decoded, cached));
+	pixman_image_unref(cached);
+	unlink(entry);
+	entry2 = cache_entry(cache_dir);
+	ZUC_ASSERT_NOT_NULL(entry2);
+	ZUC_ASSERT_TRUE(strcmp(entry, entry2) != 0);
+
+	pixman_image_unref(decoded);
+	free(entry);
+	free(entry2);
+	free(path);
+	free(source);
+	remove_dir(cache_dir);
+	remove_dir(runtime_dir);
+	free(cache_dir);
+	unsetenv("XDG_RUNTIME_DIR");
+}
+
+struct fifo_writer {
+	const char *from;
+	const char *fifo;
+	bool ok;
+};
+
+static void *
+fifo_writer_thread(void *data)
+{
+	struct fifo_writer *w = data;
+
+	w->ok = copy_file(w->from, w->fifo);
+
+	return NULL;
+}
+
+ZUC_TEST(image_loader, loads_from_fifo)
+{
+	char dir[] = "/tmp/image-loader-test-XXXXXX";
+	struct fifo_writer w;
+	pixman_image_t *decoded, *image;
+	pthread_t thread;
+	char *fifo, *path;
+
+	ZUC_ASSERT_NOT_NULL(mkdtemp(dir));
+	ZUC_ASSERT_TRUE(asprintf(&fifo, "%s/fifo", dir) > 0);
+	ZUC_ASSERT_EQ(0, mkfifo(fifo, 0600));
+	path = data_path("wayland.png");
+
+	w.from = path;
+	w.fifo = fifo;
+	w.ok = false;
+	ZUC_ASSERT_EQ(0, pthread_create(&thread, NULL, fifo_writer_thread,
+					&w));
+	image = load_image(fifo);
+	pthread_join(thread, NULL);
+	ZUC_ASSERT_TRUE(w.ok);
+	ZUC_ASSERT_NOT_NULL(image);
+
+	decoded = load_image(path);
+	ZUC_ASSERT_NOT_NULL(decoded);
+	ZUC_ASSERT_TRUE(images_equal(decoded, image));
+
+	pixman_image_unref(decoded);
+	pixman_image_unref(image);
+	unlink(fifo);
+	rmdir(dir);
+	free(fifo);
+	free(path);
+}
+
+ZUC_TEST(image_loader, load_images_matches_load_image)
+{
+	const char *paths[ARRAY_LENGTH(image_names) + 1];
+	pixman_image_t *images[ARRAY_LENGTH(paths)];
+	pixman_image_t *image;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(image_names); i++)
+		paths[i] = data_path(image_names[i]);
+	paths[i] = IMAGE_LOADER_DATA_DIR "/does-not-exist.png";
+
+	load_images(paths, ARRAY_LENGTH(paths), images, 0);
+
+	for (i = 0; i < ARRAY_LENGTH(image_names); i++) {
+		ZUC_ASSERT_NOT_NULL(images[i]);
+		image = load_image(paths[i]);
+		ZUC_ASSERT_TRUE(images_equal(image, images[i]));
+		pixman_image_unref(image);
+		pixman_image_unref(images[i]);
+		free((char *)paths[i]);
+	}
+	ZUC_ASSERT_NULL(images[i]);
+}
+
+#ifdef HAVE_JPEG
+/*
+ * A 16x16 baseline JPEG with a second SOF marker between its scan and
+ * EOI. libjpeg only reads that far in jpeg_finish_decompress(), which
+ * then fails.
+ */
+static bool
+write_jpeg_with_trailing_sof(int fd)
+{
+	static const uint8_t sof[] = {
+		0xff, 0xc0, 0x00, 0x11, 8, 0, 16, 0, 16, 3,
+		1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1,
+	};
+	static const uint8_t eoi[] = { 0xff, 0xd9 };
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	unsigned char *buf = NULL;
+	unsigned long len = 0;
+	uint8_t row[16 * 3];
+	JSAMPROW rows[1] = { row };
+	bool ok;
+
+	memset(row, 0x80, sizeof(row));
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_mem_dest(&cinfo, &buf, &len);
+	cinfo.image_width = 16;
+	cinfo.image_height = 16;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_start_compress(&cinfo, TRUE);
+	while (cinfo.next_scanline < cinfo.image_height)
+		jpeg_write_scanlines(&cinfo, rows, 1);
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	/* replace the EOI that ends the file */
+	ok = len > sizeof(eoi) &&
+	     write(fd, buf, len - sizeof(eoi)) == (ssize_t)(len - sizeof(eoi)) &&
+	     write(fd, sof, sizeof(sof)) == sizeof(sof) &&
+	     write(fd, eoi, sizeof(eoi)) == sizeof(eoi);
+	free(buf);
+
+	return ok;
+}
+
+ZUC_TEST(image_loader, jpeg_trailer_error_fails_cleanly)
+{
+	char path[] = "/tmp/image-loader-test-XXXXXX";
+	int fd;
+
+	fd = mkstemp(path);
+	ZUC_ASSERT_TRUE(fd >= 0);
+	ZUC_ASSERT_TRUE(write_jpeg_with_trailing_sof(fd));
+	close(fd);
+
+	ZUC_ASSERT_NULL(load_image(path));
+
+	unlink(path);
+}
+#endif
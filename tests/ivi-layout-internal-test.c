@@ -31,6 +31,8 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <math.h>
+#include <time.h>
 
 #include <libweston/libweston.h>
 #include "compositor/weston.h"
@@ -38,6 +40,7 @@
 #include "ivi-shell/ivi-layout-private.h"
 #include "ivi-test.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 struct test_context {
 	struct weston_compositor *compositor;
@@ -939,6 +942,230 @@ test_surface_bad_remove_notification(struct test_context *ctx)
 	iassert(lyt->add_listener_remove_surface(NULL) == IVI_FAILED);
 }
 
+static void
+test_layer_transition_commit_counter(struct wl_listener *listener, void *data)
+{
+	struct test_context *ctx =
+			container_of(listener, struct test_context,
+					layer_property_changed);
+
+	ctx->user_flags++;
+}
+
+static void
+transition_fake_repaint(struct weston_output *output,
+			const struct timespec *base, int32_t msec)
+{
+	struct weston_animation *animation;
+	struct weston_animation *next;
+	struct timespec time;
+
+	timespec_add_msec(&time, base, msec);
+
+	/* Mimic the tail of weston_output_repaint() with a fake clock. */
+	wl_list_for_each_safe(animation, next, &output->animation_list, link) {
+		animation->frame_counter++;
+		animation->frame(animation, output, &time);
+	}
+}
+
+static void
+test_layer_move_transition_frame_clock(struct test_context *ctx)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	const struct ivi_layout_layer_properties *prop;
+	struct ivi_layout_layer *ivilayer;
+	struct weston_output *output;
+	struct timespec base = { .tv_sec = 1000, .tv_nsec = 0 };
+
+	iassert(!wl_list_empty(&ctx->compositor->output_list));
+	output = container_of(ctx->compositor->output_list.next,
+			      struct weston_output, link);
+
+	ivilayer = lyt->layer_create_with_dimension(IVI_TEST_LAYER_ID(0), 200, 300);
+	iassert(lyt->layer_set_destination_rectangle(
+		ivilayer, 0, 0, 200, 300) == IVI_SUCCEEDED);
+	lyt->commit_changes();
+	prop = lyt->get_properties_of_layer(ivilayer);
+
+	/* nothing hooked into the repaint loop while idle */
+	iassert(wl_list_empty(&output->animation_list));
+
+	iassert(lyt->layer_set_transition(ivilayer,
+		IVI_LAYOUT_TRANSITION_LAYER_MOVE, 100) == IVI_SUCCEEDED);
+	iassert(lyt->layer_set_destination_rectangle(
+		ivilayer, 100, 0, 200, 300) == IVI_SUCCEEDED);
+	lyt->commit_changes();
+	iassert(wl_list_length(&output->animation_list) == 1);
+
+	ctx->user_flags = 0;
+	ctx->layer_property_changed.notify = test_layer_transition_commit_counter;
+	iassert(lyt->layer_add_listener(ivilayer, &ctx->layer_property_changed) == IVI_SUCCEEDED);
+
+	/* first sample starts the transition */
+	transition_fake_repaint(output, &base, 0);
+	iassert(ctx->user_flags == 1);
+	iassert(prop->dest_x == 0);
+
+	/* a second repaint in the same refresh period commits nothing */
+	transition_fake_repaint(output, &base, 0);
+	iassert(ctx->user_flags == 1);
+
+	transition_fake_repaint(output, &base, 50);
+	iassert(ctx->user_flags == 2);
+	iassert(prop->dest_x == (int32_t)(100 * sin(M_PI_4)));
+
+	transition_fake_repaint(output, &base, 100);
+	iassert(ctx->user_flags == 3);
+	iassert(prop->dest_x == 100);
+
+	/* finished transitions unhook the clock again */
+	iassert(wl_list_empty(&output->animation_list));
+
+	wl_list_remove(&ctx->layer_property_changed.link);
+	lyt->layer_destroy(ivilayer);
+}
+
+/*
+ * Objects walked by a commit that changes one layer's opacity while
+ * count - 1 other layers sit idle on the same screen.
+ */
+static bool
+count_single_change_commit(struct test_context *ctx, uint32_t count,
+			   struct ivi_layout_commit_stats *stats)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct weston_output *output;
+	struct ivi_layout_layer **layers;
+	uint32_t i;
+
+	if (!iassert(!wl_list_empty(&ctx->compositor->output_list)))
+		return false;
+
+	output = wl_container_of(ctx->compositor->output_list.next, output, link);
+
+	layers = zalloc(count * sizeof(*layers));
+	if (!iassert(layers != NULL))
+		return false;
+
+	for (i = 0; i < count; i++) {
+		layers[i] = lyt->layer_create_with_dimension(
+				IVI_TEST_LAYER_ID(IVI_TEST_LAYER_COUNT + i),
+				200, 300);
+		iassert(layers[i] != NULL);
+		lyt->layer_set_destination_rectangle(layers[i], i, 0, 200, 300);
+		iassert(lyt->screen_add_layer(output, layers[i]) ==
+			IVI_SUCCEEDED);
+	}
+	lyt->commit_changes();
+
+	lyt->layer_set_opacity(layers[count / 2], wl_fixed_from_double(0.5));
+	lyt->commit_changes();
+	*stats = layers[0]->layout->commit_stats;
+
+	for (i = 0; i < count; i++)
+		lyt->layer_destroy(layers[i]);
+	free(layers);
+
+	return true;
+}
+
+static void
+test_commit_cost_independent_of_layer_count(struct test_context *ctx)
+{
+	struct ivi_layout_commit_stats few, many;
+
+	if (!count_single_change_commit(ctx, 16, &few) ||
+	    !count_single_change_commit(ctx, 4096, &many))
+		return;
+
+	weston_log("single change commit walked %u/%u layers and %u/%u "
+		   "views with 16/4096 layers\n",
+		   few.layers, many.layers,
+		   few.views, many.views);
+
+	/* only the changed layer, however many others there are */
+	iassert(few.screens == 0);
+	iassert(few.layers == 1);
+	iassert(few.surfaces == 0);
+	iassert(many.screens == few.screens);
+	iassert(many.layers == few.layers);
+	iassert(many.surfaces == few.surfaces);
+	iassert(many.views == few.views);
+}
+
+/*
+ * Objects walked by a commit that retargets the running fade of one layer
+ * while count - 1 other layers keep fading.
+ */
+static bool
+count_fade_retarget(struct test_context *ctx, uint32_t count,
+		    struct ivi_layout_commit_stats *stats)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_layer **layers;
+	struct ivi_layout_layer *target;
+	struct wl_list *fade;
+	uint32_t i;
+
+	layers = zalloc(count * sizeof(*layers));
+	if (!iassert(layers != NULL))
+		return false;
+
+	for (i = 0; i < count; i++) {
+		layers[i] = lyt->layer_create_with_dimension(
+				IVI_TEST_LAYER_ID(IVI_TEST_LAYER_COUNT + i),
+				200, 300);
+		iassert(layers[i] != NULL);
+		lyt->layer_set_fade_info(layers[i], 1, 0.0, 1.0);
+		lyt->layer_set_transition(layers[i],
+					  IVI_LAYOUT_TRANSITION_LAYER_FADE, 500);
+	}
+	lyt->commit_changes();
+
+	/* every layer carries its own fade and nothing else */
+	for (i = 0; i < count; i++)
+		iassert(wl_list_length(&layers[i]->transition_list) == 1);
+
+	target = layers[count / 2];
+	fade = target->transition_list.next;
+
+	lyt->layer_set_fade_info(target, 0, 1.0, 0.0);
+	lyt->layer_set_transition(target, IVI_LAYOUT_TRANSITION_LAYER_FADE, 500);
+	lyt->commit_changes();
+	*stats = target->layout->commit_stats;
+
+	/* the fade was retargeted in place */
+	iassert(wl_list_length(&target->transition_list) == 1);
+	iassert(target->transition_list.next == fade);
+
+	/* destroying a layer also drops its running transitions */
+	for (i = 0; i < count; i++)
+		lyt->layer_destroy(layers[i]);
+	free(layers);
+
+	return true;
+}
+
+static void
+test_transition_lookup_independent_of_transition_count(struct test_context *ctx)
+{
+	struct ivi_layout_commit_stats few, many;
+
+	if (!count_fade_retarget(ctx, 64, &few) ||
+	    !count_fade_retarget(ctx, 4096, &many))
+		return;
+
+	weston_log("fade retarget looked at %u/%u transitions with 64/4096 "
+		   "fades\n", few.transitions, many.transitions);
+
+	/* only the fade of the retargeted layer */
+	iassert(few.layers == 1);
+	iassert(few.transitions == 1);
+	iassert(many.layers == few.layers);
+	iassert(many.transitions == few.transitions);
+}
+
 /************************ tests end ********************************/
 
 static void
@@ -988,6 +1215,10 @@ run_internal_tests(void *data)
 	test_layer_bad_remove_notification(ctx);
 	test_surface_bad_remove_notification(ctx);
 
+	test_layer_move_transition_frame_clock(ctx);
+	test_commit_cost_independent_of_layer_count(ctx);
+	test_transition_lookup_independent_of_transition_count(ctx);
+
 	weston_compositor_exit_with_code(ctx->compositor, EXIT_SUCCESS);
 	free(ctx);
 }
@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include "linux-sync-file.h"
+#include "sw-sync-helper.h"
+#include "zunitc/zunitc.h"
+
+ZUC_TEST(linux_sync_file, pipe_is_signalled_once_readable)
+{
+	int fds[2];
+	char c = 0;
+
+	/* a pipe polls like a fence: readable once "signalled" */
+	ZUC_ASSERT_EQ(0, pipe(fds));
+	ZUC_ASSERT_FALSE(linux_sync_file_is_signalled(fds[0]));
+
+	ZUC_ASSERT_EQ(1, write(fds[1], &c, 1));
+	ZUC_ASSERT_TRUE(linux_sync_file_is_signalled(fds[0]));
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+ZUC_TEST(linux_sync_file, closed_fd_is_signalled)
+{
+	int fds[2];
+
+	/* nobody must wait forever on an fd that cannot signal */
+	ZUC_ASSERT_EQ(0, pipe(fds));
+	close(fds[0]);
+	close(fds[1]);
+	ZUC_ASSERT_TRUE(linux_sync_file_is_signalled(fds[0]));
+}
+
+ZUC_TEST(linux_sync_file, sw_sync_fence_signals)
+{
+	int timeline;
+	int fence;
+
+	timeline = sw_sync_timeline_create();
+	if (timeline < 0)
+		ZUC_SKIP("sw_sync is not available");
+
+	fence = sw_sync_timeline_create_fence(timeline, 2);
+	ZUC_ASSERT_TRUE(fence >= 0);
+	ZUC_ASSERT_TRUE(linux_sync_file_is_valid(fence));
+	ZUC_ASSERT_FALSE(linux_sync_file_is_signalled(fence));
+
+	ZUC_ASSERT_EQ(0, sw_sync_timeline_inc(timeline, 1));
+	ZUC_ASSERT_FALSE(linux_sync_file_is_signalled(fence));
+
+	ZUC_ASSERT_EQ(0, sw_sync_timeline_inc(timeline, 1));
+	ZUC_ASSERT_TRUE(linux_sync_file_is_signalled(fence));
+
+	close(fence);
+	close(timeline);
+}
@@ -0,0 +1,380 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include "compositor/weston.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+#define PICK_POINTS 20000
+#define BENCH_PICKS 100000
+
+struct pick_test;
+
+typedef void (*pick_test_step_t)(struct pick_test *pt);
+
+struct pick_test {
+	struct weston_compositor *compositor;
+	struct weston_layer layer;
+	struct weston_surface **surfaces;
+	int count;
+	pixman_box32_t area;
+
+	/* The view list is only rebuilt by an output repaint, so the test
+	 * continues from the frame signal once the repaint it asked for
+	 * went through. */
+	struct wl_listener frame_listener;
+	pick_test_step_t next_step;
+	bool step_queued;
+	unsigned int bench;
+};
+
+static const int bench_counts[] = { 100, 1000, 10000 };
+
+static int
+random_in(int lo, int hi)
+{
+	return lo + rand() % (hi - lo);
+}
+
+static void
+place_view(struct pick_test *pt, struct weston_view *view)
+{
+	int w = pt->area.x2 - pt->area.x1;
+	int h = pt->area.y2 - pt->area.y1;
+
+	/* some views hang off the output edges */
+	weston_view_set_position(view,
+				 random_in(pt->area.x1 - w / 8, pt->area.x2),
+				 random_in(pt->area.y1 - h / 8, pt->area.y2));
+}
+
+static void
+populate(struct pick_test *pt, int count)
+{
+	struct weston_surface *surface;
+	struct weston_view *view;
+	int i;
+
+	pt->surfaces = calloc(count, sizeof *pt->surfaces);
+	assert(pt->surfaces);
+	pt->count = count;
+
+	for (i = 0; i < count; i++) {
+		surface = weston_surface_create(pt->compositor);
+		assert(surface);
+		view = weston_view_create(surface);
+		assert(view);
+
+		surface->width = random_in(8, 256);
+		surface->height = random_in(8, 256);
+
+		/* every third surface only takes input on its left half */
+		if (i % 3 == 0) {
+			pixman_region32_fini(&surface->input);
+			pixman_region32_init_rect(&surface->input, 0, 0,
+						  surface->width / 2,
+						  surface->height);
+		}
+
+		place_view(pt, view);
+		weston_layer_entry_insert(&pt->layer.view_list,
+					  &view->layer_link);
+		pt->surfaces[i] = surface;
+	}
+}
+
+static void
+run_step(void *data)
+{
+	struct pick_test *pt = data;
+	struct weston_view *view;
+	pick_test_step_t step = pt->next_step;
+
+	pt->next_step = NULL;
+	pt->step_queued = false;
+	wl_list_for_each(view, &pt->compositor->view_list, link)
+		weston_view_update_transform(view);
+
+	step(pt);
+}
+
+static void
+handle_frame(struct wl_listener *listener, void *data)
+{
+	struct pick_test *pt =
+		container_of(listener, struct pick_test, frame_listener);
+	struct wl_event_loop *loop;
+
+	if (!pt->next_step || pt->step_queued)
+		return;
+
+	/* not from within the repaint */
+	pt->step_queued = true;
+	loop = wl_display_get_event_loop(pt->compositor->wl_display);
+	wl_event_loop_add_idle(loop, run_step, pt);
+}
+
+static void
+update_views(struct pick_test *pt, pick_test_step_t next_step)
+{
+	pt->next_step = next_step;
+	weston_compositor_schedule_repaint(pt->compositor);
+}
+
+static void
+depopulate(struct pick_test *pt)
+{
+	int i;
+
+	for (i = 0; i < pt->count; i++)
+		weston_surface_destroy(pt->surfaces[i]);
+	free(pt->surfaces);
+	pt->surfaces = NULL;
+	pt->count = 0;
+}
+
+static void
+random_point(struct pick_test *pt, wl_fixed_t *x, wl_fixed_t *y)
+{
+	int w = pt->area.x2 - pt->area.x1;
+	int h = pt->area.y2 - pt->area.y1;
+
+	/* include points outside of every output */
+	*x = wl_fixed_from_double(pt->area.x1 - w / 16 +
+				  (double)rand() / RAND_MAX * w * 9 / 8);
+	*y = wl_fixed_from_double(pt->area.y1 - h / 16 +
+				  (double)rand() / RAND_MAX * h * 9 / 8);
+}
+
+/* Reference result: the topmost view on the view list accepting input at
+ * the point, found by testing every view. */
+static struct weston_view *
+pick_view_linear(struct pick_test *pt, wl_fixed_t x, wl_fixed_t y,
+		 wl_fixed_t *vx, wl_fixed_t *vy)
+{
+	struct weston_view *view;
+	wl_fixed_t view_x, view_y;
+	int ix, iy;
+
+	wl_list_for_each(view, &pt->compositor->view_list, link) {
+		if (!pixman_region32_contains_point(&view->transform.boundingbox,
+						    wl_fixed_to_int(x),
+						    wl_fixed_to_int(y), NULL))
+			continue;
+
+		weston_view_from_global_fixed(view, x, y, &view_x, &view_y);
+		ix = wl_fixed_to_int(view_x);
+		iy = wl_fixed_to_int(view_y);
+
+		if (!pixman_region32_contains_point(&view->surface->input,
+						    ix, iy, NULL))
+			continue;
+
+		if (view->geometry.scissor_enabled &&
+		    !pixman_region32_contains_point(&view->geometry.scissor,
+						    ix, iy, NULL))
+			continue;
+
+		*vx = view_x;
+		*vy = view_y;
+		return view;
+	}
+
+	*vx = wl_fixed_from_int(-1000000);
+	*vy = wl_fixed_from_int(-1000000);
+	return NULL;
+}
+
+static void
+compare_picks(struct pick_test *pt)
+{
+	struct weston_view *indexed, *linear;
+	wl_fixed_t x, y, ix, iy, lx, ly;
+	int i, hits = 0;
+
+	for (i = 0; i < PICK_POINTS; i++) {
+		random_point(pt, &x, &y);
+
+		indexed = weston_compositor_pick_view(pt->compositor, x, y,
+						      &ix, &iy);
+		linear = pick_view_linear(pt, x, y, &lx, &ly);
+		assert(indexed == linear);
+		assert(ix == lx && iy == ly);
+
+		if (indexed)
+			hits++;
+	}
+
+	assert(hits > 0);
+}
+
+static double
+bench_picks(struct pick_test *pt, bool indexed)
+{
+	struct timespec start, end;
+	wl_fixed_t x, y, vx, vy;
+	int i;
+
+	srand(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCH_PICKS; i++) {
+		random_point(pt, &x, &y);
+		if (indexed)
+			weston_compositor_pick_view(pt->compositor, x, y,
+						    &vx, &vy);
+		else
+			pick_view_linear(pt, x, y, &vx, &vy);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (double)timespec_sub_to_nsec(&end, &start) / BENCH_PICKS;
+}
+
+static void
+finish(struct pick_test *pt)
+{
+	wl_list_remove(&pt->frame_listener.link);
+	weston_layer_unset_position(&pt->layer);
+	weston_compositor_exit(pt->compositor);
+	free(pt);
+}
+
+static void
+bench_step(struct pick_test *pt)
+{
+	int count = bench_counts[pt->bench];
+
+	fprintf(stderr, "%5d views: indexed %8.1f ns/pick, "
+		"linear %8.1f ns/pick\n", count,
+		bench_picks(pt, true), bench_picks(pt, false));
+	depopulate(pt);
+
+	if (++pt->bench == ARRAY_LENGTH(bench_counts)) {
+		finish(pt);
+		return;
+	}
+
+	populate(pt, bench_counts[pt->bench]);
+	update_views(pt, bench_step);
+}
+
+static void
+restacked_step(struct pick_test *pt)
+{
+	compare_picks(pt);
+	depopulate(pt);
+
+	pt->bench = 0;
+	populate(pt, bench_counts[0]);
+	update_views(pt, bench_step);
+}
+
+/* Same result as the linear scan, also after views moved and the
+ * stacking order changed. */
+static void
+populated_step(struct pick_test *pt)
+{
+	struct weston_view *view;
+	int j;
+
+	compare_picks(pt);
+
+	for (j = 0; j < pt->count; j += 7) {
+		view = wl_container_of(pt->surfaces[j]->views.next, view,
+				       surface_link);
+		place_view(pt, view);
+		weston_view_update_transform(view);
+		if (j % 2)
+			weston_layer_entry_remove(&view->layer_link);
+	}
+	compare_picks(pt);
+
+	for (j = 0; j < pt->count; j += 7) {
+		view = wl_container_of(pt->surfaces[j]->views.next, view,
+				       surface_link);
+		if (j % 2)
+			weston_layer_entry_insert(&pt->layer.view_list,
+						  &view->layer_link);
+	}
+	update_views(pt, restacked_step);
+}
+
+static void
+pick_view_test(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct weston_output *output;
+	struct pick_test *pt;
+
+	pt = calloc(1, sizeof *pt);
+	assert(pt);
+	pt->compositor = compositor;
+
+	pt->area.x1 = pt->area.y1 = INT32_MAX;
+	pt->area.x2 = pt->area.y2 = INT32_MIN;
+	wl_list_for_each(output, &compositor->output_list, link) {
+		pixman_box32_t *box = pixman_region32_extents(&output->region);
+
+		pt->area.x1 = MIN(pt->area.x1, box->x1);
+		pt->area.y1 = MIN(pt->area.y1, box->y1);
+		pt->area.x2 = MAX(pt->area.x2, box->x2);
+		pt->area.y2 = MAX(pt->area.y2, box->y2);
+	}
+	assert(pt->area.x1 < pt->area.x2 && pt->area.y1 < pt->area.y2);
+
+	/* every output repaint rebuilds the view list, one is enough */
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+	pt->frame_listener.notify = handle_frame;
+	wl_signal_add(&output->frame_signal, &pt->frame_listener);
+
+	weston_layer_init(&pt->layer, compositor);
+	weston_layer_set_position(&pt->layer, WESTON_LAYER_POSITION_NORMAL);
+	srand(0);
+
+	populate(pt, 2000);
+	update_views(pt, populated_step);
+}
+
+WL_EXPORT int
+wet_module_init(struct weston_compositor *compositor,
+		int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, pick_view_test, compositor);
+
+	return 0;
+}
@@ -0,0 +1,454 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/pixel-convert.h"
+#include "shared/timespec-util.h"
+#include "zunitc/zunitc.h"
+
+#define MAX_WIDTH 200
+
+static const enum pixel_convert_impl impls[] = {
+	PIXEL_CONVERT_IMPL_SCALAR,
+	PIXEL_CONVERT_IMPL_SSE4,
+	PIXEL_CONVERT_IMPL_AVX2,
+	PIXEL_CONVERT_IMPL_NEON,
+};
+
+static const char *impl_names[] = { "scalar", "sse4", "avx2", "neon" };
+
+static void
+fill_random(void *buf, size_t size, unsigned seed)
+{
+	uint8_t *p = buf;
+	size_t i;
+
+	srand(seed);
+	for (i = 0; i < size; i++)
+		p[i] = rand();
+}
+
+/* The conversions written out the obvious way, independent of the
+ * module, to pin down what the scalar kernels are meant to do. */
+static void
+reference_nv12_pixel(uint32_t p, int *r, int *g, int *b)
+{
+	*r = (p >> 16) & 0xff;
+	*g = (p >> 8) & 0xff;
+	*b = p & 0xff;
+}
+
+ZUC_TEST(pixel_convert_test, scalar_matches_reference)
+{
+	const struct pixel_convert_kernels *k =
+		pixel_convert_get_kernels(PIXEL_CONVERT_IMPL_SCALAR);
+	uint32_t src[4], out32[4];
+	uint8_t y[2][2], uv[2], rgb[12];
+	int r, g, b, i;
+
+	ZUC_ASSERT_NOT_NULL(k);
+
+	src[0] = 0x80112233;
+	k->swap_rb(out32, src, 1);
+	ZUC_ASSERT_EQ(0x80332211, out32[0]);
+
+	k->pack_rgb24(rgb, src, 1, false);
+	ZUC_ASSERT_EQ(0x33, rgb[0]);
+	ZUC_ASSERT_EQ(0x22, rgb[1]);
+	ZUC_ASSERT_EQ(0x11, rgb[2]);
+
+	k->unpack_rgb24(out32, rgb, 1, false);
+	ZUC_ASSERT_EQ(0xff112233, out32[0]);
+	k->unpack_rgb24(out32, rgb, 1, true);
+	ZUC_ASSERT_EQ(0xff332211, out32[0]);
+
+	/* black, white and the primaries at BT.601 limited range */
+	src[0] = src[1] = src[2] = src[3] = 0xff000000;
+	k->nv12(y[0], y[1], uv, src, src + 2, 2, false);
+	ZUC_ASSERT_EQ(16, y[0][0]);
+	ZUC_ASSERT_EQ(128, uv[0]);
+	ZUC_ASSERT_EQ(128, uv[1]);
+
+	src[0] = src[1] = src[2] = src[3] = 0xffffffff;
+	k->nv12(y[0], y[1], uv, src, src + 2, 2, false);
+	ZUC_ASSERT_EQ(235, y[1][1]);
+	ZUC_ASSERT_EQ(128, uv[0]);
+	ZUC_ASSERT_EQ(128, uv[1]);
+
+	src[0] = src[1] = src[2] = src[3] = 0xffff0000;
+	k->nv12(y[0], y[1], uv, src, src + 2, 2, false);
+	ZUC_ASSERT_EQ(82, y[0][1]);
+	ZUC_ASSERT_EQ(90, uv[0]);
+	ZUC_ASSERT_EQ(240, uv[1]);
+	/* the same pixels read as x8b8g8r8 are pure blue */
+	k->nv12(y[0], y[1], uv, src, src + 2, 2, true);
+	ZUC_ASSERT_EQ(41, y[0][1]);
+	ZUC_ASSERT_EQ(240, uv[0]);
+	ZUC_ASSERT_EQ(110, uv[1]);
+
+	/* chroma of a mixed block is taken from the rounded average */
+	src[0] = 0xff000000;
+	src[1] = 0xff0000ff;
+	src[2] = 0xff00ff00;
+	src[3] = 0xffff0000;
+	k->nv12(y[0], y[1], uv, src, src + 2, 2, false);
+	r = g = b = 0;
+	for (i = 0; i < 4; i++) {
+		int pr, pg, pb;
+
+		reference_nv12_pixel(src[i], &pr, &pg, &pb);
+		r += pr;
+		g += pg;
+		b += pb;
+	}
+	r = (r + 2) / 4;
+	g = (g + 2) / 4;
+	b = (b + 2) / 4;
+	ZUC_ASSERT_EQ(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128, uv[0]);
+	ZUC_ASSERT_EQ(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128, uv[1]);
+
+	/* alpha 0 clears, 255 keeps, anything else rounds c * a / 255 */
+	src[0] = 0x00ffffff;
+	src[1] = 0xff112233;
+	src[2] = 0x80ff8001;
+	src[3] = 0x40112233;
+	k->premultiply(out32, src, 4, false);
+	ZUC_ASSERT_EQ(0x00000000, out32[0]);
+	ZUC_ASSERT_EQ(0xff112233, out32[1]);
+	ZUC_ASSERT_EQ(0x80804001, out32[2]);
+	ZUC_ASSERT_EQ(0x4004090d, out32[3]);
+	/* R, G, B, A in memory */
+	k->premultiply(out32, src, 4, true);
+	ZUC_ASSERT_EQ(0xff332211, out32[1]);
+	ZUC_ASSERT_EQ(0x80014080, out32[2]);
+}
+
+/* Every alpha against every channel value, as the loaders used to
+ * compute it before the kernels. */
+ZUC_TEST(pixel_convert_test, premultiply_exhaustive)
+{
+	uint32_t src[256], out[ARRAY_LENGTH(impls)][256];
+	const struct pixel_convert_kernels *k;
+	unsigned a, c, i;
+	uint32_t expect, t;
+
+	for (a = 0; a < 256; a++) {
+		for (c = 0; c < 256; c++)
+			src[c] = (a << 24) | (c << 16) | ((255 - c) << 8) | c;
+
+		for (i = 0; i < ARRAY_LENGTH(impls); i++) {
+			k = pixel_convert_get_kernels(impls[i]);
+			if (!k)
+				continue;
+
+			k->premultiply(out[i], src, 256, false);
+			for (c = 0; c < 256; c++) {
+				t = a * c + 0x80;
+				expect = (a << 24) |
+					 (((t + (t >> 8)) >> 8) << 16) |
+					 ((t + (t >> 8)) >> 8);
+				t = a * (255 - c) + 0x80;
+				expect |= ((t + (t >> 8)) >> 8) << 8;
+				ZUC_ASSERT_EQ(expect, out[i][c]);
+			}
+		}
+	}
+}
+
+/*
+ * Every kernel against the scalar one, for all widths up to MAX_WIDTH so
+ * each vector body and tail length shows up, from a misaligned source,
+ * with both channel orders.
+ */
+ZUC_TEST(pixel_convert_test, kernels_match_scalar)
+{
+	const struct pixel_convert_kernels *ref, *k;
+	uint32_t src[2][MAX_WIDTH + 1];
+	uint8_t src24[MAX_WIDTH * 3 + 1];
+	uint32_t out32[2][MAX_WIDTH + 1];
+	uint8_t out8[2][MAX_WIDTH * 3 + 16];
+	uint8_t y[2][2][MAX_WIDTH + 1], uv[2][MAX_WIDTH + 2];
+	unsigned i;
+	int width, swap;
+
+	ref = pixel_convert_get_kernels(PIXEL_CONVERT_IMPL_SCALAR);
+	fill_random(src, sizeof src, 1);
+	fill_random(src24, sizeof src24, 2);
+
+	for (i = 1; i < ARRAY_LENGTH(impls); i++) {
+		k = pixel_convert_get_kernels(impls[i]);
+		if (!k) {
+			printf("%s kernels not available\n", impl_names[i]);
+			continue;
+		}
+
+		for (width = 0; width <= MAX_WIDTH; width++) {
+			/* sentinels catch writes past the row */
+			memset(out32, 0xa5, sizeof out32);
+			ref->swap_rb(out32[0], src[0] + 1, width);
+			k->swap_rb(out32[1], src[0] + 1, width);
+			ZUC_ASSERT_EQ(0, memcmp(out32[0], out32[1],
+						sizeof out32[0]));
+
+			for (swap = 0; swap <= 1; swap++) {
+				memset(out8, 0xa5, sizeof out8);
+				ref->pack_rgb24(out8[0], src[0] + 1, width, swap);
+				k->pack_rgb24(out8[1], src[0] + 1, width, swap);
+				ZUC_ASSERT_EQ(0, memcmp(out8[0], out8[1],
+							sizeof out8[0]));
+
+				memset(out32, 0xa5, sizeof out32);
+				ref->unpack_rgb24(out32[0], src24 + 1, width, swap);
+				k->unpack_rgb24(out32[1], src24 + 1, width, swap);
+				ZUC_ASSERT_EQ(0, memcmp(out32[0], out32[1],
+							sizeof out32[0]));
+
+				memset(y, 0xa5, sizeof y);
+				memset(uv, 0xa5, sizeof uv);
+				ref->nv12(y[0][0], y[0][1], uv[0],
+					  src[0] + 1, src[1], width, swap);
+				k->nv12(y[1][0], y[1][1], uv[1],
+					src[0] + 1, src[1], width, swap);
+				ZUC_ASSERT_EQ(0, memcmp(y[0], y[1],
+							sizeof y[0]));
+				ZUC_ASSERT_EQ(0, memcmp(uv[0], uv[1],
+							sizeof uv[0]));
+
+				memset(out32, 0xa5, sizeof out32);
+				ref->premultiply(out32[0], src[0] + 1, width, swap);
+				k->premultiply(out32[1], src[0] + 1, width, swap);
+				ZUC_ASSERT_EQ(0, memcmp(out32[0], out32[1],
+							sizeof out32[0]));
+
+				/* in place, as the PNG loader runs it */
+				memcpy(out32[1], src[0] + 1, width * 4);
+				k->premultiply(out32[1], out32[1], width, swap);
+				ZUC_ASSERT_EQ(0, memcmp(out32[0], out32[1],
+							width * 4));
+			}
+		}
+	}
+}
+
+/* Saturated and extreme channel values, where rounding and sign
+ * handling in the chroma math would show first. */
+ZUC_TEST(pixel_convert_test, nv12_extremes)
+{
+	static const uint32_t values[] = {
+		0x00000000, 0xffffffff, 0x00ff0000, 0x0000ff00, 0x000000ff,
+		0x00ffff00, 0x00ff00ff, 0x0000ffff, 0x00010101, 0x00fefefe,
+	};
+	const struct pixel_convert_kernels *ref, *k;
+	uint32_t src[2][16];
+	uint8_t y[2][2][16], uv[2][16];
+	unsigned i, a, b;
+
+	ref = pixel_convert_get_kernels(PIXEL_CONVERT_IMPL_SCALAR);
+
+	for (i = 1; i < ARRAY_LENGTH(impls); i++) {
+		k = pixel_convert_get_kernels(impls[i]);
+		if (!k)
+			continue;
+
+		for (a = 0; a < ARRAY_LENGTH(values); a++) {
+			for (b = 0; b < ARRAY_LENGTH(values); b++) {
+				unsigned n;
+
+				for (n = 0; n < 16; n++) {
+					src[0][n] = values[(a + n) % ARRAY_LENGTH(values)];
+					src[1][n] = values[(b + n * 3) % ARRAY_LENGTH(values)];
+				}
+
+				ref->nv12(y[0][0], y[0][1], uv[0],
+					  src[0], src[1], 16, false);
+				k->nv12(y[1][0], y[1][1], uv[1],
+					src[0], src[1], 16, false);
+				ZUC_ASSERT_EQ(0, memcmp(y[0], y[1], sizeof y[0]));
+				ZUC_ASSERT_EQ(0, memcmp(uv[0], uv[1], sizeof uv[0]));
+			}
+		}
+	}
+}
+
+ZUC_TEST(pixel_convert_test, image_flip_and_swap)
+{
+	enum { W = 37, H = 5, STRIDE = 40 };
+	uint32_t src[H][STRIDE], dst[H][W + 3];
+	uint8_t rgb[H][W * 3], check[H][W * 3];
+	uint32_t back[H][W];
+	int x, row;
+
+	fill_random(src, sizeof src, 3);
+
+	pixel_convert_xrgb(dst, sizeof dst[0], src, sizeof src[0], W, H,
+			   PIXEL_CONVERT_YFLIP);
+	for (row = 0; row < H; row++)
+		ZUC_ASSERT_EQ(0, memcmp(dst[row], src[H - 1 - row], W * 4));
+
+	pixel_convert_xrgb(dst, sizeof dst[0], src, sizeof src[0], W, H,
+			   PIXEL_CONVERT_YFLIP | PIXEL_CONVERT_SWAP_RB);
+	for (row = 0; row < H; row++) {
+		for (x = 0; x < W; x++) {
+			uint32_t v = src[H - 1 - row][x];
+
+			ZUC_ASSERT_EQ((v & 0xff00ff00) | ((v >> 16) & 0xff) |
+				      ((v & 0xff) << 16), dst[row][x]);
+		}
+	}
+
+	/* 24-bit and back is lossless apart from alpha */
+	pixel_convert_xrgb_to_rgb24(rgb, sizeof rgb[0], src, sizeof src[0],
+				    W, H, 0);
+	pixel_convert_rgb24_to_xrgb(back, sizeof back[0], rgb, sizeof rgb[0],
+				    W, H, 0);
+	for (row = 0; row < H; row++)
+		for (x = 0; x < W; x++)
+			ZUC_ASSERT_EQ(src[row][x] | 0xff000000, back[row][x]);
+
+	/* a flipped pack is the unflipped one upside down */
+	pixel_convert_xrgb_to_rgb24(check, sizeof check[0], src,
+				    sizeof src[0], W, H, PIXEL_CONVERT_YFLIP);
+	for (row = 0; row < H; row++)
+		ZUC_ASSERT_EQ(0, memcmp(check[row], rgb[H - 1 - row],
+					sizeof rgb[0]));
+}
+
+ZUC_TEST(pixel_convert_test, image_nv12_odd_size)
+{
+	enum { W = 7, H = 5 };
+	const struct pixel_convert_kernels *ref =
+		pixel_convert_get_kernels(PIXEL_CONVERT_IMPL_SCALAR);
+	uint32_t src[H][W];
+	uint8_t y[H][W], uv[(H + 1) / 2][W + 1];
+	uint8_t ey[2][W], euv[W + 1];
+	int row;
+
+	fill_random(src, sizeof src, 4);
+	memset(uv, 0xa5, sizeof uv);
+
+	pixel_convert_xrgb_to_nv12(&y[0][0], W, &uv[0][0], W + 1,
+				   src, sizeof src[0], W, H, 0);
+
+	for (row = 0; row < H; row += 2) {
+		int next = row + 1 < H ? row + 1 : row;
+
+		ref->nv12(ey[0], ey[1], euv, src[row], src[next], W, false);
+		ZUC_ASSERT_EQ(0, memcmp(y[row], ey[0], W));
+		if (next != row)
+			ZUC_ASSERT_EQ(0, memcmp(y[next], ey[1], W));
+		ZUC_ASSERT_EQ(0, memcmp(uv[row / 2], euv, W + 1));
+	}
+}
+
+static double
+mpix_per_s(void (*conv)(const struct pixel_convert_kernels *k,
+			void *dst, const uint32_t *src, int w, int h),
+	   const struct pixel_convert_kernels *k, void *dst,
+	   const uint32_t *src, int w, int h, unsigned rounds)
+{
+	struct timespec start, end;
+	unsigned i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < rounds; i++)
+		conv(k, dst, src, w, h);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (double)w * h * rounds /
+	       timespec_sub_to_nsec(&end, &start) * 1000.0;
+}
+
+static void
+bench_swap(const struct pixel_convert_kernels *k, void *dst,
+	   const uint32_t *src, int w, int h)
+{
+	int row;
+
+	for (row = 0; row < h; row++)
+		k->swap_rb((uint32_t *)dst + (size_t)row * w,
+			   src + (size_t)(h - 1 - row) * w, w);
+}
+
+static void
+bench_premultiply(const struct pixel_convert_kernels *k, void *dst,
+		  const uint32_t *src, int w, int h)
+{
+	k->premultiply(dst, src, w * h, true);
+}
+
+static void
+bench_nv12(const struct pixel_convert_kernels *k, void *dst,
+	   const uint32_t *src, int w, int h)
+{
+	uint8_t *y = dst;
+	uint8_t *uv = y + (size_t)w * h;
+	int row;
+
+	for (row = 0; row < h; row += 2)
+		k->nv12(y + (size_t)row * w, y + (size_t)(row + 1) * w,
+			uv + (size_t)row / 2 * w,
+			src + (size_t)row * w, src + (size_t)(row + 1) * w,
+			w, false);
+}
+
+ZUC_TEST(pixel_convert_test, convert_benchmark)
+{
+	/* a 1080p readback, flipped and swizzled as for a GL screenshot */
+	const int w = 1920, h = 1080;
+	uint32_t *src, *dst;
+	const struct pixel_convert_kernels *k;
+	unsigned i;
+
+	src = malloc((size_t)w * h * 4);
+	dst = malloc((size_t)w * h * 4);
+	ZUC_ASSERTG_NOT_NULL(src, out);
+	ZUC_ASSERTG_NOT_NULL(dst, out);
+	fill_random(src, (size_t)w * h * 4, 5);
+
+	for (i = 0; i < ARRAY_LENGTH(impls); i++) {
+		k = pixel_convert_get_kernels(impls[i]);
+		if (!k)
+			continue;
+
+		printf("%-6s  yflip+swap %7.1f Mpix/s  nv12 %7.1f Mpix/s  "
+		       "premultiply %7.1f Mpix/s\n",
+		       impl_names[i],
+		       mpix_per_s(bench_swap, k, dst, src, w, h, 10),
+		       mpix_per_s(bench_nv12, k, dst, src, w, h, 10),
+		       mpix_per_s(bench_premultiply, k, dst, src, w, h, 10));
+	}
+
+out:
+	free(src);
+	free(dst);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <drm_fourcc.h>
+#include <wayland-client-protocol.h>
+
+#include "pixel-formats.h"
+#include "shared/helpers.h"
+#include "zunitc/zunitc.h"
+
+static const uint32_t known_formats[] = {
+	DRM_FORMAT_XRGB4444,
+	DRM_FORMAT_ARGB4444,
+	DRM_FORMAT_RGB565,
+	DRM_FORMAT_BGR888,
+	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_ARGB8888,
+	DRM_FORMAT_ABGR2101010,
+	DRM_FORMAT_YUYV,
+	DRM_FORMAT_NV12,
+	DRM_FORMAT_YUV420,
+	DRM_FORMAT_YVU444,
+};
+
+ZUC_TEST(pixel_formats, lookup_by_format)
+{
+	const struct pixel_format_info *info;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(known_formats); i++) {
+		info = pixel_format_get_info(known_formats[i]);
+		ZUC_ASSERT_NOT_NULL(info);
+		ZUC_ASSERT_EQ(known_formats[i], info->format);
+	}
+}
+
+ZUC_TEST(pixel_formats, lookup_by_name_round_trips)
+{
+	const struct pixel_format_info *info;
+	char lower[32];
+	unsigned int i, j;
+
+	for (i = 0; i < ARRAY_LENGTH(known_formats); i++) {
+		info = pixel_format_get_info(known_formats[i]);
+		ZUC_ASSERT_NOT_NULL(info);
+		ZUC_ASSERT_TRUE(pixel_format_get_info_by_drm_name(
+					info->drm_format_name) == info);
+
+		/* name lookups are case-insensitive */
+		for (j = 0; info->drm_format_name[j] &&
+			    j < sizeof(lower) - 1; j++)
+			lower[j] = tolower(info->drm_format_name[j]);
+		lower[j] = '\0';
+		ZUC_ASSERT_TRUE(pixel_format_get_info_by_drm_name(lower) ==
+				info);
+	}
+}
+
+ZUC_TEST(pixel_formats, shm_formats_map_to_drm)
+{
+	ZUC_ASSERT_TRUE(pixel_format_get_info_shm(WL_SHM_FORMAT_ARGB8888) ==
+			pixel_format_get_info(DRM_FORMAT_ARGB8888));
+	ZUC_ASSERT_TRUE(pixel_format_get_info_shm(WL_SHM_FORMAT_XRGB8888) ==
+			pixel_format_get_info(DRM_FORMAT_XRGB8888));
+	ZUC_ASSERT_TRUE(pixel_format_get_info_shm(WL_SHM_FORMAT_RGB565) ==
+			pixel_format_get_info(DRM_FORMAT_RGB565));
+}
+
+ZUC_TEST(pixel_formats, unknown_formats_are_not_found)
+{
+	ZUC_ASSERT_NULL(pixel_format_get_info(0));
+	ZUC_ASSERT_NULL(pixel_format_get_info(DRM_FORMAT_C8));
+	ZUC_ASSERT_NULL(pixel_format_get_info(DRM_FORMAT_XRGB8888 |
+					      DRM_FORMAT_BIG_ENDIAN));
+	ZUC_ASSERT_NULL(pixel_format_get_info_by_drm_name(""));
+	ZUC_ASSERT_NULL(pixel_format_get_info_by_drm_name("C8"));
+	ZUC_ASSERT_NULL(pixel_format_get_info_by_drm_name("XRGB88888"));
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "shared/helpers.h"
+#include "shared/readback-plan.h"
+#include "zunitc/zunitc.h"
+
+static int
+box_contains(const struct readback_box *outer, const struct readback_box *inner)
+{
+	return outer->x1 <= inner->x1 && outer->y1 <= inner->y1 &&
+	       outer->x2 >= inner->x2 && outer->y2 >= inner->y2;
+}
+
+/* Every input box must lie entirely within one of the planned boxes:
+ * merging only ever grows boxes into bounding boxes. */
+static int
+plan_covers(const struct readback_box *plan, int n_plan,
+	    const struct readback_box *in, int n_in)
+{
+	int i, j;
+
+	for (i = 0; i < n_in; i++) {
+		for (j = 0; j < n_plan; j++)
+			if (box_contains(&plan[j], &in[i]))
+				break;
+		if (j == n_plan)
+			return 0;
+	}
+
+	return 1;
+}
+
+ZUC_TEST(readback_plan_test, distant_large_boxes_stay_apart)
+{
+	struct readback_box boxes[] = {
+		{ 0, 0, 200, 200 },
+		{ 1000, 800, 1200, 1000 },
+	};
+
+	ZUC_ASSERT_EQ(2, readback_plan(boxes, ARRAY_LENGTH(boxes), 8, 4096));
+}
+
+ZUC_TEST(readback_plan_test, neighbours_merge)
+{
+	/* a clock: glyph boxes next to each other on one line */
+	struct readback_box in[] = {
+		{ 10, 10, 18, 26 },
+		{ 20, 10, 28, 26 },
+		{ 34, 10, 42, 26 },
+		{ 44, 10, 52, 26 },
+	};
+	struct readback_box boxes[ARRAY_LENGTH(in)];
+	int n;
+
+	memcpy(boxes, in, sizeof in);
+	n = readback_plan(boxes, ARRAY_LENGTH(boxes), 8, 4096);
+
+	ZUC_ASSERT_EQ(1, n);
+	ZUC_ASSERT_EQ(10, boxes[0].x1);
+	ZUC_ASSERT_EQ(10, boxes[0].y1);
+	ZUC_ASSERT_EQ(52, boxes[0].x2);
+	ZUC_ASSERT_EQ(26, boxes[0].y2);
+}
+
+ZUC_TEST(readback_plan_test, max_boxes_is_honoured)
+{
+	struct readback_box in[16], boxes[16];
+	int i, n;
+
+	/* far apart, so only the limit forces merging */
+	for (i = 0; i < 16; i++) {
+		in[i].x1 = (i % 4) * 1000;
+		in[i].y1 = (i / 4) * 1000;
+		in[i].x2 = in[i].x1 + 100;
+		in[i].y2 = in[i].y1 + 100;
+	}
+	memcpy(boxes, in, sizeof in);
+
+	n = readback_plan(boxes, 16, 4, 0);
+	ZUC_ASSERT_EQ(4, n);
+	ZUC_ASSERT_TRUE(plan_covers(boxes, n, in, 16));
+
+	memcpy(boxes, in, sizeof in);
+	n = readback_plan(boxes, 16, 0, 0);
+	ZUC_ASSERT_EQ(1, n);
+	ZUC_ASSERT_TRUE(plan_covers(boxes, n, in, 16));
+}
+
+ZUC_TEST(readback_plan_test, fragmented_damage_is_bounded)
+{
+	/* a clock in one corner and a spinner in the other, as a banded
+	 * region hands them out: many thin boxes */
+	struct readback_box in[300], boxes[300];
+	int i, n;
+
+	for (i = 0; i < 150; i++) {
+		in[i].x1 = 1800 + (i % 10) * 12;
+		in[i].y1 = 20 + (i / 10) * 2;
+		in[i].x2 = in[i].x1 + 9;
+		in[i].y2 = in[i].y1 + 2;
+	}
+	for (i = 150; i < 300; i++) {
+		in[i].x1 = 900 + ((i - 150) % 5) * 13;
+		in[i].y1 = 500 + ((i - 150) / 5) * 3;
+		in[i].x2 = in[i].x1 + 7;
+		in[i].y2 = in[i].y1 + 1;
+	}
+	memcpy(boxes, in, sizeof in);
+
+	n = readback_plan(boxes, ARRAY_LENGTH(boxes), 8, 4096);
+	ZUC_ASSERT_EQ(2, n);
+	ZUC_ASSERT_TRUE(plan_covers(boxes, n, in, ARRAY_LENGTH(in)));
+}
+
+ZUC_TEST(readback_plan_test, clusters_on_the_same_rows_stay_apart)
+{
+	/* a clock at the left edge and a spinner at the right edge, ticking
+	 * on the same rows: each band of the region holds a box from both */
+	struct readback_box in[200], boxes[200];
+	int i, n;
+
+	for (i = 0; i < 200; i += 2) {
+		in[i].x1 = 20 + (i / 2 % 4) * 12;
+		in[i].y1 = 40 + (i / 8) * 2;
+		in[i].x2 = in[i].x1 + 9;
+		in[i].y2 = in[i].y1 + 2;
+
+		in[i + 1].x1 = 1800 + (i / 2 % 4) * 10;
+		in[i + 1].y1 = in[i].y1;
+		in[i + 1].x2 = in[i + 1].x1 + 8;
+		in[i + 1].y2 = in[i].y2;
+	}
+	memcpy(boxes, in, sizeof in);
+
+	n = readback_plan(boxes, ARRAY_LENGTH(boxes), 8, 4096);
+	ZUC_ASSERT_EQ(2, n);
+	ZUC_ASSERT_TRUE(plan_covers(boxes, n, in, ARRAY_LENGTH(in)));
+
+	/* neither readback spans the screen between them */
+	for (i = 0; i < n; i++)
+		ZUC_ASSERT_TRUE(boxes[i].x2 <= 100 || boxes[i].x1 >= 1800);
+}
+
+ZUC_TEST(readback_plan_test, empty_and_single)
+{
+	struct readback_box box = { 1, 2, 3, 4 };
+
+	ZUC_ASSERT_EQ(0, readback_plan(NULL, 0, 8, 4096));
+	ZUC_ASSERT_EQ(1, readback_plan(&box, 1, 8, 4096));
+	ZUC_ASSERT_EQ(1, box.x1);
+	ZUC_ASSERT_EQ(4, box.y2);
+}
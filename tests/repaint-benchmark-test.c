@@ -0,0 +1,600 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Headless repaint benchmark.
+ *
+ * Runs a configurable set of synthetic shm clients against the compositor
+ * and reports per-frame compositor cost (from weston_test_perf) and
+ * client-visible frame latency as JSON. The scenario is taken from the
+ * environment so the same binary covers the whole matrix:
+ *
+ *   WESTON_BENCH_CLIENTS           client connections (2)
+ *   WESTON_BENCH_SURFACES          top-level surfaces per client (4)
+ *   WESTON_BENCH_WIDTH/HEIGHT      surface size (64x64)
+ *   WESTON_BENCH_DAMAGE            none, partial or full (partial)
+ *   WESTON_BENCH_SUBSURFACE_DEPTH  subsurface chain below each surface (1)
+ *   WESTON_BENCH_INPUT_RATE        pointer motions per frame (1)
+ *   WESTON_BENCH_FRAMES            measured frames (120)
+ *   WESTON_BENCH_OUTPUT            JSON file, stdout when unset
+ *
+ * The test only fails when the compositor misbehaves, never on numbers;
+ * comparing the JSON against a baseline is left to the caller.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+
+#define BENCH_WARMUP_FRAMES 10
+#define BENCH_MAX_FRAMES 4096
+
+enum bench_damage {
+	BENCH_DAMAGE_NONE,
+	BENCH_DAMAGE_PARTIAL,
+	BENCH_DAMAGE_FULL,
+};
+
+static const char * const damage_names[] = {
+	[BENCH_DAMAGE_NONE] = "none",
+	[BENCH_DAMAGE_PARTIAL] = "partial",
+	[BENCH_DAMAGE_FULL] = "full",
+};
+
+struct bench_config {
+	int clients;
+	int surfaces;
+	int width;
+	int height;
+	enum bench_damage damage;
+	int subsurface_depth;
+	int input_rate;
+	int frames;
+	const char *output;
+};
+
+struct bench_surface {
+	struct client *client;
+	struct surface *surface;
+	struct wl_subsurface *subsurface;
+	struct buffer *buffers[2];
+	int current;
+	struct bench_surface *parent;
+
+	struct bench_run *run;
+	bool frame_pending;
+	struct timespec commit_time;
+};
+
+struct bench_stats {
+	double mean;
+	uint32_t p50;
+	uint32_t p90;
+	uint32_t p99;
+	uint32_t max;
+};
+
+struct bench_run {
+	struct bench_config config;
+	struct client **clients;
+	struct bench_surface *surfaces;
+	int n_surfaces;
+
+	struct wl_subcompositor *subcompositor;
+	struct weston_test_perf *perf;
+
+	struct wl_array latency;	/* uint32_t usec */
+	bool measuring;
+
+	struct wl_array cpu;		/* uint32_t usec */
+	struct wl_array wall;		/* uint32_t usec */
+	int64_t heap_net;
+	int32_t heap_max_growth;
+	bool perf_done;
+};
+
+static int
+env_int(const char *name, int def, int min, int max)
+{
+	const char *str = getenv(name);
+	char *end;
+	long val;
+
+	if (!str || !*str)
+		return def;
+
+	val = strtol(str, &end, 10);
+	assert(*end == '\0' && "benchmark setting is not a number");
+	assert(val >= min && val <= max && "benchmark setting out of range");
+
+	return val;
+}
+
+static void
+bench_config_from_env(struct bench_config *config)
+{
+	const char *damage = getenv("WESTON_BENCH_DAMAGE");
+	unsigned i;
+
+	config->clients = env_int("WESTON_BENCH_CLIENTS", 2, 1, 64);
+	config->surfaces = env_int("WESTON_BENCH_SURFACES", 4, 1, 256);
+	config->width = env_int("WESTON_BENCH_WIDTH", 64, 1, 4096);
+	config->height = env_int("WESTON_BENCH_HEIGHT", 64, 1, 4096);
+	config->subsurface_depth =
+		env_int("WESTON_BENCH_SUBSURFACE_DEPTH", 1, 0, 16);
+	config->input_rate = env_int("WESTON_BENCH_INPUT_RATE", 1, 0, 100);
+	config->frames = env_int("WESTON_BENCH_FRAMES", 120, 1,
+				 BENCH_MAX_FRAMES);
+	config->output = getenv("WESTON_BENCH_OUTPUT");
+
+	config->damage = BENCH_DAMAGE_PARTIAL;
+	if (damage && *damage) {
+		for (i = 0; i < ARRAY_LENGTH(damage_names); i++)
+			if (strcmp(damage, damage_names[i]) == 0)
+				break;
+		assert(i < ARRAY_LENGTH(damage_names) &&
+		       "WESTON_BENCH_DAMAGE must be none, partial or full");
+		config->damage = i;
+	}
+}
+
+static void *
+bind_global(struct client *client, const struct wl_interface *intf)
+{
+	struct global *g;
+
+	wl_list_for_each(g, &client->global_list, link) {
+		if (strcmp(g->interface, intf->name) == 0)
+			return wl_registry_bind(client->wl_registry, g->name,
+						intf, 1);
+	}
+
+	return NULL;
+}
+
+static void
+perf_handle_sample(void *data, struct weston_test_perf *perf,
+		   uint32_t output, uint32_t cpu_usec, uint32_t wall_usec,
+		   int32_t heap_delta)
+{
+	struct bench_run *run = data;
+	uint32_t *p;
+
+	p = wl_array_add(&run->cpu, sizeof *p);
+	assert(p);
+	*p = cpu_usec;
+
+	p = wl_array_add(&run->wall, sizeof *p);
+	assert(p);
+	*p = wall_usec;
+
+	run->heap_net += heap_delta;
+	if (heap_delta > run->heap_max_growth)
+		run->heap_max_growth = heap_delta;
+}
+
+static void
+perf_handle_done(void *data, struct weston_test_perf *perf, uint32_t frames)
+{
+	struct bench_run *run = data;
+
+	assert(run->cpu.size / sizeof(uint32_t) == frames);
+	run->perf_done = true;
+}
+
+static const struct weston_test_perf_listener perf_listener = {
+	perf_handle_sample,
+	perf_handle_done,
+};
+
+static void
+bench_frame_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+	struct bench_surface *bs = data;
+	struct bench_run *run = bs->run;
+	struct timespec now;
+	uint32_t *p;
+
+	wl_callback_destroy(callback);
+	bs->frame_pending = false;
+
+	if (!run->measuring)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	p = wl_array_add(&run->latency, sizeof *p);
+	assert(p);
+	*p = timespec_sub_to_nsec(&now, &bs->commit_time) / 1000;
+}
+
+static const struct wl_callback_listener bench_frame_listener = {
+	bench_frame_done,
+};
+
+static void
+bench_fill(struct buffer *buffer, uint32_t argb)
+{
+	pixman_color_t color = {
+		.alpha = (argb >> 24) * 0x101,
+		.red = ((argb >> 16) & 0xff) * 0x101,
+		.green = ((argb >> 8) & 0xff) * 0x101,
+		.blue = (argb & 0xff) * 0x101,
+	};
+	pixman_image_t *solid = pixman_image_create_solid_fill(&color);
+
+	pixman_image_composite32(PIXMAN_OP_SRC, solid, NULL, buffer->image,
+				 0, 0, 0, 0, 0, 0,
+				 pixman_image_get_width(buffer->image),
+				 pixman_image_get_height(buffer->image));
+	pixman_image_unref(solid);
+}
+
+static void
+bench_surface_init(struct bench_run *run, struct bench_surface *bs,
+		   struct client *client, struct bench_surface *parent,
+		   int index)
+{
+	const struct bench_config *config = &run->config;
+	int i;
+
+	bs->run = run;
+	bs->client = client;
+	bs->parent = parent;
+	bs->surface = create_test_surface(client);
+	bs->surface->width = config->width;
+	bs->surface->height = config->height;
+
+	/* Two buffers in flight so every frame is a real attach. */
+	for (i = 0; i < 2; i++) {
+		bs->buffers[i] = create_shm_buffer_a8r8g8b8(client,
+							    config->width,
+							    config->height);
+		bench_fill(bs->buffers[i], 0xff000000 | (index * 0x2f1b3d) |
+			   (i ? 0x808080 : 0));
+	}
+
+	if (parent) {
+		bs->subsurface =
+			wl_subcompositor_get_subsurface(run->subcompositor,
+							bs->surface->wl_surface,
+							parent->surface->wl_surface);
+		wl_subsurface_set_position(bs->subsurface, 8, 8);
+	}
+}
+
+static void
+bench_surface_damage(struct bench_surface *bs, int frame)
+{
+	const struct bench_config *config = &bs->run->config;
+	struct wl_surface *surface = bs->surface->wl_surface;
+	int size, x, y;
+
+	switch (config->damage) {
+	case BENCH_DAMAGE_NONE:
+		break;
+	case BENCH_DAMAGE_PARTIAL:
+		/* a small square walking along the diagonal */
+		size = MIN(16, MIN(config->width, config->height));
+		x = (frame * 3) % (config->width - size + 1);
+		y = (frame * 5) % (config->height - size + 1);
+		wl_surface_damage_buffer(surface, x, y, size, size);
+		break;
+	case BENCH_DAMAGE_FULL:
+		wl_surface_damage_buffer(surface, 0, 0,
+					 config->width, config->height);
+		break;
+	}
+}
+
+static void
+bench_setup(struct bench_run *run)
+{
+	const struct bench_config *config = &run->config;
+	int depth = config->subsurface_depth;
+	int c, s, d, n = 0;
+	struct bench_surface *bs, *root;
+	struct client *client;
+	int x, y;
+
+	run->clients = xzalloc(config->clients * sizeof *run->clients);
+	run->n_surfaces = config->clients * config->surfaces * (depth + 1);
+	run->surfaces = xzalloc(run->n_surfaces * sizeof *run->surfaces);
+	wl_array_init(&run->latency);
+	wl_array_init(&run->cpu);
+	wl_array_init(&run->wall);
+
+	for (c = 0; c < config->clients; c++) {
+		client = create_client();
+		run->clients[c] = client;
+
+		if (c == 0) {
+			run->perf = bind_global(client,
+						&weston_test_perf_interface);
+			assert(run->perf && "no weston_test_perf found");
+			weston_test_perf_add_listener(run->perf,
+						      &perf_listener, run);
+		}
+
+		if (depth > 0) {
+			if (run->subcompositor)
+				wl_subcompositor_destroy(run->subcompositor);
+			run->subcompositor =
+				bind_global(client, &wl_subcompositor_interface);
+			assert(run->subcompositor);
+		}
+
+		for (s = 0; s < config->surfaces; s++) {
+			root = &run->surfaces[n];
+			bench_surface_init(run, root, client, NULL, n);
+			n++;
+
+			for (d = 0; d < depth; d++) {
+				bs = &run->surfaces[n];
+				bench_surface_init(run, bs, client,
+						   &run->surfaces[n - 1], n);
+				n++;
+			}
+
+			/* Spread the roots over the output with some overlap
+			 * so picking and occlusion have work to do. */
+			x = (c * config->surfaces + s) * 29 %
+			    MAX(1, client->output->width - config->width / 2);
+			y = (c * config->surfaces + s) * 17 %
+			    MAX(1, client->output->height - config->height / 2);
+			root->surface->x = x;
+			root->surface->y = y;
+			weston_test_move_surface(client->test->weston_test,
+						 root->surface->wl_surface,
+						 x, y);
+		}
+	}
+	assert(n == run->n_surfaces);
+}
+
+static void
+bench_send_input(struct bench_run *run, int frame)
+{
+	struct client *client = run->clients[0];
+	struct timespec now;
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+	int i, x, y;
+
+	for (i = 0; i < run->config.input_rate; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		timespec_to_proto(&now, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+		x = (frame * 7 + i * 13) % client->output->width;
+		y = (frame * 3 + i * 11) % client->output->height;
+		weston_test_move_pointer(client->test->weston_test,
+					 tv_sec_hi, tv_sec_lo, tv_nsec, x, y);
+	}
+}
+
+static void
+bench_frame(struct bench_run *run, int frame)
+{
+	struct bench_surface *bs;
+	struct wl_callback *callback;
+	int i, c;
+	bool pending;
+
+	/* Children first: with synchronized subsurfaces their state only
+	 * lands with the parent commit that follows. */
+	for (i = run->n_surfaces - 1; i >= 0; i--) {
+		bs = &run->surfaces[i];
+
+		bs->current ^= 1;
+		wl_surface_attach(bs->surface->wl_surface,
+				  bs->buffers[bs->current]->proxy, 0, 0);
+		bench_surface_damage(bs, frame);
+
+		if (!bs->parent) {
+			callback = wl_surface_frame(bs->surface->wl_surface);
+			wl_callback_add_listener(callback,
+						 &bench_frame_listener, bs);
+			bs->frame_pending = true;
+			clock_gettime(CLOCK_MONOTONIC, &bs->commit_time);
+		}
+
+		wl_surface_commit(bs->surface->wl_surface);
+	}
+
+	bench_send_input(run, frame);
+
+	for (c = 0; c < run->config.clients; c++)
+		assert(wl_display_flush(run->clients[c]->wl_display) >= 0);
+
+	for (c = 0; c < run->config.clients; c++) {
+		do {
+			pending = false;
+			for (i = 0; i < run->n_surfaces; i++) {
+				bs = &run->surfaces[i];
+				if (bs->client == run->clients[c] &&
+				    bs->frame_pending)
+					pending = true;
+			}
+			if (pending)
+				assert(wl_display_dispatch(run->clients[c]->wl_display) >= 0);
+		} while (pending);
+	}
+}
+
+static int
+compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint32_t
+percentile(const uint32_t *sorted, size_t n, int pct)
+{
+	/* nearest-rank */
+	size_t rank = (n * pct + 99) / 100;
+
+	return sorted[rank ? rank - 1 : 0];
+}
+
+static void
+bench_stats_compute(struct wl_array *array, struct bench_stats *stats)
+{
+	uint32_t *values = array->data;
+	size_t n = array->size / sizeof *values;
+	uint64_t sum = 0;
+	size_t i;
+
+	memset(stats, 0, sizeof *stats);
+	if (n == 0)
+		return;
+
+	qsort(values, n, sizeof *values, compare_u32);
+	for (i = 0; i < n; i++)
+		sum += values[i];
+
+	stats->mean = (double)sum / n;
+	stats->p50 = percentile(values, n, 50);
+	stats->p90 = percentile(values, n, 90);
+	stats->p99 = percentile(values, n, 99);
+	stats->max = values[n - 1];
+}
+
+static void
+print_stats(FILE *fp, const char *name, struct wl_array *array,
+	    const char *trailer)
+{
+	struct bench_stats stats;
+
+	bench_stats_compute(array, &stats);
+	fprintf(fp, "\t\t\"%s\": { \"samples\": %zu, \"mean\": %.1f, "
+		"\"p50\": %u, \"p90\": %u, \"p99\": %u, \"max\": %u }%s\n",
+		name, array->size / sizeof(uint32_t), stats.mean,
+		stats.p50, stats.p90, stats.p99, stats.max, trailer);
+}
+
+static void
+bench_report(struct bench_run *run)
+{
+	const struct bench_config *config = &run->config;
+	FILE *fp = stdout;
+
+	if (config->output) {
+		fp = fopen(config->output, "w");
+		assert(fp && "cannot open WESTON_BENCH_OUTPUT");
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "\t\"config\": {\n");
+	fprintf(fp, "\t\t\"clients\": %d,\n", config->clients);
+	fprintf(fp, "\t\t\"surfaces_per_client\": %d,\n", config->surfaces);
+	fprintf(fp, "\t\t\"width\": %d,\n", config->width);
+	fprintf(fp, "\t\t\"height\": %d,\n", config->height);
+	fprintf(fp, "\t\t\"damage\": \"%s\",\n", damage_names[config->damage]);
+	fprintf(fp, "\t\t\"subsurface_depth\": %d,\n", config->subsurface_depth);
+	fprintf(fp, "\t\t\"input_rate\": %d,\n", config->input_rate);
+	fprintf(fp, "\t\t\"frames\": %d\n", config->frames);
+	fprintf(fp, "\t},\n");
+	fprintf(fp, "\t\"compositor\": {\n");
+	print_stats(fp, "cpu_usec", &run->cpu, ",");
+	print_stats(fp, "wall_usec", &run->wall, ",");
+	fprintf(fp, "\t\t\"heap_net_bytes\": %" PRId64 ",\n", run->heap_net);
+	fprintf(fp, "\t\t\"heap_max_growth_bytes\": %d\n",
+		run->heap_max_growth);
+	fprintf(fp, "\t},\n");
+	fprintf(fp, "\t\"client\": {\n");
+	print_stats(fp, "frame_latency_usec", &run->latency, "");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "}\n");
+
+	if (fp != stdout)
+		fclose(fp);
+	else
+		fflush(fp);
+}
+
+static void
+bench_teardown(struct bench_run *run)
+{
+	struct bench_surface *bs;
+	int i;
+
+	for (i = run->n_surfaces - 1; i >= 0; i--) {
+		bs = &run->surfaces[i];
+		if (bs->subsurface)
+			wl_subsurface_destroy(bs->subsurface);
+		wl_surface_destroy(bs->surface->wl_surface);
+		buffer_destroy(bs->buffers[0]);
+		buffer_destroy(bs->buffers[1]);
+		free(bs->surface);
+	}
+
+	weston_test_perf_destroy(run->perf);
+	if (run->subcompositor)
+		wl_subcompositor_destroy(run->subcompositor);
+
+	wl_array_release(&run->latency);
+	wl_array_release(&run->cpu);
+	wl_array_release(&run->wall);
+	free(run->surfaces);
+	free(run->clients);
+}
+
+TEST(repaint_benchmark)
+{
+	struct bench_run run = { 0 };
+	int frame;
+
+	bench_config_from_env(&run.config);
+	bench_setup(&run);
+
+	for (frame = 0; frame < BENCH_WARMUP_FRAMES; frame++)
+		bench_frame(&run, frame);
+
+	weston_test_perf_start(run.perf);
+	run.measuring = true;
+
+	for (; frame < BENCH_WARMUP_FRAMES + run.config.frames; frame++)
+		bench_frame(&run, frame);
+
+	run.measuring = false;
+	weston_test_perf_stop(run.perf);
+	while (!run.perf_done)
+		assert(wl_display_dispatch(run.clients[0]->wl_display) >= 0);
+
+	assert(run.cpu.size > 0 && "compositor recorded no frames");
+	bench_report(&run);
+	bench_teardown(&run);
+}
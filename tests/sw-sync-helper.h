@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_TEST_SW_SYNC_HELPER_H
+#define WESTON_TEST_SW_SYNC_HELPER_H
+
+#include <stdint.h>
+
+/*
+ * Software sync timelines from the kernel's sw_sync driver, to get real
+ * sync_file fences that the test controls without any GPU. The driver is
+ * exposed through debugfs, sw_sync_timeline_create() returns -1 when it is
+ * not available and callers should skip.
+ */
+
+int
+sw_sync_timeline_create(void);
+
+int
+sw_sync_timeline_create_fence(int timeline_fd, uint32_t value);
+
+int
+sw_sync_timeline_inc(int timeline_fd, uint32_t count);
+
+#endif /* WESTON_TEST_SW_SYNC_HELPER_H */
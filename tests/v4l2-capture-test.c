@@ -0,0 +1,227 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "shared/v4l2-capture.h"
+#include "zunitc/zunitc.h"
+
+#define MSEC(x) ((int64_t)(x) * 1000000)
+
+static struct timespec
+at_msec(int64_t ms)
+{
+	struct timespec ts;
+
+	timespec_from_msec(&ts, ms);
+	return ts;
+}
+
+ZUC_TEST(v4l2_capture_test, queue_depth_follows_budget)
+{
+	int64_t interval = NSEC_PER_SEC / 30;
+
+	/* three frames fit in 100 ms, plus the two on screen/pending */
+	ZUC_ASSERT_EQ(5, v4l2_capture_queue_depth(MSEC(100), interval, 2));
+	/* less than a frame of budget still keeps one with the driver */
+	ZUC_ASSERT_EQ(3, v4l2_capture_queue_depth(MSEC(20), interval, 2));
+	ZUC_ASSERT_EQ(3, v4l2_capture_queue_depth(MSEC(100), 0, 2));
+	ZUC_ASSERT_EQ(2, v4l2_capture_queue_depth(MSEC(10), interval, 0));
+	ZUC_ASSERT_EQ(V4L2_CAPTURE_MAX_BUFFERS,
+		      v4l2_capture_queue_depth(MSEC(10000), interval, 2));
+}
+
+ZUC_TEST(v4l2_capture_test, watchdog_counts_misses)
+{
+	struct capture_watchdog wd;
+	struct timespec start = at_msec(0);
+	struct timespec c, p;
+
+	capture_watchdog_init(&wd, MSEC(50), MSEC(33), &start);
+
+	c = at_msec(10);
+	p = at_msec(30);
+	ZUC_ASSERT_FALSE(capture_watchdog_record(&wd, &c, &p));
+
+	c = at_msec(43);
+	p = at_msec(123);
+	ZUC_ASSERT_TRUE(capture_watchdog_record(&wd, &c, &p));
+	c = at_msec(76);
+	p = at_msec(140);
+	ZUC_ASSERT_TRUE(capture_watchdog_record(&wd, &c, &p));
+	ZUC_ASSERT_EQ(2, wd.consecutive_missed);
+
+	c = at_msec(109);
+	p = at_msec(119);
+	ZUC_ASSERT_FALSE(capture_watchdog_record(&wd, &c, &p));
+
+	ZUC_ASSERT_EQ(4, wd.frames);
+	ZUC_ASSERT_EQ(2, wd.missed);
+	ZUC_ASSERT_EQ(0, wd.consecutive_missed);
+	ZUC_ASSERT_EQ(MSEC(80), wd.max_ns);
+	ZUC_ASSERT_EQ(MSEC(10), wd.last_ns);
+	ZUC_ASSERT_EQ(MSEC(20 + 80 + 64 + 10), wd.total_ns);
+}
+
+ZUC_TEST(v4l2_capture_test, watchdog_reports_stall_once)
+{
+	struct capture_watchdog wd;
+	struct timespec start = at_msec(0);
+	struct timespec now, c, p;
+
+	capture_watchdog_init(&wd, MSEC(50), MSEC(33), &start);
+
+	now = at_msec(80);
+	ZUC_ASSERT_EQ(0, capture_watchdog_check(&wd, &now));
+	now = at_msec(90);
+	ZUC_ASSERT_EQ(MSEC(90), capture_watchdog_check(&wd, &now));
+	now = at_msec(100);
+	ZUC_ASSERT_EQ(0, capture_watchdog_check(&wd, &now));
+	ZUC_ASSERT_EQ(1, wd.stalls);
+
+	c = at_msec(100);
+	p = at_msec(120);
+	capture_watchdog_record(&wd, &c, &p);
+
+	now = at_msec(180);
+	ZUC_ASSERT_EQ(0, capture_watchdog_check(&wd, &now));
+	now = at_msec(190);
+	ZUC_ASSERT_EQ(MSEC(90), capture_watchdog_check(&wd, &now));
+	ZUC_ASSERT_EQ(2, wd.stalls);
+}
+
+/* The kernel's virtual capture driver, if loaded (modprobe vivid). */
+static bool
+find_vivid(char *path, size_t size)
+{
+	struct v4l2_capability caps;
+	int i, fd;
+	bool found;
+
+	for (i = 0; i < 64; i++) {
+		snprintf(path, size, "/dev/video%d", i);
+		fd = open(path, O_RDWR | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		memset(&caps, 0, sizeof caps);
+		found = ioctl(fd, VIDIOC_QUERYCAP, &caps) == 0 &&
+			strcmp((const char *)caps.driver, "vivid") == 0 &&
+			(caps.device_caps & (V4L2_CAP_VIDEO_CAPTURE |
+					     V4L2_CAP_VIDEO_CAPTURE_MPLANE));
+		close(fd);
+		if (found)
+			return true;
+	}
+
+	return false;
+}
+
+static struct v4l2_capture_buffer *
+wait_frame(struct v4l2_capture *cap)
+{
+	struct pollfd pfd = { .fd = cap->fd, .events = POLLIN };
+	struct v4l2_capture_buffer *buf;
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		buf = v4l2_capture_dequeue_newest(cap);
+		if (buf || errno != EAGAIN)
+			return buf;
+		poll(&pfd, 1, 20);
+	}
+
+	return NULL;
+}
+
+static void
+stream_vivid(enum v4l2_capture_io io)
+{
+	char path[32];
+	struct v4l2_capture cap;
+	struct v4l2_capture_buffer *buf;
+	struct timespec now, prev;
+	uint64_t dropped;
+	unsigned p;
+
+	if (!find_vivid(path, sizeof path))
+		ZUC_SKIP("vivid is not loaded");
+
+	ZUC_ASSERT_EQ(0, v4l2_capture_open(&cap, path, V4L2_PIX_FMT_XBGR32));
+	ZUC_ASSERT_TRUE(cap.width > 0 && cap.height > 0);
+	ZUC_ASSERT_TRUE(cap.frame_interval_ns > 0);
+
+	ZUC_ASSERT_EQ(0, v4l2_capture_start(&cap,
+		v4l2_capture_queue_depth(MSEC(100), cap.frame_interval_ns, 1),
+		io));
+	/* vivid is vb2 based and can always export */
+	ZUC_ASSERT_EQ(io, cap.io);
+
+	buf = wait_frame(&cap);
+	ZUC_ASSERT_NOT_NULL(buf);
+	for (p = 0; p < cap.num_planes; p++) {
+		if (io == V4L2_CAPTURE_IO_DMABUF)
+			ZUC_ASSERT_TRUE(buf->dmabuf_fds[p] >= 0);
+		else
+			ZUC_ASSERT_NOT_NULL(buf->maps[p]);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ZUC_ASSERT_TRUE(timespec_sub_to_nsec(&now, &buf->timestamp) >= 0);
+	prev = buf->timestamp;
+	ZUC_ASSERT_EQ(0, v4l2_capture_queue(&cap, buf));
+
+	/* fall three frames behind: only the newest comes out */
+	usleep(cap.frame_interval_ns * 3 / 1000);
+	dropped = cap.dropped;
+	buf = wait_frame(&cap);
+	ZUC_ASSERT_NOT_NULL(buf);
+	ZUC_ASSERT_TRUE(cap.dropped > dropped);
+	ZUC_ASSERT_TRUE(timespec_sub_to_nsec(&buf->timestamp, &prev) > 0);
+	ZUC_ASSERT_EQ(0, v4l2_capture_queue(&cap, buf));
+
+	v4l2_capture_close(&cap);
+}
+
+ZUC_TEST(v4l2_capture_test, vivid_dmabuf)
+{
+	stream_vivid(V4L2_CAPTURE_IO_DMABUF);
+}
+
+ZUC_TEST(v4l2_capture_test, vivid_mmap)
+{
+	stream_vivid(V4L2_CAPTURE_IO_MMAP);
+}
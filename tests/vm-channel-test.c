@@ -0,0 +1,537 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "shared/helpers.h"
+#include "shared/vm-channel.h"
+#include "zunitc/zunitc.h"
+
+#define N_MESSAGES 1000
+
+struct peer {
+	char spec[108];
+	int count;
+	size_t max_len;
+	int result;
+	pthread_t thread;
+};
+
+static void
+fill(uint8_t *buf, size_t len, int seq)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (uint8_t) (seq + i);
+}
+
+static bool
+check(const uint8_t *buf, size_t len, int seq)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] != (uint8_t) (seq + i))
+			return false;
+
+	return true;
+}
+
+static size_t
+message_len(int seq, size_t max_len)
+{
+	/* odd sizes, so ring wrap and padding get exercised */
+	return (seq * 7919) % max_len;
+}
+
+/* Client thread: sends count messages, then waits for one reply */
+static void *
+peer_thread(void *data)
+{
+	struct peer *peer = data;
+	struct vm_channel *ch;
+	const void *msg;
+	size_t len;
+	void *buf;
+	int seq;
+
+	peer->result = -1;
+	ch = vm_channel_create(peer->spec, VM_CHANNEL_CLIENT);
+	if (!ch || !vm_channel_wait_connected(ch, 5000))
+		goto out;
+
+	for (seq = 0; seq < peer->count; seq++) {
+		len = message_len(seq, peer->max_len);
+		while (!(buf = vm_channel_send_reserve(ch, len))) {
+			if (errno != EAGAIN)
+				goto out;
+			usleep(100);
+		}
+		fill(buf, len, seq);
+		if (vm_channel_send_commit(ch) < 0)
+			goto out;
+	}
+
+	if (vm_channel_recv(ch, &msg, &len, 5000) == 1 && len == 4 &&
+	    memcmp(msg, "done", 4) == 0)
+		peer->result = 0;
+	vm_channel_recv_release(ch);
+
+out:
+	vm_channel_destroy(ch);
+	return NULL;
+}
+
+static void
+peer_start(struct peer *peer, const char *spec, int count, size_t max_len)
+{
+	snprintf(peer->spec, sizeof(peer->spec), "%s", spec);
+	peer->count = count;
+	peer->max_len = max_len;
+	pthread_create(&peer->thread, NULL, peer_thread, peer);
+}
+
+static int
+serve(struct vm_channel *server, struct peer *peer)
+{
+	const void *msg;
+	size_t len;
+	int seq;
+
+	for (seq = 0; seq < peer->count; seq++) {
+		if (vm_channel_recv(server, &msg, &len, 5000) != 1)
+			return -1;
+		/* framed payloads start 8 byte aligned on every backend */
+		if (len != message_len(seq, peer->max_len) ||
+		    ((uintptr_t) msg & 7) != 0 || !check(msg, len, seq))
+			return -1;
+		vm_channel_recv_release(server);
+	}
+
+	while (vm_channel_send(server, "done", 4) == 0)
+		usleep(100);
+
+	pthread_join(peer->thread, NULL);
+
+	return peer->result;
+}
+
+static void
+shm_spec(char *spec, size_t size)
+{
+	snprintf(spec, size, "shm:%s/vm-channel-test-%d",
+		 getenv("XDG_RUNTIME_DIR") ? getenv("XDG_RUNTIME_DIR") : "/tmp",
+		 getpid());
+}
+
+ZUC_TEST(vm_channel_test, shm_roundtrip)
+{
+	struct vm_channel *server;
+	struct peer peer;
+	char spec[108];
+
+	shm_spec(spec, sizeof(spec));
+	server = vm_channel_create(spec, VM_CHANNEL_SERVER);
+	ZUC_ASSERT_NOT_NULL(server);
+
+	peer_start(&peer, spec, N_MESSAGES, 64 * 1024);
+	ZUC_ASSERT_EQ(0, serve(server, &peer));
+
+	vm_channel_destroy(server);
+}
+
+ZUC_TEST(vm_channel_test, shm_reconnect)
+{
+	struct vm_channel *server;
+	struct peer peer;
+	const void *msg;
+	size_t len;
+	char spec[108];
+
+	shm_spec(spec, sizeof(spec));
+	server = vm_channel_create(spec, VM_CHANNEL_SERVER);
+	ZUC_ASSERT_NOT_NULL(server);
+
+	peer_start(&peer, spec, 10, 1024);
+	ZUC_ASSERT_EQ(0, serve(server, &peer));
+
+	/* the first client is gone, which is reported exactly once */
+	ZUC_ASSERT_EQ(-1, vm_channel_recv(server, &msg, &len, 5000));
+	ZUC_ASSERT_EQ(EPIPE, errno);
+
+	peer_start(&peer, spec, 10, 1024);
+	ZUC_ASSERT_EQ(0, serve(server, &peer));
+
+	vm_channel_destroy(server);
+}
+
+struct corrupt_peer {
+	char spec[108];
+	uint32_t hdr_len;
+	pthread_t thread;
+};
+
+/*
+ * Client thread: publishes a 16 byte message whose ring header claims
+ * hdr_len, then waits for the server to drop it.
+ */
+static void *
+corrupt_peer_thread(void *data)
+{
+	struct corrupt_peer *peer = data;
+	struct vm_channel *ch;
+	const void *msg;
+	size_t len;
+	uint32_t *buf;
+
+	ch = vm_channel_create(peer->spec, VM_CHANNEL_CLIENT);
+	if (!ch || !vm_channel_wait_connected(ch, 5000))
+		goto out;
+
+	buf = vm_channel_send_reserve(ch, 16);
+	if (!buf)
+		goto out;
+	memset(buf, 0, 16);
+	/* the ring header (len, reserved) sits right before the payload */
+	buf[-2] = peer->hdr_len;
+	vm_channel_send_commit(ch);
+
+	while (vm_channel_recv(ch, &msg, &len, 5000) == 1)
+		vm_channel_recv_release(ch);
+
+out:
+	vm_channel_destroy(ch);
+	return NULL;
+}
+
+ZUC_TEST(vm_channel_test, shm_corrupt_header_fails_channel)
+{
+	static const uint32_t bad_lens[] = {
+		64,			/* runs past the published bytes */
+		(16 << 20) + 1,		/* larger than any message */
+		0xffffffffu,		/* padding with nothing after it */
+	};
+	struct vm_channel *server;
+	struct corrupt_peer peer;
+	struct peer good;
+	const void *msg;
+	size_t len;
+	char spec[108];
+	unsigned i;
+
+	shm_spec(spec, sizeof(spec));
+	server = vm_channel_create(spec, VM_CHANNEL_SERVER);
+	ZUC_ASSERT_NOT_NULL(server);
+
+	for (i = 0; i < ARRAY_LENGTH(bad_lens); i++) {
+		snprintf(peer.spec, sizeof(peer.spec), "%s", spec);
+		peer.hdr_len = bad_lens[i];
+		pthread_create(&peer.thread, NULL, corrupt_peer_thread, &peer);
+
+		ZUC_ASSERT_EQ(-1, vm_channel_recv(server, &msg, &len, 5000));
+		ZUC_ASSERT_EQ(EPIPE, errno);
+
+		pthread_join(peer.thread, NULL);
+	}
+
+	/* the next well behaved peer is served normally */
+	peer_start(&good, spec, 10, 1024);
+	ZUC_ASSERT_EQ(0, serve(server, &good));
+
+	vm_channel_destroy(server);
+}
+
+static int
+tcp_port(void)
+{
+	return 20000 + getpid() % 20000;
+}
+
+ZUC_TEST(vm_channel_test, tcp_roundtrip_large_messages)
+{
+	struct vm_channel *server;
+	struct peer peer;
+	char spec[64];
+
+	snprintf(spec, sizeof(spec), "tcp:127.0.0.1:%d", tcp_port());
+	server = vm_channel_create(spec, VM_CHANNEL_SERVER);
+	ZUC_ASSERT_NOT_NULL(server);
+
+	/* messages larger than the socket buffers get queued partially */
+	peer_start(&peer, spec, 50, 4 * 1024 * 1024);
+	ZUC_ASSERT_EQ(0, serve(server, &peer));
+
+	vm_channel_destroy(server);
+}
+
+struct large_peer {
+	char spec[64];
+	size_t len;
+	int result;
+	pthread_t thread;
+};
+
+/* Client thread: receives one message of len bytes */
+static void *
+large_peer_thread(void *data)
+{
+	struct large_peer *peer = data;
+	struct vm_channel *ch;
+	const void *msg;
+	size_t len;
+
+	peer->result = -1;
+	ch = vm_channel_create(peer->spec, VM_CHANNEL_CLIENT);
+	if (!ch || !vm_channel_wait_connected(ch, 5000))
+		goto out;
+
+	if (vm_channel_recv(ch, &msg, &len, 5000) == 1 && len == peer->len &&
+	    check(msg, len, 0))
+		peer->result = 0;
+	vm_channel_recv_release(ch);
+
+out:
+	vm_channel_destroy(ch);
+	return NULL;
+}
+
+/*
+ * A message larger than the socket buffers is only partly written by the
+ * send; the sender then has nothing else to do but flush, which has to
+ * get the rest to the peer.
+ */
+ZUC_TEST(vm_channel_test, tcp_large_send_is_flushed)
+{
+	const size_t len = 8 << 20;
+	struct vm_channel *server;
+	struct large_peer peer;
+	uint8_t *buf;
+	int i, ret;
+
+	snprintf(peer.spec, sizeof(peer.spec), "tcp:127.0.0.1:%d", tcp_port());
+	peer.len = len;
+	server = vm_channel_create(peer.spec, VM_CHANNEL_SERVER);
+	ZUC_ASSERT_NOT_NULL(server);
+	pthread_create(&peer.thread, NULL, large_peer_thread, &peer);
+	ZUC_ASSERT_TRUE(vm_channel_wait_connected(server, 5000));
+
+	buf = malloc(len);
+	ZUC_ASSERT_NOT_NULL(buf);
+	fill(buf, len, 0);
+	ZUC_ASSERT_EQ((int) len, vm_channel_send(server, buf, len));
+	free(buf);
+
+	for (i = 0; i < 5000; i++) {
+		ret = vm_channel_flush(server);
+		if (ret <= 0)
+			break;
+		poll(NULL, 0, 1);
+	}
+	ZUC_ASSERT_EQ(0, ret);
+
+	pthread_join(peer.thread, NULL);
+	ZUC_ASSERT_EQ(0, peer.result);
+
+	vm_channel_destroy(server);
+}
+
+/* A bare address is the unframed stream: receives return raw bytes */
+ZUC_TEST(vm_channel_test, tcp_unframed_stream)
+{
+	struct vm_channel *server, *client;
+	uint8_t sent[4096], got[sizeof(sent)];
+	const void *msg;
+	size_t len, total = 0;
+	char spec[64];
+	int i;
+
+	snprintf(spec, sizeof(spec), "127.0.0.1:%d", tcp_port());
+	server = vm_channel_create(spec, VM_CHANNEL_SERVER);
+	ZUC_ASSERT_NOT_NULL(server);
+	client = vm_channel_create(spec, VM_CHANNEL_CLIENT);
+	ZUC_ASSERT_NOT_NULL(client);
+	ZUC_ASSERT_TRUE(vm_channel_wait_connected(server, 5000));
+	ZUC_ASSERT_TRUE(vm_channel_wait_connected(client, 5000));
+	ZUC_ASSERT_FALSE(vm_channel_is_framed(server));
+
+	fill(sent, sizeof(sent), 0);
+	for (i = 0; i < 4; i++)
+		ZUC_ASSERT_EQ(1024, vm_channel_send(server, sent + i * 1024,
+						    1024));
+
+	/* no headers on the wire, message boundaries are not kept */
+	while (total < sizeof(sent)) {
+		ZUC_ASSERT_EQ(1, vm_channel_recv(client, &msg, &len, 5000));
+		ZUC_ASSERT_TRUE(len <= sizeof(sent) - total);
+		memcpy(got + total, msg, len);
+		total += len;
+		vm_channel_recv_release(client);
+	}
+	ZUC_ASSERT_EQ(0, memcmp(sent, got, sizeof(sent)));
+
+	vm_channel_destroy(client);
+	vm_channel_destroy(server);
+}
+
+/* What a shm server sends along with its fds, see vm-channel.c */
+struct fake_shm_setup {
+	uint32_t ring_size;
+};
+
+struct fake_shm_server {
+	int listen_fd;
+	uint32_t ring_size;
+	off_t size;
+	bool seal;
+	pthread_t thread;
+};
+
+/* Server thread: hands out a memfd as described, then waits for hangup */
+static void *
+fake_shm_server_thread(void *data)
+{
+	struct fake_shm_server *server = data;
+	struct fake_shm_setup setup = { server->ring_size };
+	char control[CMSG_SPACE(3 * sizeof(int))];
+	struct iovec iov = { &setup, sizeof(setup) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct pollfd pfd;
+	int fds[3];
+	int conn, i;
+
+	conn = accept(server->listen_fd, NULL, NULL);
+	if (conn < 0)
+		return NULL;
+
+	fds[0] = memfd_create("vm-channel-test", MFD_ALLOW_SEALING);
+	fds[1] = eventfd(0, EFD_NONBLOCK);
+	fds[2] = eventfd(0, EFD_NONBLOCK);
+	if (ftruncate(fds[0], server->size) == 0 && server->seal)
+		fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	sendmsg(conn, &msg, MSG_NOSIGNAL);
+
+	pfd.fd = conn;
+	pfd.events = POLLIN;
+	poll(&pfd, 1, 5000);
+
+	for (i = 0; i < 3; i++)
+		close(fds[i]);
+	close(conn);
+
+	return NULL;
+}
+
+static bool
+shm_client_accepts(uint32_t ring_size, off_t size, bool seal)
+{
+	struct fake_shm_server server = {
+		.ring_size = ring_size,
+		.size = size,
+		.seal = seal,
+	};
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct vm_channel *client;
+	char spec[108];
+	bool connected;
+
+	shm_spec(spec, sizeof(spec));
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", spec + 4);
+	unlink(addr.sun_path);
+	server.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (bind(server.listen_fd, (struct sockaddr *) &addr,
+		 sizeof(addr)) < 0 ||
+	    listen(server.listen_fd, 1) < 0)
+		return false;
+	pthread_create(&server.thread, NULL, fake_shm_server_thread, &server);
+
+	/* the first connection attempt is made right away */
+	client = vm_channel_create(spec, VM_CHANNEL_CLIENT);
+	connected = client && vm_channel_wait_connected(client, 0);
+	vm_channel_destroy(client);
+
+	pthread_join(server.thread, NULL);
+	close(server.listen_fd);
+	unlink(addr.sun_path);
+
+	return connected;
+}
+
+ZUC_TEST(vm_channel_test, shm_client_checks_the_servers_memfd)
+{
+	const uint32_t ring = 1 << 16;
+	const off_t size = 2 * (128 + ring);
+
+	/* a well formed setup, so the refusals below are not spurious */
+	ZUC_ASSERT_TRUE(shm_client_accepts(ring, size, true));
+
+	ZUC_ASSERT_FALSE(shm_client_accepts(0, size, true));
+	ZUC_ASSERT_FALSE(shm_client_accepts(64, size, true));
+	ZUC_ASSERT_FALSE(shm_client_accepts(1u << 31, size, true));
+	ZUC_ASSERT_FALSE(shm_client_accepts(ring, 4096, true));
+	ZUC_ASSERT_FALSE(shm_client_accepts(ring, size, false));
+}
+
+ZUC_TEST(vm_channel_test, unconnected_send_does_not_block)
+{
+	struct vm_channel *server;
+	char spec[108];
+
+	shm_spec(spec, sizeof(spec));
+	server = vm_channel_create(spec, VM_CHANNEL_SERVER);
+	ZUC_ASSERT_NOT_NULL(server);
+
+	ZUC_ASSERT_EQ(0, vm_channel_send_space(server));
+	ZUC_ASSERT_EQ(-1, vm_channel_send(server, "x", 1));
+	ZUC_ASSERT_EQ(ENOTCONN, errno);
+
+	vm_channel_destroy(server);
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+
+#include "renderer-gl/vm-fence.h"
+#include "sw-sync-helper.h"
+#include "zunitc/zunitc.h"
+
+struct fence_test {
+	struct wl_event_loop *loop;
+	struct vm_fence_wait *wait;
+	int done_count;
+};
+
+static void
+fence_done(struct vm_fence_wait *wait, void *data)
+{
+	struct fence_test *ft = data;
+
+	ft->done_count++;
+}
+
+static void *
+setup(void *data)
+{
+	struct fence_test *ft = calloc(1, sizeof *ft);
+
+	ft->loop = wl_event_loop_create();
+	ft->wait = vm_fence_wait_create(ft->loop, fence_done, ft);
+
+	return ft;
+}
+
+static void
+cleanup(void *data)
+{
+	struct fence_test *ft = data;
+
+	vm_fence_wait_destroy(ft->wait);
+	wl_event_loop_destroy(ft->loop);
+	free(ft);
+}
+
+static struct zuc_fixture fence_fixture = {
+	.set_up = setup,
+	.tear_down = cleanup
+};
+
+ZUC_TEST_F(fence_fixture, no_fences_done_on_arm, data)
+{
+	struct fence_test *ft = data;
+
+	ZUC_ASSERT_EQ(0, ft->done_count);
+	vm_fence_wait_arm(ft->wait);
+	ZUC_ASSERT_EQ(1, ft->done_count);
+}
+
+ZUC_TEST_F(fence_fixture, pipe_fence_waits_for_event_loop, data)
+{
+	struct fence_test *ft = data;
+	int fds[2];
+	char c = 0;
+
+	/* a pipe behaves like a fence: readable once "signalled" */
+	ZUC_ASSERT_EQ(0, pipe(fds));
+	ZUC_ASSERT_EQ(0, vm_fence_wait_add(ft->wait, fds[0]));
+	ZUC_ASSERT_EQ(1, vm_fence_wait_pending(ft->wait));
+
+	vm_fence_wait_arm(ft->wait);
+	wl_event_loop_dispatch(ft->loop, 0);
+	ZUC_ASSERT_EQ(0, ft->done_count);
+
+	ZUC_ASSERT_EQ(1, write(fds[1], &c, 1));
+	wl_event_loop_dispatch(ft->loop, 0);
+	ZUC_ASSERT_EQ(1, ft->done_count);
+	ZUC_ASSERT_EQ(0, vm_fence_wait_pending(ft->wait));
+
+	close(fds[1]);
+}
+
+ZUC_TEST_F(fence_fixture, sw_sync_fences_signal_in_order, data)
+{
+	struct fence_test *ft = data;
+	int timeline;
+
+	timeline = sw_sync_timeline_create();
+	if (timeline < 0)
+		ZUC_SKIP("sw_sync is not available");
+
+	ZUC_ASSERT_EQ(0, vm_fence_wait_add(ft->wait,
+			sw_sync_timeline_create_fence(timeline, 1)));
+	ZUC_ASSERT_EQ(0, vm_fence_wait_add(ft->wait,
+			sw_sync_timeline_create_fence(timeline, 2)));
+	ZUC_ASSERT_EQ(2, vm_fence_wait_pending(ft->wait));
+	vm_fence_wait_arm(ft->wait);
+
+	ZUC_ASSERT_EQ(0, sw_sync_timeline_inc(timeline, 1));
+	wl_event_loop_dispatch(ft->loop, 0);
+	ZUC_ASSERT_EQ(1, vm_fence_wait_pending(ft->wait));
+	ZUC_ASSERT_EQ(0, ft->done_count);
+
+	ZUC_ASSERT_EQ(0, sw_sync_timeline_inc(timeline, 1));
+	wl_event_loop_dispatch(ft->loop, 0);
+	ZUC_ASSERT_EQ(0, vm_fence_wait_pending(ft->wait));
+	ZUC_ASSERT_EQ(1, ft->done_count);
+
+	close(timeline);
+}
+
+ZUC_TEST_F(fence_fixture, sw_sync_signalled_fence_is_not_waited, data)
+{
+	struct fence_test *ft = data;
+	int timeline;
+
+	timeline = sw_sync_timeline_create();
+	if (timeline < 0)
+		ZUC_SKIP("sw_sync is not available");
+
+	ZUC_ASSERT_EQ(0, sw_sync_timeline_inc(timeline, 1));
+	ZUC_ASSERT_EQ(0, vm_fence_wait_add(ft->wait,
+			sw_sync_timeline_create_fence(timeline, 1)));
+	ZUC_ASSERT_EQ(0, vm_fence_wait_pending(ft->wait));
+
+	vm_fence_wait_arm(ft->wait);
+	ZUC_ASSERT_EQ(1, ft->done_count);
+
+	close(timeline);
+}
+
+ZUC_TEST_F(fence_fixture, destroy_cancels_pending_wait, data)
+{
+	struct fence_test *ft = data;
+	int timeline;
+
+	timeline = sw_sync_timeline_create();
+	if (timeline < 0)
+		ZUC_SKIP("sw_sync is not available");
+
+	ZUC_ASSERT_EQ(0, vm_fence_wait_add(ft->wait,
+			sw_sync_timeline_create_fence(timeline, 1)));
+	vm_fence_wait_arm(ft->wait);
+
+	vm_fence_wait_destroy(ft->wait);
+	ft->wait = NULL;
+
+	ZUC_ASSERT_EQ(0, sw_sync_timeline_inc(timeline, 1));
+	wl_event_loop_dispatch(ft->loop, 0);
+	ZUC_ASSERT_EQ(0, ft->done_count);
+
+	close(timeline);
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "zunitc/zunitc.h"
+#include "clients/vmdisplay/vmdisplay-buffer-cache.h"
+
+struct release_log {
+	int count;
+	int last;
+};
+
+static void
+release_payload(void *payload, void *data)
+{
+	struct release_log *log = data;
+
+	log->count++;
+	log->last = *(int *)payload;
+	free(payload);
+}
+
+static int *
+payload(int value)
+{
+	int *p = malloc(sizeof(*p));
+
+	*p = value;
+
+	return p;
+}
+
+static void *
+setup(void *data)
+{
+	return calloc(1, sizeof(struct release_log));
+}
+
+static void
+cleanup(void *data)
+{
+	free(data);
+}
+
+static struct zuc_fixture cache_log = {
+	.set_up = setup,
+	.tear_down = cleanup,
+};
+
+ZUC_TEST_F(cache_log, hit_and_miss, data)
+{
+	struct release_log *log = data;
+	struct vmdisplay_buffer_cache *cache;
+	struct vmdisplay_buffer_cache_stats stats;
+	int *p;
+
+	cache = vmdisplay_buffer_cache_create(4, release_payload, log);
+	ZUC_ASSERT_NOT_NULL(cache);
+
+	ZUC_ASSERT_NULL(vmdisplay_buffer_cache_lookup(cache, 1, 10, 64, 64));
+	ZUC_ASSERT_EQ(0, vmdisplay_buffer_cache_insert(cache, 1, 10, 64, 64,
+						       payload(10)));
+
+	p = vmdisplay_buffer_cache_lookup(cache, 1, 10, 64, 64);
+	ZUC_ASSERT_NOT_NULL(p);
+	ZUC_ASSERT_EQ(10, *p);
+
+	/* same buffer id on another surface is a different buffer */
+	ZUC_ASSERT_NULL(vmdisplay_buffer_cache_lookup(cache, 2, 10, 64, 64));
+
+	vmdisplay_buffer_cache_get_stats(cache, &stats);
+	ZUC_ASSERT_EQ(1, stats.hits);
+	ZUC_ASSERT_EQ(2, stats.misses);
+	ZUC_ASSERT_EQ(0, stats.evictions);
+
+	vmdisplay_buffer_cache_destroy(cache);
+	ZUC_ASSERT_EQ(1, log->count);
+}
+
+ZUC_TEST_F(cache_log, lru_eviction_per_surface, data)
+{
+	struct release_log *log = data;
+	struct vmdisplay_buffer_cache *cache;
+	struct vmdisplay_buffer_cache_stats stats;
+	int i;
+
+	cache = vmdisplay_buffer_cache_create(3, release_payload, log);
+	ZUC_ASSERT_NOT_NULL(cache);
+
+	for (i = 1; i <= 3; i++)
+		vmdisplay_buffer_cache_insert(cache, 1, i, 8, 8, payload(i));
+	vmdisplay_buffer_cache_insert(cache, 2, 100, 8, 8, payload(100));
+
+	/* touch 1 so that 2 becomes the oldest buffer of surface 1 */
+	ZUC_ASSERT_NOT_NULL(vmdisplay_buffer_cache_lookup(cache, 1, 1, 8, 8));
+
+	vmdisplay_buffer_cache_insert(cache, 1, 4, 8, 8, payload(4));
+	ZUC_ASSERT_EQ(1, log->count);
+	ZUC_ASSERT_EQ(2, log->last);
+	ZUC_ASSERT_EQ(3, vmdisplay_buffer_cache_count(cache, 1));
+
+	/* the other surface is not affected by surface 1 filling up */
+	ZUC_ASSERT_EQ(1, vmdisplay_buffer_cache_count(cache, 2));
+	ZUC_ASSERT_NOT_NULL(vmdisplay_buffer_cache_lookup(cache, 2, 100, 8, 8));
+
+	vmdisplay_buffer_cache_get_stats(cache, &stats);
+	ZUC_ASSERT_EQ(1, stats.evictions);
+
+	vmdisplay_buffer_cache_destroy(cache);
+	ZUC_ASSERT_EQ(5, log->count);
+}
+
+ZUC_TEST_F(cache_log, size_change_invalidates, data)
+{
+	struct release_log *log = data;
+	struct vmdisplay_buffer_cache *cache;
+	struct vmdisplay_buffer_cache_stats stats;
+
+	cache = vmdisplay_buffer_cache_create(2, release_payload, log);
+	ZUC_ASSERT_NOT_NULL(cache);
+
+	vmdisplay_buffer_cache_insert(cache, 7, 1, 64, 64, payload(1));
+	ZUC_ASSERT_NULL(vmdisplay_buffer_cache_lookup(cache, 7, 1, 128, 64));
+	ZUC_ASSERT_EQ(1, log->count);
+	ZUC_ASSERT_EQ(0, vmdisplay_buffer_cache_count(cache, 7));
+
+	vmdisplay_buffer_cache_get_stats(cache, &stats);
+	ZUC_ASSERT_EQ(1, stats.misses);
+	ZUC_ASSERT_EQ(1, stats.evictions);
+
+	vmdisplay_buffer_cache_destroy(cache);
+}
+
+ZUC_TEST_F(cache_log, replace_and_remove, data)
+{
+	struct release_log *log = data;
+	struct vmdisplay_buffer_cache *cache;
+	int *p;
+
+	cache = vmdisplay_buffer_cache_create(2, release_payload, log);
+	ZUC_ASSERT_NOT_NULL(cache);
+
+	vmdisplay_buffer_cache_insert(cache, 1, 1, 8, 8, payload(1));
+	vmdisplay_buffer_cache_insert(cache, 1, 1, 8, 8, payload(2));
+	ZUC_ASSERT_EQ(1, log->count);
+	ZUC_ASSERT_EQ(1, log->last);
+	ZUC_ASSERT_EQ(1, vmdisplay_buffer_cache_count(cache, 1));
+
+	p = vmdisplay_buffer_cache_lookup(cache, 1, 1, 8, 8);
+	ZUC_ASSERT_NOT_NULL(p);
+	ZUC_ASSERT_EQ(2, *p);
+
+	vmdisplay_buffer_cache_remove(cache, 1, 1);
+	ZUC_ASSERT_EQ(2, log->count);
+	ZUC_ASSERT_NULL(vmdisplay_buffer_cache_lookup(cache, 1, 1, 8, 8));
+
+	vmdisplay_buffer_cache_destroy(cache);
+}
+
+ZUC_TEST_F(cache_log, reserve_and_drop_surface, data)
+{
+	struct release_log *log = data;
+	struct vmdisplay_buffer_cache *cache;
+	struct vmdisplay_buffer_cache_stats stats;
+	int i;
+
+	cache = vmdisplay_buffer_cache_create(4, release_payload, log);
+	ZUC_ASSERT_NOT_NULL(cache);
+
+	ZUC_ASSERT_EQ(1, vmdisplay_buffer_cache_reserve(cache, 42));
+	ZUC_ASSERT_EQ(0, vmdisplay_buffer_cache_reserve(cache, 42));
+	ZUC_ASSERT_EQ(0, vmdisplay_buffer_cache_count(cache, 42));
+
+	for (i = 0; i < 4; i++)
+		vmdisplay_buffer_cache_insert(cache, 42, i, 8, 8, payload(i));
+	vmdisplay_buffer_cache_insert(cache, 43, 0, 8, 8, payload(0));
+
+	vmdisplay_buffer_cache_drop_surface(cache, 42);
+	ZUC_ASSERT_EQ(4, log->count);
+	ZUC_ASSERT_EQ(0, vmdisplay_buffer_cache_count(cache, 42));
+	ZUC_ASSERT_NOT_NULL(vmdisplay_buffer_cache_lookup(cache, 43, 0, 8, 8));
+
+	vmdisplay_buffer_cache_get_stats(cache, &stats);
+	ZUC_ASSERT_EQ(1, stats.reserves);
+	ZUC_ASSERT_EQ(0, stats.evictions);
+
+	vmdisplay_buffer_cache_clear(cache);
+	ZUC_ASSERT_EQ(5, log->count);
+
+	vmdisplay_buffer_cache_destroy(cache);
+}
+
+ZUC_TEST_F(cache_log, many_surfaces_grow_table, data)
+{
+	struct release_log *log = data;
+	struct vmdisplay_buffer_cache *cache;
+	int s, b;
+	int *p;
+
+	cache = vmdisplay_buffer_cache_create(3, release_payload, log);
+	ZUC_ASSERT_NOT_NULL(cache);
+
+	for (s = 1; s <= 200; s++)
+		for (b = 0; b < 5; b++)
+			vmdisplay_buffer_cache_insert(cache, s, b, 8, 8,
+						      payload(s * 10 + b));
+
+	/* the two oldest buffers of each surface were evicted */
+	ZUC_ASSERT_EQ(400, log->count);
+	for (s = 1; s <= 200; s++) {
+		ZUC_ASSERT_NULL(vmdisplay_buffer_cache_lookup(cache, s, 1,
+							      8, 8));
+		p = vmdisplay_buffer_cache_lookup(cache, s, 4, 8, 8);
+		ZUC_ASSERT_NOT_NULL(p);
+		ZUC_ASSERT_EQ(s * 10 + 4, *p);
+	}
+
+	vmdisplay_buffer_cache_destroy(cache);
+	ZUC_ASSERT_EQ(1000, log->count);
+}
+
+ZUC_TEST_F(cache_log, switching_surfaces_keeps_imports, data)
+{
+	struct release_log *log = data;
+	struct vmdisplay_buffer_cache *cache;
+	struct vmdisplay_buffer_cache_stats stats;
+	int frame, s;
+
+	cache = vmdisplay_buffer_cache_create(4, release_payload, log);
+	ZUC_ASSERT_NOT_NULL(cache);
+
+	/* two guest surfaces shown in turn, triple buffered */
+	for (frame = 0; frame < 30; frame++) {
+		s = 1 + frame % 2;
+		vmdisplay_buffer_cache_reserve(cache, s);
+		if (!vmdisplay_buffer_cache_lookup(cache, s, frame / 2 % 3,
+						   8, 8))
+			vmdisplay_buffer_cache_insert(cache, s, frame / 2 % 3,
+						      8, 8, payload(frame));
+	}
+
+	vmdisplay_buffer_cache_get_stats(cache, &stats);
+	ZUC_ASSERT_EQ(6, stats.misses);
+	ZUC_ASSERT_EQ(24, stats.hits);
+	ZUC_ASSERT_EQ(0, log->count);
+
+	vmdisplay_buffer_cache_destroy(cache);
+	ZUC_ASSERT_EQ(6, log->count);
+}
+
+ZUC_TEST_F(cache_log, least_recent_surface_is_evicted, data)
+{
+	struct release_log *log = data;
+	struct vmdisplay_buffer_cache *cache;
+	struct vmdisplay_buffer_cache_stats stats;
+	int s;
+
+	cache = vmdisplay_buffer_cache_create(2, release_payload, log);
+	ZUC_ASSERT_NOT_NULL(cache);
+
+	for (s = 1; s <= 256; s++)
+		vmdisplay_buffer_cache_insert(cache, s, 0, 8, 8, payload(s));
+
+	/* surface 1 is shown again, so surface 2 is the oldest */
+	ZUC_ASSERT_NOT_NULL(vmdisplay_buffer_cache_lookup(cache, 1, 0, 8, 8));
+	vmdisplay_buffer_cache_insert(cache, 257, 0, 8, 8, payload(257));
+
+	ZUC_ASSERT_EQ(1, log->count);
+	ZUC_ASSERT_EQ(2, log->last);
+	ZUC_ASSERT_EQ(0, vmdisplay_buffer_cache_count(cache, 2));
+	ZUC_ASSERT_EQ(1, vmdisplay_buffer_cache_count(cache, 1));
+
+	vmdisplay_buffer_cache_get_stats(cache, &stats);
+	ZUC_ASSERT_EQ(1, stats.evictions);
+
+	vmdisplay_buffer_cache_destroy(cache);
+	ZUC_ASSERT_EQ(257, log->count);
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zunitc/zunitc.h"
+#include "clients/vmdisplay/vmdisplay-capture.h"
+
+static char *
+capture_path(void)
+{
+	char *path = strdup("/tmp/vmdisplay-capture-test-XXXXXX");
+	int fd = mkstemp(path);
+
+	close(fd);
+
+	return path;
+}
+
+ZUC_TEST(vmdisplay_capture, roundtrip)
+{
+	struct vmdisplay_capture *capture;
+	struct vmdisplay_capture_reader *reader;
+	struct vmdisplay_capture_record record;
+	char *path = capture_path();
+	uint64_t last = 0;
+	char data[64];
+	int i;
+
+	capture = vmdisplay_capture_create(path);
+	ZUC_ASSERT_NOT_NULL(capture);
+	for (i = 0; i < 10; i++) {
+		memset(data, i, sizeof(data));
+		ZUC_ASSERT_EQ(0, vmdisplay_capture_write(capture,
+				i % 2 ? VMDISPLAY_CAPTURE_INPUT :
+					VMDISPLAY_CAPTURE_METADATA,
+				data, i + 1));
+	}
+	vmdisplay_capture_destroy(capture);
+
+	reader = vmdisplay_capture_reader_open(path);
+	ZUC_ASSERT_NOT_NULL(reader);
+
+	for (i = 0; i < 10; i++) {
+		ZUC_ASSERT_EQ(1, vmdisplay_capture_reader_next(reader, &record));
+		ZUC_ASSERT_EQ(i % 2 ? VMDISPLAY_CAPTURE_INPUT :
+			      VMDISPLAY_CAPTURE_METADATA, record.type);
+		ZUC_ASSERT_EQ(i + 1, record.len);
+		ZUC_ASSERT_EQ(i, ((const char *)record.data)[i]);
+		ZUC_ASSERT_TRUE(record.timestamp_ns >= last);
+		last = record.timestamp_ns;
+	}
+	ZUC_ASSERT_EQ(0, vmdisplay_capture_reader_next(reader, &record));
+
+	vmdisplay_capture_reader_rewind(reader);
+	ZUC_ASSERT_EQ(1, vmdisplay_capture_reader_next(reader, &record));
+	ZUC_ASSERT_EQ(1, record.len);
+
+	vmdisplay_capture_reader_close(reader);
+	unlink(path);
+	free(path);
+}
+
+ZUC_TEST(vmdisplay_capture, truncated_record_ends_capture)
+{
+	struct vmdisplay_capture *capture;
+	struct vmdisplay_capture_reader *reader;
+	struct vmdisplay_capture_record record;
+	char *path = capture_path();
+	char data[32] = { 0 };
+
+	capture = vmdisplay_capture_create(path);
+	ZUC_ASSERT_NOT_NULL(capture);
+	vmdisplay_capture_write(capture, VMDISPLAY_CAPTURE_METADATA, data, 32);
+	vmdisplay_capture_write(capture, VMDISPLAY_CAPTURE_METADATA, data, 32);
+	vmdisplay_capture_destroy(capture);
+
+	/* cut the second record in half, as a killed recorder would */
+	ZUC_ASSERT_EQ(0, truncate(path,
+		sizeof(struct vmdisplay_capture_file_header) +
+		2 * sizeof(struct vmdisplay_capture_record_header) + 32 + 16));
+
+	reader = vmdisplay_capture_reader_open(path);
+	ZUC_ASSERT_NOT_NULL(reader);
+	ZUC_ASSERT_EQ(1, vmdisplay_capture_reader_next(reader, &record));
+	ZUC_ASSERT_EQ(0, vmdisplay_capture_reader_next(reader, &record));
+	vmdisplay_capture_reader_close(reader);
+
+	unlink(path);
+	free(path);
+}
+
+ZUC_TEST(vmdisplay_capture, rejects_other_files)
+{
+	char *path = capture_path();
+	FILE *f = fopen(path, "w");
+
+	fputs("definitely not a capture file", f);
+	fclose(f);
+
+	ZUC_ASSERT_NULL(vmdisplay_capture_reader_open(path));
+
+	unlink(path);
+	free(path);
+}
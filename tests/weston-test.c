@@ -32,6 +32,10 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif
 
 #include <libweston/libweston.h>
 #include "backend.h"
@@ -40,10 +44,15 @@
 #include "weston-test-server-protocol.h"
 
 #include "shared/helpers.h"
+#include "shared/pixel-convert.h"
 #include "shared/timespec-util.h"
 
 #define MAX_TOUCH_DEVICES 32
 
+/* Keeps the burst of sample events sent on stop well inside the socket
+ * buffer; the benchmark client never asks for more than this. */
+#define TEST_PERF_MAX_SAMPLES 4096
+
 struct weston_test {
 	struct weston_compositor *compositor;
 	struct weston_layer layer;
@@ -368,70 +377,6 @@ struct test_screenshot_frame_listener {
 	void *data;
 };
 
-static void
-copy_bgra_yflip(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	uint8_t *end;
-
-	end = dst + height * stride;
-	while (dst < end) {
-		memcpy(dst, src, stride);
-		dst += stride;
-		src -= stride;
-	}
-}
-
-
-static void
-copy_bgra(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	/* TODO: optimize this out */
-	memcpy(dst, src, height * stride);
-}
-
-static void
-copy_row_swap_RB(void *vdst, void *vsrc, int bytes)
-{
-	uint32_t *dst = vdst;
-	uint32_t *src = vsrc;
-	uint32_t *end = dst + bytes / 4;
-
-	while (dst < end) {
-		uint32_t v = *src++;
-		/*                    A R G B */
-		uint32_t tmp = v & 0xff00ff00;
-		tmp |= (v >> 16) & 0x000000ff;
-		tmp |= (v << 16) & 0x00ff0000;
-		*dst++ = tmp;
-	}
-}
-
-static void
-copy_rgba_yflip(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	uint8_t *end;
-
-	end = dst + height * stride;
-	while (dst < end) {
-		copy_row_swap_RB(dst, src, stride);
-		dst += stride;
-		src -= stride;
-	}
-}
-
-static void
-copy_rgba(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	uint8_t *end;
-
-	end = dst + height * stride;
-	while (dst < end) {
-		copy_row_swap_RB(dst, src, stride);
-		dst += stride;
-		src += stride;
-	}
-}
-
 static void
 test_screenshot_frame_notify(struct wl_listener *listener, void *data)
 {
@@ -441,7 +386,9 @@ test_screenshot_frame_notify(struct wl_listener *listener, void *data)
 	struct weston_output *output = data;
 	struct weston_compositor *compositor = output->compositor;
 	int32_t stride;
-	uint8_t *pixels, *d, *s;
+	uint8_t *pixels, *d;
+	uint32_t flags = 0;
+	bool convert = true;
 
 	output->disable_planes--;
 	wl_list_remove(&listener->link);
@@ -466,7 +413,6 @@ test_screenshot_frame_notify(struct wl_listener *listener, void *data)
 	stride = wl_shm_buffer_get_stride(l->buffer->shm_buffer);
 
 	d = wl_shm_buffer_get_data(l->buffer->shm_buffer);
-	s = pixels + stride * (l->buffer->height - 1);
 
 	wl_shm_buffer_begin_access(l->buffer->shm_buffer);
 
@@ -476,22 +422,24 @@ test_screenshot_frame_notify(struct wl_listener *listener, void *data)
 	switch (compositor->read_format) {
 	case PIXMAN_a8r8g8b8:
 	case PIXMAN_x8r8g8b8:
-		if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
-			copy_bgra_yflip(d, s, output->current_mode->height, stride);
-		else
-			copy_bgra(d, pixels, output->current_mode->height, stride);
+		flags = 0;
 		break;
 	case PIXMAN_x8b8g8r8:
 	case PIXMAN_a8b8g8r8:
-		if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
-			copy_rgba_yflip(d, s, output->current_mode->height, stride);
-		else
-			copy_rgba(d, pixels, output->current_mode->height, stride);
+		flags = PIXEL_CONVERT_SWAP_RB;
 		break;
 	default:
+		convert = false;
 		break;
 	}
 
+	if (convert) {
+		if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
+			flags |= PIXEL_CONVERT_YFLIP;
+		pixel_convert_xrgb(d, stride, pixels, stride, stride / 4,
+				   output->current_mode->height, flags);
+	}
+
 	wl_shm_buffer_end_access(l->buffer->shm_buffer);
 
 	l->done(l->data, WESTON_TEST_SCREENSHOT_SUCCESS);
@@ -634,6 +582,222 @@ bind_test(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 	notify_pointer_position(test, resource);
 }
 
+struct test_perf_sample {
+	uint32_t output;
+	uint32_t cpu_usec;
+	uint32_t wall_usec;
+	int32_t heap_delta;
+};
+
+struct test_perf {
+	struct wl_resource *resource;
+	struct weston_compositor *compositor;
+	struct wl_list output_list;	/* test_perf_output::link */
+	struct wl_array samples;	/* struct test_perf_sample */
+	bool recording;
+	struct timespec last_cpu;
+	struct timespec last_wall;
+	size_t last_heap;
+};
+
+struct test_perf_output {
+	struct test_perf *perf;
+	struct weston_output *output;
+	struct wl_listener frame_listener;
+	struct wl_listener destroy_listener;
+	struct wl_list link;
+};
+
+static size_t
+perf_heap_in_use(void)
+{
+#ifdef HAVE_MALLINFO2
+	return mallinfo2().uordblks;
+#else
+	return 0;
+#endif
+}
+
+static void
+perf_snapshot(struct test_perf *perf)
+{
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &perf->last_cpu);
+	clock_gettime(CLOCK_MONOTONIC, &perf->last_wall);
+	perf->last_heap = perf_heap_in_use();
+}
+
+static void
+perf_output_destroy(struct test_perf_output *po)
+{
+	wl_list_remove(&po->frame_listener.link);
+	wl_list_remove(&po->destroy_listener.link);
+	wl_list_remove(&po->link);
+	free(po);
+}
+
+static void
+perf_output_frame_notify(struct wl_listener *listener, void *data)
+{
+	struct test_perf_output *po =
+		container_of(listener, struct test_perf_output, frame_listener);
+	struct test_perf *perf = po->perf;
+	struct test_perf_sample *sample;
+	struct timespec cpu, wall;
+	size_t heap;
+
+	if (!perf->recording ||
+	    perf->samples.size >= TEST_PERF_MAX_SAMPLES * sizeof *sample)
+		return;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	heap = perf_heap_in_use();
+
+	sample = wl_array_add(&perf->samples, sizeof *sample);
+	if (!sample)
+		return;
+
+	sample->output = po->output->id;
+	sample->cpu_usec = timespec_sub_to_nsec(&cpu, &perf->last_cpu) / 1000;
+	sample->wall_usec = timespec_sub_to_nsec(&wall, &perf->last_wall) / 1000;
+	sample->heap_delta = (int64_t)heap - (int64_t)perf->last_heap;
+
+	/* Snapshot again so the bookkeeping above is not billed to the
+	 * next frame. */
+	perf_snapshot(perf);
+}
+
+static void
+perf_output_destroy_notify(struct wl_listener *listener, void *data)
+{
+	struct test_perf_output *po =
+		container_of(listener, struct test_perf_output,
+			     destroy_listener);
+
+	perf_output_destroy(po);
+}
+
+static void
+perf_stop_listening(struct test_perf *perf)
+{
+	struct test_perf_output *po, *tmp;
+
+	wl_list_for_each_safe(po, tmp, &perf->output_list, link)
+		perf_output_destroy(po);
+}
+
+static void
+perf_start(struct wl_client *client, struct wl_resource *resource)
+{
+	struct test_perf *perf = wl_resource_get_user_data(resource);
+	struct weston_output *output;
+	struct test_perf_output *po;
+
+	perf_stop_listening(perf);
+	perf->samples.size = 0;
+
+	/* Grow the array once up front so recording does not show up in
+	 * the heap numbers. */
+	if (!wl_array_add(&perf->samples,
+			  TEST_PERF_MAX_SAMPLES * sizeof(struct test_perf_sample))) {
+		wl_resource_post_no_memory(resource);
+		return;
+	}
+	perf->samples.size = 0;
+
+	wl_list_for_each(output, &perf->compositor->output_list, link) {
+		po = zalloc(sizeof *po);
+		if (!po) {
+			perf_stop_listening(perf);
+			wl_resource_post_no_memory(resource);
+			return;
+		}
+
+		po->perf = perf;
+		po->output = output;
+		po->frame_listener.notify = perf_output_frame_notify;
+		wl_signal_add(&output->frame_signal, &po->frame_listener);
+		po->destroy_listener.notify = perf_output_destroy_notify;
+		wl_signal_add(&output->destroy_signal, &po->destroy_listener);
+		wl_list_insert(&perf->output_list, &po->link);
+	}
+
+	perf->recording = true;
+	perf_snapshot(perf);
+}
+
+static void
+perf_stop(struct wl_client *client, struct wl_resource *resource)
+{
+	struct test_perf *perf = wl_resource_get_user_data(resource);
+	struct test_perf_sample *sample;
+	uint32_t frames = 0;
+
+	perf->recording = false;
+	perf_stop_listening(perf);
+
+	wl_array_for_each(sample, &perf->samples) {
+		weston_test_perf_send_sample(resource, sample->output,
+					     sample->cpu_usec,
+					     sample->wall_usec,
+					     sample->heap_delta);
+		frames++;
+	}
+
+	weston_test_perf_send_done(resource, frames);
+	perf->samples.size = 0;
+}
+
+static void
+perf_destroy(struct wl_client *client, struct wl_resource *resource)
+{
+	wl_resource_destroy(resource);
+}
+
+static const struct weston_test_perf_interface perf_implementation = {
+	perf_destroy,
+	perf_start,
+	perf_stop,
+};
+
+static void
+destroy_perf_resource(struct wl_resource *resource)
+{
+	struct test_perf *perf = wl_resource_get_user_data(resource);
+
+	perf_stop_listening(perf);
+	wl_array_release(&perf->samples);
+	free(perf);
+}
+
+static void
+bind_perf(struct wl_client *client, void *data, uint32_t version, uint32_t id)
+{
+	struct weston_test *test = data;
+	struct test_perf *perf;
+
+	perf = zalloc(sizeof *perf);
+	if (!perf) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	perf->resource = wl_resource_create(client, &weston_test_perf_interface,
+					    1, id);
+	if (!perf->resource) {
+		free(perf);
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	perf->compositor = test->compositor;
+	wl_list_init(&perf->output_list);
+	wl_array_init(&perf->samples);
+
+	wl_resource_set_implementation(perf->resource, &perf_implementation,
+				       perf, destroy_perf_resource);
+}
+
 static void
 idle_launch_client(void *data)
 {
@@ -681,6 +845,10 @@ wet_module_init(struct weston_compositor *ec,
 			     test, bind_test) == NULL)
 		return -1;
 
+	if (wl_global_create(ec->wl_display, &weston_test_perf_interface, 1,
+			     test, bind_perf) == NULL)
+		return -1;
+
 	if (test_seat_init(test) == -1)
 		return -1;
 